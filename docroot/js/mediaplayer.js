@@ -26,6 +26,9 @@ LMS.mediaplayer = function () {
 	var _settings = {};
 	var _audioCtx = new (window.AudioContext || window.webkitAudioContext)();
 	var _gainNode = _audioCtx.createGain();
+	var _prefetchAudio; // preloads the next track, so that its transcode or file read is already in progress once it gets loaded
+	var _nearEndNotified = false;
+	const _prefetchDelay = 20; // seconds before the end of the current track
 
 	var _updateControls = function() {
 		if (_elems.audio.paused) {
@@ -204,6 +207,11 @@ LMS.mediaplayer = function () {
 		_elems.audio.addEventListener("timeupdate", function() {
 			_elems.progress.style.width = "" + ((_offset + _elems.audio.currentTime) / _duration) * 100 + "%";
 			_elems.curtime.innerHTML = _durationToString(_offset + _elems.audio.currentTime);
+
+			if (!_nearEndNotified && _duration - (_offset + _elems.audio.currentTime) < _prefetchDelay) {
+				_nearEndNotified = true;
+				Wt.emit(_root, "playbackNearEnd");
+			}
 		});
 
 		_elems.audio.addEventListener("ended", function() {
@@ -211,6 +219,9 @@ LMS.mediaplayer = function () {
 		});
 
 		_elems.audio.addEventListener("canplay", function() {
+			// The prefetched track is now being read by the audio element itself
+			_releasePrefetch();
+
 			if (_getAudioMode() == Mode.Transcode) {
 				_elems.transcodingActive.style.visibility = "visible";
 			}
@@ -275,10 +286,38 @@ LMS.mediaplayer = function () {
 		}
 	}
 
-	var _addAudioSource = function(audioSrc) {
+	var _addAudioSource = function(audioSrc, audio = _elems.audio) {
 		let source = document.createElement('source');
 		source.src = audioSrc;
-		_elems.audio.appendChild(source);
+		audio.appendChild(source);
+	}
+
+	var _getTranscodeSrc = function(params) {
+		return params.transcodeResource + "&bitrate=" + _settings.transcode.bitrate + "&format=" + _settings.transcode.format;
+	}
+
+	// ! order is important
+	var _addAudioSources = function(params, audio = _elems.audio) {
+		if (_settings.transcode.mode == TranscodeMode.Never || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
+		{
+			_addAudioSource(params.nativeResource, audio);
+		}
+		if (_settings.transcode.mode == TranscodeMode.Always || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
+		{
+			_addAudioSource(_getTranscodeSrc(params), audio);
+		}
+	}
+
+	var _releasePrefetch = function() {
+		if (!_prefetchAudio)
+			return;
+
+		// Abort the download, if still in progress
+		while (_prefetchAudio.lastElementChild) {
+			_prefetchAudio.removeChild(_prefetchAudio.lastElementChild);
+		}
+		_prefetchAudio.load();
+		_prefetchAudio = undefined;
 	}
 
 	var _getAudioMode = function() {
@@ -295,21 +334,14 @@ LMS.mediaplayer = function () {
 	var loadTrack = function(params, autoplay) {
 		_offset = 0;
 		_duration = params.duration;
+		_nearEndNotified = false;
 		_audioNativeSrc = params.nativeResource;
-		_audioTranscodeSrc = params.transcodeResource + "&bitrate=" + _settings.transcode.bitrate + "&format=" + _settings.transcode.format;
+		_audioTranscodeSrc = _getTranscodeSrc(params);
 
 		_elems.seek.max = _duration;
 
 		_removeAudioSources();
-		// ! order is important
-		if (_settings.transcode.mode == TranscodeMode.Never || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
-		{
-			_addAudioSource(_audioNativeSrc);
-		}
-		if (_settings.transcode.mode == TranscodeMode.Always || _settings.transcode.mode == TranscodeMode.IfFormatNotSupported)
-		{
-			_addAudioSource(_audioTranscodeSrc);
-		}
+		_addAudioSources(params);
 		_elems.audio.load();
 
 		_setReplayGain(params.replayGain);
@@ -330,6 +362,16 @@ LMS.mediaplayer = function () {
 		}
 	}
 
+	// Same sources as the ones that will be used by loadTrack, so that the server shares the ongoing transcode
+	var prefetchTrack = function(params) {
+		_releasePrefetch();
+
+		_prefetchAudio = new Audio();
+		_prefetchAudio.preload = "auto";
+		_addAudioSources(params, _prefetchAudio);
+		_prefetchAudio.load();
+	}
+
 	var stop = function() {
 		_elems.audio.pause();
 	}
@@ -345,6 +387,7 @@ LMS.mediaplayer = function () {
 	return {
 		init: init,
 		loadTrack: loadTrack,
+		prefetchTrack: prefetchTrack,
 		stop: stop,
 		setSettings: setSettings,
 	};
@@ -19,10 +19,14 @@
 
 #include "AuthTokenService.hpp"
 
+#include <vector>
+
 #include <Wt/Auth/HashFunction.h>
 #include <Wt/Auth/PasswordStrengthValidator.h>
+#include <Wt/Dbo/Exception.h>
 #include <Wt/WRandom.h>
 
+#include "database/Db.hpp"
 #include "database/Session.hpp"
 #include "database/User.hpp"
 #include "utils/Exception.hpp"
@@ -30,16 +34,110 @@
 
 namespace Auth {
 
-std::unique_ptr<IAuthTokenService> createAuthTokenService(std::size_t maxThrottlerEntries)
+std::unique_ptr<IAuthTokenService> createAuthTokenService(Database::Db& db, std::size_t maxThrottlerEntries)
 {
-	return std::make_unique<AuthTokenService>(maxThrottlerEntries);
+	return std::make_unique<AuthTokenService>(db, maxThrottlerEntries);
 }
 
 static const Wt::Auth::SHA1HashFunction sha1Function;
 
-AuthTokenService::AuthTokenService(std::size_t maxThrottlerEntries)
-: _loginThrottler {maxThrottlerEntries}
+AuthTokenService::AuthTokenService(Database::Db& db, std::size_t maxThrottlerEntries)
+: _db {db}
+, _loginThrottler {maxThrottlerEntries}
+{
+	_thread = std::thread {[this] { run(); }};
+}
+
+AuthTokenService::~AuthTokenService()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+	}
+	_quitCondition.notify_all();
+
+	_thread.join();
+}
+
+void
+AuthTokenService::setMaxThrottlerEntryCount(std::size_t maxThrottlerEntryCount)
+{
+	_loginThrottler.setMaxEntries(maxThrottlerEntryCount);
+}
+
+void
+AuthTokenService::run()
 {
+	Database::Session session {_db};
+
+	auto nextPurge {std::chrono::steady_clock::now()};
+
+	while (true)
+	{
+		bool quit;
+		{
+			std::unique_lock lock {_mutex};
+			quit = _quitCondition.wait_for(lock, flushPeriod, [this] { return _quit; });
+		}
+
+		try
+		{
+			removeUsedTokens(session);
+
+			if (!quit && std::chrono::steady_clock::now() >= nextPurge)
+			{
+				auto transaction {session.createUniqueTransaction()};
+				Database::AuthToken::removeExpiredTokens(session, Wt::WDateTime::currentDateTime());
+
+				nextPurge = std::chrono::steady_clock::now() + expiredTokensPurgePeriod;
+			}
+		}
+		catch (Wt::Dbo::Exception& e)
+		{
+			LMS_LOG(UI, ERROR) << "Cannot update auth tokens: " << e.what();
+		}
+
+		if (quit)
+			return;
+	}
+}
+
+void
+AuthTokenService::removeUsedTokens(Database::Session& session)
+{
+	std::vector<std::string> usedTokens;
+	{
+		std::scoped_lock lock {_mutex};
+
+		// Removed from the database one period ago: requests that could still have read them are over
+		for (const std::string& secretHash : _removedTokens)
+			_usedTokens.erase(secretHash);
+		_removedTokens.clear();
+
+		usedTokens.assign(std::cbegin(_usedTokens), std::cend(_usedTokens));
+	}
+
+	if (usedTokens.empty())
+		return;
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		for (const std::string& secretHash : usedTokens)
+			Database::AuthToken::removeByValue(session, secretHash);
+	}
+
+	LMS_LOG(UI, DEBUG) << "Removed " << usedTokens.size() << " used auth token(s)";
+
+	_removedTokens = std::move(usedTokens);
+}
+
+bool
+AuthTokenService::markTokenAsUsed(const std::string& secretHash)
+{
+	std::scoped_lock lock {_mutex};
+
+	return _usedTokens.insert(secretHash).second;
 }
 
 std::string
@@ -58,34 +156,31 @@ AuthTokenService::createAuthToken(Database::Session& session, Database::IdType u
 
 	LMS_LOG(UI, DEBUG) << "Created auth token for user '" << user->getLoginName() << "', expiry = " << expiry.toString();
 
-	if (user->getAuthTokensCount() >= 50)
-		Database::AuthToken::removeExpiredTokens(session, Wt::WDateTime::currentDateTime());
-
 	return secret;
 }
 
-static
 std::optional<AuthTokenService::AuthTokenProcessResult::AuthTokenInfo>
-processAuthToken(Database::Session& session, const std::string& secret)
+AuthTokenService::useAuthToken(Database::Session& session, const std::string& secret)
 {
 	const std::string secretHash {sha1Function.compute(secret, {})};
 
-	auto transaction {session.createUniqueTransaction()};
+	std::optional<AuthTokenProcessResult::AuthTokenInfo> res;
+	{
+		// Expired tokens are purged in the background
+		auto transaction {session.createSharedTransaction()};
 
-	Database::AuthToken::pointer authToken {Database::AuthToken::getByValue(session, secretHash)};
-	if (!authToken)
-		return std::nullopt;
+		Database::AuthToken::pointer authToken {Database::AuthToken::getByValue(session, secretHash)};
+		if (!authToken || authToken->getExpiry() < Wt::WDateTime::currentDateTime())
+			return std::nullopt;
 
-	if (authToken->getExpiry() < Wt::WDateTime::currentDateTime())
-	{
-		authToken.remove();
-		return std::nullopt;
-	}
+		LMS_LOG(UI, DEBUG) << "Found auth token for user '" << authToken->getUser()->getLoginName() << "'!";
 
-	LMS_LOG(UI, DEBUG) << "Found auth token for user '" << authToken->getUser()->getLoginName() << "'!";
+		res = AuthTokenProcessResult::AuthTokenInfo {authToken->getUser().id(), authToken->getExpiry()};
+	}
 
-	AuthTokenService::AuthTokenProcessResult::AuthTokenInfo res {authToken->getUser().id(), authToken->getExpiry()};
-	authToken.remove();
+	// Tokens can only be used once
+	if (!markTokenAsUsed(secretHash))
+		return std::nullopt;
 
 	return res;
 }
@@ -95,29 +190,22 @@ AuthTokenService::AuthTokenProcessResult
 AuthTokenService::processAuthToken(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& tokenValue)
 {
 	// Do not waste too much resource on brute force attacks (optim)
-	{
-		std::shared_lock<std::shared_timed_mutex> lock {_mutex};
+	if (_loginThrottler.isClientThrottled(clientAddress))
+		return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
 
-		if (_loginThrottler.isClientThrottled(clientAddress))
-			return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
-	}
+	auto res {useAuthToken(session, tokenValue)};
 
-	auto res {Auth::processAuthToken(session, tokenValue)};
-	{
-		std::unique_lock<std::shared_timed_mutex> lock {_mutex};
-
-		if (_loginThrottler.isClientThrottled(clientAddress))
-			return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
+	if (_loginThrottler.isClientThrottled(clientAddress))
+		return AuthTokenProcessResult {AuthTokenProcessResult::State::Throttled};
 
-		if (!res)
-		{
-			_loginThrottler.onBadClientAttempt(clientAddress);
-			return AuthTokenProcessResult {AuthTokenProcessResult::State::NotFound};
-		}
-
-		_loginThrottler.onGoodClientAttempt(clientAddress);
-		return AuthTokenProcessResult {AuthTokenProcessResult::State::Found, std::move(*res)};
+	if (!res)
+	{
+		_loginThrottler.onBadClientAttempt(clientAddress);
+		return AuthTokenProcessResult {AuthTokenProcessResult::State::NotFound};
 	}
+
+	_loginThrottler.onGoodClientAttempt(clientAddress);
+	return AuthTokenProcessResult {AuthTokenProcessResult::State::Found, std::move(*res)};
 }
 
 
@@ -19,12 +19,20 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
 #include "auth/IAuthTokenService.hpp"
 
 #include "LoginThrottler.hpp"
 
 namespace Database
 {
+	class Db;
 	class Session;
 }
 
@@ -35,7 +43,8 @@ namespace Auth {
 	{
 		public:
 
-			AuthTokenService(std::size_t maxThrottlerEntries);
+			AuthTokenService(Database::Db& db, std::size_t maxThrottlerEntries);
+			~AuthTokenService();
 
 			AuthTokenService(const AuthTokenService&) = delete;
 			AuthTokenService& operator=(const AuthTokenService&) = delete;
@@ -44,11 +53,28 @@ namespace Auth {
 
 			AuthTokenProcessResult	processAuthToken(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& tokenValue) override;
 			std::string		createAuthToken(Database::Session& session, Database::IdType userid, const Wt::WDateTime& expiry) override;
+			void setMaxThrottlerEntryCount(std::size_t maxThrottlerEntryCount) override;
 
 		private:
+			static constexpr std::chrono::seconds flushPeriod {1};
+			static constexpr std::chrono::hours expiredTokensPurgePeriod {1};
+
+			std::optional<AuthTokenProcessResult::AuthTokenInfo> useAuthToken(Database::Session& session, const std::string& secret);
+			bool markTokenAsUsed(const std::string& secretHash);
+			void run();
+			void removeUsedTokens(Database::Session& session);
 
-			std::shared_timed_mutex	_mutex;
+			Database::Db&	_db;
 			LoginThrottler	_loginThrottler;
+
+			// Used tokens are removed from the database in batches, by a background thread
+			// Until then, they are refused using this set
+			std::mutex							_mutex;
+			std::condition_variable				_quitCondition;
+			bool								_quit {};
+			std::unordered_set<std::string>		_usedTokens; // token hashes
+			std::vector<std::string>			_removedTokens; // from the database, during the last flush
+			std::thread							_thread;
 	};
 
 }
@@ -21,8 +21,9 @@
 
 #include "LoginThrottler.hpp"
 
+#include <algorithm>
+
 #include "utils/Logger.hpp"
-#include "utils/Random.hpp"
 
 namespace Auth {
 
@@ -47,17 +48,61 @@ getAddressToThrottle(const boost::asio::ip::address& address)
 	return address.is_v6() ? getAddressWithMask(address.to_v6(), 64) : address;
 }
 
+LoginThrottler::LoginThrottler(std::size_t maxEntries)
+{
+	setMaxEntries(maxEntries);
+}
+
 void
-LoginThrottler::removeOutdatedEntries()
+LoginThrottler::setMaxEntries(std::size_t maxEntries)
 {
-	const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+	const std::size_t maxEntriesPerShard {std::max<std::size_t>((maxEntries + shardCount - 1) / shardCount, 1)};
+	_maxEntriesPerShard = maxEntriesPerShard;
 
-	for (auto it {std::begin(_attemptsInfo)}; it != std::end(_attemptsInfo); )
+	for (Shard& shard : _shards)
 	{
-		if (it->second <= now)
-			it = _attemptsInfo.erase(it);
-		else
-			++it;
+		std::scoped_lock lock {shard.mutex};
+		removeOldestEntries(shard, maxEntriesPerShard);
+	}
+}
+
+LoginThrottler::Shard&
+LoginThrottler::getShard(const boost::asio::ip::address& address)
+{
+	return _shards[std::hash<boost::asio::ip::address>{}(address) % shardCount];
+}
+
+const LoginThrottler::Shard&
+LoginThrottler::getShard(const boost::asio::ip::address& address) const
+{
+	return _shards[std::hash<boost::asio::ip::address>{}(address) % shardCount];
+}
+
+bool
+LoginThrottler::isShardExpired(const Shard& shard, Clock::time_point now)
+{
+	return now.time_since_epoch().count() >= shard.latestExpiry.load(std::memory_order_acquire);
+}
+
+void
+LoginThrottler::removeOutdatedEntries(Shard& shard, Clock::time_point now)
+{
+	// Must be called with the shard lock held
+	while (!shard.entries.empty() && shard.entries.front().expiry <= now)
+	{
+		shard.entriesByAddress.erase(shard.entries.front().address);
+		shard.entries.pop_front();
+	}
+}
+
+void
+LoginThrottler::removeOldestEntries(Shard& shard, std::size_t maxEntries)
+{
+	// Must be called with the shard lock held
+	while (shard.entries.size() > maxEntries)
+	{
+		shard.entriesByAddress.erase(shard.entries.front().address);
+		shard.entries.pop_front();
 	}
 }
 
@@ -65,15 +110,33 @@ void
 LoginThrottler::onBadClientAttempt(const boost::asio::ip::address& address)
 {
 	const boost::asio::ip::address clientAddress {getAddressToThrottle(address)};
+	Shard& shard {getShard(clientAddress)};
 
-	const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+	const Clock::time_point now {Clock::now()};
+	const Clock::time_point expiry {now + throttleDuration};
 
-	if (_attemptsInfo.size() >= _maxEntries)
-		removeOutdatedEntries();
-	if (_attemptsInfo.size() >= _maxEntries)
-		_attemptsInfo.erase(Random::pickRandom(_attemptsInfo));
+	{
+		std::scoped_lock lock {shard.mutex};
 
-	_attemptsInfo[address] = now.addSecs(3);
+		removeOutdatedEntries(shard, now);
+
+		// The delay is constant: the entries stay sorted by expiry
+		auto it {shard.entriesByAddress.find(clientAddress)};
+		if (it != std::cend(shard.entriesByAddress))
+		{
+			shard.entries.splice(std::cend(shard.entries), shard.entries, it->second);
+			it->second->expiry = expiry;
+		}
+		else
+		{
+			removeOldestEntries(shard, _maxEntriesPerShard - 1);
+
+			shard.entries.push_back(Entry {clientAddress, expiry});
+			shard.entriesByAddress.emplace(clientAddress, std::prev(std::end(shard.entries)));
+		}
+
+		shard.latestExpiry.store(expiry.time_since_epoch().count(), std::memory_order_release);
+	}
 
 	LMS_LOG(AUTH, DEBUG) << "Registering bad attempt for '" << clientAddress.to_string() << "'";
 }
@@ -82,20 +145,39 @@ void
 LoginThrottler::onGoodClientAttempt(const boost::asio::ip::address& address)
 {
 	const boost::asio::ip::address clientAddress {getAddressToThrottle(address)};
+	Shard& shard {getShard(clientAddress)};
+
+	// Outdated entries are removed by the next bad attempts anyway
+	if (isShardExpired(shard, Clock::now()))
+		return;
+
+	std::scoped_lock lock {shard.mutex};
 
-	_attemptsInfo.erase(clientAddress);
+	auto it {shard.entriesByAddress.find(clientAddress)};
+	if (it == std::cend(shard.entriesByAddress))
+		return;
+
+	shard.entries.erase(it->second);
+	shard.entriesByAddress.erase(it);
 }
 
 bool
 LoginThrottler::isClientThrottled(const boost::asio::ip::address& address) const
 {
 	const boost::asio::ip::address clientAddress {getAddressToThrottle(address)};
+	const Shard& shard {getShard(clientAddress)};
+
+	const Clock::time_point now {Clock::now()};
+	if (isShardExpired(shard, now))
+		return false;
+
+	std::scoped_lock lock {shard.mutex};
 
-	auto it {_attemptsInfo.find(clientAddress)};
-	if (it == _attemptsInfo.end())
+	auto it {shard.entriesByAddress.find(clientAddress)};
+	if (it == std::cend(shard.entriesByAddress))
 		return false;
 
-	return it->second > Wt::WDateTime::currentDateTime();
+	return it->second->expiry > now;
 }
 
 } // Auth
@@ -19,34 +19,60 @@
 
 #pragma once
 
-#include <shared_mutex>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
-#include <Wt/WDateTime.h>
-
 #include "utils/NetAddress.hpp"
 #include "utils/Exception.hpp"
 
 namespace Auth {
 
+// Thread safe: clients are spread over shards, each having its own lock
 class LoginThrottler
 {
 	public:
-		LoginThrottler(std::size_t maxEntries) : _maxEntries {maxEntries} {}
+		LoginThrottler(std::size_t maxEntries);
+
+		// Extra entries are removed at once, oldest first
+		void setMaxEntries(std::size_t maxEntries);
 
-		// user must lock these calls to avoid races
 		bool isClientThrottled(const boost::asio::ip::address& address) const;
 		void onBadClientAttempt(const boost::asio::ip::address& address);
 		void onGoodClientAttempt(const boost::asio::ip::address& address);
 
 	private:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr std::size_t shardCount {16};
+		static constexpr std::chrono::seconds throttleDuration {3};
+
+		struct Entry
+		{
+			boost::asio::ip::address	address;
+			Clock::time_point			expiry;
+		};
 
-		void removeOutdatedEntries();
+		struct Shard
+		{
+			mutable std::mutex mutex;
+			std::list<Entry> entries; // by expiry, oldest first
+			std::unordered_map<boost::asio::ip::address, std::list<Entry>::iterator> entriesByAddress;
+			std::atomic<Clock::rep> latestExpiry {}; // lock free check: no client of this shard is throttled past this point
+		};
 
-		const std::size_t _maxEntries;
+		Shard& getShard(const boost::asio::ip::address& address);
+		const Shard& getShard(const boost::asio::ip::address& address) const;
+		static bool isShardExpired(const Shard& shard, Clock::time_point now);
+		static void removeOutdatedEntries(Shard& shard, Clock::time_point now);
+		static void removeOldestEntries(Shard& shard, std::size_t maxEntries);
 
-		std::unordered_map<boost::asio::ip::address, Wt::WDateTime>	_attemptsInfo;
+		std::atomic<std::size_t> _maxEntriesPerShard;
+		std::array<Shard, shardCount> _shards;
 };
 
 
@@ -19,27 +19,95 @@
 
 #include "PasswordService.hpp"
 
+#include <algorithm>
+#include <optional>
+#include <thread>
+
 #include <Wt/Auth/HashFunction.h>
 #include <Wt/Auth/PasswordStrengthValidator.h>
+#include <Wt/Utils.h>
 #include <Wt/WRandom.h>
 
 #include "database/Session.hpp"
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #ifdef LMS_SUPPORT_PAM
 #include "pam/PAM.hpp"
 #endif
 
 namespace Auth {
 
-std::unique_ptr<IPasswordService> createPasswordService(std::size_t maxThrottlerEntries)
+static constexpr std::chrono::minutes verifiedCredentialTTL {5};
+static constexpr std::size_t verifiedCredentialMaxCount {1000};
+
+static Metrics::Counter& matchCount {Metrics::getCounter("lms_auth_password_matches_total", "Number of successful password checks")};
+static Metrics::Counter& mismatchCount {Metrics::getCounter("lms_auth_password_mismatches_total", "Number of failed password checks")};
+static Metrics::Counter& throttledCount {Metrics::getCounter("lms_auth_password_throttled_total", "Number of password checks rejected because of throttling")};
+static Metrics::Histogram& hashCheckDuration {Metrics::getHistogram("lms_auth_password_hash_check_duration_seconds", "Time spent checking passwords that were not recently verified (bcrypt, PAM)")};
+
+std::unique_ptr<IPasswordService> createPasswordService(std::size_t maxThrottlerEntries, std::size_t maxConcurrentChecks, std::size_t maxPendingChecks)
 {
-	return std::make_unique<PasswordService>(maxThrottlerEntries);
+	return std::make_unique<PasswordService>(maxThrottlerEntries, maxConcurrentChecks, maxPendingChecks);
 }
 
-PasswordService::PasswordService(std::size_t maxThrottlerEntries)
+PasswordService::PasswordService(std::size_t maxThrottlerEntries, std::size_t maxConcurrentChecks, std::size_t maxPendingChecks)
 : _loginThrottler{maxThrottlerEntries}
+, _verifiedCredentialSecret {Wt::WRandom::generateId(32)}
+{
+	setCheckLimits(maxConcurrentChecks, maxPendingChecks);
+}
+
+void
+PasswordService::setMaxThrottlerEntryCount(std::size_t maxThrottlerEntryCount)
 {
+	_loginThrottler.setMaxEntries(maxThrottlerEntryCount);
+}
+
+void
+PasswordService::setCheckLimits(std::size_t maxConcurrentChecks, std::size_t maxPendingChecks)
+{
+	{
+		std::scoped_lock lock {_checkMutex};
+
+		_maxConcurrentChecks = maxConcurrentChecks > 0 ? maxConcurrentChecks : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+		_maxPendingChecks = maxPendingChecks;
+
+		LMS_LOG(AUTH, INFO) << "Checking at most " << _maxConcurrentChecks << " password(s) at the same time, " << _maxPendingChecks << " more can wait";
+	}
+
+	// Waiting checks may now be allowed to run
+	_checkCondition.notify_all();
+}
+
+bool
+PasswordService::acquireCheckSlot()
+{
+	std::unique_lock lock {_checkMutex};
+
+	if (_ongoingCheckCount >= _maxConcurrentChecks)
+	{
+		// Reject quickly rather than having all the HTTP threads waiting here
+		if (_pendingCheckCount >= _maxPendingChecks)
+			return false;
+
+		_pendingCheckCount++;
+		_checkCondition.wait(lock, [this] { return _ongoingCheckCount < _maxConcurrentChecks; });
+		_pendingCheckCount--;
+	}
+
+	_ongoingCheckCount++;
+	return true;
+}
+
+void
+PasswordService::releaseCheckSlot()
+{
+	{
+		std::scoped_lock lock {_checkMutex};
+		_ongoingCheckCount--;
+	}
+	_checkCondition.notify_one();
 }
 
 bool
@@ -60,30 +128,36 @@ PasswordService::isAuthModeSupported(Database::User::AuthMode authMode) const
 	return false;
 }
 
-static
-bool
-checkUserPassword(Database::Session& session, const std::string& loginName, const std::string& password)
+struct UserCredentials
 {
 	Database::User::AuthMode authMode;
 	Database::User::PasswordHash passwordHash;
-	{
-		auto transaction {session.createSharedTransaction()};
+};
 
-		const Database::User::pointer user {Database::User::getByLoginName(session, loginName)};
-		if (!user)
-			return false;
+static
+std::optional<UserCredentials>
+getUserCredentials(Database::Session& session, const std::string& loginName)
+{
+	auto transaction {session.createSharedTransaction()};
 
-		authMode = user->getAuthMode();
-		passwordHash = user->getPasswordHash();
-	}
+	const Database::User::pointer user {Database::User::getByLoginName(session, loginName)};
+	if (!user)
+		return std::nullopt;
 
-	switch (authMode)
+	return UserCredentials {user->getAuthMode(), user->getPasswordHash()};
+}
+
+static
+bool
+checkUserPassword(const UserCredentials& credentials, const std::string& loginName, const std::string& password)
+{
+	switch (credentials.authMode)
 	{
 		case Database::User::AuthMode::Internal:
 		{
 			LMS_LOG(AUTH, DEBUG) << "Checking internal password for user '" << loginName << "'";
 			const Wt::Auth::BCryptHashFunction hashFunc {6}; // TODO parametrize this
-			return hashFunc.verify(password, passwordHash.salt, passwordHash.hash);
+			return hashFunc.verify(password, credentials.passwordHash.salt, credentials.passwordHash.hash);
 		}
 
 		case Database::User::AuthMode::PAM:
@@ -99,33 +173,121 @@ checkUserPassword(Database::Session& session, const std::string& loginName, cons
 
 PasswordService::PasswordCheckResult
 PasswordService::checkUserPassword(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password)
+{
+	const PasswordCheckResult result {doCheckUserPassword(session, clientAddress, loginName, password)};
+	switch (result)
+	{
+		case PasswordCheckResult::Match:		matchCount.inc(); break;
+		case PasswordCheckResult::Mismatch:		mismatchCount.inc(); break;
+		case PasswordCheckResult::Throttled:	throttledCount.inc(); break;
+	}
+
+	return result;
+}
+
+PasswordService::PasswordCheckResult
+PasswordService::doCheckUserPassword(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password)
 {
 	// Do not waste too much resource on brute force attacks (optim)
+	if (_loginThrottler.isClientThrottled(clientAddress))
+		return PasswordCheckResult::Throttled;
+
+	const std::optional<UserCredentials> credentials {getUserCredentials(session, loginName)};
+
+	bool match {};
+	bool alreadyVerified {};
+	std::string credentialKey;
+	if (credentials)
+	{
+		credentialKey = computeVerifiedCredentialKey(clientAddress, loginName, password, credentials->passwordHash);
+		alreadyVerified = isCredentialVerified(credentialKey);
+		if (alreadyVerified)
+			match = true;
+		else
+		{
+			if (!acquireCheckSlot())
+			{
+				LMS_LOG(AUTH, INFO) << "Too many password checks in progress, rejecting login of '" << loginName << "'";
+				return PasswordCheckResult::Throttled;
+			}
+
+			try
+			{
+				const Metrics::ScopedTimer timer {hashCheckDuration};
+				match = Auth::checkUserPassword(*credentials, loginName, password);
+			}
+			catch (...)
+			{
+				releaseCheckSlot();
+				throw;
+			}
+			releaseCheckSlot();
+		}
+	}
+
+	if (_loginThrottler.isClientThrottled(clientAddress))
+		return PasswordCheckResult::Throttled;
+
+	if (!match)
 	{
-		std::shared_lock<std::shared_timed_mutex> lock {_mutex};
+		_loginThrottler.onBadClientAttempt(clientAddress);
+		return PasswordCheckResult::Mismatch;
+	}
 
-		if (_loginThrottler.isClientThrottled(clientAddress))
-			return PasswordCheckResult::Throttled;
+	_loginThrottler.onGoodClientAttempt(clientAddress);
+	// Do not extend the expiry: external (PAM) password changes are only caught this way
+	if (!alreadyVerified)
+	{
+		std::unique_lock lock {_mutex};
+		onCredentialVerified(credentialKey);
 	}
+	return PasswordCheckResult::Match;
+}
 
-	const bool match {Auth::checkUserPassword(session, loginName, password)};
+std::string
+PasswordService::computeVerifiedCredentialKey(const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password, const Database::User::PasswordHash& passwordHash) const
+{
+	// Keyed hash: the cleartext password is never kept in memory
+	std::string text;
+	for (const std::string& field : {clientAddress.to_string(), loginName, password, passwordHash.salt, passwordHash.hash})
 	{
-		std::unique_lock<std::shared_timed_mutex> lock {_mutex};
+		text += std::to_string(field.size());
+		text += ':';
+		text += field;
+	}
 
-		if (_loginThrottler.isClientThrottled(clientAddress))
-			return PasswordCheckResult::Throttled;
+	return Wt::Utils::hmac_sha1(text, _verifiedCredentialSecret);
+}
 
-		if (match)
-		{
-			_loginThrottler.onGoodClientAttempt(clientAddress);
-			return PasswordCheckResult::Match;
-		}
-		else
+bool
+PasswordService::isCredentialVerified(const std::string& credentialKey)
+{
+	std::shared_lock lock {_mutex};
+
+	auto it {_verifiedCredentials.find(credentialKey)};
+	return it != std::cend(_verifiedCredentials) && it->second > std::chrono::steady_clock::now();
+}
+
+void
+PasswordService::onCredentialVerified(const std::string& credentialKey)
+{
+	// Must be called with the lock held
+	if (_verifiedCredentials.size() >= verifiedCredentialMaxCount)
+	{
+		const auto now {std::chrono::steady_clock::now()};
+		for (auto it {std::begin(_verifiedCredentials)}; it != std::end(_verifiedCredentials);)
 		{
-			_loginThrottler.onBadClientAttempt(clientAddress);
-			return PasswordCheckResult::Mismatch;
+			if (it->second <= now)
+				it = _verifiedCredentials.erase(it);
+			else
+				++it;
 		}
+
+		if (_verifiedCredentials.size() >= verifiedCredentialMaxCount)
+			_verifiedCredentials.clear();
 	}
+
+	_verifiedCredentials[credentialKey] = std::chrono::steady_clock::now() + verifiedCredentialTTL;
 }
 
 Database::User::PasswordHash
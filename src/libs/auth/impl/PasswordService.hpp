@@ -19,8 +19,15 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
 #include "auth/IPasswordService.hpp"
+#include "utils/ProfiledMutex.hpp"
 
 #include "LoginThrottler.hpp"
 
@@ -36,7 +43,7 @@ namespace Auth {
 	{
 		public:
 
-			PasswordService(std::size_t maxThrottlerEntries);
+			PasswordService(std::size_t maxThrottlerEntries, std::size_t maxConcurrentChecks, std::size_t maxPendingChecks);
 
 			PasswordService(const PasswordService&) = delete;
 			PasswordService& operator=(const PasswordService&) = delete;
@@ -49,9 +56,31 @@ namespace Auth {
 			PasswordCheckResult		checkUserPassword(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password) override;
 			Database::User::PasswordHash	hashPassword(const std::string& password) const override;
 			bool				evaluatePasswordStrength(const std::string& loginName, const std::string& password) const override;
+			void setMaxThrottlerEntryCount(std::size_t maxThrottlerEntryCount) override;
+			void setCheckLimits(std::size_t maxConcurrentChecks, std::size_t maxPendingChecks) override;
+
+			PasswordCheckResult		doCheckUserPassword(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password);
+			std::string computeVerifiedCredentialKey(const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password, const Database::User::PasswordHash& passwordHash) const;
+			bool isCredentialVerified(const std::string& credentialKey);
+			void onCredentialVerified(const std::string& credentialKey);
+			bool acquireCheckSlot();
+			void releaseCheckSlot();
 
-			std::shared_timed_mutex	_mutex;
+			ProfiledSharedMutex	_mutex {"auth_password_service"};
 			LoginThrottler	_loginThrottler;
+
+			// Recently verified credentials, to avoid hashing the password again on each request
+			// The keys also depend on the stored password hash: a password change invalidates them
+			const std::string	_verifiedCredentialSecret;
+			std::unordered_map<std::string, std::chrono::steady_clock::time_point> _verifiedCredentials; // key -> expiry
+
+			// Bounds the number of HTTP threads busy checking passwords (bcrypt, PAM)
+			std::mutex				_checkMutex;
+			std::size_t				_maxConcurrentChecks {};
+			std::size_t				_maxPendingChecks {};
+			std::condition_variable	_checkCondition;
+			std::size_t				_ongoingCheckCount {};
+			std::size_t				_pendingCheckCount {};
 	};
 
 }
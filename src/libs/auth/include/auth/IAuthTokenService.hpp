@@ -30,6 +30,7 @@
 
 namespace Database
 {
+	class Db;
 	class Session;
 }
 
@@ -64,9 +65,12 @@ namespace Auth {
 			// Removed if found
 			virtual AuthTokenProcessResult	processAuthToken(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& tokenValue) = 0;
 			virtual std::string		createAuthToken(Database::Session& session, Database::IdType userid, const Wt::WDateTime& expiry) = 0;
+
+			// Can be changed while running
+			virtual void setMaxThrottlerEntryCount(std::size_t maxThrottlerEntryCount) = 0;
 	};
 
-	std::unique_ptr<IAuthTokenService> createAuthTokenService(std::size_t maxThrottlerEntryCount);
+	std::unique_ptr<IAuthTokenService> createAuthTokenService(Database::Db& db, std::size_t maxThrottlerEntryCount);
 
 }
 
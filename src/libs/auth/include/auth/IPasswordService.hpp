@@ -54,9 +54,15 @@ namespace Auth {
 			virtual PasswordCheckResult	checkUserPassword(Database::Session& session, const boost::asio::ip::address& clientAddress, const std::string& loginName, const std::string& password) = 0;
 			virtual Database::User::PasswordHash	hashPassword(const std::string& password) const = 0;
 			virtual bool				evaluatePasswordStrength(const std::string& loginName, const std::string& password) const = 0;
+
+			// Can be changed while running, same meaning as the createPasswordService parameters
+			virtual void setMaxThrottlerEntryCount(std::size_t maxThrottlerEntryCount) = 0;
+			virtual void setCheckLimits(std::size_t maxConcurrentChecks, std::size_t maxPendingChecks) = 0;
 	};
 
-	std::unique_ptr<IPasswordService> createPasswordService(std::size_t maxThrottlerEntryCount);
+	// maxConcurrentChecks: 0 means the number of hardware threads
+	// when maxConcurrentChecks checks are in progress, maxPendingChecks other ones can wait, the next ones are rejected as throttled
+	std::unique_ptr<IPasswordService> createPasswordService(std::size_t maxThrottlerEntryCount, std::size_t maxConcurrentChecks, std::size_t maxPendingChecks);
 
 }
 
@@ -50,7 +50,7 @@ MediaFileException::MediaFileException(int avError)
 }
 
 
-MediaFile::MediaFile(const std::filesystem::path& p)
+MediaFile::MediaFile(const std::filesystem::path& p, bool findStreamInfo)
 : _p {p}
 {
 	int error = avformat_open_input(&_context, _p.string().c_str(), nullptr, nullptr);
@@ -60,6 +60,10 @@ MediaFile::MediaFile(const std::filesystem::path& p)
 		throw MediaFileException(error);
 	}
 
+	// Attached pictures are read along with the file header
+	if (!findStreamInfo)
+		return;
+
 	error = avformat_find_stream_info(_context, nullptr);
 	if (error < 0)
 	{
@@ -147,7 +151,7 @@ MediaFile::getStreamInfo() const
 		if (avstream->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
 			continue;
 
-		res.push_back( {i, static_cast<std::size_t>(avstream->codecpar->bit_rate)} );
+		res.push_back( {i, static_cast<std::size_t>(avstream->codecpar->bit_rate), avcodec_get_name(avstream->codecpar->codec_id)} );
 	}
 
 	return res;
@@ -169,6 +173,18 @@ MediaFile::getBestStream() const
 	return res;
 }
 
+std::optional<StreamInfo>
+MediaFile::getStreamInfo(std::size_t streamId) const
+{
+	for (StreamInfo& streamInfo : getStreamInfo())
+	{
+		if (streamInfo.id == streamId)
+			return std::move(streamInfo);
+	}
+
+	return std::nullopt;
+}
+
 bool
 MediaFile::hasAttachedPictures(void) const
 {
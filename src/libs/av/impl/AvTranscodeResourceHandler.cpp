@@ -19,41 +19,243 @@
 
 #include "AvTranscodeResourceHandler.hpp"
 
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "av/AvInfo.hpp"
+#include "utils/FileResourceHandlerCreator.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+#include "utils/Tracing.hpp"
+
 namespace Av
 {
 
+	namespace
+	{
+		std::uint64_t
+		getOutputSize(std::chrono::milliseconds duration, std::size_t bitrate)
+		{
+			return static_cast<std::uint64_t>(std::max<std::chrono::milliseconds::rep>(duration.count(), 0)) * bitrate / (8 * 1000);
+		}
+
+		std::chrono::milliseconds
+		getOutputDuration(std::uint64_t size, std::size_t bitrate)
+		{
+			return std::chrono::milliseconds {static_cast<std::chrono::milliseconds::rep>(size * 8 * 1000 / bitrate)};
+		}
+	}
+
 	std::unique_ptr<IResourceHandler>
-	createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
+	createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeClient& client, std::optional<std::chrono::milliseconds> trackDuration)
 	{
-		return std::make_unique<TranscodeResourceHandler>(trackPath, parameters);
+		return std::make_unique<TranscodeResourceHandler>(trackPath, parameters, client, trackDuration);
 	}
 
 	// TODO set some nice HTTP return code
 
-	TranscodeResourceHandler::TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
-		: _transcoder {trackPath, parameters}
+	TranscodeResourceHandler::TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeClient& client, std::optional<std::chrono::milliseconds> trackDuration)
+		: _trackPath {trackPath}
+		, _parameters {parameters}
+		, _client {client}
+		, _trackDuration {trackDuration}
 	{
-		_transcoder.start();
+		if (ITranscodeCache* cache {Service<ITranscodeCache>::get()})
+		{
+			Tracing::Span span {"transcode.cache_lookup"};
+			_cachedFile = cache->find(trackPath, _parameters);
+			span.setAttribute("hit", _cachedFile ? "true" : "false");
+			if (_cachedFile)
+			{
+				// Served as a regular file, with range support
+				_cachedFileResourceHandler = createFileResourceHandler(*_cachedFile);
+			}
+		}
 	}
 
 	void
-	TranscodeResourceHandler::processRequest(const Wt::Http::Request& /*request*/, Wt::Http::Response& response)
+	TranscodeResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 	{
-		response.setMimeType(_transcoder.getOutputMimeType());
+		response.setMimeType(formatToMimetype(_parameters.format));
+
+		if (_cachedFileResourceHandler)
+		{
+			_cachedFileResourceHandler->processRequest(request, response);
+			return;
+		}
+
+		if (!_transcode)
+		{
+			startTranscode(request, response);
+			if (_isFinished)
+				return;
+		}
+
+		std::size_t maxSize {_chunkSize};
+		if (_remainingSize)
+			maxSize = std::min<std::uint64_t>(maxSize, *_remainingSize);
+		if (const std::optional<std::uint64_t> pacingLimit {getPacingLimit()})
+			maxSize = std::min<std::uint64_t>(maxSize, *pacingLimit > _offset ? *pacingLimit - _offset : 0);
 
-		if (!_transcoder.isComplete())
+		std::size_t writtenSize {_transcode->write(_offset, response.out(), maxSize)};
+		_offset += writtenSize;
+
+		if (_remainingSize)
 		{
-			std::vector<unsigned char> buffer;
+			// The estimated size must be honored
+			if (writtenSize == 0 && _transcode->isComplete(_offset))
+			{
+				const std::vector<char> padding(maxSize);
+				response.out().write(padding.data(), padding.size());
+				writtenSize = padding.size();
+			}
 
-			_transcoder.process(buffer, _chunkSize);
-			response.out().write(reinterpret_cast<const char *>(&buffer[0]), buffer.size());
+			*_remainingSize -= writtenSize;
+			if (*_remainingSize == 0)
+				_isFinished = true;
 		}
 	}
 
 	bool
 	TranscodeResourceHandler::isFinished() const
 	{
-		return _transcoder.isComplete();
+		if (_cachedFileResourceHandler)
+			return _cachedFileResourceHandler->isFinished();
+
+		if (_isFinished)
+			return true;
+
+		return !_remainingSize && _transcode->isComplete(_offset);
+	}
+
+	bool
+	TranscodeResourceHandler::isWaitingForData() const
+	{
+		if (_cachedFileResourceHandler)
+			return _cachedFileResourceHandler->isWaitingForData();
+
+		return isPaced() || !_transcode->isDataAvailable(_offset);
+	}
+
+	void
+	TranscodeResourceHandler::notifyWhenDataAvailable(std::function<void()> callback)
+	{
+		if (_cachedFileResourceHandler)
+		{
+			_cachedFileResourceHandler->notifyWhenDataAvailable(std::move(callback));
+			return;
+		}
+
+		// The transcode is not asked for more data meanwhile
+		if (isPaced())
+		{
+			TranscodeBroker::getInstance().callAt(getPacingResumeTime(), std::move(callback));
+			return;
+		}
+
+		_transcode->notifyWhenDataAvailable(_offset, std::move(callback));
 	}
-}
 
+	void
+	TranscodeResourceHandler::startTranscode(const Wt::Http::Request& request, Wt::Http::Response& response)
+	{
+		const Tracing::Span span {"transcode.start"};
+
+		TranscodeParameters parameters {_parameters};
+
+		if (const std::optional<std::uint64_t> estimatedSize {estimateOutputSize()})
+		{
+			response.addHeader("Accept-Ranges", "bytes");
+
+			const Wt::Http::Request::ByteRangeSpecifier ranges {request.getRanges(*estimatedSize)};
+			if (!ranges.isSatisfiable())
+			{
+				std::ostringstream contentRange;
+				contentRange << "bytes */" << *estimatedSize;
+				response.setStatus(416); // Requested range not satisfiable
+				response.addHeader("Content-Range", contentRange.str());
+				_isFinished = true;
+				return;
+			}
+
+			if (ranges.size() == 1)
+			{
+				const std::uint64_t firstByte {ranges[0].firstByte()};
+				const std::uint64_t lastByte {ranges[0].lastByte()};
+
+				// Restart the transcode at the time matching the first byte
+				const std::chrono::milliseconds rangeOffset {static_cast<std::chrono::milliseconds::rep>(firstByte * 8 * 1000 / _parameters.bitrate)};
+				parameters.offset = _parameters.offset.value_or(std::chrono::milliseconds {0}) + rangeOffset;
+
+				std::ostringstream contentRange;
+				contentRange << "bytes " << firstByte << "-" << lastByte << "/" << *estimatedSize;
+				response.setStatus(206);
+				response.addHeader("Content-Range", contentRange.str());
+
+				_remainingSize = lastByte + 1 - firstByte;
+
+				LMS_LOG(TRANSCODE, DEBUG) << "Range " << firstByte << "-" << lastByte << " requested, transcoding from " << parameters.offset->count() << " ms";
+			}
+			else
+				_remainingSize = *estimatedSize;
+
+			response.setContentLength(*_remainingSize);
+		}
+
+		_transcode = TranscodeBroker::getInstance().getTranscode(_trackPath, parameters, _client);
+		_startTime = std::chrono::steady_clock::now();
+	}
+
+	std::optional<std::uint64_t>
+	TranscodeResourceHandler::estimateOutputSize() const
+	{
+		// Only MP3 outputs are encoded at a constant bitrate
+		if (_parameters.format != Format::MP3)
+			return std::nullopt;
+
+		try
+		{
+			const std::chrono::milliseconds trackDuration {_trackDuration ? *_trackDuration : MediaFile {_trackPath}.getDuration()};
+			const std::chrono::milliseconds duration {trackDuration - _parameters.offset.value_or(std::chrono::milliseconds {0})};
+			if (duration <= std::chrono::milliseconds {0})
+				return std::nullopt;
+
+			return getOutputSize(duration, _parameters.bitrate);
+		}
+		catch (const AvException& e)
+		{
+			LMS_LOG(TRANSCODE, ERROR) << "Cannot estimate transcode size of '" << _trackPath.string() << "': " << e.what();
+			return std::nullopt;
+		}
+	}
+
+	std::optional<std::uint64_t>
+	TranscodeResourceHandler::getPacingLimit() const
+	{
+		// Offline sync and the like want the output as fast as possible
+		const std::chrono::seconds leadTime {TranscodeBroker::getInstance().getLeadTime()};
+		if (_client.priority != TranscodePriority::Interactive || leadTime.count() == 0 || _parameters.bitrate == 0)
+			return std::nullopt;
+
+		const auto elapsed {std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime)};
+		return getOutputSize(elapsed + leadTime, _parameters.bitrate);
+	}
+
+	bool
+	TranscodeResourceHandler::isPaced() const
+	{
+		const std::optional<std::uint64_t> pacingLimit {getPacingLimit()};
+		return pacingLimit && *pacingLimit <= _offset;
+	}
+
+	std::chrono::steady_clock::time_point
+	TranscodeResourceHandler::getPacingResumeTime() const
+	{
+		// Resume once a quarter of the lead time can be sent, rather than waking up for each byte
+		const std::chrono::seconds leadTime {TranscodeBroker::getInstance().getLeadTime()};
+		const std::chrono::milliseconds pacingStep {std::max<std::chrono::milliseconds>(std::chrono::seconds {1}, leadTime / 4)};
+
+		return _startTime + getOutputDuration(_offset, _parameters.bitrate) - leadTime + pacingStep;
+	}
+}
@@ -19,26 +19,63 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <optional>
+
 #include "av/AvTranscoder.hpp"
+#include "av/ITranscodeCache.hpp"
+#include "utils/ActiveStreamCounter.hpp"
+#include "TranscodeBroker.hpp"
 #include "utils/IResourceHandler.hpp"
 
 namespace Av
 {
 
+	// Serves the cached output if any, otherwise reads the transcode shared with the other listeners of the same output, without blocking
+	// CBR outputs have an estimated length: byte ranges are mapped to time offsets, the output being truncated or padded to match the estimation
+	// Interactive readers are paced: they are sent the output at most the broker lead time ahead of the time elapsed since they started,
+	// so that the transcode (produced on demand) does not run far ahead of the playback and is stopped early if the client goes away
 	class TranscodeResourceHandler final : public IResourceHandler
 	{
 		public:
-			TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters);
+			TranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeClient& client, std::optional<std::chrono::milliseconds> trackDuration);
 
 		private:
 
 			void processRequest(const Wt::Http::Request& request, Wt::Http::Response& reponse) override;
 			bool isFinished() const override;
+			bool isWaitingForData() const override;
+			void notifyWhenDataAvailable(std::function<void()> callback) override;
+
+			void startTranscode(const Wt::Http::Request& request, Wt::Http::Response& response);
+			std::optional<std::uint64_t> estimateOutputSize() const;
+
+			// Pacing, set if paced
+			std::optional<std::uint64_t> getPacingLimit() const;	// output size that may have been sent by now
+			bool isPaced() const;	// limit reached
+			std::chrono::steady_clock::time_point getPacingResumeTime() const;
 
 			static constexpr std::size_t _chunkSize {262144};
 			const std::filesystem::path _trackPath;
-			Transcoder _transcoder;
+			const TranscodeParameters _parameters;
+			const TranscodeClient _client;
+			const std::optional<std::chrono::milliseconds> _trackDuration;
+
+			// Cache hit
+			ITranscodeCache::CachedFile _cachedFile;
+			std::unique_ptr<IResourceHandler> _cachedFileResourceHandler;
+
+			// Cache miss
+			std::shared_ptr<SharedTranscode> _transcode;
+			std::size_t _offset {};
+			std::optional<std::uint64_t> _remainingSize; // set if the content length has been estimated
+			std::chrono::steady_clock::time_point _startTime;
+			bool _isFinished {};
+
+			ActiveStreamCounter _activeStreamCounter;
 	};
 }
 
@@ -19,13 +19,23 @@
 
 #include "av/AvTranscoder.hpp"
 
+#include <sys/resource.h>
+#include <sys/wait.h>
+
 #include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
 #include <mutex>
+#include <sstream>
 
 #include "av/AvInfo.hpp"
+#include "LibavTranscoder.hpp"
+#include "utils/CpuAffinity.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Path.hpp"
 #include "utils/Logger.hpp"
+#include "utils/SamplingProfiler.hpp"
 #include "utils/Service.hpp"
 
 namespace Av {
@@ -33,7 +43,21 @@ namespace Av {
 #define LOG(sev)	LMS_LOG(TRANSCODE, sev) << "[" << _id << "] - "
 
 static std::atomic<size_t>	globalId {};
+
+static
+std::string
+durationToSecondsString(std::chrono::milliseconds duration)
+{
+	std::ostringstream oss;
+	oss << duration.count() / 1000 << "." << std::setfill('0') << std::setw(3) << duration.count() % 1000;
+
+	return oss.str();
+}
+
 static std::filesystem::path	ffmpegPath;
+static bool			useLibav;
+static int			niceness;
+static CpuAffinity::CpuSet	cpuSet;
 
 void
 Transcoder::init()
@@ -41,6 +65,59 @@ Transcoder::init()
 	ffmpegPath = Service<IConfig>::get()->getPath("ffmpeg-file", "/usr/bin/ffmpeg");
 	if (!std::filesystem::exists(ffmpegPath))
 		throw LmsException {"File '" + ffmpegPath.string() + "' does not exist!"};
+
+	// Transcodes must not starve the rest of the server
+	niceness = static_cast<int>(Service<IConfig>::get()->getULong("transcode-nice", 10));
+	// Kept away from the http server threads
+	cpuSet = CpuAffinity::parseCpuSet(Service<IConfig>::get()->getString("transcode-cpu-set", ""));
+
+	// ffmpeg is still used as a fallback if the in process transcoding fails to start
+	const std::string backend {Service<IConfig>::get()->getString("transcode-backend", "libav")};
+	if (backend == "libav")
+	{
+		useLibav = true;
+		LibavTranscoder::init(Service<IConfig>::get()->getULong("transcode-worker-count", 0), niceness, cpuSet);
+	}
+	else if (backend != "ffmpeg")
+		throw LmsException {"Unknown transcode backend '" + backend + "'"};
+}
+
+std::string
+computeTranscodeKey(const std::filesystem::path& file, const TranscodeParameters& parameters)
+{
+	std::ostringstream oss;
+	oss << static_cast<int>(parameters.format)
+		<< "/" << parameters.bitrate
+		<< "/" << (parameters.stream ? std::to_string(*parameters.stream) : "auto")
+		<< "/" << (parameters.offset ? parameters.offset->count() : 0)
+		<< "/" << (parameters.duration ? parameters.duration->count() : 0)
+		<< "/" << parameters.stripMetadata
+		<< "/" << parameters.keepTimestamps
+		<< "/" << file.string();
+
+	return oss.str();
+}
+
+bool
+isStreamCopyable(const StreamInfo& stream, const TranscodeParameters& parameters)
+{
+	// Segments must be cut exactly where requested, which requires re-encoding
+	if (parameters.keepTimestamps)
+		return false;
+
+	// Unknown bitrate (some VBR files): do not take the risk of sending more than requested
+	if (stream.bitrate == 0 || stream.bitrate > parameters.bitrate)
+		return false;
+
+	switch (parameters.format)
+	{
+		case Format::MP3:		return stream.codecName == "mp3";
+		case Format::OGG_OPUS:
+		case Format::MATROSKA_OPUS:	return stream.codecName == "opus";
+		case Format::OGG_VORBIS:
+		case Format::WEBM_VORBIS:	return stream.codecName == "vorbis";
+		default:			return false;
+	}
 }
 
 Transcoder::Transcoder(const std::filesystem::path& filePath, const TranscodeParameters& parameters)
@@ -54,6 +131,8 @@ Transcoder::Transcoder(const std::filesystem::path& filePath, const TranscodePar
 bool
 Transcoder::start()
 {
+	const SamplingProfiler::ScopedSubsystem profilerSubsystem {SamplingProfiler::Subsystem::Transcode};
+
 	try
 	{
 		if (!std::filesystem::exists(_filePath))
@@ -76,7 +155,23 @@ Transcoder::start()
 		return false;
 	}
 
-	LOG(INFO) << "Transcoding file '" << _filePath.string() << "'";
+	// Only the container differs: copying the stream saves the decoding and encoding
+	const bool copyStream {isSourceStreamCopyable()};
+
+	if (useLibav && !copyStream)
+	{
+		_libavTranscoder = std::make_unique<LibavTranscoder>(_filePath, _parameters, _id);
+		if (_libavTranscoder->start())
+		{
+			_outputMimeType = formatToMimetype(_parameters.format);
+			return true;
+		}
+
+		LOG(INFO) << "Falling back to ffmpeg";
+		_libavTranscoder.reset();
+	}
+
+	LOG(INFO) << (copyStream ? "Remuxing" : "Transcoding") << " file '" << _filePath.string() << "'";
 
 	std::vector<std::string> args;
 
@@ -88,17 +183,29 @@ Transcoder::start()
 	args.emplace_back("quiet");
 	args.emplace_back("-nostdin");
 
-	// input Offset
+	// input Offset, in seconds
 	if (_parameters.offset)
 	{
 		args.emplace_back("-ss");
-		args.emplace_back(std::to_string((*_parameters.offset).count()));
+		args.emplace_back(durationToSecondsString(*_parameters.offset));
 	}
 
 	// Input file
 	args.emplace_back("-i");
 	args.emplace_back(_filePath.string());
 
+	if (_parameters.duration)
+	{
+		args.emplace_back("-t");
+		args.emplace_back(durationToSecondsString(*_parameters.duration));
+	}
+
+	if (_parameters.keepTimestamps && _parameters.offset)
+	{
+		args.emplace_back("-output_ts_offset");
+		args.emplace_back(durationToSecondsString(*_parameters.offset));
+	}
+
 	// Stream mapping, if set
 	if (_parameters.stream)
 	{
@@ -116,44 +223,38 @@ Transcoder::start()
 	// Skip video flows (including covers)
 	args.emplace_back("-vn");
 
-	// Output bitrates
-	args.emplace_back("-b:a");
-	args.emplace_back(std::to_string(_parameters.bitrate));
-
 	// Codecs and formats
+	const char* encoder {}; // default one if not set
+	const char* muxer {};
 	switch (_parameters.format)
 	{
 		case Format::MP3:
-			args.emplace_back("-f");
-			args.emplace_back("mp3");
+			muxer = "mp3";
 			break;
 
 		case Format::OGG_OPUS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libopus");
-			args.emplace_back("-f");
-			args.emplace_back("ogg");
+			encoder = "libopus";
+			muxer = "ogg";
 			break;
 
 		case Format::MATROSKA_OPUS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libopus");
-			args.emplace_back("-f");
-			args.emplace_back("matroska");
+			encoder = "libopus";
+			muxer = "matroska";
 			break;
 
 		case Format::OGG_VORBIS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libvorbis");
-			args.emplace_back("-f");
-			args.emplace_back("ogg");
+			encoder = "libvorbis";
+			muxer = "ogg";
 			break;
 
 		case Format::WEBM_VORBIS:
-			args.emplace_back("-acodec");
-			args.emplace_back("libvorbis");
-			args.emplace_back("-f");
-			args.emplace_back("webm");
+			encoder = "libvorbis";
+			muxer = "webm";
+			break;
+
+		case Format::MPEGTS_AAC:
+			encoder = "aac";
+			muxer = "mpegts";
 			break;
 
 		default:
@@ -161,6 +262,27 @@ Transcoder::start()
 			return false;
 	}
 
+	if (copyStream)
+	{
+		args.emplace_back("-acodec");
+		args.emplace_back("copy");
+	}
+	else
+	{
+		// Output bitrates
+		args.emplace_back("-b:a");
+		args.emplace_back(std::to_string(_parameters.bitrate));
+
+		if (encoder)
+		{
+			args.emplace_back("-acodec");
+			args.emplace_back(encoder);
+		}
+	}
+
+	args.emplace_back("-f");
+	args.emplace_back(muxer);
+
 	_outputMimeType = formatToMimetype(_parameters.format);
 
 	args.emplace_back("pipe:1");
@@ -178,7 +300,11 @@ Transcoder::start()
 		_child = std::make_shared<redi::ipstream>();
 
 		// Caution: stdin must have been closed before
-		_child->open(ffmpegPath.string(), args);
+		{
+			// Inherited by ffmpeg, before it starts its own threads
+			const CpuAffinity::ScopedAffinity affinity {cpuSet};
+			_child->open(ffmpegPath.string(), args);
+		}
 		if (!_child->is_open())
 		{
 			LOG(DEBUG) << "Exec failed!";
@@ -193,15 +319,56 @@ Transcoder::start()
 			return false;
 		}
 
+		if (niceness != 0 && ::setpriority(PRIO_PROCESS, _child->rdbuf()->pid(), niceness) != 0)
+			LOG(ERROR) << "Cannot set ffmpeg niceness: " << ::strerror(errno);
+
 	}
 	LOG(DEBUG) << "Stream opened!";
 
 	return true;
 }
 
+bool
+Transcoder::isSourceStreamCopyable() const
+{
+	try
+	{
+		const MediaFile mediaFile {_filePath};
+
+		const std::optional<std::size_t> streamId {_parameters.stream ? _parameters.stream : mediaFile.getBestStream()};
+		if (!streamId)
+			return false;
+
+		const std::optional<StreamInfo> streamInfo {mediaFile.getStreamInfo(*streamId)};
+		return streamInfo && isStreamCopyable(*streamInfo, _parameters);
+	}
+	catch (const MediaFileException& e)
+	{
+		LOG(DEBUG) << "Cannot probe file '" << _filePath.string() << "': " << e.what();
+		return false;
+	}
+}
+
 void
 Transcoder::process(std::vector<unsigned char>& output, std::size_t maxSize)
 {
+	const SamplingProfiler::ScopedSubsystem profilerSubsystem {SamplingProfiler::Subsystem::Transcode};
+
+	if (_libavTranscoder)
+	{
+		_libavTranscoder->process(output, maxSize);
+		_total += output.size();
+
+		if (_libavTranscoder->isComplete())
+		{
+			LOG(DEBUG) << "Transcode complete!";
+			_isComplete = true;
+			_isSuccessful = _total > 0 && _libavTranscoder->isSuccessful();
+			_libavTranscoder.reset();
+		}
+		return;
+	}
+
 	if (!_child || _isComplete)
 		return;
 
@@ -223,15 +390,23 @@ Transcoder::process(std::vector<unsigned char>& output, std::size_t maxSize)
 		_isComplete = true;
 	}
 
+	_total += output.size();
+
 	if (_isComplete)
 	{
 		LOG(DEBUG) << "Transcode complete!";
 		_child->clear();
+
+		// Wait for ffmpeg to exit in order to get its exit status
+		_child->rdbuf()->close();
+		const int status {_child->rdbuf()->status()};
+		_isSuccessful = _total > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		if (!_isSuccessful)
+			LOG(DEBUG) << "Transcode failed, status = " << status;
+
 		_child.reset();
 	}
 
-	_total += output.size();
-
 	LOG(DEBUG) << "nb bytes = " << output.size() << ", total = " << _total;
 }
 
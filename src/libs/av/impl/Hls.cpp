@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "av/Hls.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace Av::Hls
+{
+	std::size_t
+	getSegmentCount(std::chrono::milliseconds trackDuration)
+	{
+		const std::chrono::milliseconds segmentDurationMs {segmentDuration};
+
+		return (trackDuration.count() + segmentDurationMs.count() - 1) / segmentDurationMs.count();
+	}
+
+	TranscodeParameters
+	getSegmentParameters(std::size_t bitrate, std::size_t segmentIndex)
+	{
+		TranscodeParameters parameters;
+
+		parameters.format = Format::MPEGTS_AAC;
+		parameters.bitrate = bitrate;
+		parameters.offset = segmentDuration * segmentIndex;
+		parameters.duration = segmentDuration;
+		parameters.stripMetadata = true;
+		// Segments must follow each other
+		parameters.keepTimestamps = true;
+
+		return parameters;
+	}
+
+	std::string
+	createMediaPlaylist(std::chrono::milliseconds trackDuration, std::function<std::string(std::size_t segmentIndex)> segmentUrl)
+	{
+		std::ostringstream oss;
+
+		oss << "#EXTM3U\n";
+		oss << "#EXT-X-VERSION:3\n";
+		oss << "#EXT-X-PLAYLIST-TYPE:VOD\n";
+		oss << "#EXT-X-TARGETDURATION:" << segmentDuration.count() << "\n";
+		oss << "#EXT-X-MEDIA-SEQUENCE:0\n";
+
+		const std::size_t segmentCount {getSegmentCount(trackDuration)};
+		for (std::size_t i {}; i < segmentCount; ++i)
+		{
+			// Last segment may be shorter
+			const std::chrono::milliseconds duration {std::min<std::chrono::milliseconds>(segmentDuration, trackDuration - segmentDuration * i)};
+
+			oss << "#EXTINF:" << duration.count() / 1000 << "." << std::setfill('0') << std::setw(3) << duration.count() % 1000 << ",\n";
+			oss << segmentUrl(i) << "\n";
+		}
+
+		oss << "#EXT-X-ENDLIST\n";
+
+		return oss.str();
+	}
+
+	std::string
+	createMasterPlaylist(const std::vector<std::size_t>& bitrates, std::function<std::string(std::size_t bitrate)> mediaPlaylistUrl)
+	{
+		std::ostringstream oss;
+
+		oss << "#EXTM3U\n";
+		oss << "#EXT-X-VERSION:3\n";
+
+		for (const std::size_t bitrate : bitrates)
+		{
+			// AAC-LC
+			oss << "#EXT-X-STREAM-INF:BANDWIDTH=" << bitrate << ",CODECS=\"mp4a.40.2\"\n";
+			oss << mediaPlaylistUrl(bitrate) << "\n";
+		}
+
+		return oss.str();
+	}
+}
+
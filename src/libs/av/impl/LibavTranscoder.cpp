@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LibavTranscoder.hpp"
+
+extern "C"
+{
+#define __STDC_CONSTANT_MACROS
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/error.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "utils/Logger.hpp"
+#include "WorkerPool.hpp"
+
+namespace Av {
+
+#define LOG(sev)	LMS_LOG(TRANSCODE, sev) << "[" << _id << "] - "
+
+namespace {
+
+// libavcodec 59 made the codec pointers const
+#if LIBAVCODEC_VERSION_MAJOR < 59
+using CodecPtr = AVCodec*;
+#else
+using CodecPtr = const AVCodec*;
+#endif
+
+constexpr int ioBufferSize {65536};
+constexpr int defaultFrameSize {1024};
+
+std::string
+averrorToString(int error)
+{
+	std::array<char, 128> buf {};
+
+	if (av_strerror(error, buf.data(), buf.size()) == 0)
+		return buf.data();
+	else
+		return "Unknown error";
+}
+
+void
+checkAvError(int error, const std::string& operation)
+{
+	if (error < 0)
+		throw AvException {operation + ": " + averrorToString(error)};
+}
+
+struct OutputSettings
+{
+	const char* muxerName;
+	const char* encoderName;
+};
+
+OutputSettings
+getOutputSettings(Format format)
+{
+	switch (format)
+	{
+		case Format::MP3:		return {"mp3", "libmp3lame"};
+		case Format::OGG_OPUS:		return {"ogg", "libopus"};
+		case Format::MATROSKA_OPUS:	return {"matroska", "libopus"};
+		case Format::OGG_VORBIS:	return {"ogg", "libvorbis"};
+		case Format::WEBM_VORBIS:	return {"webm", "libvorbis"};
+		case Format::MPEGTS_AAC:	return {"mpegts", "aac"};
+	}
+
+	throw AvException {"Unhandled format"};
+}
+
+// Keep the input sample rate if the encoder supports it
+int
+selectSampleRate(const AVCodec& encoder, int inputSampleRate)
+{
+	if (!encoder.supported_samplerates)
+		return inputSampleRate;
+
+	for (const int* sampleRate {encoder.supported_samplerates}; *sampleRate; ++sampleRate)
+	{
+		if (*sampleRate == inputSampleRate)
+			return inputSampleRate;
+	}
+
+	return encoder.supported_samplerates[0];
+}
+
+// Transcodes are run chunk by chunk, a chunk being processed by one of the workers
+std::unique_ptr<WorkerPool> workerPool;
+
+} // namespace
+
+void
+LibavTranscoder::init(std::size_t workerCount, int niceness, const CpuAffinity::CpuSet& cpuSet)
+{
+	if (workerCount == 0)
+		workerCount = std::max(std::thread::hardware_concurrency(), 1U);
+
+	workerPool = std::make_unique<WorkerPool>(workerCount, [niceness, cpuSet]
+	{
+		CpuAffinity::setCurrentThreadAffinity(cpuSet);
+
+		// On Linux, this only applies to the calling thread
+		if (niceness != 0 && ::setpriority(PRIO_PROCESS, 0, niceness) != 0)
+			LMS_LOG(TRANSCODE, ERROR) << "Cannot set transcode worker niceness: " << ::strerror(errno);
+	});
+	LMS_LOG(TRANSCODE, INFO) << "Using " << workerCount << " transcode worker(s)";
+}
+
+LibavTranscoder::LibavTranscoder(const std::filesystem::path& filePath, const TranscodeParameters& parameters, std::size_t id)
+: _filePath {filePath},
+  _parameters {parameters},
+  _id {id}
+{
+}
+
+LibavTranscoder::~LibavTranscoder()
+{
+	av_frame_free(&_encoderFrame);
+	av_frame_free(&_resampledFrame);
+	av_frame_free(&_decodedFrame);
+	av_packet_free(&_outputPacket);
+	av_packet_free(&_inputPacket);
+
+	if (_ioContext)
+	{
+		av_freep(&_ioContext->buffer);
+		avio_context_free(&_ioContext);
+	}
+	avformat_free_context(_outputContext);
+	avcodec_free_context(&_encoderContext);
+	av_audio_fifo_free(_fifo);
+	swr_free(&_resampler);
+	avcodec_free_context(&_decoderContext);
+	avformat_close_input(&_inputContext);
+}
+
+bool
+LibavTranscoder::start()
+{
+	try
+	{
+		openInput();
+		openOutput();
+	}
+	catch (const AvException& e)
+	{
+		LOG(ERROR) << "Cannot transcode file '" << _filePath.string() << "': " << e.what();
+		return false;
+	}
+
+	LOG(INFO) << "Transcoding file '" << _filePath.string() << "' in process";
+
+	return true;
+}
+
+void
+LibavTranscoder::process(std::vector<unsigned char>& output, std::size_t maxSize)
+{
+	if (!_isFinished && _output.size() < maxSize)
+		workerPool->post([&] { fill(maxSize); }).get();
+
+	const std::size_t size {std::min(maxSize, _output.size())};
+	output.assign(std::cbegin(_output), std::cbegin(_output) + size);
+	_output.erase(std::cbegin(_output), std::cbegin(_output) + size);
+}
+
+int
+LibavTranscoder::writeOutput(void* opaque, std::uint8_t* buffer, int size)
+{
+	LibavTranscoder& transcoder {*static_cast<LibavTranscoder*>(opaque)};
+
+	transcoder._output.insert(std::end(transcoder._output), buffer, buffer + size);
+
+	return size;
+}
+
+void
+LibavTranscoder::openInput()
+{
+	checkAvError(avformat_open_input(&_inputContext, _filePath.c_str(), nullptr, nullptr), "Cannot open input");
+	checkAvError(avformat_find_stream_info(_inputContext, nullptr), "Cannot find stream information");
+
+	CodecPtr decoder {};
+	if (_parameters.stream)
+	{
+		if (*_parameters.stream >= _inputContext->nb_streams
+				|| _inputContext->streams[*_parameters.stream]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+			throw AvException {"Invalid audio stream " + std::to_string(*_parameters.stream)};
+
+		_inputStreamIndex = static_cast<int>(*_parameters.stream);
+		decoder = avcodec_find_decoder(_inputContext->streams[_inputStreamIndex]->codecpar->codec_id);
+	}
+	else
+	{
+		_inputStreamIndex = av_find_best_stream(_inputContext, AVMEDIA_TYPE_AUDIO, -1, -1, &decoder, 0);
+		checkAvError(_inputStreamIndex, "Cannot find audio stream");
+	}
+
+	if (!decoder)
+		throw AvException {"No decoder found"};
+
+	// Do not demux unused streams (covers, etc.)
+	for (unsigned i {}; i < _inputContext->nb_streams; ++i)
+	{
+		if (static_cast<int>(i) != _inputStreamIndex)
+			_inputContext->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	_decoderContext = avcodec_alloc_context3(decoder);
+	if (!_decoderContext)
+		throw AvException {"Cannot allocate decoder context"};
+
+	checkAvError(avcodec_parameters_to_context(_decoderContext, _inputContext->streams[_inputStreamIndex]->codecpar), "Cannot set decoder parameters");
+	checkAvError(avcodec_open2(_decoderContext, decoder, nullptr), "Cannot open decoder");
+
+	if (!_decoderContext->channel_layout)
+		_decoderContext->channel_layout = av_get_default_channel_layout(_decoderContext->channels);
+
+	// Same as ffmpeg: offsets are relative to the start of the file
+	std::int64_t timestamp {_inputContext->start_time != AV_NOPTS_VALUE ? _inputContext->start_time : 0};
+	const AVRational streamTimeBase {_inputContext->streams[_inputStreamIndex]->time_base};
+
+	if (_parameters.offset)
+	{
+		timestamp += av_rescale(_parameters.offset->count(), AV_TIME_BASE, 1000);
+
+		checkAvError(avformat_seek_file(_inputContext, -1, INT64_MIN, timestamp, timestamp, 0), "Cannot seek");
+
+		// Seeking lands on the previous key frame: the samples before the offset are decoded but not encoded
+		_skipUntil = av_rescale_q(timestamp, AV_TIME_BASE_Q, streamTimeBase);
+	}
+
+	if (_parameters.duration)
+		_stopAt = av_rescale_q(timestamp + av_rescale(_parameters.duration->count(), AV_TIME_BASE, 1000), AV_TIME_BASE_Q, streamTimeBase);
+}
+
+void
+LibavTranscoder::openOutput()
+{
+	const OutputSettings settings {getOutputSettings(_parameters.format)};
+
+	CodecPtr encoder {avcodec_find_encoder_by_name(settings.encoderName)};
+	if (!encoder)
+		throw AvException {std::string {"Encoder '"} + settings.encoderName + "' not available"};
+
+	checkAvError(avformat_alloc_output_context2(&_outputContext, nullptr, settings.muxerName, nullptr), "Cannot allocate output context");
+
+	AVStream* outputStream {avformat_new_stream(_outputContext, nullptr)};
+	if (!outputStream)
+		throw AvException {"Cannot create output stream"};
+
+	_encoderContext = avcodec_alloc_context3(encoder);
+	if (!_encoderContext)
+		throw AvException {"Cannot allocate encoder context"};
+
+	// Same as ffmpeg: downmix to stereo at most
+	_encoderContext->channels = std::min(_decoderContext->channels, 2);
+	_encoderContext->channel_layout = av_get_default_channel_layout(_encoderContext->channels);
+	_encoderContext->sample_rate = selectSampleRate(*encoder, _decoderContext->sample_rate);
+	_encoderContext->sample_fmt = encoder->sample_fmts ? encoder->sample_fmts[0] : _decoderContext->sample_fmt;
+	_encoderContext->bit_rate = _parameters.bitrate;
+	_encoderContext->time_base = AVRational {1, _encoderContext->sample_rate};
+	if (_outputContext->oformat->flags & AVFMT_GLOBALHEADER)
+		_encoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	checkAvError(avcodec_open2(_encoderContext, encoder, nullptr), "Cannot open encoder");
+
+	if (_parameters.keepTimestamps && _parameters.offset)
+		_nextPts = av_rescale_q(_parameters.offset->count(), AVRational {1, 1000}, _encoderContext->time_base);
+	checkAvError(avcodec_parameters_from_context(outputStream->codecpar, _encoderContext), "Cannot set output stream parameters");
+	outputStream->time_base = _encoderContext->time_base;
+
+	if (!_parameters.stripMetadata)
+		av_dict_copy(&_outputContext->metadata, _inputContext->metadata, 0);
+
+	_resampler = swr_alloc_set_opts(nullptr,
+			_encoderContext->channel_layout, _encoderContext->sample_fmt, _encoderContext->sample_rate,
+			_decoderContext->channel_layout, _decoderContext->sample_fmt, _decoderContext->sample_rate,
+			0, nullptr);
+	if (!_resampler)
+		throw AvException {"Cannot allocate resampler"};
+	checkAvError(swr_init(_resampler), "Cannot init resampler");
+
+	_fifo = av_audio_fifo_alloc(_encoderContext->sample_fmt, _encoderContext->channels, 1);
+	_inputPacket = av_packet_alloc();
+	_outputPacket = av_packet_alloc();
+	_decodedFrame = av_frame_alloc();
+	_resampledFrame = av_frame_alloc();
+	_encoderFrame = av_frame_alloc();
+	if (!_fifo || !_inputPacket || !_outputPacket || !_decodedFrame || !_resampledFrame || !_encoderFrame)
+		throw AvException {"Cannot allocate transcode buffers"};
+
+	unsigned char* ioBuffer {static_cast<unsigned char*>(av_malloc(ioBufferSize))};
+	if (!ioBuffer)
+		throw AvException {"Cannot allocate output buffer"};
+
+	_ioContext = avio_alloc_context(ioBuffer, ioBufferSize, 1, this, nullptr, &LibavTranscoder::writeOutput, nullptr);
+	if (!_ioContext)
+	{
+		av_free(ioBuffer);
+		throw AvException {"Cannot allocate output context"};
+	}
+
+	_outputContext->pb = _ioContext;
+	_outputContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	checkAvError(avformat_write_header(_outputContext, nullptr), "Cannot write header");
+}
+
+void
+LibavTranscoder::fill(std::size_t size)
+{
+	try
+	{
+		while (!_isFinished && _output.size() < size)
+		{
+			const int error {_reachedStop ? AVERROR_EOF : av_read_frame(_inputContext, _inputPacket)};
+			if (error == AVERROR_EOF)
+			{
+				decodePacket(nullptr);
+
+				// flush the resampler
+				resample(nullptr, 0);
+				encodeSamples(true);
+				encodeFrame(nullptr);
+
+				checkAvError(av_write_trailer(_outputContext), "Cannot write trailer");
+				avio_flush(_ioContext);
+
+				LOG(DEBUG) << "Transcode complete!";
+				_isFinished = true;
+				_isSuccessful = true;
+				break;
+			}
+			checkAvError(error, "Cannot read input");
+
+			if (_inputPacket->stream_index == _inputStreamIndex)
+				decodePacket(_inputPacket);
+
+			av_packet_unref(_inputPacket);
+		}
+	}
+	catch (const AvException& e)
+	{
+		LOG(ERROR) << "Transcode failed: " << e.what();
+		_isFinished = true;
+	}
+}
+
+void
+LibavTranscoder::decodePacket(const AVPacket* packet)
+{
+	const int error {avcodec_send_packet(_decoderContext, packet)};
+	if (error == AVERROR_INVALIDDATA)
+	{
+		// Same as ffmpeg: skip corrupted data
+		LOG(DEBUG) << "Skipping invalid packet";
+		return;
+	}
+	checkAvError(error, "Cannot decode");
+
+	while (true)
+	{
+		const int receiveError {avcodec_receive_frame(_decoderContext, _decodedFrame)};
+		if (receiveError == AVERROR(EAGAIN) || receiveError == AVERROR_EOF)
+			break;
+		checkAvError(receiveError, "Cannot decode");
+
+		const int sampleCount {getSampleCountBeforeStop(*_decodedFrame)};
+		const int skippedSampleCount {getSkippedSampleCount(*_decodedFrame)};
+		if (skippedSampleCount < sampleCount)
+		{
+			// Skip the leading samples of each plane
+			const int bytesPerSample {av_get_bytes_per_sample(_decoderContext->sample_fmt)};
+			const bool isPlanar {av_sample_fmt_is_planar(_decoderContext->sample_fmt) != 0};
+			const int sampleStride {isPlanar ? bytesPerSample : bytesPerSample * _decoderContext->channels};
+
+			std::vector<const std::uint8_t*> planes(isPlanar ? _decoderContext->channels : 1);
+			for (std::size_t i {}; i < planes.size(); ++i)
+				planes[i] = _decodedFrame->extended_data[i] + skippedSampleCount * sampleStride;
+
+			resample(planes.data(), sampleCount - skippedSampleCount);
+		}
+		av_frame_unref(_decodedFrame);
+
+		encodeSamples(false);
+	}
+}
+
+int
+LibavTranscoder::getSkippedSampleCount(const AVFrame& frame)
+{
+	if (!_skipUntil)
+		return 0;
+
+	const std::int64_t timestamp {frame.best_effort_timestamp};
+	if (timestamp == AV_NOPTS_VALUE)
+	{
+		_skipUntil.reset();
+		return 0;
+	}
+
+	const std::int64_t skippedSampleCount {av_rescale_q(*_skipUntil - timestamp, _inputContext->streams[_inputStreamIndex]->time_base, AVRational {1, frame.sample_rate})};
+	if (skippedSampleCount >= frame.nb_samples)
+		return frame.nb_samples;
+
+	// Reached the offset
+	_skipUntil.reset();
+	return static_cast<int>(std::max<std::int64_t>(skippedSampleCount, 0));
+}
+
+int
+LibavTranscoder::getSampleCountBeforeStop(const AVFrame& frame)
+{
+	if (!_stopAt || frame.best_effort_timestamp == AV_NOPTS_VALUE)
+		return frame.nb_samples;
+
+	const std::int64_t sampleCount {av_rescale_q(*_stopAt - frame.best_effort_timestamp, _inputContext->streams[_inputStreamIndex]->time_base, AVRational {1, frame.sample_rate})};
+	if (sampleCount >= frame.nb_samples)
+		return frame.nb_samples;
+
+	// Reached the requested duration
+	_reachedStop = true;
+	return static_cast<int>(std::max<std::int64_t>(sampleCount, 0));
+}
+
+void
+LibavTranscoder::resample(const std::uint8_t** data, int sampleCount)
+{
+	const int maxSampleCount {swr_get_out_samples(_resampler, sampleCount)};
+	checkAvError(maxSampleCount, "Cannot resample");
+	if (maxSampleCount == 0)
+		return;
+
+	_resampledFrame->nb_samples = maxSampleCount;
+	_resampledFrame->format = _encoderContext->sample_fmt;
+	_resampledFrame->channel_layout = _encoderContext->channel_layout;
+	_resampledFrame->sample_rate = _encoderContext->sample_rate;
+	checkAvError(av_frame_get_buffer(_resampledFrame, 0), "Cannot allocate resample buffer");
+
+	const int resampledCount {swr_convert(_resampler, _resampledFrame->extended_data, maxSampleCount, data, sampleCount)};
+	if (resampledCount >= 0 && av_audio_fifo_write(_fifo, reinterpret_cast<void**>(_resampledFrame->extended_data), resampledCount) < resampledCount)
+	{
+		av_frame_unref(_resampledFrame);
+		throw AvException {"Cannot buffer samples"};
+	}
+	av_frame_unref(_resampledFrame);
+
+	checkAvError(resampledCount, "Cannot resample");
+}
+
+void
+LibavTranscoder::encodeSamples(bool flush)
+{
+	const bool variableFrameSize {(_encoderContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) || _encoderContext->frame_size == 0};
+	const bool smallLastFrame {variableFrameSize || (_encoderContext->codec->capabilities & AV_CODEC_CAP_SMALL_LAST_FRAME)};
+	const int frameSize {_encoderContext->frame_size > 0 ? _encoderContext->frame_size : defaultFrameSize};
+
+	while (av_audio_fifo_size(_fifo) >= frameSize || (flush && av_audio_fifo_size(_fifo) > 0))
+	{
+		const int sampleCount {std::min(av_audio_fifo_size(_fifo), frameSize)};
+
+		_encoderFrame->nb_samples = (sampleCount < frameSize && !smallLastFrame) ? frameSize : sampleCount;
+		_encoderFrame->format = _encoderContext->sample_fmt;
+		_encoderFrame->channel_layout = _encoderContext->channel_layout;
+		_encoderFrame->sample_rate = _encoderContext->sample_rate;
+		checkAvError(av_frame_get_buffer(_encoderFrame, 0), "Cannot allocate encode buffer");
+
+		if (_encoderFrame->nb_samples > sampleCount)
+			av_samples_set_silence(_encoderFrame->extended_data, sampleCount, _encoderFrame->nb_samples - sampleCount, _encoderContext->channels, _encoderContext->sample_fmt);
+
+		av_audio_fifo_read(_fifo, reinterpret_cast<void**>(_encoderFrame->extended_data), sampleCount);
+		_encoderFrame->pts = _nextPts;
+		_nextPts += _encoderFrame->nb_samples;
+
+		try
+		{
+			encodeFrame(_encoderFrame);
+		}
+		catch (const AvException&)
+		{
+			av_frame_unref(_encoderFrame);
+			throw;
+		}
+		av_frame_unref(_encoderFrame);
+	}
+}
+
+void
+LibavTranscoder::encodeFrame(const AVFrame* frame)
+{
+	checkAvError(avcodec_send_frame(_encoderContext, frame), "Cannot encode");
+
+	while (true)
+	{
+		const int error {avcodec_receive_packet(_encoderContext, _outputPacket)};
+		if (error == AVERROR(EAGAIN) || error == AVERROR_EOF)
+			break;
+		checkAvError(error, "Cannot encode");
+
+		_outputPacket->stream_index = 0;
+		av_packet_rescale_ts(_outputPacket, _encoderContext->time_base, _outputContext->streams[0]->time_base);
+
+		// takes ownership of the packet data
+		checkAvError(av_interleaved_write_frame(_outputContext, _outputPacket), "Cannot write output");
+	}
+}
+
+} // namespace Av
+
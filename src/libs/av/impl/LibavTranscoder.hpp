@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "av/AvTranscoder.hpp"
+#include "utils/CpuAffinity.hpp"
+
+struct AVAudioFifo;
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVIOContext;
+struct AVPacket;
+struct SwrContext;
+
+namespace Av {
+
+// Transcodes using libavformat/libavcodec/libswresample, without forking any external process
+// The actual work is done by a shared pool of worker threads
+class LibavTranscoder
+{
+	public:
+		// workerCount = 0 means the number of hardware threads
+		// niceness and cpuSet (if not empty) are applied to the worker threads
+		static void init(std::size_t workerCount, int niceness, const CpuAffinity::CpuSet& cpuSet);
+
+		LibavTranscoder(const std::filesystem::path& file, const TranscodeParameters& parameters, std::size_t id);
+		~LibavTranscoder();
+
+		LibavTranscoder(const LibavTranscoder&) = delete;
+		LibavTranscoder& operator=(const LibavTranscoder&) = delete;
+		LibavTranscoder(LibavTranscoder&&) = delete;
+		LibavTranscoder& operator=(LibavTranscoder&&) = delete;
+
+		// false if the file cannot be transcoded this way
+		bool	start();
+		void	process(std::vector<unsigned char>& output, std::size_t maxSize);
+		bool	isComplete() const { return _isFinished && _output.empty(); }
+		bool	isSuccessful() const { return _isSuccessful; }
+
+	private:
+		static int writeOutput(void* opaque, std::uint8_t* buffer, int size);
+
+		void openInput();
+		void openOutput();
+		void fill(std::size_t size);
+		void decodePacket(const AVPacket* packet);
+		int getSkippedSampleCount(const AVFrame& frame);
+		int getSampleCountBeforeStop(const AVFrame& frame);
+		void resample(const std::uint8_t** data, int sampleCount);
+		void encodeSamples(bool flush);
+		void encodeFrame(const AVFrame* frame);
+
+		const std::filesystem::path	_filePath;
+		const TranscodeParameters	_parameters;
+		const std::size_t		_id;
+
+		AVFormatContext*	_inputContext {};
+		int			_inputStreamIndex {-1};
+		AVCodecContext*		_decoderContext {};
+		SwrContext*		_resampler {};
+		AVAudioFifo*		_fifo {};
+		AVCodecContext*		_encoderContext {};
+		AVFormatContext*	_outputContext {};
+		AVIOContext*		_ioContext {};
+
+		AVPacket*		_inputPacket {};
+		AVPacket*		_outputPacket {};
+		AVFrame*		_decodedFrame {};
+		AVFrame*		_resampledFrame {};
+		AVFrame*		_encoderFrame {};
+		std::int64_t		_nextPts {};
+		std::optional<std::int64_t>	_skipUntil; // in input stream time base
+		std::optional<std::int64_t>	_stopAt; // in input stream time base
+		bool			_reachedStop {};
+
+		std::vector<unsigned char>	_output; // muxed data not yet consumed
+		bool			_isFinished {};
+		bool			_isSuccessful {};
+};
+
+} // namespace Av
+
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranscodeBroker.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <limits>
+
+#include <boost/asio/steady_timer.hpp>
+
+#include "av/ITranscodeCache.hpp"
+#include "av/PreTranscode.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+
+namespace Av
+{
+
+	SharedTranscode::SharedTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, WorkerPool& ioThreads)
+		: _trackPath {trackPath}
+		, _parameters {parameters}
+		, _ioThreads {ioThreads}
+		, _transcoder {trackPath, parameters}
+	{
+		// Outputs starting at some offset (seeks, ranges) are unlikely to be requested again, unlike segments
+		const bool isWholeTrack {!_parameters.offset || _parameters.offset->count() == 0};
+		const bool isSegment {_parameters.duration.has_value()};
+		if (Service<ITranscodeCache>::get() && (isWholeTrack || isSegment))
+		{
+			std::error_code ec;
+			_trackLastWriteTime = std::filesystem::last_write_time(_trackPath, ec);
+			_cacheable = !ec;
+		}
+	}
+
+	SharedTranscode::~SharedTranscode()
+	{
+		// The admission, if any, is released along with the transcoder
+		if (!_isComplete)
+			LMS_LOG(TRANSCODE, DEBUG) << "No more reader, stopping transcode of '" << _trackPath.string() << "' after " << _buffer.size() << " bytes";
+	}
+
+	void
+	SharedTranscode::schedule(const TranscodeClient& client)
+	{
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (_isAdmitted || _isComplete || (_priority && *_priority <= client.priority))
+				return;
+
+			_priority = client.priority;
+		}
+
+		// Replacing the previous request, if any, releases it
+		std::unique_ptr<TranscodeScheduler::Admission> previousAdmission;
+		std::unique_ptr<TranscodeScheduler::Admission> admission {TranscodeScheduler::getInstance().requestAdmission(client, [weakSelf {weak_from_this()}]
+		{
+			if (std::shared_ptr<SharedTranscode> self {weakSelf.lock()})
+				self->onAdmitted();
+		})};
+
+		std::scoped_lock lock {_mutex};
+		if (!_isComplete)
+		{
+			previousAdmission = std::move(_admission);
+			_admission = std::move(admission);
+		}
+	}
+
+	void
+	SharedTranscode::onAdmitted()
+	{
+		std::scoped_lock lock {_mutex};
+
+		_isAdmitted = true;
+		if (!_callbacks.empty() && !_isProducing)
+		{
+			_isProducing = true;
+			_ioThreads.post([self {shared_from_this()}] { self->produce(); });
+		}
+	}
+
+	std::size_t
+	SharedTranscode::write(std::size_t offset, std::ostream& os, std::size_t maxSize) const
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (offset >= _buffer.size())
+			return 0;
+
+		const std::size_t size {std::min(maxSize, _buffer.size() - offset)};
+		os.write(reinterpret_cast<const char *>(_buffer.data() + offset), size);
+
+		return size;
+	}
+
+	bool
+	SharedTranscode::isDataAvailable(std::size_t offset) const
+	{
+		std::scoped_lock lock {_mutex};
+
+		return _isComplete || offset < _buffer.size();
+	}
+
+	bool
+	SharedTranscode::isComplete(std::size_t offset) const
+	{
+		std::scoped_lock lock {_mutex};
+
+		return _isComplete && offset >= _buffer.size();
+	}
+
+	void
+	SharedTranscode::notifyWhenDataAvailable(std::size_t offset, DataAvailableCallback callback)
+	{
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (!_isComplete && offset >= _buffer.size())
+			{
+				_callbacks.push_back(std::move(callback));
+				if (_isProducing || !_isAdmitted)
+					return;
+
+				_isProducing = true;
+				_ioThreads.post([self {shared_from_this()}] { self->produce(); });
+				return;
+			}
+		}
+
+		callback();
+	}
+
+	void
+	SharedTranscode::produce()
+	{
+		// Only one thread at a time produces data, without holding the lock while waiting for the transcoder
+		if (!_isStarted)
+		{
+			_isStarted = true;
+			_transcoder.start();
+		}
+		_transcoder.process(_chunk, _chunkSize);
+
+		std::vector<DataAvailableCallback> callbacks;
+		std::unique_ptr<TranscodeScheduler::Admission> admission;
+		{
+			std::scoped_lock lock {_mutex};
+
+			_buffer.insert(std::end(_buffer), std::cbegin(_chunk), std::cend(_chunk));
+			_isComplete = _transcoder.isComplete();
+			_isProducing = false;
+			callbacks.swap(_callbacks);
+			if (_isComplete)
+				admission = std::move(_admission);
+		}
+
+		// Let the next queued transcode run
+		admission.reset();
+
+		// No more writer on the buffer from now
+		if (_transcoder.isComplete() && _transcoder.isSuccessful() && _cacheable)
+			addToCache();
+
+		for (const DataAvailableCallback& callback : callbacks)
+			callback();
+	}
+
+	void
+	SharedTranscode::addToCache()
+	{
+		ITranscodeCache* cache {Service<ITranscodeCache>::get()};
+
+		const std::filesystem::path pendingFile {cache->createPendingFile()};
+		{
+			std::ofstream pendingFileStream {pendingFile, std::ios::binary | std::ios::trunc};
+			pendingFileStream.write(reinterpret_cast<const char *>(_buffer.data()), _buffer.size());
+			pendingFileStream.close();
+
+			if (!pendingFileStream)
+			{
+				LMS_LOG(TRANSCODE, ERROR) << "Cannot write transcode cache file '" << pendingFile.string() << "'";
+				std::error_code ec;
+				std::filesystem::remove(pendingFile, ec);
+				return;
+			}
+		}
+
+		cache->add(_trackPath, _parameters, _trackLastWriteTime, pendingFile);
+	}
+
+	TranscodeBroker::TranscodeBroker()
+		: _ioThreads {std::max<std::size_t>(Service<IConfig>::get()->getULong("transcode-io-thread-count", 2), 1)}
+		, _leadTime {Service<IConfig>::get()->getULong("transcode-lead-time", 30)}
+		, _timerThread {[this] { _timerIOService.run(); }}
+	{
+	}
+
+	TranscodeBroker::~TranscodeBroker()
+	{
+		_timerIOService.stop();
+		_timerThread.join();
+	}
+
+	void
+	TranscodeBroker::callAt(std::chrono::steady_clock::time_point timePoint, std::function<void()> callback)
+	{
+		auto timer {std::make_shared<boost::asio::steady_timer>(_timerIOService, timePoint)};
+		timer->async_wait([timer, callback {std::move(callback)}](const boost::system::error_code& ec)
+		{
+			if (!ec)
+				callback();
+		});
+	}
+
+	TranscodeBroker&
+	TranscodeBroker::getInstance()
+	{
+		static TranscodeBroker broker;
+		return broker;
+	}
+
+	std::shared_ptr<SharedTranscode>
+	TranscodeBroker::getTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeClient& client)
+	{
+		const std::string key {computeTranscodeKey(trackPath, parameters)};
+
+		std::scoped_lock lock {_mutex};
+
+		// Forget about the transcodes that no longer have any reader
+		for (auto it {std::begin(_transcodes)}; it != std::end(_transcodes); )
+		{
+			if (it->second.expired())
+				it = _transcodes.erase(it);
+			else
+				++it;
+		}
+
+		auto it {_transcodes.find(key)};
+		if (it != std::cend(_transcodes))
+		{
+			// The last reader may have just gone
+			if (std::shared_ptr<SharedTranscode> transcode {it->second.lock()})
+			{
+				LMS_LOG(TRANSCODE, DEBUG) << "Attaching to ongoing transcode of '" << trackPath.string() << "'";
+				transcode->schedule(client);
+				return transcode;
+			}
+		}
+
+		auto transcode {std::make_shared<SharedTranscode>(trackPath, parameters, _ioThreads)};
+		transcode->schedule(client);
+		_transcodes[key] = transcode;
+
+		return transcode;
+	}
+
+	bool
+	preTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const std::atomic<bool>& abort)
+	{
+		ITranscodeCache* cache {Service<ITranscodeCache>::get()};
+		if (!cache)
+			return false;
+
+		if (cache->find(trackPath, parameters))
+			return true;
+
+		std::shared_ptr<SharedTranscode> transcode {TranscodeBroker::getInstance().getTranscode(trackPath, parameters, TranscodeClient {"", TranscodePriority::Idle})};
+
+		// The output is discarded here: the transcode adds it to the cache by itself once complete
+		std::ostream nullStream {nullptr};
+		std::size_t offset {};
+		while (!transcode->isComplete(offset))
+		{
+			// May be called after we gave up waiting
+			auto dataAvailable {std::make_shared<std::promise<void>>()};
+			std::future<void> dataAvailableFuture {dataAvailable->get_future()};
+			transcode->notifyWhenDataAvailable(offset, [dataAvailable] { dataAvailable->set_value(); });
+
+			while (dataAvailableFuture.wait_for(std::chrono::milliseconds {500}) != std::future_status::ready)
+			{
+				if (abort)
+					return false;
+			}
+
+			offset += transcode->write(offset, nullStream, std::numeric_limits<std::size_t>::max());
+		}
+
+		return cache->find(trackPath, parameters) != nullptr;
+	}
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "av/AvTranscoder.hpp"
+#include "TranscodeScheduler.hpp"
+#include "WorkerPool.hpp"
+
+namespace Av
+{
+
+	// A transcode shared by all the readers of the same track with the same parameters
+	// Its output is kept in memory so that readers can attach at any time and start from the beginning
+	// The output is produced on demand by the I/O threads of the broker, so that readers never block
+	// The transcoder is started once admitted by the transcode scheduler
+	// If enabled, the transcode cache is fed once the whole output has been successfully produced
+	class SharedTranscode : public std::enable_shared_from_this<SharedTranscode>
+	{
+		public:
+			using DataAvailableCallback = std::function<void()>;
+
+			SharedTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, WorkerPool& ioThreads);
+			~SharedTranscode();	// stops the transcoder at once if not complete (last reader gone)
+
+			SharedTranscode(const SharedTranscode&) = delete;
+			SharedTranscode(SharedTranscode&&) = delete;
+			SharedTranscode& operator=(const SharedTranscode&) = delete;
+			SharedTranscode& operator=(SharedTranscode&&) = delete;
+
+			// Must be called right after construction
+			// May be called again to raise the priority of a transcode that is still queued
+			void schedule(const TranscodeClient& client);
+
+			// Writes up to maxSize bytes already produced at offset, straight from the shared buffer, does not block
+			// Returns the number of written bytes
+			std::size_t write(std::size_t offset, std::ostream& os, std::size_t maxSize) const;
+
+			// Set if some data is available at offset, or if there is no more data to be produced
+			bool isDataAvailable(std::size_t offset) const;
+
+			// Set once there is no more data to be produced after offset
+			bool isComplete(std::size_t offset) const;
+
+			// Produces more data if needed, callback is called (possibly from another thread) once isDataAvailable(offset) is set
+			void notifyWhenDataAvailable(std::size_t offset, DataAvailableCallback callback);
+
+		private:
+			void onAdmitted();
+			void produce();
+			void addToCache();
+
+			static constexpr std::size_t _chunkSize {262144};
+			const std::filesystem::path _trackPath;
+			const TranscodeParameters _parameters;
+			WorkerPool& _ioThreads;
+			std::filesystem::file_time_type _trackLastWriteTime;
+			bool _cacheable {};
+
+			// only used by the producing I/O thread
+			Transcoder _transcoder;
+			bool _isStarted {};
+			std::vector<unsigned char> _chunk;
+
+			mutable std::mutex _mutex;
+			std::vector<unsigned char> _buffer;
+			bool _isComplete {};
+			bool _isProducing {};
+			bool _isAdmitted {};
+			std::optional<TranscodePriority> _priority;
+			std::unique_ptr<TranscodeScheduler::Admission> _admission; // released once complete
+			std::vector<DataAvailableCallback> _callbacks;
+	};
+
+	// Gives access to the ongoing transcodes, a transcode being released along with its last reader
+	class TranscodeBroker
+	{
+		public:
+			static TranscodeBroker& getInstance();
+
+			// client is used to schedule the transcode, if not already ongoing
+			std::shared_ptr<SharedTranscode> getTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeClient& client);
+
+			// How far ahead of the elapsed time the interactive readers may be sent the output (0 means no limit)
+			std::chrono::seconds getLeadTime() const { return _leadTime; }
+
+			// callback is called from the broker timer thread once timePoint is reached
+			void callAt(std::chrono::steady_clock::time_point timePoint, std::function<void()> callback);
+
+		private:
+			TranscodeBroker();
+			~TranscodeBroker();
+
+			WorkerPool _ioThreads;
+			const std::chrono::seconds _leadTime;
+
+			boost::asio::io_service _timerIOService;
+			boost::asio::io_service::work _timerWork {_timerIOService};
+			std::thread _timerThread;
+
+			std::mutex _mutex;
+			std::unordered_map<std::string, std::weak_ptr<SharedTranscode>> _transcodes;
+	};
+}
+
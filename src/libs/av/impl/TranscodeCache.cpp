@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TranscodeCache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+#include <unistd.h>
+
+#include "av/AvTranscoder.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+
+namespace Av
+{
+	namespace
+	{
+		constexpr const char* dataFileExtension {".bin"};
+		constexpr const char* metaFileExtension {".meta"};
+		constexpr const char* pendingFileExtension {".tmp"};
+
+		// Pending and unreferenced files may be written by another process: only remove them once they are not written anymore
+		constexpr std::chrono::hours staleFileAge {1};
+		// Entries added or evicted by the other processes sharing the directory
+		constexpr std::chrono::minutes syncPeriod {1};
+
+		Metrics::Counter& cacheHits {Metrics::getCounter("lms_transcode_cache_hits_total", "Number of transcodes served from the transcode cache")};
+		Metrics::Counter& cacheMisses {Metrics::getCounter("lms_transcode_cache_misses_total", "Number of transcodes not found in the transcode cache")};
+
+		bool
+		isStale(const std::filesystem::path& path)
+		{
+			std::error_code ec;
+			const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(path, ec)};
+			return ec || std::filesystem::file_time_type::clock::now() - lastWriteTime > staleFileAge;
+		}
+	}
+
+	std::unique_ptr<ITranscodeCache>
+	createTranscodeCache(const std::filesystem::path& directory, std::uintmax_t maxSize)
+	{
+		return std::make_unique<TranscodeCache>(directory, maxSize);
+	}
+
+	TranscodeCache::EntryFiles::EntryFiles(const std::filesystem::path& _dataFile, const std::filesystem::path& _metaFile)
+		: dataFile {_dataFile}
+		, metaFile {_metaFile}
+	{
+	}
+
+	TranscodeCache::EntryFiles::~EntryFiles()
+	{
+		if (!removeOnRelease)
+			return;
+
+		std::error_code ec;
+		std::filesystem::remove(dataFile, ec);
+
+		// Another process may have published a new entry for the same key meanwhile
+		const std::optional<MetaInfo> metaInfo {readMetaFile(metaFile)};
+		if (!metaInfo || metaInfo->id == dataFile.stem().string())
+			std::filesystem::remove(metaFile, ec);
+	}
+
+	TranscodeCache::TranscodeCache(const std::filesystem::path& directory, std::uintmax_t maxSize)
+		: _directory {directory}
+		, _maxSize {maxSize}
+	{
+		std::filesystem::create_directories(_directory);
+
+		loadEntries();
+		evictEntries();
+
+		LMS_LOG(TRANSCODE, INFO) << "Transcode cache: " << _entries.size() << " entries, " << _totalSize << "/" << _maxSize << " bytes";
+	}
+
+	TranscodeCache::~TranscodeCache()
+	{
+		// Entries still in use are kept
+		_entriesByKey.clear();
+		_entries.clear();
+	}
+
+	std::optional<TranscodeCache::MetaInfo>
+	TranscodeCache::readMetaFile(const std::filesystem::path& metaFile)
+	{
+		std::ifstream ifs {metaFile};
+		std::filesystem::file_time_type::rep trackLastWriteTime {};
+		MetaInfo metaInfo;
+		if (!(ifs >> trackLastWriteTime && ifs.ignore() && std::getline(ifs, metaInfo.id) && std::getline(ifs, metaInfo.key, '\0'))
+				|| metaInfo.id.empty() || metaInfo.key.empty())
+			return std::nullopt;
+
+		metaInfo.trackLastWriteTime = std::filesystem::file_time_type {std::filesystem::file_time_type::duration {trackLastWriteTime}};
+		return metaInfo;
+	}
+
+	std::filesystem::path
+	TranscodeCache::getMetaFile(const std::string& key) const
+	{
+		// Only needs to be stable across the processes sharing the directory, the key is checked once read
+		std::ostringstream oss;
+		oss << std::hex << std::setw(16) << std::setfill('0') << std::hash<std::string> {}(key) << metaFileExtension;
+		return _directory / oss.str();
+	}
+
+	std::filesystem::path
+	TranscodeCache::getDataFile(const std::string& id) const
+	{
+		return _directory / (id + dataFileExtension);
+	}
+
+	void
+	TranscodeCache::loadEntries()
+	{
+		std::vector<Entry> entries;
+		std::unordered_set<std::filesystem::path> referencedDataFiles;
+		std::vector<std::filesystem::path> dataFiles;
+		std::vector<std::filesystem::path> filesToRemove;
+
+		std::error_code ec;
+		for (std::filesystem::directory_iterator itFile {_directory, ec}; !ec && itFile != std::filesystem::directory_iterator {}; itFile.increment(ec))
+		{
+			const std::filesystem::path& path {itFile->path()};
+
+			if (path.extension() == pendingFileExtension)
+			{
+				// Transcode interrupted by a restart, or still being written by another process
+				if (isStale(path))
+					filesToRemove.push_back(path);
+				continue;
+			}
+
+			if (path.extension() == dataFileExtension)
+			{
+				dataFiles.push_back(path);
+				continue;
+			}
+
+			if (path.extension() != metaFileExtension)
+				continue;
+
+			const std::optional<MetaInfo> metaInfo {readMetaFile(path)};
+			if (metaInfo && path == getMetaFile(metaInfo->key))
+			{
+				const std::filesystem::path dataFile {getDataFile(metaInfo->id)};
+				std::error_code sizeEc;
+				const std::uintmax_t size {std::filesystem::file_size(dataFile, sizeEc)};
+				if (!sizeEc)
+				{
+					Entry entry;
+					entry.key = metaInfo->key;
+					entry.files = std::make_shared<EntryFiles>(dataFile, path);
+					entry.size = size;
+					entry.trackLastWriteTime = metaInfo->trackLastWriteTime;
+					entries.push_back(std::move(entry));
+					referencedDataFiles.insert(dataFile);
+					continue;
+				}
+			}
+
+			// Bad entry, or written by an older version
+			LMS_LOG(TRANSCODE, DEBUG) << "Transcode cache: removing bad entry '" << path.string() << "'";
+			filesToRemove.push_back(path);
+		}
+
+		// Data files are published before their meta file
+		for (const std::filesystem::path& dataFile : dataFiles)
+		{
+			if (referencedDataFiles.find(dataFile) == std::cend(referencedDataFiles) && isStale(dataFile))
+				filesToRemove.push_back(dataFile);
+		}
+
+		for (const std::filesystem::path& file : filesToRemove)
+			std::filesystem::remove(file, ec);
+
+		// Access times are not kept, use the last write time of the data files instead (refreshed on each hit, by any process)
+		std::vector<std::pair<std::filesystem::file_time_type, Entry*>> entriesByLastUse;
+		for (Entry& entry : entries)
+			entriesByLastUse.emplace_back(std::filesystem::last_write_time(entry.files->dataFile, ec), &entry);
+		std::sort(std::begin(entriesByLastUse), std::end(entriesByLastUse), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		for (auto& [lastUse, entry] : entriesByLastUse)
+		{
+			_entries.push_back(std::move(*entry));
+			_entriesByKey.emplace(_entries.back().key, std::prev(std::end(_entries)));
+			_totalSize += _entries.back().size;
+		}
+
+		_lastSyncTime = std::chrono::steady_clock::now();
+	}
+
+	void
+	TranscodeCache::syncEntriesIfNeeded()
+	{
+		if (std::chrono::steady_clock::now() - _lastSyncTime < syncPeriod)
+			return;
+
+		// Files of the entries in use are not removed, as the entries are read again
+		_entriesByKey.clear();
+		_entries.clear();
+		_totalSize = 0;
+
+		loadEntries();
+	}
+
+	std::optional<TranscodeCache::Entries::iterator>
+	TranscodeCache::adoptEntry(const std::string& key)
+	{
+		const std::filesystem::path metaFile {getMetaFile(key)};
+
+		const std::optional<MetaInfo> metaInfo {readMetaFile(metaFile)};
+		if (!metaInfo || metaInfo->key != key)
+			return std::nullopt;
+
+		const std::filesystem::path dataFile {getDataFile(metaInfo->id)};
+		std::error_code ec;
+		const std::uintmax_t size {std::filesystem::file_size(dataFile, ec)};
+		if (ec)
+			return std::nullopt;
+
+		Entry entry;
+		entry.key = key;
+		entry.files = std::make_shared<EntryFiles>(dataFile, metaFile);
+		entry.size = size;
+		entry.trackLastWriteTime = metaInfo->trackLastWriteTime;
+		addEntry(std::move(entry));
+
+		return std::begin(_entries);
+	}
+
+	ITranscodeCache::CachedFile
+	TranscodeCache::find(const std::filesystem::path& trackPath, const TranscodeParameters& parameters)
+	{
+		const std::string key {computeTranscodeKey(trackPath, parameters)};
+
+		std::error_code ec;
+		const std::filesystem::file_time_type trackLastWriteTime {std::filesystem::last_write_time(trackPath, ec)};
+
+		std::scoped_lock lock {_mutex};
+
+		std::optional<Entries::iterator> entry;
+		if (const auto itEntry {_entriesByKey.find(key)}; itEntry != std::cend(_entriesByKey))
+			entry = itEntry->second;
+		else
+			entry = adoptEntry(key);
+
+		if (!entry)
+		{
+			cacheMisses.inc();
+			return {};
+		}
+
+		if (ec || (*entry)->trackLastWriteTime != trackLastWriteTime)
+		{
+			LMS_LOG(TRANSCODE, DEBUG) << "Transcode cache: track '" << trackPath.string() << "' changed, removing entry";
+			removeEntry(*entry);
+			cacheMisses.inc();
+			return {};
+		}
+
+		_entries.splice(std::begin(_entries), _entries, *entry);
+		std::filesystem::last_write_time((*entry)->files->dataFile, std::filesystem::file_time_type::clock::now(), ec);
+		if (ec)
+		{
+			// Evicted by another process
+			removeEntry(*entry);
+			cacheMisses.inc();
+			return {};
+		}
+
+		cacheHits.inc();
+
+		LMS_LOG(TRANSCODE, DEBUG) << "Transcode cache: hit for track '" << trackPath.string() << "'";
+
+		return CachedFile {(*entry)->files, &(*entry)->files->dataFile};
+	}
+
+	std::filesystem::path
+	TranscodeCache::createPendingFile()
+	{
+		std::scoped_lock lock {_mutex};
+
+		return _directory / (createEntryId() + pendingFileExtension);
+	}
+
+	void
+	TranscodeCache::add(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, std::filesystem::file_time_type trackLastWriteTime, const std::filesystem::path& pendingFile)
+	{
+		const std::string key {computeTranscodeKey(trackPath, parameters)};
+
+		std::error_code ec;
+		const std::uintmax_t size {std::filesystem::file_size(pendingFile, ec)};
+		if (ec || size == 0 || size > _maxSize)
+		{
+			std::filesystem::remove(pendingFile, ec);
+			return;
+		}
+
+		std::scoped_lock lock {_mutex};
+
+		syncEntriesIfNeeded();
+
+		// Same track concurrently transcoded by another request, or by another process
+		if (_entriesByKey.find(key) != std::cend(_entriesByKey) || adoptEntry(key))
+		{
+			std::filesystem::remove(pendingFile, ec);
+			return;
+		}
+
+		const std::string id {createEntryId()};
+		const std::filesystem::path dataFile {getDataFile(id)};
+		const std::filesystem::path metaFile {getMetaFile(key)};
+		const std::filesystem::path pendingMetaFile {_directory / (createEntryId() + pendingFileExtension)};
+
+		{
+			std::ofstream ofs {pendingMetaFile, std::ios::trunc};
+			ofs << trackLastWriteTime.time_since_epoch().count() << "\n" << id << "\n" << key;
+			ofs.close();
+			if (!ofs)
+			{
+				LMS_LOG(TRANSCODE, ERROR) << "Transcode cache: cannot write file '" << pendingMetaFile.string() << "'";
+				std::filesystem::remove(pendingMetaFile, ec);
+				std::filesystem::remove(pendingFile, ec);
+				return;
+			}
+		}
+
+		// The meta file is published last, so that the other processes never see an entry without its data
+		std::filesystem::rename(pendingFile, dataFile, ec);
+		if (!ec)
+			std::filesystem::rename(pendingMetaFile, metaFile, ec);
+		if (ec)
+		{
+			LMS_LOG(TRANSCODE, ERROR) << "Transcode cache: cannot publish entry '" << dataFile.string() << "': " << ec.message();
+			std::filesystem::remove(pendingMetaFile, ec);
+			std::filesystem::remove(pendingFile, ec);
+			std::filesystem::remove(dataFile, ec);
+			return;
+		}
+
+		Entry entry;
+		entry.key = key;
+		entry.files = std::make_shared<EntryFiles>(dataFile, metaFile);
+		entry.size = size;
+		entry.trackLastWriteTime = trackLastWriteTime;
+		addEntry(std::move(entry));
+
+		LMS_LOG(TRANSCODE, DEBUG) << "Transcode cache: added track '" << trackPath.string() << "', " << size << " bytes";
+
+		evictEntries();
+	}
+
+	void
+	TranscodeCache::addEntry(Entry entry)
+	{
+		_totalSize += entry.size;
+		_entries.push_front(std::move(entry));
+		_entriesByKey.emplace(_entries.front().key, std::begin(_entries));
+	}
+
+	void
+	TranscodeCache::removeEntry(Entries::iterator itEntry)
+	{
+		itEntry->files->removeOnRelease = true;
+		_totalSize -= itEntry->size;
+		_entriesByKey.erase(itEntry->key);
+		_entries.erase(itEntry);
+	}
+
+	void
+	TranscodeCache::evictEntries()
+	{
+		while (_totalSize > _maxSize && !_entries.empty())
+			removeEntry(std::prev(std::end(_entries)));
+	}
+
+	std::string
+	TranscodeCache::createEntryId()
+	{
+		// Unique across restarts and processes, so that files of evicted entries still in use are never overwritten
+		const auto now {std::chrono::system_clock::now().time_since_epoch()};
+		return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(now).count()) + "-" + std::to_string(::getpid()) + "-" + std::to_string(_nextId++);
+	}
+
+} // namespace Av
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "av/ITranscodeCache.hpp"
+
+namespace Av
+{
+	// Each entry is made of a data file (<id>.bin), served as is, and a meta file (<key hash>.meta)
+	// Meta file layout: track last write time on the first line, the id of the data file on the second one, then the entry key
+	// The directory can be shared by several processes: files are published using renames, entries added by the other
+	// processes are picked up on lookup, and the directory is listed again from time to time to evict using the actual total size
+	// Evicted files may still be used by readers of the other processes, that keep them open until done
+	class TranscodeCache final : public ITranscodeCache
+	{
+		public:
+			TranscodeCache(const std::filesystem::path& directory, std::uintmax_t maxSize);
+			~TranscodeCache();
+
+			TranscodeCache(const TranscodeCache&) = delete;
+			TranscodeCache(TranscodeCache&&) = delete;
+			TranscodeCache& operator=(const TranscodeCache&) = delete;
+			TranscodeCache& operator=(TranscodeCache&&) = delete;
+
+		private:
+			CachedFile find(const std::filesystem::path& trackPath, const TranscodeParameters& parameters) override;
+			std::filesystem::path createPendingFile() override;
+			void add(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, std::filesystem::file_time_type trackLastWriteTime, const std::filesystem::path& pendingFile) override;
+
+			// Removes the files once the entry has been evicted and nobody uses it anymore
+			struct EntryFiles
+			{
+				std::filesystem::path		dataFile;
+				std::filesystem::path		metaFile;
+				std::atomic<bool>			removeOnRelease {};
+
+				EntryFiles(const std::filesystem::path& dataFile, const std::filesystem::path& metaFile);
+				~EntryFiles();
+			};
+
+			struct Entry
+			{
+				std::string						key;
+				std::shared_ptr<EntryFiles>		files;
+				std::uintmax_t					size {};
+				std::filesystem::file_time_type	trackLastWriteTime;
+			};
+			using Entries = std::list<Entry>;	// most recently used first
+
+			struct MetaInfo
+			{
+				std::filesystem::file_time_type	trackLastWriteTime;
+				std::string						id;
+				std::string						key;
+			};
+			static std::optional<MetaInfo> readMetaFile(const std::filesystem::path& metaFile);
+
+			std::filesystem::path getMetaFile(const std::string& key) const;
+			std::filesystem::path getDataFile(const std::string& id) const;
+			void loadEntries();
+			void syncEntriesIfNeeded();
+			std::optional<Entries::iterator> adoptEntry(const std::string& key);	// added by another process
+			void addEntry(Entry entry);
+			void removeEntry(Entries::iterator itEntry);
+			void evictEntries();
+			std::string createEntryId();
+
+			const std::filesystem::path	_directory;
+			const std::uintmax_t		_maxSize;
+
+			std::mutex			_mutex;
+			Entries				_entries;
+			std::unordered_map<std::string, Entries::iterator> _entriesByKey;
+			std::uintmax_t		_totalSize {};
+			std::size_t			_nextId {};
+			std::chrono::steady_clock::time_point	_lastSyncTime;
+	};
+
+} // namespace Av
+
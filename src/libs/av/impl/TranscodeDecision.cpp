@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "av/TranscodeDecision.hpp"
+
+#include "utils/Logger.hpp"
+
+namespace Av {
+
+namespace
+{
+	// Accepted bitrate overshoot when transcodes are being queued
+	constexpr std::size_t busyBitrateFactor {2};
+
+	bool
+	isBusy(const TranscodeStats& stats)
+	{
+		return stats.queuedInteractiveCount > 0 || stats.queuedBackgroundCount > 0;
+	}
+
+	TranscodeDecision
+	decide(const StreamInfo& source, const TranscodeParameters& parameters, const ClientCapabilities& capabilities, const TranscodeStats& stats)
+	{
+		const bool isCodecSupported {capabilities.supportedCodecs.find(source.codecName) != std::cend(capabilities.supportedCodecs)};
+
+		// Unknown bitrate (some VBR files): do not take the risk of sending more than requested
+		if (isCodecSupported && source.bitrate != 0)
+		{
+			if (source.bitrate <= parameters.bitrate)
+				return {TranscodeMode::Passthrough, "source bitrate is within the limit"};
+
+			if (!capabilities.strictBitrate && isBusy(stats) && source.bitrate <= parameters.bitrate * busyBitrateFactor)
+				return {TranscodeMode::Passthrough, "source bitrate is slightly over the limit and transcodes are being queued"};
+		}
+
+		if (isStreamCopyable(source, parameters))
+			return {TranscodeMode::Remux, "source codec matches the requested format"};
+
+		if (!isCodecSupported)
+			return {TranscodeMode::Transcode, "client cannot play '" + source.codecName + "'"};
+
+		if (source.bitrate == 0)
+			return {TranscodeMode::Transcode, "source bitrate is unknown"};
+
+		return {TranscodeMode::Transcode, "source bitrate is over the limit"};
+	}
+}
+
+const char*
+transcodeModeToString(TranscodeMode mode)
+{
+	switch (mode)
+	{
+		case TranscodeMode::Passthrough:	return "passthrough";
+		case TranscodeMode::Remux:		return "remux";
+		case TranscodeMode::Transcode:		return "transcode";
+	}
+
+	return "unknown";
+}
+
+TranscodeDecision
+decideTranscodeMode(const StreamInfo& source, const TranscodeParameters& parameters, const ClientCapabilities& capabilities, const TranscodeStats& stats)
+{
+	TranscodeDecision decision {decide(source, parameters, capabilities, stats)};
+
+	LMS_LOG(TRANSCODE, DEBUG) << "Source '" << source.codecName << "' at " << source.bitrate << " bps, limit " << parameters.bitrate
+		<< " bps: " << transcodeModeToString(decision.mode) << " (" << decision.reason << ")";
+
+	return decision;
+}
+
+TranscodeDecision
+decideTranscodeMode(const std::filesystem::path& file, const TranscodeParameters& parameters, const ClientCapabilities& capabilities)
+{
+	try
+	{
+		const MediaFile mediaFile {file};
+
+		const std::optional<std::size_t> streamId {parameters.stream ? parameters.stream : mediaFile.getBestStream()};
+		if (streamId)
+		{
+			if (const std::optional<StreamInfo> streamInfo {mediaFile.getStreamInfo(*streamId)})
+				return decideTranscodeMode(*streamInfo, parameters, capabilities, getTranscodeStats());
+		}
+	}
+	catch (const MediaFileException& e)
+	{
+		LMS_LOG(TRANSCODE, DEBUG) << "Cannot probe file '" << file.string() << "': " << e.what();
+	}
+
+	return {TranscodeMode::Transcode, "source cannot be probed"};
+}
+
+} // namespace Av
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranscodeScheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Service.hpp"
+
+namespace Av
+{
+	namespace
+	{
+		Metrics::Counter& admittedTranscodes {Metrics::getCounter("lms_transcode_admitted_total", "Number of transcodes allowed to run")};
+		Metrics::Histogram& admissionWait {Metrics::getHistogram("lms_transcode_admission_wait_seconds", "Time spent by the transcodes waiting to be allowed to run")};
+	}
+
+	TranscodeStats
+	getTranscodeStats()
+	{
+		return TranscodeScheduler::getInstance().getStats();
+	}
+
+	void
+	setTranscodeLimits(std::size_t maxRunningCount, std::size_t maxRunningCountPerUser)
+	{
+		TranscodeScheduler::getInstance().setLimits(maxRunningCount, maxRunningCountPerUser);
+	}
+
+	TranscodeScheduler::TranscodeScheduler(std::size_t maxRunningCount, std::size_t maxRunningCountPerUser)
+		: _maxRunningCount {maxRunningCount}
+		, _maxRunningCountPerUser {maxRunningCountPerUser}
+	{
+		LMS_LOG(TRANSCODE, INFO) << "Max concurrent transcodes = " << _maxRunningCount << ", per user = " << _maxRunningCountPerUser;
+	}
+
+	void
+	TranscodeScheduler::setLimits(std::size_t maxRunningCount, std::size_t maxRunningCountPerUser)
+	{
+		std::vector<std::function<void()>> callbacks;
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (maxRunningCount == _maxRunningCount && maxRunningCountPerUser == _maxRunningCountPerUser)
+				return;
+
+			_maxRunningCount = maxRunningCount;
+			_maxRunningCountPerUser = maxRunningCountPerUser;
+			LMS_LOG(TRANSCODE, INFO) << "Max concurrent transcodes = " << _maxRunningCount << ", per user = " << _maxRunningCountPerUser;
+
+			// Queued transcodes may now be allowed to run
+			callbacks = admitPendingRequests();
+		}
+
+		for (const auto& callback : callbacks)
+			callback();
+	}
+
+	TranscodeScheduler&
+	TranscodeScheduler::getInstance()
+	{
+		static TranscodeScheduler scheduler {Service<IConfig>::get()->getULong("transcode-max-concurrent", 0),
+											Service<IConfig>::get()->getULong("transcode-max-concurrent-per-user", 0)};
+		return scheduler;
+	}
+
+	std::unique_ptr<TranscodeScheduler::Admission>
+	TranscodeScheduler::requestAdmission(const TranscodeClient& client, std::function<void()> onAdmitted)
+	{
+		std::vector<std::function<void()>> callbacks;
+		std::uint64_t id;
+
+		onAdmitted = [requestTime = std::chrono::steady_clock::now(), onAdmitted = std::move(onAdmitted)]
+		{
+			admittedTranscodes.inc();
+			admissionWait.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - requestTime));
+			onAdmitted();
+		};
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			id = _nextId++;
+			_pendingRequests[static_cast<std::size_t>(client.priority)].push_back(PendingRequest {id, client.user, std::move(onAdmitted)});
+			callbacks = admitPendingRequests();
+
+			if (_runningUserById.find(id) == std::cend(_runningUserById))
+				LMS_LOG(TRANSCODE, DEBUG) << "Transcode for user '" << client.user << "' queued";
+		}
+
+		auto admission {std::make_unique<Admission>(*this, id)};
+
+		for (const auto& callback : callbacks)
+			callback();
+
+		return admission;
+	}
+
+	TranscodeStats
+	TranscodeScheduler::getStats() const
+	{
+		std::scoped_lock lock {_mutex};
+
+		TranscodeStats stats;
+		stats.runningCount = _runningUserById.size();
+		stats.queuedInteractiveCount = _pendingRequests[static_cast<std::size_t>(TranscodePriority::Interactive)].size();
+		stats.queuedBackgroundCount = _pendingRequests[static_cast<std::size_t>(TranscodePriority::Background)].size();
+		stats.queuedIdleCount = _pendingRequests[static_cast<std::size_t>(TranscodePriority::Idle)].size();
+
+		return stats;
+	}
+
+	void
+	TranscodeScheduler::release(std::uint64_t id)
+	{
+		std::vector<std::function<void()>> callbacks;
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			auto itRunning {_runningUserById.find(id)};
+			if (itRunning != std::cend(_runningUserById))
+			{
+				auto itUser {_runningCountByUser.find(itRunning->second)};
+				if (--itUser->second == 0)
+					_runningCountByUser.erase(itUser);
+
+				_runningUserById.erase(itRunning);
+				callbacks = admitPendingRequests();
+			}
+			else
+			{
+				for (auto& pendingRequests : _pendingRequests)
+				{
+					auto itPending {std::find_if(std::begin(pendingRequests), std::end(pendingRequests), [&](const PendingRequest& request) { return request.id == id; })};
+					if (itPending != std::end(pendingRequests))
+					{
+						pendingRequests.erase(itPending);
+						break;
+					}
+				}
+			}
+		}
+
+		for (const auto& callback : callbacks)
+			callback();
+	}
+
+	bool
+	TranscodeScheduler::canRun(const std::string& user) const
+	{
+		if (_maxRunningCountPerUser == 0)
+			return true;
+
+		auto itUser {_runningCountByUser.find(user)};
+		return itUser == std::cend(_runningCountByUser) || itUser->second < _maxRunningCountPerUser;
+	}
+
+	std::vector<std::function<void()>>
+	TranscodeScheduler::admitPendingRequests()
+	{
+		std::vector<std::function<void()>> callbacks;
+
+		// Highest priority first, skipping the users that already reached their limit
+		for (std::size_t priority {}; priority < _pendingRequests.size(); ++priority)
+		{
+			auto& pendingRequests {_pendingRequests[priority]};
+			for (auto it {std::begin(pendingRequests)}; it != std::end(pendingRequests); )
+			{
+				if (_maxRunningCount > 0 && _runningUserById.size() >= _maxRunningCount)
+					return callbacks;
+
+				if (priority == static_cast<std::size_t>(TranscodePriority::Idle) && !_runningUserById.empty())
+					return callbacks;
+
+				if (!canRun(it->user))
+				{
+					++it;
+					continue;
+				}
+
+				_runningUserById.emplace(it->id, it->user);
+				_runningCountByUser[it->user]++;
+				callbacks.push_back(std::move(it->onAdmitted));
+				it = pendingRequests.erase(it);
+			}
+		}
+
+		return callbacks;
+	}
+}
+
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "av/AvTranscoder.hpp"
+#include "av/TranscodeStats.hpp"
+
+namespace Av
+{
+
+	// Limits the number of transcodes running at once, globally and per user
+	// Extra transcodes are queued, interactive ones first, and started as soon as some running transcodes are released
+	// Idle transcodes are only started while nothing else is running
+	class TranscodeScheduler
+	{
+		public:
+			// Releases the running or queued transcode on destruction
+			class Admission
+			{
+				public:
+					Admission(TranscodeScheduler& scheduler, std::uint64_t id) : _scheduler {scheduler}, _id {id} {}
+					~Admission() { _scheduler.release(_id); }
+
+					Admission(const Admission&) = delete;
+					Admission(Admission&&) = delete;
+					Admission& operator=(const Admission&) = delete;
+					Admission& operator=(Admission&&) = delete;
+
+				private:
+					TranscodeScheduler& _scheduler;
+					const std::uint64_t _id;
+			};
+
+			// 0 means unlimited
+			TranscodeScheduler(std::size_t maxRunningCount, std::size_t maxRunningCountPerUser);
+
+			static TranscodeScheduler& getInstance();
+
+			TranscodeScheduler(const TranscodeScheduler&) = delete;
+			TranscodeScheduler(TranscodeScheduler&&) = delete;
+			TranscodeScheduler& operator=(const TranscodeScheduler&) = delete;
+			TranscodeScheduler& operator=(TranscodeScheduler&&) = delete;
+
+			// onAdmitted is called once the transcode can run, possibly from within this call or from another thread
+			std::unique_ptr<Admission> requestAdmission(const TranscodeClient& client, std::function<void()> onAdmitted);
+
+			TranscodeStats getStats() const;
+
+			// Running transcodes are not stopped if lowered
+			void setLimits(std::size_t maxRunningCount, std::size_t maxRunningCountPerUser);
+
+		private:
+			struct PendingRequest
+			{
+				std::uint64_t id;
+				std::string user;
+				std::function<void()> onAdmitted;
+			};
+
+			void release(std::uint64_t id);
+			bool canRun(const std::string& user) const;
+			// Must be called with _mutex held, the returned callbacks are to be called once released
+			std::vector<std::function<void()>> admitPendingRequests();
+
+			mutable std::mutex _mutex;
+			std::size_t _maxRunningCount;
+			std::size_t _maxRunningCountPerUser;
+			std::uint64_t _nextId {};
+			std::array<std::deque<PendingRequest>, 3> _pendingRequests; // by priority
+			std::unordered_map<std::uint64_t, std::string> _runningUserById;
+			std::unordered_map<std::string, std::size_t> _runningCountByUser;
+	};
+
+}
+
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Av {
+
+// Runs the posted tasks on a fixed set of threads, in posting order
+class WorkerPool
+{
+	public:
+		using WorkerInit = std::function<void()>;
+
+		// workerInit, if set, is called by each worker thread before running any task
+		explicit WorkerPool(std::size_t workerCount, WorkerInit workerInit = {})
+		{
+			for (std::size_t i {}; i < workerCount; ++i)
+			{
+				_workers.emplace_back([this, workerInit]
+				{
+					if (workerInit)
+						workerInit();
+					run();
+				});
+			}
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::scoped_lock lock {_mutex};
+				_quit = true;
+			}
+			_condition.notify_all();
+
+			for (std::thread& worker : _workers)
+				worker.join();
+		}
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		std::size_t getWorkerCount() const { return _workers.size(); }
+
+		std::future<void> post(std::function<void()> func)
+		{
+			std::packaged_task<void()> task {std::move(func)};
+			std::future<void> res {task.get_future()};
+
+			{
+				std::scoped_lock lock {_mutex};
+				_tasks.push_back(std::move(task));
+			}
+			_condition.notify_one();
+
+			return res;
+		}
+
+	private:
+		void run()
+		{
+			while (true)
+			{
+				std::packaged_task<void()> task;
+
+				{
+					std::unique_lock lock {_mutex};
+					_condition.wait(lock, [this] { return _quit || !_tasks.empty(); });
+					if (_quit)
+						return;
+
+					task = std::move(_tasks.front());
+					_tasks.pop_front();
+				}
+
+				task();
+			}
+		}
+
+		std::vector<std::thread>		_workers;
+		std::mutex				_mutex;
+		std::condition_variable			_condition;
+		std::deque<std::packaged_task<void()>>	_tasks;
+		bool					_quit {};
+};
+
+} // namespace Av
+
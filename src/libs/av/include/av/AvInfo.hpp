@@ -49,6 +49,7 @@ struct StreamInfo
 {
 	size_t		id;
 	std::size_t     bitrate;
+	std::string	codecName; // as named by libavcodec ("mp3", "opus", "vorbis", etc.)
 };
 
 class MediaFileException : public AvException
@@ -60,7 +61,8 @@ class MediaFileException : public AvException
 class MediaFile
 {
 	public:
-		MediaFile(const std::filesystem::path& p);
+		// If findStreamInfo is not set, the file is not probed: only the attached pictures and the metadata can be used
+		MediaFile(const std::filesystem::path& p, bool findStreamInfo = true);
 		~MediaFile();
 
 		MediaFile(const MediaFile&) = delete;
@@ -77,6 +79,7 @@ class MediaFile
 
 		std::vector<StreamInfo>	getStreamInfo() const;
 		std::optional<std::size_t>	getBestStream() const; // none if failure/unknown
+		std::optional<StreamInfo>	getStreamInfo(std::size_t streamId) const; // none if not an audio stream
 		bool			hasAttachedPictures(void) const;
 		void			visitAttachedPictures(std::function<void(const Picture&)> func) const;
 
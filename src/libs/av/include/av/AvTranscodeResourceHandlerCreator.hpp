@@ -19,16 +19,20 @@
 
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <memory>
+#include <optional>
 
 #include "utils/IResourceHandler.hpp"
 
 namespace Av
 {
+	struct TranscodeClient;
 	struct TranscodeParameters;
 
-	std::unique_ptr<IResourceHandler> createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters);
+	// trackDuration, if known (from the database for example), saves probing the track
+	std::unique_ptr<IResourceHandler> createTranscodeResourceHandler(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const TranscodeClient& client, std::optional<std::chrono::milliseconds> trackDuration = std::nullopt);
 
 }
 
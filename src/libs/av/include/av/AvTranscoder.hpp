@@ -21,25 +21,53 @@
 
 #include <chrono>
 #include <filesystem>
+#include <memory>
 #include <optional>
+#include <string>
 
 #include <pstreams/pstream.h>
 
+#include "AvInfo.hpp"
 #include "AvTypes.hpp"
 
 namespace Av {
 
-
+class LibavTranscoder;
 
 struct TranscodeParameters
 {
 	Format					format;
 	std::size_t				bitrate {128000};
 	std::optional<std::size_t>		stream; // Id of the stream to be transcoded (auto detect by default)
-	std::optional<std::chrono::seconds>	offset;
+	std::optional<std::chrono::milliseconds>	offset;
+	std::optional<std::chrono::milliseconds>	duration; // whole track by default
 	bool 					stripMetadata {true};
+	bool					keepTimestamps {}; // output timestamps start at offset instead of 0 (segments)
+};
+
+// Interactive playback is served ahead of bulk transfers (offline sync, etc.)
+// Idle transcodes (pre-transcodes, etc.) are only run while no other transcode is running
+enum class TranscodePriority
+{
+	Interactive,
+	Background,
+	Idle,
+};
+
+// Who requested a transcode, used to schedule it fairly
+struct TranscodeClient
+{
+	std::string		user;
+	TranscodePriority	priority {TranscodePriority::Interactive};
 };
 
+// Identifies the output of a transcode
+std::string computeTranscodeKey(const std::filesystem::path& file, const TranscodeParameters& parameters);
+
+// Set if the stream can be put as is in the requested format, without being re-encoded
+// (same codec, bitrate not above the requested one)
+bool isStreamCopyable(const StreamInfo& stream, const TranscodeParameters& parameters);
+
 class Transcoder
 {
 	public:
@@ -57,16 +85,22 @@ class Transcoder
 		const std::string&	getOutputMimeType() const { return _outputMimeType; }
 		void			process(std::vector<unsigned char>& output, std::size_t maxSize);
 		bool			isComplete(void) const { return _isComplete; }
+		// Set once complete, if the whole output has been produced
+		bool			isSuccessful() const { return _isSuccessful; }
 
 		const TranscodeParameters& getParameters() const { return _parameters; }
 
 	private:
+		bool			isSourceStreamCopyable() const;
+
 		const std::filesystem::path	_filePath;
 		const TranscodeParameters	_parameters;
 
+		std::unique_ptr<LibavTranscoder>	_libavTranscoder;
 		std::shared_ptr<redi::ipstream>	_child;
 
 		bool			_isComplete {};
+		bool			_isSuccessful {};
 		std::size_t		_total {};
 		const std::size_t	_id {};
 		std::string		_outputMimeType;
@@ -39,6 +39,7 @@ enum class Format
 	MATROSKA_OPUS	= 2,
 	OGG_VORBIS	= 3,
 	WEBM_VORBIS	= 4,
+	MPEGTS_AAC	= 5, // used by HLS segments
 };
 
 const char* formatToMimetype(Format encoding);
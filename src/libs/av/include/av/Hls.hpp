@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "av/AvTranscoder.hpp"
+
+// HTTP Live Streaming: tracks are split into short segments, each of them being transcoded (and cached) on its own
+namespace Av::Hls
+{
+	constexpr const char* playlistMimeType {"application/vnd.apple.mpegurl"};
+	constexpr std::chrono::seconds segmentDuration {10};
+
+	std::size_t getSegmentCount(std::chrono::milliseconds trackDuration);
+
+	// bitrate in bps
+	TranscodeParameters getSegmentParameters(std::size_t bitrate, std::size_t segmentIndex);
+
+	// Lists the segments of a track
+	std::string createMediaPlaylist(std::chrono::milliseconds trackDuration, std::function<std::string(std::size_t segmentIndex)> segmentUrl);
+
+	// Lists the media playlists of a track, one per bitrate (in bps), so that clients can switch bitrates between segments
+	std::string createMasterPlaylist(const std::vector<std::size_t>& bitrates, std::function<std::string(std::size_t bitrate)> mediaPlaylistUrl);
+}
+
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace Av
+{
+	struct TranscodeParameters;
+
+	// On disk cache of transcoded tracks, the least recently used entries are evicted first when the size limit is reached
+	class ITranscodeCache
+	{
+		public:
+			virtual ~ITranscodeCache() = default;
+
+			// The file is kept as long as this object is alive, even if the entry gets evicted meanwhile
+			using CachedFile = std::shared_ptr<const std::filesystem::path>;
+
+			// Entries are invalidated if the track file has been modified since they were added
+			virtual CachedFile find(const std::filesystem::path& trackPath, const TranscodeParameters& parameters) = 0;
+
+			// Path of a new file, to write a transcoded output into before adding it
+			virtual std::filesystem::path createPendingFile() = 0;
+
+			// The pending file is moved into the cache (or removed if it cannot be added)
+			// trackLastWriteTime must have been read before starting the transcode
+			virtual void add(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, std::filesystem::file_time_type trackLastWriteTime, const std::filesystem::path& pendingFile) = 0;
+	};
+
+	std::unique_ptr<ITranscodeCache> createTranscodeCache(const std::filesystem::path& directory, std::uintmax_t maxSize);
+
+} // namespace Av
+
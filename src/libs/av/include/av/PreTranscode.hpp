@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+
+namespace Av
+{
+	struct TranscodeParameters;
+
+	// Transcodes the track into the transcode cache, so that it can be served later without transcoding
+	// Blocks until done or aborted, the transcode being run using the idle priority
+	// Returns true if the output is in the cache (already there or just added), false if the cache is disabled, if the transcode failed or has been aborted
+	bool preTranscode(const std::filesystem::path& trackPath, const TranscodeParameters& parameters, const std::atomic<bool>& abort);
+}
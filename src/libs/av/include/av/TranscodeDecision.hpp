@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+
+#include "av/AvInfo.hpp"
+#include "av/AvTranscoder.hpp"
+#include "av/TranscodeStats.hpp"
+
+namespace Av {
+
+enum class TranscodeMode
+{
+	Passthrough,	// the file is sent as is
+	Remux,		// the audio stream is copied into the requested format
+	Transcode,	// the audio stream is re-encoded
+};
+
+const char* transcodeModeToString(TranscodeMode mode);
+
+// What is known about the client that will play the stream
+struct ClientCapabilities
+{
+	// Codecs the client can play in their usual container, as named by libavcodec
+	std::unordered_set<std::string>	supportedCodecs {"mp3", "aac", "opus", "vorbis"};
+	// The client asked for the bitrate limit itself (bandwidth, data plan, etc.), so it must not be exceeded
+	bool				strictBitrate {};
+};
+
+struct TranscodeDecision
+{
+	TranscodeMode	mode;
+	std::string	reason; // for the logs
+};
+
+// parameters are the ones to be used if the stream has to be transcoded
+// Under transcode load, sources a bit over a non strict bitrate limit are sent as is rather than queued
+TranscodeDecision decideTranscodeMode(const StreamInfo& source, const TranscodeParameters& parameters, const ClientCapabilities& capabilities, const TranscodeStats& stats);
+
+// Probes the file and uses the current transcode stats, transcodes if the file cannot be probed
+TranscodeDecision decideTranscodeMode(const std::filesystem::path& file, const TranscodeParameters& parameters, const ClientCapabilities& capabilities);
+
+} // namespace Av
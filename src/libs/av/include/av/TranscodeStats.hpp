@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace Av
+{
+	struct TranscodeStats
+	{
+		std::size_t runningCount {};
+		std::size_t queuedInteractiveCount {};
+		std::size_t queuedBackgroundCount {};
+		std::size_t queuedIdleCount {};
+	};
+
+	// Process wide
+	TranscodeStats getTranscodeStats();
+
+	// Process wide limits of the transcodes running at once, 0 means unlimited
+	// Initially set by transcode-max-concurrent and transcode-max-concurrent-per-user, running transcodes are not stopped if lowered
+	void setTranscodeLimits(std::size_t maxRunningCount, std::size_t maxRunningCountPerUser);
+}
+
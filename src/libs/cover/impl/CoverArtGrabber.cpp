@@ -19,7 +19,12 @@
 
 #include "CoverArtGrabber.hpp"
 
+#include <algorithm>
+#include <optional>
+#include <sstream>
+
 #include "av/AvInfo.hpp"
+#include "metadata/EmbeddedPicture.hpp"
 
 #include "database/Release.hpp"
 #include "database/Session.hpp"
@@ -34,12 +39,20 @@ using RawImage = CoverArt::GraphicsMagick::RawImage;
 #endif
 
 #include "utils/Logger.hpp"
-#include "utils/Random.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracing.hpp"
 #include "utils/Utils.hpp"
 #include "Exception.hpp"
 
 namespace
 {
+	Metrics::Counter& diskCacheHits {Metrics::getCounter("lms_cover_disk_cache_hits_total", "Number of covers found in the disk cache")};
+	Metrics::Counter& diskCacheMisses {Metrics::getCounter("lms_cover_disk_cache_misses_total", "Number of covers not found in the disk cache")};
+	Metrics::Histogram& computeDuration {Metrics::getHistogram("lms_cover_compute_duration_seconds", "Time spent getting the covers not found in the memory cache")};
+	Metrics::Histogram& decodeDuration {Metrics::getHistogram("lms_cover_decode_duration_seconds", "Time spent decoding the cover images")};
+	Metrics::Histogram& resizeDuration {Metrics::getHistogram("lms_cover_resize_duration_seconds", "Time spent resizing the cover images")};
+	Metrics::Histogram& encodeDuration {Metrics::getHistogram("lms_cover_encode_duration_seconds", "Time spent encoding the cover images")};
+
 	struct TrackInfo
 	{
 		bool hasCover {};
@@ -73,11 +86,68 @@ namespace
 
 		return res;
 	}
+
+	// The track path guards against ids reused by the database
+	std::string
+	getDiskCacheKey(const CoverArt::CacheEntryDesc& entryDesc, const std::filesystem::path& trackPath)
+	{
+		std::ostringstream oss;
+		oss << (entryDesc.type == CoverArt::CacheEntryDesc::Type::Track ? "track" : "release")
+			<< "-" << entryDesc.id
+			<< "-" << entryDesc.size
+			<< "-" << std::hex << std::hash<std::string>{}(trackPath.string());
+
+		// Also the file extension in the disk cache
+		switch (entryDesc.format)
+		{
+			case CoverArt::ImageFormat::JPEG:	oss << ".jpg"; break;
+			case CoverArt::ImageFormat::WebP:	oss << ".webp"; break;
+		}
+
+		return oss.str();
+	}
 }
 
 
 namespace CoverArt {
 
+// format must be supported
+static
+std::unique_ptr<IEncodedImage>
+encode(const RawImage& rawImage, ImageFormat format, unsigned jpegQuality, unsigned webpQuality)
+{
+#if LMS_SUPPORT_IMAGE_GM
+	if (format == ImageFormat::WebP)
+		return rawImage.encodeToWebP(webpQuality);
+#else
+	(void)format;
+	(void)webpQuality;
+#endif
+
+	return rawImage.encodeToJPEG(jpegQuality);
+}
+
+// Steps are timed separately, to compare the image libraries and the quality settings
+// decodeArgs are the image source arguments of the RawImage constructor
+template<typename... DecodeArgs>
+static
+std::unique_ptr<IEncodedImage>
+decodeResizeEncode(ImageSize width, ImageFormat format, unsigned jpegQuality, unsigned webpQuality, const DecodeArgs&... decodeArgs)
+{
+	std::optional<RawImage> rawImage;
+	{
+		const Metrics::ScopedTimer timer {decodeDuration};
+		rawImage.emplace(decodeArgs..., width);
+	}
+	{
+		const Metrics::ScopedTimer timer {resizeDuration};
+		rawImage->resize(width);
+	}
+
+	const Metrics::ScopedTimer timer {encodeDuration};
+	return encode(*rawImage, format, jpegQuality, webpQuality);
+}
+
 static
 bool
 isFileSupported(const std::filesystem::path& file, const std::vector<std::filesystem::path>& extensions)
@@ -88,35 +158,48 @@ isFileSupported(const std::filesystem::path& file, const std::vector<std::filesy
 std::unique_ptr<IGrabber>
 createGrabber(const std::filesystem::path& execPath,
 		const std::filesystem::path& defaultCoverPath,
-		std::size_t maxCacheSize, std::size_t maxFileSize, unsigned jpegQuality)
+		std::size_t maxCacheSize, std::size_t maxFileSize, unsigned jpegQuality, unsigned webpQuality,
+		const std::filesystem::path& diskCacheDirectory, std::size_t maxDiskCacheSize)
 {
-	return std::make_unique<Grabber>(execPath, defaultCoverPath, maxCacheSize, maxFileSize, jpegQuality);
+	return std::make_unique<Grabber>(execPath, defaultCoverPath, maxCacheSize, maxFileSize, jpegQuality, webpQuality, diskCacheDirectory, maxDiskCacheSize);
 }
 
 Grabber::Grabber(const std::filesystem::path& execPath,
 		const std::filesystem::path& defaultCoverPath,
 		std::size_t maxCacheSize,
 		std::size_t maxFileSize,
-		unsigned jpegQuality)
-	: _defaultCoverPath {defaultCoverPath}
+		unsigned jpegQuality,
+		unsigned webpQuality,
+		const std::filesystem::path& diskCacheDirectory,
+		std::size_t maxDiskCacheSize)
+	: _cache {"cover_memory", maxCacheSize}
+	, _defaultCoverPath {defaultCoverPath}
 	, _maxCacheSize {maxCacheSize}
 	, _maxFileSize {maxFileSize}
 	, _jpegQuality {clamp<unsigned>(jpegQuality, 1, 100)}
+	, _webpQuality {clamp<unsigned>(webpQuality, 1, 100)}
 {
 	LMS_LOG(COVER, INFO) << "Default cover path = '" << _defaultCoverPath.string() << "'";
 	LMS_LOG(COVER, INFO) << "Max cache size = " << _maxCacheSize;
 	LMS_LOG(COVER, INFO) << "Max file size = " << _maxFileSize;
 	LMS_LOG(COVER, INFO) << "JPEG export quality = " << _jpegQuality;
+	LMS_LOG(COVER, INFO) << "Max disk cache size = " << maxDiskCacheSize;
+
+	if (maxDiskCacheSize > 0)
+		_diskCache = std::make_unique<DiskCache>(diskCacheDirectory, maxDiskCacheSize);
 
 #if LMS_SUPPORT_IMAGE_GM
 	GraphicsMagick::init(execPath);
+	_webpSupported = GraphicsMagick::isWebPSupported();
 #else
 	(void)execPath;
 #endif
 
+	LMS_LOG(COVER, INFO) << "WebP supported = " << _webpSupported << ", WebP export quality = " << _webpQuality;
+
 	try
 	{
-		getDefault(512);
+		getDefault(512, ImageFormat::JPEG);
 	}
 	catch (const ImageException& e)
 	{
@@ -124,8 +207,22 @@ Grabber::Grabber(const std::filesystem::path& execPath,
 	}
 }
 
+bool
+Grabber::isFormatSupported(ImageFormat format) const
+{
+	switch (format)
+	{
+		case ImageFormat::JPEG:
+			return true;
+		case ImageFormat::WebP:
+			return _webpSupported;
+	}
+
+	return false;
+}
+
 std::unique_ptr<IEncodedImage>
-Grabber::getFromAvMediaFile(const Av::MediaFile& input, ImageSize width) const
+Grabber::getFromAvMediaFile(const Av::MediaFile& input, ImageSize width, ImageFormat format) const
 {
 	std::unique_ptr<IEncodedImage> image;
 
@@ -136,9 +233,7 @@ Grabber::getFromAvMediaFile(const Av::MediaFile& input, ImageSize width) const
 
 		try
 		{
-			RawImage rawImage {picture.data, picture.dataSize};
-			rawImage.resize(width);
-			image = rawImage.encodeToJPEG(_jpegQuality);
+			image = decodeResizeEncode(width, format, _jpegQuality, _webpQuality, picture.data, picture.dataSize);
 		}
 		catch (const ImageException& e)
 		{
@@ -150,15 +245,13 @@ Grabber::getFromAvMediaFile(const Av::MediaFile& input, ImageSize width) const
 }
 
 std::unique_ptr<IEncodedImage>
-Grabber::getFromCoverFile(const std::filesystem::path& p, ImageSize width) const
+Grabber::getFromCoverFile(const std::filesystem::path& p, ImageSize width, ImageFormat format) const
 {
 	std::unique_ptr<IEncodedImage> image;
 
 	try
 	{
-		RawImage rawImage {p};
-		rawImage.resize(width);
-		image = rawImage.encodeToJPEG(_jpegQuality);
+		image = decodeResizeEncode(width, format, _jpegQuality, _webpQuality, p);
 	}
 	catch (const ImageException& e)
 	{
@@ -169,31 +262,32 @@ Grabber::getFromCoverFile(const std::filesystem::path& p, ImageSize width) const
 }
 
 std::shared_ptr<IEncodedImage>
-Grabber::getDefault(ImageSize width)
+Grabber::getDefault(ImageSize width, ImageFormat format)
 {
 	{
-		std::shared_lock lock {_cacheMutex};
+		std::scoped_lock lock {_defaultCoverMutex};
 
-		if (auto it {_defaultCoverCache.find(width)}; it != std::cend(_defaultCoverCache))
+		if (auto it {_defaultCoverCache.find({width, format})}; it != std::cend(_defaultCoverCache))
 			return it->second;
-	}
 
-	{
-		std::unique_lock lock {_cacheMutex};
-
-		if (auto it {_defaultCoverCache.find(width)}; it != std::cend(_defaultCoverCache))
-			return it->second;
-
-		std::shared_ptr<IEncodedImage> image {getFromCoverFile(_defaultCoverPath, width)};
-		_defaultCoverCache[width] = image;
+		std::shared_ptr<IEncodedImage> image {getFromCoverFile(_defaultCoverPath, width, format)};
+		_defaultCoverCache[{width, format}] = image;
 		LMS_LOG(COVER, DEBUG) << "Default cache entries = " << _defaultCoverCache.size();
 
 		return image;
 	}
 }
 
+bool
+Grabber::isDefault(const std::shared_ptr<IEncodedImage>& image)
+{
+	std::scoped_lock lock {_defaultCoverMutex};
+
+	return std::any_of(std::cbegin(_defaultCoverCache), std::cend(_defaultCoverCache), [&](const auto& entry) { return entry.second == image; });
+}
+
 std::unique_ptr<IEncodedImage>
-Grabber::getFromDirectory(const std::filesystem::path& directory, ImageSize width) const
+Grabber::getFromDirectory(const std::filesystem::path& directory, ImageSize width, ImageFormat format) const
 {
 	const std::multimap<std::string, std::filesystem::path> coverPaths {getCoverPaths(directory)};
 
@@ -204,7 +298,7 @@ Grabber::getFromDirectory(const std::filesystem::path& directory, ImageSize widt
 		auto range {coverPaths.equal_range(std::string {fileName})};
 		for (auto it {range.first}; it != range.second; ++it)
 		{
-			image = getFromCoverFile(it->second, width);
+			image = getFromCoverFile(it->second, width, format);
 			if (image)
 				break;
 		}
@@ -223,7 +317,7 @@ Grabber::getFromDirectory(const std::filesystem::path& directory, ImageSize widt
 	// Just pick one
 	for (const auto& [filename, coverPath] : coverPaths)
 	{
-		image = getFromCoverFile(coverPath, width);
+		image = getFromCoverFile(coverPath, width, format);
 		if (image)
 			return image;
 	}
@@ -232,19 +326,13 @@ Grabber::getFromDirectory(const std::filesystem::path& directory, ImageSize widt
 }
 
 std::unique_ptr<IEncodedImage>
-Grabber::getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize width) const
+Grabber::getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize width, ImageFormat format) const
 {
 	std::unique_ptr<IEncodedImage> res;
 
-	std::filesystem::path coverPath {filePath};
-	for (const std::filesystem::path& extension : _fileExtensions)
+	for (const std::filesystem::path& coverPath : getSameNamedCoverPaths(filePath))
 	{
-		coverPath.replace_extension(extension);
-
-		if (!checkCoverFile(coverPath))
-			continue;
-
-		res = getFromCoverFile(coverPath, width);
+		res = getFromCoverFile(coverPath, width, format);
 		if (res)
 			break;
 	}
@@ -252,6 +340,27 @@ Grabber::getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize w
 	return res;
 }
 
+std::vector<std::filesystem::path>
+Grabber::getSameNamedCoverPaths(const std::filesystem::path& filePath) const
+{
+	std::vector<std::filesystem::path> res;
+
+	const std::multimap<std::string, std::filesystem::path> coverPaths {getCoverPaths(filePath.parent_path())};
+	const auto range {coverPaths.equal_range(filePath.stem().string())};
+
+	// In the order of the supported extensions
+	for (const std::filesystem::path& extension : _fileExtensions)
+	{
+		for (auto it {range.first}; it != range.second; ++it)
+		{
+			if (it->second.extension() == extension)
+				res.push_back(it->second);
+		}
+	}
+
+	return res;
+}
+
 bool
 Grabber::checkCoverFile(const std::filesystem::path& filePath) const
 {
@@ -277,6 +386,36 @@ Grabber::checkCoverFile(const std::filesystem::path& filePath) const
 
 std::multimap<std::string, std::filesystem::path>
 Grabber::getCoverPaths(const std::filesystem::path& directoryPath) const
+{
+	// Listing the directory may be slow (network file systems): only do it again if it changed
+	std::error_code ec;
+	const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(directoryPath, ec)};
+	if (ec)
+		return {};
+
+	{
+		std::scoped_lock lock {_coverPathsMutex};
+
+		if (auto it {_coverPathsCache.find(directoryPath)}; it != std::cend(_coverPathsCache) && it->second.lastWriteTime == lastWriteTime)
+			return it->second.coverPaths;
+	}
+
+	std::multimap<std::string, std::filesystem::path> coverPaths {listCoverPaths(directoryPath)};
+
+	{
+		std::scoped_lock lock {_coverPathsMutex};
+
+		if (_coverPathsCache.size() >= _maxCoverPathsCacheEntries)
+			_coverPathsCache.clear();
+
+		_coverPathsCache[directoryPath] = DirectoryCoverPaths {lastWriteTime, coverPaths};
+	}
+
+	return coverPaths;
+}
+
+std::multimap<std::string, std::filesystem::path>
+Grabber::listCoverPaths(const std::filesystem::path& directoryPath) const
 {
 	std::multimap<std::string, std::filesystem::path> res;
 	std::error_code ec;
@@ -297,14 +436,28 @@ Grabber::getCoverPaths(const std::filesystem::path& directoryPath) const
 }
 
 std::unique_ptr<IEncodedImage>
-Grabber::getFromTrack(const std::filesystem::path& p, ImageSize width) const
+Grabber::getFromTrack(const std::filesystem::path& p, ImageSize width, ImageFormat format) const
 {
 	std::unique_ptr<IEncodedImage> image;
 
+	// Reading the tags is much cheaper than opening the file using libavformat
+	if (const std::optional<MetaData::EmbeddedPicture> picture {MetaData::readEmbeddedPicture(p)})
+	{
+		try
+		{
+			return decodeResizeEncode(width, format, _jpegQuality, _webpQuality, picture->data.data(), picture->data.size());
+		}
+		catch (const ImageException& e)
+		{
+			LMS_LOG(COVER, ERROR) << "Cannot read embedded cover: " << e.what();
+		}
+	}
+
 	try
 	{
-		const Av::MediaFile input {p};
-		image = getFromAvMediaFile(input, width);
+		// The scanner already told us there is a cover: no need to probe the streams
+		const Av::MediaFile input {p, false};
+		image = getFromAvMediaFile(input, width, format);
 	}
 	catch (Av::AvException& e)
 	{
@@ -315,61 +468,87 @@ Grabber::getFromTrack(const std::filesystem::path& p, ImageSize width) const
 }
 
 std::shared_ptr<IEncodedImage>
-Grabber::getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width)
+Grabber::getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, ImageFormat format)
 {
-	return getFromTrack(dbSession, trackId, width, true /* allow release fallback*/);
+	return getFromTrack(dbSession, trackId, width, isFormatSupported(format) ? format : ImageFormat::JPEG, true /* allow release fallback*/);
 }
 
 
 
 
 std::shared_ptr<IEncodedImage>
-Grabber::getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, bool allowReleaseFallback)
+Grabber::getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, ImageFormat format, bool allowReleaseFallback)
 {
 	using namespace Database;
 
-	const CacheEntryDesc cacheEntryDesc {CacheEntryDesc::Type::Track, trackId, width};
+	const CacheEntryDesc cacheEntryDesc {CacheEntryDesc::Type::Track, trackId, width, format};
 
-	std::shared_ptr<IEncodedImage> cover {loadFromCache(cacheEntryDesc)};
-	if (cover)
-		return cover;
-
-	if (const std::optional<TrackInfo> trackInfo {getTrackInfo(dbSession, trackId)})
+	// Without release fallback, we are computing a release cover: waiting for a pending track cover could deadlock
+	return getCover(cacheEntryDesc, allowReleaseFallback, [&]
 	{
-		if (trackInfo->hasCover)
-			cover = getFromTrack(trackInfo->trackPath, width);
+		std::optional<std::string> diskCacheKey;
+		std::shared_ptr<IEncodedImage> cover {loadFromDiskCache(dbSession, cacheEntryDesc, diskCacheKey)};
+		if (cover)
+			return cover;
 
-		if (!cover)
-			cover = getFromSameNamedFile(trackInfo->trackPath, width);
+		if (const std::optional<TrackInfo> trackInfo {getTrackInfo(dbSession, trackId)})
+		{
+			if (trackInfo->hasCover)
+				cover = getFromTrack(trackInfo->trackPath, width, format);
 
-		if (!cover && trackInfo->releaseId && allowReleaseFallback)
-			cover = getFromRelease(dbSession, *trackInfo->releaseId, width);
+			if (!cover)
+				cover = getFromSameNamedFile(trackInfo->trackPath, width, format);
 
-		if (!cover && trackInfo->isMultiDisc)
-		{
-			if (trackInfo->trackPath.parent_path().has_parent_path())
-				cover = getFromDirectory(trackInfo->trackPath.parent_path().parent_path(), width);
+			if (!cover && trackInfo->releaseId && allowReleaseFallback)
+				cover = getFromRelease(dbSession, *trackInfo->releaseId, width, format);
+
+			if (!cover && trackInfo->isMultiDisc)
+			{
+				if (trackInfo->trackPath.parent_path().has_parent_path())
+					cover = getFromDirectory(trackInfo->trackPath.parent_path().parent_path(), width, format);
+			}
 		}
-	}
 
-	if (!cover)
-		cover = getDefault(width);
+		if (cover && diskCacheKey && !isDefault(cover))
+			_diskCache->save(*diskCacheKey, *cover);
 
-	if (cover)
-		saveToCache(cacheEntryDesc, cover);
+		if (!cover)
+			cover = getDefault(width, format);
 
-	return cover;
+		return cover;
+	});
 }
 
 std::shared_ptr<IEncodedImage>
-Grabber::getFromRelease(Database::Session& session, Database::IdType releaseId, ImageSize width)
+Grabber::getFromRelease(Database::Session& session, Database::IdType releaseId, ImageSize width, ImageFormat format)
 {
-	const CacheEntryDesc cacheEntryDesc {CacheEntryDesc::Type::Release, releaseId, width};
+	if (!isFormatSupported(format))
+		format = ImageFormat::JPEG;
+
+	const CacheEntryDesc cacheEntryDesc {CacheEntryDesc::Type::Release, releaseId, width, format};
+
+	return getCover(cacheEntryDesc, true, [&]
+	{
+		std::optional<std::string> diskCacheKey;
+		std::shared_ptr<IEncodedImage> cover {loadFromDiskCache(session, cacheEntryDesc, diskCacheKey)};
+		if (cover)
+			return cover;
+
+		cover = computeReleaseCover(session, releaseId, width, format);
+
+		if (cover && diskCacheKey && !isDefault(cover))
+			_diskCache->save(*diskCacheKey, *cover);
+
+		if (!cover)
+			cover = getDefault(width, format);
 
-	std::shared_ptr<IEncodedImage> cover {loadFromCache(cacheEntryDesc)};
-	if (cover)
 		return cover;
+	});
+}
 
+std::shared_ptr<IEncodedImage>
+Grabber::computeReleaseCover(Database::Session& session, Database::IdType releaseId, ImageSize width, ImageFormat format)
+{
 	struct ReleaseInfo
 	{
 		Database::IdType firstTrackId;
@@ -395,65 +574,246 @@ Grabber::getFromRelease(Database::Session& session, Database::IdType releaseId,
 		return res;
 	}};
 
+	std::shared_ptr<IEncodedImage> cover;
+
 	if (const std::optional<ReleaseInfo> releaseInfo {getReleaseInfo()})
 	{
-		cover = getFromDirectory(releaseInfo->releaseDirectory, width);
+		cover = getFromDirectory(releaseInfo->releaseDirectory, width, format);
 		if (!cover)
-			cover = getFromTrack(session, releaseInfo->firstTrackId, width, false /* no release fallback */);
+			cover = getFromTrack(session, releaseInfo->firstTrackId, width, format, false /* no release fallback */);
 	}
 
-	if (!cover)
-		cover = getDefault(width);
+	return cover;
+}
 
-	if (cover)
-		saveToCache(cacheEntryDesc, cover);
+bool
+Grabber::generateReleaseCover(Database::Session& dbSession, Database::IdType releaseId, ImageSize width)
+{
+	if (!_diskCache)
+		return false;
 
-	return cover;
+	const CacheEntryDesc cacheEntryDesc {CacheEntryDesc::Type::Release, releaseId, width, ImageFormat::JPEG};
+
+	const std::optional<CoverSources> sources {getCoverSources(dbSession, cacheEntryDesc.type, cacheEntryDesc.id)};
+	if (!sources)
+		return false;
+
+	const std::string diskCacheKey {getDiskCacheKey(cacheEntryDesc, sources->trackPath)};
+	if (_diskCache->contains(diskCacheKey, sources->lastWriteTime))
+		return false;
+
+	const std::shared_ptr<IEncodedImage> cover {computeReleaseCover(dbSession, releaseId, width, cacheEntryDesc.format)};
+	if (!cover || isDefault(cover))
+		return false;
+
+	_diskCache->save(diskCacheKey, *cover);
+	return true;
+}
+
+std::optional<std::filesystem::file_time_type>
+Grabber::getDirectoryLastWriteTime(const std::filesystem::path& directory) const
+{
+	std::error_code ec;
+	std::filesystem::file_time_type res {std::filesystem::last_write_time(directory, ec)};
+	if (ec)
+		return std::nullopt;
+
+	// Cover files may have been modified in place
+	for (const auto& [name, coverPath] : getCoverPaths(directory))
+	{
+		const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(coverPath, ec)};
+		if (!ec)
+			res = std::max(res, lastWriteTime);
+	}
+
+	return res;
+}
+
+std::optional<Grabber::CoverSources>
+Grabber::getCoverSources(Database::Session& dbSession, CacheEntryDesc::Type type, Database::IdType id) const
+{
+	std::vector<std::filesystem::path> files;
+	std::vector<std::filesystem::path> directories;
+
+	{
+		auto transaction {dbSession.createSharedTransaction()};
+
+		Database::Track::pointer track;
+		switch (type)
+		{
+			case CacheEntryDesc::Type::Track:
+				track = Database::Track::getById(dbSession, id);
+				break;
+
+			case CacheEntryDesc::Type::Release:
+				if (const Database::Release::pointer release {Database::Release::getById(dbSession, id)})
+					track = release->getFirstTrack();
+				break;
+		}
+
+		if (!track)
+			return std::nullopt;
+
+		// Same places as the ones looked into by getFromTrack and getFromRelease
+		const std::filesystem::path trackPath {track->getPath()};
+		files.push_back(trackPath);
+
+		directories.push_back(trackPath.parent_path());
+		if (track->getRelease() && track->getRelease()->getTotalDisc() > 1 && trackPath.parent_path().has_parent_path())
+			directories.push_back(trackPath.parent_path().parent_path());
+	}
+
+	for (const std::filesystem::path& coverPath : getSameNamedCoverPaths(files.front()))
+		files.push_back(coverPath);
+
+	std::error_code ec;
+	std::filesystem::file_time_type res {std::filesystem::last_write_time(files.front(), ec)};
+	if (ec)
+		return std::nullopt;
+
+	// Missing same named files do not matter: creating them updates the directory
+	for (const std::filesystem::path& file : files)
+	{
+		const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(file, ec)};
+		if (!ec)
+			res = std::max(res, lastWriteTime);
+	}
+
+	for (const std::filesystem::path& directory : directories)
+	{
+		const std::optional<std::filesystem::file_time_type> lastWriteTime {getDirectoryLastWriteTime(directory)};
+		if (!lastWriteTime)
+			return std::nullopt;
+
+		res = std::max(res, *lastWriteTime);
+	}
+
+	return CoverSources {files.front(), res};
 }
 
 void
-Grabber::flushCache()
+Grabber::setMaxCacheSize(std::size_t maxCacheSize)
 {
-	std::unique_lock lock {_cacheMutex};
+	if (_maxCacheSize.exchange(maxCacheSize) == maxCacheSize)
+		return;
 
-	LMS_LOG(COVER, DEBUG) << "Cache stats: hits = " << _cacheHits << ", misses = " << _cacheMisses << ", nb entries = " << _cache.size() << ", size = " << _cacheSize;
-	_cacheHits = 0;
-	_cacheMisses = 0;
-	_cacheSize = 0;
-	_cache.clear();
+	LMS_LOG(COVER, INFO) << "Max cache size = " << maxCacheSize;
+	_cache.setMaxWeight(maxCacheSize);
 }
 
 void
-Grabber::saveToCache(const CacheEntryDesc& entryDesc, std::shared_ptr<IEncodedImage> image)
+Grabber::flushCache(Database::Session& dbSession)
 {
-	std::unique_lock lock {_cacheMutex};
+	{
+		const CoverCache::Stats stats {_cache.getStats()};
+		const std::uint64_t requestCount {stats.hits + stats.misses};
+		LMS_LOG(COVER, DEBUG) << "Cache stats: hits = " << stats.hits << ", misses = " << stats.misses
+			<< ", hit ratio = " << (requestCount > 0 ? stats.hits * 100 / requestCount : 0) << "%"
+			<< ", nb entries = " << stats.entryCount << ", size = " << stats.weight;
+	}
+
+	std::map<std::pair<CacheEntryDesc::Type, Database::IdType>, std::filesystem::file_time_type> oldestCachedTimes;
+	_cache.visit([&](const CacheEntryDesc& entryDesc, const CachedCover& cachedCover)
+	{
+		auto [it, inserted] {oldestCachedTimes.emplace(std::make_pair(entryDesc.type, entryDesc.id), cachedCover.cachedTime)};
+		if (!inserted)
+			it->second = std::min(it->second, cachedCover.cachedTime);
+	});
 
-	while (_cacheSize + image->getDataSize() > _maxCacheSize && !_cache.empty())
+	// Checked without holding the lock, entries cached meanwhile are up to date
+	std::map<std::pair<CacheEntryDesc::Type, Database::IdType>, std::optional<std::filesystem::file_time_type>> outdatedSources;
+	for (const auto& [source, oldestCachedTime] : oldestCachedTimes)
 	{
-		auto itRandom {Random::pickRandom(_cache)};
-		_cacheSize -= itRandom->second->getDataSize();
-		_cache.erase(itRandom);
+		const std::optional<CoverSources> sources {getCoverSources(dbSession, source.first, source.second)};
+		if (!sources || sources->lastWriteTime >= oldestCachedTime)
+			outdatedSources.emplace(source, sources ? std::make_optional(sources->lastWriteTime) : std::nullopt);
 	}
 
-	_cacheSize += image->getDataSize();
-	_cache[entryDesc] = image;
+	if (outdatedSources.empty())
+		return;
+
+	const std::size_t removedCount {_cache.eraseIf([&](const CacheEntryDesc& entryDesc, const CachedCover& cachedCover)
+	{
+		auto itSource {outdatedSources.find(std::make_pair(entryDesc.type, entryDesc.id))};
+		if (itSource == std::cend(outdatedSources))
+			return false;
+
+		// Entries cached after the sources changed (during the check for example) are up to date
+		const std::optional<std::filesystem::file_time_type>& lastWriteTime {itSource->second};
+		return !lastWriteTime || *lastWriteTime >= cachedCover.cachedTime;
+	})};
+
+	LMS_LOG(COVER, DEBUG) << "Removed " << removedCount << " outdated cache entries";
 }
 
 std::shared_ptr<IEncodedImage>
-Grabber::loadFromCache(const CacheEntryDesc& entryDesc)
+Grabber::getCover(const CacheEntryDesc& entryDesc, bool singleFlight, const std::function<std::shared_ptr<IEncodedImage>()>& computeCover)
 {
-	std::shared_lock lock {_cacheMutex};
+	Tracing::Span span {"cover.get"};
 
-	auto it {_cache.find(entryDesc)};
-	if (it == std::cend(_cache))
+	auto loadCover {[&]() -> std::optional<CachedCover>
 	{
-		++_cacheMisses;
-		return nullptr;
+		const Metrics::ScopedTimer timer {computeDuration};
+		const Tracing::Span computeSpan {"cover.compute"};
+
+		std::shared_ptr<IEncodedImage> cover {computeCover()};
+		if (!cover)
+			return std::nullopt;
+
+		return CachedCover {std::move(cover), std::filesystem::file_time_type::clock::now()};
+	}};
+
+	if (!singleFlight)
+	{
+		if (std::optional<CachedCover> cachedCover {_cache.get(entryDesc)})
+		{
+			span.setAttribute("source", "memory");
+			return cachedCover->image;
+		}
+
+		span.setAttribute("source", "computed");
+		std::optional<CachedCover> cachedCover {loadCover()};
+		if (!cachedCover)
+			return nullptr;
+
+		_cache.put(entryDesc, *cachedCover);
+		return cachedCover->image;
+	}
+
+	CoverCache::LoadSource source {};
+	const std::optional<CachedCover> cachedCover {_cache.getOrLoad(entryDesc, loadCover, &source)};
+	switch (source)
+	{
+		case CoverCache::LoadSource::Cache:			span.setAttribute("source", "memory"); break;
+		case CoverCache::LoadSource::PendingLoad:	span.setAttribute("source", "pending"); break;
+		case CoverCache::LoadSource::Loader:		span.setAttribute("source", "computed"); break;
 	}
 
-	++_cacheHits;
-	return it->second;
+	return cachedCover ? cachedCover->image : nullptr;
 }
 
-} // namespace CoverArt
+std::shared_ptr<IEncodedImage>
+Grabber::loadFromDiskCache(Database::Session& dbSession, const CacheEntryDesc& entryDesc, std::optional<std::string>& diskCacheKey)
+{
+	if (!_diskCache)
+		return nullptr;
+
+	Tracing::Span span {"cover.disk_cache_load"};
+
+	const std::optional<CoverSources> sources {getCoverSources(dbSession, entryDesc.type, entryDesc.id)};
+	if (!sources)
+		return nullptr;
 
+	diskCacheKey = getDiskCacheKey(entryDesc, sources->trackPath);
+
+	std::shared_ptr<IEncodedImage> image {_diskCache->load(*diskCacheKey, sources->lastWriteTime)};
+	span.setAttribute("hit", image ? "true" : "false");
+	if (image)
+		diskCacheHits.inc();
+	else
+		diskCacheMisses.inc();
+
+	return image;
+}
+
+} // namespace CoverArt
@@ -21,9 +21,11 @@
 
 #include <atomic>
 #include <filesystem>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
-#include <shared_mutex>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
@@ -31,6 +33,10 @@
 #include "cover/ICoverArtGrabber.hpp"
 #include "cover/IEncodedImage.hpp"
 #include "database/Types.hpp"
+#include "utils/Path.hpp"
+#include "utils/ProfiledMutex.hpp"
+#include "utils/ShardedCache.hpp"
+#include "DiskCache.hpp"
 
 namespace Database
 {
@@ -55,12 +61,14 @@ namespace CoverArt
 		Type				type;
 		Database::IdType	id;
 		std::size_t			size;
+		ImageFormat			format;
 
 		bool operator==(const CacheEntryDesc& other) const
 		{
 			return type == other.type
 				&& id == other.id
-				&& size == other.size;
+				&& size == other.size
+				&& format == other.format;
 		}
 	};
 
@@ -78,6 +86,7 @@ namespace std
 				size_t h = std::hash<int>()(static_cast<int>(e.type));
 				h ^= std::hash<Database::IdType>()(e.id) << 1;
 				h ^= std::hash<std::size_t>()(e.size) << 1;
+				h ^= std::hash<int>()(static_cast<int>(e.format)) << 1;
 				return h;
 			}
 	};
@@ -93,7 +102,10 @@ namespace CoverArt
 					const std::filesystem::path& defaultCoverPath,
 					std::size_t maxCacheEntries,
 					std::size_t maxFileSize,
-					unsigned jpegQuality);
+					unsigned jpegQuality,
+					unsigned webpQuality,
+					const std::filesystem::path& diskCacheDirectory,
+					std::size_t maxDiskCacheSize);
 
 			Grabber(const Grabber&) = delete;
 			Grabber& operator=(const Grabber&) = delete;
@@ -101,38 +113,79 @@ namespace CoverArt
 			Grabber& operator=(Grabber&&) = delete;
 
 		private:
-			std::shared_ptr<IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width) override;
-			std::shared_ptr<IEncodedImage>	getFromRelease(Database::Session& dbSession, Database::IdType releaseId, ImageSize width) override;
-			void							flushCache() override;
-
-			std::shared_ptr<IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, bool allowReleaseFallback);
-			std::unique_ptr<IEncodedImage>	getFromAvMediaFile(const Av::MediaFile& input, ImageSize width) const;
-			std::unique_ptr<IEncodedImage>	getFromCoverFile(const std::filesystem::path& p, ImageSize width) const;
-
-			std::unique_ptr<IEncodedImage>	getFromTrack(const std::filesystem::path& path, ImageSize width) const;
+			bool							isFormatSupported(ImageFormat format) const override;
+			std::shared_ptr<IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, ImageFormat format) override;
+			std::shared_ptr<IEncodedImage>	getFromRelease(Database::Session& dbSession, Database::IdType releaseId, ImageSize width, ImageFormat format) override;
+			void							setMaxCacheSize(std::size_t maxCacheSize) override;
+			void							flushCache(Database::Session& dbSession) override;
+			bool							generateReleaseCover(Database::Session& dbSession, Database::IdType releaseId, ImageSize width) override;
+
+			std::shared_ptr<IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, ImageFormat format, bool allowReleaseFallback);
+			std::shared_ptr<IEncodedImage>	computeReleaseCover(Database::Session& dbSession, Database::IdType releaseId, ImageSize width, ImageFormat format);
+			std::unique_ptr<IEncodedImage>	getFromAvMediaFile(const Av::MediaFile& input, ImageSize width, ImageFormat format) const;
+			std::unique_ptr<IEncodedImage>	getFromCoverFile(const std::filesystem::path& p, ImageSize width, ImageFormat format) const;
+
+			std::unique_ptr<IEncodedImage>	getFromTrack(const std::filesystem::path& path, ImageSize width, ImageFormat format) const;
 			std::multimap<std::string, std::filesystem::path>	getCoverPaths(const std::filesystem::path& directoryPath) const;
-			std::unique_ptr<IEncodedImage>	getFromDirectory(const std::filesystem::path& directory, ImageSize width) const;
-			std::unique_ptr<IEncodedImage>	getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize width) const;
-			std::shared_ptr<IEncodedImage>	getDefault(ImageSize width);
+			std::multimap<std::string, std::filesystem::path>	listCoverPaths(const std::filesystem::path& directoryPath) const;
+			std::vector<std::filesystem::path>	getSameNamedCoverPaths(const std::filesystem::path& filePath) const;
+			std::unique_ptr<IEncodedImage>	getFromDirectory(const std::filesystem::path& directory, ImageSize width, ImageFormat format) const;
+			std::unique_ptr<IEncodedImage>	getFromSameNamedFile(const std::filesystem::path& filePath, ImageSize width, ImageFormat format) const;
+			std::shared_ptr<IEncodedImage>	getDefault(ImageSize width, ImageFormat format);
+			bool							isDefault(const std::shared_ptr<IEncodedImage>& image);
 
 			bool							checkCoverFile(const std::filesystem::path& directoryPath) const;
 
-			std::shared_mutex _cacheMutex;
-			std::unordered_map<CacheEntryDesc, std::shared_ptr<IEncodedImage>> _cache;
-			std::unordered_map<ImageSize, std::shared_ptr<IEncodedImage>> _defaultCoverCache;
-			std::atomic<std::size_t>	_cacheMisses {};
-			std::atomic<std::size_t>	_cacheHits {};
-			std::size_t					_cacheSize {};
+			struct CoverSources
+			{
+				std::filesystem::path				trackPath;		// track the cover is looked up from
+				std::filesystem::file_time_type		lastWriteTime;	// last write time of the files and directories the cover may have been read from
+			};
+			// none if the cover cannot be found anymore
+			std::optional<CoverSources>	getCoverSources(Database::Session& dbSession, CacheEntryDesc::Type type, Database::IdType id) const;
+			std::optional<std::filesystem::file_time_type>	getDirectoryLastWriteTime(const std::filesystem::path& directory) const;
+
+			// Size aware LRU cache
+			struct CachedCover
+			{
+				std::shared_ptr<IEncodedImage>		image;
+				std::filesystem::file_time_type		cachedTime;
+			};
+			struct CachedCoverWeigher
+			{
+				std::size_t operator()(const CachedCover& cover) const { return cover.image->getDataSize(); }
+			};
+			using CoverCache = ShardedCache<CacheEntryDesc, CachedCover, CachedCoverWeigher>;
+			CoverCache _cache;
+
+			ProfiledMutex _defaultCoverMutex {"cover_default_cache"};
+			std::map<std::pair<ImageSize, ImageFormat>, std::shared_ptr<IEncodedImage>> _defaultCoverCache;
+
+			// Second tier, only for the covers actually found
+			std::shared_ptr<IEncodedImage> loadFromDiskCache(Database::Session& dbSession, const CacheEntryDesc& entryDesc, std::optional<std::string>& diskCacheKey);
+			std::unique_ptr<DiskCache> _diskCache;
+
+			// Cover files found in each directory, valid as long as the directory last write time does not change
+			struct DirectoryCoverPaths
+			{
+				std::filesystem::file_time_type						lastWriteTime;
+				std::multimap<std::string, std::filesystem::path>	coverPaths;
+			};
+			static constexpr std::size_t _maxCoverPathsCacheEntries {10000};
+			mutable std::mutex _coverPathsMutex;
+			mutable std::unordered_map<std::filesystem::path, DirectoryCoverPaths> _coverPathsCache;
 
-			void saveToCache(const CacheEntryDesc& entryDesc, std::shared_ptr<IEncodedImage> image);
-			std::shared_ptr<IEncodedImage> loadFromCache(const CacheEntryDesc& entryDesc);
+			// Single flight: concurrent misses for the same entry wait for the cover being computed by the first one
+			std::shared_ptr<IEncodedImage> getCover(const CacheEntryDesc& entryDesc, bool singleFlight, const std::function<std::shared_ptr<IEncodedImage>()>& computeCover);
 
 			const std::filesystem::path _defaultCoverPath;
-			const std::size_t _maxCacheSize;
+			std::atomic<std::size_t> _maxCacheSize;
 			static inline const std::vector<std::filesystem::path> _fileExtensions {".jpg", ".jpeg", ".png", ".bmp"}; // TODO parametrize
 			const std::size_t _maxFileSize;
 			static inline const std::vector<std::string> _preferredFileNames {"cover", "front"}; // TODO parametrize
 			const unsigned _jpegQuality;
+			const unsigned _webpQuality;
+			bool _webpSupported {};
 	};
 
 } // namespace CoverArt
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DiskCache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "utils/Logger.hpp"
+#include "EncodedImage.hpp"
+
+namespace CoverArt {
+
+namespace {
+
+constexpr const char* pendingFileExtension {".tmp"};
+
+// Pending files may be written by another process: only remove them once they are not written anymore
+constexpr std::chrono::hours stalePendingFileAge {1};
+// Entries added or evicted by the other processes sharing the directory
+constexpr std::chrono::minutes syncPeriod {1};
+
+std::optional<std::string_view>
+getMimeType(const std::filesystem::path& extension)
+{
+	if (extension == ".jpg")
+		return "image/jpeg";
+	if (extension == ".webp")
+		return "image/webp";
+
+	return std::nullopt;
+}
+
+} // namespace
+
+DiskCache::DiskCache(const std::filesystem::path& directory, std::uintmax_t maxSize)
+	: _directory {directory}
+	, _maxSize {maxSize}
+{
+	std::filesystem::create_directories(_directory);
+
+	loadEntries();
+	evictEntries();
+
+	LMS_LOG(COVER, INFO) << "Disk cache: " << _entries.size() << " entries, " << _totalSize << "/" << _maxSize << " bytes";
+}
+
+std::filesystem::path
+DiskCache::getEntryPath(const std::string& key) const
+{
+	return _directory / key;
+}
+
+void
+DiskCache::loadEntries()
+{
+	std::vector<std::pair<std::filesystem::file_time_type, Entry>> entries;
+
+	std::error_code ec;
+	for (std::filesystem::directory_iterator itFile {_directory, ec}; !ec && itFile != std::filesystem::directory_iterator {}; itFile.increment(ec))
+	{
+		const std::filesystem::path& path {itFile->path()};
+
+		if (path.extension() == pendingFileExtension)
+		{
+			// Write interrupted by a restart, or still in progress in another process
+			std::error_code timeEc;
+			const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(path, timeEc)};
+			if (timeEc || std::filesystem::file_time_type::clock::now() - lastWriteTime > stalePendingFileAge)
+				std::filesystem::remove(path, timeEc);
+			continue;
+		}
+
+		if (!getMimeType(path.extension()))
+			continue;
+
+		Entry entry;
+		entry.key = path.filename().string();
+		entry.size = std::filesystem::file_size(path, ec);
+		const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(path, ec)};
+		if (!ec)
+			entries.emplace_back(lastWriteTime, std::move(entry));
+	}
+
+	std::sort(std::begin(entries), std::end(entries), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	for (auto& [lastWriteTime, entry] : entries)
+	{
+		_totalSize += entry.size;
+		_entries.push_back(std::move(entry));
+		_entriesByKey.emplace(_entries.back().key, std::prev(std::end(_entries)));
+	}
+
+	_lastSyncTime = std::chrono::steady_clock::now();
+}
+
+void
+DiskCache::syncEntriesIfNeeded()
+{
+	if (std::chrono::steady_clock::now() - _lastSyncTime < syncPeriod)
+		return;
+
+	_entries.clear();
+	_entriesByKey.clear();
+	_totalSize = 0;
+
+	loadEntries();
+}
+
+std::unique_ptr<IEncodedImage>
+DiskCache::load(const std::string& key, std::filesystem::file_time_type sourcesLastWriteTime)
+{
+	const std::filesystem::path path {getEntryPath(key)};
+
+	std::scoped_lock lock {_mutex};
+
+	const std::optional<Entries::iterator> entry {findUpToDateEntry(key, sourcesLastWriteTime)};
+	if (!entry)
+		return nullptr;
+
+	std::vector<std::byte> data;
+	{
+		// Files are replaced using renames: the opened one cannot change while being read, but may differ from the known entry
+		std::ifstream ifs {path, std::ios::binary | std::ios::ate};
+		const std::streamoff size {ifs ? static_cast<std::streamoff>(ifs.tellg()) : 0};
+		if (size > 0)
+		{
+			_totalSize = _totalSize - (*entry)->size + static_cast<std::uintmax_t>(size);
+			(*entry)->size = static_cast<std::uintmax_t>(size);
+
+			data.resize(static_cast<std::size_t>(size));
+			ifs.seekg(0);
+			ifs.read(reinterpret_cast<char*>(data.data()), data.size());
+		}
+		if (size <= 0 || !ifs)
+		{
+			LMS_LOG(COVER, ERROR) << "Disk cache: cannot read file '" << path.string() << "'";
+			removeEntry(*entry);
+			return nullptr;
+		}
+	}
+
+	_entries.splice(std::begin(_entries), _entries, *entry);
+	std::error_code ec;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+	return std::make_unique<EncodedImage>(std::move(data), *getMimeType(path.extension()));
+}
+
+bool
+DiskCache::contains(const std::string& key, std::filesystem::file_time_type sourcesLastWriteTime)
+{
+	std::scoped_lock lock {_mutex};
+
+	return findUpToDateEntry(key, sourcesLastWriteTime).has_value();
+}
+
+std::optional<DiskCache::Entries::iterator>
+DiskCache::findUpToDateEntry(const std::string& key, std::filesystem::file_time_type sourcesLastWriteTime)
+{
+	const std::filesystem::path path {getEntryPath(key)};
+
+	auto itEntry {_entriesByKey.find(key)};
+	if (itEntry == std::cend(_entriesByKey))
+	{
+		// Saved by another process
+		std::error_code ec;
+		const std::uintmax_t size {std::filesystem::file_size(path, ec)};
+		if (ec || !getMimeType(path.extension()))
+			return std::nullopt;
+
+		_totalSize += size;
+		_entries.push_front(Entry {key, size});
+		itEntry = _entriesByKey.emplace(key, std::begin(_entries)).first;
+	}
+
+	std::error_code ec;
+	const std::filesystem::file_time_type lastWriteTime {std::filesystem::last_write_time(path, ec)};
+	if (ec || lastWriteTime <= sourcesLastWriteTime)
+	{
+		LMS_LOG(COVER, DEBUG) << "Disk cache: removing outdated entry '" << key << "'";
+		removeEntry(itEntry->second);
+		return std::nullopt;
+	}
+
+	return itEntry->second;
+}
+
+void
+DiskCache::save(const std::string& key, const IEncodedImage& image)
+{
+	if (image.getDataSize() == 0 || image.getDataSize() > _maxSize)
+		return;
+
+	if (getMimeType(std::filesystem::path {key}.extension()) != image.getMimeType())
+	{
+		LMS_LOG(COVER, ERROR) << "Disk cache: key '" << key << "' does not match the image type '" << image.getMimeType() << "'";
+		return;
+	}
+
+	std::scoped_lock lock {_mutex};
+
+	syncEntriesIfNeeded();
+
+	const std::filesystem::path pendingFile {_directory / (key + "-" + std::to_string(::getpid()) + "-" + std::to_string(_nextId++) + pendingFileExtension)};
+	const std::filesystem::path path {getEntryPath(key)};
+
+	std::error_code ec;
+	{
+		std::ofstream ofs {pendingFile, std::ios::binary | std::ios::trunc};
+		ofs.write(reinterpret_cast<const char*>(image.getData()), image.getDataSize());
+		ofs.close();
+		if (!ofs)
+		{
+			LMS_LOG(COVER, ERROR) << "Disk cache: cannot write file '" << pendingFile.string() << "'";
+			std::filesystem::remove(pendingFile, ec);
+			return;
+		}
+	}
+
+	if (const auto itEntry {_entriesByKey.find(key)}; itEntry != std::cend(_entriesByKey))
+	{
+		_totalSize -= itEntry->second->size;
+		_entries.erase(itEntry->second);
+		_entriesByKey.erase(itEntry);
+	}
+
+	// Replaces the outdated file, if any
+	std::filesystem::rename(pendingFile, path, ec);
+	if (ec)
+	{
+		LMS_LOG(COVER, ERROR) << "Disk cache: cannot rename file '" << pendingFile.string() << "': " << ec.message();
+		std::filesystem::remove(pendingFile, ec);
+		std::filesystem::remove(path, ec);
+		return;
+	}
+
+	_totalSize += image.getDataSize();
+	_entries.push_front(Entry {key, image.getDataSize()});
+	_entriesByKey.emplace(key, std::begin(_entries));
+
+	evictEntries();
+}
+
+void
+DiskCache::removeEntry(Entries::iterator itEntry)
+{
+	std::error_code ec;
+	std::filesystem::remove(getEntryPath(itEntry->key), ec);
+
+	_totalSize -= itEntry->size;
+	_entriesByKey.erase(itEntry->key);
+	_entries.erase(itEntry);
+}
+
+void
+DiskCache::evictEntries()
+{
+	while (_totalSize > _maxSize && !_entries.empty())
+		removeEntry(std::prev(std::end(_entries)));
+}
+
+} // namespace CoverArt
+
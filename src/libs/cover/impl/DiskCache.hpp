@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "cover/IEncodedImage.hpp"
+
+namespace CoverArt
+{
+	// On disk second tier of the cover cache, so that resized covers survive restarts
+	// Each entry is an image file named after its key, that is valid as long as it is more recent than the sources of the cover
+	// Keys end with the file extension of the image format (.jpg, .webp)
+	// The least recently used entries are removed first when the size limit is reached (file last write times are refreshed on each hit)
+	// The directory can be shared by several processes: files are published using renames, entries saved by the other processes
+	// are picked up on lookup, and the directory is listed again from time to time to evict using the actual total size
+	class DiskCache
+	{
+		public:
+			DiskCache(const std::filesystem::path& directory, std::uintmax_t maxSize);
+
+			DiskCache(const DiskCache&) = delete;
+			DiskCache(DiskCache&&) = delete;
+			DiskCache& operator=(const DiskCache&) = delete;
+			DiskCache& operator=(DiskCache&&) = delete;
+
+			// Outdated entries are removed
+			std::unique_ptr<IEncodedImage> load(const std::string& key, std::filesystem::file_time_type sourcesLastWriteTime);
+			bool contains(const std::string& key, std::filesystem::file_time_type sourcesLastWriteTime);
+			void save(const std::string& key, const IEncodedImage& image);
+
+		private:
+			struct Entry
+			{
+				std::string		key;
+				std::uintmax_t	size {};
+			};
+			using Entries = std::list<Entry>; // most recently used first
+
+			std::filesystem::path getEntryPath(const std::string& key) const;
+			void loadEntries();
+			void syncEntriesIfNeeded();
+			// Outdated entries are removed
+			std::optional<Entries::iterator> findUpToDateEntry(const std::string& key, std::filesystem::file_time_type sourcesLastWriteTime);
+			void removeEntry(Entries::iterator itEntry);
+			void evictEntries();
+
+			const std::filesystem::path	_directory;
+			const std::uintmax_t		_maxSize;
+
+			std::mutex		_mutex;
+			Entries			_entries;
+			std::unordered_map<std::string, Entries::iterator> _entriesByKey;
+			std::uintmax_t	_totalSize {};
+			std::size_t		_nextId {};
+			std::chrono::steady_clock::time_point	_lastSyncTime;
+	};
+
+} // namespace CoverArt
+
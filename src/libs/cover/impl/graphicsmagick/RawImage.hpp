@@ -27,6 +27,7 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <optional>
 
 #include "cover/IEncodedImage.hpp"
 #include "IRawImage.hpp"
@@ -35,17 +36,23 @@ namespace CoverArt::GraphicsMagick
 {
 	void init(const std::filesystem::path& path);
 
+	// Depends on how GraphicsMagick has been built (libwebp)
+	bool isWebPSupported();
+
 	class RawImage : IRawImage
 	{
 		public:
-			RawImage(const std::byte* encodedData, std::size_t encodedDataSize);
-			RawImage(const std::filesystem::path& path);
+			// If set, the image may be decoded at a lower resolution, still larger than sizeHint (only meant to be resized down to sizeHint)
+			RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint = std::nullopt);
+			RawImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint = std::nullopt);
 
 			void resize(ImageSize width) override;
 			std::unique_ptr<IEncodedImage> encodeToJPEG(unsigned quality) const override;
+			std::unique_ptr<IEncodedImage> encodeToWebP(unsigned quality) const;
 
 		private:
 			friend class JPEGImage;
+			friend class WebPImage;
 			Magick::Image getMagickImage() const;
 
 			Magick::Image _image;
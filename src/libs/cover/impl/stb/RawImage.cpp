@@ -34,7 +34,8 @@
 
 namespace CoverArt::STB
 {
-	RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize)
+	// stb_image cannot decode at a lower resolution
+	RawImage::RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize>)
 	{
 		int n;
 		_data = UniquePtrFree {stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encodedData), encodedDataSize, &_width, &_height, &n, 3), std::free};
@@ -42,7 +43,7 @@ namespace CoverArt::STB
 			throw ImageException {"Cannot load image from memory"};
 	}
 
-	RawImage::RawImage(const std::filesystem::path& p)
+	RawImage::RawImage(const std::filesystem::path& p, std::optional<ImageSize>)
 	{
 		int n;
 		_data = UniquePtrFree {stbi_load(p.string().c_str(), &_width, &_height, &n, 3), std::free};
@@ -68,6 +69,10 @@ namespace CoverArt::STB
 			width = (size_t)((float)height/_height*_width);
 		}
 
+		// The filtered resize is expensive on large images: first halve them with a cheap box filter, as long as they stay twice larger than the target
+		while (static_cast<std::size_t>(_width / 2) >= 2 * width && static_cast<std::size_t>(_height / 2) >= 2 * height)
+			halve();
+
 		UniquePtrFree resizedData {reinterpret_cast<unsigned char*>(malloc(width*height*3)), std::free};
 		if (!resizedData)
 			throw ImageException {"Cannot allocate memory for resized image!"};
@@ -84,6 +89,36 @@ namespace CoverArt::STB
 		_width = width;
 	}
 
+	void
+	RawImage::halve()
+	{
+		const int halvedWidth {_width / 2};
+		const int halvedHeight {_height / 2};
+		const std::size_t stride {static_cast<std::size_t>(_width) * 3};
+
+		// In place: each output pixel is written before or at the first of its source pixels
+		unsigned char* data {_data.get()};
+		for (int y {}; y < halvedHeight; ++y)
+		{
+			const unsigned char* row0 {data + 2 * y * stride};
+			const unsigned char* row1 {row0 + stride};
+			unsigned char* out {data + static_cast<std::size_t>(y) * halvedWidth * 3};
+
+			for (int x {}; x < halvedWidth; ++x)
+			{
+				for (int c {}; c < 3; ++c)
+					out[c] = static_cast<unsigned char>((row0[c] + row0[c + 3] + row1[c] + row1[c + 3] + 2) / 4);
+
+				out += 3;
+				row0 += 6;
+				row1 += 6;
+			}
+		}
+
+		_width = halvedWidth;
+		_height = halvedHeight;
+	}
+
 	std::unique_ptr<IEncodedImage>
 	RawImage::encodeToJPEG(unsigned quality) const
 	{
@@ -25,6 +25,7 @@
 
 #include <cstddef>
 #include <filesystem>
+#include <optional>
 
 #include "cover/IEncodedImage.hpp"
 #include "IRawImage.hpp"
@@ -34,8 +35,9 @@ namespace CoverArt::STB
 	class RawImage : public IRawImage
 	{
 		public:
-			RawImage(const std::byte* encodedData, std::size_t encodedDataSize);
-			RawImage(const std::filesystem::path& path);
+			// If set, the image may be decoded at a lower resolution, still larger than sizeHint (only meant to be resized down to sizeHint)
+			RawImage(const std::byte* encodedData, std::size_t encodedDataSize, std::optional<ImageSize> sizeHint = std::nullopt);
+			RawImage(const std::filesystem::path& path, std::optional<ImageSize> sizeHint = std::nullopt);
 
 			void resize(ImageSize width) override;
 			std::unique_ptr<IEncodedImage> encodeToJPEG(unsigned quality) const override;
@@ -45,6 +47,8 @@ namespace CoverArt::STB
 			const std::byte* getData() const;
 
 		private:
+			void halve();
+
 			int _width;
 			int _height;
 			using UniquePtrFree = std::unique_ptr<unsigned char, decltype(&std::free)>;
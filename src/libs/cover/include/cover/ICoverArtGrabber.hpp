@@ -37,17 +37,31 @@ namespace CoverArt
 		public:
 			virtual ~IGrabber() = default;
 
-			virtual std::shared_ptr<IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width) = 0;
-			virtual std::shared_ptr<IEncodedImage>	getFromRelease(Database::Session& dbSession, Database::IdType releaseId, ImageSize width) = 0;
+			// Unsupported formats fall back to JPEG
+			virtual bool							isFormatSupported(ImageFormat format) const = 0;
 
-			virtual void flushCache() = 0;
+			virtual std::shared_ptr<IEncodedImage>	getFromTrack(Database::Session& dbSession, Database::IdType trackId, ImageSize width, ImageFormat format = ImageFormat::JPEG) = 0;
+			virtual std::shared_ptr<IEncodedImage>	getFromRelease(Database::Session& dbSession, Database::IdType releaseId, ImageSize width, ImageFormat format = ImageFormat::JPEG) = 0;
+
+			// Size of the memory cache, in bytes: least recently used covers are removed at once if lowered
+			virtual void setMaxCacheSize(std::size_t maxCacheSize) = 0;
+
+			// Removes the cached covers whose sources (track files, cover files, directories) changed since they were cached
+			virtual void flushCache(Database::Session& dbSession) = 0;
+
+			// Stores the JPEG release cover in the disk cache, if not already up to date there
+			// Returns false if nothing was generated (up to date, no cover found or no disk cache)
+			virtual bool generateReleaseCover(Database::Session& dbSession, Database::IdType releaseId, ImageSize width) = 0;
 	};
 
 	std::unique_ptr<IGrabber> createGrabber(const std::filesystem::path& execPath,
 			const std::filesystem::path& defaultCoverPath,
 			std::size_t maxCacheEntries,
 			std::size_t maxFileSize,
-			unsigned jpegQuality);
+			unsigned jpegQuality,
+			unsigned webpQuality,
+			const std::filesystem::path& diskCacheDirectory,
+			std::size_t maxDiskCacheSize); // 0 to disable the disk cache
 
 } // namespace CoverArt
 
@@ -26,6 +26,12 @@ namespace CoverArt
 {
 	using ImageSize = std::size_t;
 
+	enum class ImageFormat
+	{
+		JPEG,
+		WebP,
+	};
+
 	class IEncodedImage
 	{
 		public:
@@ -27,6 +27,7 @@
 #include "database/User.hpp"
 #include "utils/Logger.hpp"
 #include "SqlQuery.hpp"
+#include "Utils.hpp"
 
 
 namespace Database
@@ -35,7 +36,7 @@ namespace Database
 Artist::Artist(const std::string& name, const std::optional<UUID>& MBID)
 : _name {std::string(name, 0 , _maxNameLength)},
 _sortName {_name},
-_MBID {MBID ? MBID->getAsString() : ""}
+_MBID {MBID ? MBID->getAsBytes() : std::vector<unsigned char> {}}
 {
 
 }
@@ -53,14 +54,23 @@ Artist::pointer
 Artist::getByMBID(Session& session, const UUID& mbid)
 {
 	session.checkSharedLocked();
-	return session.getDboSession().find<Artist>().where("mbid = ?").bind(std::string {mbid.getAsString()});
+	return session.getDboSession().find<Artist>().where("mbid = ?").bind(mbid.getAsBytes());
 }
 
 Artist::pointer
 Artist::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
-	return session.getDboSession().find<Artist>().where("id = ?").bind(id);
+
+	return Utils::getById<Artist>(session.getDboSession(), id);
+}
+
+std::vector<Artist::pointer>
+Artist::getByIds(Session& session, const std::vector<IdType>& ids)
+{
+	session.checkSharedLocked();
+
+	return Utils::getByIdsInOrder<Artist>(session.getDboSession(), "artist", ids);
 }
 
 Artist::pointer
@@ -92,7 +102,12 @@ createQuery(Session& session,
 	if (linkType)
 		query.where("t_a_l.type = ?").bind(*linkType);
 
-	if (!keywords.empty())
+	if (!keywords.empty() && Utils::canUseSearchIndex(session, keywords))
+	{
+		// keywords may match either the name or the sort name
+		query.where("a.id IN (SELECT rowid FROM artist_fts WHERE artist_fts MATCH ?)").bind(Utils::getSearchIndexMatchQuery(keywords));
+	}
+	else if (!keywords.empty())
 	{
 		std::vector<std::string> clauses;
 		std::vector<std::string> sortClauses;
@@ -112,7 +127,9 @@ createQuery(Session& session,
 		query.where("(" + StringUtils::joinStrings(clauses, " AND ") + ") OR (" + StringUtils::joinStrings(sortClauses, " AND ") + ")");
 	}
 
-	if (!clusterIds.empty())
+	// Multiple clusters: intersect them using the in memory index if the result is small enough
+	const bool filteredOnClusters {clusterIds.size() > 1 && Utils::filterOnClustersUsingIndex(session, query, clusterIds, "a.id IN (SELECT t_a_l.artist_id FROM track_artist_link t_a_l WHERE t_a_l.track_id IN (", "))")};
+	if (!clusterIds.empty() && !filteredOnClusters)
 	{
 		std::ostringstream oss;
 		oss << "a.id IN (SELECT DISTINCT a.id FROM artist a"
@@ -220,12 +237,7 @@ Artist::getAllIdsRandom(Session& session, const std::set<IdType>& clusters, std:
 
 	auto query {createQuery<IdType>(session, "SELECT DISTINCT a.id from artist a", clusters, {}, linkType)};
 
-	Wt::Dbo::collection<IdType> res = query
-		.orderBy("RANDOM()")
-		.limit(size ? static_cast<int>(*size) : -1);
-
-	return std::vector<IdType>(res.begin(), res.end());
-
+	return Utils::fetchRandomIds(query, size);
 }
 
 std::vector<Artist::pointer>
@@ -237,6 +249,31 @@ Artist::getAllOrphans(Session& session)
 	return std::vector<pointer>(res.begin(), res.end());
 }
 
+std::size_t
+Artist::removeAllOrphans(Session& session)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().flush();
+	session.getDboSession().execute("DELETE FROM artist WHERE NOT EXISTS(SELECT 1 FROM track t INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = artist.id WHERE t.id = t_a_l.track_id)");
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
+void
+Artist::updateAggregates(Session& session)
+{
+	session.checkUniqueLocked();
+
+	const std::string releaseCount {"(SELECT COUNT(DISTINCT t.release_id) FROM track t INNER JOIN track_artist_link t_a_l ON t_a_l.track_id = t.id WHERE t_a_l.artist_id = artist.id)"};
+	const std::string trackCount {"(SELECT COUNT(DISTINCT t_a_l.track_id) FROM track_artist_link t_a_l WHERE t_a_l.artist_id = artist.id)"};
+
+	// Only write the artists that actually changed
+	session.getDboSession().flush();
+	session.getDboSession().execute("UPDATE artist SET release_count = " + releaseCount + ", track_count = " + trackCount
+			+ " WHERE release_count IS NOT " + releaseCount + " OR track_count IS NOT " + trackCount);
+}
+
 std::vector<IdType>
 Artist::getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit)
 {
@@ -251,6 +288,30 @@ Artist::getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit
 	return std::vector<IdType>(res.begin(), res.end());
 }
 
+bool
+Artist::hasPrecomputedSimilarArtists(Session& session)
+{
+	session.checkSharedLocked();
+
+	return Utils::hasSimilarIds(session, "artist");
+}
+
+std::vector<IdType>
+Artist::getPrecomputedSimilarArtistIds(Session& session, IdType artistId, std::size_t maxCount)
+{
+	session.checkSharedLocked();
+
+	return Utils::getSimilarIds(session, "artist", artistId, maxCount);
+}
+
+void
+Artist::setPrecomputedSimilarArtists(Session& session, const std::vector<std::pair<IdType, std::vector<IdType>>>& similarArtistIds)
+{
+	session.checkUniqueLocked();
+
+	Utils::replaceSimilarIds(session, "artist", similarArtistIds);
+}
+
 std::vector<Artist::pointer>
 Artist::getByClusters(Session& session, const std::set<IdType>& clusters, SortMethod sortMethod)
 {
@@ -302,6 +363,35 @@ Artist::getByFilter(Session& session,
 	return res;
 }
 
+std::vector<Artist::pointer>
+Artist::getByFilter(Session& session,
+		const std::set<IdType>& clusters,
+		const std::vector<std::string>& keywords,
+		std::optional<TrackArtistLinkType> linkType,
+		SortMethod sortMethod,
+		const std::optional<Cursor>& after,
+		std::size_t limit,
+		bool& moreResults)
+{
+	session.checkSharedLocked();
+
+	auto query {createQuery<Artist::pointer>(session, "SELECT DISTINCT a from artist a", clusters, keywords, linkType)};
+	switch (sortMethod)
+	{
+		case Artist::SortMethod::None:
+			Utils::applyCursor(query, "", "a.id", after, limit);
+			break;
+		case Artist::SortMethod::ByName:
+			Utils::applyCursor(query, "a.name", "a.id", after, limit);
+			break;
+		case Artist::SortMethod::BySortName:
+			Utils::applyCursor(query, "a.sort_name", "a.id", after, limit);
+			break;
+	}
+
+	return Utils::fetchCursorResults(query, limit, moreResults);
+}
+
 std::vector<Artist::pointer>
 Artist::getLastWritten(Session& session,
 		std::optional<Wt::WDateTime> after,
@@ -25,6 +25,7 @@
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "SqlQuery.hpp"
+#include "Utils.hpp"
 
 namespace Database {
 
@@ -68,12 +69,37 @@ Cluster::getAllOrphans(Session& session)
 	return std::vector<Cluster::pointer>(res.begin(), res.end());
 }
 
+std::size_t
+Cluster::removeAllOrphans(Session& session)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().flush();
+	session.getDboSession().execute("DELETE FROM cluster WHERE NOT EXISTS(SELECT 1 FROM track_cluster t_c WHERE t_c.cluster_id = cluster.id)");
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
+void
+Cluster::updateAggregates(Session& session)
+{
+	session.checkUniqueLocked();
+
+	const std::string trackCount {"(SELECT COUNT(*) FROM track_cluster t_c WHERE t_c.cluster_id = cluster.id)"};
+	const std::string releaseCount {"(SELECT COUNT(DISTINCT t.release_id) FROM track t INNER JOIN track_cluster t_c ON t_c.track_id = t.id WHERE t_c.cluster_id = cluster.id)"};
+
+	// Only write the clusters that actually changed
+	session.getDboSession().flush();
+	session.getDboSession().execute("UPDATE cluster SET track_count = " + trackCount + ", release_count = " + releaseCount
+			+ " WHERE track_count IS NOT " + trackCount + " OR release_count IS NOT " + releaseCount);
+}
+
 Cluster::pointer
 Cluster::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<Cluster>().where("id = ?").bind(id);
+	return Utils::getById<Cluster>(session.getDboSession(), id);
 }
 
 void
@@ -165,7 +191,7 @@ ClusterType::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<ClusterType>().where("id= ?").bind(id);
+	return Utils::getById<ClusterType>(session.getDboSession(), id);
 }
 
 std::vector<ClusterType::pointer>
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ClusterTrackIndex.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+#include <Wt/Dbo/Dbo.h>
+
+#include "database/Session.hpp"
+#include "utils/Logger.hpp"
+
+namespace Database {
+
+namespace {
+
+	long long
+	getCurrentVersion(Session& session)
+	{
+		return session.getDboSession().query<long long>("SELECT version FROM track_cluster_version").resultValue();
+	}
+
+} // namespace
+
+void
+ClusterTrackIndex::prepare(Session& session)
+{
+	session.checkUniqueLocked();
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+
+	dboSession.execute(R"(CREATE TABLE IF NOT EXISTS "track_cluster_version" ("version" bigint not null))");
+	dboSession.execute("INSERT INTO track_cluster_version (version) SELECT 0 WHERE NOT EXISTS (SELECT 1 FROM track_cluster_version)");
+	dboSession.execute("CREATE TRIGGER IF NOT EXISTS track_cluster_version_insert AFTER INSERT ON track_cluster BEGIN UPDATE track_cluster_version SET version = version + 1; END");
+	dboSession.execute("CREATE TRIGGER IF NOT EXISTS track_cluster_version_delete AFTER DELETE ON track_cluster BEGIN UPDATE track_cluster_version SET version = version + 1; END");
+}
+
+void
+ClusterTrackIndex::rebuildIfNeeded(Session& session)
+{
+	const Version version {getCurrentVersion(session)};
+
+	// Readers may see an older snapshot of the database: only rebuild to get newer data
+	auto isUpToDate {[&]
+	{
+		std::shared_lock lock {_mutex};
+		return _version && *_version >= version;
+	}};
+
+	if (isUpToDate())
+		return;
+
+	std::scoped_lock rebuildLock {_rebuildMutex};
+	if (isUpToDate())
+		return;
+
+	using ClusterAndTrackIds = std::tuple<IdType, IdType>;
+
+	TrackIdsByCluster trackIdsByCluster;
+	std::size_t entryCount {};
+	{
+		Wt::Dbo::collection<ClusterAndTrackIds> res {session.getDboSession().query<ClusterAndTrackIds>("SELECT cluster_id, track_id FROM track_cluster").orderBy("cluster_id, track_id")};
+		for (const auto& [clusterId, trackId] : res)
+		{
+			trackIdsByCluster[clusterId].push_back(trackId);
+			entryCount++;
+		}
+	}
+
+	for (auto& [clusterId, trackIds] : trackIdsByCluster)
+		trackIds.shrink_to_fit();
+
+	LMS_LOG(DB, DEBUG) << "Cluster track index rebuilt: " << trackIdsByCluster.size() << " clusters, " << entryCount << " entries";
+
+	std::unique_lock lock {_mutex};
+	_trackIdsByCluster.swap(trackIdsByCluster);
+	_version = version;
+}
+
+void
+ClusterTrackIndex::reset()
+{
+	std::scoped_lock rebuildLock {_rebuildMutex};
+	std::unique_lock lock {_mutex};
+
+	_version.reset();
+	_trackIdsByCluster.clear();
+}
+
+std::optional<std::vector<IdType>>
+ClusterTrackIndex::getTrackIds(Session& session, const std::set<IdType>& clusterIds, std::size_t maxCount)
+{
+	session.checkSharedLocked();
+
+	if (clusterIds.empty())
+		return std::nullopt;
+
+	rebuildIfNeeded(session);
+
+	std::shared_lock lock {_mutex};
+
+	std::vector<const std::vector<IdType>*> trackIdsPerCluster;
+	for (const IdType clusterId : clusterIds)
+	{
+		auto it {_trackIdsByCluster.find(clusterId)};
+		if (it == std::cend(_trackIdsByCluster))
+			return std::vector<IdType> {};
+
+		trackIdsPerCluster.push_back(&it->second);
+	}
+
+	// Start with the smallest cluster: the intersection can only get smaller
+	std::sort(std::begin(trackIdsPerCluster), std::end(trackIdsPerCluster), [](const auto* lhs, const auto* rhs) { return lhs->size() < rhs->size(); });
+
+	std::vector<IdType> res (*trackIdsPerCluster.front());
+	for (auto itTrackIds {std::next(std::cbegin(trackIdsPerCluster))}; itTrackIds != std::cend(trackIdsPerCluster) && !res.empty(); ++itTrackIds)
+	{
+		const std::vector<IdType>& trackIds {**itTrackIds};
+
+		// candidates are few compared to the cluster tracks: binary searches rather than a linear merge
+		res.erase(std::remove_if(std::begin(res), std::end(res), [&](IdType trackId) { return !std::binary_search(std::cbegin(trackIds), std::cend(trackIds), trackId); }), std::end(res));
+	}
+
+	if (res.size() > maxCount)
+		return std::nullopt;
+
+	return res;
+}
+
+} // namespace Database
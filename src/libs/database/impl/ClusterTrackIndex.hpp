@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "database/Types.hpp"
+
+namespace Database {
+
+class Session;
+
+// In memory index of the tracks of each cluster, used to filter on several clusters at once
+// without grouping the track_cluster rows in SQL
+// Rebuilt on first use after track_cluster has changed (changes are counted using triggers)
+class ClusterTrackIndex
+{
+	public:
+		ClusterTrackIndex() = default;
+
+		ClusterTrackIndex(const ClusterTrackIndex&) = delete;
+		ClusterTrackIndex(ClusterTrackIndex&&) = delete;
+		ClusterTrackIndex& operator=(const ClusterTrackIndex&) = delete;
+		ClusterTrackIndex& operator=(ClusterTrackIndex&&) = delete;
+
+		// Creates the change counter and its triggers if needed
+		static void prepare(Session& session);
+
+		// Sorted ids of the tracks belonging to all the given clusters
+		// nullopt if more than maxCount tracks match
+		// session must be shared locked, it is used to rebuild the index if needed
+		std::optional<std::vector<IdType>> getTrackIds(Session& session, const std::set<IdType>& clusterIds, std::size_t maxCount);
+
+		// Forces a rebuild on next use, the change counter of a replaced database cannot be compared
+		void reset();
+
+	private:
+		using Version = long long;
+		using TrackIdsByCluster = std::unordered_map<IdType, std::vector<IdType>>;	// track ids are sorted
+
+		void rebuildIfNeeded(Session& session);
+
+		std::mutex					_rebuildMutex;
+
+		std::shared_mutex			_mutex;
+		std::optional<Version>		_version;
+		TrackIdsByCluster			_trackIdsByCluster;
+};
+
+} // namespace Database
+
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConnectionPool.hpp"
+
+#include <algorithm>
+#include <system_error>
+
+#include <Wt/Dbo/Exception.h>
+#include <Wt/Dbo/SqlStatement.h>
+#include <Wt/Dbo/backend/Sqlite3.h>
+
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "InstrumentedConnection.hpp"
+
+namespace Database {
+
+namespace {
+
+	thread_local bool readOnlyAccess {};
+
+	Metrics::Counter& statementCacheClears {Metrics::getCounter("lms_db_statement_cache_clears_total", "Number of times the prepared statement cache of a connection exceeded its max size and was cleared")};
+
+	// Page cache of the write connection of the databases being bulk loaded, so that the lookup indexes stay in memory
+	constexpr std::size_t bulkLoadCacheSizeKiB {256 * 1024};
+
+	std::unique_ptr<Wt::Dbo::SqlConnection>
+	createConnection(const std::filesystem::path& dbPath, bool readOnly, std::chrono::milliseconds busyTimeout, const ConnectionSettings& settings, QueryStats* queryStats)
+	{
+		auto connection {std::make_unique<InstrumentedSqlite3>(dbPath.string(), queryStats)};
+	//	connection->setProperty("show-queries", "true");
+		// Wait instead of failing if the database is locked by another connection (checkpoints, other processes, ...)
+		connection->executeSql("pragma busy_timeout=" + std::to_string(settings.busyTimeout ? settings.busyTimeout->count() : busyTimeout.count()));
+		if (settings.cacheSizeKiB)
+			connection->executeSql("pragma cache_size=-" + std::to_string(*settings.cacheSizeKiB)); // negative means KiB
+		if (settings.mmapSize)
+			connection->executeSql("pragma mmap_size=" + std::to_string(*settings.mmapSize));
+		if (settings.tempStoreInMemory)
+			connection->executeSql("pragma temp_store=memory");
+		if (settings.walAutoCheckpoint)
+			connection->executeSql("pragma wal_autocheckpoint=" + std::to_string(*settings.walAutoCheckpoint));
+
+		if (readOnly)
+		{
+			connection->executeSql("pragma query_only=ON");
+		}
+		else if (settings.bulkLoad)
+		{
+			connection->executeSql("pragma journal_mode=MEMORY");
+			connection->executeSql("pragma synchronous=OFF");
+			if (!settings.cacheSizeKiB || *settings.cacheSizeKiB < bulkLoadCacheSizeKiB)
+				connection->executeSql("pragma cache_size=-" + std::to_string(bulkLoadCacheSizeKiB));
+		}
+		else
+		{
+			connection->executeSql("pragma journal_mode=WAL");
+			connection->executeSql("pragma synchronous=normal");
+		}
+
+		return connection;
+	}
+
+	std::string
+	getPragmaValue(Wt::Dbo::SqlConnection& connection, const std::string& pragma)
+	{
+		std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement("pragma " + pragma)};
+		statement->execute();
+
+		std::string value;
+		if (!statement->nextRow() || !statement->getResult(0, &value, 0))
+			return "?";
+
+		return value;
+	}
+
+	// Some values may be capped or ignored by SQLite (mmap_size for example)
+	void
+	logEffectiveSettings(Wt::Dbo::SqlConnection& connection)
+	{
+		for (const char* pragma : {"journal_mode", "synchronous", "cache_size", "mmap_size", "temp_store", "busy_timeout", "wal_autocheckpoint"})
+			LMS_LOG(DB, INFO) << "Using " << pragma << " = " << getPragmaValue(connection, pragma);
+	}
+
+} // namespace
+
+ConnectionPool::ConnectionPool(const std::filesystem::path& dbPath, std::size_t readConnectionCount, std::chrono::seconds timeout, const ConnectionSettings& settings, QueryStats* queryStats)
+: _dbPath {dbPath}
+, _readConnectionCount {std::max<std::size_t>(readConnectionCount, 1)}
+, _timeout {timeout}
+, _settings {settings}
+, _queryStats {queryStats}
+{
+	LMS_LOG(DB, INFO) << "Creating connection pool on file " << _dbPath.string() << ": 1 write connection, " << _readConnectionCount << " read connection(s)";
+
+	createConnections();
+	logEffectiveSettings(*_freeWriteConnection);
+}
+
+ConnectionPool::~ConnectionPool() = default;
+
+bool
+ConnectionPool::setReadOnlyAccess(bool readOnly)
+{
+	const bool previousReadOnly {readOnlyAccess};
+	readOnlyAccess = readOnly;
+	return previousReadOnly;
+}
+
+std::unique_ptr<Wt::Dbo::SqlConnection>
+ConnectionPool::getConnection()
+{
+	const bool readOnly {readOnlyAccess};
+
+	std::unique_lock lock {_mutex};
+
+	const bool available {_connectionReturned.wait_for(lock, _timeout, [&]
+	{
+		if (_replacingDatabase)
+			return false;
+
+		return readOnly ? !_freeReadConnections.empty() : static_cast<bool>(_freeWriteConnection);
+	})};
+
+	if (!available)
+	{
+		LMS_LOG(DB, ERROR) << "Timeout while waiting for a " << (readOnly ? "read" : "write") << " connection";
+		throw Wt::Dbo::Exception {"ConnectionPool::getConnection(): timeout"};
+	}
+
+	if (!readOnly)
+		return std::move(_freeWriteConnection);
+
+	std::unique_ptr<Wt::Dbo::SqlConnection> connection {std::move(_freeReadConnections.back())};
+	_freeReadConnections.pop_back();
+
+	return connection;
+}
+
+void
+ConnectionPool::returnConnection(std::unique_ptr<Wt::Dbo::SqlConnection> connection)
+{
+	// No statement is in use once returned: the cache can be cleared
+	auto& instrumentedConnection {static_cast<InstrumentedSqlite3&>(*connection)};
+	if (_settings.statementCacheMaxSize > 0 && instrumentedConnection.getCachedStatementCount() > _settings.statementCacheMaxSize)
+	{
+		instrumentedConnection.clearCachedStatements();
+		statementCacheClears.inc();
+	}
+
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (connection.get() == _writeConnection)
+			_freeWriteConnection = std::move(connection);
+		else
+			_freeReadConnections.emplace_back(std::move(connection));
+	}
+
+	_connectionReturned.notify_all();
+}
+
+void
+ConnectionPool::replaceDatabase(const std::filesystem::path& newDbPath)
+{
+	{
+		std::unique_lock lock {_mutex};
+
+		_replacingDatabase = true;
+		_connectionReturned.wait(lock, [this] { return _freeWriteConnection && _freeReadConnections.size() == _readConnectionCount; });
+
+		// Closing the last connection checkpoints the write-ahead log: nothing is left to apply to the replaced file
+		_freeWriteConnection.reset();
+		_writeConnection = nullptr;
+		_freeReadConnections.clear();
+
+		std::error_code ec;
+		std::filesystem::remove(_dbPath.string() + "-wal", ec);
+		std::filesystem::remove(_dbPath.string() + "-shm", ec);
+
+		std::filesystem::rename(newDbPath, _dbPath, ec);
+		if (ec)
+			LMS_LOG(DB, ERROR) << "Cannot move database file " << newDbPath.string() << " to " << _dbPath.string() << ": " << ec.message();
+
+		createConnections();
+		_replacingDatabase = false;
+
+		if (ec)
+			throw Wt::Dbo::Exception {"ConnectionPool::replaceDatabase(): cannot move database file: " + ec.message()};
+	}
+
+	_connectionReturned.notify_all();
+}
+
+void
+ConnectionPool::createConnections()
+{
+	// Create the writer first to make sure the database is set in WAL mode before being read
+	_freeWriteConnection = createConnection(_dbPath, false, _timeout, _settings, _queryStats);
+	_writeConnection = _freeWriteConnection.get();
+
+	for (std::size_t i {}; i < _readConnectionCount; ++i)
+		_freeReadConnections.emplace_back(createConnection(_dbPath, true, _timeout, _settings, _queryStats));
+}
+
+void
+ConnectionPool::prepareForDropTables() const
+{
+	std::scoped_lock lock {_mutex};
+
+	if (_freeWriteConnection)
+		_freeWriteConnection->prepareForDropTables();
+
+	for (const auto& connection : _freeReadConnections)
+		connection->prepareForDropTables();
+}
+
+} // namespace Database
+
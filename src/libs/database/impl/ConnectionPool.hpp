@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Wt/Dbo/SqlConnection.h>
+#include <Wt/Dbo/SqlConnectionPool.h>
+
+#include "database/Db.hpp"
+
+namespace Database {
+
+// Connection pool made of a single writer connection and of a set of read only connections
+// The kind of connection given is selected using a per thread access mode (read write by default)
+class ConnectionPool final : public Wt::Dbo::SqlConnectionPool
+{
+	public:
+		// If set, queryStats must outlive the pool
+		ConnectionPool(const std::filesystem::path& dbPath, std::size_t readConnectionCount, std::chrono::seconds timeout, const ConnectionSettings& settings, QueryStats* queryStats);
+		~ConnectionPool();
+
+		ConnectionPool(const ConnectionPool&) = delete;
+		ConnectionPool(ConnectionPool&&) = delete;
+		ConnectionPool& operator=(const ConnectionPool&) = delete;
+		ConnectionPool& operator=(ConnectionPool&&) = delete;
+
+		// Returns the previous access mode of the current thread
+		static bool setReadOnlyAccess(bool readOnly);
+
+		std::unique_ptr<Wt::Dbo::SqlConnection> getConnection() override;
+		void returnConnection(std::unique_ptr<Wt::Dbo::SqlConnection> connection) override;
+		void prepareForDropTables() const override;
+
+		// Waits for all the connections to be returned, closes them, moves the database file newDbPath over the current one and reopens them
+		// Connections are not given meanwhile. Must not be called from a thread having a pending transaction
+		void replaceDatabase(const std::filesystem::path& newDbPath);
+
+	private:
+		void createConnections();	// _mutex must be held, if needed
+
+		const std::filesystem::path			_dbPath;
+		const std::size_t					_readConnectionCount;
+		const std::chrono::seconds			_timeout;
+		const ConnectionSettings			_settings;
+		QueryStats* const					_queryStats;
+		const Wt::Dbo::SqlConnection*		_writeConnection {};
+
+		mutable std::mutex					_mutex;
+		std::condition_variable				_connectionReturned;
+		bool								_replacingDatabase {};
+		std::unique_ptr<Wt::Dbo::SqlConnection>					_freeWriteConnection;
+		std::vector<std::unique_ptr<Wt::Dbo::SqlConnection>>	_freeReadConnections;
+};
+
+} // namespace Database
+
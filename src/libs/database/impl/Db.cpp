@@ -19,33 +19,60 @@
 
 #include "database/Db.hpp"
 
-#include <Wt/Dbo/FixedSqlConnectionPool.h>
-#include <Wt/Dbo/backend/Sqlite3.h>
+#include <cassert>
+#include <mutex>
+#include <system_error>
 
+#include <Wt/Dbo/SqlStatement.h>
+
+#include "database/QueryStats.hpp"
 #include "database/Session.hpp"
 #include "database/User.hpp"
+#include "database/UserStateJournal.hpp"
 #include "utils/Logger.hpp"
 
+#include "ClusterTrackIndex.hpp"
+#include "ConnectionPool.hpp"
+#include "Maintenance.hpp"
+#include "Rebuild.hpp"
+
 namespace Database {
 
-// Session living class handling the database and the login
-Db::Db(const std::filesystem::path& dbPath)
-{
-	LMS_LOG(DB, INFO) << "Creating connection pool on file " << dbPath.string();
+namespace {
 
-	std::unique_ptr<Wt::Dbo::backend::Sqlite3> connection {std::make_unique<Wt::Dbo::backend::Sqlite3>(dbPath.string())};
-//	connection->setProperty("show-queries", "true");
-	connection->executeSql("pragma journal_mode=WAL");
-	connection->executeSql("pragma synchronous=normal");
+	void
+	removeDatabaseFiles(const std::filesystem::path& dbPath)
+	{
+		std::error_code ec;
+		for (const char* suffix : {"", "-journal", "-wal", "-shm"})
+			std::filesystem::remove(dbPath.string() + suffix, ec);
+	}
 
-	auto connectionPool = std::make_unique<Wt::Dbo::FixedSqlConnectionPool>(std::move(connection), 10);
-	connectionPool->setTimeout(std::chrono::seconds(10));
+} // namespace
 
-	_connectionPool = std::move(connectionPool);
+// Session living class handling the database and the login
+Db::Db(const std::filesystem::path& dbPath, std::size_t readConnectionCount, ConcurrencyMode concurrencyMode, const ConnectionSettings& connectionSettings, const QueryStatsSettings& queryStatsSettings)
+: _dbPath {dbPath}
+, _readConnectionCount {readConnectionCount}
+, _concurrencyMode {concurrencyMode}
+, _connectionSettings {connectionSettings}
+, _queryStats {queryStatsSettings.enabled ? std::make_unique<QueryStats>(queryStatsSettings.slowQueryThreshold) : nullptr}
+, _connectionPool {std::make_unique<ConnectionPool>(dbPath, readConnectionCount, std::chrono::seconds {10}, connectionSettings, _queryStats.get())}
+, _clusterTrackIndex {std::make_unique<ClusterTrackIndex>()}
+, _userStateJournal {std::make_unique<UserStateJournal>(*this)}
+{
+	LMS_LOG(DB, INFO) << "Read transactions " << (_concurrencyMode == ConcurrencyMode::ConcurrentReads ? "do not wait" : "wait") << " for write transactions";
+	if (_queryStats)
+		LMS_LOG(DB, INFO) << "Query stats enabled";
 }
 
 Db::~Db()
 {
+	LMS_LOG(DB, DEBUG) << "Flushing user state updates...";
+	_userStateJournal.reset();
+
+	_maintenance.reset();
+
 	LMS_LOG(DB, DEBUG) << "Optimizing db...";
 	executeSql("pragma optimize");
 	LMS_LOG(DB, DEBUG) << "Optimizing db DONE";
@@ -58,6 +85,106 @@ Db::executeSql(const std::string& sql)
 	connection->executeSql(sql);
 }
 
+std::vector<std::string>
+Db::getQueryPlan(const std::string& query)
+{
+	ScopedConnection connection {*_connectionPool};
+
+	std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection->prepareStatement("EXPLAIN QUERY PLAN " + query)};
+	statement->execute();
+
+	// columns are id, parent, notused and detail
+	std::vector<std::string> steps;
+	std::string detail;
+	while (statement->nextRow())
+	{
+		if (statement->getResult(3, &detail, 0))
+			steps.push_back(detail);
+	}
+
+	return steps;
+}
+
+std::unique_ptr<Db>
+Db::createRebuildDb()
+{
+	const std::filesystem::path rebuildDbPath {_dbPath.string() + ".rebuild"};
+
+	// Leftovers of an interrupted rebuild
+	removeDatabaseFiles(rebuildDbPath);
+
+	LMS_LOG(DB, INFO) << "Creating database to be rebuilt in file " << rebuildDbPath.string();
+
+	ConnectionSettings connectionSettings {_connectionSettings};
+	connectionSettings.bulkLoad = true;
+
+	auto rebuildDb {std::make_unique<Db>(rebuildDbPath, _readConnectionCount, ConcurrencyMode::Exclusive, connectionSettings)};
+	{
+		Session session {*rebuildDb};
+		session.prepareTablesForBulkLoad();
+	}
+
+	Rebuild::copyScanSettings(rebuildDbPath, _dbPath);
+
+	return rebuildDb;
+}
+
+void
+Db::replaceByRebuildDb(std::unique_ptr<Db> rebuildDb)
+{
+	const std::filesystem::path rebuildDbPath {rebuildDb->_dbPath};
+
+	LMS_LOG(DB, INFO) << "Creating indexes of the rebuilt database...";
+	{
+		Session session {*rebuildDb};
+		session.createIndexes();
+	}
+	rebuildDb.reset();
+
+	// Pending user state updates refer to the current ids: write them first,
+	// and block the flushes until the replacement is done so that the updates queued meanwhile can be translated
+	std::unique_lock flushLock {_userStateJournal->getFlushMutex()};
+	_userStateJournal->flushLocked();
+
+	{
+		std::unique_lock lock {_sharedMutex};
+
+		LMS_LOG(DB, INFO) << "Copying user data into the rebuilt database...";
+		const Rebuild::IdMaps idMaps {Rebuild::copyUserData(rebuildDbPath, _dbPath)};
+
+		LMS_LOG(DB, INFO) << "Replacing database by the rebuilt one...";
+		static_cast<ConnectionPool&>(*_connectionPool).replaceDatabase(rebuildDbPath);
+
+		_clusterTrackIndex->reset();
+		_userStateJournal->translateIds(idMaps);
+	}
+
+	LMS_LOG(DB, INFO) << "Database replaced by the rebuilt one";
+}
+
+void
+Db::discardRebuildDb(std::unique_ptr<Db> rebuildDb)
+{
+	const std::filesystem::path rebuildDbPath {rebuildDb->_dbPath};
+	rebuildDb.reset();
+
+	LMS_LOG(DB, INFO) << "Discarding rebuilt database";
+	removeDatabaseFiles(rebuildDbPath);
+}
+
+void
+Db::startMaintenance(const MaintenanceSettings& settings)
+{
+	assert(!_maintenance);
+	_maintenance = std::make_unique<Maintenance>(*this, _dbPath, settings);
+}
+
+void
+Db::startUserStateJournal(const UserStateJournalSettings& settings)
+{
+	_userStateJournal->start(settings);
+}
+
 Session&
 Db::getTLSSession()
 {
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "InstrumentedConnection.hpp"
+
+#include "database/QueryStats.hpp"
+#include "utils/Metrics.hpp"
+
+namespace Database {
+
+namespace {
+
+	class ScopedDuration
+	{
+		public:
+			ScopedDuration(std::chrono::microseconds& duration)
+			: _duration {duration}
+			, _start {std::chrono::steady_clock::now()}
+			{}
+
+			~ScopedDuration()
+			{
+				_duration += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start);
+			}
+
+			ScopedDuration(const ScopedDuration&) = delete;
+			ScopedDuration(ScopedDuration&&) = delete;
+			ScopedDuration& operator=(const ScopedDuration&) = delete;
+			ScopedDuration& operator=(ScopedDuration&&) = delete;
+
+		private:
+			std::chrono::microseconds& _duration;
+			const std::chrono::steady_clock::time_point _start;
+	};
+
+	Metrics::Gauge& cachedStatements {Metrics::getGauge("lms_db_cached_statements", "Number of prepared statements kept for reuse by the database connections")};
+
+} // namespace
+
+InstrumentedSqlite3::InstrumentedSqlite3(const std::string& db, QueryStats* stats)
+: Wt::Dbo::backend::Sqlite3 {db}
+, _stats {stats}
+{
+}
+
+InstrumentedSqlite3::~InstrumentedSqlite3()
+{
+	cachedStatements.add(-static_cast<std::int64_t>(_cachedStatementCount));
+}
+
+std::unique_ptr<Wt::Dbo::SqlConnection>
+InstrumentedSqlite3::clone() const
+{
+	auto connection {std::make_unique<InstrumentedSqlite3>(*this)};
+	connection->_cachedStatementCount = 0;
+	return connection;
+}
+
+std::unique_ptr<Wt::Dbo::SqlStatement>
+InstrumentedSqlite3::prepareStatement(const std::string& sql)
+{
+	_cachedStatementCount++;
+	cachedStatements.add(1);
+
+	std::unique_ptr<Wt::Dbo::SqlStatement> statement {Wt::Dbo::backend::Sqlite3::prepareStatement(sql)};
+	if (!_stats)
+		return statement;
+
+	return std::make_unique<InstrumentedStatement>(std::move(statement), *_stats);
+}
+
+void
+InstrumentedSqlite3::clearCachedStatements()
+{
+	clearStatementCache();
+	cachedStatements.add(-static_cast<std::int64_t>(_cachedStatementCount));
+	_cachedStatementCount = 0;
+}
+
+void
+InstrumentedSqlite3::prepareForDropTables()
+{
+	// Clears the statement cache
+	Wt::Dbo::backend::Sqlite3::prepareForDropTables();
+	cachedStatements.add(-static_cast<std::int64_t>(_cachedStatementCount));
+	_cachedStatementCount = 0;
+}
+
+InstrumentedStatement::InstrumentedStatement(std::unique_ptr<Wt::Dbo::SqlStatement> statement, QueryStats& stats)
+: _statement {std::move(statement)}
+, _stats {stats}
+, _queryShape {QueryStats::getQueryShape(_statement->sql())}
+{
+}
+
+InstrumentedStatement::~InstrumentedStatement()
+{
+	reportStats();
+}
+
+void
+InstrumentedStatement::reset()
+{
+	reportStats();
+	_statement->reset();
+}
+
+void
+InstrumentedStatement::execute()
+{
+	reportStats();
+
+	_executed = true;
+	{
+		ScopedDuration duration {_duration};
+		_statement->execute();
+	}
+
+	// No row to fetch
+	if (_statement->columnCount() == 0)
+		reportStats();
+}
+
+bool
+InstrumentedStatement::nextRow()
+{
+	bool res;
+	{
+		ScopedDuration duration {_duration};
+		res = _statement->nextRow();
+	}
+
+	if (res)
+		_rowCount++;
+	else
+		reportStats();
+
+	return res;
+}
+
+void
+InstrumentedStatement::reportStats()
+{
+	if (!_executed)
+		return;
+
+	_stats.addQuery(_queryShape, _statement->sql(), _duration, _rowCount);
+
+	_executed = false;
+	_duration = {};
+	_rowCount = 0;
+}
+
+} // namespace Database
+
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <Wt/Dbo/SqlStatement.h>
+#include <Wt/Dbo/backend/Sqlite3.h>
+
+namespace Database {
+
+class QueryStats;
+
+// Sqlite3 connection counting the statements it prepares (lms_db_cached_statements), and reporting their execution time if stats are set
+class InstrumentedSqlite3 final : public Wt::Dbo::backend::Sqlite3
+{
+	public:
+		InstrumentedSqlite3(const std::string& db, QueryStats* stats);
+		~InstrumentedSqlite3() override;
+
+		std::unique_ptr<Wt::Dbo::SqlConnection> clone() const override;
+		std::unique_ptr<Wt::Dbo::SqlStatement> prepareStatement(const std::string& sql) override;
+		void prepareForDropTables() override;
+
+		// Dbo caches the statements it prepares, one per distinct query text (and more if used concurrently)
+		std::size_t getCachedStatementCount() const { return _cachedStatementCount; }
+		// No statement must be in use
+		void clearCachedStatements();
+
+	private:
+		QueryStats* _stats;
+		std::size_t _cachedStatementCount {};
+};
+
+// Forwards to the actual statement, measuring the time spent executing it and fetching its rows
+// Stats are reported once all the rows are fetched, or when the statement is reset
+class InstrumentedStatement final : public Wt::Dbo::SqlStatement
+{
+	public:
+		InstrumentedStatement(std::unique_ptr<Wt::Dbo::SqlStatement> statement, QueryStats& stats);
+		~InstrumentedStatement() override;
+
+		InstrumentedStatement(const InstrumentedStatement&) = delete;
+		InstrumentedStatement(InstrumentedStatement&&) = delete;
+		InstrumentedStatement& operator=(const InstrumentedStatement&) = delete;
+		InstrumentedStatement& operator=(InstrumentedStatement&&) = delete;
+
+		void reset() override;
+		void bind(int column, const std::string& value) override { _statement->bind(column, value); }
+		void bind(int column, short value) override { _statement->bind(column, value); }
+		void bind(int column, int value) override { _statement->bind(column, value); }
+		void bind(int column, long long value) override { _statement->bind(column, value); }
+		void bind(int column, float value) override { _statement->bind(column, value); }
+		void bind(int column, double value) override { _statement->bind(column, value); }
+		void bind(int column, const std::chrono::system_clock::time_point& value, Wt::Dbo::SqlDateTimeType type) override { _statement->bind(column, value, type); }
+		void bind(int column, const std::chrono::duration<int, std::milli>& value) override { _statement->bind(column, value); }
+		void bind(int column, const std::vector<unsigned char>& value) override { _statement->bind(column, value); }
+		void bindNull(int column) override { _statement->bindNull(column); }
+
+		void execute() override;
+		long long insertedId() override { return _statement->insertedId(); }
+		int affectedRowCount() override { return _statement->affectedRowCount(); }
+		bool nextRow() override;
+		int columnCount() const override { return _statement->columnCount(); }
+
+		bool getResult(int column, std::string* value, int size) override { return _statement->getResult(column, value, size); }
+		bool getResult(int column, short* value) override { return _statement->getResult(column, value); }
+		bool getResult(int column, int* value) override { return _statement->getResult(column, value); }
+		bool getResult(int column, long long* value) override { return _statement->getResult(column, value); }
+		bool getResult(int column, float* value) override { return _statement->getResult(column, value); }
+		bool getResult(int column, double* value) override { return _statement->getResult(column, value); }
+		bool getResult(int column, std::chrono::system_clock::time_point* value, Wt::Dbo::SqlDateTimeType type) override { return _statement->getResult(column, value, type); }
+		bool getResult(int column, std::chrono::duration<int, std::milli>* value) override { return _statement->getResult(column, value); }
+		bool getResult(int column, std::vector<unsigned char>* value, int size) override { return _statement->getResult(column, value, size); }
+
+		std::string sql() const override { return _statement->sql(); }
+
+	private:
+		void reportStats();
+
+		const std::unique_ptr<Wt::Dbo::SqlStatement>	_statement;
+		QueryStats&										_stats;
+		const std::string								_queryShape;
+
+		bool						_executed {};
+		std::chrono::microseconds	_duration {};
+		std::size_t					_rowCount {};
+};
+
+} // namespace Database
+
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Maintenance.hpp"
+
+#include <array>
+#include <chrono>
+#include <string>
+
+#include <Wt/Dbo/Exception.h>
+#include <Wt/Dbo/SqlStatement.h>
+
+#include "database/Session.hpp"
+#include "database/TrackList.hpp"
+#include "database/User.hpp"
+#include "utils/Logger.hpp"
+
+namespace Database {
+
+namespace {
+
+	// Time to wait for the readers when trying to truncate the write-ahead log
+	constexpr std::chrono::milliseconds truncateBusyTimeout {100};
+	// Max number of rows examined per index when analyzing the tables
+	constexpr int analysisLimit {1000};
+
+	// Reads the first row of the result, made of integers
+	template <std::size_t N>
+	std::array<long long, N>
+	queryIntegers(Wt::Dbo::SqlConnection& connection, const std::string& sql)
+	{
+		std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement(sql)};
+		statement->execute();
+
+		std::array<long long, N> res {};
+		if (statement->nextRow())
+		{
+			for (std::size_t i {}; i < N; ++i)
+				statement->getResult(static_cast<int>(i), &res[i]);
+		}
+
+		return res;
+	}
+
+} // namespace
+
+Maintenance::Maintenance(Db& db, const std::filesystem::path& dbPath, const MaintenanceSettings& settings)
+: _db {db}
+, _connectionPool {db.getConnectionPool()}
+, _walPath {dbPath.string() + "-wal"}
+, _settings {settings}
+{
+	LMS_LOG(DB, INFO) << "Starting maintenance: checking the write-ahead log size every " << _settings.checkInterval.count() << " second(s), optimizing every " << _settings.optimizePeriod.count() << " minute(s)";
+
+	_thread = std::thread {[this] { run(); }};
+}
+
+Maintenance::~Maintenance()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+	}
+	_quitCondition.notify_all();
+
+	_thread.join();
+}
+
+void
+Maintenance::run()
+{
+	auto nextPeriodicTasks {std::chrono::steady_clock::now() + _settings.optimizePeriod};
+
+	while (true)
+	{
+		{
+			std::unique_lock lock {_mutex};
+			if (_quitCondition.wait_for(lock, _settings.checkInterval, [this] { return _quit; }))
+				return;
+		}
+
+		try
+		{
+			if (std::chrono::steady_clock::now() >= nextPeriodicTasks)
+			{
+				runPeriodicTasks();
+				nextPeriodicTasks = std::chrono::steady_clock::now() + _settings.optimizePeriod;
+			}
+			else
+			{
+				checkWalSize();
+			}
+		}
+		catch (Wt::Dbo::Exception& e)
+		{
+			LMS_LOG(DB, ERROR) << "Maintenance failed: " << e.what();
+		}
+	}
+}
+
+void
+Maintenance::checkWalSize()
+{
+	std::error_code ec;
+	const std::uintmax_t walSize {std::filesystem::file_size(_walPath, ec)};
+	if (ec || walSize < _settings.walCheckpointThreshold)
+		return;
+
+	LMS_LOG(DB, DEBUG) << "Write-ahead log size is " << walSize << " bytes, checkpointing";
+
+	Db::ScopedConnection connection {_connectionPool};
+	checkpoint(*connection);
+}
+
+void
+Maintenance::runPeriodicTasks()
+{
+	LMS_LOG(DB, DEBUG) << "Running periodic maintenance...";
+
+	if (_settings.maxListenCount > 0)
+		compactListens();
+
+	Db::ScopedConnection connection {_connectionPool};
+
+	// Only analyzes the tables that need it, on a sample of rows to keep it short
+	connection->executeSql("pragma analysis_limit=" + std::to_string(analysisLimit));
+	connection->executeSql("pragma optimize");
+
+	checkpoint(*connection);
+
+	// Only effective if the database has been created or vacuumed using auto_vacuum=incremental
+	const auto [autoVacuum] {queryIntegers<1>(*connection, "pragma auto_vacuum")};
+	if (autoVacuum == 2)
+	{
+		const auto [freePageCount] {queryIntegers<1>(*connection, "pragma freelist_count")};
+		if (freePageCount > 0)
+		{
+			LMS_LOG(DB, DEBUG) << "Reclaiming " << freePageCount << " free page(s)";
+			connection->executeSql("pragma incremental_vacuum");
+		}
+	}
+
+	LMS_LOG(DB, DEBUG) << "Periodic maintenance done";
+}
+
+void
+Maintenance::compactListens()
+{
+	Session& session {_db.getTLSSession()};
+
+	std::size_t compactedCount {};
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		for (const User::pointer& user : User::getAll(session))
+		{
+			if (const TrackList::pointer playedTrackList {user->getPlayedTrackList(session)})
+				compactedCount += TrackList::compactEntries(session, playedTrackList, _settings.maxListenCount);
+		}
+	}
+
+	if (compactedCount > 0)
+		LMS_LOG(DB, DEBUG) << "Compacted " << compactedCount << " listen(s)";
+}
+
+void
+Maintenance::checkpoint(Wt::Dbo::SqlConnection& connection)
+{
+	// Does not wait for the readers and writers
+	const auto [busy, logPageCount, checkpointedPageCount] {queryIntegers<3>(connection, "pragma wal_checkpoint(PASSIVE)")};
+	LMS_LOG(DB, DEBUG) << "Passive checkpoint: " << checkpointedPageCount << "/" << logPageCount << " page(s) checkpointed";
+
+	if (busy || logPageCount < 0 || checkpointedPageCount != logPageCount)
+		return;
+
+	// Everything has been copied back into the database: try to reset the write-ahead log file in order to reclaim its space
+	// Give up quickly if some readers are still using it
+	const auto [busyTimeout] {queryIntegers<1>(connection, "pragma busy_timeout")};
+	connection.executeSql("pragma busy_timeout=" + std::to_string(truncateBusyTimeout.count()));
+	const auto truncateResult {queryIntegers<3>(connection, "pragma wal_checkpoint(TRUNCATE)")};
+	connection.executeSql("pragma busy_timeout=" + std::to_string(busyTimeout));
+
+	LMS_LOG(DB, DEBUG) << "Write-ahead log " << (truncateResult[0] ? "not truncated, database busy" : "truncated");
+}
+
+} // namespace Database
+
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include <Wt/Dbo/SqlConnectionPool.h>
+
+#include "database/Db.hpp"
+
+namespace Database {
+
+// Periodically runs maintenance tasks on the database, using its own thread
+// Only passive checkpoints or tasks that give up quickly if the database is busy are used, so that readers are never blocked
+// Except for the compaction of the listens, which is a regular write transaction
+class Maintenance
+{
+	public:
+		Maintenance(Db& db, const std::filesystem::path& dbPath, const MaintenanceSettings& settings);
+		~Maintenance();
+
+		Maintenance(const Maintenance&) = delete;
+		Maintenance(Maintenance&&) = delete;
+		Maintenance& operator=(const Maintenance&) = delete;
+		Maintenance& operator=(Maintenance&&) = delete;
+
+	private:
+		void run();
+		void checkWalSize();
+		void runPeriodicTasks();
+		void compactListens();
+		void checkpoint(Wt::Dbo::SqlConnection& connection);
+
+		Db&							_db;
+		Wt::Dbo::SqlConnectionPool&	_connectionPool;
+		const std::filesystem::path	_walPath;
+		const MaintenanceSettings	_settings;
+
+		std::mutex					_mutex;
+		std::condition_variable		_quitCondition;
+		bool						_quit {};
+		std::thread					_thread;
+};
+
+} // namespace Database
+
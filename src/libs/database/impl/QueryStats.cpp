@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database/QueryStats.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#include "utils/Logger.hpp"
+
+namespace Database {
+
+static
+bool
+isIdentifierChar(char c)
+{
+	return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static
+bool
+endsWith(const std::string& str, std::string_view suffix)
+{
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static
+void
+addLockWait(QueryStats::LockWaitStats& stats, std::chrono::microseconds duration)
+{
+	stats.count++;
+	stats.totalWait += duration;
+	stats.maxWait = std::max(stats.maxWait, duration);
+}
+
+QueryStats::QueryStats(std::optional<std::chrono::milliseconds> slowQueryThreshold)
+: _slowQueryThreshold {slowQueryThreshold}
+{
+}
+
+std::string
+QueryStats::getQueryShape(std::string_view sql)
+{
+	std::string res;
+	res.reserve(sql.size());
+
+	std::size_t i {};
+	while (i < sql.size())
+	{
+		const char c {sql[i]};
+
+		if (c == '\'')
+		{
+			// string literal, quotes are escaped by doubling them
+			for (++i; i < sql.size(); ++i)
+			{
+				if (sql[i] == '\'' && (i + 1 == sql.size() || sql[i + 1] != '\''))
+					break;
+				if (sql[i] == '\'')
+					++i;
+			}
+			++i;
+			res += '?';
+		}
+		else if (std::isdigit(static_cast<unsigned char>(c)) && (res.empty() || !isIdentifierChar(res.back())))
+		{
+			while (i < sql.size() && (std::isdigit(static_cast<unsigned char>(sql[i])) || sql[i] == '.'))
+				++i;
+			res += '?';
+		}
+		else if (c == ',' && (endsWith(res, "?") || endsWith(res, "?...")))
+		{
+			// collapse the placeholder lists: "?, ?, ?" becomes "?..."
+			std::size_t next {i + 1};
+			while (next < sql.size() && sql[next] == ' ')
+				++next;
+
+			if (next < sql.size() && sql[next] == '?')
+			{
+				if (!endsWith(res, "?..."))
+					res += "...";
+				i = next + 1;
+			}
+			else
+			{
+				res += c;
+				++i;
+			}
+		}
+		else
+		{
+			res += c;
+			++i;
+		}
+	}
+
+	return res;
+}
+
+void
+QueryStats::addQuery(const std::string& queryShape, const std::string& sql, std::chrono::microseconds duration, std::size_t rowCount)
+{
+	if (_slowQueryThreshold && duration >= *_slowQueryThreshold)
+		LMS_LOG(DB, INFO) << "Slow query (" << duration.count() / 1000 << " ms, " << rowCount << " row(s)): " << sql;
+
+	std::scoped_lock lock {_mutex};
+
+	QueryShapeStats& stats {_stats.queries[queryShape]};
+	stats.count++;
+	stats.rowCount += rowCount;
+	stats.totalDuration += duration;
+	stats.maxDuration = std::max(stats.maxDuration, duration);
+}
+
+void
+QueryStats::addSharedLockWait(std::chrono::microseconds duration)
+{
+	std::scoped_lock lock {_mutex};
+	addLockWait(_stats.sharedTransactions, duration);
+}
+
+void
+QueryStats::addUniqueLockWait(std::chrono::microseconds duration)
+{
+	std::scoped_lock lock {_mutex};
+	addLockWait(_stats.uniqueTransactions, duration);
+}
+
+QueryStats::Snapshot
+QueryStats::getSnapshot() const
+{
+	std::scoped_lock lock {_mutex};
+	return _stats;
+}
+
+} // namespace Database
+
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Rebuild.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Wt/Dbo/SqlStatement.h>
+#include <Wt/Dbo/backend/Sqlite3.h>
+
+#include "utils/Logger.hpp"
+
+namespace Database::Rebuild
+{
+
+namespace
+{
+	// Schema name of the current database, attached to the connection on the rebuilt one
+	const std::string currentSchema {"current_db"};
+
+	std::string
+	quoteString(const std::string& str)
+	{
+		std::string res {"'"};
+		for (const char c : str)
+		{
+			if (c == '\'')
+				res += "''";
+			else
+				res += c;
+		}
+		res += "'";
+
+		return res;
+	}
+
+	class ScopedAttachedDb
+	{
+		public:
+			ScopedAttachedDb(Wt::Dbo::SqlConnection& connection, const std::filesystem::path& dbPath)
+			: _connection {connection}
+			{
+				_connection.executeSql("ATTACH DATABASE " + quoteString(dbPath.string()) + " AS " + currentSchema);
+			}
+
+			~ScopedAttachedDb()
+			{
+				try
+				{
+					_connection.executeSql("DETACH DATABASE " + currentSchema);
+				}
+				catch (const std::exception& e)
+				{
+					LMS_LOG(DB, ERROR) << "Cannot detach database: " << e.what();
+				}
+			}
+
+			ScopedAttachedDb(const ScopedAttachedDb&) = delete;
+			ScopedAttachedDb(ScopedAttachedDb&&) = delete;
+			ScopedAttachedDb& operator=(const ScopedAttachedDb&) = delete;
+			ScopedAttachedDb& operator=(ScopedAttachedDb&&) = delete;
+
+		private:
+			Wt::Dbo::SqlConnection& _connection;
+	};
+
+	// Single transaction: the rebuilt database is synced on commit, including the pages written before without sync
+	template <typename Func>
+	void
+	runTransaction(Wt::Dbo::SqlConnection& connection, Func func)
+	{
+		connection.startTransaction();
+		try
+		{
+			func();
+			connection.commitTransaction();
+		}
+		catch (...)
+		{
+			connection.rollbackTransaction();
+			throw;
+		}
+	}
+
+	std::vector<std::string>
+	getColumnNames(Wt::Dbo::SqlConnection& connection, const std::string& table)
+	{
+		std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement("PRAGMA main.table_info(\"" + table + "\")")};
+		statement->execute();
+
+		// columns are cid, name, type, notnull, dflt_value and pk
+		std::vector<std::string> names;
+		std::string name;
+		while (statement->nextRow())
+		{
+			if (statement->getResult(1, &name, 0))
+				names.push_back(name);
+		}
+
+		return names;
+	}
+
+	// Both databases have the same schema, but not necessarily the same column order (migrations append columns)
+	// Ids of the given columns are translated using the given id maps: rows referring to objects not found are skipped
+	void
+	copyRows(Wt::Dbo::SqlConnection& connection, const std::string& table, const std::map<std::string, std::string>& translatedColumns = {})
+	{
+		std::string columns;
+		std::string values;
+		std::string joins;
+		for (const std::string& column : getColumnNames(connection, table))
+		{
+			if (!columns.empty())
+			{
+				columns += ", ";
+				values += ", ";
+			}
+			columns += "\"" + column + "\"";
+
+			auto itIdMap {translatedColumns.find(column)};
+			if (itIdMap == std::cend(translatedColumns))
+			{
+				values += "src.\"" + column + "\"";
+			}
+			else
+			{
+				const std::string idMapAlias {"map_" + column};
+				values += idMapAlias + ".new_id";
+				joins += " JOIN temp." + itIdMap->second + " " + idMapAlias + " ON " + idMapAlias + ".old_id = src.\"" + column + "\"";
+			}
+		}
+
+		connection.executeSql("INSERT OR IGNORE INTO main.\"" + table + "\" (" + columns + ") SELECT " + values + " FROM " + currentSchema + ".\"" + table + "\" src" + joins);
+	}
+
+	// First match wins
+	void
+	createIdMaps(Wt::Dbo::SqlConnection& connection)
+	{
+		for (const char* idMap : {"track_id_map", "release_id_map", "artist_id_map"})
+			connection.executeSql(std::string {"CREATE TEMP TABLE "} + idMap + " (old_id INTEGER PRIMARY KEY, new_id INTEGER NOT NULL)");
+
+		// MBIDs are empty blobs if not set
+		connection.executeSql("INSERT OR IGNORE INTO temp.track_id_map (old_id, new_id)"
+				" SELECT src.id, dst.id FROM " + currentSchema + ".track src JOIN main.track dst ON dst.file_path = src.file_path");
+		connection.executeSql("INSERT OR IGNORE INTO temp.track_id_map (old_id, new_id)"
+				" SELECT src.id, dst.id FROM " + currentSchema + ".track src JOIN main.track dst ON dst.mbid = src.mbid WHERE LENGTH(src.mbid) > 0");
+
+		connection.executeSql("INSERT OR IGNORE INTO temp.release_id_map (old_id, new_id)"
+				" SELECT src.id, dst.id FROM " + currentSchema + ".release src JOIN main.release dst ON dst.mbid = src.mbid WHERE LENGTH(src.mbid) > 0");
+		connection.executeSql("INSERT OR IGNORE INTO temp.release_id_map (old_id, new_id)"
+				" SELECT src.release_id, dst.release_id FROM " + currentSchema + ".track src"
+				" JOIN temp.track_id_map map ON map.old_id = src.id"
+				" JOIN main.track dst ON dst.id = map.new_id"
+				" WHERE src.release_id IS NOT NULL AND dst.release_id IS NOT NULL");
+
+		// Artists without MBID: the artist of the same name linked to the same track
+		connection.executeSql("INSERT OR IGNORE INTO temp.artist_id_map (old_id, new_id)"
+				" SELECT src.id, dst.id FROM " + currentSchema + ".artist src JOIN main.artist dst ON dst.mbid = src.mbid WHERE LENGTH(src.mbid) > 0");
+		connection.executeSql("INSERT OR IGNORE INTO temp.artist_id_map (old_id, new_id)"
+				" SELECT src.id, dst.id FROM " + currentSchema + ".track_artist_link src_link"
+				" JOIN temp.track_id_map map ON map.old_id = src_link.track_id"
+				" JOIN main.track_artist_link dst_link ON dst_link.track_id = map.new_id"
+				" JOIN " + currentSchema + ".artist src ON src.id = src_link.artist_id"
+				" JOIN main.artist dst ON dst.id = dst_link.artist_id AND dst.name = src.name");
+	}
+
+	std::unordered_map<IdType, IdType>
+	readIdMap(Wt::Dbo::SqlConnection& connection, const std::string& idMap)
+	{
+		std::unique_ptr<Wt::Dbo::SqlStatement> statement {connection.prepareStatement("SELECT old_id, new_id FROM temp." + idMap)};
+		statement->execute();
+
+		std::unordered_map<IdType, IdType> res;
+		IdType oldId {};
+		IdType newId {};
+		while (statement->nextRow())
+		{
+			if (statement->getResult(0, &oldId) && statement->getResult(1, &newId))
+				res.emplace(oldId, newId);
+		}
+
+		return res;
+	}
+
+} // namespace
+
+void
+copyScanSettings(const std::filesystem::path& rebuiltDbPath, const std::filesystem::path& currentDbPath)
+{
+	Wt::Dbo::backend::Sqlite3 connection {rebuiltDbPath.string()};
+	const ScopedAttachedDb attachedDb {connection, currentDbPath};
+
+	runTransaction(connection, [&]
+	{
+		copyRows(connection, "scan_settings");
+		copyRows(connection, "cluster_type");
+	});
+}
+
+IdMaps
+copyUserData(const std::filesystem::path& rebuiltDbPath, const std::filesystem::path& currentDbPath)
+{
+	Wt::Dbo::backend::Sqlite3 connection {rebuiltDbPath.string()};
+	const ScopedAttachedDb attachedDb {connection, currentDbPath};
+
+	runTransaction(connection, [&]
+	{
+		createIdMaps(connection);
+
+		copyRows(connection, "user");
+		copyRows(connection, "auth_token");
+		copyRows(connection, "tracklist");
+		// Entry ids are kept: they give the listen order and are referred to by the play stats
+		// The tracklist stats are computed by the triggers, using the durations of the rebuilt tracks
+		copyRows(connection, "tracklist_entry", {{"track_id", "track_id_map"}});
+		copyRows(connection, "tracklist_compaction");
+		// The triggers only counted the copied entries: the copied stats also count the compacted ones
+		connection.executeSql("DELETE FROM main.track_play_stats");
+		copyRows(connection, "track_play_stats", {{"track_id", "track_id_map"}});
+		copyRows(connection, "track_bookmark", {{"track_id", "track_id_map"}});
+		copyRows(connection, "user_artist_starred", {{"artist_id", "artist_id_map"}});
+		copyRows(connection, "user_release_starred", {{"release_id", "release_id_map"}});
+		copyRows(connection, "user_track_starred", {{"track_id", "track_id_map"}});
+		// Not read from the files, and slow to fetch again
+		copyRows(connection, "track_features", {{"track_id", "track_id_map"}});
+	});
+
+	IdMaps idMaps;
+	idMaps.artistIds = readIdMap(connection, "artist_id_map");
+	idMaps.releaseIds = readIdMap(connection, "release_id_map");
+	idMaps.trackIds = readIdMap(connection, "track_id_map");
+
+	LMS_LOG(DB, INFO) << "Found " << idMaps.trackIds.size() << " track(s), " << idMaps.releaseIds.size() << " release(s) and " << idMaps.artistIds.size() << " artist(s) in the rebuilt database";
+
+	return idMaps;
+}
+
+} // namespace Database::Rebuild
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <unordered_map>
+
+#include "database/Types.hpp"
+
+// Copies between a database being used and its rebuilt version, using a dedicated connection on the rebuilt file
+namespace Database::Rebuild
+{
+	// Ids of the current objects found in the rebuilt database
+	struct IdMaps
+	{
+		std::unordered_map<IdType, IdType>	artistIds;
+		std::unordered_map<IdType, IdType>	releaseIds;
+		std::unordered_map<IdType, IdType>	trackIds;
+	};
+
+	// Settings needed by the scanner to fill the rebuilt database, ids are kept
+	void copyScanSettings(const std::filesystem::path& rebuiltDbPath, const std::filesystem::path& currentDbPath);
+
+	// Users and their data: ids of the users and of their playlists are kept, the rest refers to the rebuilt objects
+	// Tracks are found using their file path, then their MBID. Releases and artists using their MBID, then their tracks
+	// Must be called once the indexes of the rebuilt database are created, and while the current database is not written
+	IdMaps copyUserData(const std::filesystem::path& rebuiltDbPath, const std::filesystem::path& currentDbPath);
+}
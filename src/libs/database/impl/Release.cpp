@@ -28,6 +28,7 @@
 #include "database/User.hpp"
 #include "utils/Logger.hpp"
 #include "SqlQuery.hpp"
+#include "Utils.hpp"
 
 namespace Database
 {
@@ -44,10 +45,19 @@ createQuery(Session& session,
 	auto query {session.getDboSession().query<T>(queryStr)};
 	query.join("track t ON t.release_id = r.id");
 
-	for (const std::string& keyword : keywords)
-		query.where("r.name LIKE ?").bind("%%" + keyword + "%%");
+	if (!keywords.empty() && Utils::canUseSearchIndex(session, keywords))
+	{
+		query.where("r.id IN (SELECT rowid FROM release_fts WHERE release_fts MATCH ?)").bind(Utils::getSearchIndexMatchQuery(keywords));
+	}
+	else
+	{
+		for (const std::string& keyword : keywords)
+			query.where("r.name LIKE ?").bind("%%" + keyword + "%%");
+	}
 
-	if (!clusterIds.empty())
+	// Multiple clusters: intersect them using the in memory index if the result is small enough
+	const bool filteredOnClusters {clusterIds.size() > 1 && Utils::filterOnClustersUsingIndex(session, query, clusterIds, "r.id IN (SELECT t.release_id FROM track t WHERE t.id IN (", "))")};
+	if (!clusterIds.empty() && !filteredOnClusters)
 	{
 		std::ostringstream oss;
 		oss << "r.id IN (SELECT DISTINCT r.id FROM release r"
@@ -73,7 +83,7 @@ createQuery(Session& session,
 
 Release::Release(const std::string& name, const std::optional<UUID>& MBID)
 : _name {std::string(name, 0 , _maxNameLength)},
-_MBID {MBID ? MBID->getAsString() : ""}
+_MBID {MBID ? MBID->getAsBytes() : std::vector<unsigned char> {}}
 {
 
 }
@@ -92,7 +102,7 @@ Release::getByMBID(Session& session, const UUID& mbid)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<Release>().where("mbid = ?").bind(std::string {mbid.getAsString()});
+	return session.getDboSession().find<Release>().where("mbid = ?").bind(mbid.getAsBytes());
 }
 
 Release::pointer
@@ -100,13 +110,21 @@ Release::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<Release>().where("id = ?").bind(id);
+	return Utils::getById<Release>(session.getDboSession(), id);
+}
+
+std::vector<Release::pointer>
+Release::getByIds(Session& session, const std::vector<IdType>& ids)
+{
+	session.checkSharedLocked();
+
+	return Utils::getByIdsInOrder<Release>(session.getDboSession(), "release", ids);
 }
 
 Release::pointer
 Release::create(Session& session, const std::string& name, const std::optional<UUID>& MBID)
 {
-	session.checkSharedLocked();
+	session.checkUniqueLocked();
 
 	Release::pointer res {session.getDboSession().add(std::make_unique<Release>(name, MBID))};
 	session.getDboSession().flush();
@@ -167,13 +185,9 @@ Release::getAllRandom(Session& session, const std::set<IdType>& clusterIds, std:
 {
 	session.checkSharedLocked();
 
-	auto query {createQuery<Release::pointer>(session, "SELECT DISTINCT r from release r", clusterIds,{})};
-
-	Wt::Dbo::collection<pointer> res = query
-		.orderBy("RANDOM()")
-		.limit(size ? static_cast<int>(*size) : -1);
+	auto query {createQuery<IdType>(session, "SELECT DISTINCT r.id from release r", clusterIds,{})};
 
-	return std::vector<pointer>(res.begin(), res.end());
+	return Utils::getByIdsInOrder<Release>(session.getDboSession(), "release", Utils::fetchRandomIds(query, size));
 }
 
 std::vector<IdType>
@@ -183,11 +197,7 @@ Release::getAllIdsRandom(Session& session, const std::set<IdType>& clusterIds, s
 
 	auto query {createQuery<IdType>(session, "SELECT DISTINCT r.id from release r", clusterIds,{})};
 
-	Wt::Dbo::collection<IdType> res = query
-		.orderBy("RANDOM()")
-		.limit(size ? static_cast<int>(*size) : -1);
-
-	return std::vector<IdType>(res.begin(), res.end());
+	return Utils::fetchRandomIds(query, size);
 }
 
 
@@ -201,6 +211,31 @@ Release::getAllOrphans(Session& session)
 	return std::vector<pointer>(res.begin(), res.end());
 }
 
+std::size_t
+Release::removeAllOrphans(Session& session)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().flush();
+	session.getDboSession().execute("DELETE FROM release WHERE NOT EXISTS(SELECT 1 FROM track t WHERE t.release_id = release.id)");
+
+	return session.getDboSession().query<int>("SELECT changes()");
+}
+
+void
+Release::updateAggregates(Session& session)
+{
+	session.checkUniqueLocked();
+
+	const std::string trackCount {"(SELECT COUNT(*) FROM track t WHERE t.release_id = release.id)"};
+	const std::string duration {"(SELECT COALESCE(SUM(t.duration), 0) FROM track t WHERE t.release_id = release.id)"};
+
+	// Only write the releases that actually changed
+	session.getDboSession().flush();
+	session.getDboSession().execute("UPDATE release SET track_count = " + trackCount + ", duration = " + duration
+			+ " WHERE track_count IS NOT " + trackCount + " OR duration IS NOT " + duration);
+}
+
 std::vector<Release::pointer>
 Release::getLastWritten(Session& session,
 		std::optional<Wt::WDateTime> after,
@@ -246,15 +281,10 @@ Release::getByYear(Session& session, int yearFrom, int yearTo, std::optional<Ran
 	return std::vector<pointer>(res.begin(), res.end());
 }
 
-std::vector<Release::pointer>
-Release::getStarred(Session& session,
-		User::pointer user,
-		const std::set<IdType>& clusterIds,
-		std::optional<Range> range,
-		bool& moreResults)
+static
+Wt::Dbo::Query<Release::pointer>
+createStarredQuery(Session& session, const User::pointer& user, const std::set<IdType>& clusterIds)
 {
-	session.checkSharedLocked();
-
 	auto query {createQuery<Release::pointer>(session, "SELECT r from release r", clusterIds, {})};
 	{
 		std::ostringstream oss;
@@ -265,10 +295,22 @@ Release::getStarred(Session& session,
 		query.bind(user.id());
 		query.where(oss.str());
 	}
+	query.groupBy("r.id");
 
-	Wt::Dbo::collection<Release::pointer> collection = query
-		.groupBy("r.id")
-		.orderBy("r.name COLLATE NOCASE")
+	return query;
+}
+
+std::vector<Release::pointer>
+Release::getStarred(Session& session,
+		User::pointer user,
+		const std::set<IdType>& clusterIds,
+		std::optional<Range> range,
+		bool& moreResults)
+{
+	session.checkSharedLocked();
+
+	Wt::Dbo::collection<Release::pointer> collection = createStarredQuery(session, user, clusterIds)
+		.orderBy("r.name COLLATE NOCASE, r.id")
 		.offset(range ? static_cast<int>(range->offset) : -1)
 		.limit(range ? static_cast<int>(range->limit) + 1: -1);
 
@@ -282,8 +324,22 @@ Release::getStarred(Session& session,
 		moreResults = false;
 
 	return res;
+}
+
+std::vector<Release::pointer>
+Release::getStarred(Session& session,
+		User::pointer user,
+		const std::set<IdType>& clusterIds,
+		const std::optional<Cursor>& after,
+		std::size_t limit,
+		bool& moreResults)
+{
+	session.checkSharedLocked();
 
+	auto query {createStarredQuery(session, user, clusterIds)};
+	Utils::applyCursor(query, "r.name", "r.id", after, limit);
 
+	return Utils::fetchCursorResults(query, limit, moreResults);
 }
 
 std::vector<Release::pointer>
@@ -308,7 +364,7 @@ Release::getByFilter(Session& session,
 
 	Wt::Dbo::collection<pointer> collection = createQuery<Release::pointer>(session, "SELECT r from release r", clusterIds, keywords)
 		.groupBy("r.id")
-		.orderBy("r.name COLLATE NOCASE")
+		.orderBy("r.name COLLATE NOCASE, r.id")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
 
@@ -325,6 +381,23 @@ Release::getByFilter(Session& session,
 	return res;
 }
 
+std::vector<Release::pointer>
+Release::getByFilter(Session& session,
+		const std::set<IdType>& clusterIds,
+		const std::vector<std::string>& keywords,
+		const std::optional<Cursor>& after,
+		std::size_t limit,
+		bool& moreResults)
+{
+	session.checkSharedLocked();
+
+	auto query {createQuery<Release::pointer>(session, "SELECT r from release r", clusterIds, keywords)};
+	query.groupBy("r.id");
+	Utils::applyCursor(query, "r.name", "r.id", after, limit);
+
+	return Utils::fetchCursorResults(query, limit, moreResults);
+}
+
 std::vector<IdType>
 Release::getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit)
 {
@@ -339,6 +412,30 @@ Release::getAllIdsWithClusters(Session& session, std::optional<std::size_t> limi
 	return std::vector<IdType>(res.begin(), res.end());
 }
 
+bool
+Release::hasPrecomputedSimilarReleases(Session& session)
+{
+	session.checkSharedLocked();
+
+	return Utils::hasSimilarIds(session, "release");
+}
+
+std::vector<IdType>
+Release::getPrecomputedSimilarReleaseIds(Session& session, IdType releaseId, std::size_t maxCount)
+{
+	session.checkSharedLocked();
+
+	return Utils::getSimilarIds(session, "release", releaseId, maxCount);
+}
+
+void
+Release::setPrecomputedSimilarReleases(Session& session, const std::vector<std::pair<IdType, std::vector<IdType>>>& similarReleaseIds)
+{
+	session.checkUniqueLocked();
+
+	Utils::replaceSimilarIds(session, "release", similarReleaseIds);
+}
+
 
 std::optional<std::size_t>
 Release::getTotalTrack(void) const
@@ -449,6 +546,141 @@ Release::getArtists(TrackArtistLinkType linkType) const
 	return std::vector<Wt::Dbo::ptr<Artist>>(res.begin(), res.end());
 }
 
+std::unordered_map<IdType, std::vector<Artist::pointer>>
+Release::getArtistsByRelease(Session& session, const std::vector<IdType>& releaseIds, TrackArtistLinkType linkType)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, Artist::pointer>;
+
+	std::unordered_map<IdType, std::vector<Artist::pointer>> res;
+
+	Utils::forEachIdChunk(releaseIds, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.getDboSession().query<QueryResultType>(
+				"SELECT DISTINCT t.release_id, a FROM artist a"
+				" INNER JOIN track_artist_link t_a_l ON t_a_l.artist_id = a.id"
+				" INNER JOIN track t ON t.id = t_a_l.track_id")};
+
+		query.where("t.release_id IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType releaseId : chunkIds)
+			query.bind(releaseId);
+
+		query.where("t_a_l.type = ?").bind(linkType);
+
+		Wt::Dbo::collection<QueryResultType> collection = query;
+		for (const auto& [releaseId, artist] : collection)
+			res[releaseId].push_back(artist);
+	});
+
+	return res;
+}
+
+std::vector<Release::ListEntry>
+Release::getListEntries(Session& session, const std::vector<IdType>& releaseIds)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, std::string, int, IdType, std::string>;
+
+	struct Entry
+	{
+		ListEntry				listEntry;
+		std::vector<ObjectRef>	releaseArtists;
+	};
+	std::unordered_map<IdType, Entry> entries;
+
+	Utils::forEachIdChunk(releaseIds, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.getDboSession().query<QueryResultType>(
+				"SELECT r.id, r.name, COALESCE(t_a_l.type, -1), COALESCE(a.id, -1), COALESCE(a.name, '') FROM release r"
+				" LEFT OUTER JOIN track t ON t.release_id = r.id"
+				" LEFT OUTER JOIN track_artist_link t_a_l ON t_a_l.track_id = t.id AND t_a_l.type IN ("
+					+ std::to_string(static_cast<int>(TrackArtistLinkType::Artist)) + ", "
+					+ std::to_string(static_cast<int>(TrackArtistLinkType::ReleaseArtist)) + ")"
+				" LEFT OUTER JOIN artist a ON a.id = t_a_l.artist_id")};
+
+		query.where("r.id IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType releaseId : chunkIds)
+			query.bind(releaseId);
+
+		query.groupBy("r.id, t_a_l.type, a.id");
+
+		// ids may be split across chunks if they are repeated
+		std::unordered_map<IdType, Entry> chunkEntries;
+
+		Wt::Dbo::collection<QueryResultType> collection = query;
+		for (const auto& [releaseId, releaseName, linkType, artistId, artistName] : collection)
+		{
+			auto [it, inserted] {chunkEntries.try_emplace(releaseId)};
+			Entry& entry {it->second};
+			if (inserted)
+			{
+				entry.listEntry.id = releaseId;
+				entry.listEntry.name = releaseName;
+			}
+
+			if (!IdIsValid(artistId))
+				continue;
+
+			if (linkType == static_cast<int>(TrackArtistLinkType::ReleaseArtist))
+				entry.releaseArtists.push_back(ObjectRef {artistId, artistName});
+			else
+				entry.listEntry.artists.push_back(ObjectRef {artistId, artistName});
+		}
+
+		for (auto& [releaseId, entry] : chunkEntries)
+		{
+			if (!entry.releaseArtists.empty())
+				entry.listEntry.artists = std::move(entry.releaseArtists);
+
+			entries.try_emplace(releaseId, std::move(entry));
+		}
+	});
+
+	std::vector<ListEntry> res;
+	res.reserve(releaseIds.size());
+	for (const IdType releaseId : releaseIds)
+	{
+		if (auto it {entries.find(releaseId)}; it != std::cend(entries))
+			res.push_back(it->second.listEntry);
+	}
+
+	return res;
+}
+
+std::unordered_map<IdType, Cluster::pointer>
+Release::getFirstClusterByRelease(Session& session, const std::vector<IdType>& releaseIds, IdType clusterTypeId)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, Cluster::pointer>;
+
+	std::unordered_map<IdType, Cluster::pointer> res;
+
+	Utils::forEachIdChunk(releaseIds, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.getDboSession().query<QueryResultType>(
+				"SELECT t.release_id, c FROM cluster c"
+				" INNER JOIN track_cluster t_c ON t_c.cluster_id = c.id"
+				" INNER JOIN track t ON t.id = t_c.track_id")};
+
+		query.where("c.cluster_type_id = ?").bind(clusterTypeId);
+		query.where("t.release_id IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType releaseId : chunkIds)
+			query.bind(releaseId);
+
+		query.groupBy("t.release_id, c.id");
+		query.orderBy("t.release_id, COUNT(c.id) DESC, c.id");
+
+		Wt::Dbo::collection<QueryResultType> collection = query;
+		for (const auto& [releaseId, cluster] : collection)
+			res.try_emplace(releaseId, cluster);
+	});
+
+	return res;
+}
+
 std::vector<Release::pointer>
 Release::getSimilarReleases(std::optional<std::size_t> offset, std::optional<std::size_t> count) const
 {
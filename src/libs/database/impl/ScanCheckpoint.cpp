@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database/ScanCheckpoint.hpp"
+
+#include "database/Session.hpp"
+#include "utils/String.hpp"
+
+namespace Database {
+
+namespace
+{
+	std::vector<std::filesystem::path>
+	splitPaths(std::string_view paths)
+	{
+		std::vector<std::filesystem::path> res;
+		for (const std::string_view path : StringUtils::splitStringViews(paths, "\n"))
+		{
+			if (!path.empty())
+				res.emplace_back(path);
+		}
+
+		return res;
+	}
+
+	std::string
+	joinPaths(const std::vector<std::filesystem::path>& paths)
+	{
+		std::vector<std::string> res;
+		for (const std::filesystem::path& path : paths)
+			res.push_back(path.string());
+
+		return StringUtils::joinStrings(res, "\n");
+	}
+}
+
+ScanCheckpoint::pointer
+ScanCheckpoint::get(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().find<ScanCheckpoint>().limit(1);
+}
+
+ScanCheckpoint::pointer
+ScanCheckpoint::getOrCreate(Session& session)
+{
+	session.checkUniqueLocked();
+
+	pointer res {get(session)};
+	if (!res)
+	{
+		res = session.getDboSession().add(std::make_unique<ScanCheckpoint>());
+		session.getDboSession().flush();
+	}
+
+	return res;
+}
+
+void
+ScanCheckpoint::removeAll(Session& session)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().execute("DELETE FROM scan_checkpoint");
+}
+
+std::vector<std::filesystem::path>
+ScanCheckpoint::getMediaDirectories() const
+{
+	return splitPaths(_mediaDirectory);
+}
+
+std::vector<std::filesystem::path>
+ScanCheckpoint::getDirectories() const
+{
+	return splitPaths(_directory);
+}
+
+void
+ScanCheckpoint::setMediaDirectories(const std::vector<std::filesystem::path>& directories)
+{
+	_mediaDirectory = joinPaths(directories);
+}
+
+void
+ScanCheckpoint::setDirectories(const std::vector<std::filesystem::path>& directories)
+{
+	_directory = joinPaths(directories);
+}
+
+ScanCheckpoint::Counters
+ScanCheckpoint::getCounters() const
+{
+	Counters counters;
+
+	counters.filesScanned = _filesScanned;
+	counters.skips = _skips;
+	counters.scans = _scans;
+	counters.additions = _additions;
+	counters.deletions = _deletions;
+	counters.updates = _updates;
+	counters.moves = _moves;
+	counters.featuresFetched = _featuresFetched;
+
+	return counters;
+}
+
+void
+ScanCheckpoint::setCounters(const Counters& counters)
+{
+	_filesScanned = counters.filesScanned;
+	_skips = counters.skips;
+	_scans = counters.scans;
+	_additions = counters.additions;
+	_deletions = counters.deletions;
+	_updates = counters.updates;
+	_moves = counters.moves;
+	_featuresFetched = counters.featuresFetched;
+}
+
+} // namespace Database
+
@@ -82,10 +82,31 @@ ScanSettings::getClusterTypes() const
 	return std::vector<ClusterType::pointer>(std::cbegin(_clusterTypes), std::cend(_clusterTypes));
 }
 
+std::vector<std::filesystem::path>
+ScanSettings::getMediaDirectories() const
+{
+	std::vector<std::filesystem::path> directories;
+	for (const std::string_view directory : StringUtils::splitStringViews(_mediaDirectory, "\n"))
+	{
+		if (!directory.empty())
+			directories.emplace_back(directory);
+	}
+
+	return directories;
+}
+
 void
-ScanSettings::setMediaDirectory(const std::filesystem::path& p)
+ScanSettings::setMediaDirectories(const std::vector<std::filesystem::path>& directories)
 {
-	_mediaDirectory = StringUtils::stringTrimEnd(p.string(), "/\\");
+	std::vector<std::string> directoryNames;
+	for (const std::filesystem::path& directory : directories)
+	{
+		std::string directoryName {StringUtils::stringTrimEnd(directory.string(), "/\\")};
+		if (!directoryName.empty())
+			directoryNames.emplace_back(std::move(directoryName));
+	}
+
+	_mediaDirectory = StringUtils::joinStrings(directoryNames, "\n");
 }
 
 template <typename It>
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database/ScannedDirectory.hpp"
+
+#include "database/Session.hpp"
+#include "Utils.hpp"
+
+namespace Database {
+
+ScannedDirectory::ScannedDirectory(const std::filesystem::path& p, const Wt::WDateTime& lastWriteTime, std::size_t scanVersion)
+: _path {p.string()},
+_lastWrite {lastWriteTime},
+_scanVersion {static_cast<int>(scanVersion)}
+{
+}
+
+ScannedDirectory::pointer
+ScannedDirectory::create(Session& session, const std::filesystem::path& p, const Wt::WDateTime& lastWriteTime, std::size_t scanVersion)
+{
+	session.checkUniqueLocked();
+
+	ScannedDirectory::pointer res {session.getDboSession().add(std::make_unique<ScannedDirectory>(p, lastWriteTime, scanVersion))};
+	session.getDboSession().flush();
+
+	return res;
+}
+
+void
+ScannedDirectory::removeAll(Session& session)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().execute("DELETE FROM scanned_directory");
+}
+
+std::vector<ScannedDirectory::pointer>
+ScannedDirectory::getAll(Session& session)
+{
+	session.checkSharedLocked();
+
+	Wt::Dbo::collection<ScannedDirectory::pointer> res {session.getDboSession().find<ScannedDirectory>()};
+
+	return std::vector<ScannedDirectory::pointer>(std::cbegin(res), std::cend(res));
+}
+
+ScannedDirectory::pointer
+ScannedDirectory::getById(Session& session, IdType id)
+{
+	session.checkSharedLocked();
+
+	return Utils::getById<ScannedDirectory>(session.getDboSession(), id);
+}
+
+} // namespace Database
+
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database/ScannerLease.hpp"
+
+#include <Wt/Dbo/Dbo.h>
+
+#include "database/Session.hpp"
+
+namespace Database::ScannerLease {
+
+namespace {
+
+	long long
+	toSeconds(std::chrono::system_clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+	}
+
+} // namespace
+
+void
+prepare(Session& session)
+{
+	session.checkUniqueLocked();
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+
+	dboSession.execute(R"(CREATE TABLE IF NOT EXISTS "scanner_lease" ("node" text not null, "expiry" bigint not null, "library_generation" bigint not null))");
+	dboSession.execute("INSERT INTO scanner_lease (node, expiry, library_generation) SELECT '', 0, 0 WHERE NOT EXISTS (SELECT 1 FROM scanner_lease)");
+}
+
+bool
+acquire(Session& session, const std::string& node, std::chrono::seconds duration)
+{
+	session.checkUniqueLocked();
+
+	const auto now {std::chrono::system_clock::now()};
+
+	session.getDboSession().execute("UPDATE scanner_lease SET node = ?, expiry = ? WHERE node = ? OR expiry <= ?")
+		.bind(node)
+		.bind(toSeconds(now + duration))
+		.bind(node)
+		.bind(toSeconds(now));
+
+	return session.getDboSession().query<int>("SELECT changes()").resultValue() > 0;
+}
+
+void
+release(Session& session, const std::string& node)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().execute("UPDATE scanner_lease SET expiry = 0 WHERE node = ?").bind(node);
+}
+
+long long
+getLibraryGeneration(Session& session)
+{
+	session.checkSharedLocked();
+
+	return session.getDboSession().query<long long>("SELECT library_generation FROM scanner_lease").resultValue();
+}
+
+void
+publishLibraryGeneration(Session& session, const std::string& node)
+{
+	session.checkUniqueLocked();
+
+	// A node that has lost the lease meanwhile must not make the other nodes reload
+	session.getDboSession().execute("UPDATE scanner_lease SET library_generation = library_generation + 1 WHERE node = ?").bind(node);
+}
+
+} // namespace Database::ScannerLease
@@ -19,17 +19,31 @@
 
 #include "database/Session.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <map>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 
 #include "utils/Exception.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/String.hpp"
+#include "utils/Tracing.hpp"
+#include "utils/UUID.hpp"
 
 #include "database/Artist.hpp"
 #include "database/Cluster.hpp"
 #include "database/Db.hpp"
+#include "database/QueryStats.hpp"
 #include "database/Release.hpp"
+#include "database/ScanCheckpoint.hpp"
+#include "database/ScannedDirectory.hpp"
+#include "database/ScannerLease.hpp"
 #include "database/ScanSettings.hpp"
 #include "database/Track.hpp"
 #include "database/TrackBookmark.hpp"
@@ -38,12 +52,95 @@
 #include "database/TrackFeatures.hpp"
 #include "database/User.hpp"
 
+#include "ClusterTrackIndex.hpp"
+#include "ConnectionPool.hpp"
+
 namespace Database {
 
-#define LMS_DATABASE_VERSION	27
+#define LMS_DATABASE_VERSION	38
 
 using Version = std::size_t;
 
+// Not mapped to a class: play count and last entry of each track in each tracklist, used to get the top and recent artists/releases/tracks
+static const std::string trackPlayStatsTable {R"(
+CREATE TABLE IF NOT EXISTS "track_play_stats" (
+  "tracklist_id" bigint not null,
+  "track_id" bigint not null,
+  "play_count" integer not null,
+  "last_entry_id" bigint not null,
+  primary key ("tracklist_id", "track_id"),
+  constraint "fk_track_play_stats_tracklist" foreign key ("tracklist_id") references "tracklist" ("id") on delete cascade deferrable initially deferred,
+  constraint "fk_track_play_stats_track" foreign key ("track_id") references "track" ("id") on delete cascade deferrable initially deferred
+))"};
+
+// Not mapped to a class: entries up to compacted_entry_id have been removed from the tracklist, but are still counted in its play stats
+static const std::string tracklistCompactionTable {R"(
+CREATE TABLE IF NOT EXISTS "tracklist_compaction" (
+  "tracklist_id" bigint not null primary key,
+  "compacted_entry_id" bigint not null,
+  constraint "fk_tracklist_compaction_tracklist" foreign key ("tracklist_id") references "tracklist" ("id") on delete cascade deferrable initially deferred
+))"};
+
+// Not mapped to a class (so that saving a tracklist does not overwrite them): entry count and total duration of each tracklist
+// Tracklists without a row have no entries
+static const std::string tracklistStatsTable {R"(
+CREATE TABLE IF NOT EXISTS "tracklist_stats" (
+  "tracklist_id" bigint not null primary key,
+  "entry_count" integer not null,
+  "duration" integer not null,
+  constraint "fk_tracklist_stats_tracklist" foreign key ("tracklist_id") references "tracklist" ("id") on delete cascade deferrable initially deferred
+))"};
+
+// Not mapped to a class: similar releases and artists precomputed by the recommendation engine, by position (best first)
+static const std::string releaseSimilarityTable {R"(
+CREATE TABLE IF NOT EXISTS "release_similarity" (
+  "release_id" bigint not null,
+  "position" integer not null,
+  "similar_release_id" bigint not null,
+  primary key ("release_id", "position"),
+  constraint "fk_release_similarity_release" foreign key ("release_id") references "release" ("id") on delete cascade deferrable initially deferred,
+  constraint "fk_release_similarity_similar_release" foreign key ("similar_release_id") references "release" ("id") on delete cascade deferrable initially deferred
+))"};
+
+static const std::string artistSimilarityTable {R"(
+CREATE TABLE IF NOT EXISTS "artist_similarity" (
+  "artist_id" bigint not null,
+  "position" integer not null,
+  "similar_artist_id" bigint not null,
+  primary key ("artist_id", "position"),
+  constraint "fk_artist_similarity_artist" foreign key ("artist_id") references "artist" ("id") on delete cascade deferrable initially deferred,
+  constraint "fk_artist_similarity_similar_artist" foreign key ("similar_artist_id") references "artist" ("id") on delete cascade deferrable initially deferred
+))"};
+
+// Not mapped to a class: raw tags of each track, as read by the scanner from the file in the given state
+static const std::string trackTagsTable {R"(
+CREATE TABLE IF NOT EXISTS "track_tags" (
+  "track_id" bigint not null primary key,
+  "file_last_write" bigint not null,
+  "file_size" bigint not null,
+  "data" blob not null,
+  constraint "fk_track_tags_track" foreign key ("track_id") references "track" ("id") on delete cascade deferrable initially deferred
+))"};
+
+// MBIDs used to be stored as text, store them as 16 byte blobs (empty if not set)
+static
+void
+convertMBIDsToBinary(Wt::Dbo::Session& session, const std::string& table)
+{
+	using TextMBID = std::tuple<IdType, std::string>;
+
+	Wt::Dbo::collection<TextMBID> res = session.query<TextMBID>("SELECT id, mbid FROM " + table).where("typeof(mbid) = 'text'");
+	const std::vector<TextMBID> textMBIDs(res.begin(), res.end());
+
+	for (const auto& [id, mbid] : textMBIDs)
+	{
+		const std::optional<UUID> uuid {UUID::fromString(mbid)};
+		session.execute("UPDATE " + table + " SET mbid = ? WHERE id = ?").bind(uuid ? uuid->getAsBytes() : std::vector<unsigned char> {}).bind(id);
+	}
+
+	LMS_LOG(DB, INFO) << "Converted " << textMBIDs.size() << " MBID(s) in table '" << table << "'";
+}
+
 class VersionInfo
 {
 	public:
@@ -284,6 +381,107 @@ CREATE TABLE "user_backup" (
 			// Just increment the scan version of the settings to make the next scheduled scan rescan everything
 			ScanSettings::get(*this).modify()->incScanVersion();
 		}
+		else if (version == 27)
+		{
+			_session.execute(R"(
+CREATE TABLE IF NOT EXISTS "scanned_directory" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "path" text not null,
+  "last_write" text,
+  "scan_version" integer not null
+))");
+		}
+		else if (version == 28)
+		{
+			// Content fingerprint, to detect moved files
+			_session.execute("ALTER TABLE track ADD fingerprint TEXT NOT NULL DEFAULT ''");
+			// Just increment the scan version of the settings to make the next scheduled scan rescan everything
+			ScanSettings::get(*this).modify()->incScanVersion();
+		}
+		else if (version == 29)
+		{
+			_session.execute(R"(
+CREATE TABLE IF NOT EXISTS "scan_checkpoint" (
+  "id" integer primary key autoincrement,
+  "version" integer not null,
+  "scan_version" integer not null,
+  "force_scan" boolean not null,
+  "media_directory" text not null,
+  "step" integer not null,
+  "directory" text not null,
+  "start_time" text,
+  "files_scanned" bigint not null,
+  "skips" bigint not null,
+  "scans" bigint not null,
+  "additions" bigint not null,
+  "deletions" bigint not null,
+  "updates" bigint not null,
+  "moves" bigint not null,
+  "features_fetched" bigint not null
+))");
+		}
+		else if (version == 30)
+		{
+			// File size, to reuse the audio properties of unchanged files (0 means unknown)
+			_session.execute("ALTER TABLE track ADD file_size BIGINT NOT NULL DEFAULT 0");
+		}
+		else if (version == 31)
+		{
+			// Compact copy of the features used by the classifier, filled in by the scanner
+			_session.execute("ALTER TABLE track_features ADD feature_values BLOB NOT NULL DEFAULT x''");
+		}
+		else if (version == 32)
+		{
+			// Cached aggregates
+			_session.execute("ALTER TABLE release ADD track_count INTEGER NOT NULL DEFAULT 0");
+			_session.execute("ALTER TABLE release ADD duration INTEGER NOT NULL DEFAULT 0");
+			_session.execute("ALTER TABLE artist ADD release_count INTEGER NOT NULL DEFAULT 0");
+			_session.execute("ALTER TABLE artist ADD track_count INTEGER NOT NULL DEFAULT 0");
+			_session.execute("ALTER TABLE cluster ADD track_count INTEGER NOT NULL DEFAULT 0");
+			_session.execute("ALTER TABLE cluster ADD release_count INTEGER NOT NULL DEFAULT 0");
+
+			Release::updateAggregates(*this);
+			Artist::updateAggregates(*this);
+			Cluster::updateAggregates(*this);
+		}
+		else if (version == 33)
+		{
+			// Whole file CRC32, computed on first download
+			_session.execute("ALTER TABLE track ADD crc32 BIGINT NOT NULL DEFAULT -1");
+			_session.execute("ALTER TABLE track ADD crc32_file_last_write TEXT");
+		}
+		else if (version == 34)
+		{
+			// Per tracklist play stats, kept up to date using triggers (see prepareTables)
+			_session.execute(trackPlayStatsTable);
+			_session.execute("INSERT INTO track_play_stats (tracklist_id, track_id, play_count, last_entry_id)"
+					" SELECT tracklist_id, track_id, COUNT(*), MAX(id) FROM tracklist_entry"
+					" WHERE tracklist_id IS NOT NULL AND track_id IS NOT NULL"
+					" GROUP BY tracklist_id, track_id");
+		}
+		else if (version == 35)
+		{
+			// MBIDs stored as binary UUIDs
+			for (const char* table : {"artist", "release", "track"})
+				convertMBIDsToBinary(_session, table);
+		}
+		else if (version == 36)
+		{
+			// Play stats triggers now ignore the compacted entries, recreated in prepareTables
+			_session.execute("DROP TRIGGER IF EXISTS track_play_stats_delete");
+			_session.execute("DROP TRIGGER IF EXISTS track_play_stats_update");
+		}
+		else if (version == 37)
+		{
+			// Per tracklist entry count and duration, kept up to date using triggers (see prepareTables)
+			_session.execute(tracklistStatsTable);
+			_session.execute("INSERT INTO tracklist_stats (tracklist_id, entry_count, duration)"
+					" SELECT p_e.tracklist_id, COUNT(*), COALESCE(SUM(t.duration), 0) FROM tracklist_entry p_e"
+					" LEFT JOIN track t ON t.id = p_e.track_id"
+					" WHERE p_e.tracklist_id IS NOT NULL"
+					" GROUP BY p_e.tracklist_id");
+		}
 		else
 		{
 			LMS_LOG(DB, ERROR) << "Database version " << version << " cannot be handled using migration";
@@ -305,6 +503,8 @@ Session::Session(Db& db)
 	_session.mapClass<Cluster>("cluster");
 	_session.mapClass<ClusterType>("cluster_type");
 	_session.mapClass<Release>("release");
+	_session.mapClass<ScanCheckpoint>("scan_checkpoint");
+	_session.mapClass<ScannedDirectory>("scanned_directory");
 	_session.mapClass<ScanSettings>("scan_settings");
 	_session.mapClass<Track>("track");
 	_session.mapClass<TrackBookmark>("track_bookmark");
@@ -323,10 +523,34 @@ enum class OwnedLock
 	Unique,
 };
 
-static thread_local std::map<std::shared_mutex*, OwnedLock> lockDebug;
+static thread_local std::map<ProfiledSharedMutex*, OwnedLock> lockDebug;
+
+static Metrics::Histogram& uniqueLockWait {Metrics::getHistogram("lms_db_unique_lock_wait_seconds", "Time spent waiting for the database lock by the write transactions")};
+static Metrics::Histogram& sharedLockWait {Metrics::getHistogram("lms_db_shared_lock_wait_seconds", "Time spent waiting for the database lock by the read transactions")};
+
+template <typename Lock>
+static
+Lock
+acquireLock(ProfiledSharedMutex& mutex, const void* callSite, Metrics::Histogram& lockWait, QueryStats* queryStats, void (QueryStats::*addLockWait)(std::chrono::microseconds))
+{
+	const auto start {std::chrono::steady_clock::now()};
+	const Tracing::Span span {"db.lock_wait"};
+	if constexpr (std::is_same_v<Lock, std::unique_lock<ProfiledSharedMutex>>)
+		mutex.lock(callSite);
+	else
+		mutex.lock_shared(callSite);
+	Lock lock {mutex, std::adopt_lock};
+	const auto wait {std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)};
+
+	lockWait.record(wait);
+	if (queryStats)
+		(queryStats->*addLockWait)(wait);
+
+	return lock;
+}
 
-UniqueTransaction::UniqueTransaction(std::shared_mutex& mutex, Wt::Dbo::Session& session)
-: _lock {mutex},
+UniqueTransaction::UniqueTransaction(ProfiledSharedMutex& mutex, const void* callSite, Wt::Dbo::Session& session, QueryStats* queryStats)
+: _lock {acquireLock<std::unique_lock<ProfiledSharedMutex>>(mutex, callSite, uniqueLockWait, queryStats, &QueryStats::addUniqueLockWait)},
  _transaction {session}
 {
 	assert(lockDebug[_lock.mutex()] == OwnedLock::None);
@@ -339,18 +563,29 @@ UniqueTransaction::~UniqueTransaction()
 	lockDebug[_lock.mutex()] = OwnedLock::None;
 }
 
-SharedTransaction::SharedTransaction(std::shared_mutex& mutex, Wt::Dbo::Session& session)
-: _lock {mutex},
+SharedTransaction::SharedTransaction(ProfiledSharedMutex& mutex, bool lock, const void* callSite, Wt::Dbo::Session& session, QueryStats* queryStats)
+: _mutex {mutex},
+ _lock {lock ? acquireLock<std::shared_lock<ProfiledSharedMutex>>(mutex, callSite, sharedLockWait, queryStats, &QueryStats::addSharedLockWait) : std::shared_lock {mutex, std::defer_lock}},
  _transaction {session}
 {
-	assert(lockDebug[_lock.mutex()] == OwnedLock::None);
-	lockDebug[_lock.mutex()] = OwnedLock::Shared;
+	assert(lockDebug[&_mutex] == OwnedLock::None);
+	lockDebug[&_mutex] = OwnedLock::Shared;
 }
 
 SharedTransaction::~SharedTransaction()
 {
-	assert(lockDebug[_lock.mutex()] == OwnedLock::Shared);
-	lockDebug[_lock.mutex()] = OwnedLock::None;
+	assert(lockDebug[&_mutex] == OwnedLock::Shared);
+	lockDebug[&_mutex] = OwnedLock::None;
+}
+
+SharedTransaction::ScopedReadOnlyAccess::ScopedReadOnlyAccess()
+: _previousReadOnly {ConnectionPool::setReadOnlyAccess(true)}
+{
+}
+
+SharedTransaction::ScopedReadOnlyAccess::~ScopedReadOnlyAccess()
+{
+	ConnectionPool::setReadOnlyAccess(_previousReadOnly);
 }
 
 void
@@ -365,51 +600,67 @@ Session::checkSharedLocked()
 	assert(lockDebug[&_db.getMutex()] != OwnedLock::None);
 }
 
+// Not inlined: the lock profiling call site is the caller
+__attribute__((noinline))
 UniqueTransaction
 Session::createUniqueTransaction()
 {
-	return UniqueTransaction {_db.getMutex(), _session};
+	return UniqueTransaction {_db.getMutex(), __builtin_return_address(0), _session, _db.getQueryStats()};
 }
 
+__attribute__((noinline))
 SharedTransaction
 Session::createSharedTransaction()
 {
-	return SharedTransaction {_db.getMutex(), _session};
+	return SharedTransaction {_db.getMutex(), _db.getConcurrencyMode() == Db::ConcurrencyMode::Exclusive, __builtin_return_address(0), _session, _db.getQueryStats()};
 }
 
 void
 Session::prepareTables()
 {
-	// Creation case
-	try {
-	        _session.createTables();
+	auto start {std::chrono::steady_clock::now()};
+	auto logStepDone {[&](const char* step)
+	{
+		const auto now {std::chrono::steady_clock::now()};
+		LMS_LOG(DB, INFO) << "Prepare tables: " << step << " done in " << std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() << " ms";
+		start = now;
+	}};
 
-		LMS_LOG(DB, INFO) << "Tables created";
-	}
-	catch (Wt::Dbo::Exception& e)
+	createTables();
+	logStepDone("tables and migration");
+	createIndexes();
+	logStepDone("indexes");
+
+	// Initial settings tables
 	{
-		LMS_LOG(DB, ERROR) << "Cannot create tables: " << e.what();
+		auto uniqueTransaction {createUniqueTransaction()};
+
+		ScanSettings::init(*this);
 	}
+	logStepDone("settings");
+}
 
-	doDatabaseMigrationIfNeeded();
+void
+Session::prepareTablesForBulkLoad()
+{
+	createTables();
+	createLookupIndexes();
+	createTrackTagCache();
+}
+
+void
+Session::createIndexes()
+{
+	createLookupIndexes();
 
-	// Indexes
 	{
 		auto uniqueTransaction {createUniqueTransaction()};
-		_session.execute("CREATE INDEX IF NOT EXISTS artist_name_idx ON artist(name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS artist_sort_name_nocase_idx ON artist(sort_name COLLATE NOCASE)");
-		_session.execute("CREATE INDEX IF NOT EXISTS artist_mbid_idx ON artist(mbid)");
 		_session.execute("CREATE INDEX IF NOT EXISTS auth_token_user_idx ON auth_token(user_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS auth_token_expiry_idx ON auth_token(expiry)");
 		_session.execute("CREATE INDEX IF NOT EXISTS auth_token_value_idx ON auth_token(value)");
-		_session.execute("CREATE INDEX IF NOT EXISTS cluster_name_idx ON cluster(name)");
-		_session.execute("CREATE INDEX IF NOT EXISTS cluster_cluster_type_idx ON cluster(cluster_type_id)");
-		_session.execute("CREATE INDEX IF NOT EXISTS cluster_type_name_idx ON cluster_type(name)");
-		_session.execute("CREATE INDEX IF NOT EXISTS release_name_idx ON release(name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS release_name_nocase_idx ON release(name COLLATE NOCASE)");
-		_session.execute("CREATE INDEX IF NOT EXISTS release_mbid_idx ON release(mbid)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_file_last_write_idx ON track(file_last_write)");
-		_session.execute("CREATE INDEX IF NOT EXISTS track_path_idx ON track(file_path)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_name_idx ON track(name)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_name_nocase_idx ON track(name COLLATE NOCASE)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_mbid_idx ON track(mbid)");
@@ -425,14 +676,241 @@ Session::prepareTables()
 		_session.execute("CREATE INDEX IF NOT EXISTS track_artist_link_type_idx ON track_artist_link(type)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_bookmark_user_idx ON track_bookmark(user_id)");
 		_session.execute("CREATE INDEX IF NOT EXISTS track_bookmark_user_track_idx ON track_bookmark(user_id,track_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_entry_tracklist_track_idx ON tracklist_entry(tracklist_id,track_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_entry_tracklist_idx ON tracklist_entry(tracklist_id,id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS tracklist_entry_track_idx ON tracklist_entry(track_id)");
+		// Join tables: composite indexes in both directions, so that lookups from either side are covered
+		_session.execute("CREATE INDEX IF NOT EXISTS track_cluster_track_cluster_idx ON track_cluster(track_id,cluster_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS track_cluster_cluster_track_idx ON track_cluster(cluster_id,track_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS user_artist_starred_user_artist_idx ON user_artist_starred(user_id,artist_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS user_artist_starred_artist_user_idx ON user_artist_starred(artist_id,user_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS user_release_starred_user_release_idx ON user_release_starred(user_id,release_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS user_release_starred_release_user_idx ON user_release_starred(release_id,user_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS user_track_starred_user_track_idx ON user_track_starred(user_id,track_id)");
+		_session.execute("CREATE INDEX IF NOT EXISTS user_track_starred_track_user_idx ON user_track_starred(track_id,user_id)");
 	}
 
-	// Initial settings tables
+	createTrackPlayStats();
+	createTracklistStats();
+	createSimilarityTables();
+	createTrackTagCache();
+	createSearchIndexes();
+
 	{
 		auto uniqueTransaction {createUniqueTransaction()};
+		ClusterTrackIndex::prepare(*this);
+		ScannerLease::prepare(*this);
+	}
+}
 
-		ScanSettings::init(*this);
+void
+Session::createTables()
+{
+	// Creation case
+	try {
+	        _session.createTables();
+
+		LMS_LOG(DB, INFO) << "Tables created";
+	}
+	catch (Wt::Dbo::Exception& e)
+	{
+		LMS_LOG(DB, ERROR) << "Cannot create tables: " << e.what();
 	}
+
+	doDatabaseMigrationIfNeeded();
+}
+
+void
+Session::createLookupIndexes()
+{
+	auto uniqueTransaction {createUniqueTransaction()};
+
+	_session.execute("CREATE INDEX IF NOT EXISTS artist_name_idx ON artist(name)");
+	_session.execute("CREATE INDEX IF NOT EXISTS artist_mbid_idx ON artist(mbid)");
+	_session.execute("CREATE INDEX IF NOT EXISTS cluster_name_idx ON cluster(name)");
+	_session.execute("CREATE INDEX IF NOT EXISTS cluster_cluster_type_idx ON cluster(cluster_type_id)");
+	_session.execute("CREATE INDEX IF NOT EXISTS cluster_type_name_idx ON cluster_type(name)");
+	_session.execute("CREATE INDEX IF NOT EXISTS release_name_idx ON release(name)");
+	_session.execute("CREATE INDEX IF NOT EXISTS release_mbid_idx ON release(mbid)");
+	_session.execute("CREATE INDEX IF NOT EXISTS track_path_idx ON track(file_path)");
+}
+
+void
+Session::createTrackPlayStats()
+{
+	// If only compacted entries remain, keep the removed entry as the last one
+	static const std::string removeOldEntry {
+		"UPDATE track_play_stats SET play_count = play_count - 1,"
+			" last_entry_id = COALESCE((SELECT MAX(id) FROM tracklist_entry WHERE tracklist_id = old.tracklist_id AND track_id = old.track_id), last_entry_id)"
+			" WHERE tracklist_id = old.tracklist_id AND track_id = old.track_id;"
+		" DELETE FROM track_play_stats WHERE tracklist_id = old.tracklist_id AND track_id = old.track_id AND play_count <= 0;"};
+	static const std::string addNewEntry {
+		"INSERT OR IGNORE INTO track_play_stats (tracklist_id, track_id, play_count, last_entry_id)"
+			" SELECT new.tracklist_id, new.track_id, 0, new.id WHERE new.tracklist_id IS NOT NULL AND new.track_id IS NOT NULL;"
+		" UPDATE track_play_stats SET play_count = play_count + 1, last_entry_id = MAX(last_entry_id, new.id)"
+			" WHERE tracklist_id = new.tracklist_id AND track_id = new.track_id;"};
+
+	auto uniqueTransaction {createUniqueTransaction()};
+
+	_session.execute(trackPlayStatsTable);
+	_session.execute(tracklistCompactionTable);
+	_session.execute("CREATE INDEX IF NOT EXISTS track_play_stats_tracklist_play_count_idx ON track_play_stats(tracklist_id,play_count)");
+	_session.execute("CREATE INDEX IF NOT EXISTS track_play_stats_tracklist_last_entry_idx ON track_play_stats(tracklist_id,last_entry_id)");
+	_session.execute("CREATE INDEX IF NOT EXISTS track_play_stats_track_idx ON track_play_stats(track_id)");
+
+	_session.execute("CREATE TRIGGER IF NOT EXISTS track_play_stats_insert AFTER INSERT ON tracklist_entry BEGIN " + addNewEntry + " END");
+	// Compacted entries are removed from the tracklist, but are still counted
+	_session.execute("CREATE TRIGGER IF NOT EXISTS track_play_stats_delete AFTER DELETE ON tracklist_entry"
+			" WHEN old.id > COALESCE((SELECT compacted_entry_id FROM tracklist_compaction WHERE tracklist_id = old.tracklist_id), 0)"
+			" BEGIN " + removeOldEntry + " END");
+	_session.execute("CREATE TRIGGER IF NOT EXISTS track_play_stats_update AFTER UPDATE OF track_id, tracklist_id ON tracklist_entry"
+			" WHEN old.tracklist_id IS NOT new.tracklist_id OR old.track_id IS NOT new.track_id"
+			" BEGIN " + removeOldEntry + " " + addNewEntry + " END");
+}
+
+void
+Session::createTracklistStats()
+{
+	static const std::string removeOldEntry {
+		"UPDATE tracklist_stats SET entry_count = entry_count - 1,"
+			" duration = duration - COALESCE((SELECT duration FROM track WHERE id = old.track_id), 0)"
+			" WHERE tracklist_id = old.tracklist_id;"};
+	static const std::string addNewEntry {
+		"INSERT OR IGNORE INTO tracklist_stats (tracklist_id, entry_count, duration)"
+			" SELECT new.tracklist_id, 0, 0 WHERE new.tracklist_id IS NOT NULL;"
+		" UPDATE tracklist_stats SET entry_count = entry_count + 1,"
+			" duration = duration + COALESCE((SELECT duration FROM track WHERE id = new.track_id), 0)"
+			" WHERE tracklist_id = new.tracklist_id;"};
+	// Weighted by the number of entries of the track in each tracklist
+	static const std::string addTrackDurationDelta {
+		"UPDATE tracklist_stats SET duration = duration + (COALESCE(new.duration, 0) - COALESCE(old.duration, 0))"
+			" * (SELECT COUNT(*) FROM tracklist_entry p_e WHERE p_e.tracklist_id = tracklist_stats.tracklist_id AND p_e.track_id = old.id)"
+			" WHERE tracklist_id IN (SELECT tracklist_id FROM tracklist_entry WHERE track_id = old.id);"};
+	static const std::string removeTrackDuration {
+		"UPDATE tracklist_stats SET duration = duration - COALESCE(old.duration, 0)"
+			" * (SELECT COUNT(*) FROM tracklist_entry p_e WHERE p_e.tracklist_id = tracklist_stats.tracklist_id AND p_e.track_id = old.id)"
+			" WHERE tracklist_id IN (SELECT tracklist_id FROM tracklist_entry WHERE track_id = old.id);"};
+
+	auto uniqueTransaction {createUniqueTransaction()};
+
+	_session.execute(tracklistStatsTable);
+
+	_session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_stats_insert AFTER INSERT ON tracklist_entry BEGIN " + addNewEntry + " END");
+	_session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_stats_delete AFTER DELETE ON tracklist_entry BEGIN " + removeOldEntry + " END");
+	_session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_stats_update AFTER UPDATE OF track_id, tracklist_id ON tracklist_entry"
+			" WHEN old.tracklist_id IS NOT new.tracklist_id OR old.track_id IS NOT new.track_id"
+			" BEGIN " + removeOldEntry + " " + addNewEntry + " END");
+	// Dbo updates all the columns on save: only react to actual changes
+	_session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_stats_track_duration AFTER UPDATE OF duration ON track"
+			" WHEN old.duration IS NOT new.duration"
+			" BEGIN " + addTrackDurationDelta + " END");
+	// The entries of a removed track are deleted afterwards (cascade), once the track can no longer be found: its duration is removed first
+	_session.execute("CREATE TRIGGER IF NOT EXISTS tracklist_stats_track_delete BEFORE DELETE ON track BEGIN " + removeTrackDuration + " END");
+}
+
+void
+Session::createSimilarityTables()
+{
+	auto uniqueTransaction {createUniqueTransaction()};
+
+	_session.execute(releaseSimilarityTable);
+	_session.execute("CREATE INDEX IF NOT EXISTS release_similarity_similar_release_idx ON release_similarity(similar_release_id)");
+	_session.execute(artistSimilarityTable);
+	_session.execute("CREATE INDEX IF NOT EXISTS artist_similarity_similar_artist_idx ON artist_similarity(similar_artist_id)");
+}
+
+void
+Session::createTrackTagCache()
+{
+	auto uniqueTransaction {createUniqueTransaction()};
+
+	_session.execute(trackTagsTable);
+}
+
+void
+Session::createSearchIndexes()
+{
+	struct SearchIndex
+	{
+		std::string table;
+		std::vector<std::string> columns;
+	};
+
+	static const std::vector<SearchIndex> searchIndexes
+	{
+		{"artist", {"name", "sort_name"}},
+		{"release", {"name"}},
+		{"track", {"name"}},
+	};
+
+	// Full text search indexes, kept up to date using triggers
+	// Requires the FTS5 extension: if not available, searches are done using 'LIKE' clauses
+	try
+	{
+		auto uniqueTransaction {createUniqueTransaction()};
+
+		for (const SearchIndex& searchIndex : searchIndexes)
+		{
+			const std::string ftsTable {searchIndex.table + "_fts"};
+			const std::string columns {StringUtils::joinStrings(searchIndex.columns, ", ")};
+			const std::string newColumns {"new." + StringUtils::joinStrings(searchIndex.columns, ", new.")};
+			const std::string oldColumns {"old." + StringUtils::joinStrings(searchIndex.columns, ", old.")};
+			std::vector<std::string> changedConditions;
+			for (const std::string& column : searchIndex.columns)
+				changedConditions.push_back("old." + column + " IS NOT new." + column);
+			const std::string changedCondition {StringUtils::joinStrings(changedConditions, " OR ")};
+
+			const int count {_session.query<int>("SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = ?").bind(ftsTable)};
+			if (count > 0)
+				continue;
+
+			LMS_LOG(DB, INFO) << "Creating search index '" << ftsTable << "'...";
+
+			_session.execute("CREATE VIRTUAL TABLE " + ftsTable + " USING fts5(" + columns + ", content='" + searchIndex.table + "', content_rowid='id')");
+			_session.execute("CREATE TRIGGER IF NOT EXISTS " + ftsTable + "_insert AFTER INSERT ON " + searchIndex.table + " BEGIN"
+					" INSERT INTO " + ftsTable + "(rowid, " + columns + ") VALUES (new.id, " + newColumns + ");"
+					" END");
+			_session.execute("CREATE TRIGGER IF NOT EXISTS " + ftsTable + "_delete AFTER DELETE ON " + searchIndex.table + " BEGIN"
+					" INSERT INTO " + ftsTable + "(" + ftsTable + ", rowid, " + columns + ") VALUES ('delete', old.id, " + oldColumns + ");"
+					" END");
+			_session.execute("CREATE TRIGGER IF NOT EXISTS " + ftsTable + "_update AFTER UPDATE OF " + columns + " ON " + searchIndex.table + " WHEN " + changedCondition + " BEGIN"
+					" INSERT INTO " + ftsTable + "(" + ftsTable + ", rowid, " + columns + ") VALUES ('delete', old.id, " + oldColumns + ");"
+					" INSERT INTO " + ftsTable + "(rowid, " + columns + ") VALUES (new.id, " + newColumns + ");"
+					" END");
+			_session.execute("INSERT INTO " + ftsTable + "(" + ftsTable + ") VALUES ('rebuild')");
+		}
+
+		_db.setSearchIndexEnabled(true);
+	}
+	catch (Wt::Dbo::Exception& e)
+	{
+		LMS_LOG(DB, ERROR) << "Cannot create search indexes, searches will be slower: " << e.what();
+	}
+}
+
+bool
+Session::isSearchIndexEnabled() const
+{
+	return _db.isSearchIndexEnabled();
+}
+
+bool
+Session::canUseSearchIndex(const std::vector<std::string>& keywords) const
+{
+	if (!isSearchIndexEnabled())
+		return false;
+
+	// The full text search indexes only index words made of alphanumeric characters
+	return std::all_of(std::cbegin(keywords), std::cend(keywords), [](const std::string& keyword)
+	{
+		return std::any_of(std::cbegin(keyword), std::cend(keyword), [](unsigned char c) { return std::isalnum(c) || c >= 0x80; });
+	});
+}
+
+std::optional<std::vector<IdType>>
+Session::getTrackIdsInClusters(const std::set<IdType>& clusterIds, std::size_t maxCount)
+{
+	return _db.getClusterTrackIndex().getTrackIds(*this, clusterIds, maxCount);
 }
 
 void
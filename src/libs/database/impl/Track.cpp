@@ -30,6 +30,7 @@
 #include "utils/Logger.hpp"
 
 #include "SqlQuery.hpp"
+#include "Utils.hpp"
 
 namespace Database {
 
@@ -45,10 +46,20 @@ createQuery(Session& session,
 
 	auto query {session.getDboSession().query<T>(queryStr)};
 
-	for (const std::string& keyword : keywords)
-		query.where("t.name LIKE ?").bind("%%" + keyword + "%%");
+	if (!keywords.empty() && Utils::canUseSearchIndex(session, keywords))
+	{
+		query.join("track_fts ON track_fts.rowid = t.id");
+		query.where("track_fts MATCH ?").bind(Utils::getSearchIndexMatchQuery(keywords));
+	}
+	else
+	{
+		for (const std::string& keyword : keywords)
+			query.where("t.name LIKE ?").bind("%%" + keyword + "%%");
+	}
 
-	if (!clusterIds.empty())
+	// Multiple clusters: intersect them using the in memory index if the result is small enough
+	const bool filteredOnClusters {clusterIds.size() > 1 && Utils::filterOnClustersUsingIndex(session, query, clusterIds, "t.id IN (", ")")};
+	if (!clusterIds.empty() && !filteredOnClusters)
 	{
 		std::ostringstream oss;
 		oss << "t.id IN (SELECT DISTINCT t.id FROM track t"
@@ -100,13 +111,9 @@ Track::getAllRandom(Session& session, const std::set<IdType>& clusterIds, std::o
 {
 	session.checkSharedLocked();
 
-	auto query {createQuery<Track::pointer>(session, "SELECT t from track t", clusterIds, {})};
-
-	Wt::Dbo::collection<Track::pointer> collection = query
-		.orderBy("RANDOM()")
-		.limit(limit ? static_cast<int>(*limit) + 1: -1);
+	auto query {createQuery<IdType>(session, "SELECT t.id from track t", clusterIds, {})};
 
-	return std::vector<pointer>(collection.begin(), collection.end());
+	return Utils::getByIdsInOrder<Track>(session.getDboSession(), "track", Utils::fetchRandomIds(query, limit));
 }
 
 std::vector<Database::IdType>
@@ -116,11 +123,7 @@ Track::getAllIdsRandom(Session& session, const std::set<IdType>& clusterIds, std
 
 	auto query {createQuery<IdType>(session, "SELECT t.id from track t", clusterIds, {})};
 
-	Wt::Dbo::collection<IdType> collection = query
-		.orderBy("RANDOM()")
-		.limit(limit ? static_cast<int>(*limit) + 1: -1);
-
-	return std::vector<IdType>(collection.begin(), collection.end());
+	return Utils::fetchRandomIds(query, limit);
 }
 
 
@@ -146,8 +149,15 @@ Track::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<Track>()
-		.where("id = ?").bind(id);
+	return Utils::getById<Track>(session.getDboSession(), id);
+}
+
+std::vector<Track::pointer>
+Track::getByIds(Session& session, const std::vector<IdType>& ids)
+{
+	session.checkSharedLocked();
+
+	return Utils::getByIdsInOrder<Track>(session.getDboSession(), "track", ids);
 }
 
 Track::pointer
@@ -156,7 +166,7 @@ Track::getByMBID(Session& session, const UUID& mbid)
 	session.checkSharedLocked();
 
 	return session.getDboSession().find<Track>()
-		.where("mbid = ?").bind(std::string {mbid.getAsString()});
+		.where("mbid = ?").bind(mbid.getAsBytes());
 }
 
 Track::pointer
@@ -192,12 +202,88 @@ Track::getAllPaths(Session& session, std::optional<std::size_t> offset, std::opt
 	return result;
 }
 
+std::vector<std::pair<IdType, std::filesystem::path>>
+Track::getAllPathsUnder(Session& session, const std::filesystem::path& path)
+{
+	using QueryResultType = std::tuple<IdType, std::string>;
+	session.checkSharedLocked();
+
+	// Range on the path to make use of the index: all paths starting with "dir/" are in ["dir/", "dir0")
+	std::string directoryBegin {(path / "").string()};
+	std::string directoryEnd {directoryBegin};
+	directoryEnd.back() = static_cast<char>(directoryEnd.back() + 1);
+
+	Wt::Dbo::collection<QueryResultType> queryRes = session.getDboSession().query<QueryResultType>("SELECT id,file_path FROM track")
+		.where("file_path = ? OR (file_path >= ? AND file_path < ?)")
+		.bind(path.string())
+		.bind(directoryBegin)
+		.bind(directoryEnd);
+
+	std::vector<std::pair<IdType, std::filesystem::path>> result;
+	std::transform(std::begin(queryRes), std::end(queryRes), std::back_inserter(result),
+			[](const QueryResultType& queryResult)
+			{
+				return std::make_pair(std::get<0>(queryResult), std::get<1>(queryResult));
+			});
+
+	return result;
+}
+
+std::vector<Track::FileInfo>
+Track::getAllFileInfos(Session& session)
+{
+	using QueryResultType = std::tuple<IdType, std::string, Wt::WDateTime, int, long long>;
+	session.checkSharedLocked();
+
+	Wt::Dbo::collection<QueryResultType> queryRes = session.getDboSession().query<QueryResultType>("SELECT id,file_path,file_last_write,scan_version,file_size FROM track");
+
+	std::vector<FileInfo> result;
+	result.reserve(queryRes.size());
+
+	std::transform(std::begin(queryRes), std::end(queryRes), std::back_inserter(result),
+			[](const QueryResultType& queryResult)
+			{
+				return FileInfo {std::get<0>(queryResult), std::get<1>(queryResult), std::get<2>(queryResult), static_cast<std::size_t>(std::get<3>(queryResult)), static_cast<std::uintmax_t>(std::get<4>(queryResult))};
+			});
+
+	return result;
+}
+
+std::optional<std::vector<unsigned char>>
+Track::getCachedTags(Session& session, IdType trackId, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize)
+{
+	session.checkSharedLocked();
+
+	Wt::Dbo::collection<std::vector<unsigned char>> res = session.getDboSession().query<std::vector<unsigned char>>("SELECT data FROM track_tags")
+		.where("track_id = ?").bind(trackId)
+		.where("file_last_write = ?").bind(static_cast<long long>(lastWriteTime.toTime_t()))
+		.where("file_size = ?").bind(static_cast<long long>(fileSize));
+
+	auto it {res.begin()};
+	if (it == res.end())
+		return std::nullopt;
+
+	return *it;
+}
+
+void
+Track::setCachedTags(Session& session, IdType trackId, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize, const std::vector<unsigned char>& tags)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().execute("INSERT OR REPLACE INTO track_tags (track_id, file_last_write, file_size, data) VALUES (?, ?, ?, ?)")
+		.bind(trackId)
+		.bind(static_cast<long long>(lastWriteTime.toTime_t()))
+		.bind(static_cast<long long>(fileSize))
+		.bind(tags);
+}
+
 std::vector<Track::pointer>
 Track::getMBIDDuplicates(Session& session)
 {
 	session.checkSharedLocked();
 
-	Wt::Dbo::collection<pointer> res = session.getDboSession().query<pointer>( "SELECT track FROM track WHERE mbid in (SELECT mbid FROM track WHERE mbid <> '' GROUP BY mbid HAVING COUNT (*) > 1)").orderBy("track.release_id,track.disc_number,track.track_number,track.mbid");
+	Wt::Dbo::collection<pointer> res = session.getDboSession().query<pointer>( "SELECT track FROM track WHERE mbid in (SELECT mbid FROM track WHERE LENGTH(mbid) > 0 GROUP BY mbid HAVING COUNT (*) > 1)").orderBy("track.release_id,track.disc_number,track.track_number,track.mbid");
 	return std::vector<pointer>(res.begin(), res.end());
 }
 
@@ -266,6 +352,85 @@ Track::getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit)
 	return std::vector<IdType>(res.begin(), res.end());
 }
 
+std::vector<std::pair<IdType, IdType>>
+Track::getAllClusterLinks(Session& session)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, IdType>;
+
+	Wt::Dbo::collection<QueryResultType> queryRes = session.getDboSession().query<QueryResultType>("SELECT track_id, cluster_id FROM track_cluster");
+
+	std::vector<std::pair<IdType, IdType>> res;
+	for (const auto& [trackId, clusterId] : queryRes)
+		res.emplace_back(trackId, clusterId);
+
+	return res;
+}
+
+std::vector<std::pair<IdType, IdType>>
+Track::getAllReleaseLinks(Session& session)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, IdType>;
+
+	Wt::Dbo::collection<QueryResultType> queryRes = session.getDboSession().query<QueryResultType>("SELECT id, release_id FROM track WHERE release_id IS NOT NULL");
+
+	std::vector<std::pair<IdType, IdType>> res;
+	for (const auto& [trackId, releaseId] : queryRes)
+		res.emplace_back(trackId, releaseId);
+
+	return res;
+}
+
+std::vector<std::pair<IdType, IdType>>
+Track::getAllArtistLinks(Session& session, EnumSet<TrackArtistLinkType> linkTypes)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, IdType>;
+
+	auto query {session.getDboSession().query<QueryResultType>("SELECT track_id, artist_id FROM track_artist_link")};
+	if (!linkTypes.empty())
+	{
+		std::size_t linkTypeCount {};
+		for (TrackArtistLinkType type : linkTypes)
+		{
+			(void) type;
+			linkTypeCount++;
+		}
+
+		query.where("type IN (" + Utils::getPlaceholders(linkTypeCount) + ")");
+		for (TrackArtistLinkType type : linkTypes)
+			query.bind(type);
+	}
+
+	Wt::Dbo::collection<QueryResultType> queryRes = query;
+
+	std::vector<std::pair<IdType, IdType>> res;
+	for (const auto& [trackId, artistId] : queryRes)
+		res.emplace_back(trackId, artistId);
+
+	return res;
+}
+
+std::vector<std::tuple<IdType, IdType, TrackArtistLinkType>>
+Track::getAllArtistLinksWithType(Session& session)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, IdType, TrackArtistLinkType>;
+
+	Wt::Dbo::collection<QueryResultType> queryRes = session.getDboSession().query<QueryResultType>("SELECT track_id, artist_id, type FROM track_artist_link");
+
+	std::vector<QueryResultType> res;
+	for (const QueryResultType& link : queryRes)
+		res.push_back(link);
+
+	return res;
+}
+
 std::vector<Track::pointer>
 Track::getStarred(Session& session,
 		Wt::Dbo::ptr<User> user,
@@ -338,7 +503,11 @@ Track::getByFilter(Session& session,
 {
 	session.checkSharedLocked();
 
-	Wt::Dbo::collection<pointer> collection = createQuery<Track::pointer>(session, "SELECT t from track t", clusterIds, keywords)
+	auto query {createQuery<Track::pointer>(session, "SELECT t from track t", clusterIds, keywords)};
+	if (!keywords.empty() && Utils::canUseSearchIndex(session, keywords))
+		query.orderBy("track_fts.rank");
+
+	Wt::Dbo::collection<pointer> collection = query
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
 
@@ -354,6 +523,22 @@ Track::getByFilter(Session& session,
 	return res;
 }
 
+std::vector<Track::pointer>
+Track::getByFilter(Session& session,
+		const std::set<IdType>& clusterIds,
+		const std::vector<std::string>& keywords,
+		const std::optional<Cursor>& after,
+		std::size_t limit,
+		bool& moreResults)
+{
+	session.checkSharedLocked();
+
+	auto query {createQuery<Track::pointer>(session, "SELECT t from track t", clusterIds, keywords)};
+	Utils::applyCursor(query, "", "t.id", after, limit);
+
+	return Utils::fetchCursorResults(query, limit, moreResults);
+}
+
 std::vector<Track::pointer>
 Track::getSimilarTracks(Session& session,
 				const std::unordered_set<IdType>& tracks,
@@ -363,29 +548,24 @@ Track::getSimilarTracks(Session& session,
 	assert(!tracks.empty());
 	session.checkSharedLocked();
 
-	std::ostringstream oss;
-	for (std::size_t i {}; i < tracks.size(); ++i)
-	{
-		if (!oss.str().empty())
-			oss << ", ";
-		oss << "?";
-	}
+	const std::vector<IdType> trackIds {Utils::getBucketedIds(tracks)};
+	const std::string placeholders {Utils::getPlaceholders(trackIds.size())};
 
 	Wt::Dbo::Query<pointer> query {session.getDboSession().query<pointer>(
 			"SELECT t FROM track t"
 			" INNER JOIN track_cluster t_c ON t_c.track_id = t.id"
-					" AND t_c.cluster_id IN (SELECT c.id FROM cluster c INNER JOIN track_cluster t_c ON t_c.cluster_id = c.id WHERE t_c.track_id IN (" + oss.str() + "))"
-					" AND t.id NOT IN (" + oss.str() + ")")
+					" AND t_c.cluster_id IN (SELECT c.id FROM cluster c INNER JOIN track_cluster t_c ON t_c.cluster_id = c.id WHERE t_c.track_id IN (" + placeholders + "))"
+					" AND t.id NOT IN (" + placeholders + ")")
 		.groupBy("t.id")
 		.orderBy("COUNT(*) DESC, RANDOM()")
 		.limit(size ? static_cast<int>(*size) : -1)
 		.offset(offset ? static_cast<int>(*offset) : -1)};
 
-	for (IdType trackId : tracks)
-		query.bind(trackId );
+	for (IdType trackId : trackIds)
+		query.bind(trackId);
 
-	for (IdType trackId : tracks)
-		query.bind(trackId );
+	for (IdType trackId : trackIds)
+		query.bind(trackId);
 
 	Wt::Dbo::collection<pointer> res = query;
 	return std::vector<pointer>(res.begin(), res.end());
@@ -456,6 +636,15 @@ Track::getTotalDisc() const
 	return (_totalDisc > 0) ? std::make_optional<std::size_t>(_totalDisc) : std::nullopt;
 }
 
+std::optional<std::uint32_t>
+Track::getCrc32() const
+{
+	if (_crc32 < 0 || _crc32FileLastWrite != _fileLastWrite)
+		return std::nullopt;
+
+	return static_cast<std::uint32_t>(_crc32);
+}
+
 std::optional<int>
 Track::getYear() const
 {
@@ -559,6 +748,138 @@ Track::getArtistIds(EnumSet<TrackArtistLinkType> linkTypes) const
 	return std::vector<IdType>(std::begin(res), std::end(res));
 }
 
+std::unordered_map<IdType, std::vector<Artist::pointer>>
+Track::getArtistsByTrack(Session& session, const std::vector<IdType>& trackIds, EnumSet<TrackArtistLinkType> linkTypes)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, Artist::pointer>;
+
+	std::unordered_map<IdType, std::vector<Artist::pointer>> res;
+
+	Utils::forEachIdChunk(trackIds, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.getDboSession().query<QueryResultType>(
+				"SELECT t_a_l.track_id, a FROM artist a"
+				" INNER JOIN track_artist_link t_a_l ON a.id = t_a_l.artist_id")};
+
+		query.where("t_a_l.track_id IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType trackId : chunkIds)
+			query.bind(trackId);
+
+		if (!linkTypes.empty())
+		{
+			std::size_t linkTypeCount {};
+			for (TrackArtistLinkType type : linkTypes)
+			{
+				(void) type;
+				linkTypeCount++;
+			}
+
+			query.where("t_a_l.type IN (" + Utils::getPlaceholders(linkTypeCount) + ")");
+			for (TrackArtistLinkType type : linkTypes)
+				query.bind(type);
+		}
+
+		query.orderBy("t_a_l.id");
+
+		Wt::Dbo::collection<QueryResultType> collection = query;
+		for (const auto& [trackId, artist] : collection)
+			res[trackId].push_back(artist);
+	});
+
+	return res;
+}
+
+std::vector<Track::ListEntry>
+Track::getListEntries(Session& session, const std::vector<IdType>& trackIds)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, std::string, std::chrono::duration<int, std::milli>, IdType, std::string, IdType, std::string>;
+
+	std::unordered_map<IdType, ListEntry> entries;
+
+	Utils::forEachIdChunk(trackIds, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.getDboSession().query<QueryResultType>(
+				"SELECT t.id, t.name, t.duration, COALESCE(r.id, -1), COALESCE(r.name, ''), COALESCE(a.id, -1), COALESCE(a.name, '') FROM track t"
+				" LEFT OUTER JOIN release r ON r.id = t.release_id"
+				" LEFT OUTER JOIN track_artist_link t_a_l ON t_a_l.track_id = t.id AND t_a_l.type = " + std::to_string(static_cast<int>(TrackArtistLinkType::Artist)) +
+				" LEFT OUTER JOIN artist a ON a.id = t_a_l.artist_id")};
+
+		query.where("t.id IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType trackId : chunkIds)
+			query.bind(trackId);
+
+		query.orderBy("t.id, t_a_l.id");
+
+		// ids may be split across chunks if they are repeated
+		std::unordered_map<IdType, ListEntry> chunkEntries;
+
+		Wt::Dbo::collection<QueryResultType> collection = query;
+		for (const auto& [trackId, trackName, duration, releaseId, releaseName, artistId, artistName] : collection)
+		{
+			auto [it, inserted] {chunkEntries.try_emplace(trackId)};
+			ListEntry& entry {it->second};
+			if (inserted)
+			{
+				entry.id = trackId;
+				entry.name = trackName;
+				entry.duration = duration;
+				if (IdIsValid(releaseId))
+					entry.release = ObjectRef {releaseId, releaseName};
+			}
+
+			if (IdIsValid(artistId))
+				entry.artists.push_back(ObjectRef {artistId, artistName});
+		}
+
+		for (auto& [trackId, entry] : chunkEntries)
+			entries.try_emplace(trackId, std::move(entry));
+	});
+
+	std::vector<ListEntry> res;
+	res.reserve(trackIds.size());
+	for (const IdType trackId : trackIds)
+	{
+		if (auto it {entries.find(trackId)}; it != std::cend(entries))
+			res.push_back(it->second);
+	}
+
+	return res;
+}
+
+std::unordered_map<IdType, Cluster::pointer>
+Track::getFirstClusterByTrack(Session& session, const std::vector<IdType>& trackIds, IdType clusterTypeId)
+{
+	session.checkSharedLocked();
+
+	using QueryResultType = std::tuple<IdType, Cluster::pointer>;
+
+	std::unordered_map<IdType, Cluster::pointer> res;
+
+	Utils::forEachIdChunk(trackIds, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.getDboSession().query<QueryResultType>(
+				"SELECT t_c.track_id, c FROM cluster c"
+				" INNER JOIN track_cluster t_c ON c.id = t_c.cluster_id")};
+
+		query.where("c.cluster_type_id = ?").bind(clusterTypeId);
+		query.where("t_c.track_id IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType trackId : chunkIds)
+			query.bind(trackId);
+
+		query.orderBy("c.id");
+
+		Wt::Dbo::collection<QueryResultType> collection = query;
+		for (const auto& [trackId, cluster] : collection)
+			res.try_emplace(trackId, cluster);
+	});
+
+	return res;
+}
+
 std::vector<Wt::Dbo::ptr<TrackArtistLink>>
 Track::getArtistLinks() const
 {
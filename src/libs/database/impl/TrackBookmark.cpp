@@ -22,6 +22,7 @@
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/User.hpp"
+#include "Utils.hpp"
 
 namespace Database {
 
@@ -82,8 +83,7 @@ TrackBookmark::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<TrackBookmark>()
-		.where("id = ?").bind(id);
+	return Utils::getById<TrackBookmark>(session.getDboSession(), id);
 }
 
 
@@ -19,26 +19,176 @@
 
 #include "database/TrackFeatures.hpp"
 
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <tuple>
+
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "utils/Logger.hpp"
+#include "Utils.hpp"
 
 namespace Database {
 
-TrackFeatures::TrackFeatures(Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures)
+// Binary layout, for each feature (native endianness):
+//  - name length (uint16)
+//  - name
+//  - value count (uint16)
+//  - values (double)
+using EncodedSize = std::uint16_t;
+
+template <typename T>
+static
+void
+appendRaw(std::vector<unsigned char>& buffer, const T& value)
+{
+	const std::size_t offset {buffer.size()};
+	buffer.resize(offset + sizeof(T));
+	std::memcpy(buffer.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static
+bool
+readRaw(const std::vector<unsigned char>& buffer, std::size_t& offset, T& value)
+{
+	if (buffer.size() - offset < sizeof(T))
+		return false;
+
+	std::memcpy(&value, buffer.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+static
+std::vector<unsigned char>
+encodeFeatureValuesMap(const FeatureValuesMap& featureValuesMap)
+{
+	std::vector<unsigned char> res;
+
+	for (const auto& [featureName, featureValues] : featureValuesMap)
+	{
+		appendRaw(res, static_cast<EncodedSize>(featureName.size()));
+		res.insert(std::end(res), std::cbegin(featureName), std::cend(featureName));
+		appendRaw(res, static_cast<EncodedSize>(featureValues.size()));
+		for (double value : featureValues)
+			appendRaw(res, value);
+	}
+
+	return res;
+}
+
+static
+std::optional<FeatureValuesMap>
+decodeFeatureValuesMap(const std::vector<unsigned char>& buffer, const std::unordered_set<FeatureName>& featureNames)
+{
+	FeatureValuesMap res;
+
+	std::size_t offset {};
+	while (offset < buffer.size())
+	{
+		EncodedSize nameSize;
+		if (!readRaw(buffer, offset, nameSize) || buffer.size() - offset < nameSize)
+			return std::nullopt;
+
+		FeatureName featureName {reinterpret_cast<const char*>(buffer.data() + offset), nameSize};
+		offset += nameSize;
+
+		EncodedSize valueCount;
+		if (!readRaw(buffer, offset, valueCount) || (buffer.size() - offset) / sizeof(double) < valueCount)
+			return std::nullopt;
+
+		if (featureNames.find(featureName) == std::cend(featureNames))
+		{
+			offset += valueCount * sizeof(double);
+			continue;
+		}
+
+		FeatureValues& featureValues {res[featureName]};
+		featureValues.resize(valueCount);
+		std::memcpy(featureValues.data(), buffer.data() + offset, valueCount * sizeof(double));
+		offset += valueCount * sizeof(double);
+	}
+
+	if (res.size() != featureNames.size())
+		return std::nullopt;
+
+	return res;
+}
+
+TrackFeatures::TrackFeatures(Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures, const std::unordered_set<FeatureName>& storedFeatureNames)
 : _data(jsonEncodedFeatures),
 _track(track)
 {
+	storeFeatureValues(storedFeatureNames);
 }
 
 TrackFeatures::pointer
-TrackFeatures::create(Session& session, Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures)
+TrackFeatures::create(Session& session, Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures, const std::unordered_set<FeatureName>& storedFeatureNames)
 {
 	session.checkUniqueLocked();
-	return session.getDboSession().add(std::make_unique<TrackFeatures>(track, jsonEncodedFeatures));
+	return session.getDboSession().add(std::make_unique<TrackFeatures>(track, jsonEncodedFeatures, storedFeatureNames));
+}
+
+std::vector<IdType>
+TrackFeatures::getIdsWithoutStoredFeatureValues(Session& session)
+{
+	session.checkSharedLocked();
+
+	Wt::Dbo::collection<IdType> res = session.getDboSession().query<IdType>("SELECT id FROM track_features WHERE LENGTH(feature_values) = 0");
+	return std::vector<IdType>(res.begin(), res.end());
+}
+
+TrackFeatures::pointer
+TrackFeatures::getById(Session& session, IdType id)
+{
+	session.checkSharedLocked();
+
+	return Utils::getById<TrackFeatures>(session.getDboSession(), id);
+}
+
+FeatureValuesMap
+TrackFeatures::getFeatureValuesMapByTrack(Session& session, IdType trackId, const std::unordered_set<FeatureName>& featureNames)
+{
+	session.checkSharedLocked();
+
+	// Only fetch the compact column, the json data may be large
+	const std::vector<unsigned char> featureValues {session.getDboSession().query<std::vector<unsigned char>>("SELECT feature_values FROM track_features WHERE track_id = ?").bind(trackId).resultValue()};
+	if (std::optional<FeatureValuesMap> featureValuesMap {decodeFeatureValuesMap(featureValues, featureNames)})
+		return std::move(*featureValuesMap);
+
+	const pointer trackFeatures {session.getDboSession().find<TrackFeatures>().where("track_id = ?").bind(trackId)};
+	if (!trackFeatures)
+		return {};
+
+	return trackFeatures->getFeatureValuesMap(featureNames);
+}
+
+std::vector<TrackFeatures::EncodedFeatureValues>
+TrackFeatures::getEncodedFeatureValues(Session& session, IdType afterTrackId, std::size_t count)
+{
+	using QueryResultType = std::tuple<IdType, std::vector<unsigned char>>;
+	session.checkSharedLocked();
+
+	Wt::Dbo::collection<QueryResultType> queryRes = session.getDboSession().query<QueryResultType>("SELECT track_id, feature_values FROM track_features WHERE track_id > ? ORDER BY track_id")
+		.bind(afterTrackId)
+		.limit(static_cast<int>(count));
+
+	std::vector<EncodedFeatureValues> res;
+	for (auto& [trackId, data] : queryRes)
+		res.push_back(EncodedFeatureValues {trackId, std::move(data)});
+
+	return res;
+}
+
+std::optional<FeatureValuesMap>
+TrackFeatures::decodeFeatureValues(const std::vector<unsigned char>& encodedFeatureValues, const std::unordered_set<FeatureName>& featureNames)
+{
+	return decodeFeatureValuesMap(encodedFeatureValues, featureNames);
 }
 
 FeatureValues
@@ -51,6 +201,9 @@ TrackFeatures::getFeatureValues(const FeatureName& featureNode) const
 FeatureValuesMap
 TrackFeatures::getFeatureValuesMap(const std::unordered_set<FeatureName>& featureNames) const
 {
+	if (std::optional<FeatureValuesMap> featureValuesMap {decodeFeatureValuesMap(_featureValues, featureNames)})
+		return std::move(*featureValuesMap);
+
 	try
 	{
 		std::istringstream iss {_data};
@@ -85,4 +238,13 @@ TrackFeatures::getFeatureValuesMap(const std::unordered_set<FeatureName>& featur
 	}
 }
 
+void
+TrackFeatures::storeFeatureValues(const std::unordered_set<FeatureName>& featureNames)
+{
+	_featureValues.clear();
+
+	const FeatureValuesMap featureValuesMap {getFeatureValuesMap(featureNames)};
+	_featureValues = encodeFeatureValuesMap(featureValuesMap);
+}
+
 } // namespace Database
@@ -18,6 +18,7 @@
  */
 #include "database/TrackList.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 #include "utils/Logger.hpp"
@@ -29,6 +30,7 @@
 #include "database/User.hpp"
 #include "database/Track.hpp"
 #include "SqlQuery.hpp"
+#include "Utils.hpp"
 
 namespace Database {
 
@@ -53,6 +55,57 @@ TrackList::create(Session& session, const std::string& name, Type type, bool isP
 	return res;
 }
 
+std::size_t
+TrackList::appendTracks(Session& session, pointer tracklist, const std::vector<IdType>& trackIds, std::optional<std::size_t> maxCount)
+{
+	session.checkUniqueLocked();
+	assert(tracklist);
+
+	// Each id takes two host parameters (position and id)
+	constexpr std::size_t maxIdsPerStatement {Utils::maxIdsPerQuery / 2};
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+	dboSession.flush();
+
+	std::size_t appendedCount {};
+	for (std::size_t offset {}; offset < trackIds.size(); offset += maxIdsPerStatement)
+	{
+		if (maxCount && appendedCount == *maxCount)
+			break;
+
+		const std::size_t idCount {std::min(maxIdsPerStatement, trackIds.size() - offset)};
+		// padded with invalid ids, so that only a few statement shapes get prepared
+		const std::size_t bucketSize {Utils::getPlaceholderBucketSize(idCount)};
+
+		std::string values;
+		values.reserve(bucketSize * 8);
+		for (std::size_t i {}; i < bucketSize; ++i)
+		{
+			if (i > 0)
+				values += ", ";
+			values += "(?, ?)";
+		}
+
+		auto call {dboSession.execute("WITH ids(pos, id) AS (VALUES " + values + ")"
+				" INSERT INTO tracklist_entry (version, track_id, tracklist_id)"
+				" SELECT 0, t.id, ? FROM ids INNER JOIN track t ON t.id = ids.id"
+				" ORDER BY ids.pos LIMIT ?")};
+
+		for (std::size_t i {}; i < bucketSize; ++i)
+		{
+			call.bind(static_cast<long long>(i));
+			call.bind(i < idCount ? trackIds[offset + i] : Wt::Dbo::dbo_default_traits::invalidId());
+		}
+		call.bind(tracklist.id());
+		call.bind(maxCount ? static_cast<long long>(*maxCount - appendedCount) : -1LL);
+		call.run();
+
+		appendedCount += dboSession.query<int>("SELECT changes()").resultValue();
+	}
+
+	return appendedCount;
+}
+
 TrackList::pointer
 TrackList::get(Session& session, const std::string& name, Type type, Wt::Dbo::ptr<User> user)
 {
@@ -104,19 +157,25 @@ TrackList::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<TrackList>().where("id = ?").bind(id);
+	return Utils::getById<TrackList>(session.getDboSession(), id);
 }
 
 bool
 TrackList::isEmpty() const
 {
-	return _entries.empty();
+	return getCount() == 0;
 }
 
 std::size_t
 TrackList::getCount() const
 {
-	return _entries.size();
+	assert(session());
+	assert(IdIsValid(self()->id()));
+
+	// No result if no entry
+	return session()->query<int>("SELECT entry_count FROM tracklist_stats")
+		.where("tracklist_id = ?").bind(self()->id())
+		.resultValue();
 }
 
 Wt::Dbo::ptr<TrackListEntry>
@@ -163,17 +222,43 @@ TrackList::getEntriesReverse(std::optional<std::size_t> offset, std::optional<st
 	return std::vector<Wt::Dbo::ptr<TrackListEntry>>(entries.begin(), entries.end());
 }
 
+std::size_t
+TrackList::compactEntries(Session& session, pointer tracklist, std::size_t keptEntryCount)
+{
+	session.checkUniqueLocked();
+	assert(tracklist);
+
+	Wt::Dbo::Session& dboSession {session.getDboSession()};
+
+	Wt::Dbo::collection<IdType> ids = dboSession.query<IdType>("SELECT id FROM tracklist_entry")
+		.where("tracklist_id = ?").bind(tracklist.id())
+		.orderBy("id DESC")
+		.limit(1)
+		.offset(static_cast<int>(keptEntryCount));
+
+	const auto itLastCompactedId {ids.begin()};
+	if (itLastCompactedId == ids.end())
+		return 0;
+
+	const IdType lastCompactedId {*itLastCompactedId};
+
+	// The play stats triggers ignore the entries up to lastCompactedId from now on
+	dboSession.execute("INSERT OR REPLACE INTO tracklist_compaction (tracklist_id, compacted_entry_id) VALUES (?, ?)").bind(tracklist.id()).bind(lastCompactedId);
+	dboSession.execute("DELETE FROM tracklist_entry WHERE tracklist_id = ? AND id <= ?").bind(tracklist.id()).bind(lastCompactedId);
+
+	return dboSession.query<int>("SELECT changes()");
+}
+
+// The following queries use the per track play stats of the tracklist (see Session), maintained by triggers on each entry change
 static
 Wt::Dbo::Query<Artist::pointer>
-createArtistsQuery(Wt::Dbo::Session& session, const std::string& queryStr, IdType tracklistId, const std::set<IdType>& clusterIds, std::optional<TrackArtistLinkType> linkType)
+createArtistsQuery(Wt::Dbo::Session& session, IdType tracklistId, const std::set<IdType>& clusterIds, std::optional<TrackArtistLinkType> linkType)
 {
-	auto query {session.query<Artist::pointer>(queryStr)};
-	query.join("track t ON t.id = t_a_l.track_id");
+	auto query {session.query<Artist::pointer>("SELECT a from artist a")};
 	query.join("track_artist_link t_a_l ON t_a_l.artist_id = a.id");
-	query.join("tracklist_entry p_e ON p_e.track_id = t.id");
-	query.join("tracklist p ON p.id = p_e.tracklist_id");
+	query.join("track_play_stats t_s ON t_s.track_id = t_a_l.track_id");
 
-	query.where("p.id = ?").bind(tracklistId);
+	query.where("t_s.tracklist_id = ?").bind(tracklistId);
 
 	if (linkType)
 		query.where("t_a_l.type = ?").bind(*linkType);
@@ -205,14 +290,13 @@ createArtistsQuery(Wt::Dbo::Session& session, const std::string& queryStr, IdTyp
 
 static
 Wt::Dbo::Query<Release::pointer>
-createReleasesQuery(Wt::Dbo::Session& session, const std::string& queryStr, IdType tracklistId, const std::set<IdType>& clusterIds)
+createReleasesQuery(Wt::Dbo::Session& session, IdType tracklistId, const std::set<IdType>& clusterIds)
 {
-	auto query {session.query<Release::pointer>(queryStr)};
+	auto query {session.query<Release::pointer>("SELECT r from release r")};
 	query.join("track t ON t.release_id = r.id");
-	query.join("tracklist_entry p_e ON p_e.track_id = t.id");
-	query.join("tracklist p ON p.id = p_e.tracklist_id");
+	query.join("track_play_stats t_s ON t_s.track_id = t.id");
 
-	query.where("p.id = ?").bind(tracklistId);
+	query.where("t_s.tracklist_id = ?").bind(tracklistId);
 
 	if (!clusterIds.empty())
 	{
@@ -242,9 +326,9 @@ static
 Wt::Dbo::Query<Track::pointer>
 createTracksQuery(Wt::Dbo::Session& session, IdType tracklistId, const std::set<IdType>& clusterIds)
 {
-	auto query {session.query<Track::pointer>("SELECT t from track t INNER JOIN tracklist_entry p_e ON p_e.track_id = t.id INNER JOIN tracklist p ON p.id = p_e.tracklist_id")};
+	auto query {session.query<Track::pointer>("SELECT t from track t INNER JOIN track_play_stats t_s ON t_s.track_id = t.id")};
 
-	query.where("p.id = ?").bind(tracklistId);
+	query.where("t_s.tracklist_id = ?").bind(tracklistId);
 
 	if (!clusterIds.empty())
 	{
@@ -275,8 +359,9 @@ TrackList::getArtistsReverse(const std::set<IdType>& clusterIds, std::optional<T
 	assert(session());
 	assert(IdIsValid(self()->id()));
 
-	Wt::Dbo::collection<Artist::pointer> collection = createArtistsQuery(*session(), "SELECT DISTINCT a from artist a", self()->id(), clusterIds, linkType)
-		.orderBy("p_e.id DESC")
+	Wt::Dbo::collection<Artist::pointer> collection = createArtistsQuery(*session(), self()->id(), clusterIds, linkType)
+		.orderBy("MAX(t_s.last_entry_id) DESC")
+		.groupBy("a.id")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
 
@@ -298,8 +383,9 @@ TrackList::getReleasesReverse(const std::set<IdType>& clusterIds, std::optional<
 	assert(session());
 	assert(IdIsValid(self()->id()));
 
-	Wt::Dbo::collection<Release::pointer> collection = createReleasesQuery(*session(), "SELECT DISTINCT r from release r", self()->id(), clusterIds)
-		.orderBy("p_e.id DESC")
+	Wt::Dbo::collection<Release::pointer> collection = createReleasesQuery(*session(), self()->id(), clusterIds)
+		.orderBy("MAX(t_s.last_entry_id) DESC")
+		.groupBy("r.id")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
 
@@ -322,8 +408,7 @@ TrackList::getTracksReverse(const std::set<IdType>& clusterIds, std::optional<Ra
 	assert(IdIsValid(self()->id()));
 
 	Wt::Dbo::collection<Track::pointer> collection = createTracksQuery(*session(), self()->id(), clusterIds)
-		.orderBy("p_e.id DESC")
-		.groupBy("t.id")
+		.orderBy("t_s.last_entry_id DESC")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
 
@@ -390,6 +475,19 @@ TrackList::getSimilarTracks(std::optional<std::size_t> offset, std::optional<std
 	return std::vector<Track::pointer>(tracks.begin(), tracks.end());
 }
 
+std::vector<Track::pointer>
+TrackList::getTracks() const
+{
+	assert(session());
+	assert(IdIsValid(self()->id()));
+
+	Wt::Dbo::collection<Track::pointer> res = session()->query<Track::pointer>("SELECT t from track t INNER JOIN tracklist_entry p_e ON t.id = p_e.track_id")
+		.where("p_e.tracklist_id = ?").bind(self()->id())
+		.orderBy("p_e.id");
+
+	return std::vector<Track::pointer>(res.begin(), res.end());
+}
+
 std::vector<IdType>
 TrackList::getTrackIds() const
 {
@@ -410,10 +508,10 @@ TrackList::getDuration() const
 
 	using milli = std::chrono::duration<int, std::milli>;
 
-	Wt::Dbo::Query<milli> query {session()->query<milli>("SELECT COALESCE(SUM(duration), 0) FROM track t INNER JOIN tracklist_entry p_e ON t.id = p_e.track_id")
-			.where("p_e.tracklist_id = ?").bind(self()->id())};
-
-	return query.resultValue();
+	// No result if no entry
+	return session()->query<milli>("SELECT duration FROM tracklist_stats")
+		.where("tracklist_id = ?").bind(self()->id())
+		.resultValue();
 }
 
 std::vector<Artist::pointer>
@@ -422,10 +520,10 @@ TrackList::getTopArtists(const std::set<IdType>& clusterIds, std::optional<Track
 	assert(session());
 	assert(IdIsValid(self()->id()));
 
-	auto query {createArtistsQuery(*session(), "SELECT a from artist a", self()->id(), clusterIds, linkType)};
+	auto query {createArtistsQuery(*session(), self()->id(), clusterIds, linkType)};
 
 	Wt::Dbo::collection<Artist::pointer> collection = query
-		.orderBy("COUNT(a.id) DESC")
+		.orderBy("SUM(t_s.play_count) DESC")
 		.groupBy("a.id")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
@@ -450,10 +548,10 @@ TrackList::getTopReleases(const std::set<IdType>& clusterIds, std::optional<Rang
 	assert(session());
 	assert(IdIsValid(self()->id()));
 
-	auto query {createReleasesQuery(*session(), "SELECT r from release r", self()->id(), clusterIds)};
+	auto query {createReleasesQuery(*session(), self()->id(), clusterIds)};
 
 	Wt::Dbo::collection<Release::pointer> collection = query
-		.orderBy("COUNT(r.id) DESC")
+		.orderBy("SUM(t_s.play_count) DESC")
 		.groupBy("r.id")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
@@ -480,8 +578,7 @@ TrackList::getTopTracks(const std::set<IdType>& clusterIds, std::optional<Range>
 	auto query {createTracksQuery(*session(), self()->id(), clusterIds)};
 
 	Wt::Dbo::collection<Track::pointer> collection = query
-		.orderBy("COUNT(t.id) DESC")
-		.groupBy("t.id")
+		.orderBy("t_s.play_count DESC")
 		.limit(range ? static_cast<int>(range->limit) + 1 : -1)
 		.offset(range ? static_cast<int>(range->offset) : -1);
 
@@ -523,7 +620,7 @@ TrackListEntry::getById(Session& session, IdType id)
 {
 	session.checkSharedLocked();
 
-	return session.getDboSession().find<TrackListEntry>().where("id = ?").bind(id);
+	return Utils::getById<TrackListEntry>(session.getDboSession(), id);
 }
 
 } // namespace Database
@@ -25,6 +25,7 @@
 #include "database/Track.hpp"
 #include "database/TrackList.hpp"
 #include "utils/Logger.hpp"
+#include "Utils.hpp"
 
 namespace Database {
 
@@ -58,6 +59,15 @@ AuthToken::removeExpiredTokens(Session& session, const Wt::WDateTime& now)
 		("DELETE FROM auth_token WHERE expiry < ?").bind(now);
 }
 
+void
+AuthToken::removeByValue(Session& session, const std::string& value)
+{
+	session.checkUniqueLocked();
+
+	session.getDboSession().execute
+		("DELETE FROM auth_token WHERE value = ?").bind(value);
+}
+
 AuthToken::pointer
 AuthToken::getByValue(Session& session, const std::string& value)
 {
@@ -111,7 +121,7 @@ User::create(Session& session, const std::string& loginName)
 User::pointer
 User::getById(Session& session, IdType id)
 {
-	return session.getDboSession().find<User>().where("id = ?").bind( id );
+	return Utils::getById<User>(session.getDboSession(), id);
 }
 
 User::pointer
@@ -212,6 +222,58 @@ User::hasStarredTrack(Wt::Dbo::ptr<Track> track) const
 	return _starredTracks.count(track) != 0;
 }
 
+static
+std::unordered_set<IdType>
+getStarredIds(Wt::Dbo::Session& session, IdType userId, const std::string& starTable, const std::string& idColumn, const std::vector<IdType>& ids)
+{
+	std::unordered_set<IdType> res;
+
+	Utils::forEachIdChunk(ids, [&](const std::vector<IdType>& chunkIds)
+	{
+		auto query {session.query<IdType>("SELECT " + idColumn + " FROM " + starTable)};
+		query.where("user_id = ?").bind(userId);
+		query.where(idColumn + " IN (" + Utils::getPlaceholders(chunkIds.size()) + ")");
+		for (const IdType id : chunkIds)
+			query.bind(id);
+
+		Wt::Dbo::collection<IdType> collection = query;
+		res.insert(collection.begin(), collection.end());
+	});
+
+	return res;
+}
+
+std::unordered_set<IdType>
+User::getStarredArtistIds() const
+{
+	assert(self());
+	assert(session());
+
+	auto query {session()->query<IdType>("SELECT artist_id FROM user_artist_starred")};
+	query.where("user_id = ?").bind(self()->id());
+
+	Wt::Dbo::collection<IdType> collection = query;
+	return std::unordered_set<IdType> {collection.begin(), collection.end()};
+}
+
+std::unordered_set<IdType>
+User::getStarredReleaseIds(const std::vector<IdType>& releaseIds) const
+{
+	assert(self());
+	assert(session());
+
+	return getStarredIds(*session(), self()->id(), "user_release_starred", "release_id", releaseIds);
+}
+
+std::unordered_set<IdType>
+User::getStarredTrackIds(const std::vector<IdType>& trackIds) const
+{
+	assert(self());
+	assert(session());
+
+	return getStarredIds(*session(), self()->id(), "user_track_starred", "track_id", trackIds);
+}
+
 } // namespace Database
 
 
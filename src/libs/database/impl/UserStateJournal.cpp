@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "database/UserStateJournal.hpp"
+
+#include <type_traits>
+
+#include <Wt/Dbo/Exception.h>
+
+#include "database/Artist.hpp"
+#include "database/Release.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+#include "database/TrackBookmark.hpp"
+#include "database/TrackList.hpp"
+#include "database/User.hpp"
+#include "utils/Logger.hpp"
+
+#include "Rebuild.hpp"
+
+namespace Database {
+
+UserStateJournal::UserStateJournal(Db& db)
+: _db {db}
+{
+}
+
+UserStateJournal::~UserStateJournal()
+{
+	if (_thread.joinable())
+	{
+		{
+			std::scoped_lock lock {_mutex};
+			_quit = true;
+		}
+		_quitCondition.notify_all();
+
+		_thread.join();
+	}
+
+	flush();
+}
+
+void
+UserStateJournal::start(const UserStateJournalSettings& settings)
+{
+	LMS_LOG(DB, INFO) << "Writing user state updates every " << settings.flushPeriod.count() << " ms";
+
+	_settings = settings;
+	_thread = std::thread {[this] { run(); }};
+}
+
+void
+UserStateJournal::setCurPlayingTrackPos(IdType userId, std::size_t pos)
+{
+	std::scoped_lock lock {_mutex};
+	_pendingUpdates[userId].curPlayingTrackPos = pos;
+}
+
+void
+UserStateJournal::addListen(IdType userId, IdType trackId)
+{
+	std::scoped_lock lock {_mutex};
+	_pendingUpdates[userId].listenedTrackIds.push_back(trackId);
+}
+
+void
+UserStateJournal::setArtistStarred(IdType userId, IdType artistId, bool starred)
+{
+	std::scoped_lock lock {_mutex};
+	_pendingUpdates[userId].starredArtists[artistId] = starred;
+}
+
+void
+UserStateJournal::setReleaseStarred(IdType userId, IdType releaseId, bool starred)
+{
+	std::scoped_lock lock {_mutex};
+	_pendingUpdates[userId].starredReleases[releaseId] = starred;
+}
+
+void
+UserStateJournal::setTrackStarred(IdType userId, IdType trackId, bool starred)
+{
+	std::scoped_lock lock {_mutex};
+	_pendingUpdates[userId].starredTracks[trackId] = starred;
+}
+
+void
+UserStateJournal::setBookmark(IdType userId, IdType trackId, std::chrono::milliseconds offset, const std::optional<std::string>& comment)
+{
+	std::scoped_lock lock {_mutex};
+
+	std::optional<Bookmark>& bookmark {_pendingUpdates[userId].bookmarks[trackId]};
+	// Keep a pending comment if not replaced
+	if (!comment && bookmark && bookmark->comment)
+		bookmark = Bookmark {offset, bookmark->comment};
+	else
+		bookmark = Bookmark {offset, comment};
+}
+
+void
+UserStateJournal::removeBookmark(IdType userId, IdType trackId)
+{
+	std::scoped_lock lock {_mutex};
+	_pendingUpdates[userId].bookmarks[trackId].reset();
+}
+
+bool
+UserStateJournal::hasPendingUpdates(IdType userId) const
+{
+	std::scoped_lock lock {_mutex};
+	return _pendingUpdates.find(userId) != std::cend(_pendingUpdates);
+}
+
+void
+UserStateJournal::flush()
+{
+	std::scoped_lock flushLock {_flushMutex};
+	flushLocked();
+}
+
+void
+UserStateJournal::flushLocked()
+{
+	std::unordered_map<IdType, UserUpdates> pendingUpdates;
+	{
+		std::scoped_lock lock {_mutex};
+		pendingUpdates.swap(_pendingUpdates);
+	}
+
+	if (pendingUpdates.empty())
+		return;
+
+	Session& session {_db.getTLSSession()};
+
+	try
+	{
+		std::size_t updateCount {};
+		{
+			auto transaction {session.createUniqueTransaction()};
+
+			for (const auto& [userId, updates] : pendingUpdates)
+				updateCount += writeUpdates(session, userId, updates);
+		}
+
+		LMS_LOG(DB, DEBUG) << "Wrote " << updateCount << " user state update(s) for " << pendingUpdates.size() << " user(s)";
+	}
+	catch (Wt::Dbo::Exception& e)
+	{
+		LMS_LOG(DB, ERROR) << "Cannot write user state updates: " << e.what() << ", will retry on next flush";
+
+		// Put the batch back, before the updates queued meanwhile
+		std::scoped_lock lock {_mutex};
+		for (auto& [userId, updates] : pendingUpdates)
+			mergeOlderUpdates(_pendingUpdates[userId], std::move(updates));
+	}
+}
+
+void
+UserStateJournal::mergeOlderUpdates(UserUpdates& updates, UserUpdates&& olderUpdates)
+{
+	if (!updates.curPlayingTrackPos)
+		updates.curPlayingTrackPos = olderUpdates.curPlayingTrackPos;
+
+	olderUpdates.listenedTrackIds.insert(std::end(olderUpdates.listenedTrackIds), std::cbegin(updates.listenedTrackIds), std::cend(updates.listenedTrackIds));
+	updates.listenedTrackIds = std::move(olderUpdates.listenedTrackIds);
+
+	// Only inserts the values that have not been updated since
+	updates.starredArtists.merge(olderUpdates.starredArtists);
+	updates.starredReleases.merge(olderUpdates.starredReleases);
+	updates.starredTracks.merge(olderUpdates.starredTracks);
+
+	for (auto& [trackId, olderBookmark] : olderUpdates.bookmarks)
+	{
+		auto [it, inserted] {updates.bookmarks.try_emplace(trackId, olderBookmark)};
+		// Keep an older comment if not replaced
+		if (!inserted && it->second && !it->second->comment && olderBookmark)
+			it->second->comment = std::move(olderBookmark->comment);
+	}
+}
+
+void
+UserStateJournal::translateIds(const Rebuild::IdMaps& idMaps)
+{
+	// Updates of objects that are not in the new database are dropped
+	auto translateKeys {[](const auto& values, const std::unordered_map<IdType, IdType>& ids)
+	{
+		std::decay_t<decltype(values)> res;
+		for (const auto& [id, value] : values)
+		{
+			auto it {ids.find(id)};
+			if (it != std::cend(ids))
+				res.emplace(it->second, value);
+		}
+		return res;
+	}};
+
+	std::scoped_lock lock {_mutex};
+
+	for (auto& [userId, updates] : _pendingUpdates)
+	{
+		std::vector<IdType> listenedTrackIds;
+		for (const IdType trackId : updates.listenedTrackIds)
+		{
+			auto it {idMaps.trackIds.find(trackId)};
+			if (it != std::cend(idMaps.trackIds))
+				listenedTrackIds.push_back(it->second);
+		}
+		updates.listenedTrackIds = std::move(listenedTrackIds);
+
+		updates.starredArtists = translateKeys(updates.starredArtists, idMaps.artistIds);
+		updates.starredReleases = translateKeys(updates.starredReleases, idMaps.releaseIds);
+		updates.starredTracks = translateKeys(updates.starredTracks, idMaps.trackIds);
+		updates.bookmarks = translateKeys(updates.bookmarks, idMaps.trackIds);
+	}
+}
+
+void
+UserStateJournal::run()
+{
+	while (true)
+	{
+		{
+			std::unique_lock lock {_mutex};
+			if (_quitCondition.wait_for(lock, _settings.flushPeriod, [this] { return _quit; }))
+				return;
+		}
+
+		flush();
+	}
+}
+
+std::size_t
+UserStateJournal::writeUpdates(Session& session, IdType userId, const UserUpdates& updates)
+{
+	// Objects may have been removed meanwhile: skip their updates
+	User::pointer user {User::getById(session, userId)};
+	if (!user)
+		return 0;
+
+	std::size_t updateCount {};
+
+	if (updates.curPlayingTrackPos)
+	{
+		user.modify()->setCurPlayingTrackPos(*updates.curPlayingTrackPos);
+		updateCount++;
+	}
+
+	if (!updates.listenedTrackIds.empty())
+	{
+		const TrackList::pointer playedTrackList {user->getPlayedTrackList(session)};
+		for (const IdType trackId : updates.listenedTrackIds)
+		{
+			if (const Track::pointer track {Track::getById(session, trackId)})
+			{
+				TrackListEntry::create(session, track, playedTrackList);
+				updateCount++;
+			}
+		}
+	}
+
+	for (const auto& [artistId, starred] : updates.starredArtists)
+	{
+		if (const Artist::pointer artist {Artist::getById(session, artistId)})
+		{
+			if (starred)
+				user.modify()->starArtist(artist);
+			else
+				user.modify()->unstarArtist(artist);
+			updateCount++;
+		}
+	}
+
+	for (const auto& [releaseId, starred] : updates.starredReleases)
+	{
+		if (const Release::pointer release {Release::getById(session, releaseId)})
+		{
+			if (starred)
+				user.modify()->starRelease(release);
+			else
+				user.modify()->unstarRelease(release);
+			updateCount++;
+		}
+	}
+
+	for (const auto& [trackId, starred] : updates.starredTracks)
+	{
+		if (const Track::pointer track {Track::getById(session, trackId)})
+		{
+			if (starred)
+				user.modify()->starTrack(track);
+			else
+				user.modify()->unstarTrack(track);
+			updateCount++;
+		}
+	}
+
+	for (const auto& [trackId, bookmark] : updates.bookmarks)
+	{
+		const Track::pointer track {Track::getById(session, trackId)};
+		if (!track)
+			continue;
+
+		TrackBookmark::pointer trackBookmark {TrackBookmark::getByUser(session, user, track)};
+		if (!bookmark)
+		{
+			if (trackBookmark)
+				trackBookmark.remove();
+		}
+		else
+		{
+			if (!trackBookmark)
+				trackBookmark = TrackBookmark::create(session, user, track);
+
+			trackBookmark.modify()->setOffset(bookmark->offset);
+			if (bookmark->comment)
+				trackBookmark.modify()->setComment(*bookmark->comment);
+		}
+		updateCount++;
+	}
+
+	return updateCount;
+}
+
+} // namespace Database
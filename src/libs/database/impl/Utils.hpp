@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Wt/Dbo/Session.h>
+
+#include "database/Session.hpp"
+#include "database/Types.hpp"
+#include "utils/Random.hpp"
+
+namespace Database::Utils
+{
+	// Always queries the database, unlike Session::load: objects removed by other sessions or by raw SQL are not returned
+	// The SQL text is the same for each call, so Dbo prepares the statement only once per connection
+	// Returns a null pointer if the object does not exist
+	template <typename T>
+	Wt::Dbo::ptr<T>
+	getById(Wt::Dbo::Session& session, IdType id)
+	{
+		return session.find<T>().where("id = ?").bind(id);
+	}
+
+	// Dbo caches prepared statements by SQL text: round up the arity of
+	// 'IN (?, ?, ...)' lists so that only a few query shapes get prepared
+	inline std::size_t
+	getPlaceholderBucketSize(std::size_t count)
+	{
+		std::size_t bucketSize {1};
+		while (bucketSize < count)
+			bucketSize *= 2;
+
+		return bucketSize;
+	}
+
+	inline std::string
+	getPlaceholders(std::size_t count)
+	{
+		std::string res;
+		res.reserve(count * 3);
+
+		for (std::size_t i {}; i < count; ++i)
+		{
+			if (i > 0)
+				res += ", ";
+			res += "?";
+		}
+
+		return res;
+	}
+
+	// Ids are padded by repeating the last one, which does not change the result of an 'IN' clause
+	template <typename Container>
+	std::vector<IdType>
+	getBucketedIds(const Container& ids)
+	{
+		std::vector<IdType> res (std::cbegin(ids), std::cend(ids));
+		if (!res.empty())
+			res.resize(getPlaceholderBucketSize(res.size()), res.back());
+
+		return res;
+	}
+
+	// Keeps 'IN' lists under the host parameter limit of older SQLite versions
+	constexpr std::size_t maxIdsPerQuery {512};
+
+	// func is called with successive bucketed chunks of ids
+	template <typename Func>
+	void
+	forEachIdChunk(const std::vector<IdType>& ids, Func func)
+	{
+		for (std::size_t offset {}; offset < ids.size(); offset += maxIdsPerQuery)
+		{
+			const auto begin {std::next(std::cbegin(ids), offset)};
+			const auto end {std::next(begin, std::min(maxIdsPerQuery, ids.size() - offset))};
+
+			func(getBucketedIds(std::vector<IdType>(begin, end)));
+		}
+	}
+
+	// Filters on several clusters at once using the in memory cluster index
+	// The clause is clausePrefix, followed by the track id placeholders, then clauseSuffix
+	// Returns false if too many tracks match: the caller must fall back on a SQL filter
+	template <typename T>
+	bool
+	filterOnClustersUsingIndex(Session& session, Wt::Dbo::Query<T>& query, const std::set<IdType>& clusterIds, const std::string& clausePrefix, const std::string& clauseSuffix)
+	{
+		const std::optional<std::vector<IdType>> trackIds {session.getTrackIdsInClusters(clusterIds, maxIdsPerQuery)};
+		if (!trackIds)
+			return false;
+
+		if (trackIds->empty())
+		{
+			query.where("0");
+			return true;
+		}
+
+		const std::vector<IdType> bucketedIds {getBucketedIds(*trackIds)};
+		query.where(clausePrefix + getPlaceholders(bucketedIds.size()) + clauseSuffix);
+		for (const IdType id : bucketedIds)
+			query.bind(id);
+
+		return true;
+	}
+
+	// Precomputed similarity tables, named "<entity>_similarity" (see Session::createSimilarityTables)
+	// Each entity has its similar entities stored by position, best first
+	inline bool
+	hasSimilarIds(Session& session, const std::string& entity)
+	{
+		return session.getDboSession().query<int>("SELECT EXISTS (SELECT 1 FROM " + entity + "_similarity)").resultValue() != 0;
+	}
+
+	inline std::vector<IdType>
+	getSimilarIds(Session& session, const std::string& entity, IdType id, std::size_t maxCount)
+	{
+		Wt::Dbo::collection<IdType> collection = session.getDboSession().query<IdType>("SELECT similar_" + entity + "_id FROM " + entity + "_similarity")
+			.where(entity + "_id = ?").bind(id)
+			.orderBy("position")
+			.limit(static_cast<int>(maxCount));
+
+		return std::vector<IdType>(collection.begin(), collection.end());
+	}
+
+	// The entries of each entity are inserted using a single statement, whose shape only depends on the number of similar ids
+	inline void
+	replaceSimilarIds(Session& session, const std::string& entity, const std::vector<std::pair<IdType, std::vector<IdType>>>& similarIds)
+	{
+		Wt::Dbo::Session& dboSession {session.getDboSession()};
+
+		dboSession.execute("DELETE FROM " + entity + "_similarity");
+
+		for (const auto& [id, ids] : similarIds)
+		{
+			if (ids.empty())
+				continue;
+
+			std::string sql {"INSERT INTO " + entity + "_similarity (" + entity + "_id, position, similar_" + entity + "_id) VALUES "};
+			for (std::size_t position {}; position < ids.size(); ++position)
+			{
+				if (position > 0)
+					sql += ", ";
+				sql += "(?, ?, ?)";
+			}
+
+			auto call {dboSession.execute(sql)};
+			for (std::size_t position {}; position < ids.size(); ++position)
+				call.bind(id).bind(static_cast<int>(position)).bind(ids[position]);
+
+			call.run();
+		}
+	}
+
+	// Picks random ids without sorting all the rows using 'ORDER BY RANDOM()':
+	// only the ids are fetched, then a partial shuffle picks the requested count
+	inline std::vector<IdType>
+	fetchRandomIds(Wt::Dbo::Query<IdType>& query, std::optional<std::size_t> count)
+	{
+		Wt::Dbo::collection<IdType> collection = query;
+		std::vector<IdType> ids(collection.begin(), collection.end());
+
+		const std::size_t pickCount {count ? std::min(*count, ids.size()) : ids.size()};
+		Random::shuffleContainerPartially(ids, pickCount);
+		ids.resize(pickCount);
+
+		return ids;
+	}
+
+	// Objects are returned in the order of ids, missing ones are skipped
+	template <typename T>
+	std::vector<Wt::Dbo::ptr<T>>
+	getByIdsInOrder(Wt::Dbo::Session& session, const std::string& tableName, const std::vector<IdType>& ids)
+	{
+		std::unordered_map<IdType, Wt::Dbo::ptr<T>> objects;
+
+		forEachIdChunk(ids, [&](const std::vector<IdType>& chunkIds)
+		{
+			auto query {session.query<Wt::Dbo::ptr<T>>("SELECT o FROM " + tableName + " o")};
+			query.where("o.id IN (" + getPlaceholders(chunkIds.size()) + ")");
+			for (const IdType id : chunkIds)
+				query.bind(id);
+
+			Wt::Dbo::collection<Wt::Dbo::ptr<T>> collection = query;
+			for (const Wt::Dbo::ptr<T>& object : collection)
+				objects.emplace(object.id(), object);
+		});
+
+		std::vector<Wt::Dbo::ptr<T>> res;
+		res.reserve(ids.size());
+		for (const IdType id : ids)
+		{
+			if (auto it {objects.find(id)}; it != std::cend(objects))
+				res.push_back(it->second);
+		}
+
+		return res;
+	}
+
+	// Keyset pagination on entries ordered by sortKeyColumn (case insensitive), then by id
+	// If sortKeyColumn is empty, entries are ordered by id only
+	// One more entry than limit is requested to tell if there are more results
+	template <typename T>
+	void
+	applyCursor(Wt::Dbo::Query<T>& query, const std::string& sortKeyColumn, const std::string& idColumn, const std::optional<Cursor>& after, std::size_t limit)
+	{
+		if (sortKeyColumn.empty())
+		{
+			if (after)
+				query.where(idColumn + " > ?").bind(after->id);
+
+			query.orderBy(idColumn);
+		}
+		else
+		{
+			if (after)
+			{
+				query.where("(" + sortKeyColumn + " COLLATE NOCASE > ? OR (" + sortKeyColumn + " COLLATE NOCASE = ? AND " + idColumn + " > ?))")
+					.bind(after->sortKey)
+					.bind(after->sortKey)
+					.bind(after->id);
+			}
+
+			query.orderBy(sortKeyColumn + " COLLATE NOCASE, " + idColumn);
+		}
+
+		query.limit(static_cast<int>(limit) + 1);
+	}
+
+	template <typename T>
+	std::vector<Wt::Dbo::ptr<T>>
+	fetchCursorResults(Wt::Dbo::Query<Wt::Dbo::ptr<T>>& query, std::size_t limit, bool& moreResults)
+	{
+		Wt::Dbo::collection<Wt::Dbo::ptr<T>> collection = query;
+
+		std::vector<Wt::Dbo::ptr<T>> res(collection.begin(), collection.end());
+		moreResults = (res.size() == limit + 1);
+		if (moreResults)
+			res.pop_back();
+
+		return res;
+	}
+
+	inline bool
+	canUseSearchIndex(const Session& session, const std::vector<std::string>& keywords)
+	{
+		return session.canUseSearchIndex(keywords);
+	}
+
+	// Each keyword must match the beginning of a word
+	inline std::string
+	getSearchIndexMatchQuery(const std::vector<std::string>& keywords)
+	{
+		std::string res;
+
+		for (const std::string& keyword : keywords)
+		{
+			if (!res.empty())
+				res += " ";
+
+			res += "\"";
+			for (char c : keyword)
+			{
+				if (c == '"')
+					res += "\"";
+				res += c;
+			}
+			res += "\"*";
+		}
+
+		return res;
+	}
+} // namespace Database::Utils
+
@@ -22,6 +22,7 @@
 #include <optional>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <Wt/WDateTime.h>
@@ -62,6 +63,7 @@ class Artist : public Wt::Dbo::Dbo<Artist>
 		// Accessors
 		static pointer			getByMBID(Session& session, const UUID& MBID);
 		static pointer			getById(Session& session, IdType id);
+		static std::vector<pointer>	getByIds(Session& session, const std::vector<IdType>& ids); // in the order of ids, missing ones are skipped
 		static std::vector<pointer>	getByName(Session& session, const std::string& name);		// exact match on name field
 		static std::vector<pointer> 	getByClusters(Session& session,
 								const std::set<IdType>& clusters,		// at least one track that belongs to  these clusters
@@ -74,6 +76,14 @@ class Artist : public Wt::Dbo::Dbo<Artist>
 								SortMethod sortMethod,
 								std::optional<Range> range,
 								bool& moreExpected);
+		static std::vector<pointer> 	getByFilter(Session& session,
+								const std::set<IdType>& clusters,
+								const std::vector<std::string>& keywords,
+								std::optional<TrackArtistLinkType> linkType,
+								SortMethod sortMethod,
+								const std::optional<Cursor>& after,		// keyset pagination variant, the cursor sort key must match the sort method
+								std::size_t limit,
+								bool& moreExpected);
 
 		static std::vector<pointer>	getAll(Session& session);
 		static std::vector<pointer>	getAll(Session& session, SortMethod sortMethod);
@@ -88,6 +98,10 @@ class Artist : public Wt::Dbo::Dbo<Artist>
 								std::optional<Range>,
 								bool& moreResults);
 		static std::vector<IdType>	getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit = {});
+		// Similar artists precomputed by the recommendation engine, best first
+		static bool					hasPrecomputedSimilarArtists(Session& session);
+		static std::vector<IdType>	getPrecomputedSimilarArtistIds(Session& session, IdType artistId, std::size_t maxCount);
+		static void					setPrecomputedSimilarArtists(Session& session, const std::vector<std::pair<IdType, std::vector<IdType>>>& similarArtistIds); // replaces all of them
 		static std::vector<pointer>	getStarred(Session& session,
 								Wt::Dbo::ptr<User> user,
 								const std::set<IdType>& clusters,
@@ -98,10 +112,13 @@ class Artist : public Wt::Dbo::Dbo<Artist>
 		// Accessors
 		const std::string&	getName() const { return _name; }
 		const std::string&	getSortName() const { return _sortName; }
-		std::optional<UUID>	getMBID() const { return UUID::fromString(_MBID); }
+		std::optional<UUID>	getMBID() const { return UUID::fromBytes(_MBID); }
 
 		std::vector<Wt::Dbo::ptr<Release>>	getReleases(const std::set<IdType>& clusterIds = {}) const; // if non empty, get the releases that match all these clusters
 		std::size_t				getReleaseCount() const;
+		// Aggregates cached in the artist, refreshed using updateAggregates (done by the scanner)
+		std::size_t				getCachedReleaseCount() const { return _releaseCount; }
+		std::size_t				getCachedTracksCount() const { return _trackCount; }
 		std::vector<Wt::Dbo::ptr<Track>>	getTracks(std::optional<TrackArtistLinkType> linkType = {}) const;
 		std::vector<Wt::Dbo::ptr<Track>>	getTracksWithRelease(std::optional<TrackArtistLinkType> linkType = {}) const;
 		std::vector<Wt::Dbo::ptr<Track>>	getRandomTracks(std::optional<std::size_t> count) const;
@@ -115,18 +132,26 @@ class Artist : public Wt::Dbo::Dbo<Artist>
 		std::vector<std::vector<Wt::Dbo::ptr<Cluster>>> getClusterGroups(std::vector<Wt::Dbo::ptr<ClusterType>> clusterTypes, std::size_t size) const;
 
 		void setName(std::string_view name)		{ _name  = name; }
-		void setMBID(const std::optional<UUID>& mbid)	{ _MBID = mbid ? mbid->getAsString() : ""; }
+		void setMBID(const std::optional<UUID>& mbid)	{ _MBID = mbid ? mbid->getAsBytes() : std::vector<unsigned char> {}; }
 		void setSortName(const std::string& sortName);
 
 		// Create
 		static pointer create(Session& session, const std::string& name, const std::optional<UUID>& UUID = {});
 
+		// Remove, returns the number of removed artists
+		static std::size_t removeAllOrphans(Session& session);
+
+		// Refresh the cached aggregates of all the artists
+		static void updateAggregates(Session& session);
+
 		template<class Action>
 			void persist(Action& a)
 			{
 				Wt::Dbo::field(a, _name, "name");
 				Wt::Dbo::field(a, _sortName, "sort_name");
 				Wt::Dbo::field(a, _MBID, "mbid");
+				Wt::Dbo::field(a, _releaseCount, "release_count");
+				Wt::Dbo::field(a, _trackCount, "track_count");
 
 				Wt::Dbo::hasMany(a, _trackArtistLinks, Wt::Dbo::ManyToOne, "artist");
 				Wt::Dbo::hasMany(a, _starringUsers, Wt::Dbo::ManyToMany, "user_release_starred", "", Wt::Dbo::OnDeleteCascade);
@@ -138,7 +163,9 @@ class Artist : public Wt::Dbo::Dbo<Artist>
 
 		std::string _name;
 		std::string _sortName;
-		std::string _MBID;	// Musicbrainz Identifier
+		std::vector<unsigned char> _MBID;	// Musicbrainz Identifier, empty if not set
+		int			_releaseCount {};
+		int			_trackCount {};
 
 		Wt::Dbo::collection<Wt::Dbo::ptr<TrackArtistLink>> _trackArtistLinks; // Tracks involving this artist
 		Wt::Dbo::collection<Wt::Dbo::ptr<User>>		_starringUsers; // Users that starred this artist
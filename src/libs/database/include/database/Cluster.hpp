@@ -52,6 +52,12 @@ class Cluster : public Wt::Dbo::Dbo<Cluster>
 		// Create utility
 		static pointer create(Session& session, Wt::Dbo::ptr<ClusterType> type, std::string_view name);
 
+		// Remove utility, returns the number of removed clusters
+		static std::size_t removeAllOrphans(Session& session);
+
+		// Refresh the cached aggregates of all the clusters
+		static void updateAggregates(Session& session);
+
 		// Accessors
 		const std::string& getName() const		{ return _name; }
 		Wt::Dbo::ptr<ClusterType> getType() const	{ return _clusterType; }
@@ -60,12 +66,18 @@ class Cluster : public Wt::Dbo::Dbo<Cluster>
 		std::set<IdType> getTrackIds() const;
 		std::size_t getReleasesCount() const;
 
+		// Aggregates cached in the cluster, refreshed using updateAggregates (done by the scanner)
+		std::size_t getCachedTracksCount() const	{ return _trackCount; }
+		std::size_t getCachedReleasesCount() const	{ return _releaseCount; }
+
 		void addTrack(Wt::Dbo::ptr<Track> track);
 
 		template<class Action>
 		void persist(Action& a)
 		{
 			Wt::Dbo::field(a, _name,	"name");
+			Wt::Dbo::field(a, _trackCount,	"track_count");
+			Wt::Dbo::field(a, _releaseCount,	"release_count");
 
 			Wt::Dbo::belongsTo(a, _clusterType, "cluster_type", Wt::Dbo::OnDeleteCascade);
 			Wt::Dbo::hasMany(a, _tracks, Wt::Dbo::ManyToMany, "track_cluster", "", Wt::Dbo::OnDeleteCascade);
@@ -76,6 +88,8 @@ class Cluster : public Wt::Dbo::Dbo<Cluster>
 		static const std::size_t _maxNameLength = 128;
 
 		std::string	_name;
+		int			_trackCount {};
+		int			_releaseCount {};
 
 		Wt::Dbo::ptr<ClusterType> _clusterType;
 		Wt::Dbo::collection< Wt::Dbo::ptr<Track> > _tracks;
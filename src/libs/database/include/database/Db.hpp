@@ -19,19 +19,76 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <shared_mutex>
+#include <string>
+#include <vector>
 
 #include <Wt/Dbo/SqlConnectionPool.h>
 
+#include "utils/ProfiledMutex.hpp"
+
 namespace Database {
 
+class ClusterTrackIndex;
+class Maintenance;
+class QueryStats;
 class Session;
+class UserStateJournal;
+
+// SQLite tuning, applied to every connection
+// Unset values keep the SQLite defaults
+struct ConnectionSettings
+{
+	std::optional<std::size_t>	cacheSizeKiB;		// page cache size, per connection
+	std::optional<std::size_t>	mmapSize;			// in bytes, 0 disables memory mapped I/O
+	bool						tempStoreInMemory {};
+	std::optional<std::chrono::milliseconds>	busyTimeout;	// defaults to the time spent waiting for a free connection
+	std::optional<std::size_t>	walAutoCheckpoint;	// in pages, 0 disables automatic checkpoints
+	std::size_t					statementCacheMaxSize {256};	// prepared statements kept by each connection, cleared beyond that when the connection is returned to the pool (0 means unlimited)
+	bool						bulkLoad {};		// no journal file nor sync on the write connection: only for databases that are discarded if the load is interrupted
+};
+
+struct QueryStatsSettings
+{
+	bool										enabled {};
+	std::optional<std::chrono::milliseconds>	slowQueryThreshold;	// queries taking longer are logged
+};
+
+struct MaintenanceSettings
+{
+	std::chrono::seconds	checkInterval {60};							// interval between two checks of the write-ahead log size
+	std::uintmax_t			walCheckpointThreshold {64 * 1024 * 1024};	// in bytes, checkpoint if the write-ahead log is bigger
+	std::chrono::minutes	optimizePeriod {60};						// optimize, checkpoint and reclaim the free pages
+	std::size_t				maxListenCount {};							// per user, older listens are only kept in the play stats (0 means unlimited)
+};
+
+struct UserStateJournalSettings
+{
+	std::chrono::milliseconds	flushPeriod {5000};	// max time the user state updates are kept in memory
+};
+
 class Db
 {
 	public:
 
-		Db(const std::filesystem::path& dbPath);
+		enum class ConcurrencyMode
+		{
+			Exclusive,			// write transactions wait for the read transactions to complete, and conversely
+			ConcurrentReads,	// read transactions only wait for other write transactions, readers see the last committed data
+		};
+
+		// Write transactions use a dedicated connection, read transactions use one of the readConnectionCount other ones
+		Db(const std::filesystem::path& dbPath,
+				std::size_t readConnectionCount = 10,
+				ConcurrencyMode concurrencyMode = ConcurrencyMode::Exclusive,
+				const ConnectionSettings& connectionSettings = {},
+				const QueryStatsSettings& queryStatsSettings = {});
 		~Db();
 
 		Db(const Db&) = delete;
@@ -39,13 +96,49 @@ class Db
 		Db& operator=(const Db&) = delete;
 		Db& operator=(Db&&) = delete;
 
+		// Long lived session of the calling thread
+		// Loaded objects are released by Dbo along with their last pointer: do not keep pointers to them beyond the transaction
 		Session& getTLSSession();
 
+		// Runs the maintenance tasks in the background, until the Db is destroyed
+		// Must be called once the tables are prepared
+		void startMaintenance(const MaintenanceSettings& settings);
+
+		// Frequent user state updates are to be queued there rather than written directly
+		// Pending updates are written on destruction
+		UserStateJournal&	getUserStateJournal() { return *_userStateJournal; }
+		void startUserStateJournal(const UserStateJournalSettings& settings);
+
+		// nullptr if the query stats are not enabled
+		const QueryStats*	getQueryStats() const { return _queryStats.get(); }
+
+		// Steps of the plan SQLite would use to run the query (EXPLAIN QUERY PLAN), placeholders are left unbound
+		// Must not be called from a thread having a pending transaction
+		std::vector<std::string> getQueryPlan(const std::string& query);
+
+		// Rebuild of the whole database in a new file, while this one is still being used
+		// The returned database is set up for bulk writes (lookup indexes only, no sync) and has the scan settings of this one
+		std::unique_ptr<Db> createRebuildDb();
+		// Creates the indexes of the rebuilt database, copies the user data (users, playlists, stars, bookmarks, ...) into it
+		// and replaces this database by it. Writes are blocked meanwhile, the file replacement itself waits for the pending reads
+		// User data refers to the rebuilt objects using their MBID or file path: objects that cannot be found are dropped
+		// Ids of the tracks, releases and artists change: objects loaded before must not be used afterwards
+		// Must not be called from a thread having a pending transaction
+		void replaceByRebuildDb(std::unique_ptr<Db> rebuildDb);
+		// Interrupted rebuild
+		static void discardRebuildDb(std::unique_ptr<Db> rebuildDb);
+
 	private:
+		friend class Maintenance;
 		friend class Session;
 
-		std::shared_mutex&		getMutex() { return _sharedMutex; }
+		ProfiledSharedMutex&	getMutex() { return _sharedMutex; }
+		QueryStats*				getQueryStats() { return _queryStats.get(); }
+		ConcurrencyMode			getConcurrencyMode() const { return _concurrencyMode; }
+		bool					isSearchIndexEnabled() const { return _searchIndexEnabled; }
+		void					setSearchIndexEnabled(bool enabled) { _searchIndexEnabled = enabled; }
 		Wt::Dbo::SqlConnectionPool&	getConnectionPool() { return *_connectionPool; }
+		ClusterTrackIndex&		getClusterTrackIndex() { return *_clusterTrackIndex; }
 
 		class ScopedConnection
 		{
@@ -59,6 +152,7 @@ class Db
 				ScopedConnection& operator=(ScopedConnection&& ) = delete;
 
 				Wt::Dbo::SqlConnection* operator->() const;
+				Wt::Dbo::SqlConnection& operator*() const { return *_connection; }
 
 			private:
 				Wt::Dbo::SqlConnectionPool& _connectionPool;
@@ -88,8 +182,17 @@ class Db
 
 		void executeSql(const std::string& sql);
 
-		std::shared_mutex				_sharedMutex;
+		const std::filesystem::path		_dbPath;
+		const std::size_t				_readConnectionCount;
+		const ConcurrencyMode			_concurrencyMode;
+		const ConnectionSettings		_connectionSettings;
+		std::atomic<bool>				_searchIndexEnabled {};	// set at startup, once the tables are prepared
+		ProfiledSharedMutex				_sharedMutex {"db"};
+		std::unique_ptr<QueryStats>		_queryStats;	// must be destroyed after the connection pool
 		std::unique_ptr<Wt::Dbo::SqlConnectionPool>	_connectionPool;
+		std::unique_ptr<Maintenance>	_maintenance;	// must be destroyed before the connection pool
+		std::unique_ptr<ClusterTrackIndex>	_clusterTrackIndex;
+		std::unique_ptr<UserStateJournal>	_userStateJournal;	// must be destroyed first, as it uses the other members
 
 		std::mutex _tlsSessionsMutex;
 		std::vector<std::unique_ptr<Session>> _tlsSessions;
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace Database {
+
+// Collects the execution times of the queries and the lock wait times of the transactions
+// Thread safe
+class QueryStats
+{
+	public:
+		struct QueryShapeStats
+		{
+			std::size_t					count {};
+			std::size_t					rowCount {};
+			std::chrono::microseconds	totalDuration {};
+			std::chrono::microseconds	maxDuration {};
+		};
+
+		struct LockWaitStats
+		{
+			std::size_t					count {};
+			std::chrono::microseconds	totalWait {};
+			std::chrono::microseconds	maxWait {};
+		};
+
+		struct Snapshot
+		{
+			std::map<std::string, QueryShapeStats>	queries;	// by query shape
+			LockWaitStats							sharedTransactions;
+			LockWaitStats							uniqueTransactions;
+		};
+
+		// Queries taking longer than slowQueryThreshold are logged
+		QueryStats(std::optional<std::chrono::milliseconds> slowQueryThreshold);
+
+		QueryStats(const QueryStats&) = delete;
+		QueryStats(QueryStats&&) = delete;
+		QueryStats& operator=(const QueryStats&) = delete;
+		QueryStats& operator=(QueryStats&&) = delete;
+
+		// Replaces the literals by placeholders and collapses the placeholder lists,
+		// so that queries only differing by their parameters share the same shape
+		static std::string getQueryShape(std::string_view sql);
+
+		void addQuery(const std::string& queryShape, const std::string& sql, std::chrono::microseconds duration, std::size_t rowCount);
+		void addSharedLockWait(std::chrono::microseconds duration);
+		void addUniqueLockWait(std::chrono::microseconds duration);
+
+		Snapshot getSnapshot() const;
+
+	private:
+		const std::optional<std::chrono::microseconds> _slowQueryThreshold;
+
+		mutable std::mutex	_mutex;
+		Snapshot			_stats;
+};
+
+} // namespace Database
+
@@ -21,6 +21,9 @@
 
 #include <optional>
 #include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <Wt/WDateTime.h>
 #include <Wt/Dbo/Dbo.h>
@@ -53,6 +56,7 @@ class Release : public Wt::Dbo::Dbo<Release>
 		static pointer			getByMBID(Session& session, const UUID& MBID);
 		static std::vector<pointer>	getByName(Session& session, const std::string& name);
 		static pointer			getById(Session& session, IdType id);
+		static std::vector<pointer>	getByIds(Session& session, const std::vector<IdType>& ids); // in the order of ids, missing ones are skipped
 		static std::vector<pointer>	getAllOrphans(Session& session); // no track related
 		static std::vector<pointer>	getAll(Session& session, std::optional<Range> range = std::nullopt);
 		static std::vector<IdType>	getAllIds(Session& session);
@@ -62,6 +66,7 @@ class Release : public Wt::Dbo::Dbo<Release>
 		static std::vector<pointer>	getLastWritten(Session& session, std::optional<Wt::WDateTime> after, const std::set<IdType>& clusters, std::optional<Range> range, bool& moreResults);
 		static std::vector<pointer>	getByYear(Session& session, int yearFrom, int yearTo, std::optional<Range> range = std::nullopt);
 		static std::vector<pointer> getStarred(Session& session, Wt::Dbo::ptr<User> user, const std::set<IdType>& clusters, std::optional<Range> range, bool& moreResults);
+		static std::vector<pointer> getStarred(Session& session, Wt::Dbo::ptr<User> user, const std::set<IdType>& clusters, const std::optional<Cursor>& after, std::size_t limit, bool& moreResults); // ordered by name
 
 		static std::vector<pointer>	getByClusters(Session& session, const std::set<IdType>& clusters);
 		static std::vector<pointer>	getByFilter(Session& session,
@@ -69,8 +74,32 @@ class Release : public Wt::Dbo::Dbo<Release>
 							const std::vector<std::string>& keywords,	// if non empty, name must match all of these keywords
 							std::optional<Range> range,
 							bool& moreExpected);
+		static std::vector<pointer>	getByFilter(Session& session,
+							const std::set<IdType>& clusters,
+							const std::vector<std::string>& keywords,
+							const std::optional<Cursor>& after,		// keyset pagination variant, ordered by name
+							std::size_t limit,
+							bool& moreExpected);
 		static std::vector<IdType>	getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit = {});
 
+		// Similar releases precomputed by the recommendation engine, best first
+		static bool					hasPrecomputedSimilarReleases(Session& session);
+		static std::vector<IdType>	getPrecomputedSimilarReleaseIds(Session& session, IdType releaseId, std::size_t maxCount);
+		static void					setPrecomputedSimilarReleases(Session& session, const std::vector<std::pair<IdType, std::vector<IdType>>>& similarReleaseIds); // replaces all of them
+
+		// Batch loaders, to report many releases without issuing queries for each of them
+		static std::unordered_map<IdType, std::vector<Wt::Dbo::ptr<Artist>>>	getArtistsByRelease(Session& session, const std::vector<IdType>& releaseIds, TrackArtistLinkType linkType);
+		static std::unordered_map<IdType, Wt::Dbo::ptr<Cluster>>				getFirstClusterByRelease(Session& session, const std::vector<IdType>& releaseIds, IdType clusterTypeId); // most used by the tracks
+
+		// Projection of what release lists display, loaded using a single query per chunk of ids
+		struct ListEntry
+		{
+			IdType					id {};
+			std::string				name;
+			std::vector<ObjectRef>	artists;	// release artists, or regular artists if there is no release artist
+		};
+		static std::vector<ListEntry>	getListEntries(Session& session, const std::vector<IdType>& releaseIds); // in the order of ids, missing ones are skipped
+
 		std::vector<Wt::Dbo::ptr<Track>> getTracks(const std::set<IdType>& clusters = std::set<IdType>()) const;
 		std::size_t			getTracksCount() const;
 		Wt::Dbo::ptr<Track>			getFirstTrack() const;
@@ -83,6 +112,12 @@ class Release : public Wt::Dbo::Dbo<Release>
 		// Create
 		static pointer create(Session& session, const std::string& name, const std::optional<UUID>& MBID = {});
 
+		// Remove, returns the number of removed releases
+		static std::size_t removeAllOrphans(Session& session);
+
+		// Refresh the cached aggregates of all the releases
+		static void updateAggregates(Session& session);
+
 		// Utility functions
 		std::optional<int> getReleaseYear(bool originalDate = false) const; // 0 if unknown or various
 		std::optional<std::string> getCopyright() const;
@@ -90,12 +125,16 @@ class Release : public Wt::Dbo::Dbo<Release>
 
 		// Accessors
 		const std::string&		getName() const		{ return _name; }
-		std::optional<UUID>		getMBID() const		{ return UUID::fromString(_MBID); }
+		std::optional<UUID>		getMBID() const		{ return UUID::fromBytes(_MBID); }
 		std::optional<std::size_t>	getTotalTrack() const;
 		std::optional<std::size_t>	getTotalDisc() const;
 		std::chrono::milliseconds	getDuration() const;
 		Wt::WDateTime				getLastWritten() const;
 
+		// Aggregates cached in the release, refreshed using updateAggregates (done by the scanner)
+		std::size_t					getCachedTracksCount() const	{ return _trackCount; }
+		std::chrono::milliseconds	getCachedDuration() const		{ return _duration; }
+
 		// Get the artists of this release
 		std::vector<Wt::Dbo::ptr<Artist> > getArtists(TrackArtistLinkType type = TrackArtistLinkType::Artist) const;
 		std::vector<Wt::Dbo::ptr<Artist> > getReleaseArtists() const { return getArtists(TrackArtistLinkType::ReleaseArtist); }
@@ -103,13 +142,15 @@ class Release : public Wt::Dbo::Dbo<Release>
 		std::vector<pointer>		getSimilarReleases(std::optional<std::size_t> offset = {}, std::optional<std::size_t> count = {}) const;
 
 		void setName(std::string_view name)		{ _name = name; }
-		void setMBID(const std::optional<UUID>& mbid)	{ _MBID = mbid ? mbid->getAsString() : ""; }
+		void setMBID(const std::optional<UUID>& mbid)	{ _MBID = mbid ? mbid->getAsBytes() : std::vector<unsigned char> {}; }
 
 		template<class Action>
 			void persist(Action& a)
 			{
 				Wt::Dbo::field(a, _name, "name");
 				Wt::Dbo::field(a, _MBID, "mbid");
+				Wt::Dbo::field(a, _trackCount, "track_count");
+				Wt::Dbo::field(a, _duration, "duration");
 
 				Wt::Dbo::hasMany(a, _tracks, Wt::Dbo::ManyToOne, "release");
 				Wt::Dbo::hasMany(a, _starringUsers, Wt::Dbo::ManyToMany, "user_release_starred", "", Wt::Dbo::OnDeleteCascade);
@@ -119,7 +160,9 @@ class Release : public Wt::Dbo::Dbo<Release>
 		static const std::size_t _maxNameLength {128};
 
 		std::string	_name;
-		std::string	_MBID;
+		std::vector<unsigned char>	_MBID;	// empty if not set
+		int			_trackCount {};
+		std::chrono::duration<int, std::milli>	_duration {};
 
 		Wt::Dbo::collection<Wt::Dbo::ptr<Track>>	_tracks; // Tracks in the release
 		Wt::Dbo::collection<Wt::Dbo::ptr<User>>		_starringUsers; // Users that starred this release
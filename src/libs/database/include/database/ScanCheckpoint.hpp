@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <Wt/WDateTime.h>
+#include <Wt/Dbo/Dbo.h>
+#include <Wt/Dbo/WtSqlTraits.h>
+
+namespace Database {
+
+class Session;
+
+// Progress of an interrupted scan, so that it can be resumed
+// There is at most one checkpoint
+class ScanCheckpoint : public Wt::Dbo::Dbo<ScanCheckpoint>
+{
+	public:
+		using pointer = Wt::Dbo::ptr<ScanCheckpoint>;
+
+		// Counters of the partial scan stats
+		struct Counters
+		{
+			std::size_t filesScanned {};
+			std::size_t skips {};
+			std::size_t scans {};
+			std::size_t additions {};
+			std::size_t deletions {};
+			std::size_t updates {};
+			std::size_t moves {};
+			std::size_t featuresFetched {};
+		};
+
+		ScanCheckpoint() = default;
+
+		// utility
+		static pointer get(Session& session);
+		static pointer getOrCreate(Session& session);
+		static void removeAll(Session& session);
+
+		// Getters
+		std::size_t				getScanVersion() const		{ return _scanVersion; }
+		bool					isForceScan() const			{ return _forceScan; }
+		std::vector<std::filesystem::path>	getMediaDirectories() const;
+		int						getStep() const				{ return _step; }
+		std::vector<std::filesystem::path>	getDirectories() const;
+		Wt::WDateTime			getStartTime() const		{ return _startTime; }
+		Counters				getCounters() const;
+
+		// Setters
+		void setScanVersion(std::size_t scanVersion)				{ _scanVersion = static_cast<int>(scanVersion); }
+		void setForceScan(bool forceScan)							{ _forceScan = forceScan; }
+		void setMediaDirectories(const std::vector<std::filesystem::path>& directories);
+		void setStep(int step)										{ _step = step; }
+		void setDirectories(const std::vector<std::filesystem::path>& directories);
+		void setStartTime(const Wt::WDateTime& startTime)			{ _startTime = startTime; }
+		void setCounters(const Counters& counters);
+
+		template<class Action>
+			void persist(Action& a)
+			{
+				Wt::Dbo::field(a, _scanVersion,		"scan_version");
+				Wt::Dbo::field(a, _forceScan,		"force_scan");
+				Wt::Dbo::field(a, _mediaDirectory,	"media_directory");
+				Wt::Dbo::field(a, _step,			"step");
+				Wt::Dbo::field(a, _directory,		"directory");
+				Wt::Dbo::field(a, _startTime,		"start_time");
+				Wt::Dbo::field(a, _filesScanned,	"files_scanned");
+				Wt::Dbo::field(a, _skips,			"skips");
+				Wt::Dbo::field(a, _scans,			"scans");
+				Wt::Dbo::field(a, _additions,		"additions");
+				Wt::Dbo::field(a, _deletions,		"deletions");
+				Wt::Dbo::field(a, _updates,			"updates");
+				Wt::Dbo::field(a, _moves,			"moves");
+				Wt::Dbo::field(a, _featuresFetched,	"features_fetched");
+			}
+
+	private:
+		int				_scanVersion {};
+		bool			_forceScan {};
+		std::string		_mediaDirectory;	// one directory per line
+		int				_step {};
+		std::string		_directory;		// for each explorer of the media directories, last directory whose files have all been committed, one per line
+		Wt::WDateTime	_startTime;
+
+		long long		_filesScanned {};
+		long long		_skips {};
+		long long		_scans {};
+		long long		_additions {};
+		long long		_deletions {};
+		long long		_updates {};
+		long long		_moves {};
+		long long		_featuresFetched {};
+};
+
+} // namespace Database
+
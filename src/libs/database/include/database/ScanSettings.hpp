@@ -20,6 +20,7 @@
 #pragma once
 
 #include <unordered_set>
+#include <vector>
 
 #include <Wt/Dbo/Dbo.h>
 #include <Wt/WTime.h>
@@ -57,7 +58,7 @@ class ScanSettings : public Wt::Dbo::Dbo<ScanSettings>
 
 		// Getters
 		std::size_t getScanVersion() const { return _scanVersion; }
-		std::filesystem::path getMediaDirectory() const { return _mediaDirectory; }
+		std::vector<std::filesystem::path> getMediaDirectories() const;
 		Wt::WTime getUpdateStartTime() const { return _startTime; }
 		UpdatePeriod getUpdatePeriod() const { return _updatePeriod; }
 		std::vector<Wt::Dbo::ptr<ClusterType>> getClusterTypes() const;
@@ -66,7 +67,7 @@ class ScanSettings : public Wt::Dbo::Dbo<ScanSettings>
 
 		// Setters
 		void addAudioFileExtension(const std::filesystem::path& ext);
-		void setMediaDirectory(const std::filesystem::path& p);
+		void setMediaDirectories(const std::vector<std::filesystem::path>& directories);
 		void setUpdateStartTime(Wt::WTime t) { _startTime = t; }
 		void setUpdatePeriod(UpdatePeriod p) { _updatePeriod = p; }
 		void setClusterTypes(Session& session, const std::set<std::string>& clusterTypeNames);
@@ -88,7 +89,7 @@ class ScanSettings : public Wt::Dbo::Dbo<ScanSettings>
 	private:
 
 		int		_scanVersion {};
-		std::string	_mediaDirectory;
+		std::string	_mediaDirectory;	// one directory per line
 		Wt::WTime	_startTime = Wt::WTime {0,0,0};
 		UpdatePeriod	_updatePeriod {UpdatePeriod::Never};
 		RecommendationEngineType _recommendationEngineType {RecommendationEngineType::Clusters};
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include <Wt/WDateTime.h>
+#include <Wt/Dbo/Dbo.h>
+#include <Wt/Dbo/WtSqlTraits.h>
+
+#include "Types.hpp"
+
+namespace Database {
+
+class Session;
+
+// Directories explored during the last complete scan
+class ScannedDirectory : public Wt::Dbo::Dbo<ScannedDirectory>
+{
+	public:
+		using pointer = Wt::Dbo::ptr<ScannedDirectory>;
+
+		ScannedDirectory() = default;
+		ScannedDirectory(const std::filesystem::path& p, const Wt::WDateTime& lastWriteTime, std::size_t scanVersion);
+
+		// utility
+		static pointer create(Session& session, const std::filesystem::path& p, const Wt::WDateTime& lastWriteTime, std::size_t scanVersion);
+		static void removeAll(Session& session);
+
+		// Find utility functions
+		static std::vector<pointer>	getAll(Session& session);
+		static pointer			getById(Session& session, IdType id);
+
+		// Getters
+		std::filesystem::path	getPath() const				{ return _path; }
+		Wt::WDateTime			getLastWriteTime() const	{ return _lastWrite; }
+		std::size_t				getScanVersion() const		{ return _scanVersion; }
+
+		template<class Action>
+			void persist(Action& a)
+			{
+				Wt::Dbo::field(a, _path,		"path");
+				Wt::Dbo::field(a, _lastWrite,	"last_write");
+				Wt::Dbo::field(a, _scanVersion,	"scan_version");
+			}
+
+	private:
+		std::string		_path;
+		Wt::WDateTime	_lastWrite;
+		int				_scanVersion {};
+};
+
+} // namespace Database
+
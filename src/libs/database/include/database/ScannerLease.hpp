@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace Database
+{
+	class Session;
+}
+
+// Lease on the scanner, for several LMS processes sharing the same database and working directory
+// Only the holder of the lease scans the media directories and trains the recommendation engine,
+// the other ones reload what it has written each time it publishes a new library generation
+// Expiry times are wall clock times: all the processes are expected to run on the same host
+namespace Database::ScannerLease
+{
+	// Creates the lease table if needed, session must be unique locked
+	void prepare(Session& session);
+
+	// Takes the lease if it has expired, or extends it if already held by node
+	// Returns true if node holds the lease for the given duration
+	bool acquire(Session& session, const std::string& node, std::chrono::seconds duration);
+	// Lets another node take the lease without waiting for it to expire
+	void release(Session& session, const std::string& node);
+
+	// Counter incremented by the lease holder each time the library has changed
+	// Only compare values for equality: the counter restarts if the database is replaced
+	long long getLibraryGeneration(Session& session);
+	void publishLibraryGeneration(Session& session, const std::string& node);
+}
@@ -22,14 +22,23 @@
 #include <mutex>
 #include <map>
 #include <memory>
+#include <optional>
+#include <set>
 #include <shared_mutex>
+#include <string>
 #include <vector>
 
 #include <Wt/Dbo/Dbo.h>
 #include <Wt/Dbo/SqlConnectionPool.h>
 
+#include "database/Types.hpp"
+#include "utils/ProfiledMutex.hpp"
+#include "utils/Tracing.hpp"
+
 namespace Database {
 
+class QueryStats;
+
 class UniqueTransaction
 {
 	public:
@@ -37,9 +46,11 @@ class UniqueTransaction
 
 	private:
 		friend class Session;
-		UniqueTransaction(std::shared_mutex& mutex, Wt::Dbo::Session& session);
+		// callSite is the function creating the transaction, for lock profiling
+		UniqueTransaction(ProfiledSharedMutex& mutex, const void* callSite, Wt::Dbo::Session& session, QueryStats* queryStats);
 
-		std::unique_lock<std::shared_mutex> _lock;
+		Tracing::Span _span {"db.unique_transaction"};	// first, to include the lock wait
+		std::unique_lock<ProfiledSharedMutex> _lock;
 		Wt::Dbo::Transaction _transaction;
 };
 
@@ -50,9 +61,29 @@ class SharedTransaction
 
 	private:
 		friend class Session;
-		SharedTransaction(std::shared_mutex& mutex, Wt::Dbo::Session& session);
-
-		std::shared_lock<std::shared_mutex> _lock;
+		// If lock is not set, the transaction relies on SQLite to read consistent data while writes occur
+		SharedTransaction(ProfiledSharedMutex& mutex, bool lock, const void* callSite, Wt::Dbo::Session& session, QueryStats* queryStats);
+
+		// Makes the transaction use a read only connection
+		class ScopedReadOnlyAccess
+		{
+			public:
+				ScopedReadOnlyAccess();
+				~ScopedReadOnlyAccess();
+
+				ScopedReadOnlyAccess(const ScopedReadOnlyAccess&) = delete;
+				ScopedReadOnlyAccess(ScopedReadOnlyAccess&&) = delete;
+				ScopedReadOnlyAccess& operator=(const ScopedReadOnlyAccess&) = delete;
+				ScopedReadOnlyAccess& operator=(ScopedReadOnlyAccess&&) = delete;
+
+			private:
+				bool _previousReadOnly;
+		};
+
+		Tracing::Span _span {"db.shared_transaction"};	// first, to include the lock wait
+		ProfiledSharedMutex& _mutex;
+		std::shared_lock<ProfiledSharedMutex> _lock;
+		ScopedReadOnlyAccess _readOnlyAccess;
 		Wt::Dbo::Transaction _transaction;
 };
 
@@ -77,12 +108,33 @@ class Session
 
 		void prepareTables(); // need to run only once at startup
 
+		// New database to be filled at once: only the indexes used to find the objects already written are created
+		// createIndexes() is to be called once filled
+		void prepareTablesForBulkLoad();
+		void createIndexes();
+
+		// Set if names can be searched using the full text search indexes
+		bool isSearchIndexEnabled() const;
+		// Set if the searches on these keywords use the full text search indexes, otherwise 'LIKE' clauses are used
+		bool canUseSearchIndex(const std::vector<std::string>& keywords) const;
+
+		// Sorted ids of the tracks belonging to all the given clusters, using the in memory cluster index
+		// nullopt if more than maxCount tracks match
+		std::optional<std::vector<IdType>> getTrackIdsInClusters(const std::set<IdType>& clusterIds, std::size_t maxCount);
+
 		Wt::Dbo::Session& getDboSession() { return _session; }
 
 	private:
 		Session(std::shared_mutex& mutex, Wt::Dbo::SqlConnectionPool& connectionPool);
 
+		void createTables();
 		void doDatabaseMigrationIfNeeded();
+		void createLookupIndexes();
+		void createTrackPlayStats();
+		void createTracklistStats();
+		void createSimilarityTables();
+		void createTrackTagCache();
+		void createSearchIndexes();
 
 		Db&					_db;
 		Wt::Dbo::Session	_session;
@@ -20,9 +20,12 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -61,6 +64,7 @@ class Track : public Wt::Dbo::Dbo<Track>
 		static std::size_t getCount(Session& session);
 		static pointer getByPath(Session& session, const std::filesystem::path& p);
 		static pointer getById(Session& session, IdType id);
+		static std::vector<pointer> getByIds(Session& session, const std::vector<IdType>& ids); // in the order of ids, missing ones are skipped
 		static pointer getByMBID(Session& session, const UUID& MBID);
 		static std::vector<pointer>	getSimilarTracks(Session& session,
 							const std::unordered_set<IdType>& trackIds,
@@ -70,25 +74,67 @@ class Track : public Wt::Dbo::Dbo<Track>
 							const std::set<IdType>& clusters);           // tracks that belong to these clusters
 		static std::vector<pointer>	getByFilter(Session& session,
 							const std::set<IdType>& clusters,            // if non empty, tracks that belong to these clusters
-							const std::vector<std::string>& keywords,    // if non empty, name must match all of these keywords
+							const std::vector<std::string>& keywords,    // if non empty, name must match all of these keywords (as word prefixes, by relevance order, if the search index is enabled)
 							std::optional<Range> range,
 							bool& moreExpected);
+		static std::vector<pointer>	getByFilter(Session& session,
+							const std::set<IdType>& clusters,
+							const std::vector<std::string>& keywords,
+							const std::optional<Cursor>& after,		// keyset pagination variant, ordered by id
+							std::size_t limit,
+							bool& moreExpected);
 
 		static std::vector<pointer>	getAll(Session& session, std::optional<std::size_t> limit = std::nullopt);
 		static std::vector<pointer>	getAllRandom(Session& session, const std::set<IdType>& clusters, std::optional<std::size_t> limit = std::nullopt);
 		static std::vector<IdType>	getAllIdsRandom(Session& session, const std::set<IdType>& clusters, std::optional<std::size_t> limit = std::nullopt);
 		static std::vector<IdType>	getAllIds(Session& session);
 		static std::vector<std::pair<IdType, std::filesystem::path>> getAllPaths(Session& session, std::optional<std::size_t> offset = std::nullopt, std::optional<std::size_t> size = std::nullopt);
+		static std::vector<std::pair<IdType, std::filesystem::path>> getAllPathsUnder(Session& session, const std::filesystem::path& path); // path itself or files in directory path
+
+		struct FileInfo
+		{
+			IdType					id;
+			std::filesystem::path	path;
+			Wt::WDateTime			lastWriteTime;
+			std::size_t				scanVersion;
+			std::uintmax_t			fileSize;		// 0 if unknown
+		};
+		static std::vector<FileInfo>	getAllFileInfos(Session& session);
+
+		// Raw tags read from the file by the scanner, so that the track can be built again without reading the file
+		// Only returned if they have been read from the file in the given state
+		static std::optional<std::vector<unsigned char>>	getCachedTags(Session& session, IdType trackId, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize);
+		static void	setCachedTags(Session& session, IdType trackId, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize, const std::vector<unsigned char>& tags);
 		static std::vector<pointer>	getMBIDDuplicates(Session& session);
 		static std::vector<pointer>	getLastWritten(Session& session, std::optional<Wt::WDateTime> after, const std::set<IdType>& clusters, std::optional<Range> range, bool& moreResults);
 		static std::vector<pointer>	getAllWithMBIDAndMissingFeatures(Session& session);
 		static std::vector<IdType>	getAllIdsWithFeatures(Session& session, std::optional<std::size_t> limit = {});
 		static std::vector<IdType>	getAllIdsWithClusters(Session& session, std::optional<std::size_t> limit = {});
+		static std::vector<std::pair<IdType, IdType>>	getAllClusterLinks(Session& session); // (track id, cluster id) pairs
+		static std::vector<std::pair<IdType, IdType>>	getAllReleaseLinks(Session& session); // (track id, release id) pairs, tracks without release are skipped
+		static std::vector<std::pair<IdType, IdType>>	getAllArtistLinks(Session& session, EnumSet<TrackArtistLinkType> linkTypes = {}); // (track id, artist id) pairs, one per link. No linkTypes means get them all
+		static std::vector<std::tuple<IdType, IdType, TrackArtistLinkType>>	getAllArtistLinksWithType(Session& session); // (track id, artist id, link type), one per link
 		static std::vector<pointer>	getStarred(Session& session,
 							Wt::Dbo::ptr<User> user,
 							const std::set<IdType>& clusters,
 							std::optional<Range> range, bool& hasMore);
 
+		// Batch loaders, to report many tracks without issuing queries for each of them
+		// no artistLinkTypes means get all
+		static std::unordered_map<IdType, std::vector<Wt::Dbo::ptr<Artist>>>	getArtistsByTrack(Session& session, const std::vector<IdType>& trackIds, EnumSet<TrackArtistLinkType> artistLinkTypes);
+		static std::unordered_map<IdType, Wt::Dbo::ptr<Cluster>>				getFirstClusterByTrack(Session& session, const std::vector<IdType>& trackIds, IdType clusterTypeId);
+
+		// Projection of what track lists display, loaded using a single query per chunk of ids
+		struct ListEntry
+		{
+			IdType						id {};
+			std::string					name;
+			std::chrono::milliseconds	duration {};
+			std::optional<ObjectRef>	release;
+			std::vector<ObjectRef>		artists;	// regular artists only
+		};
+		static std::vector<ListEntry>	getListEntries(Session& session, const std::vector<IdType>& trackIds); // in the order of ids, missing ones are skipped
+
 		// Create utility
 		static pointer	create(Session& session, const std::filesystem::path& p);
 
@@ -101,12 +147,16 @@ class Track : public Wt::Dbo::Dbo<Track>
 		void setDiscSubtitle(const std::string& name)			{ _discSubtitle = name; }
 		void setName(const std::string& name)				{ _name = std::string(name, 0, _maxNameLength); }
 		void setDuration(std::chrono::milliseconds duration)		{ _duration = duration; }
+		void setPath(const std::filesystem::path& p)			{ _filePath = p.string(); }
 		void setLastWriteTime(Wt::WDateTime time)			{ _fileLastWrite = time; }
+		void setFingerprint(const std::string& fingerprint)		{ _fingerprint = fingerprint; }
+		void setFileSize(std::uintmax_t fileSize)			{ _fileSize = static_cast<long long>(fileSize); }
+		void setCrc32(std::uint32_t crc32, const Wt::WDateTime& fileLastWrite)	{ _crc32 = crc32; _crc32FileLastWrite = fileLastWrite; }
 		void setAddedTime(Wt::WDateTime time)				{ _fileAdded = time; }
 		void setYear(int year)						{ _year = year; }
 		void setOriginalYear(int year)					{ _originalYear = year; }
 		void setHasCover(bool hasCover)					{ _hasCover = hasCover; }
-		void setMBID(const std::optional<UUID>& MBID)			{ _MBID = MBID ? MBID->getAsString() : ""; }
+		void setMBID(const std::optional<UUID>& MBID)			{ _MBID = MBID ? MBID->getAsBytes() : std::vector<unsigned char> {}; }
 		void setCopyright(const std::string& copyright)			{ _copyright = std::string(copyright, 0, _maxCopyrightLength); }
 		void setCopyrightURL(const std::string& copyrightURL)		{ _copyrightURL = std::string(copyrightURL, 0, _maxCopyrightURLLength); }
 		void setTrackReplayGain(float replayGain)			{ _trackReplayGain = replayGain; }
@@ -129,9 +179,12 @@ class Track : public Wt::Dbo::Dbo<Track>
 		std::optional<int>			getYear() const;
 		std::optional<int>			getOriginalYear() const;
 		Wt::WDateTime				getLastWriteTime() const	{ return _fileLastWrite; }
+		const std::string&			getFingerprint() const		{ return _fingerprint; }
+		std::uintmax_t				getFileSize() const		{ return static_cast<std::uintmax_t>(_fileSize); }
+		std::optional<std::uint32_t>		getCrc32() const; // only if computed on the current version of the file
 		Wt::WDateTime				getAddedTime() const		{ return _fileAdded; }
 		bool					hasCover() const		{ return _hasCover; }
-		std::optional<UUID>			getMBID() const			{ return UUID::fromString(_MBID); }
+		std::optional<UUID>			getMBID() const			{ return UUID::fromBytes(_MBID); }
 		std::optional<std::string>		getCopyright() const;
 		std::optional<std::string>		getCopyrightURL() const;
 		std::optional<float>			getTrackReplayGain() const	{ return _trackReplayGain; }
@@ -164,6 +217,10 @@ class Track : public Wt::Dbo::Dbo<Track>
 				Wt::Dbo::field(a, _originalYear,	"original_year");
 				Wt::Dbo::field(a, _filePath,		"file_path");
 				Wt::Dbo::field(a, _fileLastWrite,	"file_last_write");
+				Wt::Dbo::field(a, _fingerprint,		"fingerprint");
+				Wt::Dbo::field(a, _fileSize,		"file_size");
+				Wt::Dbo::field(a, _crc32,		"crc32");
+				Wt::Dbo::field(a, _crc32FileLastWrite,	"crc32_file_last_write");
 				Wt::Dbo::field(a, _fileAdded,		"file_added");
 				Wt::Dbo::field(a, _hasCover,		"has_cover");
 				Wt::Dbo::field(a, _MBID,		"mbid");
@@ -199,9 +256,13 @@ class Track : public Wt::Dbo::Dbo<Track>
 		int					_originalYear {};
 		std::string				_filePath;
 		Wt::WDateTime				_fileLastWrite;
+		std::string				_fingerprint;	// see computeFingerprint
+		long long				_fileSize {};	// 0 if unknown
+		long long				_crc32 {-1};	// whole file CRC32, -1 if unknown
+		Wt::WDateTime				_crc32FileLastWrite;	// last write time of the file when the CRC32 was computed
 		Wt::WDateTime				_fileAdded;
 		bool					_hasCover {};
-		std::string				_MBID; // Musicbrainz Identifier
+		std::vector<unsigned char>	_MBID; // Musicbrainz Identifier, empty if not set
 		std::string				_copyright;
 		std::string				_copyrightURL;
 		std::optional<float>			_trackReplayGain;
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -44,24 +45,47 @@ class TrackFeatures : public Wt::Dbo::Dbo<TrackFeatures>
 		using pointer = Wt::Dbo::ptr<TrackFeatures>;
 
 		TrackFeatures() = default;
-		TrackFeatures(Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures);
+		TrackFeatures(Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures, const std::unordered_set<FeatureName>& storedFeatureNames);
 
 		// Create utility
-		static pointer create(Session& session, Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures);
+		// storedFeatureNames are extracted from the json data and stored in a compact binary form
+		static pointer create(Session& session, Wt::Dbo::ptr<Track> track, const std::string& jsonEncodedFeatures, const std::unordered_set<FeatureName>& storedFeatureNames);
+
+		// Utility
+		static std::vector<IdType> getIdsWithoutStoredFeatureValues(Session& session);
+		static pointer getById(Session& session, IdType trackFeaturesId);
+
+		// Uses the stored features if they contain all the requested ones, parses the json data otherwise
+		static FeatureValuesMap getFeatureValuesMapByTrack(Session& session, IdType trackId, const std::unordered_set<FeatureName>& featureNames);
+
+		// Compact feature values of tracks, ordered by track id, starting after afterTrackId
+		// Meant to be decoded out of the transaction, using decodeFeatureValues
+		struct EncodedFeatureValues
+		{
+			IdType						trackId;
+			std::vector<unsigned char>	data;
+		};
+		static std::vector<EncodedFeatureValues> getEncodedFeatureValues(Session& session, IdType afterTrackId, std::size_t count);
+		// Nothing if some of the requested features are not stored in the compact form
+		static std::optional<FeatureValuesMap> decodeFeatureValues(const std::vector<unsigned char>& encodedFeatureValues, const std::unordered_set<FeatureName>& featureNames);
 
 		FeatureValues		getFeatureValues(const FeatureName& feature) const;
 		FeatureValuesMap	getFeatureValuesMap(const std::unordered_set<FeatureName>& featureNames) const;
 
+		void				storeFeatureValues(const std::unordered_set<FeatureName>& featureNames);
+
 		template<class Action>
 		void persist(Action& a)
 		{
 			Wt::Dbo::field(a, _data,	"data");
+			Wt::Dbo::field(a, _featureValues,	"feature_values");
 			Wt::Dbo::belongsTo(a, _track, "track", Wt::Dbo::OnDeleteCascade);
 		}
 
 	private:
 
 		std::string _data;
+		std::vector<unsigned char> _featureValues;	// binary encoded subset of _data
 		Wt::Dbo::ptr<Track> _track;
 };
 
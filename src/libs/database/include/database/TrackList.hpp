@@ -51,7 +51,7 @@ class TrackList : public Wt::Dbo::Dbo<TrackList>
 		TrackList() = default;
 		TrackList(const std::string& name, Type type, bool isPublic, Wt::Dbo::ptr<User> user);
 
-		// Stats utility
+		// Stats utility, computed from the per track play count and last entry of the tracklist
 		std::vector<Wt::Dbo::ptr<Artist>> getTopArtists(const std::set<IdType>& clusterIds, std::optional<TrackArtistLinkType> linkType, std::optional<Range> range, bool& moreResults) const;
 		std::vector<Wt::Dbo::ptr<Release>> getTopReleases(const std::set<IdType>& clusterIds, std::optional<Range> range, bool& moreResults) const;
 		std::vector<Wt::Dbo::ptr<Track>> getTopTracks(const std::set<IdType>& clusterIds, std::optional<Range> range, bool& moreResults) const;
@@ -66,6 +66,14 @@ class TrackList : public Wt::Dbo::Dbo<TrackList>
 		// Create utility
 		static pointer	create(Session& session, const std::string& name, Type type, bool isPublic, Wt::Dbo::ptr<User> user);
 
+		// Appends the tracks in the order of trackIds, ids that do not match any track are skipped
+		// Returns the number of appended tracks
+		static std::size_t appendTracks(Session& session, pointer tracklist, const std::vector<IdType>& trackIds, std::optional<std::size_t> maxCount = {});
+
+		// Removes all the entries but the keptEntryCount most recent ones, removed entries are still counted in the play stats
+		// Returns the number of removed entries
+		static std::size_t compactEntries(Session& session, pointer tracklist, std::size_t keptEntryCount);
+
 		// Accessors
 		std::string	getName() const { return _name; }
 		bool		isPublic() const { return _isPublic; }
@@ -88,6 +96,7 @@ class TrackList : public Wt::Dbo::Dbo<TrackList>
 		std::vector<Wt::Dbo::ptr<Release>> getReleasesReverse(const std::set<IdType>& clusterIds, std::optional<Range> range, bool& moreResults) const;
 		std::vector<Wt::Dbo::ptr<Track>> getTracksReverse(const std::set<IdType>& clusterIds, std::optional<Range> range, bool& moreResults) const;
 
+		std::vector<Wt::Dbo::ptr<Track>> getTracks() const; // ordered by position, loaded using a single query
 		std::vector<IdType> getTrackIds() const;
 
 		std::chrono::milliseconds getDuration() const;
@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <string>
+
 #include <Wt/Dbo/ptr.h>
 
 namespace Database
@@ -36,6 +38,21 @@ namespace Database
 		std::size_t limit {};
 	};
 
+	// Enough to display a link to an object, without loading it
+	struct ObjectRef
+	{
+		IdType		id {};
+		std::string	name;
+	};
+
+	// Keyset pagination: designates the last entry of the previous page
+	// Unlike an offset, the previous entries do not need to be walked through to get the next page
+	struct Cursor
+	{
+		std::string	sortKey;	// ignored by listings ordered by id
+		IdType		id {};
+	};
+
 	enum class TrackArtistLinkType
 	{
 		Artist,	// regular artist
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <optional>
+#include <unordered_set>
 #include <vector>
 
 #include <Wt/Dbo/Dbo.h>
@@ -62,6 +63,7 @@ class AuthToken
 		// Utility
 		static pointer create(Session& session, const std::string& value, const Wt::WDateTime&expiry, Wt::Dbo::ptr<User> user);
 		static void removeExpiredTokens(Session& session, const Wt::WDateTime& now);
+		static void removeByValue(Session& session, const std::string& value);
 		static pointer getByValue(Session& session, const std::string& value);
 		static pointer getById(Session& session, IdType tokenId);
 
@@ -198,15 +200,18 @@ class User : public Wt::Dbo::Dbo<User>
 		void			starArtist(Wt::Dbo::ptr<Artist> artist);
 		void			unstarArtist(Wt::Dbo::ptr<Artist> artist);
 		bool			hasStarredArtist(Wt::Dbo::ptr<Artist> artist) const;
+		std::unordered_set<IdType> getStarredArtistIds() const;
 
 		void			starRelease(Wt::Dbo::ptr<Release> release);
 		void			unstarRelease(Wt::Dbo::ptr<Release> release);
 		bool			hasStarredRelease(Wt::Dbo::ptr<Release> release) const;
+		std::unordered_set<IdType> getStarredReleaseIds(const std::vector<IdType>& releaseIds) const; // among releaseIds, in a single query per chunk of ids
 
 		// Stars
 		void			starTrack(Wt::Dbo::ptr<Track> track);
 		void			unstarTrack(Wt::Dbo::ptr<Track> track);
 		bool			hasStarredTrack(Wt::Dbo::ptr<Track> track) const;
+		std::unordered_set<IdType> getStarredTrackIds(const std::vector<IdType>& trackIds) const; // among trackIds, in a single query per chunk of ids
 
 		template<class Action>
 		void persist(Action& a)
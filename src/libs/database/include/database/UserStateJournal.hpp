@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "database/Db.hpp"
+#include "database/Types.hpp"
+
+namespace Database {
+
+class Session;
+
+namespace Rebuild
+{
+	struct IdMaps;
+}
+
+// Write-behind queue for the frequent updates of the user state: playing position, listens, stars and bookmarks
+// Updates are coalesced per user (last value wins, listens are appended) and written in a single write transaction,
+// so that they do not contend for the database with the scanner on each call
+// Pending updates are not visible to readers until flushed
+class UserStateJournal
+{
+	public:
+		UserStateJournal(Db& db);
+		~UserStateJournal();	// flushes the pending updates
+
+		UserStateJournal(const UserStateJournal&) = delete;
+		UserStateJournal(UserStateJournal&&) = delete;
+		UserStateJournal& operator=(const UserStateJournal&) = delete;
+		UserStateJournal& operator=(UserStateJournal&&) = delete;
+
+		// Periodically flushes the pending updates, using its own thread
+		// Before that, updates are only written on flush() or on destruction
+		void start(const UserStateJournalSettings& settings);
+
+		// Can be called from a thread having a pending transaction
+		void setCurPlayingTrackPos(IdType userId, std::size_t pos);
+		void addListen(IdType userId, IdType trackId);
+		void setArtistStarred(IdType userId, IdType artistId, bool starred);
+		void setReleaseStarred(IdType userId, IdType releaseId, bool starred);
+		void setTrackStarred(IdType userId, IdType trackId, bool starred);
+		void setBookmark(IdType userId, IdType trackId, std::chrono::milliseconds offset, const std::optional<std::string>& comment);
+		void removeBookmark(IdType userId, IdType trackId);
+
+		// Writes the pending updates now, to be called before reading state that may have just been updated
+		// Must not be called from a thread having a pending transaction
+		void flush();
+
+		// Whether updates of this user are waiting to be written
+		bool hasPendingUpdates(IdType userId) const;
+
+	private:
+		friend class Db;
+
+		// Database replacement: flushes are blocked while the pending updates are translated to the new ids
+		std::mutex&	getFlushMutex() { return _flushMutex; }
+		void		flushLocked();	// _flushMutex must be held
+		void		translateIds(const Rebuild::IdMaps& idMaps);
+
+		struct Bookmark
+		{
+			std::chrono::milliseconds	offset;
+			std::optional<std::string>	comment;	// unset keeps the existing comment
+		};
+
+		struct UserUpdates
+		{
+			std::optional<std::size_t>	curPlayingTrackPos;
+			std::vector<IdType>			listenedTrackIds;	// in listen order
+			std::map<IdType, bool>		starredArtists;
+			std::map<IdType, bool>		starredReleases;
+			std::map<IdType, bool>		starredTracks;
+			std::map<IdType, std::optional<Bookmark>>	bookmarks;	// by track, unset means removed
+		};
+
+		void run();
+		static void mergeOlderUpdates(UserUpdates& updates, UserUpdates&& olderUpdates);
+		std::size_t writeUpdates(Session& session, IdType userId, const UserUpdates& updates);
+
+		Db&							_db;
+		UserStateJournalSettings	_settings;
+
+		mutable std::mutex			_mutex;
+		std::unordered_map<IdType, UserUpdates>	_pendingUpdates;	// by user
+		std::condition_variable		_quitCondition;
+		bool						_quit {};
+
+		std::mutex					_flushMutex;	// flushes are serialized so that updates are written in order
+		std::thread					_thread;
+};
+
+} // namespace Database
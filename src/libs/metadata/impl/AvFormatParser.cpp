@@ -126,116 +126,128 @@ getArtists(const MetadataMap& metadataMap)
 	return artists;
 }
 
-std::optional<Track>
-AvFormatParser::parse(const std::filesystem::path& p, bool debug)
+std::optional<RawTrack>
+AvFormatParser::readRawTrack(const std::filesystem::path& p, bool debug)
 {
-	Track track;
+	RawTrack track;
 
 	try
 	{
 		Av::MediaFile mediaFile {p};
 
 		// Stream info
-		{
-			std::vector<AudioStream> audioStreams;
-
-			for (auto stream : mediaFile.getStreamInfo())
-			{
-				MetaData::AudioStream audioStream {static_cast<unsigned>(stream.bitrate)};
-				track.audioStreams.emplace_back(audioStream);
-			}
-		}
+		for (const Av::StreamInfo& stream : mediaFile.getStreamInfo())
+			track.audioStreams.emplace_back(MetaData::AudioStream {static_cast<unsigned>(stream.bitrate)});
 
 		track.duration = mediaFile.getDuration();
 		track.hasCover = mediaFile.hasAttachedPictures();
 
-		MetaData::Clusters clusters;
-
-		const std::map<std::string, std::string> metadataMap {mediaFile.getMetaData()};
-
-		for (const auto& metadata : metadataMap)
+		for (auto& [tag, value] : mediaFile.getMetaData())
 		{
-			const std::string& tag {metadata.first};
-			const std::string& value {metadata.second};
-
 			if (debug)
 				std::cout << "TAG = " << tag << ", VAL = " << value << std::endl;
 
-			if (tag == "TITLE")
-				track.title = value;
-			else if (tag == "TRACK")
-			{
-				// Expecting 'Number/Total'
-				std::vector<std::string> strings {StringUtils::splitString(value, "/") };
+			track.tags[tag].emplace_back(std::move(value));
+		}
+	}
+	catch(Av::MediaFileException& e)
+	{
+		return std::nullopt;
+	}
 
-				if (strings.size() > 0)
-				{
-					track.trackNumber = StringUtils::readAs<std::size_t>(strings[0]);
+	return track;
+}
 
-					if (strings.size() > 1)
-						track.totalTrack = StringUtils::readAs<std::size_t>(strings[1]);
-				}
-			}
-			else if (tag == "DISC")
-			{
-				// Expecting 'Number/Total'
-				std::vector<std::string> strings {StringUtils::splitString(value, "/")};
+Track
+AvFormatParser::parseRawTrack(const RawTrack& rawTrack)
+{
+	Track track;
 
-				if (strings.size() > 0)
-				{
-					track.discNumber = StringUtils::readAs<std::size_t>(strings[0]);
+	track.duration = rawTrack.duration;
+	track.audioStreams = rawTrack.audioStreams;
+	track.hasCover = rawTrack.hasCover;
 
-					if (strings.size() > 1)
-						track.totalDisc = StringUtils::readAs<std::size_t>(strings[1]);
-				}
-			}
-			else if (tag == "DATE"
-					|| tag == "YEAR"
-					|| tag == "WM/Year")
-			{
-				track.year = StringUtils::readAs<int>(value);
-			}
-			else if (tag == "TDOR"	// Original release time (ID3v2 2.4)
-					|| tag == "TORY")	// Original release year
-			{
-				track.originalYear = StringUtils::readAs<int>(value);
-			}
-			else if (tag == "ACOUSTID ID")
-			{
-				track.acoustID = UUID::fromString(value);
-			}
-			else if (tag == "MUSICBRAINZ RELEASE TRACK ID"
-					|| tag == "MUSICBRAINZ_RELEASETRACKID"
-					|| tag == "MUSICBRAINZ_TRACKID"
-					|| tag == "MUSICBRAINZ/TRACK ID")
-			{
-				track.musicBrainzTrackID = UUID::fromString(value);
-			}
-			else if (tag == "TSST"
-					|| tag == "DISCSUBTITLE"
-					|| tag == "SETSUBTITLE")
+	MetadataMap metadataMap;
+	for (const auto& [tag, values] : rawTrack.tags)
+	{
+		if (!values.empty())
+			metadataMap.emplace(tag, values.front());
+	}
+
+	for (const auto& metadata : metadataMap)
+	{
+		const std::string& tag {metadata.first};
+		const std::string& value {metadata.second};
+
+		if (tag == "TITLE")
+			track.title = value;
+		else if (tag == "TRACK")
+		{
+			// Expecting 'Number/Total'
+			std::vector<std::string> strings {StringUtils::splitString(value, "/") };
+
+			if (strings.size() > 0)
 			{
-				track.discSubtitle = value;
+				track.trackNumber = StringUtils::readAs<std::size_t>(strings[0]);
+
+				if (strings.size() > 1)
+					track.totalTrack = StringUtils::readAs<std::size_t>(strings[1]);
 			}
-			else if (_clusterTypeNames.find(tag) != _clusterTypeNames.end())
+		}
+		else if (tag == "DISC")
+		{
+			// Expecting 'Number/Total'
+			std::vector<std::string> strings {StringUtils::splitString(value, "/")};
+
+			if (strings.size() > 0)
 			{
-				std::vector<std::string> clusterNames {StringUtils::splitString(value, "/,;")};
+				track.discNumber = StringUtils::readAs<std::size_t>(strings[0]);
 
-				if (!clusterNames.empty())
-					track.clusters[tag] = std::set<std::string>{clusterNames.begin(), clusterNames.end()};
+				if (strings.size() > 1)
+					track.totalDisc = StringUtils::readAs<std::size_t>(strings[1]);
 			}
-
 		}
+		else if (tag == "DATE"
+				|| tag == "YEAR"
+				|| tag == "WM/Year")
+		{
+			track.year = StringUtils::readAs<int>(value);
+		}
+		else if (tag == "TDOR"	// Original release time (ID3v2 2.4)
+				|| tag == "TORY")	// Original release year
+		{
+			track.originalYear = StringUtils::readAs<int>(value);
+		}
+		else if (tag == "ACOUSTID ID")
+		{
+			track.acoustID = UUID::fromString(value);
+		}
+		else if (tag == "MUSICBRAINZ RELEASE TRACK ID"
+				|| tag == "MUSICBRAINZ_RELEASETRACKID"
+				|| tag == "MUSICBRAINZ_TRACKID"
+				|| tag == "MUSICBRAINZ/TRACK ID")
+		{
+			track.musicBrainzTrackID = UUID::fromString(value);
+		}
+		else if (tag == "TSST"
+				|| tag == "DISCSUBTITLE"
+				|| tag == "SETSUBTITLE")
+		{
+			track.discSubtitle = value;
+		}
+		else if (_clusterTypeNames.find(tag) != _clusterTypeNames.end())
+		{
+			std::vector<std::string> clusterNames {StringUtils::splitString(value, "/,;")};
 
-		track.artists = getArtists(metadataMap);
-		track.album = getAlbum(metadataMap);
-		track.albumArtists = getAlbumArtists(metadataMap);
-	}
-	catch(Av::MediaFileException& e)
-	{
-		return std::nullopt;
+			if (!clusterNames.empty())
+				track.clusters[tag] = std::set<std::string>{clusterNames.begin(), clusterNames.end()};
+		}
 	}
 
+	track.artists = getArtists(metadataMap);
+	track.album = getAlbum(metadataMap);
+	track.albumArtists = getAlbumArtists(metadataMap);
+
 	return track;
 }
 
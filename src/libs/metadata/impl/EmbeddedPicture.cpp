@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metadata/EmbeddedPicture.hpp"
+
+#include <algorithm>
+
+#include <taglib/attachedpictureframe.h>
+#include <taglib/flacfile.h>
+#include <taglib/flacpicture.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/mp4file.h>
+#include <taglib/mpegfile.h>
+#include <taglib/opusfile.h>
+#include <taglib/vorbisfile.h>
+#include <taglib/xiphcomment.h>
+
+#include "utils/Logger.hpp"
+#include "utils/String.hpp"
+
+namespace MetaData
+{
+
+namespace
+{
+	EmbeddedPicture
+	toEmbeddedPicture(const TagLib::String& mimeType, const TagLib::ByteVector& data)
+	{
+		EmbeddedPicture picture;
+		picture.mimeType = mimeType.to8Bit();
+		picture.data.resize(data.size());
+		std::transform(data.begin(), data.end(), std::begin(picture.data), [](char c) { return static_cast<std::byte>(c); });
+
+		return picture;
+	}
+
+	// FLAC and Ogg files share the same picture blocks
+	std::optional<EmbeddedPicture>
+	getFromFlacPictures(const TagLib::List<TagLib::FLAC::Picture*>& pictures)
+	{
+		const TagLib::FLAC::Picture* selectedPicture {};
+		for (const TagLib::FLAC::Picture* picture : pictures)
+		{
+			if (!selectedPicture || picture->type() == TagLib::FLAC::Picture::FrontCover)
+				selectedPicture = picture;
+
+			if (picture->type() == TagLib::FLAC::Picture::FrontCover)
+				break;
+		}
+
+		if (!selectedPicture || selectedPicture->data().isEmpty())
+			return std::nullopt;
+
+		return toEmbeddedPicture(selectedPicture->mimeType(), selectedPicture->data());
+	}
+
+	std::optional<EmbeddedPicture>
+	getFromID3v2Tag(const TagLib::ID3v2::Tag* tag)
+	{
+		if (!tag)
+			return std::nullopt;
+
+		const TagLib::ID3v2::AttachedPictureFrame* selectedFrame {};
+		for (const TagLib::ID3v2::Frame* frame : tag->frameList("APIC"))
+		{
+			const auto* pictureFrame {dynamic_cast<const TagLib::ID3v2::AttachedPictureFrame*>(frame)};
+			if (!pictureFrame)
+				continue;
+
+			if (!selectedFrame || pictureFrame->type() == TagLib::ID3v2::AttachedPictureFrame::FrontCover)
+				selectedFrame = pictureFrame;
+
+			if (pictureFrame->type() == TagLib::ID3v2::AttachedPictureFrame::FrontCover)
+				break;
+		}
+
+		if (!selectedFrame || selectedFrame->picture().isEmpty())
+			return std::nullopt;
+
+		return toEmbeddedPicture(selectedFrame->mimeType(), selectedFrame->picture());
+	}
+
+	std::optional<EmbeddedPicture>
+	getFromMP4Tag(TagLib::MP4::Tag* tag)
+	{
+		if (!tag)
+			return std::nullopt;
+
+		const TagLib::MP4::CoverArtList coverArtList {tag->itemListMap()["covr"].toCoverArtList()};
+		if (coverArtList.isEmpty() || coverArtList.front().data().isEmpty())
+			return std::nullopt;
+
+		const TagLib::MP4::CoverArt& coverArt {coverArtList.front()};
+
+		TagLib::String mimeType;
+		switch (coverArt.format())
+		{
+			case TagLib::MP4::CoverArt::JPEG:	mimeType = "image/jpeg"; break;
+			case TagLib::MP4::CoverArt::PNG:	mimeType = "image/png"; break;
+			case TagLib::MP4::CoverArt::BMP:	mimeType = "image/bmp"; break;
+			case TagLib::MP4::CoverArt::GIF:	mimeType = "image/gif"; break;
+			default: break;
+		}
+
+		return toEmbeddedPicture(mimeType, coverArt.data());
+	}
+}
+
+std::optional<EmbeddedPicture>
+readEmbeddedPicture(const std::filesystem::path& p)
+{
+	const std::string extension {StringUtils::stringToLower(p.extension().string())};
+
+	// Audio properties are not needed
+	if (extension == ".mp3")
+	{
+		TagLib::MPEG::File file {p.string().c_str(), false};
+		if (file.isValid())
+			return getFromID3v2Tag(file.ID3v2Tag());
+	}
+	else if (extension == ".flac")
+	{
+		TagLib::FLAC::File file {p.string().c_str(), false};
+		if (file.isValid())
+			return getFromFlacPictures(file.pictureList());
+	}
+	else if (extension == ".m4a" || extension == ".m4b" || extension == ".mp4" || extension == ".alac")
+	{
+		TagLib::MP4::File file {p.string().c_str(), false};
+		if (file.isValid())
+			return getFromMP4Tag(file.tag());
+	}
+	else if (extension == ".ogg" || extension == ".oga")
+	{
+		TagLib::Ogg::Vorbis::File file {p.string().c_str(), false};
+		if (file.isValid() && file.tag())
+			return getFromFlacPictures(file.tag()->pictureList());
+	}
+	else if (extension == ".opus")
+	{
+		TagLib::Ogg::Opus::File file {p.string().c_str(), false};
+		if (file.isValid() && file.tag())
+			return getFromFlacPictures(file.tag()->pictureList());
+	}
+	else
+		return std::nullopt;
+
+	LMS_LOG(METADATA, DEBUG) << "File '" << p.string() << "': cannot read tags";
+	return std::nullopt;
+}
+
+} // namespace MetaData
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metadata/IParser.hpp"
+
+#include <cstdint>
+
+namespace MetaData
+{
+
+namespace
+{
+	// To be increased each time the layout changes: data written by other versions is then ignored
+	constexpr unsigned char serializationVersion {1};
+
+	// Integers are written using 7 bits per byte, the high bit telling if more bytes follow
+	class Writer
+	{
+		public:
+			Writer(std::vector<unsigned char>& data) : _data {data} {}
+
+			void writeInteger(std::uint64_t value)
+			{
+				while (value >= 0x80)
+				{
+					_data.push_back(static_cast<unsigned char>(value | 0x80));
+					value >>= 7;
+				}
+				_data.push_back(static_cast<unsigned char>(value));
+			}
+
+			void writeString(const std::string& str)
+			{
+				writeInteger(str.size());
+				_data.insert(std::end(_data), std::cbegin(str), std::cend(str));
+			}
+
+		private:
+			std::vector<unsigned char>& _data;
+	};
+
+	class Reader
+	{
+		public:
+			Reader(const std::vector<unsigned char>& data) : _data {data} {}
+
+			bool isComplete() const { return _pos == _data.size(); }
+
+			std::optional<std::uint64_t> readInteger()
+			{
+				std::uint64_t value {};
+				for (unsigned shift {}; shift < 64; shift += 7)
+				{
+					if (_pos == _data.size())
+						return std::nullopt;
+
+					const unsigned char byte {_data[_pos++]};
+					value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+					if (!(byte & 0x80))
+						return value;
+				}
+
+				return std::nullopt;
+			}
+
+			std::optional<std::string> readString()
+			{
+				const std::optional<std::uint64_t> size {readInteger()};
+				if (!size || *size > _data.size() - _pos)
+					return std::nullopt;
+
+				std::string res(reinterpret_cast<const char*>(_data.data() + _pos), *size);
+				_pos += *size;
+
+				return res;
+			}
+
+		private:
+			const std::vector<unsigned char>& _data;
+			std::size_t _pos {};
+	};
+}
+
+std::vector<unsigned char>
+serializeRawTrack(const RawTrack& rawTrack)
+{
+	std::vector<unsigned char> data;
+	Writer writer {data};
+
+	writer.writeInteger(serializationVersion);
+	writer.writeInteger(static_cast<std::uint64_t>(rawTrack.duration.count()));
+	writer.writeInteger(rawTrack.hasCover);
+
+	writer.writeInteger(rawTrack.audioStreams.size());
+	for (const AudioStream& audioStream : rawTrack.audioStreams)
+		writer.writeInteger(audioStream.bitRate);
+
+	writer.writeInteger(rawTrack.tags.size());
+	for (const auto& [tag, values] : rawTrack.tags)
+	{
+		writer.writeString(tag);
+		writer.writeInteger(values.size());
+		for (const std::string& value : values)
+			writer.writeString(value);
+	}
+
+	return data;
+}
+
+std::optional<RawTrack>
+deserializeRawTrack(const std::vector<unsigned char>& data)
+{
+	Reader reader {data};
+
+	const std::optional<std::uint64_t> version {reader.readInteger()};
+	if (!version || *version != serializationVersion)
+		return std::nullopt;
+
+	RawTrack rawTrack;
+
+	const std::optional<std::uint64_t> duration {reader.readInteger()};
+	const std::optional<std::uint64_t> hasCover {reader.readInteger()};
+	if (!duration || !hasCover)
+		return std::nullopt;
+
+	rawTrack.duration = std::chrono::milliseconds {static_cast<std::chrono::milliseconds::rep>(*duration)};
+	rawTrack.hasCover = *hasCover != 0;
+
+	const std::optional<std::uint64_t> audioStreamCount {reader.readInteger()};
+	if (!audioStreamCount)
+		return std::nullopt;
+
+	for (std::uint64_t i {}; i < *audioStreamCount; ++i)
+	{
+		const std::optional<std::uint64_t> bitRate {reader.readInteger()};
+		if (!bitRate)
+			return std::nullopt;
+
+		rawTrack.audioStreams.push_back(AudioStream {static_cast<unsigned>(*bitRate)});
+	}
+
+	const std::optional<std::uint64_t> tagCount {reader.readInteger()};
+	if (!tagCount)
+		return std::nullopt;
+
+	for (std::uint64_t i {}; i < *tagCount; ++i)
+	{
+		std::optional<std::string> tag {reader.readString()};
+		const std::optional<std::uint64_t> valueCount {reader.readInteger()};
+		if (!tag || !valueCount)
+			return std::nullopt;
+
+		std::vector<std::string>& values {rawTrack.tags[std::move(*tag)]};
+		for (std::uint64_t j {}; j < *valueCount; ++j)
+		{
+			std::optional<std::string> value {reader.readString()};
+			if (!value)
+				return std::nullopt;
+
+			values.emplace_back(std::move(*value));
+		}
+	}
+
+	if (!reader.isComplete())
+		return std::nullopt;
+
+	return rawTrack;
+}
+
+} // namespace MetaData
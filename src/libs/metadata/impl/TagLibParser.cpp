@@ -33,6 +33,9 @@
 #include <taglib/vorbisfile.h>
 #include <taglib/wavpackfile.h>
 
+#include <type_traits>
+#include <unordered_set>
+
 #include "utils/Logger.hpp"
 #include "utils/String.hpp"
 
@@ -40,27 +43,79 @@
 namespace MetaData
 {
 
+// Tags handled by processTag, other than cluster ones
+static const std::unordered_set<std::string_view> handledTags
+{
+	"TITLE",
+	"MUSICBRAINZ_RELEASETRACKID", "MUSICBRAINZ RELEASE TRACK ID",
+	"MUSICBRAINZ_TRACKID", "MUSICBRAINZ TRACK ID",
+	"ACOUSTID_ID",
+	"TRACKTOTAL", "TRACKNUMBER",
+	"DISCTOTAL", "DISCNUMBER",
+	"DATE", "ORIGINALDATE", "ORIGINALYEAR",
+	"COPYRIGHT", "COPYRIGHTURL",
+	"REPLAYGAIN_ALBUM_GAIN", "REPLAYGAIN_TRACK_GAIN",
+	"DISCSUBTITLE", "SETSUBTITLE",
+};
+
+static constexpr std::string_view whitespaces {" \t"};
+
+// Trim in place to save a copy
+static
+void
+trimString(std::string& str)
+{
+	const auto strEnd {str.find_last_not_of(whitespaces)};
+	if (strEnd == std::string::npos)
+	{
+		str.clear();
+		return;
+	}
+
+	str.erase(strEnd + 1);
+	str.erase(0, str.find_first_not_of(whitespaces));
+}
+
+static
+std::string
+toTrimmedString(std::string value)
+{
+	trimString(value);
+
+	return value;
+}
+
+using TagMap = std::map<std::string, std::vector<std::string>>;
+
 template<typename T>
 std::vector<T>
-getPropertyValuesFirstMatchAs(const TagLib::PropertyMap& properties, const std::vector<std::string_view>& keys)
+getPropertyValuesFirstMatchAs(const TagMap& properties, const std::vector<std::string_view>& keys)
 {
 	std::vector<T> res;
 
 	for (std::string_view key : keys)
 	{
-		const TagLib::StringList& values {properties[std::string {key}]};
-		if (values.isEmpty())
+		auto it {properties.find(std::string {key})};
+		if (it == std::cend(properties) || it->second.empty())
 			continue;
 
+		const std::vector<std::string>& values {it->second};
 		res.reserve(values.size());
 
-		for (const auto& value : values)
+		for (const std::string& value : values)
 		{
-			auto val {StringUtils::readAs<T>(StringUtils::stringTrim(value.to8Bit(true)))};
-			if (!val)
-				continue;
+			if constexpr (std::is_same_v<T, std::string>)
+			{
+				res.emplace_back(toTrimmedString(value));
+			}
+			else
+			{
+				auto val {StringUtils::readAs<T>(toTrimmedString(value))};
+				if (!val)
+					continue;
 
-			res.emplace_back(std::move(*val));
+				res.emplace_back(std::move(*val));
+			}
 		}
 
 		break;
@@ -71,7 +126,7 @@ getPropertyValuesFirstMatchAs(const TagLib::PropertyMap& properties, const std::
 
 template <typename T>
 std::vector<T>
-getPropertyValuesAs(const TagLib::PropertyMap& properties, const std::string& key)
+getPropertyValuesAs(const TagMap& properties, const std::string& key)
 {
 	return getPropertyValuesFirstMatchAs<T>(properties, {std::move(key)});
 }
@@ -82,36 +137,60 @@ splitAndTrimString(const std::string& str, const std::string& delimiters)
 {
 	std::vector<std::string> res;
 
-	std::vector<std::string> strings {StringUtils::splitString(str, delimiters)};
-	for (const std::string& s : strings)
-		res.emplace_back(StringUtils::stringTrim(s));
+	for (std::string_view s : StringUtils::splitStringViews(str, delimiters))
+		res.emplace_back(StringUtils::stringTrimView(s));
 
 	return res;
 }
 
+// Insert the trimmed, non empty, values separated by any of the delimiters
+static
+void
+splitAndTrimStringInto(std::string_view str, std::string_view delimiters, std::set<std::string>& res)
+{
+	while (!str.empty())
+	{
+		const std::size_t delimiterPos {str.find_first_of(delimiters)};
+		std::string_view value {str.substr(0, delimiterPos)};
+
+		const std::size_t valueBegin {value.find_first_not_of(whitespaces)};
+		if (valueBegin != std::string_view::npos)
+		{
+			value.remove_prefix(valueBegin);
+			value.remove_suffix(value.size() - value.find_last_not_of(whitespaces) - 1);
+			res.emplace(value);
+		}
+
+		if (delimiterPos == std::string_view::npos)
+			break;
+
+		str.remove_prefix(delimiterPos + 1);
+	}
+}
+
 static
 std::vector<Artist>
-getArtists(const TagLib::PropertyMap& properties,
+getArtists(const TagMap& properties,
 		const std::vector<std::string_view>& artistTagNames,
 		const std::vector<std::string_view>& artistSortTagNames,
 		const std::vector<std::string_view>& artistMBIDTagNames
 		)
 {
-	const std::vector<std::string> artistNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistTagNames)};
+	std::vector<std::string> artistNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistTagNames)};
 	if (artistNames.empty())
 		return {};
 
 	std::vector<Artist> artists;
 	artists.reserve(artistNames.size());
-	std::transform(std::cbegin(artistNames), std::cend(artistNames), std::back_inserter(artists),
-		[&](const std::string& name) { return Artist {name}; });
+	for (std::string& name : artistNames)
+		artists.emplace_back(std::move(name));
 
 	{
-		const std::vector<std::string> artistSortNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistSortTagNames)};
+		std::vector<std::string> artistSortNames {getPropertyValuesFirstMatchAs<std::string>(properties, artistSortTagNames)};
 		if (artistSortNames.size() == artists.size())
 		{
 			for (std::size_t i {}; i < artistSortNames.size(); ++i)
-				artists[i].sortName = artistSortNames[i];
+				artists[i].sortName = std::move(artistSortNames[i]);
 		}
 	}
 
@@ -131,7 +210,7 @@ getArtists(const TagLib::PropertyMap& properties,
 
 static
 std::optional<Album>
-getAlbum(const TagLib::PropertyMap& properties)
+getAlbum(const TagMap& properties)
 {
 	std::vector<std::string> albumName {getPropertyValuesAs<std::string>(properties, "ALBUM")};
 	if (albumName.empty())
@@ -146,25 +225,32 @@ getAlbum(const TagLib::PropertyMap& properties)
 }
 
 void
-TagLibParser::processTag(Track& track, const std::string& tag, const TagLib::StringList& values, bool debug)
+TagLibParser::processTag(Track& track, const std::string& tag, const std::vector<std::string>& values)
 {
-
 	// TODO validate MBID format
-	if (debug)
+	if (tag.empty() || values.empty() || values.front().empty())
+		return;
+
+	// Other tags are only used as clusters
+	if (handledTags.find(tag) == std::cend(handledTags))
 	{
-		std::vector<std::string> strs;
-		std::transform(values.begin(), values.end(), std::back_inserter(strs), [](const auto& value) { return value.to8Bit(true); });
+		if (_clusterTypeNames.find(tag) != std::cend(_clusterTypeNames))
+		{
+			std::set<std::string> clusterNames;
+			for (const std::string& value : values)
+				splitAndTrimStringInto(value, "/,;", clusterNames);
 
-		std::cout << "[" << tag << "] = " << StringUtils::joinStrings(strs, "*SEP*") << std::endl;
-	}
+			if (!clusterNames.empty())
+				track.clusters[tag] = std::move(clusterNames);
+		}
 
-	if (tag.empty() || values.isEmpty() || values.front().isEmpty())
 		return;
+	}
 
-	std::string value {StringUtils::stringTrim(values.front().to8Bit(true))};
+	std::string value {toTrimmedString(values.front())};
 
 	if (tag == "TITLE")
-		track.title = value;
+		track.title = std::move(value);
 	else if (tag == "MUSICBRAINZ_RELEASETRACKID"
 			|| tag == "MUSICBRAINZ RELEASE TRACK ID")
 	{
@@ -204,7 +290,7 @@ TagLibParser::processTag(Track& track, const std::string& tag, const TagLib::Str
 	else if (tag == "DISCNUMBER")
 	{
 		// Expecting 'Number/Total'
-		std::vector<std::string> strings {StringUtils::splitString(value, "/")};
+		const std::vector<std::string_view> strings {StringUtils::splitStringViews(value, "/")};
 
 		if (!strings.empty())
 		{
@@ -229,39 +315,23 @@ TagLibParser::processTag(Track& track, const std::string& tag, const TagLib::Str
 		if (originalYear)
 			track.originalYear = originalYear;
 	}
-	else if (tag == "METADATA_BLOCK_PICTURE")
-		track.hasCover = true;
 	else if (tag == "COPYRIGHT")
-		track.copyright = value;
+		track.copyright = std::move(value);
 	else if (tag == "COPYRIGHTURL")
-		track.copyrightURL = value;
+		track.copyrightURL = std::move(value);
 	else if (tag == "REPLAYGAIN_ALBUM_GAIN")
 		track.albumReplayGain = StringUtils::readAs<float>(value);
 	else if (tag == "REPLAYGAIN_TRACK_GAIN")
 		track.trackReplayGain = StringUtils::readAs<float>(value);
 	else if (tag == "DISCSUBTITLE" || tag == "SETSUBTITLE")
-		track.discSubtitle = value;
-	else if (_clusterTypeNames.find(tag) != _clusterTypeNames.end())
-	{
-		std::set<std::string> clusterNames;
-		for (const auto& valueList : values)
-		{
-			const auto splittedValues {splitAndTrimString(valueList.to8Bit(true), "/,;")};
-
-			for (const auto& value : splittedValues)
-				clusterNames.insert(value);
-		}
-
-		if (!clusterNames.empty())
-			track.clusters[tag] = clusterNames;
-	}
+		track.discSubtitle = std::move(value);
 }
 
-std::optional<Track>
-TagLibParser::parse(const std::filesystem::path& p, bool debug)
+std::optional<RawTrack>
+TagLibParser::readRawTrack(const std::filesystem::path& p, bool debug)
 {
 	TagLib::FileRef f {p.string().c_str(),
-		true, // read audio properties
+		_readAudioProperties,
 		TagLib::AudioProperties::Fast};
 
 	if (f.isNull())
@@ -270,21 +340,22 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 		return std::nullopt;
 	}
 
-	if (!f.audioProperties())
+	if (_readAudioProperties && !f.audioProperties())
 	{
 		LMS_LOG(METADATA, INFO) << "File '" << p.string() << "': no audio properties";
 		return std::nullopt;
 	}
 
-	Track track;
+	RawTrack track;
 
+	// Left empty if not read
+	if (_readAudioProperties)
 	{
 		const TagLib::AudioProperties *properties {f.audioProperties() };
 
 		track.duration = std::chrono::milliseconds {properties->length() * 1000};
 
-		MetaData::AudioStream audioStream {static_cast<unsigned>(properties->bitrate() * 1000)};
-		track.audioStreams = {std::move(audioStream)};
+		track.audioStreams.push_back(MetaData::AudioStream {static_cast<unsigned>(properties->bitrate() * 1000)});
 	}
 
 	TagLib::PropertyMap properties {f.file()->properties()};
@@ -388,14 +459,49 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 			track.hasCover = true;
 	}
 
-	for (const auto& property : properties)
+	for (const auto& [name, values] : properties)
 	{
-		const std::string tag {property.first.upper().to8Bit(true)};
-		const TagLib::StringList& values {property.second};
+		// PropertyMap keys are already upper case
+		std::string tag {name.to8Bit(true)};
+
+		if (debug)
+		{
+			std::vector<std::string> strs;
+			std::transform(values.begin(), values.end(), std::back_inserter(strs), [](const auto& value) { return value.to8Bit(true); });
 
-		processTag(track, tag, values, debug);
+			std::cout << "[" << tag << "] = " << StringUtils::joinStrings(strs, "*SEP*") << std::endl;
+		}
+
+		// Do not keep the picture data
+		if (tag == "METADATA_BLOCK_PICTURE")
+		{
+			if (!values.isEmpty() && !values.front().isEmpty())
+				track.hasCover = true;
+			continue;
+		}
+
+		std::vector<std::string>& tagValues {track.tags[std::move(tag)]};
+		tagValues.reserve(values.size());
+		for (const auto& value : values)
+			tagValues.emplace_back(value.to8Bit(true));
 	}
 
+	return track;
+}
+
+Track
+TagLibParser::parseRawTrack(const RawTrack& rawTrack)
+{
+	Track track;
+
+	track.duration = rawTrack.duration;
+	track.audioStreams = rawTrack.audioStreams;
+	track.hasCover = rawTrack.hasCover;
+
+	const TagMap& properties {rawTrack.tags};
+	for (const auto& [tag, values] : properties)
+		processTag(track, tag, values);
+
 	track.album = getAlbum(properties);
 	track.artists = getArtists(properties, {"ARTISTS", "ARTIST"}, {"ARTISTSORT"}, {"MUSICBRAINZ_ARTISTID", "MUSICBRAINZ ARTIST ID"});
 	track.albumArtists = getArtists(properties, {"ALBUMARTIST"}, {"ALBUMARTISTSORT"}, {"MUSICBRAINZ_ALBUMARTISTID", "MUSICBRAINZ ALBUM ARTIST ID"});
@@ -404,7 +510,7 @@ TagLibParser::parse(const std::filesystem::path& p, bool debug)
 	track.lyricistArtists = getArtists(properties, {"LYRICIST"}, {"LYRICISTSORT"}, {});
 	track.mixerArtists = getArtists(properties, {"MIXER"}, {""}, {});
 	track.producerArtists = getArtists(properties, {"PRODUCER"}, {""}, {});
-	track.remixerArtists = getArtists(properties, {"REMIXER", "ModifiedBy"}, {""}, {});
+	track.remixerArtists = getArtists(properties, {"REMIXER", "MODIFIEDBY"}, {""}, {});
 
 	return track;
 }
@@ -28,7 +28,8 @@ namespace MetaData
 class AvFormatParser : public IParser
 {
 	public:
-		std::optional<Track> parse(const std::filesystem::path& p, bool debug = false) override;
+		std::optional<RawTrack> readRawTrack(const std::filesystem::path& p, bool debug = false) override;
+		Track parseRawTrack(const RawTrack& rawTrack) override;
 };
 
 } // namespace MetaData
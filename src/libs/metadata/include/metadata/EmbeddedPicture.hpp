@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace MetaData
+{
+	struct EmbeddedPicture
+	{
+		std::string				mimeType;	// as stated in the file, may be empty
+		std::vector<std::byte>	data;
+	};
+
+	// Reads the front cover embedded in the tags, or the first picture if there is no front cover
+	// Only reads the tags, which is much cheaper than probing the file using libavformat
+	// Handles MP3 (ID3v2), FLAC, MP4 and Ogg (Vorbis, Opus) files, unset for other formats or if there is no picture
+	std::optional<EmbeddedPicture> readEmbeddedPicture(const std::filesystem::path& p);
+}
@@ -24,6 +24,7 @@
 #include <map>
 #include <optional>
 #include <set>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -39,8 +40,8 @@ namespace MetaData
 		std::optional<std::string> sortName;
 		std::optional<UUID> musicBrainzArtistID;
 
-		Artist(std::string_view _name) : name {_name} {}
-		Artist(std::string_view _name, std::optional<std::string> _sortName, std::optional<UUID> _musicBrainzArtistID) : name {_name}, sortName {_sortName}, musicBrainzArtistID {_musicBrainzArtistID} {}
+		Artist(std::string _name) : name {std::move(_name)} {}
+		Artist(std::string _name, std::optional<std::string> _sortName, std::optional<UUID> _musicBrainzArtistID) : name {std::move(_name)}, sortName {std::move(_sortName)}, musicBrainzArtistID {_musicBrainzArtistID} {}
 	};
 
 	struct Album
@@ -86,17 +87,48 @@ namespace MetaData
 		std::vector<Artist>		remixerArtists;
 	};
 
+	// Tags as read from a file, along with what cannot be found in them
+	// The track can be built again from them without accessing the file (cluster types may have changed meanwhile, etc.)
+	struct RawTrack
+	{
+		std::map<std::string, std::vector<std::string>>	tags;	// by name, as reported by the parser
+		std::chrono::milliseconds	duration {};
+		std::vector<AudioStream>	audioStreams;	// empty if the audio properties have not been read
+		bool						hasCover {};	// embedded pictures, whose data is not kept
+	};
+
+	// Compact binary form, to be stored
+	// Returns nothing if the data is invalid or has been produced by another serialization version
+	std::vector<unsigned char> serializeRawTrack(const RawTrack& rawTrack);
+	std::optional<RawTrack> deserializeRawTrack(const std::vector<unsigned char>& data);
+
 	class IParser
 	{
 		public:
 			virtual ~IParser() = default;
 
-			virtual std::optional<Track> parse(const std::filesystem::path& p, bool debug = false) = 0;
+			std::optional<Track> parse(const std::filesystem::path& p, bool debug = false)
+			{
+				std::optional<RawTrack> rawTrack {readRawTrack(p, debug)};
+				if (!rawTrack)
+					return std::nullopt;
+
+				return parseRawTrack(*rawTrack);
+			}
+
+			// Only this part reads the file
+			virtual std::optional<RawTrack> readRawTrack(const std::filesystem::path& p, bool debug = false) = 0;
+			virtual Track parseRawTrack(const RawTrack& rawTrack) = 0;
 
 			void setClusterTypeNames(const std::set<std::string>& clusterTypeNames) { _clusterTypeNames = clusterTypeNames; }
 
+			// Reading the audio properties (duration, audio streams) may need to read far into the file
+			// If not set, parsers may skip them and only read the tags
+			void setReadAudioProperties(bool readAudioProperties) { _readAudioProperties = readAudioProperties; }
+
 		protected:
 			std::set<std::string> _clusterTypeNames;
+			bool _readAudioProperties {true};
 	};
 
 } // namespace MetaData
@@ -21,11 +21,6 @@
 
 #include "metadata/IParser.hpp"
 
-namespace TagLib
-{
-	class StringList;
-}
-
 namespace MetaData
 {
 
@@ -33,9 +28,10 @@ namespace MetaData
 class TagLibParser : public IParser
 {
 	private:
-		std::optional<Track> parse(const std::filesystem::path& p, bool debug = false) override;
+		std::optional<RawTrack> readRawTrack(const std::filesystem::path& p, bool debug = false) override;
+		Track parseRawTrack(const RawTrack& rawTrack) override;
 
-		void processTag(Track& track, const std::string& tag, const TagLib::StringList& values, bool debug);
+		void processTag(Track& track, const std::string& tag, const std::vector<std::string>& values);
 };
 
 } // namespace MetaData
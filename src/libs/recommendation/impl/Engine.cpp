@@ -19,20 +19,32 @@
 
 #include "Engine.hpp"
 
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "ClustersClassifierCreator.hpp"
 #include "FeaturesClassifierCreator.hpp"
+#include "NearestNeighboursClassifierCreator.hpp"
 
 #include "database/Db.hpp"
 #include "database/Session.hpp"
 #include "database/ScanSettings.hpp"
 #include "utils/Exception.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/SamplingProfiler.hpp"
+#include "utils/Scheduler.hpp"
+#include "utils/Service.hpp"
 
 namespace Recommendation {
 
+static Metrics::Counter& queryCount {Metrics::getCounter("lms_recommendation_queries_total", "Number of similarity queries, including the ones served from the result cache")};
+static Metrics::Histogram& computeDuration {Metrics::getHistogram("lms_recommendation_compute_duration_seconds", "Time spent computing the similarity queries not found in the result cache")};
+static Metrics::Histogram& loadDuration {Metrics::getHistogram("lms_recommendation_load_duration_seconds", "Time spent loading or training the classifiers")};
 
 static
 std::unique_ptr<IClassifier>
@@ -47,6 +59,10 @@ createClassifier(ClassifierType type)
 		case ClassifierType::Features:
 			return createFeaturesClassifier();
 			break;
+
+		case ClassifierType::NearestNeighbours:
+			return createNearestNeighboursClassifier();
+			break;
 	}
 
 	return {};
@@ -60,39 +76,72 @@ createEngine(Database::Db& db)
 
 Engine::Engine(Database::Db& db)
 : _db {db}
+, _resultCache {Service<IConfig>::get()->getULong("recommendation-result-cache-size", 512)}
 {
 }
 
-std::unordered_set<Database::IdType>
-Engine::getSimilarTracksFromTrackList(Database::Session& session, Database::IdType trackListId, std::size_t maxCount)
+// Classifiers are queried for maxCount + excludedIds.size() objects, so that excluded ones do not make results short
+static
+void
+copyResults(const IEngine::RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds, std::size_t maxCount, IEngine::RankedResults& output)
+{
+	output.clear();
+	for (const IEngine::ScoredId& result : results)
+	{
+		if (output.size() == maxCount)
+			break;
+
+		if (excludedIds.find(result.id) == std::cend(excludedIds))
+			output.push_back(result);
+	}
+}
+
+void
+Engine::getRankedSimilarTracksFromTrackList(Database::Session& session, Database::IdType trackListId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds)
 {
-	std::unordered_set<Database::IdType> res;
+	results.clear();
+
+	const std::shared_ptr<const ClassifierSet> classifierSet {getClassifierSet()};
+	if (!classifierSet)
+		return;
 
-	std::shared_lock lock {_classifiersMutex};
-	for (const auto& classifierName : _classifierPriorities)
+	for (ClassifierType classifierType : classifierSet->priorities)
 	{
-		auto itClassifier {_classifiers.find(classifierName)};
-		if (itClassifier == std::cend(_classifiers))
+		auto itClassifier {classifierSet->classifiers.find(classifierType)};
+		if (itClassifier == std::cend(classifierSet->classifiers))
 			continue;
 
-		res = itClassifier->second->getSimilarTracksFromTrackList(session, trackListId, maxCount);
-		if (!res.empty())
+		copyResults(itClassifier->second->getSimilarTracksFromTrackList(session, trackListId, maxCount + excludedIds.size()), excludedIds, maxCount, results);
+		if (!results.empty())
 			break;
 	}
+}
 
-	return res;
+void
+Engine::getRankedSimilarTracks(Database::Session& dbSession, const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds)
+{
+	queryCount.inc();
+	const std::size_t queriedCount {maxCount + excludedIds.size()};
+	ResultCache::Key key {ResultCache::QueryType::SimilarTracks, {std::cbegin(trackIds), std::cend(trackIds)}, {}, queriedCount};
+
+	const ResultCache::Results similarTracks {_resultCache.getOrCompute(std::move(key), [&] { return computeSimilarTracks(dbSession, trackIds, queriedCount); })};
+	copyResults(*similarTracks, excludedIds, maxCount, results);
 }
 
-std::unordered_set<Database::IdType>
-Engine::getSimilarTracks(Database::Session& dbSession, const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount)
+IEngine::RankedResults
+Engine::computeSimilarTracks(Database::Session& dbSession, const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount)
 {
-	std::unordered_set<Database::IdType> res;
+	const Metrics::ScopedTimer timer {computeDuration};
+	RankedResults res;
+
+	const std::shared_ptr<const ClassifierSet> classifierSet {getClassifierSet()};
+	if (!classifierSet)
+		return res;
 
-	std::shared_lock lock {_classifiersMutex};
-	for (ClassifierType classifierType : _classifierPriorities)
+	for (ClassifierType classifierType : classifierSet->priorities)
 	{
-		auto itClassifier {_classifiers.find(classifierType)};
-		if (itClassifier == std::cend(_classifiers))
+		auto itClassifier {classifierSet->classifiers.find(classifierType)};
+		if (itClassifier == std::cend(classifierSet->classifiers))
 			continue;
 
 		const IClassifier& classifier {*itClassifier->second};
@@ -107,16 +156,31 @@ Engine::getSimilarTracks(Database::Session& dbSession, const std::unordered_set<
 	return res;
 }
 
-std::unordered_set<Database::IdType>
-Engine::getSimilarReleases(Database::Session& dbSession, Database::IdType releaseId, std::size_t maxCount)
+void
+Engine::getRankedSimilarReleases(Database::Session& dbSession, Database::IdType releaseId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds)
+{
+	queryCount.inc();
+	const std::size_t queriedCount {maxCount + excludedIds.size()};
+	ResultCache::Key key {ResultCache::QueryType::SimilarReleases, {releaseId}, {}, queriedCount};
+
+	const ResultCache::Results similarReleases {_resultCache.getOrCompute(std::move(key), [&] { return computeSimilarReleases(dbSession, releaseId, queriedCount); })};
+	copyResults(*similarReleases, excludedIds, maxCount, results);
+}
+
+IEngine::RankedResults
+Engine::computeSimilarReleases(Database::Session& dbSession, Database::IdType releaseId, std::size_t maxCount)
 {
-	std::unordered_set<Database::IdType> res;
+	const Metrics::ScopedTimer timer {computeDuration};
+	RankedResults res;
 
-	std::shared_lock lock {_classifiersMutex};
-	for (ClassifierType classifierType : _classifierPriorities)
+	const std::shared_ptr<const ClassifierSet> classifierSet {getClassifierSet()};
+	if (!classifierSet)
+		return res;
+
+	for (ClassifierType classifierType : classifierSet->priorities)
 	{
-		auto itClassifier {_classifiers.find(classifierType)};
-		if (itClassifier == std::cend(_classifiers))
+		auto itClassifier {classifierSet->classifiers.find(classifierType)};
+		if (itClassifier == std::cend(classifierSet->classifiers))
 			continue;
 
 		const IClassifier& classifier {*itClassifier->second};
@@ -131,19 +195,41 @@ Engine::getSimilarReleases(Database::Session& dbSession, Database::IdType releas
 	return res;
 }
 
-std::unordered_set<Database::IdType>
-Engine::getSimilarArtists(Database::Session& dbSession,
+void
+Engine::getRankedSimilarArtists(Database::Session& dbSession,
+		Database::IdType artistId,
+		EnumSet<Database::TrackArtistLinkType> linkTypes,
+		std::size_t maxCount,
+		RankedResults& results,
+		const std::unordered_set<Database::IdType>& excludedIds)
+{
+	queryCount.inc();
+	const std::size_t queriedCount {maxCount + excludedIds.size()};
+	ResultCache::Key key {ResultCache::QueryType::SimilarArtists, {artistId}, {}, queriedCount};
+	for (Database::TrackArtistLinkType linkType : linkTypes)
+		key.linkTypes |= (std::uint32_t {1} << static_cast<std::uint32_t>(linkType));
+
+	const ResultCache::Results similarArtists {_resultCache.getOrCompute(std::move(key), [&] { return computeSimilarArtists(dbSession, artistId, linkTypes, queriedCount); })};
+	copyResults(*similarArtists, excludedIds, maxCount, results);
+}
+
+IEngine::RankedResults
+Engine::computeSimilarArtists(Database::Session& dbSession,
 		Database::IdType artistId,
 		EnumSet<Database::TrackArtistLinkType> linkTypes,
 		std::size_t maxCount)
 {
-	std::unordered_set<Database::IdType> res;
+	const Metrics::ScopedTimer timer {computeDuration};
+	RankedResults res;
+
+	const std::shared_ptr<const ClassifierSet> classifierSet {getClassifierSet()};
+	if (!classifierSet)
+		return res;
 
-	std::shared_lock lock {_classifiersMutex};
-	for (ClassifierType classifierType : _classifierPriorities)
+	for (ClassifierType classifierType : classifierSet->priorities)
 	{
-		auto itClassifier {_classifiers.find(classifierType)};
-		if (itClassifier == std::cend(_classifiers))
+		auto itClassifier {classifierSet->classifiers.find(classifierType)};
+		if (itClassifier == std::cend(classifierSet->classifiers))
 			continue;
 
 		const IClassifier& classifier {*itClassifier->second};
@@ -167,127 +253,161 @@ getRecommendationEngineType(Database::Session& session)
 	return Database::ScanSettings::get(session)->getRecommendationEngineType();
 }
 
+static
+ClassifierType
+getFeaturesClassifierType()
+{
+	const std::string algorithm {Service<IConfig>::get()->getString("recommendation-features-algorithm", "som", {"som", "nearest-neighbours"})};
+
+	return algorithm == "nearest-neighbours" ? ClassifierType::NearestNeighbours : ClassifierType::Features;
+}
+
 void
-Engine::load(bool forceReload, const ProgressCallback& progressCallback)
+Engine::load(bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback)
 {
 	using namespace Database;
 
 	LMS_LOG(RECOMMENDATION, INFO) << "Reloading recommendation engines...";
-	struct ClassifierWithType
-	{
-		ClassifierType type;
-		std::unique_ptr<IClassifier> classifier;
-	};
-
-	std::vector<ClassifierWithType> classifiers;
-	auto addClassifier {[&](ClassifierType type)
-	{
-		classifiers.emplace_back(ClassifierWithType {type, createClassifier(type)});
-	}};
+	const Metrics::ScopedTimer timer {loadDuration};
+	const SamplingProfiler::ScopedSubsystem profilerSubsystem {SamplingProfiler::Subsystem::Train};
 
+	std::vector<ClassifierType> classifierPriorities;
+	std::vector<ClassifierType> classifierLoadOrder;
 	switch (getRecommendationEngineType(_db.getTLSSession()))
 	{
 		case ScanSettings::RecommendationEngineType::Clusters:
-			setClassifierPriorities({ClassifierType::Clusters});
-			addClassifier(ClassifierType::Clusters);
+			classifierPriorities = {ClassifierType::Clusters};
+			classifierLoadOrder = {ClassifierType::Clusters};
 			break;
 		case ScanSettings::RecommendationEngineType::Features:
-			setClassifierPriorities({ClassifierType::Features, ClassifierType::Clusters});
-			// not same order since clusters is faster to load
-			addClassifier(ClassifierType::Clusters);
-			addClassifier(ClassifierType::Features);
+		{
+			const ClassifierType featuresClassifierType {getFeaturesClassifierType()};
+			classifierPriorities = {featuresClassifierType, ClassifierType::Clusters};
+			// not same order since clusters is faster to load (matters if loaded sequentially)
+			classifierLoadOrder = {ClassifierType::Clusters, featuresClassifierType};
 			break;
+		}
 	}
 
-	assert(_pendingClassifiers.empty());
-	clearClassifiers();
+	std::unordered_map<ClassifierType, std::shared_ptr<IClassifier>> classifiers;
+	for (ClassifierType type : classifierLoadOrder)
+		classifiers.emplace(type, createClassifier(type));
 
-	{
-		std::scoped_lock lock {_controlMutex};
+	// New classifiers are published as soon as they are loaded
+	// Meanwhile, the previous ones are still used to serve queries
+	const std::shared_ptr<const ClassifierSet> previousClassifierSet {getClassifierSet()};
 
-		std::transform(std::cbegin(classifiers), std::cend(classifiers), std::inserter(_pendingClassifiers, std::end(_pendingClassifiers)),
-				[](auto& classifier) { return classifier.classifier.get(); });
+	ClassifierSet classifierSet;
+	classifierSet.priorities = classifierPriorities;
+	if (previousClassifierSet)
+	{
+		for (const auto& [type, classifier] : previousClassifierSet->classifiers)
+		{
+			if (classifiers.find(type) != std::cend(classifiers))
+				classifierSet.classifiers.emplace(type, classifier);
+		}
 	}
 
-	for (ClassifierWithType& classifier : classifiers)
-		loadClassifier(std::move(classifier.classifier), classifier.type, forceReload, progressCallback);
+	// Classifiers do not depend on each other: load them concurrently, each one being published as soon as it is ready
+	// (the clusters one is quick to load, whereas the features one may have to be trained first)
+	std::mutex loadMutex;	// protects classifierSet, loadCancelled and progress reports
+	bool loadCancelled {};
 
-	LMS_LOG(RECOMMENDATION, INFO) << "Recommendation engines loaded!";
-}
+	auto progress {[&](const Progress& progress)
+	{
+		std::scoped_lock lock {loadMutex};
+		progressCallback(progress);
+	}};
 
-void
-Engine::setClassifierPriorities(const std::vector<ClassifierType>& classifierPriorities)
-{
-	std::unique_lock<std::shared_mutex> lock {_classifiersMutex};
+	auto loadClassifierAt {[&](std::size_t index)
+	{
+		const ClassifierType type {classifierLoadOrder[index]};
+		const std::shared_ptr<IClassifier>& classifier {classifiers.at(type)};
 
-	_classifierPriorities = classifierPriorities;
-}
+		bool res {};
+		try
+		{
+			res = loadClassifier(*classifier, forceReload, cancellation, progressCallback ? progress : ProgressCallback {});
+		}
+		catch (const std::exception& e)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot load classifier '" << classifier->getName() << "': " << e.what();
+		}
 
-void
-Engine::clearClassifiers()
-{
-	std::unique_lock lock {_classifiersMutex};
+		std::scoped_lock lock {loadMutex};
 
-	_classifiers.clear();
-}
+		if (res)
+			classifierSet.classifiers[type] = classifier;
+		else if (!cancellation.isCancelled())
+			classifierSet.classifiers.erase(type);
+		else
+			loadCancelled = true;
 
-void
-Engine::loadClassifier(std::unique_ptr<IClassifier> classifier,
-		ClassifierType classifierType,
-		bool forceReload,
-		const ProgressCallback& progressCallback)
-{
-	IClassifier* rawClassifier {classifier.get()};
+		publishClassifierSet(std::make_shared<ClassifierSet>(classifierSet));
+	}};
 
-	bool res {};
-	if (!_loadCancelled)
+	if (Scheduler* scheduler {Service<Scheduler>::get()})
+	{
+		// Do not pass the cancellation token: each classifier has to report its own state
+		scheduler->parallelFor(Scheduler::TaskClass::Cpu, Scheduler::Priority::Normal, CancellationToken {}, classifierLoadOrder.size(), loadClassifierAt, classifierLoadOrder.size());
+	}
+	else
 	{
-		LMS_LOG(RECOMMENDATION, INFO) << "Initializing classifier '" << classifier->getName() << "'...";
+		for (std::size_t i {}; i < classifierLoadOrder.size(); ++i)
+			loadClassifierAt(i);
+	}
 
-		auto progress {[&](IClassifier::Progress progress)
-		{
-			progressCallback(Progress {progress.processedElems, progress.totalElems});
-		}};
+	if (loadCancelled)
+		LMS_LOG(RECOMMENDATION, INFO) << "Recommendation engines loading cancelled, keeping previous engines";
+	else
+		LMS_LOG(RECOMMENDATION, INFO) << "Recommendation engines loaded!";
+}
 
-		res = classifier->load(_db.getTLSSession(), forceReload, progressCallback ? progress : IClassifier::ProgressCallback {});
+std::shared_ptr<const Engine::ClassifierSet>
+Engine::getClassifierSet() const
+{
+	std::scoped_lock lock {_classifierSetMutex};
 
-		LMS_LOG(RECOMMENDATION, INFO) << "Initializing classifier '" << classifier->getName() << "': " << (res ? "SUCCESS" : "FAILURE");
-	}
+	return _classifierSet;
+}
 
-	if (res)
+void
+Engine::publishClassifierSet(std::shared_ptr<const ClassifierSet> classifierSet)
+{
+	std::shared_ptr<const ClassifierSet> previousClassifierSet;
 	{
-		std::unique_lock lock {_classifiersMutex};
+		std::scoped_lock lock {_classifierSetMutex};
 
-		_classifiers.emplace(classifierType, std::move(classifier));
+		previousClassifierSet = std::exchange(_classifierSet, std::move(classifierSet));
 	}
 
-	{
-		std::scoped_lock lock {_controlMutex};
-
-		_pendingClassifiers.erase(rawClassifier);
-	}
+	_resultCache.invalidate();
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Result cache invalidated, hits = " << _resultCache.getHitCount() << ", misses = " << _resultCache.getMissCount();
 
-	_pendingClassifiersCondvar.notify_one();
+	// the previous set is released outside the lock, possibly destroying classifiers
 }
 
-void
-Engine::cancelLoad()
+bool
+Engine::loadClassifier(IClassifier& classifier,
+		bool forceReload,
+		const CancellationToken& cancellation,
+		const ProgressCallback& progressCallback)
 {
-	LMS_LOG(RECOMMENDATION, DEBUG) << "Cancelling loading...";
-
-	std::unique_lock lock {_controlMutex};
+	if (cancellation.isCancelled())
+		return false;
 
-	LMS_LOG(RECOMMENDATION, DEBUG) << "Still " <<  _pendingClassifiers.size() << " pending classifiers!";
+	LMS_LOG(RECOMMENDATION, INFO) << "Initializing classifier '" << classifier.getName() << "'...";
 
-	_loadCancelled = true;
+	auto progress {[&](IClassifier::Progress progress)
+	{
+		progressCallback(Progress {progress.processedElems, progress.totalElems});
+	}};
 
-	for (IClassifier* classifier : _pendingClassifiers)
-		classifier->requestCancelLoad();
+	const bool res {classifier.load(_db.getTLSSession(), forceReload, cancellation, progressCallback ? progress : IClassifier::ProgressCallback {})};
 
-    _pendingClassifiersCondvar.wait(lock, [this] {return _pendingClassifiers.empty();});
-	_loadCancelled = false;
+	LMS_LOG(RECOMMENDATION, INFO) << "Initializing classifier '" << classifier.getName() << "': " << (res ? "SUCCESS" : "FAILURE");
 
-	LMS_LOG(RECOMMENDATION, DEBUG) << "Cancelling loading DONE";
+	return res;
 }
 
 } // ns Similarity
@@ -19,14 +19,16 @@
 
 #pragma once
 
-#include <condition_variable>
-#include <shared_mutex>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "recommendation/IEngine.hpp"
+#include "utils/ProfiledMutex.hpp"
 #include "IClassifier.hpp"
+#include "ResultCache.hpp"
 
 namespace Database
 {
@@ -39,6 +41,7 @@ namespace Recommendation
 	{
 		Clusters,
 		Features,
+		NearestNeighbours,
 	};
 
 	class Engine : public IEngine
@@ -53,33 +56,44 @@ namespace Recommendation
 			Engine& operator=(Engine&&) = delete;
 
 		private:
-			void	load(bool forceReload, const ProgressCallback& progressCallback) override;
-			void	cancelLoad() override;
+			void	load(bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback) override;
 
-			ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) override;
-			ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) override;
-			ResultContainer getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) override;
-			ResultContainer getSimilarArtists(Database::Session& session,
+			void getRankedSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds) override;
+			void getRankedSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds) override;
+			void getRankedSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds) override;
+			void getRankedSimilarArtists(Database::Session& session,
 					Database::IdType artistId,
 					EnumSet<Database::TrackArtistLinkType> linkTypes,
-					std::size_t maxCount) override;
+					std::size_t maxCount,
+					RankedResults& results,
+					const std::unordered_set<Database::IdType>& excludedIds) override;
 
-			void setClassifierPriorities(const std::vector<ClassifierType>& classifierTypes);
-			void clearClassifiers();
-			void loadClassifier(std::unique_ptr<IClassifier> classifier, ClassifierType classifierType, bool forceReload, const ProgressCallback& progressCallback);
+			RankedResults computeSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount);
+			RankedResults computeSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount);
+			RankedResults computeSimilarArtists(Database::Session& session,
+					Database::IdType artistId,
+					EnumSet<Database::TrackArtistLinkType> linkTypes,
+					std::size_t maxCount);
 
-			Database::Db&				_db;
+			// Set of loaded classifiers, never modified once published
+			struct ClassifierSet
+			{
+				std::unordered_map<ClassifierType, std::shared_ptr<IClassifier>> classifiers;
+				std::vector<ClassifierType>	priorities; // ordered by priority
+			};
 
-			std::mutex							_controlMutex;
-			bool								_loadCancelled {};
-			std::condition_variable 			_pendingClassifiersCondvar;
-			std::unordered_set<IClassifier*>	_pendingClassifiers;
+			std::shared_ptr<const ClassifierSet> getClassifierSet() const;
+			void publishClassifierSet(std::shared_ptr<const ClassifierSet> classifierSet);
+			bool loadClassifier(IClassifier& classifier, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback);
+
+			Database::Db&				_db;
 
-			std::shared_mutex			_classifiersMutex;
-			using ClassifierContainer = std::unordered_map<ClassifierType, std::unique_ptr<IClassifier>>;
-			ClassifierContainer			_classifiers;
-			std::vector<ClassifierType>	_classifierPriorities; // ordered by priority
+			// Queries keep using the previous set while a new one is being loaded
+			mutable ProfiledMutex					_classifierSetMutex {"recommendation_classifiers"};	// only held to copy or replace the pointer
+			std::shared_ptr<const ClassifierSet>	_classifierSet;
 
+			// Similarity results, for the current classifier set
+			ResultCache							_resultCache;
 	};
 
 } // ns Recommendation
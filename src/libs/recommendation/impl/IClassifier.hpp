@@ -19,11 +19,15 @@
 
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <string_view>
 #include <unordered_set>
+#include <vector>
 
 #include "database/Types.hpp"
+#include "recommendation/IEngine.hpp"
+#include "utils/CancellationToken.hpp"
 #include "utils/EnumSet.hpp"
 
 namespace Database
@@ -47,10 +51,11 @@ namespace Recommendation
 				std::size_t	processedElems {};
 			};
 			using ProgressCallback = std::function<void(const Progress&)>;
-			virtual bool load(Database::Session& session, bool forceReload, const ProgressCallback& progressCallback) = 0;
-			virtual void requestCancelLoad() = 0;
+			// Returns false on failure or if cancelled
+			virtual bool load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback) = 0;
 
-			using ResultContainer = std::unordered_set<Database::IdType>;
+			// Ordered by decreasing score, without the queried ids
+			using ResultContainer = IEngine::RankedResults;
 
 			virtual ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const = 0;
 			virtual ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) const = 0;
@@ -60,4 +65,19 @@ namespace Recommendation
 					EnumSet<Database::TrackArtistLinkType> linkTypes, std::size_t maxCount) const = 0;
 	};
 
+	// Score of the object at the given rank, for results that are only ordered
+	inline float getRankScore(std::size_t rank)
+	{
+		return 1.f / (1 + rank);
+	}
+
+	inline IClassifier::ResultContainer toRankedResults(const std::vector<Database::IdType>& orderedIds)
+	{
+		IClassifier::ResultContainer res;
+		res.reserve(orderedIds.size());
+		for (std::size_t rank {}; rank < orderedIds.size(); ++rank)
+			res.push_back({orderedIds[rank], getRankScore(rank)});
+		return res;
+	}
+
 } // ns Recommendation
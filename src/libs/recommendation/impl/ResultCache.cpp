@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ResultCache.hpp"
+
+#include <tuple>
+
+namespace Recommendation
+{
+	bool
+	ResultCache::Key::operator<(const Key& other) const
+	{
+		return std::tie(type, ids, linkTypes, maxCount) < std::tie(other.type, other.ids, other.linkTypes, other.maxCount);
+	}
+
+	ResultCache::ResultCache(std::size_t maxEntryCount)
+	: _maxEntryCount {maxEntryCount}
+	{
+	}
+
+	ResultCache::Results
+	ResultCache::getOrCompute(Key key, const std::function<IEngine::RankedResults()>& compute)
+	{
+		if (_maxEntryCount == 0)
+			return std::make_shared<const IEngine::RankedResults>(compute());
+
+		std::size_t generation;
+		{
+			std::scoped_lock lock {_mutex};
+
+			auto itEntry {_entriesByKey.find(key)};
+			if (itEntry != std::cend(_entriesByKey))
+			{
+				_hitCount++;
+				_entries.splice(std::begin(_entries), _entries, itEntry->second);
+				return itEntry->second->second;
+			}
+
+			_missCount++;
+			generation = _generation;
+		}
+
+		Results res {std::make_shared<const IEngine::RankedResults>(compute())};
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			// Results computed using invalidated classifiers must not be cached
+			if (generation != _generation || _entriesByKey.find(key) != std::cend(_entriesByKey))
+				return res;
+
+			_entries.emplace_front(key, res);
+			_entriesByKey.emplace(std::move(key), std::begin(_entries));
+
+			if (_entries.size() > _maxEntryCount)
+			{
+				_entriesByKey.erase(_entries.back().first);
+				_entries.pop_back();
+			}
+		}
+
+		return res;
+	}
+
+	void
+	ResultCache::invalidate()
+	{
+		std::scoped_lock lock {_mutex};
+
+		_generation++;
+		_entriesByKey.clear();
+		_entries.clear();
+	}
+
+	std::size_t
+	ResultCache::getHitCount() const
+	{
+		std::scoped_lock lock {_mutex};
+		return _hitCount;
+	}
+
+	std::size_t
+	ResultCache::getMissCount() const
+	{
+		std::scoped_lock lock {_mutex};
+		return _missCount;
+	}
+} // ns Recommendation
+
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "recommendation/IEngine.hpp"
+
+namespace Recommendation
+{
+	// Bounded cache of the similarity query results, least recently used entries are evicted first
+	// Must be invalidated each time the classifiers change
+	class ResultCache
+	{
+		public:
+			enum class QueryType
+			{
+				SimilarTracks,
+				SimilarReleases,
+				SimilarArtists,
+			};
+
+			struct Key
+			{
+				QueryType					type;
+				std::set<Database::IdType>	ids;
+				std::uint32_t				linkTypes {};	// bitfield of TrackArtistLinkType, only for artists
+				std::size_t					maxCount {};
+
+				bool operator<(const Key& other) const;
+			};
+
+			// 0 means disabled
+			ResultCache(std::size_t maxEntryCount);
+
+			ResultCache(const ResultCache&) = delete;
+			ResultCache(ResultCache&&) = delete;
+			ResultCache& operator=(const ResultCache&) = delete;
+			ResultCache& operator=(ResultCache&&) = delete;
+
+			// compute is called without holding the lock
+			using Results = std::shared_ptr<const IEngine::RankedResults>;
+			Results getOrCompute(Key key, const std::function<IEngine::RankedResults()>& compute);
+			void invalidate();
+
+			std::size_t getHitCount() const;
+			std::size_t getMissCount() const;
+
+		private:
+			using Entry = std::pair<Key, Results>;
+			using EntryList = std::list<Entry>;	// most recently used first
+
+			const std::size_t _maxEntryCount;
+
+			mutable std::mutex _mutex;
+			std::size_t _generation {};
+			EntryList _entries;
+			std::map<Key, EntryList::iterator> _entriesByKey;
+			std::size_t _hitCount {};
+			std::size_t _missCount {};
+	};
+} // ns Recommendation
+
@@ -19,88 +19,334 @@
 
 #include "ClustersClassifier.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <unordered_set>
+
 #include "database/Artist.hpp"
 #include "database/Cluster.hpp"
 #include "database/Release.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/TrackList.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+#include "utils/Scheduler.hpp"
+#include "utils/Service.hpp"
 
 namespace Recommendation {
 
+namespace {
+
+	// Similar releases and artists are precomputed up to this count, bigger requests are handled using SQL queries
+	constexpr std::size_t maxPrecomputedSimilarCount {50};
+
+	// Similar artists are only precomputed for the link types the UI and the Subsonic API use
+	const EnumSet<Database::TrackArtistLinkType> precomputedArtistLinkTypes {Database::TrackArtistLinkType::Artist, Database::TrackArtistLinkType::ReleaseArtist};
+
+	using EntityLinks = std::vector<std::pair<Database::IdType, Database::IdType>>; // (track id, entity id) pairs, one per link
+	using SimilarEntities = std::vector<std::pair<Database::IdType, std::vector<Database::IdType>>>;
+
+	// Same scores as the SQL queries: the clusters of an entity are those of the tracks in sourceLinks,
+	// and the score of another entity is the number of (link in candidateLinks, shared cluster) pairs
+	// Entities are densely indexed so that each chunk scores the candidates using plain vectors
+	std::optional<SimilarEntities>
+	computeSimilarEntities(const EntityLinks& sourceLinks,
+			const EntityLinks& candidateLinks,
+			const std::unordered_map<Database::IdType, std::vector<Database::IdType>>& clustersByTrack,
+			const CancellationToken& cancellation)
+	{
+		std::unordered_map<Database::IdType, std::uint32_t> indexByEntity;
+		std::vector<Database::IdType> entities;
+		auto getEntityIndex {[&](Database::IdType entityId)
+		{
+			auto [it, inserted] {indexByEntity.try_emplace(entityId, static_cast<std::uint32_t>(entities.size()))};
+			if (inserted)
+				entities.push_back(entityId);
+			return it->second;
+		}};
+
+		std::unordered_map<Database::IdType, std::unordered_map<std::uint32_t, std::uint32_t>> candidateCountsByClusterMap;
+		for (const auto& [trackId, entityId] : candidateLinks)
+		{
+			auto itClusters {clustersByTrack.find(trackId)};
+			if (itClusters == std::cend(clustersByTrack))
+				continue;
+
+			const std::uint32_t entityIndex {getEntityIndex(entityId)};
+			for (const Database::IdType clusterId : itClusters->second)
+				candidateCountsByClusterMap[clusterId][entityIndex]++;
+		}
+
+		std::unordered_map<Database::IdType, std::vector<std::pair<std::uint32_t, std::uint32_t>>> candidateCountsByCluster;
+		for (const auto& [clusterId, counts] : candidateCountsByClusterMap)
+			candidateCountsByCluster.emplace(clusterId, std::vector<std::pair<std::uint32_t, std::uint32_t>>(std::cbegin(counts), std::cend(counts)));
+		candidateCountsByClusterMap.clear();
+
+		std::vector<std::vector<const std::vector<std::pair<std::uint32_t, std::uint32_t>>*>> clustersByEntity;
+		{
+			std::unordered_map<std::uint32_t, std::unordered_set<Database::IdType>> clusterIdsByEntity;
+			for (const auto& [trackId, entityId] : sourceLinks)
+			{
+				auto itClusters {clustersByTrack.find(trackId)};
+				if (itClusters != std::cend(clustersByTrack))
+					clusterIdsByEntity[getEntityIndex(entityId)].insert(std::cbegin(itClusters->second), std::cend(itClusters->second));
+			}
+
+			clustersByEntity.resize(entities.size());
+			for (const auto& [entityIndex, clusterIds] : clusterIdsByEntity)
+			{
+				for (const Database::IdType clusterId : clusterIds)
+				{
+					if (auto itCounts {candidateCountsByCluster.find(clusterId)}; itCounts != std::cend(candidateCountsByCluster))
+						clustersByEntity[entityIndex].push_back(&itCounts->second);
+				}
+			}
+		}
+
+		std::vector<std::vector<Database::IdType>> similarEntities(entities.size());
+
+		constexpr std::size_t chunkSize {256};
+		const std::size_t chunkCount {(entities.size() + chunkSize - 1) / chunkSize};
+		auto processChunk {[&](std::size_t chunk)
+		{
+			std::vector<std::uint32_t> scores(entities.size());
+			std::vector<std::uint32_t> candidates;
+
+			for (std::size_t entityIndex {chunk * chunkSize}; entityIndex < std::min(entities.size(), (chunk + 1) * chunkSize); ++entityIndex)
+			{
+				for (const auto* candidateCounts : clustersByEntity[entityIndex])
+				{
+					for (const auto& [candidateIndex, count] : *candidateCounts)
+					{
+						if (candidateIndex == entityIndex)
+							continue;
+
+						if (scores[candidateIndex] == 0)
+							candidates.push_back(candidateIndex);
+						scores[candidateIndex] += count;
+					}
+				}
+
+				Random::shuffleContainer(candidates);
+
+				const std::size_t count {std::min(maxPrecomputedSimilarCount, candidates.size())};
+				std::partial_sort(std::begin(candidates), std::next(std::begin(candidates), count), std::end(candidates),
+						[&](std::uint32_t a, std::uint32_t b) { return scores[a] > scores[b]; });
+
+				similarEntities[entityIndex].reserve(count);
+				std::transform(std::cbegin(candidates), std::next(std::cbegin(candidates), count), std::back_inserter(similarEntities[entityIndex]),
+						[&](std::uint32_t candidateIndex) { return entities[candidateIndex]; });
+
+				for (const std::uint32_t candidateIndex : candidates)
+					scores[candidateIndex] = 0;
+				candidates.clear();
+			}
+		}};
+
+		if (Scheduler* scheduler {Service<Scheduler>::get()})
+		{
+			if (!scheduler->parallelFor(Scheduler::TaskClass::Cpu, Scheduler::Priority::Normal, cancellation, chunkCount, processChunk))
+				return std::nullopt;
+		}
+		else
+		{
+			for (std::size_t chunk {}; chunk < chunkCount; ++chunk)
+			{
+				if (cancellation.isCancelled())
+					return std::nullopt;
+				processChunk(chunk);
+			}
+		}
+
+		SimilarEntities res;
+		res.reserve(entities.size());
+		for (std::size_t entityIndex {}; entityIndex < entities.size(); ++entityIndex)
+		{
+			if (!similarEntities[entityIndex].empty())
+				res.emplace_back(entities[entityIndex], std::move(similarEntities[entityIndex]));
+		}
+
+		return res;
+	}
+
+} // namespace
+
 std::unique_ptr<IClassifier> createClustersClassifier()
 {
 	return std::make_unique<ClusterClassifier>();
 }
 
-std::unordered_set<Database::IdType>
-ClusterClassifier::getSimilarTracks(Database::Session& dbSession, const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const
+bool
+ClusterClassifier::load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback&)
 {
-	auto transaction {dbSession.createSharedTransaction()};
+	std::vector<std::pair<Database::IdType, Database::IdType>> links;
+	{
+		auto transaction {session.createSharedTransaction()};
 
-	const auto tracks {Database::Track::getSimilarTracks(dbSession, trackIds, 0, maxCount)};
+		links = Database::Track::getAllClusterLinks(session);
+	}
 
-	std::unordered_set<Database::IdType> res;
-	std::transform(std::cbegin(tracks), std::cend(tracks), std::inserter(res, std::end(res)),
-			[](const auto& track) { return track.id(); });
-	return res;
+	for (const auto& [trackId, clusterId] : links)
+	{
+		if (cancellation.isCancelled())
+			return false;
+
+		_tracksByCluster[clusterId].push_back(trackId);
+		_clustersByTrack[trackId].push_back(clusterId);
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Indexed " << links.size() << " track/cluster links, " << _clustersByTrack.size() << " tracks, " << _tracksByCluster.size() << " clusters";
+
+	return precomputeSimilarities(session, forceReload, cancellation);
 }
 
-std::unordered_set<Database::IdType>
-ClusterClassifier::getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const
+bool
+ClusterClassifier::precomputeSimilarities(Database::Session& session, bool forceReload, const CancellationToken& cancellation) const
 {
-	std::unordered_set<Database::IdType> res;
+	EntityLinks releaseLinks;
+	EntityLinks artistLinks;
+	EntityLinks precomputedArtistLinks;
+	{
+		auto transaction {session.createSharedTransaction()};
 
-	auto transaction {session.createSharedTransaction()};
+		// Nothing changed since the last computation
+		if (!forceReload && Database::Release::hasPrecomputedSimilarReleases(session) && Database::Artist::hasPrecomputedSimilarArtists(session))
+			return true;
 
-	const Database::TrackList::pointer trackList {Database::TrackList::getById(session, tracklistId)};
-	if (!trackList)
-		return res;
+		releaseLinks = Database::Track::getAllReleaseLinks(session);
+		artistLinks = Database::Track::getAllArtistLinks(session);
+		precomputedArtistLinks = Database::Track::getAllArtistLinks(session, precomputedArtistLinkTypes);
+	}
 
-	const auto tracks {trackList->getSimilarTracks(0, maxCount)};
-	std::transform(std::cbegin(tracks), std::cend(tracks), std::inserter(res, std::end(res)),
-			[](const Database::Track::pointer& track) { return track.id(); });
+	const auto similarReleases {computeSimilarEntities(releaseLinks, releaseLinks, _clustersByTrack, cancellation)};
+	if (!similarReleases)
+		return false;
+
+	const auto similarArtists {computeSimilarEntities(artistLinks, precomputedArtistLinks, _clustersByTrack, cancellation)};
+	if (!similarArtists)
+		return false;
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		Database::Release::setPrecomputedSimilarReleases(session, *similarReleases);
+		Database::Artist::setPrecomputedSimilarArtists(session, *similarArtists);
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Precomputed similar entities for " << similarReleases->size() << " releases and " << similarArtists->size() << " artists";
+
+	return true;
+}
+
+IClassifier::ResultContainer
+ClusterClassifier::getSimilarTracksFromIndex(const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const
+{
+	std::unordered_set<Database::IdType> clusterIds;
+	for (const Database::IdType trackId : trackIds)
+	{
+		if (auto itClusters {_clustersByTrack.find(trackId)}; itClusters != std::cend(_clustersByTrack))
+			clusterIds.insert(std::cbegin(itClusters->second), std::cend(itClusters->second));
+	}
+
+	// Score = number of clusters shared with the given tracks
+	std::unordered_map<Database::IdType, std::size_t> scores;
+	for (const Database::IdType clusterId : clusterIds)
+	{
+		auto itTracks {_tracksByCluster.find(clusterId)};
+		if (itTracks == std::cend(_tracksByCluster))
+			continue;
+
+		for (const Database::IdType trackId : itTracks->second)
+		{
+			if (trackIds.find(trackId) == std::cend(trackIds))
+				scores[trackId]++;
+		}
+	}
+
+	std::vector<std::pair<Database::IdType, std::size_t>> candidates(std::cbegin(scores), std::cend(scores));
+	Random::shuffleContainer(candidates);
+
+	const std::size_t count {std::min(maxCount, candidates.size())};
+	std::partial_sort(std::begin(candidates), std::next(std::begin(candidates), count), std::end(candidates),
+			[](const auto& a, const auto& b) { return a.second > b.second; });
+
+	// Score = ratio of the clusters of the given tracks that are shared
+	ResultContainer res;
+	res.reserve(count);
+	std::transform(std::cbegin(candidates), std::next(std::cbegin(candidates), count), std::back_inserter(res),
+			[&](const auto& candidate) { return IEngine::ScoredId {candidate.first, static_cast<float>(candidate.second) / clusterIds.size()}; });
 
 	return res;
 }
 
-std::unordered_set<Database::IdType>
-ClusterClassifier::getSimilarReleases(Database::Session& dbSession, Database::IdType releaseId, std::size_t maxCount) const
+IClassifier::ResultContainer
+ClusterClassifier::getSimilarTracks(Database::Session&, const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const
 {
-	std::unordered_set<Database::IdType> res;
+	return getSimilarTracksFromIndex(trackIds, maxCount);
+}
 
+IClassifier::ResultContainer
+ClusterClassifier::getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const
+{
+	std::unordered_set<Database::IdType> trackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::TrackList::pointer trackList {Database::TrackList::getById(session, tracklistId)};
+		if (!trackList)
+			return {};
+
+		const auto tracklistTrackIds {trackList->getTrackIds()};
+		trackIds.insert(std::cbegin(tracklistTrackIds), std::cend(tracklistTrackIds));
+	}
+
+	return getSimilarTracksFromIndex(trackIds, maxCount);
+}
+
+IClassifier::ResultContainer
+ClusterClassifier::getSimilarReleases(Database::Session& dbSession, Database::IdType releaseId, std::size_t maxCount) const
+{
 	auto transaction {dbSession.createSharedTransaction()};
 
+	if (maxCount <= maxPrecomputedSimilarCount)
+		return toRankedResults(Database::Release::getPrecomputedSimilarReleaseIds(dbSession, releaseId, maxCount));
+
 	auto release {Database::Release::getById(dbSession, releaseId)};
 	if (!release)
-		return res;
+		return {};
 
+	std::vector<Database::IdType> similarReleaseIds;
 	const auto releases {release->getSimilarReleases(0, maxCount)};
-	std::transform(std::cbegin(releases), std::cend(releases), std::inserter(res, std::end(res)),
+	std::transform(std::cbegin(releases), std::cend(releases), std::back_inserter(similarReleaseIds),
 			[](const auto& release) { return release.id(); });
 
-	return res;
+	return toRankedResults(similarReleaseIds);
 }
 
-std::unordered_set<Database::IdType>
+IClassifier::ResultContainer
 ClusterClassifier::getSimilarArtists(Database::Session& dbSession,
 		Database::IdType artistId,
 		EnumSet<Database::TrackArtistLinkType> artistLinkTypes,
 		std::size_t maxCount) const
 {
-	std::unordered_set<Database::IdType> res;
-
 	auto transaction {dbSession.createSharedTransaction()};
 
+	if (maxCount <= maxPrecomputedSimilarCount && artistLinkTypes == precomputedArtistLinkTypes)
+		return toRankedResults(Database::Artist::getPrecomputedSimilarArtistIds(dbSession, artistId, maxCount));
+
 	auto artist {Database::Artist::getById(dbSession, artistId)};
 	if (!artist)
-		return res;
+		return {};
 
+	std::vector<Database::IdType> similarArtistIds;
 	const auto artists {artist->getSimilarArtists(artistLinkTypes, Database::Range {0, maxCount})};
-	std::transform(std::cbegin(artists), std::cend(artists), std::inserter(res, std::end(res)),
+	std::transform(std::cbegin(artists), std::cend(artists), std::back_inserter(similarArtistIds),
 			[](const auto& artist) { return artist.id(); });
 
-	return res;
+	return toRankedResults(similarArtistIds);
 }
 
 } // namespace Recommendation
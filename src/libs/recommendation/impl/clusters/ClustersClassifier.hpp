@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include "IClassifier.hpp"
 
 namespace Recommendation
@@ -37,8 +40,7 @@ namespace Recommendation
 
 			std::string_view getName() const override { return "Clusters"; }
 
-			bool load(Database::Session&, bool, const ProgressCallback&) override { return true; }
-			void requestCancelLoad() override {}
+			bool load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback) override;
 
 			ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const override;
 			ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) const override;
@@ -47,6 +49,16 @@ namespace Recommendation
 					Database::IdType artistId,
 					EnumSet<Database::TrackArtistLinkType> linkTypes,
 					std::size_t maxCount) const override;
+
+			// Fills the similar release and artist tables, unless already done and nothing changed
+			bool precomputeSimilarities(Database::Session& session, bool forceReload, const CancellationToken& cancellation) const;
+
+			// Tracks sharing the most clusters with the given tracks, ties are randomly broken
+			ResultContainer getSimilarTracksFromIndex(const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const;
+
+			// Track/cluster links, indexed both ways at load time
+			std::unordered_map<Database::IdType, std::vector<Database::IdType>> _tracksByCluster;
+			std::unordered_map<Database::IdType, std::vector<Database::IdType>> _clustersByTrack;
 };
 
 } // namespace Recommendation
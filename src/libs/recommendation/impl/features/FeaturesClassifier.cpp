@@ -19,27 +19,100 @@
 
 #include "FeaturesClassifier.hpp"
 
-#include <numeric>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "FeaturesExtraction.hpp"
 
 #include "database/Artist.hpp"
 #include "database/Release.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/TrackArtistLink.hpp"
-#include "database/TrackFeatures.hpp"
 #include "database/TrackList.hpp"
+#include "recommendation/IEngine.hpp"
 #include "som/DataNormalizer.hpp"
+#include "som/SampleMatrix.hpp"
+#include "utils/Crc32Calculator.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Random.hpp"
+#include "utils/Scheduler.hpp"
+#include "utils/Service.hpp"
 
 
 namespace Recommendation {
 
+namespace
+{
+	// Merges the lists rank by rank, so that the most similar objects of each list come first
+	// Lists are visited in random order, so that the objects of the last merged rank are randomly picked
+	// Objects are scored by their rank in the lists
+	IClassifier::ResultContainer
+	mergeSimilarObjects(std::vector<const std::vector<Database::IdType>*> similarObjectLists, const std::unordered_set<Database::IdType>& excludedIds, std::size_t maxCount)
+	{
+		IClassifier::ResultContainer res;
+		std::unordered_set<Database::IdType> resIds;
+
+		Random::shuffleContainer(similarObjectLists);
+
+		bool remainingObjects {true};
+		for (std::size_t rank {}; remainingObjects && res.size() < maxCount; ++rank)
+		{
+			remainingObjects = false;
+			for (const std::vector<Database::IdType>* similarObjectIds : similarObjectLists)
+			{
+				if (rank >= similarObjectIds->size())
+					continue;
+
+				remainingObjects = true;
+
+				const Database::IdType similarObjectId {(*similarObjectIds)[rank]};
+				if (excludedIds.find(similarObjectId) == std::cend(excludedIds) && resIds.insert(similarObjectId).second)
+					res.push_back({similarObjectId, getRankScore(rank)});
+
+				if (res.size() == maxCount)
+					break;
+			}
+		}
+
+		return res;
+	}
+
+	IClassifier::ResultContainer
+	getPrecomputedSimilarObjects(const SimilarObjects& similarObjects, const std::unordered_set<Database::IdType>& ids, std::size_t maxCount)
+	{
+		std::vector<const std::vector<Database::IdType>*> similarObjectLists;
+		for (const Database::IdType id : ids)
+		{
+			if (const auto itSimilarObjects {similarObjects.find(id)}; itSimilarObjects != std::cend(similarObjects))
+				similarObjectLists.push_back(&itSimilarObjects->second);
+		}
+
+		return mergeSimilarObjects(std::move(similarObjectLists), ids, maxCount);
+	}
+}
+
 std::unique_ptr<IClassifier> createFeaturesClassifier()
 {
 	return std::make_unique<FeaturesClassifier>();
 }
 
+std::unordered_set<std::string>
+getUsedTrackFeatureNames()
+{
+	std::unordered_set<std::string> res;
+
+	for (const auto& [featureName, featureSettings] : FeaturesClassifier::getDefaultTrainFeatureSettings())
+		res.emplace(featureName);
+
+	return res;
+}
+
 const FeatureSettingsMap&
 FeaturesClassifier::getDefaultTrainFeatureSettings()
 {
@@ -62,69 +135,20 @@ getTrackFeatureValues(FeaturesClassifier::FeaturesFetchFunc func, Database::IdTy
 	return func(trackId, featureNames);
 }
 
-static
-std::optional<FeatureValuesMap>
-getTrackFeatureValuesFromDb(Database::Session& session, Database::IdType trackId, const std::unordered_set<FeatureName>& featureNames)
-{
-	auto func = [&](Database::IdType trackId, const std::unordered_set<FeatureName>& featureNames)
-	{
-		std::optional<FeatureValuesMap> res;
-
-		auto transaction {session.createSharedTransaction()};
-
-		Database::Track::pointer track {Database::Track::getById(session, trackId)};
-		if (!track)
-			return res;
-
-		res = track->getTrackFeatures()->getFeatureValuesMap(featureNames);
-		if (res->empty())
-			res.reset();
-
-		return res;
-	};
-
-	return getTrackFeatureValues(func, trackId, featureNames);
-}
-
-static
 std::optional<SOM::InputVector>
-convertFeatureValuesMapToInputVector(const FeatureValuesMap& featureValuesMap, std::size_t nbDimensions)
+FeaturesClassifier::getTrackInputVector(Database::Session& session, Database::IdType trackId, const std::unordered_set<FeatureName>& featureNames, std::size_t nbDimensions) const
 {
-	std::size_t i {};
-	std::optional<SOM::InputVector> res {SOM::InputVector {nbDimensions}};
-	for (const auto& [featureName, values] : featureValuesMap)
-	{
-		if (values.size() != getFeatureDef(featureName).nbDimensions)
-		{
-			LMS_LOG(RECOMMENDATION, WARNING) << "Dimension mismatch for feature '" << featureName << "'. Expected " << getFeatureDef(featureName).nbDimensions << ", got " << values.size();
-			res.reset();
-			break;
-		}
-
-		for (double val : values)
-			(*res)[i++] = val;
-	}
-
-	return res;
-}
-
-static
-SOM::InputVector
-getInputVectorWeights(const FeatureSettingsMap& featureSettingsMap, std::size_t nbDimensions)
-{
-	SOM::InputVector weights {nbDimensions};
-	std::size_t index {};
-	for (const auto& [featureName, featureSettings] : featureSettingsMap)
-	{
-		const std::size_t featureNbDimensions {getFeatureDef(featureName).nbDimensions};
+	std::optional<FeatureValuesMap> featureValuesMap;
 
-		for (std::size_t i {}; i < featureNbDimensions; ++i)
-			weights[index++] = (1. / featureNbDimensions * featureSettings.weight);
-	}
+	if (_featuresFetchFunc)
+		featureValuesMap = getTrackFeatureValues(_featuresFetchFunc, trackId, featureNames);
+	else
+		featureValuesMap = getTrackFeatureValuesFromDb(session, trackId, featureNames);
 
-	assert(index == nbDimensions);
+	if (!featureValuesMap)
+		return std::nullopt;
 
-	return weights;
+	return convertFeatureValuesMapToInputVector(*featureValuesMap, nbDimensions);
 }
 
 bool
@@ -132,106 +156,225 @@ FeaturesClassifier::loadFromTraining(Database::Session& session, const TrainSett
 {
 	LMS_LOG(RECOMMENDATION, INFO) << "Constructing features classifier...";
 
-	std::unordered_set<FeatureName> featureNames;
-	std::transform(std::cbegin(trainSettings.featureSettingsMap), std::cend(trainSettings.featureSettingsMap), std::inserter(featureNames, std::begin(featureNames)),
-		[](const auto& itFeatureSetting) { return itFeatureSetting.first; });
-
-	const std::size_t nbDimensions {std::accumulate(std::cbegin(featureNames), std::cend(featureNames), std::size_t {0},
-			[](std::size_t sum, const FeatureName& featureName) { return sum + getFeatureDef(featureName).nbDimensions; })};
+	const std::unordered_set<FeatureName> featureNames {getFeatureNames(trainSettings.featureSettingsMap)};
+	const std::size_t nbDimensions {getFeaturesDimCount(featureNames)};
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Features dimension = " << nbDimensions;
 
-	std::vector<Database::IdType> trackIds;
+	// Keep the samples in a compact form, and compute the normalization factors on the fly
+	std::optional<SOM::SampleMatrix> samples;
+	if (trainSettings.samplesFile.empty())
 	{
-		auto transaction {session.createSharedTransaction()};
-
-		LMS_LOG(RECOMMENDATION, DEBUG) << "Getting Tracks with features...";
-		trackIds = Database::Track::getAllIdsWithFeatures(session);
-		LMS_LOG(RECOMMENDATION, DEBUG) << "Getting Tracks with features DONE (found " << trackIds.size() << " tracks)";
+		samples.emplace(nbDimensions);
+	}
+	else
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Using samples file '" << trainSettings.samplesFile.string() << "'";
+		samples.emplace(nbDimensions, trainSettings.samplesFile);
 	}
-
-	std::vector<SOM::InputVector> samples;
 	std::vector<Database::IdType> samplesTrackIds;
+	SOM::DataNormalizer dataNormalizer {nbDimensions};
 
-	samples.reserve(trackIds.size());
-	samplesTrackIds.reserve(trackIds.size());
+	auto addSample {[&](Database::IdType trackId, const SOM::InputVector& inputVector)
+	{
+		dataNormalizer.update(inputVector);
+		samples->append(inputVector);
+		samplesTrackIds.push_back(trackId);
+	}};
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Extracting features...";
-	for (Database::IdType trackId : trackIds)
+	if (_featuresFetchFunc)
 	{
-		if (_loadCancelled)
-			return false;
+		std::vector<Database::IdType> trackIds;
+		{
+			auto transaction {session.createSharedTransaction()};
 
-		std::optional<FeatureValuesMap> featureValuesMap;
+			LMS_LOG(RECOMMENDATION, DEBUG) << "Getting Tracks with features...";
+			trackIds = Database::Track::getAllIdsWithFeatures(session);
+			LMS_LOG(RECOMMENDATION, DEBUG) << "Getting Tracks with features DONE (found " << trackIds.size() << " tracks)";
+		}
 
-		if (_featuresFetchFunc)
-			featureValuesMap = getTrackFeatureValues(_featuresFetchFunc, trackId, featureNames);
-		else
-			featureValuesMap = getTrackFeatureValuesFromDb(session, trackId, featureNames);
+		samplesTrackIds.reserve(trackIds.size());
 
-		if (!featureValuesMap)
-			continue;
+		for (Database::IdType trackId : trackIds)
+		{
+			if (_loadCancellation.isCancelled())
+				return false;
 
-		std::optional<SOM::InputVector> inputVector {convertFeatureValuesMapToInputVector(*featureValuesMap, nbDimensions)};
-		if (!inputVector)
-			continue;
+			std::optional<SOM::InputVector> inputVector {getTrackInputVector(session, trackId, featureNames, nbDimensions)};
+			if (!inputVector)
+				continue;
 
-		samples.emplace_back(std::move(*inputVector));
-		samplesTrackIds.emplace_back(trackId);
+			addSample(trackId, *inputVector);
+		}
+	}
+	else
+	{
+		if (!visitAllTrackInputVectors(session, featureNames, nbDimensions, trainSettings.threadCount, _loadCancellation, addSample))
+			return false;
 	}
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Extracting features DONE";
 
-	if (samples.empty())
+	if (samples->isEmpty())
 	{
 		LMS_LOG(RECOMMENDATION, INFO) << "Nothing to classify!";
 		return false;
 	}
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Normalizing data...";
-	SOM::DataNormalizer dataNormalizer {nbDimensions};
+	dataNormalizer.finalize();
+	for (std::size_t i {}; i < samples->getSampleCount(); ++i)
+		dataNormalizer.normalizeData(samples->getSampleValues(i));
 
-	dataNormalizer.computeNormalizationFactors(samples);
-	for (auto& sample : samples)
-		dataNormalizer.normalizeData(sample);
+	SOM::InputVector weights {getInputVectorWeights(trainSettings.featureSettingsMap, nbDimensions)};
 
-	const SOM::Coordinate size {static_cast<SOM::Coordinate>(std::sqrt(samples.size() / trainSettings.sampleCountPerNeuron))};
-	LMS_LOG(RECOMMENDATION, INFO) << "Found " << samples.size() << " tracks, constructing a " << size << "*" << size << " network";
+	// Distances between reduced samples approximate the weighted distances between samples: use unit weights in the network
+	std::optional<SOM::DimensionReducer> dimensionReducer;
+	std::optional<SOM::SampleMatrix> reducedSamples;
+	if (trainSettings.reducedDimCount > 0 && trainSettings.reducedDimCount < nbDimensions)
+	{
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Reducing data to " << trainSettings.reducedDimCount << " dimensions...";
 
-	SOM::Network network {size, size, nbDimensions};
+		dimensionReducer.emplace(nbDimensions, trainSettings.reducedDimCount);
+		dimensionReducer->setDataWeights(weights);
+		for (std::size_t i {}; i < samples->getSampleCount(); ++i)
+			dimensionReducer->update(samples->getSampleValues(i));
+		dimensionReducer->finalize();
 
-	SOM::InputVector weights {getInputVectorWeights(trainSettings.featureSettingsMap, nbDimensions)};
+		if (trainSettings.samplesFile.empty())
+			reducedSamples.emplace(trainSettings.reducedDimCount);
+		else
+			reducedSamples.emplace(trainSettings.reducedDimCount, trainSettings.samplesFile.string() + ".reduced");
+
+		for (std::size_t i {}; i < samples->getSampleCount(); ++i)
+			reducedSamples->append(dimensionReducer->reduceData(samples->getSampleValues(i)));
+		samples.reset();
+
+		weights = SOM::InputVector {trainSettings.reducedDimCount, 1};
+
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Reducing data DONE";
+	}
+	SOM::SampleMatrix& trainSamples {reducedSamples ? *reducedSamples : *samples};
+
+	const SOM::Coordinate size {static_cast<SOM::Coordinate>(std::sqrt(trainSamples.getSampleCount() / trainSettings.sampleCountPerNeuron))};
+	LMS_LOG(RECOMMENDATION, INFO) << "Found " << trainSamples.getSampleCount() << " tracks, constructing a " << size << "*" << size << " network";
+
+	SOM::Network network {size, size, trainSamples.getInputDimCount()};
+	network.setThreadCount(trainSettings.threadCount);
 	network.setDataWeights(weights);
 
+	// Identifies the samples (and thus the normalization and the reduction) a checkpoint has been made with
+	const std::uint32_t samplesChecksum {[&]
+	{
+		Utils::Crc32Calculator crc32;
+		crc32.processBytes(reinterpret_cast<const std::byte*>(samplesTrackIds.data()), samplesTrackIds.size() * sizeof(Database::IdType));
+		for (std::size_t i {}; i < trainSamples.getSampleCount(); ++i)
+			crc32.processBytes(reinterpret_cast<const std::byte*>(trainSamples.getSampleValues(i)), trainSamples.getInputDimCount() * sizeof(SOM::InputVector::value_type));
+		return crc32.getResult();
+	}()};
+
+	std::size_t firstIteration {};
+	if (trainSettings.checkpointPeriod.count() > 0)
+	{
+		const std::optional<FeaturesTrainingCheckpoint> checkpoint {FeaturesTrainingCheckpoint::read()};
+		if (checkpoint
+			&& checkpoint->_samplesChecksum == samplesChecksum
+			&& checkpoint->_iterationCount == trainSettings.iterationCount
+			&& checkpoint->_batchTraining == trainSettings.batchTraining
+			&& checkpoint->_network.getWidth() == network.getWidth()
+			&& checkpoint->_network.getHeight() == network.getHeight()
+			&& checkpoint->_network.getInputDimCount() == network.getInputDimCount()
+			&& std::equal(std::cbegin(checkpoint->_network.getDataWeights()), std::cend(checkpoint->_network.getDataWeights()), std::cbegin(weights)))
+		{
+			LMS_LOG(RECOMMENDATION, INFO) << "Resuming training at pass " << checkpoint->_iteration << " / " << checkpoint->_iterationCount;
+
+			for (SOM::Coordinate y {}; y < network.getHeight(); ++y)
+			{
+				for (SOM::Coordinate x {}; x < network.getWidth(); ++x)
+					network.setRefVector({x, y}, checkpoint->_network.getRefVector({x, y}));
+			}
+			firstIteration = checkpoint->_iteration;
+		}
+		else if (checkpoint)
+		{
+			LMS_LOG(RECOMMENDATION, INFO) << "Training checkpoint does not match, starting over";
+		}
+	}
+
+	std::size_t currentIteration {firstIteration};
+	auto writeCheckpoint {[&]
+	{
+		FeaturesTrainingCheckpoint {network, currentIteration, trainSettings.iterationCount, trainSettings.batchTraining, samplesChecksum}.write();
+	}};
+
+	auto lastCheckpointTime {std::chrono::steady_clock::now()};
 	auto somProgressCallback{[&](const SOM::Network::CurrentIteration& iter)
 	{
+		currentIteration = iter.idIteration;
+
+		if (trainSettings.checkpointPeriod.count() > 0
+			&& currentIteration > firstIteration
+			&& std::chrono::steady_clock::now() - lastCheckpointTime >= trainSettings.checkpointPeriod)
+		{
+			writeCheckpoint();
+			lastCheckpointTime = std::chrono::steady_clock::now();
+		}
+
 		LMS_LOG(RECOMMENDATION, DEBUG) << "Current pass = " << iter.idIteration << " / " << iter.iterationCount;
-		progressCallback(Progress {iter.idIteration, iter.iterationCount});
+		if (progressCallback)
+			progressCallback(Progress {iter.idIteration, iter.iterationCount});
+	}};
+
+	const auto trainStartTime {std::chrono::steady_clock::now()};
+	bool maxDurationReached {};
+	auto requestStopCallback {[&]
+	{
+		if (_loadCancellation.isCancelled())
+			return true;
+
+		if (trainSettings.maxDuration.count() > 0 && std::chrono::steady_clock::now() - trainStartTime >= trainSettings.maxDuration)
+			maxDurationReached = true;
+
+		return maxDurationReached;
 	}};
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Training network...";
-	network.train(samples, trainSettings.iterationCount,
-			progressCallback ? somProgressCallback : SOM::Network::ProgressCallback {},
-			[this] { return _loadCancelled; });
+	if (trainSettings.batchTraining)
+		network.trainBatch(trainSamples, trainSettings.iterationCount, somProgressCallback, requestStopCallback, firstIteration);
+	else
+		network.train(trainSamples, trainSettings.iterationCount, somProgressCallback, requestStopCallback, firstIteration);
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Training network DONE";
 
-	if (_loadCancelled)
+	if (_loadCancellation.isCancelled())
+	{
+		// The ongoing pass is run again on resume
+		if (trainSettings.checkpointPeriod.count() > 0)
+			writeCheckpoint();
 		return false;
+	}
+
+	if (maxDurationReached)
+		LMS_LOG(RECOMMENDATION, INFO) << "Training duration limit reached, stopped at pass " << currentIteration << " / " << trainSettings.iterationCount;
+
+	FeaturesTrainingCheckpoint::invalidate();
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Classifying tracks...";
 	ObjectPositions trackPositions;
-	for (std::size_t i {}; i < samples.size(); ++i)
 	{
-		if (_loadCancelled)
+		const std::vector<SOM::Position> positions {network.getClosestRefVectorPositions(trainSamples)};
+		if (_loadCancellation.isCancelled())
 			return false;
 
-		const SOM::Position position {network.getClosestRefVectorPosition(samples[i])};
-
-		trackPositions[samplesTrackIds[i]].insert(position);
+		for (std::size_t i {}; i < positions.size(); ++i)
+			trackPositions[samplesTrackIds[i]].insert(positions[i]);
 	}
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Classifying tracks DONE";
 
-	return load(session, std::move(network), std::move(trackPositions));
+	_trainedTrackCount = trainSamples.getSampleCount();
+	_updatedTrackCount = 0;
+
+	return load(session, std::move(network), std::move(dataNormalizer), std::move(dimensionReducer), std::move(trackPositions));
 }
 
 bool
@@ -239,10 +382,95 @@ FeaturesClassifier::loadFromCache(Database::Session& session, const FeaturesClas
 {
 	LMS_LOG(RECOMMENDATION, INFO) << "Constructing features classifier from cache...";
 
-	return load(session, std::move(cache._network), cache._trackPositions);
+	_trainedTrackCount = cache._trainedTrackCount;
+	_updatedTrackCount = cache._updatedTrackCount;
+	_similarities = cache._similarities;
+
+	return load(session, cache._network, cache._dataNormalizer, cache._dimensionReducer, cache._trackPositions);
+}
+
+bool
+FeaturesClassifier::loadFromCacheWithUpdates(Database::Session& session, const FeaturesClassifierCache& cache, const FeatureSettingsMap& featureSettingsMap, std::size_t reducedDimCount, std::size_t maxUpdatedTrackPercent)
+{
+	LMS_LOG(RECOMMENDATION, INFO) << "Updating features classifier from cache...";
+
+	const std::unordered_set<FeatureName> featureNames {getFeatureNames(featureSettingsMap)};
+	const std::size_t nbDimensions {getFeaturesDimCount(featureNames)};
+	if (nbDimensions != cache._dataNormalizer.getInputDimCount())
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Features dimension changed, full training needed";
+		return false;
+	}
+
+	const std::size_t cacheReducedDimCount {cache._dimensionReducer ? cache._dimensionReducer->getOutputDimCount() : 0};
+	if ((reducedDimCount < nbDimensions ? reducedDimCount : 0) != cacheReducedDimCount)
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Reduced dimension changed, full training needed";
+		return false;
+	}
+
+	std::vector<Database::IdType> trackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+		trackIds = Database::Track::getAllIdsWithFeatures(session);
+	}
+
+	ObjectPositions trackPositions;
+	std::vector<Database::IdType> newTrackIds;
+	for (Database::IdType trackId : trackIds)
+	{
+		const auto itPositions {cache._trackPositions.find(trackId)};
+		if (itPositions != std::cend(cache._trackPositions))
+			trackPositions.emplace(trackId, itPositions->second);
+		else
+			newTrackIds.push_back(trackId);
+	}
+
+	const std::size_t removedTrackCount {cache._trackPositions.size() - trackPositions.size()};
+	const std::size_t updatedTrackCount {cache._updatedTrackCount + newTrackIds.size() + removedTrackCount};
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Added tracks = " << newTrackIds.size() << ", removed tracks = " << removedTrackCount << ", updated tracks since training = " << updatedTrackCount << " / " << cache._trainedTrackCount;
+
+	// Tracks the network has not been trained with make it drift from the collection
+	if (updatedTrackCount * 100 > cache._trainedTrackCount * maxUpdatedTrackPercent)
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Too many tracks changed since last training, full training needed";
+		return false;
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Classifying new tracks...";
+	SOM::SampleMatrix newTrackSamples {cache._network.getInputDimCount()};
+	std::vector<Database::IdType> newTrackSampleIds;
+	for (Database::IdType trackId : newTrackIds)
+	{
+		if (_loadCancellation.isCancelled())
+			return false;
+
+		std::optional<SOM::InputVector> inputVector {getTrackInputVector(session, trackId, featureNames, nbDimensions)};
+		if (!inputVector)
+			continue;
+
+		cache._dataNormalizer.normalizeData(*inputVector);
+		if (cache._dimensionReducer)
+			inputVector = cache._dimensionReducer->reduceData(*inputVector);
+
+		newTrackSamples.append(*inputVector);
+		newTrackSampleIds.push_back(trackId);
+	}
+
+	{
+		const std::vector<SOM::Position> positions {cache._network.getClosestRefVectorPositions(newTrackSamples)};
+		for (std::size_t i {}; i < positions.size(); ++i)
+			trackPositions[newTrackSampleIds[i]].insert(positions[i]);
+	}
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Classifying new tracks DONE";
+
+	_trainedTrackCount = cache._trainedTrackCount;
+	_updatedTrackCount = updatedTrackCount;
+
+	return load(session, cache._network, cache._dataNormalizer, cache._dimensionReducer, trackPositions);
 }
 
-std::unordered_set<Database::IdType>
+IClassifier::ResultContainer
 FeaturesClassifier::getSimilarTracksFromTrackList(Database::Session& session, Database::IdType trackListId, std::size_t maxCount) const
 {
 	const std::unordered_set<Database::IdType> trackIds {[&]
@@ -264,141 +492,267 @@ FeaturesClassifier::getSimilarTracksFromTrackList(Database::Session& session, Da
 	return getSimilarTracks(session, trackIds, maxCount);
 }
 
-std::unordered_set<Database::IdType>
+IClassifier::ResultContainer
 FeaturesClassifier::getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksIds, std::size_t maxCount) const
 {
-	auto similarTrackIds {getSimilarObjects(tracksIds, _tracksMap, _trackPositions, maxCount)};
-	if (!similarTrackIds.empty())
+	if (maxCount <= _similarities.maxCount)
+		return getPrecomputedSimilarObjects(_similarities.tracks, tracksIds, maxCount);
+
+	ResultContainer similarTracks {toRankedResults(getSimilarObjects(tracksIds, _tracks, _tracks, maxCount))};
+	if (!similarTracks.empty())
 	{
 		// Report only existing ids
 		auto transaction {session.createSharedTransaction()};
 
-		for (auto it {std::begin(similarTrackIds)}; it != std::end(similarTrackIds);)
-		{
-			const Database::IdType trackId {*it};
-			if (!Database::Track::getById(session, trackId))
-				it = similarTrackIds.erase(it);
-			else
-				it++;
-		}
+		similarTracks.erase(std::remove_if(std::begin(similarTracks), std::end(similarTracks),
+					[&](const IEngine::ScoredId& similarTrack) { return !Database::Track::getById(session, similarTrack.id); }), std::end(similarTracks));
 	}
 
-	return similarTrackIds;
+	return similarTracks;
 }
 
-std::unordered_set<Database::IdType>
+IClassifier::ResultContainer
 FeaturesClassifier::getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) const
 {
-	auto similarReleaseIds {getSimilarObjects({releaseId}, _releasesMap, _releasePositions, maxCount)};
-	if (!similarReleaseIds.empty())
+	if (maxCount <= _similarities.maxCount)
+		return getPrecomputedSimilarObjects(_similarities.releases, {releaseId}, maxCount);
+
+	ResultContainer similarReleases {toRankedResults(getSimilarObjects({releaseId}, _releases, _releases, maxCount))};
+	if (!similarReleases.empty())
 	{
 		// Report only existing ids
 		auto transaction {session.createSharedTransaction()};
 
-		for (auto it {std::begin(similarReleaseIds)}; it != std::end(similarReleaseIds);)
-		{
-			const Database::IdType similarReleaseId {*it};
-			if (!Database::Release::getById(session, similarReleaseId))
-				it = similarReleaseIds.erase(it);
-			else
-				it++;
-		}
+		similarReleases.erase(std::remove_if(std::begin(similarReleases), std::end(similarReleases),
+					[&](const IEngine::ScoredId& similarRelease) { return !Database::Release::getById(session, similarRelease.id); }), std::end(similarReleases));
 	}
 
-	return similarReleaseIds;
+	return similarReleases;
 }
 
-std::unordered_set<Database::IdType>
+IClassifier::ResultContainer
 FeaturesClassifier::getSimilarArtists(Database::Session& session,
 		Database::IdType artistId,
 		EnumSet<Database::TrackArtistLinkType> linkTypes,
 		std::size_t maxCount) const
 {
+	if (maxCount <= _similarities.maxCount)
+	{
+		std::vector<const std::vector<Database::IdType>*> similarArtistLists;
+		for (Database::TrackArtistLinkType linkType : linkTypes)
+		{
+			const auto itSimilarArtists {_similarities.artistsByLinkType.find(linkType)};
+			if (itSimilarArtists == std::cend(_similarities.artistsByLinkType))
+				continue;
+
+			if (const auto itSimilarArtistIds {itSimilarArtists->second.find(artistId)}; itSimilarArtistIds != std::cend(itSimilarArtists->second))
+				similarArtistLists.push_back(&itSimilarArtistIds->second);
+		}
+
+		return mergeSimilarObjects(std::move(similarArtistLists), {artistId}, maxCount);
+	}
+
 	auto getSimilarArtistIdsForLinkType {[&] (Database::TrackArtistLinkType linkType)
 	{
-		std::unordered_set<Database::IdType> similarArtistIds;
+		std::vector<Database::IdType> similarArtistIds;
 
-		const auto itArtists {_artistsMap.find(linkType)};
-		if (itArtists == std::cend(_artistsMap))
+		const auto itArtists {_artistsByLinkType.find(linkType)};
+		if (itArtists == std::cend(_artistsByLinkType))
 		{
 			return similarArtistIds;
 		}
 
-		similarArtistIds = getSimilarObjects({artistId}, itArtists->second, _artistPositions, maxCount);
+		similarArtistIds = getSimilarObjects({artistId}, itArtists->second, _artists, maxCount);
 
 		return similarArtistIds;
 	}};
 
-	std::unordered_set<Database::IdType> similarArtistIds;
-
+	std::vector<std::vector<Database::IdType>> similarArtistIdsByLinkType;
 	for (Database::TrackArtistLinkType linkType : linkTypes)
 	{
-		const auto similarArtistIdsForLinkType {getSimilarArtistIdsForLinkType(linkType)};
-		similarArtistIds.insert(std::begin(similarArtistIdsForLinkType), std::end(similarArtistIdsForLinkType));
-	}
+		std::vector<Database::IdType> similarArtistIds {getSimilarArtistIdsForLinkType(linkType)};
+		if (similarArtistIds.empty())
+			continue;
 
-	if (!similarArtistIds.empty())
-	{
 		// Report only existing ids
 		auto transaction {session.createSharedTransaction()};
 
-		for (auto it {std::begin(similarArtistIds)}; it != std::end(similarArtistIds);)
-		{
-			const Database::IdType similarArtistId {*it};
-			if (!Database::Artist::getById(session, similarArtistId))
-				it = similarArtistIds.erase(it);
-			else
-				it++;
-		}
+		similarArtistIds.erase(std::remove_if(std::begin(similarArtistIds), std::end(similarArtistIds),
+					[&](Database::IdType similarArtistId) { return !Database::Artist::getById(session, similarArtistId); }), std::end(similarArtistIds));
+		similarArtistIdsByLinkType.push_back(std::move(similarArtistIds));
 	}
 
-	while (similarArtistIds.size() > maxCount)
-		similarArtistIds.erase(Random::pickRandom(similarArtistIds));
+	std::vector<const std::vector<Database::IdType>*> similarArtistLists;
+	for (const std::vector<Database::IdType>& similarArtistIds : similarArtistIdsByLinkType)
+		similarArtistLists.push_back(&similarArtistIds);
 
-	return similarArtistIds;
+	return mergeSimilarObjects(std::move(similarArtistLists), {artistId}, maxCount);
 }
 
 FeaturesClassifierCache
 FeaturesClassifier::toCache() const
 {
-	return FeaturesClassifierCache {*_network, _trackPositions};
+	ObjectPositions trackPositions;
+	_tracks.visitLinks([&](Database::IdType trackId, const SOM::Position& position) { trackPositions[trackId].insert(position); });
+
+	FeaturesClassifierCache cache {*_network, *_dataNormalizer, std::move(trackPositions)};
+	if (_dimensionReducer)
+		cache._dimensionReducer = *_dimensionReducer;
+	cache._trainedTrackCount = _trainedTrackCount;
+	cache._updatedTrackCount = _updatedTrackCount;
+	cache._similarities = _similarities;
+
+	return cache;
+}
+
+std::optional<SimilarObjects>
+FeaturesClassifier::computeSimilarObjects(const PositionedObjects& objects, const PositionedObjects& objectPositions, std::size_t maxCount) const
+{
+	std::vector<Database::IdType> ids;
+	objectPositions.visitLinks([&](Database::IdType id, const SOM::Position&)
+	{
+		if (ids.empty() || ids.back() != id)
+			ids.push_back(id);
+	});
+
+	std::vector<std::vector<Database::IdType>> similarObjectIds(ids.size());
+	auto computeObject {[&](std::size_t i)
+	{
+		similarObjectIds[i] = getSimilarObjects({ids[i]}, objects, objectPositions, maxCount);
+	}};
+
+	if (Scheduler* scheduler {Service<Scheduler>::get()})
+	{
+		if (!scheduler->parallelFor(Scheduler::TaskClass::Cpu, Scheduler::Priority::Normal, _loadCancellation, ids.size(), computeObject))
+			return std::nullopt;
+	}
+	else
+	{
+		for (std::size_t i {}; i < ids.size(); ++i)
+		{
+			if (_loadCancellation.isCancelled())
+				return std::nullopt;
+			computeObject(i);
+		}
+	}
+
+	SimilarObjects res;
+	for (std::size_t i {}; i < ids.size(); ++i)
+	{
+		if (!similarObjectIds[i].empty())
+			res.emplace(ids[i], std::move(similarObjectIds[i]));
+	}
+
+	return res;
 }
 
 bool
-FeaturesClassifier::load(Database::Session& session, bool forceReload, const ProgressCallback& progressCallback)
+FeaturesClassifier::precomputeSimilarities(std::size_t maxCount)
 {
-	if (forceReload)
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Precomputing similar objects...";
+
+	PrecomputedSimilarities similarities;
+	similarities.maxCount = maxCount;
+
+	std::optional<SimilarObjects> similarTracks {computeSimilarObjects(_tracks, _tracks, maxCount)};
+	if (!similarTracks)
+		return false;
+	similarities.tracks = std::move(*similarTracks);
+
+	std::optional<SimilarObjects> similarReleases {computeSimilarObjects(_releases, _releases, maxCount)};
+	if (!similarReleases)
+		return false;
+	similarities.releases = std::move(*similarReleases);
+
+	for (const auto& [linkType, artists] : _artistsByLinkType)
+	{
+		std::optional<SimilarObjects> similarArtists {computeSimilarObjects(artists, _artists, maxCount)};
+		if (!similarArtists)
+			return false;
+		similarities.artistsByLinkType.emplace(linkType, std::move(*similarArtists));
+	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Precomputing similar objects DONE (" << similarities.tracks.size() << " tracks, " << similarities.releases.size() << " releases)";
+
+	_similarities = std::move(similarities);
+
+	return true;
+}
+
+bool
+FeaturesClassifier::load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback)
+{
+	_loadCancellation = cancellation;
+
+	const FeatureSettingsMap& featureSettingsMap {getDefaultTrainFeatureSettings()};
+	const std::size_t reducedDimCount {Service<IConfig>::get()->getULong("recommendation-features-reduced-dim-count", 0)};
 
+	// Similarities are kept in the cache, so that they are only computed again when the network or the setting changes
+	const std::size_t precomputedSimilarCount {Service<IConfig>::get()->getULong("recommendation-features-precomputed-similar-count", 0)};
+	auto updateSimilarities {[&](bool cacheUpToDate)
+	{
+		if (_similarities.maxCount != precomputedSimilarCount)
+		{
+			_similarities = {};
+			if (precomputedSimilarCount > 0 && !precomputeSimilarities(precomputedSimilarCount))
+				return false;
+
+			cacheUpToDate = false;
+		}
+
+		if (!cacheUpToDate)
+			toCache().write();
+
+		return true;
+	}};
+
+	if (forceReload)
 	{
+		// Try to avoid a full training if only a few tracks changed
+		const std::size_t maxUpdatedTrackPercent {Service<IConfig>::get()->getULong("recommendation-features-retrain-threshold", 10)};
+		const std::optional<FeaturesClassifierCache> cache {maxUpdatedTrackPercent > 0 ? FeaturesClassifierCache::read() : std::nullopt};
+		if (cache && loadFromCacheWithUpdates(session, *cache, featureSettingsMap, reducedDimCount, maxUpdatedTrackPercent))
+			return updateSimilarities(false);
+
 		FeaturesClassifierCache::invalidate();
 	}
 	else
 	{
 		const std::optional<FeaturesClassifierCache> cache {FeaturesClassifierCache::read()};
 		if (cache)
-			return loadFromCache(session, *cache);
+			return loadFromCache(session, *cache) && updateSimilarities(true);
 	}
 
-	TrainSettings trainSettings;
-	trainSettings.featureSettingsMap = getDefaultTrainFeatureSettings();
+	if (_loadCancellation.isCancelled())
+		return false;
 
-	const bool res {loadFromTraining(session, trainSettings, progressCallback)};
-	if (res)
-		toCache().write();
+	TrainSettings trainSettings;
+	trainSettings.featureSettingsMap = featureSettingsMap;
+	trainSettings.threadCount = getFeaturesThreadCount();
+	trainSettings.batchTraining = Service<IConfig>::get()->getBool("recommendation-features-batch-training", false);
+	trainSettings.reducedDimCount = reducedDimCount;
+	trainSettings.checkpointPeriod = std::chrono::seconds {Service<IConfig>::get()->getULong("recommendation-features-train-checkpoint-period", 600)};
+	trainSettings.maxDuration = std::chrono::seconds {Service<IConfig>::get()->getULong("recommendation-features-train-max-duration", 0)};
+	if (Service<IConfig>::get()->getBool("recommendation-features-train-samples-file", false))
+	{
+		const std::filesystem::path samplesDirectory {Service<IConfig>::get()->getPath("working-dir") / "cache" / "features"};
 
-	return res;
-}
+		std::error_code ec;
+		std::filesystem::create_directories(samplesDirectory, ec);
+		if (ec)
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create directory '" << samplesDirectory.string() << "': " << ec.message();
+		else
+			trainSettings.samplesFile = samplesDirectory / "train-samples.bin";
+	}
 
-void
-FeaturesClassifier::requestCancelLoad()
-{
-	LMS_LOG(RECOMMENDATION, DEBUG) << "Requesting init cancellation";
-	_loadCancelled = true;
+	return loadFromTraining(session, trainSettings, progressCallback) && updateSimilarities(false);
 }
 
 bool
 FeaturesClassifier::load(Database::Session& session,
 			SOM::Network network,
+			SOM::DataNormalizer dataNormalizer,
+			std::optional<SOM::DimensionReducer> dimensionReducer,
 			const ObjectPositions& tracksPosition)
 {
 	_networkRefVectorsDistanceMedian = network.computeRefVectorsDistanceMedian();
@@ -407,135 +761,107 @@ FeaturesClassifier::load(Database::Session& session,
 	const SOM::Coordinate width {network.getWidth()};
 	const SOM::Coordinate height {network.getHeight()};
 
-	_releasesMap = MatrixOfObjects {width, height};
-	_tracksMap = MatrixOfObjects {width, height};
+	std::vector<PositionedObjects::Link> trackLinks;
+	std::vector<PositionedObjects::Link> releaseLinks;
+	std::vector<PositionedObjects::Link> artistLinks;
+	std::unordered_map<Database::TrackArtistLinkType, std::vector<PositionedObjects::Link>> artistLinksByLinkType;
 
 	LMS_LOG(RECOMMENDATION, DEBUG) << "Constructing maps...";
 
-	for (auto itTrackCoord : tracksPosition)
 	{
-		if (_loadCancelled)
-			return false;
-
+		// Relations are read by bulk queries, instead of loading each classified track
 		auto transaction {session.createSharedTransaction()};
 
-		Database::IdType trackId {itTrackCoord.first};
-		const std::unordered_set<SOM::Position>& positionSet {itTrackCoord.second};
-
-		const Database::Track::pointer track {Database::Track::getById(session, trackId)};
-		if (!track)
-			continue;
-
-		for (const SOM::Position& position : positionSet)
+		auto visitTrackPositions {[&](Database::IdType trackId, auto func)
 		{
-			_tracksMap[position].insert(trackId);
-			_trackPositions[trackId].insert(position);
-
-			if (track->getRelease())
-			{
-				_releasePositions[track->getRelease().id()].insert(position);
-				_releasesMap[position].insert(track->getRelease().id());
-			}
-			for (const auto& artistLink : track->getArtistLinks())
-			{
-				_artistPositions[artistLink->getArtist().id()].insert(position);
-				auto itArtists {_artistsMap.find(artistLink->getType())};
-				if (itArtists == std::cend(_artistsMap))
-				{
-					auto [it, inserted] = _artistsMap.try_emplace(artistLink->getType(), MatrixOfObjects {});
-					assert(inserted);
-					itArtists = it;
-					itArtists->second = MatrixOfObjects {width, height};
-				}
-				itArtists->second[position].insert(artistLink->getArtist().id());
-			}
-		}
-	}
-
-	_network = std::make_unique<SOM::Network>(std::move(network));
+			const auto itTrackPositions {tracksPosition.find(trackId)};
+			if (itTrackPositions == std::cend(tracksPosition))
+				return;
 
-	LMS_LOG(RECOMMENDATION, INFO) << "Classifier successfully loaded!";
+			for (const SOM::Position& position : itTrackPositions->second)
+				func(position);
+		}};
 
-	return true;
-}
+		// Tracks removed meanwhile are skipped
+		for (const Database::IdType trackId : Database::Track::getAllIds(session))
+			visitTrackPositions(trackId, [&](const SOM::Position& position) { trackLinks.emplace_back(trackId, position); });
 
-std::unordered_set<SOM::Position>
-FeaturesClassifier::getMatchingRefVectorsPosition(const std::unordered_set<Database::IdType>& ids, const ObjectPositions& objectPositions)
-{
-	std::unordered_set<SOM::Position> res;
+		if (_loadCancellation.isCancelled())
+			return false;
 
-	if (ids.empty())
-		return res;
+		for (const auto& [trackId, releaseId] : Database::Track::getAllReleaseLinks(session))
+			visitTrackPositions(trackId, [&, releaseId = releaseId](const SOM::Position& position) { releaseLinks.emplace_back(releaseId, position); });
 
-	for (auto id : ids)
-	{
-		auto it = objectPositions.find(id);
-		if (it == objectPositions.end())
-			continue;
+		if (_loadCancellation.isCancelled())
+			return false;
 
-		for (const auto& position : it->second)
-			res.insert(position);
+		for (const auto& [trackId, artistId, linkType] : Database::Track::getAllArtistLinksWithType(session))
+		{
+			visitTrackPositions(trackId, [&, artistId = artistId, linkType = linkType](const SOM::Position& position)
+			{
+				artistLinks.emplace_back(artistId, position);
+				artistLinksByLinkType[linkType].emplace_back(artistId, position);
+			});
+		}
 	}
 
-	return res;
-}
+	_tracks = PositionedObjects {width, height, std::move(trackLinks)};
+	_releases = PositionedObjects {width, height, std::move(releaseLinks)};
+	_artists = PositionedObjects {width, height, std::move(artistLinks)};
+	for (auto& [linkType, links] : artistLinksByLinkType)
+		_artistsByLinkType.emplace(linkType, PositionedObjects {width, height, std::move(links)});
 
-std::unordered_set<Database::IdType>
-FeaturesClassifier::getObjectsIds(const std::unordered_set<SOM::Position>& positionSet, const MatrixOfObjects& objectsMap)
-{
-	std::unordered_set<Database::IdType> res;
+	_network = std::make_unique<SOM::Network>(std::move(network));
+	_dataNormalizer = std::make_unique<SOM::DataNormalizer>(std::move(dataNormalizer));
+	if (dimensionReducer)
+		_dimensionReducer = std::make_unique<SOM::DimensionReducer>(std::move(*dimensionReducer));
 
-	for (const auto& position : positionSet)
-	{
-		for (auto id : objectsMap.get(position))
-			res.insert(id);
-	}
+	LMS_LOG(RECOMMENDATION, INFO) << "Classifier successfully loaded!";
 
-	return res;
+	return true;
 }
 
-std::unordered_set<Database::IdType>
+std::vector<Database::IdType>
 FeaturesClassifier::getSimilarObjects(const std::unordered_set<Database::IdType>& ids,
-		const MatrixOfObjects& objectsMap,
-		const ObjectPositions& objectPosition,
+		const PositionedObjects& objects,
+		const PositionedObjects& objectPositions,
 		std::size_t maxCount) const
 {
-	std::unordered_set<Database::IdType> res;
+	std::vector<Database::IdType> res;
+	std::unordered_set<Database::IdType> resIds;
+
+	std::unordered_set<SOM::Position> searchedRefVectorsPosition;
+	for (Database::IdType id : ids)
+		objectPositions.visitPositions(id, [&](const SOM::Position& position) { searchedRefVectorsPosition.insert(position); });
 
-	std::unordered_set<SOM::Position> searchedRefVectorsPosition {getMatchingRefVectorsPosition(ids, objectPosition)};
 	if (searchedRefVectorsPosition.empty())
 		return res;
 
-	while (1)
+	// Report objects that are not in input
+	auto addObjects {[&](const SOM::Position& position)
 	{
-		std::unordered_set<Database::IdType> closestObjectIds {getObjectsIds(searchedRefVectorsPosition, objectsMap)};
-
-		// Remove objects that are already in input or already reported
-		for (auto id : ids)
-			closestObjectIds.erase(id);
-
-		for (auto it {std::cbegin(closestObjectIds)}; it != std::cend(closestObjectIds); ++it)
+		objects.visitObjects(position, [&](Database::IdType id)
 		{
-			if (res.size() == maxCount)
-				break;
-
-			res.insert(*it);
-		}
+			if (res.size() < maxCount && ids.find(id) == std::cend(ids) && resIds.insert(id).second)
+				res.push_back(id);
+		});
+	}};
 
-		if (res.size() == maxCount)
-			break;
+	for (const SOM::Position& position : searchedRefVectorsPosition)
+		addObjects(position);
 
+	if (res.size() < maxCount)
+	{
 		// If there is not enough objects, try again with closest neighbour until there is too much distance
-		const std::optional<SOM::Position> closestRefVectorPosition {_network->getClosestRefVectorPosition(searchedRefVectorsPosition, _networkRefVectorsDistanceMedian * 0.75)};
-		if (!closestRefVectorPosition)
-			break;
-
-		searchedRefVectorsPosition.insert(closestRefVectorPosition.value());
+		_network->growRegion(searchedRefVectorsPosition, _networkRefVectorsDistanceMedian * 0.75, [&](const SOM::Position& position)
+		{
+			addObjects(position);
+			return res.size() < maxCount;
+		});
 	}
 
 	return res;
 }
 
 
-
 } // ns Recommendation
@@ -19,15 +19,20 @@
 
 #pragma once
 
+#include <chrono>
+#include <filesystem>
 #include <functional>
 #include <unordered_map>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "som/DataNormalizer.hpp"
+#include "som/DimensionReducer.hpp"
 #include "som/Network.hpp"
 #include "FeaturesClassifierCache.hpp"
 #include "FeaturesDefs.hpp"
+#include "PositionedObjects.hpp"
 #include "IClassifier.hpp"
 
 namespace Database
@@ -59,57 +64,72 @@ class FeaturesClassifier : public IClassifier
 
 		std::string_view getName() const override { return "Features"; }
 
-		bool load(Database::Session& session, bool forceReload, const ProgressCallback& progressCallback) override;
-		void requestCancelLoad() override;
+		bool load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback) override;
 
-		std::unordered_set<Database::IdType> getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const override;
-		std::unordered_set<Database::IdType> getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) const override;
-		std::unordered_set<Database::IdType> getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) const override;
-		std::unordered_set<Database::IdType> getSimilarArtists(Database::Session& session,
+		ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const override;
+		ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) const override;
+		ResultContainer getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) const override;
+		ResultContainer getSimilarArtists(Database::Session& session,
 				Database::IdType artistId,
 				EnumSet<Database::TrackArtistLinkType> linkTypes,
 				std::size_t maxCount) const override;
 
 		bool loadFromCache(Database::Session& session, const FeaturesClassifierCache& cache);
 
+		// Map the tracks added since the cache was written onto the cached network, and drop the removed ones
+		// Returns false if too many tracks changed (a full training is then needed)
+		bool loadFromCacheWithUpdates(Database::Session& session, const FeaturesClassifierCache& cache, const FeatureSettingsMap& featureSettingsMap, std::size_t reducedDimCount, std::size_t maxUpdatedTrackPercent);
+
 		// Use training (may be very slow)
 		struct TrainSettings
 		{
 			std::size_t iterationCount {10};
 			float sampleCountPerNeuron {4};
+			std::size_t threadCount {1};
+			bool batchTraining {};	// otherwise, use online training
+			std::size_t reducedDimCount {};	// if set, features are reduced to this dimension count before training
+			std::chrono::seconds checkpointPeriod {};	// if set, the training state is saved at this period, to be resumed on next load if stopped
+			std::chrono::seconds maxDuration {};	// if set, the training is stopped early after this duration, and the network is used as is
+			std::filesystem::path samplesFile;	// if set, samples are kept in this memory mapped file instead of in memory
 			FeatureSettingsMap featureSettingsMap;
 		};
 		bool loadFromTraining(Database::Session& session, const TrainSettings& trainSettings, const ProgressCallback& progressCallback);
 
 		using ObjectPositions = std::unordered_map<Database::IdType, std::unordered_set<SOM::Position>>;
-		using MatrixOfObjects = SOM::Matrix<std::unordered_set<Database::IdType>>;
 
 		bool load(Database::Session& session,
 				SOM::Network network,
+				SOM::DataNormalizer dataNormalizer,
+				std::optional<SOM::DimensionReducer> dimensionReducer,
 				const ObjectPositions& tracksPosition);
 
+		std::optional<SOM::InputVector> getTrackInputVector(Database::Session& session, Database::IdType trackId, const std::unordered_set<FeatureName>& featureNames, std::size_t nbDimensions) const;
+
 		FeaturesClassifierCache toCache() const;
 
-		static std::unordered_set<SOM::Position> getMatchingRefVectorsPosition(const std::unordered_set<Database::IdType>& ids, const ObjectPositions& objectPositions);
-		static std::unordered_set<Database::IdType> getObjectsIds(const std::unordered_set<SOM::Position>& positionSet, const MatrixOfObjects& objectsMap);
+		// Computes the maxCount most similar tracks, releases and artists of each object
+		bool precomputeSimilarities(std::size_t maxCount);
+		std::optional<SimilarObjects> computeSimilarObjects(const PositionedObjects& objects, const PositionedObjects& objectPositions, std::size_t maxCount) const;
 
-		std::unordered_set<Database::IdType> getSimilarObjects(const std::unordered_set<Database::IdType>& ids,
-				const SOM::Matrix<std::unordered_set<Database::IdType>>& objectsMap,
-				const ObjectPositions& objectPosition,
+		// Most similar first
+		std::vector<Database::IdType> getSimilarObjects(const std::unordered_set<Database::IdType>& ids,
+				const PositionedObjects& objects,
+				const PositionedObjects& objectPositions,
 				std::size_t maxCount) const;
 
-		bool				_loadCancelled {};
+		CancellationToken	_loadCancellation; // of the ongoing load
 		std::unique_ptr<SOM::Network>	_network;
+		std::unique_ptr<SOM::DataNormalizer>	_dataNormalizer;
+		std::unique_ptr<SOM::DimensionReducer>	_dimensionReducer;	// applied after normalization, if set
+		std::size_t			_trainedTrackCount {};
+		std::size_t			_updatedTrackCount {};
 		double				_networkRefVectorsDistanceMedian {};
 
-		ObjectPositions     _artistPositions;
-		std::unordered_map<Database::TrackArtistLinkType, MatrixOfObjects> _artistsMap;
-
-		MatrixOfObjects		_releasesMap;
-		ObjectPositions		_releasePositions;
-
-		MatrixOfObjects		_tracksMap;
-		ObjectPositions		_trackPositions;
+		PositionedObjects	_artists;	// all link types
+		std::unordered_map<Database::TrackArtistLinkType, PositionedObjects> _artistsByLinkType;
+		PositionedObjects	_releases;
+		PositionedObjects	_tracks;
+		PrecomputedSimilarities	_similarities;
 
 		static inline FeaturesFetchFunc _featuresFetchFunc;
 };
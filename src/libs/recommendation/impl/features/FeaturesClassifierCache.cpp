@@ -17,17 +17,170 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "FeaturesClassifierCache.hpp"
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
+#include "FeaturesClassifierCache.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils/Crc32Calculator.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Service.hpp"
 
 namespace Recommendation {
 
+namespace
+{
+	// Binary cache file layout, using the native endianness:
+	// - CacheHeader
+	// - data weights (networkDimCount values)
+	// - normalization factors (dimCount min/max pairs)
+	// - if reducedDimCount is set, dimension reducer mean (dimCount values) and components (reducedDimCount * dimCount values)
+	// - ref vectors (width * height * networkDimCount values, row by row)
+	// - track positions (trackPositionCount CacheTrackPosition, sorted)
+	// - similar object lists (similarListCount CacheSimilarList, sorted)
+	// - similar object ids (similarIdCount values, in list order)
+	// networkDimCount is reducedDimCount if set, dimCount otherwise
+	constexpr std::array<char, 8> cacheMagic {'L', 'M', 'S', 'F', 'E', 'A', 'T', 'C'};
+	constexpr std::uint32_t cacheVersion {4};
+
+	struct CacheHeader
+	{
+		std::array<char, 8>	magic;
+		std::uint32_t		version;
+		std::uint32_t		valueSize;	// size of SOM::InputVector::value_type
+		std::uint32_t		width;
+		std::uint32_t		height;
+		std::uint64_t		dimCount;
+		std::uint64_t		reducedDimCount;	// 0 if the dimensions are not reduced
+		std::uint64_t		trackPositionCount;
+		std::uint64_t		trainedTrackCount;
+		std::uint64_t		updatedTrackCount;
+		std::uint64_t		similarMaxCount;	// 0 if no similar objects were precomputed
+		std::uint64_t		similarListCount;
+		std::uint64_t		similarIdCount;
+		std::uint32_t		checksum;	// CRC32 of everything that follows the header
+		std::uint32_t		reserved;
+	};
+	static_assert(std::is_trivially_copyable_v<CacheHeader>);
+
+	struct CacheTrackPosition
+	{
+		std::int64_t	trackId;
+		std::uint32_t	x;
+		std::uint32_t	y;
+	};
+	static_assert(std::is_trivially_copyable_v<CacheTrackPosition>);
+
+	// Similar objects of tracks, releases, then artists for each link type
+	enum class CacheSimilarListKind : std::uint32_t
+	{
+		Track,
+		Release,
+		Artist,	// link type is added to this value
+	};
+
+	struct CacheSimilarList
+	{
+		std::uint32_t	kind;
+		std::uint32_t	idCount;
+		std::int64_t	objectId;
+	};
+	static_assert(std::is_trivially_copyable_v<CacheSimilarList>);
+
+	// Training checkpoint file layout, using the native endianness:
+	// - CheckpointHeader
+	// - data weights (dimCount values)
+	// - ref vectors (width * height * dimCount values, row by row)
+	constexpr std::array<char, 8> checkpointMagic {'L', 'M', 'S', 'F', 'E', 'A', 'T', 'K'};
+	constexpr std::uint32_t checkpointVersion {1};
+
+	struct CheckpointHeader
+	{
+		std::array<char, 8>	magic;
+		std::uint32_t		version;
+		std::uint32_t		valueSize;	// size of SOM::InputVector::value_type
+		std::uint32_t		width;
+		std::uint32_t		height;
+		std::uint64_t		dimCount;
+		std::uint64_t		iteration;
+		std::uint64_t		iterationCount;
+		std::uint32_t		batchTraining;
+		std::uint32_t		samplesChecksum;
+		std::uint32_t		checksum;	// CRC32 of everything that follows the header
+		std::uint32_t		reserved;
+	};
+	static_assert(std::is_trivially_copyable_v<CheckpointHeader>);
+
+	class MappedFile
+	{
+		public:
+			MappedFile(const std::filesystem::path& path)
+			{
+				_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (_fd < 0)
+					return;
+
+				struct stat fileStat;
+				if (::fstat(_fd, &fileStat) != 0 || fileStat.st_size == 0)
+					return;
+
+				void* data {::mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, _fd, 0)};
+				if (data == MAP_FAILED)
+					return;
+
+				::madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+
+				_data = static_cast<const std::byte*>(data);
+				_size = fileStat.st_size;
+			}
+
+			~MappedFile()
+			{
+				if (_data)
+					::munmap(const_cast<std::byte*>(_data), _size);
+				if (_fd >= 0)
+					::close(_fd);
+			}
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile(MappedFile&&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile& operator=(MappedFile&&) = delete;
+
+			const std::byte* getData() const { return _data; }
+			std::size_t getSize() const { return _size; }
+
+		private:
+			int					_fd {-1};
+			const std::byte*	_data {};
+			std::size_t			_size {};
+	};
+
+	template <typename T>
+	void
+	writeValues(std::ofstream& ofs, Utils::Crc32Calculator& crc32, const T* values, std::size_t count)
+	{
+		const std::byte* data {reinterpret_cast<const std::byte*>(values)};
+
+		crc32.processBytes(data, count * sizeof(T));
+		ofs.write(reinterpret_cast<const char*>(data), count * sizeof(T));
+	}
+}
 
 static
 std::filesystem::path getCacheDirectory()
@@ -35,221 +188,511 @@ std::filesystem::path getCacheDirectory()
 	return Service<IConfig>::get()->getPath("working-dir") / "cache" / "features";
 }
 
-static std::filesystem::path getCacheNetworkFilePath()
+static std::filesystem::path getCacheFilePath()
 {
-	return getCacheDirectory() / "network";
+	return getCacheDirectory() / "classifier.bin";
 }
 
-static std::filesystem::path getCacheTrackPositionsFilePath()
+static std::filesystem::path getCheckpointFilePath()
 {
-	return getCacheDirectory() / "track_positions";
+	return getCacheDirectory() / "training-checkpoint.bin";
 }
 
-static
 bool
-networkToCacheFile(const SOM::Network& network, std::filesystem::path path)
+FeaturesClassifierCache::toCacheFile(const std::filesystem::path& path) const
 {
-	try
+	const std::size_t dimCount {_dataNormalizer.getInputDimCount()};
+	const std::size_t networkDimCount {_network.getInputDimCount()};
+
+	std::vector<CacheTrackPosition> trackPositions;
+	for (const auto& [trackId, positions] : _trackPositions)
 	{
-		boost::property_tree::ptree root;
+		for (const SOM::Position& position : positions)
+			trackPositions.push_back(CacheTrackPosition {trackId, position.x, position.y});
+	}
+	std::sort(std::begin(trackPositions), std::end(trackPositions), [](const CacheTrackPosition& a, const CacheTrackPosition& b)
+	{
+		return std::tie(a.trackId, a.x, a.y) < std::tie(b.trackId, b.x, b.y);
+	});
 
-		root.put("width", network.getWidth());
-		root.put("height", network.getHeight());
-		root.put("dim_count", network.getInputDimCount());
+	std::vector<std::pair<CacheSimilarList, const std::vector<Database::IdType>*>> similarLists;
+	std::size_t similarIdCount {};
+	auto addSimilarLists {[&](std::uint32_t kind, const SimilarObjects& similarObjects)
+	{
+		for (const auto& [objectId, similarObjectIds] : similarObjects)
+		{
+			similarLists.emplace_back(CacheSimilarList {kind, static_cast<std::uint32_t>(similarObjectIds.size()), objectId}, &similarObjectIds);
+			similarIdCount += similarObjectIds.size();
+		}
+	}};
+	addSimilarLists(static_cast<std::uint32_t>(CacheSimilarListKind::Track), _similarities.tracks);
+	addSimilarLists(static_cast<std::uint32_t>(CacheSimilarListKind::Release), _similarities.releases);
+	for (const auto& [linkType, similarArtists] : _similarities.artistsByLinkType)
+		addSimilarLists(static_cast<std::uint32_t>(CacheSimilarListKind::Artist) + static_cast<std::uint32_t>(linkType), similarArtists);
+	std::sort(std::begin(similarLists), std::end(similarLists), [](const auto& a, const auto& b)
+	{
+		return std::tie(a.first.kind, a.first.objectId) < std::tie(b.first.kind, b.first.objectId);
+	});
 
-		for (SOM::InputVector::value_type weight : network.getDataWeights())
-			root.add("weights.weight", weight);
+	// Write in a temporary file first, so that a partially written cache is never read
+	const std::filesystem::path tmpPath {path.string() + ".tmp"};
+	{
+		std::ofstream ofs {tmpPath, std::ios::binary | std::ios::trunc};
+		if (!ofs)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create classifier cache file '" << tmpPath.string() << "'";
+			return false;
+		}
 
-		for (SOM::Coordinate x = 0; x < network.getWidth(); ++x)
+		CacheHeader header {};
+		header.magic = cacheMagic;
+		header.version = cacheVersion;
+		header.valueSize = sizeof(SOM::InputVector::value_type);
+		header.width = _network.getWidth();
+		header.height = _network.getHeight();
+		header.dimCount = dimCount;
+		header.reducedDimCount = _dimensionReducer ? _dimensionReducer->getOutputDimCount() : 0;
+		header.trackPositionCount = trackPositions.size();
+		header.trainedTrackCount = _trainedTrackCount;
+		header.updatedTrackCount = _updatedTrackCount;
+		header.similarMaxCount = _similarities.maxCount;
+		header.similarListCount = similarLists.size();
+		header.similarIdCount = similarIdCount;
+
+		// the checksum is only known at the end
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		Utils::Crc32Calculator crc32;
+
+		writeValues(ofs, crc32, _network.getDataWeights().data(), networkDimCount);
+		for (std::size_t i {}; i < dimCount; ++i)
 		{
-			for (SOM::Coordinate y = 0; y < network.getWidth(); ++y)
+			const SOM::DataNormalizer::MinMax& minMax {_dataNormalizer.getValue(i)};
+			writeValues(ofs, crc32, &minMax.min, 1);
+			writeValues(ofs, crc32, &minMax.max, 1);
+		}
+		if (_dimensionReducer)
+		{
+			for (std::size_t i {}; i < dimCount; ++i)
 			{
-				const auto& refVector = network.getRefVector({x, y});
-
-				boost::property_tree::ptree node;
-				for (auto value : refVector)
-					node.add("values.value", value);
-
-				node.put("coord_x", x);
-				node.put("coord_y", y);
-
-				root.add_child("ref_vectors.ref_vector", node);
+				const SOM::InputVector::value_type mean {_dimensionReducer->getMean(i)};
+				writeValues(ofs, crc32, &mean, 1);
+			}
+			for (std::size_t i {}; i < _dimensionReducer->getOutputDimCount(); ++i)
+				writeValues(ofs, crc32, _dimensionReducer->getComponent(i).data(), dimCount);
+		}
+		for (SOM::Coordinate y {}; y < _network.getHeight(); ++y)
+		{
+			for (SOM::Coordinate x {}; x < _network.getWidth(); ++x)
+				writeValues(ofs, crc32, _network.getRefVector({x, y}).data(), networkDimCount);
+		}
+		writeValues(ofs, crc32, trackPositions.data(), trackPositions.size());
+		for (const auto& [similarList, similarObjectIds] : similarLists)
+			writeValues(ofs, crc32, &similarList, 1);
+		for (const auto& [similarList, similarObjectIds] : similarLists)
+		{
+			for (const Database::IdType similarObjectId : *similarObjectIds)
+			{
+				const std::int64_t id {similarObjectId};
+				writeValues(ofs, crc32, &id, 1);
 			}
 		}
 
-		boost::property_tree::write_xml(path.string(), root);
+		header.checksum = crc32.getResult();
+		ofs.seekp(0);
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
 
-		LMS_LOG(RECOMMENDATION, DEBUG) << "Created network cache";
-		return true;
+		ofs.close();
+		if (!ofs)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot write classifier cache file '" << tmpPath.string() << "'";
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
 	}
-	catch (boost::property_tree::ptree_error& error)
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec)
 	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create network cache: " << error.what();
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot rename classifier cache file: " << ec.message();
+		std::filesystem::remove(tmpPath, ec);
 		return false;
 	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Created classifier cache";
+	return true;
 }
 
-std::optional<SOM::Network>
-FeaturesClassifierCache::createNetworkFromCacheFile(const std::filesystem::path& path)
+std::optional<FeaturesClassifierCache>
+FeaturesClassifierCache::createFromCacheFile(const std::filesystem::path& path)
 {
 	if (!std::filesystem::exists(path))
 		return std::nullopt;
 
-	try
-	{
-		LMS_LOG(RECOMMENDATION, INFO) << "Reading network from cache...";
+	LMS_LOG(RECOMMENDATION, INFO) << "Reading classifier from cache...";
 
-		boost::property_tree::ptree root;
+	const MappedFile file {path};
+	if (!file.getData())
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot map classifier cache file '" << path.string() << "': " << ::strerror(errno);
+		return std::nullopt;
+	}
 
-		boost::property_tree::read_xml(path.string(), root);
+	CacheHeader header;
+	if (file.getSize() < sizeof(header))
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Classifier cache file is truncated";
+		return std::nullopt;
+	}
+	std::memcpy(&header, file.getData(), sizeof(header));
 
-		SOM::Coordinate width {root.get<SOM::Coordinate>("width")};
-		SOM::Coordinate height {root.get<SOM::Coordinate>("height")};
-		std::size_t dimCount {root.get<std::size_t>("dim_count")};
+	if (header.magic != cacheMagic
+		|| header.version != cacheVersion
+		|| header.valueSize != sizeof(SOM::InputVector::value_type))
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Classifier cache file has an unsupported format";
+		return std::nullopt;
+	}
 
-		SOM::Network res {width, height, dimCount};
+	const std::size_t networkDimCount {header.reducedDimCount ? header.reducedDimCount : header.dimCount};
+	const std::size_t valueCount {(static_cast<std::size_t>(header.width) * header.height + 1) * networkDimCount
+		+ 2 * header.dimCount
+		+ (header.reducedDimCount ? (header.reducedDimCount + 1) * header.dimCount : 0)};
+	const std::size_t expectedSize {sizeof(header)
+		+ valueCount * sizeof(SOM::InputVector::value_type)
+		+ header.trackPositionCount * sizeof(CacheTrackPosition)
+		+ header.similarListCount * sizeof(CacheSimilarList)
+		+ header.similarIdCount * sizeof(std::int64_t)};
+	if (header.dimCount == 0 || header.reducedDimCount > header.dimCount || file.getSize() != expectedSize)
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Classifier cache file has a bad size";
+		return std::nullopt;
+	}
 
-		{
-			SOM::InputVector weights {dimCount};
-			std::size_t i {};
-			for (const auto& val : root.get_child("weights"))
-				weights[i++] = val.second.get_value<double>();
+	const std::byte* data {file.getData() + sizeof(header)};
 
-			res.setDataWeights(weights);
-		}
+	Utils::Crc32Calculator crc32;
+	crc32.processBytes(data, file.getSize() - sizeof(header));
+	if (crc32.getResult() != header.checksum)
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Classifier cache file is corrupted";
+		return std::nullopt;
+	}
 
-		for (const auto& node : root.get_child("ref_vectors"))
-		{
-			SOM::Coordinate x {node.second.get<SOM::Coordinate>("coord_x")};
-			SOM::Coordinate y {node.second.get<SOM::Coordinate>("coord_y")};
+	auto readVector {[&](std::size_t dimCount)
+	{
+		SOM::InputVector res {dimCount};
+		std::memcpy(&*res.begin(), data, dimCount * sizeof(SOM::InputVector::value_type));
+		data += dimCount * sizeof(SOM::InputVector::value_type);
 
-			SOM::InputVector refVector {dimCount};
-			std::size_t i {};
-			for (const auto& val : node.second.get_child("values"))
-				refVector[i++] = val.second.get_value<SOM::InputVector::value_type>();
+		return res;
+	}};
 
-			res.setRefVector({x, y}, refVector);
-		}
+	SOM::Network network {header.width, header.height, networkDimCount};
+	network.setDataWeights(readVector(networkDimCount));
 
-		LMS_LOG(RECOMMENDATION, INFO) << "Successfully read network from cache";
+	auto readValue {[&]
+	{
+		SOM::InputVector::value_type res;
+		std::memcpy(&res, data, sizeof(res));
+		data += sizeof(res);
 
 		return res;
+	}};
+
+	SOM::DataNormalizer dataNormalizer {header.dimCount};
+	for (std::size_t i {}; i < header.dimCount; ++i)
+	{
+		const SOM::InputVector::value_type min {readValue()};
+		const SOM::InputVector::value_type max {readValue()};
+		dataNormalizer.setValue(i, {min, max});
+	}
+
+	std::optional<SOM::DimensionReducer> dimensionReducer;
+	if (header.reducedDimCount)
+	{
+		dimensionReducer.emplace(header.dimCount, header.reducedDimCount);
+		for (std::size_t i {}; i < header.dimCount; ++i)
+			dimensionReducer->setMean(i, readValue());
+		for (std::size_t i {}; i < header.reducedDimCount; ++i)
+			dimensionReducer->setComponent(i, readVector(header.dimCount));
 	}
-	catch (boost::property_tree::ptree_error& error)
+
+	for (SOM::Coordinate y {}; y < header.height; ++y)
 	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot read network cache: " << error.what();
-		return std::nullopt;
+		for (SOM::Coordinate x {}; x < header.width; ++x)
+			network.setRefVector({x, y}, readVector(networkDimCount));
 	}
-}
 
-bool
-FeaturesClassifierCache::objectPositionToCacheFile(const ObjectPositions& objectsPosition, const std::filesystem::path& path)
-{
-	try
+	ObjectPositions trackPositions;
+	for (std::size_t i {}; i < header.trackPositionCount; ++i)
 	{
-		boost::property_tree::ptree root;
+		CacheTrackPosition trackPosition;
+		std::memcpy(&trackPosition, data, sizeof(trackPosition));
+		data += sizeof(trackPosition);
 
-		for (const auto& objectPosition : objectsPosition)
+		if (trackPosition.x >= header.width || trackPosition.y >= header.height)
 		{
-			boost::property_tree::ptree node;
+			LMS_LOG(RECOMMENDATION, ERROR) << "Classifier cache file has a bad track position";
+			return std::nullopt;
+		}
 
-			node.put("id", objectPosition.first);
+		trackPositions[trackPosition.trackId].insert({trackPosition.x, trackPosition.y});
+	}
+
+	PrecomputedSimilarities similarities;
+	similarities.maxCount = header.similarMaxCount;
+	{
+		const std::byte* similarIdData {data + header.similarListCount * sizeof(CacheSimilarList)};
+		std::size_t remainingSimilarIdCount {header.similarIdCount};
 
-			for (const auto& position : objectPosition.second)
+		for (std::size_t i {}; i < header.similarListCount; ++i)
+		{
+			CacheSimilarList similarList;
+			std::memcpy(&similarList, data, sizeof(similarList));
+			data += sizeof(similarList);
+
+			SimilarObjects* similarObjects {};
+			if (similarList.kind == static_cast<std::uint32_t>(CacheSimilarListKind::Track))
+				similarObjects = &similarities.tracks;
+			else if (similarList.kind == static_cast<std::uint32_t>(CacheSimilarListKind::Release))
+				similarObjects = &similarities.releases;
+			else if (similarList.kind - static_cast<std::uint32_t>(CacheSimilarListKind::Artist) <= static_cast<std::uint32_t>(Database::TrackArtistLinkType::Writer))
+				similarObjects = &similarities.artistsByLinkType[static_cast<Database::TrackArtistLinkType>(similarList.kind - static_cast<std::uint32_t>(CacheSimilarListKind::Artist))];
+
+			if (!similarObjects || similarList.idCount > remainingSimilarIdCount)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Classifier cache file has a bad similar object list";
+				return std::nullopt;
+			}
+			remainingSimilarIdCount -= similarList.idCount;
+
+			std::vector<Database::IdType>& similarObjectIds {(*similarObjects)[similarList.objectId]};
+			similarObjectIds.reserve(similarList.idCount);
+			for (std::size_t j {}; j < similarList.idCount; ++j)
 			{
-				boost::property_tree::ptree positionNode;
-				positionNode.put("x", position.x);
-				positionNode.put("y", position.y);
+				std::int64_t similarObjectId;
+				std::memcpy(&similarObjectId, similarIdData, sizeof(similarObjectId));
+				similarIdData += sizeof(similarObjectId);
 
-				node.add_child("position.position", positionNode);
+				similarObjectIds.push_back(similarObjectId);
 			}
+		}
+
+		if (remainingSimilarIdCount != 0)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Classifier cache file has bad similar object counts";
+			return std::nullopt;
+		}
+	}
+
+	LMS_LOG(RECOMMENDATION, INFO) << "Successfully read classifier from cache";
+
+	FeaturesClassifierCache cache {std::move(network), std::move(dataNormalizer), std::move(trackPositions)};
+	cache._trainedTrackCount = header.trainedTrackCount;
+	cache._updatedTrackCount = header.updatedTrackCount;
+	cache._dimensionReducer = std::move(dimensionReducer);
+	cache._similarities = std::move(similarities);
+
+	return cache;
+}
+
+void
+FeaturesClassifierCache::invalidate()
+{
+	std::error_code ec;
+	std::filesystem::remove(getCacheFilePath(), ec);
+
+	// Files of the former XML format
+	std::filesystem::remove(getCacheDirectory() / "network", ec);
+	std::filesystem::remove(getCacheDirectory() / "track_positions", ec);
+}
+
+std::optional<FeaturesClassifierCache>
+FeaturesClassifierCache::read()
+{
+	return createFromCacheFile(getCacheFilePath());
+}
+
+void
+FeaturesClassifierCache::write() const
+{
+	std::filesystem::create_directories(getCacheDirectory());
+
+	if (!toCacheFile(getCacheFilePath()))
+		invalidate();
+}
+
+FeaturesClassifierCache::FeaturesClassifierCache(SOM::Network network, SOM::DataNormalizer dataNormalizer, ObjectPositions trackPositions)
+: _network {std::move(network)},
+_dataNormalizer {std::move(dataNormalizer)},
+_trackPositions {std::move(trackPositions)}
+{
+}
+
+bool
+FeaturesTrainingCheckpoint::toCheckpointFile(const std::filesystem::path& path) const
+{
+	const std::size_t dimCount {_network.getInputDimCount()};
+
+	const std::filesystem::path tmpPath {path.string() + ".tmp"};
+	{
+		std::ofstream ofs {tmpPath, std::ios::binary | std::ios::trunc};
+		if (!ofs)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create training checkpoint file '" << tmpPath.string() << "'";
+			return false;
+		}
+
+		CheckpointHeader header {};
+		header.magic = checkpointMagic;
+		header.version = checkpointVersion;
+		header.valueSize = sizeof(SOM::InputVector::value_type);
+		header.width = _network.getWidth();
+		header.height = _network.getHeight();
+		header.dimCount = dimCount;
+		header.iteration = _iteration;
+		header.iterationCount = _iterationCount;
+		header.batchTraining = _batchTraining;
+		header.samplesChecksum = _samplesChecksum;
+
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
 
-			root.add_child("objects.object", node);
+		Utils::Crc32Calculator crc32;
+
+		writeValues(ofs, crc32, _network.getDataWeights().data(), dimCount);
+		for (SOM::Coordinate y {}; y < _network.getHeight(); ++y)
+		{
+			for (SOM::Coordinate x {}; x < _network.getWidth(); ++x)
+				writeValues(ofs, crc32, _network.getRefVector({x, y}).data(), dimCount);
 		}
 
-		boost::property_tree::write_xml(path.string(), root);
-		return true;
+		header.checksum = crc32.getResult();
+		ofs.seekp(0);
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		ofs.close();
+		if (!ofs)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot write training checkpoint file '" << tmpPath.string() << "'";
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
 	}
-	catch (boost::property_tree::ptree_error& error)
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec)
 	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot cache object position: " << error.what();
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot rename training checkpoint file: " << ec.message();
+		std::filesystem::remove(tmpPath, ec);
 		return false;
 	}
+
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Created training checkpoint at iteration " << _iteration << " / " << _iterationCount;
+	return true;
 }
 
-std::optional<FeaturesClassifierCache::ObjectPositions>
-FeaturesClassifierCache::createObjectPositionsFromCacheFile(const std::filesystem::path& path)
+std::optional<FeaturesTrainingCheckpoint>
+FeaturesTrainingCheckpoint::createFromCheckpointFile(const std::filesystem::path& path)
 {
-	try
+	if (!std::filesystem::exists(path))
+		return std::nullopt;
+
+	const MappedFile file {path};
+	if (!file.getData())
 	{
-		LMS_LOG(RECOMMENDATION, INFO) << "Reading object position from cache...";
+		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot map training checkpoint file '" << path.string() << "': " << ::strerror(errno);
+		return std::nullopt;
+	}
 
-		boost::property_tree::ptree root;
+	CheckpointHeader header;
+	if (file.getSize() < sizeof(header))
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Training checkpoint file is truncated";
+		return std::nullopt;
+	}
+	std::memcpy(&header, file.getData(), sizeof(header));
 
-		boost::property_tree::read_xml(path.string(), root);
+	if (header.magic != checkpointMagic
+		|| header.version != checkpointVersion
+		|| header.valueSize != sizeof(SOM::InputVector::value_type))
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Training checkpoint file has an unsupported format";
+		return std::nullopt;
+	}
 
-		ObjectPositions res;
+	const std::size_t valueCount {(static_cast<std::size_t>(header.width) * header.height + 1) * header.dimCount};
+	if (header.dimCount == 0 || header.iteration > header.iterationCount || file.getSize() != sizeof(header) + valueCount * sizeof(SOM::InputVector::value_type))
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Training checkpoint file has a bad size";
+		return std::nullopt;
+	}
 
-		for (const auto& object : root.get_child("objects"))
-		{
-			auto id = object.second.get<Database::IdType>("id");
-			for (const auto& position : object.second.get_child("position"))
-			{
-				auto x = position.second.get<SOM::Coordinate>("x");
-				auto y = position.second.get<SOM::Coordinate>("y");
+	const std::byte* data {file.getData() + sizeof(header)};
 
-				res[id].insert({x, y});
-			}
-		}
+	Utils::Crc32Calculator crc32;
+	crc32.processBytes(data, file.getSize() - sizeof(header));
+	if (crc32.getResult() != header.checksum)
+	{
+		LMS_LOG(RECOMMENDATION, ERROR) << "Training checkpoint file is corrupted";
+		return std::nullopt;
+	}
 
-		LMS_LOG(RECOMMENDATION, INFO) << "Successfully read object position from cache";
+	auto readVector {[&]
+	{
+		SOM::InputVector res {header.dimCount};
+		std::memcpy(&*res.begin(), data, header.dimCount * sizeof(SOM::InputVector::value_type));
+		data += header.dimCount * sizeof(SOM::InputVector::value_type);
 
 		return res;
-	}
-	catch (boost::property_tree::ptree_error& error)
+	}};
+
+	SOM::Network network {header.width, header.height, header.dimCount};
+	network.setDataWeights(readVector());
+	for (SOM::Coordinate y {}; y < header.height; ++y)
 	{
-		LMS_LOG(RECOMMENDATION, ERROR) << "Cannot create object position from cache file: " << error.what();
-		return std::nullopt;
+		for (SOM::Coordinate x {}; x < header.width; ++x)
+			network.setRefVector({x, y}, readVector());
 	}
+
+	return FeaturesTrainingCheckpoint {std::move(network), header.iteration, header.iterationCount, header.batchTraining != 0, header.samplesChecksum};
 }
 
 void
-FeaturesClassifierCache::invalidate()
+FeaturesTrainingCheckpoint::invalidate()
 {
-	std::filesystem::remove(getCacheNetworkFilePath());
-	std::filesystem::remove(getCacheTrackPositionsFilePath());
+	std::error_code ec;
+	std::filesystem::remove(getCheckpointFilePath(), ec);
 }
 
-std::optional<FeaturesClassifierCache>
-FeaturesClassifierCache::read()
+std::optional<FeaturesTrainingCheckpoint>
+FeaturesTrainingCheckpoint::read()
 {
-	auto network{createNetworkFromCacheFile(getCacheNetworkFilePath())};
-	if (!network)
-		return std::nullopt;
-
-	auto trackPositions{createObjectPositionsFromCacheFile(getCacheTrackPositionsFilePath())};
-	if (!trackPositions)
-		return std::nullopt;
-
-	return FeaturesClassifierCache {std::move(*network), std::move(*trackPositions)};
+	return createFromCheckpointFile(getCheckpointFilePath());
 }
 
 void
-FeaturesClassifierCache::write() const
+FeaturesTrainingCheckpoint::write() const
 {
-	std::filesystem::create_directories(Service<IConfig>::get()->getPath("working-dir") / "cache" / "features");
+	std::error_code ec;
+	std::filesystem::create_directories(getCacheDirectory(), ec);
 
-	if (!networkToCacheFile(_network, getCacheNetworkFilePath())
-		|| !objectPositionToCacheFile(_trackPositions, getCacheTrackPositionsFilePath()))
-	{
+	if (!toCheckpointFile(getCheckpointFilePath()))
 		invalidate();
-	}
 }
 
-FeaturesClassifierCache::FeaturesClassifierCache(SOM::Network network, ObjectPositions trackPositions)
+FeaturesTrainingCheckpoint::FeaturesTrainingCheckpoint(SOM::Network network, std::size_t iteration, std::size_t iterationCount, bool batchTraining, std::uint32_t samplesChecksum)
 : _network {std::move(network)},
-_trackPositions {std::move(trackPositions)}
+_iteration {iteration},
+_iterationCount {iterationCount},
+_batchTraining {batchTraining},
+_samplesChecksum {samplesChecksum}
 {
 }
 
 } // namespace Recommendation
+
@@ -19,15 +19,31 @@
 
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "database/Types.hpp"
+#include "som/DataNormalizer.hpp"
+#include "som/DimensionReducer.hpp"
 #include "som/Network.hpp"
 
 namespace Recommendation {
 
+// Most similar objects of each object, most similar first
+using SimilarObjects = std::unordered_map<Database::IdType, std::vector<Database::IdType>>;
+
+struct PrecomputedSimilarities
+{
+	std::size_t	maxCount {};	// 0 if not computed
+	SimilarObjects	tracks;
+	SimilarObjects	releases;
+	std::unordered_map<Database::TrackArtistLinkType, SimilarObjects> artistsByLinkType;
+};
+
 class FeaturesClassifierCache
 {
 	public:
@@ -39,16 +55,44 @@ class FeaturesClassifierCache
 	private:
 		using ObjectPositions = std::unordered_map<Database::IdType, std::unordered_set<SOM::Position>>;
 
-		FeaturesClassifierCache(SOM::Network network, ObjectPositions trackPositions);
+		FeaturesClassifierCache(SOM::Network network, SOM::DataNormalizer dataNormalizer, ObjectPositions trackPositions);
 
-		static std::optional<SOM::Network> createNetworkFromCacheFile(const std::filesystem::path& path);
-		static std::optional<ObjectPositions> createObjectPositionsFromCacheFile(const std::filesystem::path& path);
-		static bool objectPositionToCacheFile(const ObjectPositions& objectsPosition, const std::filesystem::path& path);
+		static std::optional<FeaturesClassifierCache> createFromCacheFile(const std::filesystem::path& path);
+		bool toCacheFile(const std::filesystem::path& path) const;
 
 		friend class FeaturesClassifier;
 
 		SOM::Network		_network;
+		SOM::DataNormalizer	_dataNormalizer;	// used to normalize the samples the network was trained with
+		std::optional<SOM::DimensionReducer>	_dimensionReducer;	// used to reduce the normalized samples, if set
 		ObjectPositions		_trackPositions;
+		std::size_t			_trainedTrackCount {};	// number of tracks the network was trained with
+		std::size_t			_updatedTrackCount {};	// number of tracks added or removed since the training
+		PrecomputedSimilarities	_similarities;
+};
+
+// State of an ongoing training, so that it can be resumed after a cancellation or a restart
+class FeaturesTrainingCheckpoint
+{
+	public:
+		static void invalidate();
+
+		static std::optional<FeaturesTrainingCheckpoint> read();
+		void write() const;
+
+	private:
+		FeaturesTrainingCheckpoint(SOM::Network network, std::size_t iteration, std::size_t iterationCount, bool batchTraining, std::uint32_t samplesChecksum);
+
+		static std::optional<FeaturesTrainingCheckpoint> createFromCheckpointFile(const std::filesystem::path& path);
+		bool toCheckpointFile(const std::filesystem::path& path) const;
+
+		friend class FeaturesClassifier;
+
+		SOM::Network	_network;
+		std::size_t		_iteration;	// next iteration to run
+		std::size_t		_iterationCount;
+		bool			_batchTraining;
+		std::uint32_t	_samplesChecksum;	// of the samples the network is trained with
 };
 
 } // namespace Recommendation
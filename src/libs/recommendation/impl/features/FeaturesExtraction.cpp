@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "FeaturesExtraction.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <numeric>
+
+#include "database/Session.hpp"
+#include "database/TrackFeatures.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Scheduler.hpp"
+#include "utils/Service.hpp"
+
+namespace Recommendation {
+
+FeatureNames
+getFeatureNames(const FeatureSettingsMap& featureSettingsMap)
+{
+	FeatureNames featureNames;
+	std::transform(std::cbegin(featureSettingsMap), std::cend(featureSettingsMap), std::inserter(featureNames, std::begin(featureNames)),
+		[](const auto& itFeatureSetting) { return itFeatureSetting.first; });
+
+	return featureNames;
+}
+
+std::size_t
+getFeaturesDimCount(const FeatureNames& featureNames)
+{
+	return std::accumulate(std::cbegin(featureNames), std::cend(featureNames), std::size_t {0},
+			[](std::size_t sum, const FeatureName& featureName) { return sum + getFeatureDef(featureName).nbDimensions; });
+}
+
+SOM::InputVector
+getInputVectorWeights(const FeatureSettingsMap& featureSettingsMap, std::size_t nbDimensions)
+{
+	SOM::InputVector weights {nbDimensions};
+	std::size_t index {};
+	for (const auto& [featureName, featureSettings] : featureSettingsMap)
+	{
+		const std::size_t featureNbDimensions {getFeatureDef(featureName).nbDimensions};
+
+		for (std::size_t i {}; i < featureNbDimensions; ++i)
+			weights[index++] = (1. / featureNbDimensions * featureSettings.weight);
+	}
+
+	assert(index == nbDimensions);
+
+	return weights;
+}
+
+std::optional<FeatureValuesMap>
+getTrackFeatureValuesFromDb(Database::Session& session, Database::IdType trackId, const FeatureNames& featureNames)
+{
+	std::optional<FeatureValuesMap> res;
+
+	auto transaction {session.createSharedTransaction()};
+
+	res = Database::TrackFeatures::getFeatureValuesMapByTrack(session, trackId, featureNames);
+	if (res->empty())
+		res.reset();
+
+	return res;
+}
+
+std::optional<SOM::InputVector>
+convertFeatureValuesMapToInputVector(const FeatureValuesMap& featureValuesMap, std::size_t nbDimensions)
+{
+	std::size_t i {};
+	std::optional<SOM::InputVector> res {SOM::InputVector {nbDimensions}};
+	for (const auto& [featureName, values] : featureValuesMap)
+	{
+		if (values.size() != getFeatureDef(featureName).nbDimensions)
+		{
+			LMS_LOG(RECOMMENDATION, WARNING) << "Dimension mismatch for feature '" << featureName << "'. Expected " << getFeatureDef(featureName).nbDimensions << ", got " << values.size();
+			res.reset();
+			break;
+		}
+
+		for (double val : values)
+			(*res)[i++] = val;
+	}
+
+	return res;
+}
+
+std::size_t
+getFeaturesThreadCount()
+{
+	const std::size_t configThreadCount {Service<IConfig>::get()->getULong("recommendation-features-thread-count", 0)};
+	if (configThreadCount)
+		return configThreadCount;
+
+	return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+std::optional<TrackInputVectors>
+extractAllTrackInputVectors(Database::Session& session, const FeatureNames& featureNames, std::size_t nbDimensions, std::size_t threadCount, const CancellationToken& cancellation)
+{
+	TrackInputVectors res;
+
+	const bool completed {visitAllTrackInputVectors(session, featureNames, nbDimensions, threadCount, cancellation,
+		[&](Database::IdType trackId, SOM::InputVector&& inputVector)
+		{
+			res.trackIds.push_back(trackId);
+			res.inputVectors.emplace_back(std::move(inputVector));
+		})};
+
+	if (!completed)
+		return std::nullopt;
+
+	return res;
+}
+
+bool
+visitAllTrackInputVectors(Database::Session& session, const FeatureNames& featureNames, std::size_t nbDimensions, std::size_t threadCount, const CancellationToken& cancellation, const TrackInputVectorVisitor& visitor)
+{
+	constexpr std::size_t batchSize {4096};
+
+	Database::IdType lastTrackId {};
+	while (true)
+	{
+		if (cancellation.isCancelled())
+			return false;
+
+		std::vector<Database::TrackFeatures::EncodedFeatureValues> batch;
+		{
+			auto transaction {session.createSharedTransaction()};
+
+			batch = Database::TrackFeatures::getEncodedFeatureValues(session, lastTrackId, batchSize);
+		}
+		if (batch.empty())
+			break;
+
+		lastTrackId = batch.back().trackId;
+
+		// Decoding does not need the database, split the batch among the scheduler threads
+		std::vector<std::optional<SOM::InputVector>> inputVectors(batch.size());
+		auto decode {[&](std::size_t i)
+		{
+			if (const std::optional<FeatureValuesMap> featureValuesMap {Database::TrackFeatures::decodeFeatureValues(batch[i].data, featureNames)})
+				inputVectors[i] = convertFeatureValuesMapToInputVector(*featureValuesMap, nbDimensions);
+		}};
+
+		if (Scheduler* scheduler {Service<Scheduler>::get()})
+		{
+			if (!scheduler->parallelFor(Scheduler::TaskClass::Cpu, Scheduler::Priority::Normal, cancellation, batch.size(), decode, std::max<std::size_t>(threadCount, 1)))
+				return false;
+		}
+		else
+		{
+			for (std::size_t i {}; i < batch.size(); ++i)
+				decode(i);
+		}
+
+		for (std::size_t i {}; i < batch.size(); ++i)
+		{
+			// Features not stored in the compact form, need to parse the json data (slow)
+			if (!inputVectors[i])
+			{
+				if (const std::optional<FeatureValuesMap> featureValuesMap {getTrackFeatureValuesFromDb(session, batch[i].trackId, featureNames)})
+					inputVectors[i] = convertFeatureValuesMapToInputVector(*featureValuesMap, nbDimensions);
+			}
+
+			if (!inputVectors[i])
+				continue;
+
+			visitor(batch[i].trackId, std::move(*inputVectors[i]));
+		}
+	}
+
+	return true;
+}
+
+} // namespace Recommendation
+
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "database/Types.hpp"
+#include "som/InputVector.hpp"
+#include "utils/CancellationToken.hpp"
+#include "FeaturesDefs.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace Recommendation {
+
+FeatureNames getFeatureNames(const FeatureSettingsMap& featureSettingsMap);
+std::size_t getFeaturesDimCount(const FeatureNames& featureNames);
+
+// Weight of each dimension, so that each feature weighs the same whatever its dimension count
+SOM::InputVector getInputVectorWeights(const FeatureSettingsMap& featureSettingsMap, std::size_t nbDimensions);
+
+std::optional<FeatureValuesMap> getTrackFeatureValuesFromDb(Database::Session& session, Database::IdType trackId, const FeatureNames& featureNames);
+std::optional<SOM::InputVector> convertFeatureValuesMapToInputVector(const FeatureValuesMap& featureValuesMap, std::size_t nbDimensions);
+
+// Number of threads used to process the features (from the configuration)
+std::size_t getFeaturesThreadCount();
+
+struct TrackInputVectors
+{
+	std::vector<Database::IdType>	trackIds;
+	std::vector<SOM::InputVector>	inputVectors;	// same order as trackIds
+};
+// Input vectors of all the tracks that have features
+// Features are read by large batches and decoded by at most threadCount scheduler threads
+// Returns nothing if cancelled
+std::optional<TrackInputVectors> extractAllTrackInputVectors(Database::Session& session, const FeatureNames& featureNames, std::size_t nbDimensions, std::size_t threadCount, const CancellationToken& cancellation);
+
+// Same as above, but each input vector is passed to the visitor as soon as it is decoded, by increasing track id
+// Returns false if cancelled
+using TrackInputVectorVisitor = std::function<void(Database::IdType /* trackId */, SOM::InputVector&& /* inputVector */)>;
+bool visitAllTrackInputVectors(Database::Session& session, const FeatureNames& featureNames, std::size_t nbDimensions, std::size_t threadCount, const CancellationToken& cancellation, const TrackInputVectorVisitor& visitor);
+
+} // namespace Recommendation
+
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "PositionedObjects.hpp"
+
+#include <algorithm>
+
+namespace Recommendation {
+
+PositionedObjects::PositionedObjects(SOM::Coordinate width, SOM::Coordinate height, std::vector<Link> links)
+: _width {width}
+{
+	const std::size_t positionCount {static_cast<std::size_t>(width) * height};
+
+	_positionsById.reserve(links.size());
+	for (const auto& [id, position] : links)
+		_positionsById.emplace_back(id, static_cast<PositionIndex>(getPositionIndex(position)));
+	links.clear();
+	links.shrink_to_fit();
+
+	std::sort(std::begin(_positionsById), std::end(_positionsById));
+	_positionsById.erase(std::unique(std::begin(_positionsById), std::end(_positionsById)), std::end(_positionsById));
+	_positionsById.shrink_to_fit();
+
+	// Counting sort by position, ids stay sorted for each position
+	_objectOffsets.assign(positionCount + 1, 0);
+	for (const auto& [id, positionIndex] : _positionsById)
+		_objectOffsets[positionIndex + 1]++;
+	for (std::size_t i {}; i < positionCount; ++i)
+		_objectOffsets[i + 1] += _objectOffsets[i];
+
+	_objectIds.resize(_positionsById.size());
+	std::vector<std::uint32_t> nextOffsets(std::cbegin(_objectOffsets), std::prev(std::cend(_objectOffsets)));
+	for (const auto& [id, positionIndex] : _positionsById)
+		_objectIds[nextOffsets[positionIndex]++] = id;
+}
+
+std::vector<std::pair<Database::IdType, PositionedObjects::PositionIndex>>::const_iterator
+PositionedObjects::findObject(Database::IdType id) const
+{
+	return std::lower_bound(std::cbegin(_positionsById), std::cend(_positionsById), id,
+			[](const auto& positionById, Database::IdType id) { return positionById.first < id; });
+}
+
+} // namespace Recommendation
+
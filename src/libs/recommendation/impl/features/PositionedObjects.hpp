@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "database/Types.hpp"
+#include "som/Matrix.hpp"
+
+namespace Recommendation {
+
+// Objects placed on the ref vectors of a network, indexed both ways
+// Stored in flat sorted arrays: objects of each ref vector are contiguous (CSR layout), as are positions of each object
+class PositionedObjects
+{
+	public:
+		using Link = std::pair<Database::IdType, SOM::Position>;
+
+		PositionedObjects() = default;
+		// Duplicated links are ignored
+		PositionedObjects(SOM::Coordinate width, SOM::Coordinate height, std::vector<Link> links);
+
+		// Sorted, without duplicates
+		template <typename Func>
+		void visitObjects(const SOM::Position& position, Func func) const
+		{
+			if (_objectOffsets.empty())
+				return;
+
+			const std::size_t index {getPositionIndex(position)};
+			for (std::uint32_t i {_objectOffsets[index]}; i < _objectOffsets[index + 1]; ++i)
+				func(_objectIds[i]);
+		}
+
+		template <typename Func>
+		void visitPositions(Database::IdType id, Func func) const
+		{
+			for (auto it {findObject(id)}; it != std::cend(_positionsById) && it->first == id; ++it)
+				func(getPosition(it->second));
+		}
+
+		// Sorted by id
+		template <typename Func>
+		void visitLinks(Func func) const
+		{
+			for (const auto& [id, positionIndex] : _positionsById)
+				func(id, getPosition(positionIndex));
+		}
+
+		bool empty() const { return _positionsById.empty(); }
+
+	private:
+		using PositionIndex = std::uint32_t;
+
+		std::size_t getPositionIndex(const SOM::Position& position) const { return static_cast<std::size_t>(position.y) * _width + position.x; }
+		SOM::Position getPosition(PositionIndex index) const { return {index % _width, index / _width}; }
+		std::vector<std::pair<Database::IdType, PositionIndex>>::const_iterator findObject(Database::IdType id) const;
+
+		SOM::Coordinate							_width {};
+		std::vector<std::uint32_t>				_objectOffsets;	// width * height + 1 offsets in _objectIds
+		std::vector<Database::IdType>			_objectIds;
+		std::vector<std::pair<Database::IdType, PositionIndex>>	_positionsById;	// sorted
+};
+
+} // namespace Recommendation
+
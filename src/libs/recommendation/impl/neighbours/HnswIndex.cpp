@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "HnswIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <type_traits>
+
+namespace Recommendation
+{
+	namespace
+	{
+		template <typename T>
+		void
+		writeValue(std::ostream& os, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		template <typename T>
+		T
+		readValue(std::istream& is)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+
+			T value {};
+			is.read(reinterpret_cast<char*>(&value), sizeof(value));
+			return value;
+		}
+	}
+
+	HnswIndex::HnswIndex(const SOM::InputVector& weights, const Settings& settings)
+	: _settings {settings}
+	, _weights {weights}
+	, _levelFactor {1. / std::log(static_cast<double>(std::max<std::size_t>(2, settings.maxNeighbourCount)))}
+	{
+		if (_settings.maxNeighbourCount == 0 || getDimCount() == 0)
+			throw SOM::Exception {"Bad index settings"};
+	}
+
+	std::vector<HnswIndex::Label>
+	HnswIndex::getLabels() const
+	{
+		std::vector<Label> res;
+		res.reserve(_nodeIdsByLabel.size());
+
+		for (const auto& [label, nodeId] : _nodeIdsByLabel)
+			res.push_back(label);
+
+		return res;
+	}
+
+	const HnswIndex::value_type*
+	HnswIndex::getVector(Label label) const
+	{
+		auto itNodeId {_nodeIdsByLabel.find(label)};
+		if (itNodeId == std::cend(_nodeIdsByLabel))
+			return nullptr;
+
+		return getNodeVector(itNodeId->second);
+	}
+
+	HnswIndex::Distance
+	HnswIndex::computeDistance(const value_type* a, const value_type* b) const
+	{
+		return SOM::InputVector::computeEuclidianSquareDistance(a, b, _weights.data(), getDimCount());
+	}
+
+	std::size_t
+	HnswIndex::getMaxNeighbourCount(std::size_t level) const
+	{
+		return level == 0 ? _settings.maxNeighbourCount * 2 : _settings.maxNeighbourCount;
+	}
+
+	std::size_t
+	HnswIndex::pickLevel()
+	{
+		std::uniform_real_distribution<double> dist {0, 1};
+
+		return static_cast<std::size_t>(-std::log(1. - dist(_randGenerator)) * _levelFactor);
+	}
+
+	void
+	HnswIndex::insert(Label label, const SOM::InputVector& vector)
+	{
+		if (!vector.hasSameDimension(_weights))
+			throw SOM::Exception {"Not the same dimension count"};
+
+		remove(label);
+
+		const NodeId nodeId {static_cast<NodeId>(_nodes.size())};
+		const std::size_t level {pickLevel()};
+
+		_nodes.push_back(Node {label, false, std::vector<std::vector<NodeId>>(level + 1)});
+		_values.insert(std::end(_values), vector.cbegin(), vector.cend());
+		_nodeIdsByLabel[label] = nodeId;
+
+		if (!_entryPoint)
+		{
+			_entryPoint = nodeId;
+			_maxLevel = level;
+			return;
+		}
+
+		const value_type* query {getNodeVector(nodeId)};
+
+		NodeId current {*_entryPoint};
+		for (std::size_t currentLevel {_maxLevel}; currentLevel > level; --currentLevel)
+			current = greedySearch(query, current, currentLevel);
+
+		for (std::size_t currentLevel {std::min(level, _maxLevel) + 1}; currentLevel-- > 0; )
+		{
+			const std::vector<Candidate> candidates {searchLevel(query, current, _settings.constructionSearchSize, currentLevel)};
+			const std::vector<NodeId> neighbours {selectNeighbours(candidates, _settings.maxNeighbourCount)};
+
+			_nodes[nodeId].neighbours[currentLevel] = neighbours;
+			for (NodeId neighbour : neighbours)
+			{
+				_nodes[neighbour].neighbours[currentLevel].push_back(nodeId);
+				if (_nodes[neighbour].neighbours[currentLevel].size() > getMaxNeighbourCount(currentLevel))
+					shrinkNeighbours(neighbour, currentLevel);
+			}
+
+			current = candidates.front().second;
+		}
+
+		if (level > _maxLevel)
+		{
+			_maxLevel = level;
+			_entryPoint = nodeId;
+		}
+	}
+
+	void
+	HnswIndex::remove(Label label)
+	{
+		auto itNodeId {_nodeIdsByLabel.find(label)};
+		if (itNodeId == std::cend(_nodeIdsByLabel))
+			return;
+
+		_nodes[itNodeId->second].removed = true;
+		_nodeIdsByLabel.erase(itNodeId);
+	}
+
+	HnswIndex::NodeId
+	HnswIndex::greedySearch(const value_type* query, NodeId entryPoint, std::size_t level) const
+	{
+		NodeId current {entryPoint};
+		Distance currentDistance {computeDistance(query, getNodeVector(current))};
+
+		bool changed {true};
+		while (changed)
+		{
+			changed = false;
+			for (NodeId neighbour : _nodes[current].neighbours[level])
+			{
+				const Distance distance {computeDistance(query, getNodeVector(neighbour))};
+				if (distance < currentDistance)
+				{
+					current = neighbour;
+					currentDistance = distance;
+					changed = true;
+				}
+			}
+		}
+
+		return current;
+	}
+
+	std::vector<HnswIndex::Candidate>
+	HnswIndex::searchLevel(const value_type* query, NodeId entryPoint, std::size_t searchSize, std::size_t level) const
+	{
+		std::vector<bool> visited(_nodes.size());
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;	// closest on top
+		std::priority_queue<Candidate> results;	// farthest on top
+
+		const Distance entryPointDistance {computeDistance(query, getNodeVector(entryPoint))};
+		visited[entryPoint] = true;
+		candidates.emplace(entryPointDistance, entryPoint);
+		results.emplace(entryPointDistance, entryPoint);
+
+		while (!candidates.empty())
+		{
+			const Candidate candidate {candidates.top()};
+			if (results.size() >= searchSize && candidate.first > results.top().first)
+				break;
+
+			candidates.pop();
+
+			for (NodeId neighbour : _nodes[candidate.second].neighbours[level])
+			{
+				if (visited[neighbour])
+					continue;
+				visited[neighbour] = true;
+
+				const Distance distance {computeDistance(query, getNodeVector(neighbour))};
+				if (results.size() < searchSize || distance < results.top().first)
+				{
+					candidates.emplace(distance, neighbour);
+					results.emplace(distance, neighbour);
+					if (results.size() > searchSize)
+						results.pop();
+				}
+			}
+		}
+
+		std::vector<Candidate> res;
+		res.reserve(results.size());
+		for (; !results.empty(); results.pop())
+			res.push_back(results.top());
+		std::reverse(std::begin(res), std::end(res));
+
+		return res;
+	}
+
+	std::vector<HnswIndex::NodeId>
+	HnswIndex::selectNeighbours(const std::vector<Candidate>& candidates, std::size_t maxCount) const
+	{
+		// Keep a candidate only if it is closer to the node than to the already selected neighbours,
+		// so that the links spread in several directions
+		std::vector<NodeId> res;
+		std::vector<NodeId> discarded;
+
+		for (const auto& [distance, nodeId] : candidates)
+		{
+			if (res.size() == maxCount)
+				break;
+
+			const bool keep {std::none_of(std::cbegin(res), std::cend(res), [&](NodeId selected)
+			{
+				return computeDistance(getNodeVector(nodeId), getNodeVector(selected)) < distance;
+			})};
+
+			if (keep)
+				res.push_back(nodeId);
+			else
+				discarded.push_back(nodeId);
+		}
+
+		// Fill with the closest discarded candidates (useful for duplicate vectors)
+		for (auto it {std::cbegin(discarded)}; it != std::cend(discarded) && res.size() < maxCount; ++it)
+			res.push_back(*it);
+
+		return res;
+	}
+
+	void
+	HnswIndex::shrinkNeighbours(NodeId nodeId, std::size_t level)
+	{
+		std::vector<Candidate> candidates;
+		for (NodeId neighbour : _nodes[nodeId].neighbours[level])
+			candidates.emplace_back(computeDistance(getNodeVector(nodeId), getNodeVector(neighbour)), neighbour);
+
+		std::sort(std::begin(candidates), std::end(candidates));
+
+		_nodes[nodeId].neighbours[level] = selectNeighbours(candidates, getMaxNeighbourCount(level));
+	}
+
+	std::vector<HnswIndex::Neighbour>
+	HnswIndex::search(const value_type* query, std::size_t count, std::size_t searchSize) const
+	{
+		std::vector<Neighbour> res;
+
+		if (!_entryPoint || count == 0)
+			return res;
+
+		NodeId current {*_entryPoint};
+		for (std::size_t level {_maxLevel}; level > 0; --level)
+			current = greedySearch(query, current, level);
+
+		for (const auto& [distance, nodeId] : searchLevel(query, current, std::max(searchSize, count), 0))
+		{
+			if (_nodes[nodeId].removed)
+				continue;
+
+			res.push_back(Neighbour {_nodes[nodeId].label, distance});
+			if (res.size() == count)
+				break;
+		}
+
+		return res;
+	}
+
+	void
+	HnswIndex::write(std::ostream& os) const
+	{
+		writeValue<std::uint64_t>(os, _settings.maxNeighbourCount);
+		writeValue<std::uint64_t>(os, _settings.constructionSearchSize);
+		writeValue<std::uint64_t>(os, getDimCount());
+		os.write(reinterpret_cast<const char*>(_weights.data()), getDimCount() * sizeof(value_type));
+
+		writeValue<std::uint64_t>(os, _maxLevel);
+		writeValue<std::int64_t>(os, _entryPoint ? static_cast<std::int64_t>(*_entryPoint) : -1);
+		writeValue<std::uint64_t>(os, _nodes.size());
+		for (const Node& node : _nodes)
+		{
+			writeValue<std::int64_t>(os, node.label);
+			writeValue<std::uint8_t>(os, node.removed);
+			writeValue<std::uint32_t>(os, node.neighbours.size());
+			for (const std::vector<NodeId>& neighbours : node.neighbours)
+			{
+				writeValue<std::uint32_t>(os, neighbours.size());
+				os.write(reinterpret_cast<const char*>(neighbours.data()), neighbours.size() * sizeof(NodeId));
+			}
+		}
+		os.write(reinterpret_cast<const char*>(_values.data()), _values.size() * sizeof(value_type));
+	}
+
+	std::optional<HnswIndex>
+	HnswIndex::read(std::istream& is)
+	{
+		Settings settings;
+		settings.maxNeighbourCount = readValue<std::uint64_t>(is);
+		settings.constructionSearchSize = readValue<std::uint64_t>(is);
+
+		const std::size_t dimCount {readValue<std::uint64_t>(is)};
+		if (!is || dimCount == 0 || settings.maxNeighbourCount == 0)
+			return std::nullopt;
+
+		SOM::InputVector weights {dimCount};
+		is.read(reinterpret_cast<char*>(&*weights.begin()), dimCount * sizeof(value_type));
+
+		HnswIndex index {weights, settings};
+		index._maxLevel = readValue<std::uint64_t>(is);
+		const std::int64_t entryPoint {readValue<std::int64_t>(is)};
+		const std::size_t nodeCount {readValue<std::uint64_t>(is)};
+		if (!is || entryPoint >= static_cast<std::int64_t>(nodeCount) || (entryPoint < 0) != (nodeCount == 0))
+			return std::nullopt;
+
+		if (entryPoint >= 0)
+			index._entryPoint = static_cast<NodeId>(entryPoint);
+
+		index._nodes.reserve(nodeCount);
+		for (std::size_t nodeId {}; nodeId < nodeCount; ++nodeId)
+		{
+			Node node;
+			node.label = readValue<std::int64_t>(is);
+			node.removed = readValue<std::uint8_t>(is);
+			node.neighbours.resize(readValue<std::uint32_t>(is));
+			if (!is || node.neighbours.empty() || node.neighbours.size() > index._maxLevel + 1)
+				return std::nullopt;
+
+			for (std::vector<NodeId>& neighbours : node.neighbours)
+			{
+				neighbours.resize(readValue<std::uint32_t>(is));
+				is.read(reinterpret_cast<char*>(neighbours.data()), neighbours.size() * sizeof(NodeId));
+			}
+
+			if (!is)
+				return std::nullopt;
+
+			if (!node.removed)
+				index._nodeIdsByLabel[node.label] = nodeId;
+
+			index._nodes.push_back(std::move(node));
+		}
+
+		// Links must stay within the graph and the levels of the linked nodes
+		for (const Node& node : index._nodes)
+		{
+			for (std::size_t level {}; level < node.neighbours.size(); ++level)
+			{
+				for (NodeId neighbour : node.neighbours[level])
+				{
+					if (neighbour >= nodeCount || index._nodes[neighbour].neighbours.size() <= level)
+						return std::nullopt;
+				}
+			}
+		}
+		if (index._entryPoint && index._nodes[*index._entryPoint].neighbours.size() != index._maxLevel + 1)
+			return std::nullopt;
+
+		index._values.resize(nodeCount * dimCount);
+		is.read(reinterpret_cast<char*>(index._values.data()), index._values.size() * sizeof(value_type));
+		if (!is)
+			return std::nullopt;
+
+		return index;
+	}
+} // ns Recommendation
+
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "database/Types.hpp"
+#include "som/InputVector.hpp"
+
+namespace Recommendation
+{
+	// Hierarchical Navigable Small World graph, used to find the approximate nearest neighbours of a vector
+	// Distances are weighted square euclidian distances
+	// Removed vectors are only marked as such, they are still used to navigate in the graph
+	class HnswIndex
+	{
+		public:
+			using Label = Database::IdType;
+			using value_type = SOM::InputVector::value_type;
+			using Distance = SOM::InputVector::Distance;
+
+			struct Settings
+			{
+				std::size_t maxNeighbourCount {16};	// per node and per level, twice on the lowest level
+				std::size_t constructionSearchSize {100};
+			};
+
+			HnswIndex(const SOM::InputVector& weights, const Settings& settings);
+
+			std::size_t getDimCount() const { return _weights.getNbDimensions(); }
+			const SOM::InputVector& getWeights() const { return _weights; }
+			std::size_t getSize() const { return _nodeIdsByLabel.size(); }
+			std::vector<Label> getLabels() const;
+
+			// nullptr if not found
+			const value_type* getVector(Label label) const;
+
+			// Replaces the previous vector if the label is already indexed
+			void insert(Label label, const SOM::InputVector& vector);
+			void remove(Label label);
+
+			struct Neighbour
+			{
+				Label		label;
+				Distance	distance;
+			};
+			// Closest first, searchSize is the size of the dynamic candidate list (the higher, the more accurate)
+			std::vector<Neighbour> search(const value_type* query, std::size_t count, std::size_t searchSize) const;
+
+			// Native endianness
+			void write(std::ostream& os) const;
+			static std::optional<HnswIndex> read(std::istream& is);
+
+		private:
+			using NodeId = std::uint32_t;
+			using Candidate = std::pair<Distance, NodeId>;
+
+			struct Node
+			{
+				Label	label;
+				bool	removed {};
+				std::vector<std::vector<NodeId>>	neighbours;	// indexed by level
+			};
+
+			const value_type* getNodeVector(NodeId nodeId) const { return &_values[static_cast<std::size_t>(nodeId) * getDimCount()]; }
+			Distance computeDistance(const value_type* a, const value_type* b) const;
+			std::size_t getMaxNeighbourCount(std::size_t level) const;
+			std::size_t pickLevel();
+
+			NodeId greedySearch(const value_type* query, NodeId entryPoint, std::size_t level) const;
+			// Sorted, closest first
+			std::vector<Candidate> searchLevel(const value_type* query, NodeId entryPoint, std::size_t searchSize, std::size_t level) const;
+			std::vector<NodeId> selectNeighbours(const std::vector<Candidate>& candidates, std::size_t maxCount) const;
+			void shrinkNeighbours(NodeId nodeId, std::size_t level);
+
+			Settings					_settings;
+			SOM::InputVector			_weights;
+			double						_levelFactor;
+			std::mt19937				_randGenerator;
+
+			std::vector<Node>			_nodes;
+			std::vector<value_type>		_values;	// vectors of all the nodes, contiguous
+			std::unordered_map<Label, NodeId>	_nodeIdsByLabel;	// only nodes that are not removed
+			std::optional<NodeId>		_entryPoint;
+			std::size_t					_maxLevel {};
+	};
+} // ns Recommendation
+
@@ -0,0 +1,543 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "NearestNeighboursClassifier.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <type_traits>
+
+#include "features/FeaturesClassifier.hpp"
+#include "features/FeaturesExtraction.hpp"
+#include "NearestNeighboursClassifierCreator.hpp"
+
+#include "database/Artist.hpp"
+#include "database/Release.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+#include "database/TrackArtistLink.hpp"
+#include "database/TrackList.hpp"
+#include "utils/Crc32Calculator.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+#include "utils/Service.hpp"
+
+namespace Recommendation {
+
+namespace
+{
+	// Index file layout, using the native endianness:
+	// - IndexFileHeader
+	// - dimension count, then normalization factors (dimCount min/max pairs)
+	// - HNSW index
+	constexpr std::array<char, 8> indexFileMagic {'L', 'M', 'S', 'N', 'N', 'I', 'D', 'X'};
+	constexpr std::uint32_t indexFileVersion {1};
+
+	struct IndexFileHeader
+	{
+		std::array<char, 8>	magic;
+		std::uint32_t		version;
+		std::uint32_t		valueSize;	// size of SOM::InputVector::value_type
+		std::uint64_t		payloadSize;
+		std::uint32_t		checksum;	// CRC32 of the payload
+		std::uint32_t		reserved;
+	};
+	static_assert(std::is_trivially_copyable_v<IndexFileHeader>);
+
+	// Searching more seeds does not bring much, and the search cost is linear in the seed count
+	constexpr std::size_t maxSeedTrackCount {32};
+	// Similar tracks looked for, per requested release or artist
+	constexpr std::size_t trackCountPerObject {10};
+	constexpr std::size_t minSearchSize {64};
+	constexpr std::size_t progressStep {256};
+
+	std::filesystem::path getIndexFilePath()
+	{
+		return Service<IConfig>::get()->getPath("working-dir") / "cache" / "neighbours" / "index.bin";
+	}
+
+	void
+	writeIndexFile(const HnswIndex& index, const SOM::DataNormalizer& dataNormalizer)
+	{
+		std::ostringstream payload;
+		{
+			const std::uint64_t dimCount {index.getDimCount()};
+			payload.write(reinterpret_cast<const char*>(&dimCount), sizeof(dimCount));
+
+			for (std::size_t i {}; i < dimCount; ++i)
+			{
+				const SOM::DataNormalizer::MinMax& minMax {dataNormalizer.getValue(i)};
+				payload.write(reinterpret_cast<const char*>(&minMax.min), sizeof(minMax.min));
+				payload.write(reinterpret_cast<const char*>(&minMax.max), sizeof(minMax.max));
+			}
+
+			index.write(payload);
+		}
+		const std::string payloadData {payload.str()};
+
+		Utils::Crc32Calculator crc32;
+		crc32.processBytes(reinterpret_cast<const std::byte*>(payloadData.data()), payloadData.size());
+
+		IndexFileHeader header {};
+		header.magic = indexFileMagic;
+		header.version = indexFileVersion;
+		header.valueSize = sizeof(SOM::InputVector::value_type);
+		header.payloadSize = payloadData.size();
+		header.checksum = crc32.getResult();
+
+		const std::filesystem::path path {getIndexFilePath()};
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		// Write in a temporary file first, so that a partially written index is never read
+		const std::filesystem::path tmpPath {path.string() + ".tmp"};
+		{
+			std::ofstream ofs {tmpPath, std::ios::binary | std::ios::trunc};
+			ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			ofs.write(payloadData.data(), payloadData.size());
+			ofs.close();
+			if (!ofs)
+			{
+				LMS_LOG(RECOMMENDATION, ERROR) << "Cannot write nearest neighbours index file '" << tmpPath.string() << "'";
+				std::filesystem::remove(tmpPath, ec);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmpPath, path, ec);
+		if (ec)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Cannot rename nearest neighbours index file: " << ec.message();
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+
+		LMS_LOG(RECOMMENDATION, DEBUG) << "Written nearest neighbours index file (" << index.getSize() << " tracks)";
+	}
+
+	struct IndexFileContents
+	{
+		HnswIndex			index;
+		SOM::DataNormalizer	dataNormalizer;
+	};
+
+	std::optional<IndexFileContents>
+	readIndexFile()
+	{
+		const std::filesystem::path path {getIndexFilePath()};
+
+		std::ifstream ifs {path, std::ios::binary};
+		if (!ifs)
+			return std::nullopt;
+
+		IndexFileHeader header;
+		ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!ifs
+			|| header.magic != indexFileMagic
+			|| header.version != indexFileVersion
+			|| header.valueSize != sizeof(SOM::InputVector::value_type))
+		{
+			LMS_LOG(RECOMMENDATION, INFO) << "Nearest neighbours index file has an unsupported format";
+			return std::nullopt;
+		}
+
+		std::string payloadData(header.payloadSize, '\0');
+		ifs.read(payloadData.data(), payloadData.size());
+		if (!ifs || ifs.peek() != std::ifstream::traits_type::eof())
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Nearest neighbours index file has a bad size";
+			return std::nullopt;
+		}
+
+		Utils::Crc32Calculator crc32;
+		crc32.processBytes(reinterpret_cast<const std::byte*>(payloadData.data()), payloadData.size());
+		if (crc32.getResult() != header.checksum)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Nearest neighbours index file is corrupted";
+			return std::nullopt;
+		}
+
+		std::istringstream payload {std::move(payloadData)};
+
+		std::uint64_t dimCount {};
+		payload.read(reinterpret_cast<char*>(&dimCount), sizeof(dimCount));
+		if (!payload || dimCount == 0)
+			return std::nullopt;
+
+		SOM::DataNormalizer dataNormalizer {dimCount};
+		for (std::size_t i {}; i < dimCount; ++i)
+		{
+			SOM::DataNormalizer::MinMax minMax;
+			payload.read(reinterpret_cast<char*>(&minMax.min), sizeof(minMax.min));
+			payload.read(reinterpret_cast<char*>(&minMax.max), sizeof(minMax.max));
+			dataNormalizer.setValue(i, minMax);
+		}
+
+		std::optional<HnswIndex> index {HnswIndex::read(payload)};
+		if (!index || index->getDimCount() != dimCount)
+		{
+			LMS_LOG(RECOMMENDATION, ERROR) << "Nearest neighbours index file has a bad index";
+			return std::nullopt;
+		}
+
+		return IndexFileContents {std::move(*index), std::move(dataNormalizer)};
+	}
+}
+
+std::unique_ptr<IClassifier> createNearestNeighboursClassifier()
+{
+	return std::make_unique<NearestNeighboursClassifier>();
+}
+
+bool
+NearestNeighboursClassifier::load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback)
+{
+	_loadCancellation = cancellation;
+
+	const std::size_t nbDimensions {getFeaturesDimCount(getFeatureNames(FeaturesClassifier::getDefaultTrainFeatureSettings()))};
+
+	std::optional<IndexFileContents> indexFileContents {readIndexFile()};
+	if (indexFileContents && indexFileContents->index.getDimCount() != nbDimensions)
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Features dimension changed, rebuilding nearest neighbours index";
+		indexFileContents.reset();
+	}
+
+	if (indexFileContents)
+	{
+		_index = std::move(indexFileContents->index);
+		_dataNormalizer = std::make_unique<SOM::DataNormalizer>(std::move(indexFileContents->dataNormalizer));
+	}
+
+	if (!_index || forceReload)
+	{
+		const std::size_t updatedTrackCount {_index ? updateIndex(session, progressCallback) : buildIndex(session, progressCallback)};
+		if (_loadCancellation.isCancelled() || !_index || _index->getSize() == 0)
+			return false;
+
+		if (updatedTrackCount > 0)
+			writeIndexFile(*_index, *_dataNormalizer);
+	}
+
+	return loadTrackLinks(session);
+}
+
+std::size_t
+NearestNeighboursClassifier::buildIndex(Database::Session& session, const ProgressCallback& progressCallback)
+{
+	LMS_LOG(RECOMMENDATION, INFO) << "Building nearest neighbours index...";
+
+	const FeatureSettingsMap& featureSettingsMap {FeaturesClassifier::getDefaultTrainFeatureSettings()};
+	const FeatureNames featureNames {getFeatureNames(featureSettingsMap)};
+	const std::size_t nbDimensions {getFeaturesDimCount(featureNames)};
+
+	std::optional<TrackInputVectors> trackInputVectors {extractAllTrackInputVectors(session, featureNames, nbDimensions, getFeaturesThreadCount(), _loadCancellation)};
+	if (!trackInputVectors)
+		return 0;
+
+	std::vector<SOM::InputVector>& samples {trackInputVectors->inputVectors};
+	const std::vector<Database::IdType>& samplesTrackIds {trackInputVectors->trackIds};
+
+	if (samples.empty())
+	{
+		LMS_LOG(RECOMMENDATION, INFO) << "Nothing to classify!";
+		return 0;
+	}
+
+	SOM::DataNormalizer dataNormalizer {nbDimensions};
+	dataNormalizer.computeNormalizationFactors(samples);
+
+	HnswIndex index {getInputVectorWeights(featureSettingsMap, nbDimensions), HnswIndex::Settings {}};
+	for (std::size_t i {}; i < samples.size(); ++i)
+	{
+		if (_loadCancellation.isCancelled())
+			return 0;
+
+		dataNormalizer.normalizeData(samples[i]);
+		index.insert(samplesTrackIds[i], samples[i]);
+
+		if (progressCallback && (i % progressStep == 0))
+			progressCallback(Progress {samples.size(), i});
+	}
+
+	LMS_LOG(RECOMMENDATION, INFO) << "Built nearest neighbours index with " << index.getSize() << " tracks";
+
+	_index = std::move(index);
+	_dataNormalizer = std::make_unique<SOM::DataNormalizer>(std::move(dataNormalizer));
+
+	return _index->getSize();
+}
+
+std::size_t
+NearestNeighboursClassifier::updateIndex(Database::Session& session, const ProgressCallback& progressCallback)
+{
+	std::vector<Database::IdType> trackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+		trackIds = Database::Track::getAllIdsWithFeatures(session);
+	}
+
+	const FeatureNames featureNames {getFeatureNames(FeaturesClassifier::getDefaultTrainFeatureSettings())};
+	const std::unordered_set<Database::IdType> currentTrackIds(std::cbegin(trackIds), std::cend(trackIds));
+
+	std::size_t removedTrackCount {};
+	std::size_t addedTrackCount {};
+	for (Database::IdType trackId : _index->getLabels())
+	{
+		if (currentTrackIds.find(trackId) == std::cend(currentTrackIds))
+		{
+			_index->remove(trackId);
+			removedTrackCount++;
+		}
+	}
+
+	std::vector<Database::IdType> newTrackIds;
+	std::copy_if(std::cbegin(trackIds), std::cend(trackIds), std::back_inserter(newTrackIds), [&](Database::IdType trackId) { return !_index->getVector(trackId); });
+
+	// Features of new tracks are normalized using the factors computed when the index was built (values are clamped)
+	for (std::size_t i {}; i < newTrackIds.size(); ++i)
+	{
+		if (_loadCancellation.isCancelled())
+			return 0;
+
+		const std::optional<FeatureValuesMap> featureValuesMap {getTrackFeatureValuesFromDb(session, newTrackIds[i], featureNames)};
+		if (!featureValuesMap)
+			continue;
+
+		std::optional<SOM::InputVector> inputVector {convertFeatureValuesMapToInputVector(*featureValuesMap, _index->getDimCount())};
+		if (!inputVector)
+			continue;
+
+		_dataNormalizer->normalizeData(*inputVector);
+		_index->insert(newTrackIds[i], *inputVector);
+		addedTrackCount++;
+
+		if (progressCallback && (i % progressStep == 0))
+			progressCallback(Progress {newTrackIds.size(), i});
+	}
+
+	LMS_LOG(RECOMMENDATION, INFO) << "Updated nearest neighbours index: " << addedTrackCount << " new tracks, " << removedTrackCount << " removed tracks";
+
+	return addedTrackCount + removedTrackCount;
+}
+
+bool
+NearestNeighboursClassifier::loadTrackLinks(Database::Session& session)
+{
+	LMS_LOG(RECOMMENDATION, DEBUG) << "Constructing maps...";
+
+	for (Database::IdType trackId : _index->getLabels())
+	{
+		if (_loadCancellation.isCancelled())
+			return false;
+
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::Track::pointer track {Database::Track::getById(session, trackId)};
+		if (!track)
+			continue;
+
+		if (track->getRelease())
+		{
+			_releaseByTrack[trackId] = track->getRelease().id();
+			_tracksByRelease[track->getRelease().id()].push_back(trackId);
+		}
+
+		for (const auto& artistLink : track->getArtistLinks())
+		{
+			_artistsByTrack[trackId].push_back(ArtistLink {artistLink->getType(), artistLink->getArtist().id()});
+			_tracksByArtist[artistLink->getArtist().id()].push_back(ArtistLink {artistLink->getType(), trackId});
+		}
+	}
+
+	LMS_LOG(RECOMMENDATION, INFO) << "Classifier successfully loaded!";
+
+	return true;
+}
+
+IClassifier::ResultContainer
+NearestNeighboursClassifier::getSimilarTrackIds(const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const
+{
+	std::vector<const HnswIndex::value_type*> seedVectors;
+	for (Database::IdType trackId : trackIds)
+	{
+		if (const HnswIndex::value_type* vector {_index->getVector(trackId)})
+			seedVectors.push_back(vector);
+	}
+
+	if (seedVectors.size() > maxSeedTrackCount)
+	{
+		Random::shuffleContainerPartially(seedVectors, maxSeedTrackCount);
+		seedVectors.resize(maxSeedTrackCount);
+	}
+
+	// Keep the distance to the closest seed
+	const std::size_t neighbourCount {maxCount + std::min(trackIds.size(), maxSeedTrackCount)};
+	std::unordered_map<Database::IdType, HnswIndex::Distance> distances;
+	for (const HnswIndex::value_type* seedVector : seedVectors)
+	{
+		for (const HnswIndex::Neighbour& neighbour : _index->search(seedVector, neighbourCount, std::max(neighbourCount, minSearchSize)))
+		{
+			if (trackIds.find(neighbour.label) != std::cend(trackIds))
+				continue;
+
+			auto [it, inserted] {distances.try_emplace(neighbour.label, neighbour.distance)};
+			if (!inserted)
+				it->second = std::min(it->second, neighbour.distance);
+		}
+	}
+
+	std::vector<std::pair<Database::IdType, HnswIndex::Distance>> candidates(std::cbegin(distances), std::cend(distances));
+	const std::size_t count {std::min(maxCount, candidates.size())};
+	std::partial_sort(std::begin(candidates), std::next(std::begin(candidates), count), std::end(candidates),
+			[](const auto& a, const auto& b) { return a.second < b.second; });
+
+	ResultContainer res;
+	res.reserve(count);
+	std::transform(std::cbegin(candidates), std::next(std::cbegin(candidates), count), std::back_inserter(res),
+			[](const auto& candidate) { return IEngine::ScoredId {candidate.first, static_cast<float>(1 / (1 + candidate.second))}; });
+
+	return res;
+}
+
+IClassifier::ResultContainer
+NearestNeighboursClassifier::getSimilarTracksFromTrackList(Database::Session& session, Database::IdType trackListId, std::size_t maxCount) const
+{
+	std::unordered_set<Database::IdType> trackIds;
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const Database::TrackList::pointer trackList {Database::TrackList::getById(session, trackListId)};
+		if (!trackList)
+			return {};
+
+		const std::vector<Database::IdType> orderedTrackIds {trackList->getTrackIds()};
+		trackIds.insert(std::cbegin(orderedTrackIds), std::cend(orderedTrackIds));
+	}
+
+	return getSimilarTracks(session, trackIds, maxCount);
+}
+
+IClassifier::ResultContainer
+NearestNeighboursClassifier::getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const
+{
+	ResultContainer res {getSimilarTrackIds(trackIds, maxCount)};
+	if (res.empty())
+		return res;
+
+	// Report only existing ids
+	auto transaction {session.createSharedTransaction()};
+
+	res.erase(std::remove_if(std::begin(res), std::end(res), [&](const IEngine::ScoredId& result) { return !Database::Track::getById(session, result.id); }), std::end(res));
+
+	return res;
+}
+
+IClassifier::ResultContainer
+NearestNeighboursClassifier::getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) const
+{
+	ResultContainer res;
+
+	auto itTracks {_tracksByRelease.find(releaseId)};
+	if (itTracks == std::cend(_tracksByRelease))
+		return res;
+
+	const std::unordered_set<Database::IdType> releaseTrackIds(std::cbegin(itTracks->second), std::cend(itTracks->second));
+
+	// Report only existing ids
+	auto transaction {session.createSharedTransaction()};
+
+	// Releases are scored by their closest track
+	std::unordered_set<Database::IdType> releaseIds;
+	for (const IEngine::ScoredId& similarTrack : getSimilarTrackIds(releaseTrackIds, maxCount * trackCountPerObject))
+	{
+		if (res.size() == maxCount)
+			break;
+
+		auto itRelease {_releaseByTrack.find(similarTrack.id)};
+		if (itRelease == std::cend(_releaseByTrack) || itRelease->second == releaseId || releaseIds.find(itRelease->second) != std::cend(releaseIds))
+			continue;
+
+		if (Database::Release::getById(session, itRelease->second))
+		{
+			releaseIds.insert(itRelease->second);
+			res.push_back({itRelease->second, similarTrack.score});
+		}
+	}
+
+	return res;
+}
+
+IClassifier::ResultContainer
+NearestNeighboursClassifier::getSimilarArtists(Database::Session& session,
+		Database::IdType artistId,
+		EnumSet<Database::TrackArtistLinkType> linkTypes,
+		std::size_t maxCount) const
+{
+	ResultContainer res;
+
+	auto itTracks {_tracksByArtist.find(artistId)};
+	if (itTracks == std::cend(_tracksByArtist))
+		return res;
+
+	std::unordered_set<Database::IdType> artistTrackIds;
+	for (const ArtistLink& link : itTracks->second)
+	{
+		if (linkTypes.contains(link.type))
+			artistTrackIds.insert(link.id);
+	}
+
+	// Report only existing ids
+	auto transaction {session.createSharedTransaction()};
+
+	// Artists are scored by their closest track
+	std::unordered_set<Database::IdType> artistIds;
+	for (const IEngine::ScoredId& similarTrack : getSimilarTrackIds(artistTrackIds, maxCount * trackCountPerObject))
+	{
+		auto itArtists {_artistsByTrack.find(similarTrack.id)};
+		if (itArtists == std::cend(_artistsByTrack))
+			continue;
+
+		for (const ArtistLink& link : itArtists->second)
+		{
+			if (res.size() == maxCount)
+				return res;
+
+			if (!linkTypes.contains(link.type) || link.id == artistId || artistIds.find(link.id) != std::cend(artistIds))
+				continue;
+
+			if (Database::Artist::getById(session, link.id))
+			{
+				artistIds.insert(link.id);
+				res.push_back({link.id, similarTrack.score});
+			}
+		}
+	}
+
+	return res;
+}
+
+} // ns Recommendation
+
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "som/DataNormalizer.hpp"
+#include "HnswIndex.hpp"
+#include "IClassifier.hpp"
+
+namespace Recommendation
+{
+	// Finds similar tracks using an approximate nearest neighbours search on their normalized features
+	// No training is needed and tracks can be added to or removed from the index at any time
+	class NearestNeighboursClassifier : public IClassifier
+	{
+		public:
+			NearestNeighboursClassifier() = default;
+			NearestNeighboursClassifier(const NearestNeighboursClassifier&) = delete;
+			NearestNeighboursClassifier(NearestNeighboursClassifier&&) = delete;
+			NearestNeighboursClassifier& operator=(const NearestNeighboursClassifier&) = delete;
+			NearestNeighboursClassifier& operator=(NearestNeighboursClassifier&&) = delete;
+
+		private:
+			std::string_view getName() const override { return "NearestNeighbours"; }
+
+			bool load(Database::Session& session, bool forceReload, const CancellationToken& cancellation, const ProgressCallback& progressCallback) override;
+
+			ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) const override;
+			ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) const override;
+			ResultContainer getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) const override;
+			ResultContainer getSimilarArtists(Database::Session& session,
+					Database::IdType artistId,
+					EnumSet<Database::TrackArtistLinkType> linkTypes,
+					std::size_t maxCount) const override;
+
+			// Return the number of added or removed tracks
+			std::size_t buildIndex(Database::Session& session, const ProgressCallback& progressCallback);
+			std::size_t updateIndex(Database::Session& session, const ProgressCallback& progressCallback);
+			bool loadTrackLinks(Database::Session& session);
+
+			// Tracks ordered by decreasing similarity, given tracks excluded
+			// Scored by the distance to the closest given track
+			ResultContainer getSimilarTrackIds(const std::unordered_set<Database::IdType>& trackIds, std::size_t maxCount) const;
+
+			CancellationToken _loadCancellation; // of the ongoing load
+
+			std::optional<HnswIndex>				_index;
+			std::unique_ptr<SOM::DataNormalizer>	_dataNormalizer;
+
+			struct ArtistLink
+			{
+				Database::TrackArtistLinkType	type;
+				Database::IdType				id;	// artist or track, depending on the map
+			};
+			std::unordered_map<Database::IdType, Database::IdType>					_releaseByTrack;
+			std::unordered_map<Database::IdType, std::vector<Database::IdType>>		_tracksByRelease;
+			std::unordered_map<Database::IdType, std::vector<ArtistLink>>			_artistsByTrack;
+			std::unordered_map<Database::IdType, std::vector<ArtistLink>>			_tracksByArtist;
+	};
+} // ns Recommendation
+
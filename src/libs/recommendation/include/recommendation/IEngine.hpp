@@ -20,10 +20,14 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <optional>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "database/Types.hpp"
+#include "utils/CancellationToken.hpp"
 #include "utils/EnumSet.hpp"
 
 namespace Database
@@ -45,21 +49,77 @@ namespace Recommendation
 				std::size_t	processedElems {};
 			};
 			using ProgressCallback = std::function<void(const Progress&)>;
-			virtual void load(bool forceReload, const ProgressCallback& progressCallback = {}) = 0;
-			virtual void cancelLoad() = 0;
+			// The previous classifiers are kept if cancelled
+			virtual void load(bool forceReload, const CancellationToken& cancellation = {}, const ProgressCallback& progressCallback = {}) = 0;
 
+			struct ScoredId
+			{
+				Database::IdType	id;
+				float				score;	// in ]0, 1], higher is more similar. Scales depend on the classifier that answered
+			};
+			// Ordered by decreasing score
+			using RankedResults = std::vector<ScoredId>;
+
+			// Results are written to the provided container, replacing its content (so that callers can reuse its storage)
+			// Excluded ids are never reported, and do not count in maxCount
+			virtual void getRankedSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds = {}) = 0;
+			virtual void getRankedSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds = {}) = 0;
+			virtual void getRankedSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount, RankedResults& results, const std::unordered_set<Database::IdType>& excludedIds = {}) = 0;
+			virtual void getRankedSimilarArtists(Database::Session& session,
+					Database::IdType artistId,
+					EnumSet<Database::TrackArtistLinkType> linkTypes,
+					std::size_t maxCount,
+					RankedResults& results,
+					const std::unordered_set<Database::IdType>& excludedIds = {}) = 0;
+
+			// Same, for callers that do not care about the ranking
 			using ResultContainer = std::unordered_set<Database::IdType>;
 
-			virtual ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount) = 0;
-			virtual ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount) = 0;
-			virtual ResultContainer getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount) = 0;
-			virtual ResultContainer getSimilarArtists(Database::Session& session,
+			ResultContainer getSimilarTracksFromTrackList(Database::Session& session, Database::IdType tracklistId, std::size_t maxCount)
+			{
+				RankedResults results;
+				getRankedSimilarTracksFromTrackList(session, tracklistId, maxCount, results);
+				return toResultContainer(results);
+			}
+
+			ResultContainer getSimilarTracks(Database::Session& session, const std::unordered_set<Database::IdType>& tracksId, std::size_t maxCount)
+			{
+				RankedResults results;
+				getRankedSimilarTracks(session, tracksId, maxCount, results);
+				return toResultContainer(results);
+			}
+
+			ResultContainer getSimilarReleases(Database::Session& session, Database::IdType releaseId, std::size_t maxCount)
+			{
+				RankedResults results;
+				getRankedSimilarReleases(session, releaseId, maxCount, results);
+				return toResultContainer(results);
+			}
+
+			ResultContainer getSimilarArtists(Database::Session& session,
 					Database::IdType artistId,
 					EnumSet<Database::TrackArtistLinkType> linkTypes,
-					std::size_t maxCount) = 0;
+					std::size_t maxCount)
+			{
+				RankedResults results;
+				getRankedSimilarArtists(session, artistId, linkTypes, maxCount, results);
+				return toResultContainer(results);
+			}
+
+		private:
+			static ResultContainer toResultContainer(const RankedResults& results)
+			{
+				ResultContainer res;
+				for (const ScoredId& result : results)
+					res.insert(result.id);
+				return res;
+			}
 	};
 
 	std::unique_ptr<IEngine> createEngine(Database::Db& db);
 
+	// Names of the track features the features classifier may use
+	std::unordered_set<std::string> getUsedTrackFeatureNames();
+
 } // ns Recommendation
 
@@ -19,6 +19,12 @@
 
 #include "AcousticBrainzUtils.hpp"
 
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+
+#include <boost/asio/steady_timer.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
@@ -34,54 +40,324 @@
 namespace AcousticBrainz
 {
 
-static
+namespace
+{
+
+// Limit set by the API
+constexpr std::size_t maxMBIDsPerRequest {25};
+
 std::string
-getJsonData(const UUID& mbid)
+getLowLevelBulkURL(const std::vector<std::string>& mbids)
 {
 	static const std::string defaultAPIURL = "https://acousticbrainz.org/api/v1/";
 
-	const std::string url {Service<IConfig>::get()->getString("acousticbrainz-api-url", defaultAPIURL) + std::string {mbid.getAsString()} + "/low-level"};
+	std::string url {Service<IConfig>::get()->getString("acousticbrainz-api-url", defaultAPIURL) + "low-level?recording_ids="};
+	for (std::size_t i {}; i < mbids.size(); ++i)
+	{
+		if (i > 0)
+			url += ";";
+		url += mbids[i];
+	}
 
-	boost::asio::io_service ioService;
+	return url;
+}
 
-	Wt::Http::Client client {ioService};
-	client.setFollowRedirect(true);
-	client.setSslCertificateVerificationEnabled(true);
-	client.setMaximumResponseSize(256*1024);
+// Unset if the response cannot be parsed
+std::optional<std::map<std::string, std::string>>
+parseLowLevelBulkResponse(const std::string& body, const std::vector<std::string>& mbids)
+{
+	std::map<std::string, std::string> res;
 
-	if (!client.get(url))
+	try
 	{
-		LMS_LOG(DBUPDATER, ERROR) << "Cannot perform a GET request to url '" << url << "'";
-		return {};
-	}
+		std::istringstream iss {body};
+		boost::property_tree::ptree root;
+		boost::property_tree::read_json(iss, root);
 
-	std::string response;
-	client.done().connect([&](Wt::AsioWrapper::error_code ec, const Wt::Http::Message &msg)
+		// Redirected MBIDs are reported using their new value
+		const auto mbidMapping {root.get_child_optional("mbid_mapping")};
+
+		for (const std::string& mbid : mbids)
+		{
+			std::string actualMBID {mbid};
+			if (mbidMapping)
+			{
+				if (const auto mappedMBID {mbidMapping->get_optional<std::string>(mbid)})
+					actualMBID = *mappedMBID;
+			}
+
+			// Only the first submission is used
+			const auto lowLevelFeatures {root.get_child_optional(actualMBID + ".0")};
+			if (!lowLevelFeatures)
+			{
+				LMS_LOG(DBUPDATER, DEBUG) << "No low level features found for MBID '" << mbid << "'";
+				continue;
+			}
+
+			std::ostringstream oss;
+			boost::property_tree::write_json(oss, *lowLevelFeatures, false);
+			res.emplace(mbid, oss.str());
+		}
+	}
+	catch (boost::property_tree::ptree_error& error)
 	{
-		if (ec)
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot parse low level features: " << error.what();
+		return std::nullopt;
+	}
+
+	return res;
+}
+
+// One file per MBID, empty if the recording has no low level features
+class FeaturesCache
+{
+	public:
+		FeaturesCache(const std::filesystem::path& directory)
+		: _directory {directory}
+		{}
+
+		// Unset if not cached
+		std::optional<std::string> get(const std::string& mbid) const
 		{
-			LMS_LOG(DBUPDATER, ERROR) << "GET request to url '" << url << "' failed: " << ec.message();
-			return;
+			std::ifstream ifs {getPath(mbid), std::ios::binary};
+			if (!ifs)
+				return std::nullopt;
+
+			std::ostringstream oss;
+			oss << ifs.rdbuf();
+			return oss.str();
 		}
 
-		if (msg.status() != 200)
+		void set(const std::string& mbid, const std::string& lowLevelFeatures)
 		{
-			LMS_LOG(DBUPDATER, ERROR) << "GET request to url '" << url << "' failed: status = " << msg.status() << ", body = " << msg.body();
-			return;
+			const std::filesystem::path path {getPath(mbid)};
+			const std::filesystem::path tmpPath {path.string() + ".tmp"};
+
+			std::error_code ec;
+			std::filesystem::create_directories(path.parent_path(), ec);
+			if (ec)
+			{
+				LMS_LOG(DBUPDATER, ERROR) << "Cannot create cache directory '" << path.parent_path().string() << "': " << ec.message();
+				return;
+			}
+
+			// Written aside then renamed, so that an interrupted write is not taken as a valid entry
+			{
+				std::ofstream ofs {tmpPath, std::ios::binary | std::ios::trunc};
+				ofs << lowLevelFeatures;
+				if (!ofs)
+				{
+					LMS_LOG(DBUPDATER, ERROR) << "Cannot write cache file '" << tmpPath.string() << "'";
+					return;
+				}
+			}
+
+			std::filesystem::rename(tmpPath, path, ec);
+			if (ec)
+				LMS_LOG(DBUPDATER, ERROR) << "Cannot rename cache file '" << tmpPath.string() << "': " << ec.message();
 		}
 
-		response = msg.body();
-	});
+	private:
+		std::filesystem::path getPath(const std::string& mbid) const
+		{
+			return _directory / mbid.substr(0, 2) / (mbid + ".json");
+		}
 
-	ioService.run();
+		const std::filesystem::path _directory;
+};
 
-	return response;
-}
+class BulkFetcher
+{
+	public:
+		BulkFetcher(const std::vector<UUID>& MBIDs, const FetchSettings& settings, FeaturesCallback callback)
+		: _settings {settings}
+		, _callback {std::move(callback)}
+		, _clients(std::max<std::size_t>(1, settings.maxConcurrentRequests))
+		{
+			if (!_settings.cacheDirectory.empty())
+				_cache.emplace(_settings.cacheDirectory);
 
-std::string
-extractLowLevelFeatures(const UUID& mbid)
+			_mbids.reserve(MBIDs.size());
+			for (const UUID& mbid : MBIDs)
+				_mbids.emplace_back(mbid.getAsString());
+
+			_retryTimers.reserve(_clients.size());
+			for (std::size_t slot {}; slot < _clients.size(); ++slot)
+				_retryTimers.emplace_back(_ioService);
+		}
+
+		void run()
+		{
+			if (_cache)
+				reportCachedFeatures();
+
+			for (std::size_t slot {}; slot < _clients.size(); ++slot)
+				startNextRequest(slot);
+
+			_ioService.run();
+		}
+
+	private:
+		struct Request
+		{
+			std::vector<std::string>	mbids;
+			std::size_t					retryCount {};
+		};
+
+		// Only keeps the MBIDs that are not cached
+		void reportCachedFeatures()
+		{
+			std::vector<std::string> uncachedMBIDs;
+			std::map<std::string, std::string> lowLevelFeatures;
+			std::size_t cachedCount {};
+			std::size_t pendingCount {};
+
+			auto report {[&]
+			{
+				if (pendingCount > 0 && !_callback(pendingCount, lowLevelFeatures))
+					_stop = true;
+
+				lowLevelFeatures.clear();
+				pendingCount = 0;
+			}};
+
+			for (const std::string& mbid : _mbids)
+			{
+				if (_stop)
+					break;
+
+				std::optional<std::string> cachedFeatures {_cache->get(mbid)};
+				if (!cachedFeatures)
+				{
+					uncachedMBIDs.push_back(mbid);
+					continue;
+				}
+
+				if (!cachedFeatures->empty())
+					lowLevelFeatures.emplace(mbid, std::move(*cachedFeatures));
+
+				cachedCount++;
+				if (++pendingCount == maxMBIDsPerRequest)
+					report();
+			}
+			if (!_stop)
+				report();
+
+			LMS_LOG(DBUPDATER, INFO) << "Found " << cachedCount << " cached MBID(s), " << uncachedMBIDs.size() << " to request";
+			_mbids = std::move(uncachedMBIDs);
+		}
+
+		void startNextRequest(std::size_t slot)
+		{
+			_clients[slot].reset();
+
+			if (_stop || _nextMBIDIndex >= _mbids.size())
+				return;
+
+			const std::size_t count {std::min(maxMBIDsPerRequest, _mbids.size() - _nextMBIDIndex)};
+			Request request;
+			request.mbids.assign(std::next(std::cbegin(_mbids), _nextMBIDIndex), std::next(std::cbegin(_mbids), _nextMBIDIndex + count));
+			_nextMBIDIndex += count;
+
+			sendRequest(slot, std::move(request));
+		}
+
+		void sendRequest(std::size_t slot, Request request)
+		{
+			const std::string url {getLowLevelBulkURL(request.mbids)};
+
+			auto client {std::make_unique<Wt::Http::Client>(_ioService)};
+			client->setFollowRedirect(true);
+			client->setSslCertificateVerificationEnabled(true);
+			client->setMaximumResponseSize(request.mbids.size() * 256*1024);
+
+			client->done().connect([this, slot, url, request](Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
+			{
+				if (ec)
+					LMS_LOG(DBUPDATER, ERROR) << "GET request to url '" << url << "' failed: " << ec.message();
+				else if (msg.status() != 200)
+					LMS_LOG(DBUPDATER, ERROR) << "GET request to url '" << url << "' failed: status = " << msg.status() << ", body = " << msg.body();
+
+				// Transient failures: network errors, server errors and throttling
+				const bool retryable {ec || msg.status() == 429 || msg.status() >= 500};
+				if (retryable && !_stop && request.retryCount < _settings.maxRetryCount)
+				{
+					retryRequest(slot, request);
+					return;
+				}
+
+				std::optional<std::map<std::string, std::string>> lowLevelFeatures;
+				if (!ec && msg.status() == 200)
+					lowLevelFeatures = parseLowLevelBulkResponse(msg.body(), request.mbids);
+
+				if (lowLevelFeatures && _cache)
+				{
+					for (const std::string& mbid : request.mbids)
+					{
+						auto itFeatures {lowLevelFeatures->find(mbid)};
+						_cache->set(mbid, itFeatures != std::cend(*lowLevelFeatures) ? itFeatures->second : "");
+					}
+				}
+
+				onRequestComplete(slot, request.mbids.size(), lowLevelFeatures ? *lowLevelFeatures : std::map<std::string, std::string> {});
+			});
+
+			if (!client->get(url))
+			{
+				LMS_LOG(DBUPDATER, ERROR) << "Cannot perform a GET request to url '" << url << "'";
+				onRequestComplete(slot, request.mbids.size(), {});
+			}
+
+			_clients[slot] = std::move(client);
+		}
+
+		void retryRequest(std::size_t slot, Request request)
+		{
+			const std::chrono::milliseconds delay {_settings.retryBaseDelay * (std::size_t {1} << std::min<std::size_t>(request.retryCount, 16))};
+			request.retryCount++;
+
+			LMS_LOG(DBUPDATER, INFO) << "Retrying request in " << delay.count() << " ms (attempt " << request.retryCount << "/" << _settings.maxRetryCount << ")";
+
+			boost::asio::steady_timer& timer {_retryTimers[slot]};
+			timer.expires_from_now(delay);
+			timer.async_wait([this, slot, request {std::move(request)}](const boost::system::error_code& ec) mutable
+			{
+				if (ec)
+					return;
+
+				// The failed client is no longer in its handler here
+				sendRequest(slot, std::move(request));
+			});
+		}
+
+		void onRequestComplete(std::size_t slot, std::size_t requestedCount, const std::map<std::string, std::string>& lowLevelFeatures)
+		{
+			if (!_callback(requestedCount, lowLevelFeatures))
+				_stop = true;
+
+			// Do not destroy the client from its own handler
+			_ioService.post([this, slot] { startNextRequest(slot); });
+		}
+
+		const FetchSettings _settings;
+		FeaturesCallback _callback;
+		std::optional<FeaturesCache> _cache;
+		std::vector<std::string> _mbids;
+		std::size_t _nextMBIDIndex {};
+		bool _stop {};
+
+		boost::asio::io_service _ioService;
+		std::vector<std::unique_ptr<Wt::Http::Client>> _clients;
+		std::vector<boost::asio::steady_timer> _retryTimers;
+};
+
+} // namespace
+
+void
+extractLowLevelFeatures(const std::vector<UUID>& MBIDs, const FetchSettings& settings, FeaturesCallback callback)
 {
-	return getJsonData(mbid);
+	BulkFetcher fetcher {MBIDs, settings, std::move(callback)};
+	fetcher.run();
 }
 
-} // namespace Scanner::AcousticBrainz
+} // namespace AcousticBrainz
@@ -19,12 +19,34 @@
 
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
 #include <string>
+#include <vector>
 
 class UUID;
 
 namespace AcousticBrainz
 {
-	std::string extractLowLevelFeatures(const UUID& MBID);
+	// Called each time a request is complete
+	// lowLevelFeatures contains the JSON encoded features of the recordings that could be fetched, keyed by MBID
+	// Return false to stop sending new requests
+	using FeaturesCallback = std::function<bool(std::size_t requestedCount, const std::map<std::string, std::string>& lowLevelFeatures)>;
+
+	struct FetchSettings
+	{
+		std::size_t					maxConcurrentRequests {4};
+		std::size_t					maxRetryCount {3};			// for requests that failed because of network errors, server errors or throttling
+		std::chrono::milliseconds	retryBaseDelay {1000};		// doubled on each retry
+		std::filesystem::path		cacheDirectory;				// empty means no cache
+	};
+
+	// Fetches the low level features of the given recordings, using bulk requests
+	// At most maxConcurrentRequests requests are in flight at the same time
+	// Responses are kept in the cache directory, by MBID (recordings without features as well): cached recordings are not requested again
+	// Blocks until all the requests are complete, the callback is called from the calling thread
+	void extractLowLevelFeatures(const std::vector<UUID>& MBIDs, const FetchSettings& settings, FeaturesCallback callback);
 }
 
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileSystemWatcher.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#include "utils/Exception.hpp"
+#include "utils/Logger.hpp"
+
+namespace Scanner {
+
+namespace {
+
+constexpr std::uint32_t watchMask {IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR};
+
+} // namespace
+
+FileSystemWatcher::FileSystemWatcher(const std::filesystem::path& rootDirectory, std::chrono::milliseconds debounceDelay, ChangesCallback callback)
+: _rootDirectory {rootDirectory}
+, _debounceDelay {debounceDelay}
+, _callback {std::move(callback)}
+{
+	_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotifyFd < 0)
+		throw LmsException {"Cannot init inotify: " + std::string {::strerror(errno)}};
+
+	_stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_stopFd < 0)
+	{
+		::close(_inotifyFd);
+		throw LmsException {"Cannot create eventfd: " + std::string {::strerror(errno)}};
+	}
+
+	try
+	{
+		if (!addWatch(_rootDirectory))
+			throw LmsException {"Cannot watch directory '" + _rootDirectory.string() + "'"};
+
+		addWatchesRecursive(_rootDirectory);
+	}
+	catch (LmsException&)
+	{
+		::close(_stopFd);
+		::close(_inotifyFd);
+		throw;
+	}
+
+	LMS_LOG(DBUPDATER, INFO) << "Watching " << _watchedDirectories.size() << " directories in '" << _rootDirectory.string() << "'";
+
+	_thread = std::thread {[this] { run(); }};
+}
+
+FileSystemWatcher::~FileSystemWatcher()
+{
+	const std::uint64_t value {1};
+	if (::write(_stopFd, &value, sizeof(value)) != sizeof(value))
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot notify watcher to stop: " << ::strerror(errno);
+
+	_thread.join();
+
+	::close(_stopFd);
+	::close(_inotifyFd);
+}
+
+void
+FileSystemWatcher::addWatchesRecursive(const std::filesystem::path& directory)
+{
+	std::error_code ec;
+	std::filesystem::recursive_directory_iterator itPath {directory, std::filesystem::directory_options::follow_directory_symlink | std::filesystem::directory_options::skip_permission_denied, ec};
+	if (ec)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot explore directory '" << directory.string() << "': " << ec.message();
+		return;
+	}
+
+	for (; itPath != std::filesystem::recursive_directory_iterator {}; itPath.increment(ec))
+	{
+		if (ec)
+		{
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot explore directory '" << directory.string() << "': " << ec.message();
+			break;
+		}
+
+		if (itPath->is_directory(ec) && !ec)
+		{
+			if (!addWatch(itPath->path()))
+				throw LmsException {"Cannot watch directory '" + itPath->path().string() + "'"};
+		}
+	}
+}
+
+bool
+FileSystemWatcher::addWatch(const std::filesystem::path& directory)
+{
+	const int wd {::inotify_add_watch(_inotifyFd, directory.c_str(), watchMask)};
+	if (wd < 0)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot watch directory '" << directory.string() << "': " << ::strerror(errno);
+		return false;
+	}
+
+	_watchedDirectories[wd] = directory;
+	return true;
+}
+
+void
+FileSystemWatcher::run()
+{
+	std::array<struct pollfd, 2> fds {};
+	fds[0].fd = _inotifyFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = _stopFd;
+	fds[1].events = POLLIN;
+
+	while (true)
+	{
+		const bool changesPending {!_changedPaths.empty() || _fullRescanNeeded};
+
+		const int res {::poll(fds.data(), fds.size(), changesPending ? static_cast<int>(_debounceDelay.count()) : -1)};
+		if (res < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			LMS_LOG(DBUPDATER, ERROR) << "Watcher poll failed: " << ::strerror(errno);
+			return;
+		}
+
+		if (fds[1].revents & POLLIN)
+			return;
+
+		if (res == 0)
+		{
+			// Nothing happened during the debounce delay
+			LMS_LOG(DBUPDATER, DEBUG) << "Watcher: reporting " << _changedPaths.size() << " changed path(s), full rescan needed = " << _fullRescanNeeded;
+			_callback(_changedPaths, _fullRescanNeeded);
+			_changedPaths.clear();
+			_fullRescanNeeded = false;
+			continue;
+		}
+
+		if (fds[0].revents & POLLIN)
+			readEvents();
+	}
+}
+
+void
+FileSystemWatcher::readEvents()
+{
+	alignas(struct inotify_event) std::array<char, 4096> buffer;
+
+	while (true)
+	{
+		const ssize_t len {::read(_inotifyFd, buffer.data(), buffer.size())};
+		if (len <= 0)
+			return;
+
+		for (const char* ptr {buffer.data()}; ptr < buffer.data() + len; )
+		{
+			const struct inotify_event* event {reinterpret_cast<const struct inotify_event*>(ptr)};
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				LMS_LOG(DBUPDATER, INFO) << "Watcher: event queue overflow";
+				_fullRescanNeeded = true;
+				continue;
+			}
+
+			auto itDirectory {_watchedDirectories.find(event->wd)};
+			if (itDirectory == std::cend(_watchedDirectories))
+				continue;
+
+			if (event->mask & IN_IGNORED)
+			{
+				_watchedDirectories.erase(itDirectory);
+				continue;
+			}
+
+			if (event->mask & IN_DELETE_SELF)
+			{
+				_changedPaths.insert(itDirectory->second);
+				continue;
+			}
+
+			const std::filesystem::path path {event->len > 0 ? itDirectory->second / event->name : itDirectory->second};
+
+			if (event->mask & IN_ISDIR)
+			{
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					try
+					{
+						if (addWatch(path))
+							addWatchesRecursive(path);
+					}
+					catch (LmsException& e)
+					{
+						LMS_LOG(DBUPDATER, ERROR) << "Watcher: " << e.what() << ", changes in this directory may be missed";
+					}
+				}
+			}
+			else if (event->mask & IN_CREATE)
+			{
+				// wait for the file to be written
+				continue;
+			}
+
+			_changedPaths.insert(path);
+		}
+	}
+}
+
+} // namespace Scanner
+
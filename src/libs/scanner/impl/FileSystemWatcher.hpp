@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+namespace Scanner {
+
+// Watches a directory tree for changes, using inotify
+// Changes are debounced: the callback is called once no event has been received during the debounce delay
+class FileSystemWatcher
+{
+	public:
+		// changedPaths may be files or directories, that may not exist anymore
+		// fullRescanNeeded is set if some events have been lost
+		using ChangesCallback = std::function<void(const std::set<std::filesystem::path>& changedPaths, bool fullRescanNeeded)>;
+
+		// Throws LmsException if the directory cannot be watched
+		FileSystemWatcher(const std::filesystem::path& rootDirectory, std::chrono::milliseconds debounceDelay, ChangesCallback callback);
+		~FileSystemWatcher();
+
+		FileSystemWatcher(const FileSystemWatcher&) = delete;
+		FileSystemWatcher(FileSystemWatcher&&) = delete;
+		FileSystemWatcher& operator=(const FileSystemWatcher&) = delete;
+		FileSystemWatcher& operator=(FileSystemWatcher&&) = delete;
+
+		const std::filesystem::path& getRootDirectory() const { return _rootDirectory; }
+
+	private:
+		void addWatchesRecursive(const std::filesystem::path& directory);
+		bool addWatch(const std::filesystem::path& directory);
+		void run();
+		void readEvents();
+
+		const std::filesystem::path			_rootDirectory;
+		const std::chrono::milliseconds		_debounceDelay;
+		ChangesCallback						_callback;
+
+		int _inotifyFd {-1};
+		int _stopFd {-1};
+		std::unordered_map<int, std::filesystem::path>	_watchedDirectories;
+
+		std::set<std::filesystem::path>	_changedPaths;
+		bool							_fullRescanNeeded {};
+		std::thread						_thread;
+};
+
+} // namespace Scanner
+
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "database/Types.hpp"
+#include "utils/UUID.hpp"
+
+namespace Scanner {
+
+// Ids of the entities resolved during a scan, to avoid looking them up again for each track
+// Entries may be stale (entity removed, transaction rolled back): they must be checked when used
+// Name keys are interned: each name is stored once, whatever the number of entries using it
+class LookupCache
+{
+	public:
+		struct TypeAndNameHash
+		{
+			std::size_t operator()(const std::pair<Database::IdType, std::string_view>& key) const
+			{
+				return std::hash<Database::IdType> {}(key.first) ^ (std::hash<std::string_view> {}(key.second) << 1);
+			}
+		};
+
+		std::unordered_map<UUID, Database::IdType>				artistsByMBID;
+		std::unordered_map<UUID, Database::IdType>				releasesByMBID;
+		// Keys must be interned before being inserted
+		std::unordered_map<std::string_view, Database::IdType>	artistsByName;		// artists without MBID only
+		std::unordered_map<std::string_view, Database::IdType>	releasesByName;		// releases without MBID only
+		std::unordered_map<std::string_view, Database::IdType>	clusterTypesByName;
+		std::unordered_map<std::pair<Database::IdType, std::string_view>, Database::IdType, TypeAndNameHash>	clustersByTypeAndName;
+
+		// The returned view is valid until clear is called
+		std::string_view intern(std::string_view str)
+		{
+			auto it {_internedStrings.find(str)};
+			if (it != std::cend(_internedStrings))
+				return *it;
+
+			// deque: references are not invalidated when adding elements
+			const std::string& internedString {_strings.emplace_back(str)};
+			_internedStrings.insert(internedString);
+
+			return internedString;
+		}
+
+		void clear()
+		{
+			artistsByMBID.clear();
+			releasesByMBID.clear();
+			artistsByName.clear();
+			releasesByName.clear();
+			clusterTypesByName.clear();
+			clustersByTypeAndName.clear();
+
+			_internedStrings.clear();
+			_strings.clear();
+		}
+
+	private:
+		std::deque<std::string>					_strings;
+		std::unordered_set<std::string_view>	_internedStrings;
+};
+
+} // namespace Scanner
@@ -19,23 +19,48 @@
 
 #include "MediaScanner.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
 #include <boost/asio/placeholders.hpp>
 
 #include <Wt/WLocalDateTime.h>
 
 #include "database/Artist.hpp"
 #include "database/Cluster.hpp"
+#include "database/Db.hpp"
 #include "database/Release.hpp"
+#include "database/ScanCheckpoint.hpp"
+#include "database/ScannedDirectory.hpp"
+#include "database/ScannerLease.hpp"
 #include "database/ScanSettings.hpp"
 #include "database/Track.hpp"
 #include "database/TrackArtistLink.hpp"
 #include "database/TrackFeatures.hpp"
 #include "metadata/TagLibParser.hpp"
+#include "cover/ICoverArtGrabber.hpp"
 #include "recommendation/IEngine.hpp"
+#include "utils/ActiveStreamCounter.hpp"
+#include "utils/CpuAffinity.hpp"
 #include "utils/Exception.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include "utils/Path.hpp"
+#include "utils/Readiness.hpp"
+#include "utils/SamplingProfiler.hpp"
+#include "utils/Scheduler.hpp"
+#include "utils/Service.hpp"
+#include "utils/String.hpp"
+#include "utils/ThreadPriority.hpp"
 #include "utils/UUID.hpp"
 #include "AcousticBrainzUtils.hpp"
 
@@ -89,6 +114,92 @@ isPathInParentPath(const std::filesystem::path& path, const std::filesystem::pat
 	return false;
 }
 
+std::size_t
+getParserWorkerCount()
+{
+	const std::size_t configWorkerCount {Service<IConfig>::get()->getULong("scanner-parser-thread-count", 0)};
+	if (configWorkerCount)
+		return configWorkerCount;
+
+	return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+AcousticBrainz::FetchSettings
+getFeaturesFetchSettings()
+{
+	AcousticBrainz::FetchSettings settings;
+	settings.maxConcurrentRequests = Service<IConfig>::get()->getULong("acousticbrainz-max-concurrent-requests", 4);
+	if (Service<IConfig>::get()->getBool("acousticbrainz-cache", true))
+		settings.cacheDirectory = Service<IConfig>::get()->getPath("working-dir") / "cache" / "acousticbrainz";
+
+	return settings;
+}
+
+// 0 means all the scheduler I/O threads
+std::size_t
+getFileCheckWorkerCount()
+{
+	return Service<IConfig>::get()->getULong("scanner-file-check-thread-count", 0);
+}
+
+Metrics::Counter& completeScanCount {Metrics::getCounter("lms_scanner_complete_scans_total", "Number of scans that were not aborted")};
+Metrics::Counter& scannedFileCount {Metrics::getCounter("lms_scanner_scanned_files_total", "Number of files read by the scanner")};
+Metrics::Counter& changedPathScanCount {Metrics::getCounter("lms_scanner_watched_changes_total", "Number of batches of watched changes processed")};
+Metrics::Histogram& scanDuration {Metrics::getHistogram("lms_scanner_scan_duration_seconds", "Duration of the complete scans")};
+
+// Defaults to "hostname:pid", so that several processes of a same host do not collide
+std::string
+getNodeName()
+{
+	std::string nodeName {Service<IConfig>::get()->getString("scanner-node-name", "")};
+	if (!nodeName.empty())
+		return nodeName;
+
+	char hostName[256] {};
+	if (::gethostname(hostName, sizeof(hostName) - 1) != 0)
+		hostName[0] = '\0';
+
+	return std::string {hostName} + ":" + std::to_string(::getpid());
+}
+
+// Accumulates the wall and CPU times spent in its scope
+class ScopedTimer
+{
+	public:
+		ScopedTimer(Scanner::ScanStepTimings& timings) : _timings {timings} {}
+		~ScopedTimer()
+		{
+			_timings.wallTime += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _wallStart);
+			_timings.cpuTime += std::chrono::milliseconds {(std::clock() - _cpuStart) * 1000 / CLOCKS_PER_SEC};
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer(ScopedTimer&&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+	private:
+		Scanner::ScanStepTimings& _timings;
+		const std::chrono::steady_clock::time_point _wallStart {std::chrono::steady_clock::now()};
+		const std::clock_t _cpuStart {std::clock()};
+};
+
+// Calls the given function when leaving its scope, including on exceptions
+class ScopedCleanup
+{
+	public:
+		ScopedCleanup(std::function<void()> cleanup) : _cleanup {std::move(cleanup)} {}
+		~ScopedCleanup() { _cleanup(); }
+
+		ScopedCleanup(const ScopedCleanup&) = delete;
+		ScopedCleanup(ScopedCleanup&&) = delete;
+		ScopedCleanup& operator=(const ScopedCleanup&) = delete;
+		ScopedCleanup& operator=(ScopedCleanup&&) = delete;
+
+	private:
+		std::function<void()> _cleanup;
+};
+
 static
 Artist::pointer
 createArtist(Session& session, const MetaData::Artist& artistInfo)
@@ -120,8 +231,24 @@ updateArtistIfNeeded(const Artist::pointer& artist, const MetaData::Artist& arti
 	}
 }
 
+// Returns an empty pointer if the cached entity does not exist anymore
+template <typename T, typename Cache, typename Key>
+typename T::pointer
+getCachedEntity(Session& session, Cache& cache, const Key& key)
+{
+	auto it {cache.find(key)};
+	if (it == std::end(cache))
+		return typename T::pointer {};
+
+	typename T::pointer entity {T::getById(session, it->second)};
+	if (!entity)
+		cache.erase(it);
+
+	return entity;
+}
+
 std::vector<Artist::pointer>
-getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artistsInfo)
+getOrCreateArtists(Session& session, Scanner::LookupCache& cache, const std::vector<MetaData::Artist>& artistsInfo)
 {
 	std::vector<Artist::pointer> artists;
 
@@ -132,12 +259,18 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 		// First try to get by MBID
 		if (artistInfo.musicBrainzArtistID)
 		{
-			artist = Artist::getByMBID(session, *artistInfo.musicBrainzArtistID);
+			const UUID& mbid {*artistInfo.musicBrainzArtistID};
+
+			artist = getCachedEntity<Artist>(session, cache.artistsByMBID, mbid);
+			if (!artist)
+				artist = Artist::getByMBID(session, mbid);
+
 			if (!artist)
 				artist = createArtist(session, artistInfo);
 			else
 				updateArtistIfNeeded(artist, artistInfo);
 
+			cache.artistsByMBID[mbid] = artist.id();
 			artists.emplace_back(std::move(artist));
 			continue;
 		}
@@ -145,13 +278,17 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 		// Fall back on artist name (collisions may occur)
 		if (!artistInfo.name.empty())
 		{
-			for (const Artist::pointer& sameNamedArtist : Artist::getByName(session, artistInfo.name))
+			artist = getCachedEntity<Artist>(session, cache.artistsByName, std::string_view {artistInfo.name});
+			if (!artist)
 			{
-				// Do not fallback on artist that is correctly tagged
-				if (!sameNamedArtist->getMBID())
+				for (const Artist::pointer& sameNamedArtist : Artist::getByName(session, artistInfo.name))
 				{
-					artist = sameNamedArtist;
-					break;
+					// Do not fallback on artist that is correctly tagged
+					if (!sameNamedArtist->getMBID())
+					{
+						artist = sameNamedArtist;
+						break;
+					}
 				}
 			}
 
@@ -161,6 +298,7 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 			else
 				updateArtistIfNeeded(artist, artistInfo);
 
+			cache.artistsByName[cache.intern(artistInfo.name)] = artist.id();
 			artists.emplace_back(std::move(artist));
 			continue;
 		}
@@ -170,14 +308,19 @@ getOrCreateArtists(Session& session, const std::vector<MetaData::Artist>& artist
 }
 
 Release::pointer
-getOrCreateRelease(Session& session, const MetaData::Album& album)
+getOrCreateRelease(Session& session, Scanner::LookupCache& cache, const MetaData::Album& album)
 {
 	Release::pointer release;
 
 	// First try to get by MBID
 	if (album.musicBrainzAlbumID)
 	{
-		release = Release::getByMBID(session, *album.musicBrainzAlbumID);
+		const UUID& mbid {*album.musicBrainzAlbumID};
+
+		release = getCachedEntity<Release>(session, cache.releasesByMBID, mbid);
+		if (!release)
+			release = Release::getByMBID(session, mbid);
+
 		if (!release)
 		{
 			release = Release::create(session, album.name, album.musicBrainzAlbumID);
@@ -188,19 +331,24 @@ getOrCreateRelease(Session& session, const MetaData::Album& album)
 			release.modify()->setName(album.name);
 		}
 
+		cache.releasesByMBID[mbid] = release.id();
 		return release;
 	}
 
 	// Fall back on release name (collisions may occur)
 	if (!album.name.empty())
 	{
-		for (const Release::pointer& sameNamedRelease : Release::getByName(session, album.name))
+		release = getCachedEntity<Release>(session, cache.releasesByName, std::string_view {album.name});
+		if (!release)
 		{
-			// do not fallback on properly tagged releases
-			if (!sameNamedRelease->getMBID())
+			for (const Release::pointer& sameNamedRelease : Release::getByName(session, album.name))
 			{
-				release = sameNamedRelease;
-				break;
+				// do not fallback on properly tagged releases
+				if (!sameNamedRelease->getMBID())
+				{
+					release = sameNamedRelease;
+					break;
+				}
 			}
 		}
 
@@ -208,6 +356,7 @@ getOrCreateRelease(Session& session, const MetaData::Album& album)
 		if (!release)
 			release = Release::create(session, album.name);
 
+		cache.releasesByName[cache.intern(album.name)] = release.id();
 		return release;
 	}
 
@@ -215,22 +364,29 @@ getOrCreateRelease(Session& session, const MetaData::Album& album)
 }
 
 std::vector<Cluster::pointer>
-getOrCreateClusters(Session& session, const MetaData::Clusters& clustersNames)
+getOrCreateClusters(Session& session, Scanner::LookupCache& cache, const MetaData::Clusters& clustersNames)
 {
 	std::vector< Cluster::pointer > clusters;
 
-	for (auto clusterNames : clustersNames)
+	for (const auto& [clusterTypeName, clusterNames] : clustersNames)
 	{
-		auto clusterType = ClusterType::getByName(session, clusterNames.first);
+		auto clusterType {getCachedEntity<ClusterType>(session, cache.clusterTypesByName, std::string_view {clusterTypeName})};
+		if (!clusterType)
+			clusterType = ClusterType::getByName(session, clusterTypeName);
 		if (!clusterType)
 			continue;
 
-		for (auto clusterName : clusterNames.second)
+		cache.clusterTypesByName[cache.intern(clusterTypeName)] = clusterType.id();
+
+		for (const std::string& clusterName : clusterNames)
 		{
-			auto cluster = clusterType->getCluster(clusterName);
+			auto cluster {getCachedEntity<Cluster>(session, cache.clustersByTypeAndName, std::make_pair(clusterType.id(), std::string_view {clusterName}))};
+			if (!cluster)
+				cluster = clusterType->getCluster(clusterName);
 			if (!cluster)
 				cluster = Cluster::create(session, clusterType, clusterName);
 
+			cache.clustersByTypeAndName[std::make_pair(clusterType.id(), cache.intern(clusterName))] = cluster.id();
 			clusters.push_back(cluster);
 		}
 	}
@@ -249,14 +405,45 @@ createMediaScanner(Database::Db& db, Recommendation::IEngine& recommendationEngi
 }
 
 MediaScanner::MediaScanner(Database::Db& db, Recommendation::IEngine& recommendationEngine)
-: _recommendationEngine {recommendationEngine}
-, _dbSession {db}
+: _db {db}
+, _recommendationEngine {recommendationEngine}
+, _dbSession {std::make_unique<Session>(db)}
+, _rebuildOnFullScan {Service<IConfig>::get()->getBool("scanner-rebuild-on-full-scan", false) && !Service<IConfig>::get()->getBool("scanner-leader-election", false)}
+, _parserWorkerCount {getParserWorkerCount()}
+, _deviceParserMaxWorkerCount {Service<IConfig>::get()->getULong("scanner-device-parser-thread-count", 0)}
+, _fileCheckWorkerCount {getFileCheckWorkerCount()}
+, _writeBatchSize {std::max<std::size_t>(1, Service<IConfig>::get()->getULong("scanner-write-batch-size", 100))}
+, _writeBatchMaxDuration {Service<IConfig>::get()->getULong("scanner-write-batch-max-duration", 1000)}
+, _maxFilesPerSecond {Service<IConfig>::get()->getULong("scanner-max-files-per-second", 0)}
+, _maxBytesPerSecond {Service<IConfig>::get()->getULong("scanner-max-mbytes-per-second", 0) * 1024 * 1024}
+, _pauseActiveStreamCount {Service<IConfig>::get()->getULong("scanner-pause-active-stream-count", 0)}
+, _lowPriority {Service<IConfig>::get()->getBool("scanner-low-priority", false)}
+, _cpuSet {CpuAffinity::parseCpuSet(Service<IConfig>::get()->getString("background-cpu-set", ""))}
+, _skipUnchangedDirectories {Service<IConfig>::get()->getBool("scanner-skip-unchanged-directories", false)}
+, _estimateFileCount {Service<IConfig>::get()->getBool("scanner-estimate-file-count", false)}
+, _reuseAudioProperties {Service<IConfig>::get()->getBool("scanner-reuse-audio-properties", false)}
+, _cacheTags {Service<IConfig>::get()->getBool("scanner-cache-tags", true)}
+, _prioritizeNewFiles {Service<IConfig>::get()->getBool("scanner-prioritize-new-files", true)}
+, _featuresFetchSettings {getFeaturesFetchSettings()}
+, _checkpointInterval {Service<IConfig>::get()->getULong("scanner-checkpoint-interval", 60)}
+, _watchEnabled {Service<IConfig>::get()->getBool("scanner-watch-enable", false)}
+, _watchDebounceDelay {Service<IConfig>::get()->getULong("scanner-watch-debounce-delay", 5000)}
+, _leaderElection {Service<IConfig>::get()->getBool("scanner-leader-election", false)}
+, _leaseDuration {std::max<unsigned long>(3, Service<IConfig>::get()->getULong("scanner-leader-lease-duration", 30))}
+, _nodeName {getNodeName()}
 {
-	// For now, always use TagLib
-	_metadataParser = std::make_unique<MetaData::TagLibParser>();
-
 	_ioService.setThreadCount(1);
 
+	// The other processes would keep using the replaced database file
+	if (_leaderElection && Service<IConfig>::get()->getBool("scanner-rebuild-on-full-scan", false))
+		LMS_LOG(DBUPDATER, WARNING) << "Database rebuilds are not supported with leader election, full scans update the current database";
+
+	for (const std::string& size : StringUtils::splitString(Service<IConfig>::get()->getString("scanner-generate-cover-sizes", ""), " ,"))
+	{
+		if (const auto value {StringUtils::readAs<std::size_t>(size)})
+			_coverSizes.push_back(*value);
+	}
+
 	refreshScanSettings();
 
 	start();
@@ -273,12 +460,16 @@ MediaScanner::start()
 {
 	std::scoped_lock lock {_controlMutex};
 
+	Readiness::declare("recommendation");
 	_ioService.post([this]
 	{
-		if (_abortScan)
+		if (_scanCancellation.isCancelled())
 			return;
 
-		_recommendationEngine.load(false,
+		// Similarity requests are served by the classifiers that are already loaded
+		const Metrics::ScopedWarming warming {"recommendation"};
+		CpuAffinity::setCurrentThreadAffinity(_cpuSet);
+		_recommendationEngine.load(false, _scanCancellation,
 				[](const Recommendation::IEngine::Progress& progress)
 				{
 					LMS_LOG(DBUPDATER, DEBUG) << "Reloading recommendation : " << progress.processedElems << "/" << progress.totalElems;
@@ -287,17 +478,35 @@ MediaScanner::start()
 	});
 
 	_ioService.start();
+
+	if (_leaderElection)
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Leader election enabled, node name = '" << _nodeName << "'";
+		_leaseThread = std::thread {[this] { runLease(); }};
+	}
 }
 
 void
 MediaScanner::stop()
 {
+	// The lease thread may abort scans, it must not be running once _controlMutex is held
+	if (_leaseThread.joinable())
+	{
+		{
+			std::scoped_lock lock {_leaseMutex};
+			_leaseQuit = true;
+		}
+		_leaseCondition.notify_all();
+
+		_leaseThread.join();
+	}
+
 	std::scoped_lock lock {_controlMutex};
 
-	_abortScan = true;
+	_scanCancellation.cancel();
 	_scheduleTimer.cancel();
-	_recommendationEngine.cancelLoad();
 	_ioService.stop();
+	_watchers.clear();
 }
 
 void
@@ -308,13 +517,14 @@ MediaScanner::abortScan()
 
 	LMS_LOG(DBUPDATER, DEBUG) << "Waiting for the scan to abort...";
 
-	_abortScan = true;
+	// The recommendation engine load and the scheduled tasks share the token
+	_scanCancellation.cancel();
 	_scheduleTimer.cancel();
-	_recommendationEngine.cancelLoad();
 	_ioService.stop();
 	LMS_LOG(DBUPDATER, DEBUG) << "Scan abort done!";
 
-	_abortScan = false;
+	// Only used by the scan thread, stopped at this point
+	_scanCancellation = CancellationToken {};
 	_ioService.start();
 }
 
@@ -324,7 +534,7 @@ MediaScanner::requestImmediateScan(bool force)
 	abortScan();
 	_ioService.post([=]()
 	{
-		if (_abortScan)
+		if (_scanCancellation.isCancelled())
 			return;
 
 		scheduleScan(force);
@@ -337,7 +547,7 @@ MediaScanner::requestReload()
 	abortScan();
 	_ioService.post([=]()
 	{
-		if (_abortScan)
+		if (_scanCancellation.isCancelled())
 			return;
 
 		scheduleNextScan();
@@ -362,12 +572,42 @@ MediaScanner::getStatus() const
 void
 MediaScanner::scheduleNextScan()
 {
+	if (!isScanAllowed())
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Not holding the scanner lease, no scan scheduled";
+
+		{
+			std::unique_lock lock {_statusMutex};
+			_curState = State::NotScheduled;
+			_nextScheduledScan = {};
+		}
+
+		_sigScheduled.emit(_nextScheduledScan);
+		return;
+	}
+
 	LMS_LOG(DBUPDATER, INFO) << "Scheduling next scan";
 
 	refreshScanSettings();
+	refreshWatchers();
 
 	const Wt::WDateTime now {Wt::WLocalDateTime::currentServerDateTime().toUTC()};
 
+	if (hasResumableCheckpoint())
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Interrupted scan found, resuming it";
+		scheduleScan(false);
+
+		{
+			std::unique_lock lock {_statusMutex};
+			_curState = State::Scheduled;
+			_nextScheduledScan = now;
+		}
+
+		_sigScheduled.emit(_nextScheduledScan);
+		return;
+	}
+
 	Wt::WDate nextScanDate;
 	switch (_updatePeriod)
 	{
@@ -415,305 +655,1143 @@ MediaScanner::scheduleNextScan()
 }
 
 void
-MediaScanner::countAllFiles(ScanStats& stats)
+MediaScanner::countAllFiles(ScanStats& stats, bool collectNewFiles)
 {
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::DiscoveringFiles};
 
 	stats.filesScanned = 0;
+	_newFiles.clear();
 	notifyInProgress(stepStats);
 
-	exploreFilesRecursive(_mediaDirectory, [&](std::error_code ec, const std::filesystem::path& path)
+	for (const std::filesystem::path& mediaDirectory : _mediaDirectories)
 	{
-		if (_abortScan)
-			return false;
-
-		if (!ec && isFileSupported(path, _fileExtensions))
+		exploreFilesRecursive(mediaDirectory, [&](std::error_code ec, const std::filesystem::path& path)
 		{
-			stats.filesScanned++;
-			stepStats.processedElems++;
-			notifyInProgressIfNeeded(stepStats);
-		}
+			if (_scanCancellation.isCancelled())
+				return false;
 
-		return true;
-	});
+			if (!ec && isFileSupported(path, _fileExtensions))
+			{
+				stats.filesScanned++;
+				stepStats.processedElems++;
+				notifyInProgressIfNeeded(stepStats);
+
+				if (collectNewFiles && _trackFileInfos.find(path) == std::cend(_trackFileInfos))
+					_newFiles.push_back(path);
+			}
+
+			return true;
+		});
+	}
 	notifyInProgress(stepStats);
 }
 
 void
-MediaScanner::scheduleScan(bool force, const Wt::WDateTime& dateTime)
+MediaScanner::estimateFileCount(ScanStats& stats)
 {
-	auto cb {[=](boost::system::error_code ec)
+	// Use the previous scan if any, otherwise the number of tracks in the database
 	{
-		if (ec)
-			return;
-
-		scan(force);
-	}};
+		std::shared_lock lock {_statusMutex};
 
-	if (dateTime.isNull())
-	{
-		LMS_LOG(DBUPDATER, INFO) << "Scheduling next scan right now";
-		_scheduleTimer.expires_from_now(std::chrono::seconds {0});
-		_scheduleTimer.async_wait(cb);
+		if (_lastCompleteScanStats && _lastCompleteScanStats->filesScanned)
+		{
+			stats.filesScanned = _lastCompleteScanStats->filesScanned;
+			return;
+		}
 	}
-	else
-	{
-		std::chrono::system_clock::time_point timePoint {dateTime.toTimePoint()};
-		std::time_t t {std::chrono::system_clock::to_time_t(timePoint)};
-		char ctimeStr[26];
 
-		LMS_LOG(DBUPDATER, INFO) << "Scheduling next scan at " << std::string(::ctime_r(&t, ctimeStr));
-		_scheduleTimer.expires_at(timePoint);
-		_scheduleTimer.async_wait(cb);
-	}
+	auto transaction {_dbSession->createSharedTransaction()};
+	stats.filesScanned = Track::getCount(*_dbSession);
 }
 
 void
-MediaScanner::scan(bool forceScan)
+MediaScanner::loadTrackFileInfos()
 {
-	scanStarted().emit();
+	LMS_LOG(DBUPDATER, DEBUG) << "Loading track file infos...";
+
+	_trackFileInfos.clear();
 
+	std::vector<Track::FileInfo> fileInfos;
 	{
-		std::unique_lock lock {_statusMutex};
-		_curState = State::InProgress;
-		_nextScheduledScan = {};
+		auto transaction {_dbSession->createSharedTransaction()};
+		fileInfos = Track::getAllFileInfos(*_dbSession);
 	}
 
-	ScanStats stats;
-	stats.startTime = Wt::WLocalDateTime::currentDateTime().toUTC();
-
-	LMS_LOG(UI, INFO) << "New scan started!";
-
-	refreshScanSettings();
+	_trackFileInfos.reserve(fileInfos.size());
+	for (Track::FileInfo& fileInfo : fileInfos)
+		_trackFileInfos.emplace(std::move(fileInfo.path), TrackFileInfo {fileInfo.id, fileInfo.lastWriteTime.toTime_t(), fileInfo.scanVersion, fileInfo.fileSize});
 
-	removeMissingTracks(stats);
+	LMS_LOG(DBUPDATER, DEBUG) << "Loaded " << _trackFileInfos.size() << " track file infos";
+}
 
-	LMS_LOG(DBUPDATER, DEBUG) << "Counting files in media directory '" << _mediaDirectory.string() << "'...";
-	countAllFiles(stats);
-	LMS_LOG(DBUPDATER, DEBUG) << "-> Nb files = " << stats.filesScanned;
+void
+MediaScanner::loadScannedDirectoryInfos()
+{
+	LMS_LOG(DBUPDATER, DEBUG) << "Loading scanned directory infos...";
 
-	LMS_LOG(UI, INFO) << "Checks complete, force scan = " << forceScan;
+	_scannedDirectoryInfos.clear();
 
-	LMS_LOG(DBUPDATER, INFO) << "scaning media directory '" << _mediaDirectory.string() << "'...";
-	scanMediaDirectory(_mediaDirectory, forceScan, stats);
-	LMS_LOG(DBUPDATER, INFO) << "scaning media directory '" << _mediaDirectory.string() << "' DONE";
+	{
+		auto transaction {_dbSession->createSharedTransaction()};
 
-	removeOrphanEntries();
+		for (const ScannedDirectory::pointer& scannedDirectory : ScannedDirectory::getAll(*_dbSession))
+			_scannedDirectoryInfos.emplace(scannedDirectory->getPath(), ScannedDirectoryInfo {scannedDirectory->getLastWriteTime().toTime_t(), scannedDirectory->getScanVersion(), {}});
+	}
 
-	if (!_abortScan)
+	for (const auto& [directory, directoryInfo] : _scannedDirectoryInfos)
 	{
-		checkDuplicatedAudioFiles(stats);
-		fetchTrackFeatures(stats);
-		reloadSimilarityEngine(stats);
+		auto itParent {_scannedDirectoryInfos.find(directory.parent_path())};
+		if (itParent != std::end(_scannedDirectoryInfos) && itParent->first != directory)
+			itParent->second.subDirectories.push_back(directory);
 	}
 
-	LMS_LOG(DBUPDATER, INFO) << "Scan " << (_abortScan ? "aborted" : "complete") << ". Changes = " << stats.nbChanges() << " (added = " << stats.additions << ", removed = " << stats.deletions << ", updated = " << stats.updates << "), Not changed = " << stats.skips << ", Scanned = " << stats.scans << " (errors = " << stats.errors.size() << "), features fetched = " << stats.featuresFetched << ",  duplicates = " << stats.duplicates.size();
-
-	_dbSession.optimize();
+	// Explore the sub directories in the same order as the directory entries
+	for (auto& [directory, directoryInfo] : _scannedDirectoryInfos)
+		std::sort(std::begin(directoryInfo.subDirectories), std::end(directoryInfo.subDirectories));
 
-	if (!_abortScan)
+	for (const auto& [trackPath, trackFileInfo] : _trackFileInfos)
 	{
-		stats.stopTime = Wt::WLocalDateTime::currentDateTime().toUTC();
-		{
-			std::unique_lock lock {_statusMutex};
-
-			_lastCompleteScanStats = std::move(stats);
-			_currentScanStepStats.reset();
-		}
-
-		LMS_LOG(DBUPDATER, DEBUG) << "Scan not aborted, scheduling next scan!";
-		scheduleNextScan();
-
-		scanComplete().emit();
+		auto itDirectory {_scannedDirectoryInfos.find(trackPath.parent_path())};
+		if (itDirectory != std::end(_scannedDirectoryInfos))
+			itDirectory->second.trackCount++;
 	}
-	else
-	{
-		LMS_LOG(DBUPDATER, DEBUG) << "Scan aborted, not scheduling next scan!";
 
-		std::unique_lock lock {_statusMutex};
-
-		_curState = State::NotScheduled;
-		_currentScanStepStats.reset();
-	}
+	LMS_LOG(DBUPDATER, DEBUG) << "Loaded " << _scannedDirectoryInfos.size() << " scanned directory infos";
 }
 
-bool
-MediaScanner::fetchTrackFeatures(Database::IdType trackId, const UUID& MBID)
+void
+MediaScanner::saveScannedDirectoryInfos()
 {
-	std::map<std::string, double> features;
+	LMS_LOG(DBUPDATER, DEBUG) << "Saving " << _exploredDirectories.size() << " scanned directory infos...";
 
-	LMS_LOG(DBUPDATER, INFO) << "Fetching low level features for track '" << MBID.getAsString() << "'";
-	const std::string data {AcousticBrainz::extractLowLevelFeatures(MBID)};
-	if (data.empty())
-	{
-		LMS_LOG(DBUPDATER, ERROR) << "Track " << trackId << ", MBID = '" << MBID.getAsString() << "': cannot extract features using AcousticBrainz";
-		return false;
-	}
+	auto transaction {_dbSession->createUniqueTransaction()};
 
-	{
-		auto uniqueTransaction {_dbSession.createUniqueTransaction()};
+	ScannedDirectory::removeAll(*_dbSession);
+	for (const auto& [directory, lastWriteTime] : _exploredDirectories)
+		ScannedDirectory::create(*_dbSession, directory, lastWriteTime, _scanVersion);
+}
 
-		Wt::Dbo::ptr<Database::Track> track {Database::Track::getById(_dbSession, trackId)};
-		if (!track)
-			return false;
+bool
+MediaScanner::isCheckpointResumable(const ScanCheckpoint::pointer& checkpoint) const
+{
+	return checkpoint->getScanVersion() == _scanVersion
+		&& checkpoint->getMediaDirectories() == _mediaDirectories
+		&& checkpoint->getStep() >= static_cast<int>(ScanProgressStep::ScanningFiles)
+		&& checkpoint->getStep() < static_cast<int>(ScanProgressStepCount);
+}
 
-		Database::TrackFeatures::create(_dbSession, track, data);
-	}
+bool
+MediaScanner::hasResumableCheckpoint()
+{
+	auto transaction {_dbSession->createSharedTransaction()};
 
-	return true;
+	const ScanCheckpoint::pointer checkpoint {ScanCheckpoint::get(*_dbSession)};
+	return checkpoint && isCheckpointResumable(checkpoint);
 }
 
-void
-MediaScanner::fetchTrackFeatures(ScanStats& stats)
+std::optional<ScanProgressStep>
+MediaScanner::resumeFromCheckpoint(bool& forceScan, ScanStats& stats)
 {
-	if (_recommendationEngineType != ScanSettings::RecommendationEngineType::Features)
-		return;
-
-	ScanStepStats stepStats{stats.startTime, ScanProgressStep::FetchingTrackFeatures};
+	_lastCheckpointTime = std::chrono::steady_clock::now();
 
-	LMS_LOG(DBUPDATER, INFO) << "Fetching missing track features...";
+	auto transaction {_dbSession->createUniqueTransaction()};
 
-	struct TrackInfo
-	{
-		Database::IdType id;
-		UUID mbid;
-	};
+	const ScanCheckpoint::pointer checkpoint {ScanCheckpoint::get(*_dbSession)};
+	if (!checkpoint)
+		return std::nullopt;
 
-	const auto tracksToFetch {[&]()
+	// A forced scan cannot be resumed from a regular one
+	if (!isCheckpointResumable(checkpoint) || (forceScan && !checkpoint->isForceScan()))
 	{
-		std::vector<TrackInfo> res;
-
-		auto transaction {_dbSession.createSharedTransaction()};
+		LMS_LOG(DBUPDATER, INFO) << "Discarding the checkpoint of the interrupted scan";
+		ScanCheckpoint::removeAll(*_dbSession);
+		return std::nullopt;
+	}
 
-		auto tracks {Database::Track::getAllWithMBIDAndMissingFeatures(_dbSession)};
-		for (const auto& track : tracks)
-			res.emplace_back(TrackInfo {track.id(), *track->getMBID()});
+	const ScanProgressStep step {static_cast<ScanProgressStep>(checkpoint->getStep())};
 
-		return res;
-	}()};
+	forceScan = checkpoint->isForceScan();
+	stats.startTime = checkpoint->getStartTime();
 
-	stepStats.totalElems = tracksToFetch.size();
-	notifyInProgress(stepStats);
+	const ScanCheckpoint::Counters counters {checkpoint->getCounters()};
+	stats.filesScanned = counters.filesScanned;
+	stats.skips = counters.skips;
+	stats.scans = counters.scans;
+	stats.additions = counters.additions;
+	stats.deletions = counters.deletions;
+	stats.updates = counters.updates;
+	stats.moves = counters.moves;
+	stats.featuresFetched = counters.featuresFetched;
 
-	LMS_LOG(DBUPDATER, INFO) << "Found " << tracksToFetch.size() << " track(s) to fetch!";
+	LMS_LOG(DBUPDATER, INFO) << "Resuming interrupted scan at step '" << getScanProgressStepName(step) << "'";
 
-	for (const TrackInfo& trackToFetch : tracksToFetch)
+	if (step == ScanProgressStep::ScanningFiles)
 	{
-		if (_abortScan)
-			return;
+		for (const std::filesystem::path& directory : checkpoint->getDirectories())
+		{
+			if (DeviceWalker* walker {getDeviceWalker(directory)})
+			{
+				LMS_LOG(DBUPDATER, INFO) << "Resuming exploration after directory '" << directory.string() << "'";
+				walker->resumeDirectory = directory;
+			}
+		}
+	}
 
-		if (fetchTrackFeatures(trackToFetch.id, trackToFetch.mbid))
-			stats.featuresFetched++;
+	return step;
+}
 
-		stepStats.processedElems++;
-		notifyInProgressIfNeeded(stepStats);
+void
+MediaScanner::saveCheckpoint(ScanProgressStep step, const std::vector<std::filesystem::path>& directories, bool forceScan, const ScanStats& stats)
+{
+	ScanCheckpoint::Counters counters;
+	counters.filesScanned = stats.filesScanned;
+	counters.skips = stats.skips;
+	counters.scans = stats.scans;
+	counters.additions = stats.additions;
+	counters.deletions = stats.deletions;
+	counters.updates = stats.updates;
+	counters.moves = stats.moves;
+	counters.featuresFetched = stats.featuresFetched;
+
+	{
+		auto transaction {_dbSession->createUniqueTransaction()};
+
+		ScanCheckpoint::pointer checkpoint {ScanCheckpoint::getOrCreate(*_dbSession)};
+		checkpoint.modify()->setScanVersion(_scanVersion);
+		checkpoint.modify()->setForceScan(forceScan);
+		checkpoint.modify()->setMediaDirectories(_mediaDirectories);
+		checkpoint.modify()->setStep(static_cast<int>(step));
+		checkpoint.modify()->setDirectories(directories);
+		checkpoint.modify()->setStartTime(stats.startTime);
+		checkpoint.modify()->setCounters(counters);
 	}
 
-	notifyInProgress(stepStats);
-	LMS_LOG(DBUPDATER, INFO) << "Track features fetched!";
+	_lastCheckpointTime = std::chrono::steady_clock::now();
+
+	LMS_LOG(DBUPDATER, DEBUG) << "Saved scan checkpoint at step '" << getScanProgressStepName(step) << "', " << directories.size() << " directory(ies)";
 }
 
 void
-MediaScanner::refreshScanSettings()
+MediaScanner::saveCheckpointIfNeeded(bool forceScan, ScanStats& stats)
 {
-	auto transaction {_dbSession.createSharedTransaction()};
+	// Rebuilds are not resumed
+	if (_checkpointInterval.count() == 0
+			|| _rebuildDb
+			|| std::chrono::steady_clock::now() - _lastCheckpointTime < _checkpointInterval)
+		return;
+
+	constexpr std::chrono::milliseconds pollPeriod {20};
+
+	// The checkpoint must only cover committed files: pause each walker once done with its current directory
+	std::vector<std::filesystem::path> directories;
+	{
+		std::unique_lock lock {_walkMutex};
+
+		_checkpointRequested = true;
+		while (!_walkCondition.wait_for(lock, pollPeriod, [this]
+				{
+					return std::all_of(std::cbegin(_deviceWalkers), std::cend(_deviceWalkers), [](const auto& walker) { return walker->paused || walker->done; });
+				}))
+		{
+			// A walker may take a while to complete its directory: keep writing meanwhile
+			lock.unlock();
+			processParsedAudioFiles(false, stats);
+			lock.lock();
+		}
 
-	const ScanSettings::pointer scanSettings {ScanSettings::get(_dbSession)};
+		for (const auto& walker : _deviceWalkers)
+		{
+			if (!walker->lastDirectory.empty())
+				directories.push_back(walker->lastDirectory);
+		}
+	}
 
-	LMS_LOG(DBUPDATER, INFO) << "Using scan settings version " << scanSettings->getScanVersion();
+	processParsedAudioFiles(true, stats);
+	mergeDeviceWalkerStats(stats);
 
-	_scanVersion = scanSettings->getScanVersion();
-	_startTime = scanSettings->getUpdateStartTime();
-	_updatePeriod = scanSettings->getUpdatePeriod();
+	if (!_scanCancellation.isCancelled())
+		saveCheckpoint(ScanProgressStep::ScanningFiles, directories, forceScan, stats);
 
 	{
-		const auto fileExtensions {scanSettings->getAudioFileExtensions()};
-		_fileExtensions.clear();
-		std::transform(std::cbegin(fileExtensions), std::end(fileExtensions), std::inserter(_fileExtensions, std::begin(_fileExtensions)),
-				[](const std::filesystem::path& extension) { return std::filesystem::path{ StringUtils::stringToLower(extension.string()) }; });
+		std::scoped_lock lock {_walkMutex};
+		_checkpointRequested = false;
 	}
-	_mediaDirectory = scanSettings->getMediaDirectory();
-	_recommendationEngineType = scanSettings->getRecommendationEngineType();
+	_walkCondition.notify_all();
+}
 
-	const auto clusterTypes = scanSettings->getClusterTypes();
-	std::set<std::string> clusterTypeNames;
+void
+MediaScanner::removeCheckpoint()
+{
+	auto transaction {_dbSession->createUniqueTransaction()};
 
-	std::transform(std::cbegin(clusterTypes), std::cend(clusterTypes),
-			std::inserter(clusterTypeNames, clusterTypeNames.begin()),
-			[](ClusterType::pointer clusterType) { return clusterType->getName(); });
+	ScanCheckpoint::removeAll(*_dbSession);
+}
 
-	_metadataParser->setClusterTypeNames(clusterTypeNames);
+Database::Db&
+MediaScanner::getScanDb()
+{
+	return _rebuildDb ? *_rebuildDb : _db;
 }
 
 void
-MediaScanner::notifyInProgress(const ScanStepStats& stepStats)
+MediaScanner::startDatabaseRebuild()
 {
-	{
-		std::unique_lock lock {_statusMutex};
-		_currentScanStepStats = stepStats;
-	}
+	LMS_LOG(DBUPDATER, INFO) << "Scanning files into a new database";
 
-	const std::chrono::system_clock::time_point now {std::chrono::system_clock::now()};
-	_sigScanInProgress(stepStats);
-	_lastScanInProgressEmit = now;
+	_rebuildDb = _db.createRebuildDb();
+	_dbSession = std::make_unique<Session>(*_rebuildDb);
 }
 
 void
-MediaScanner::notifyInProgressIfNeeded(const ScanStepStats& stepStats)
+MediaScanner::replaceDatabaseByRebuild()
 {
-	std::chrono::system_clock::time_point now {std::chrono::system_clock::now()};
+	// Sessions must not outlive their database
+	_dbSession = std::make_unique<Session>(_db);
+	_db.replaceByRebuildDb(std::move(_rebuildDb));
+}
 
-	if (std::chrono::duration_cast<std::chrono::seconds>(now - _lastScanInProgressEmit).count() > 1)
-		notifyInProgress(stepStats);
+void
+MediaScanner::discardDatabaseRebuild()
+{
+	if (!_rebuildDb)
+		return;
+
+	_dbSession = std::make_unique<Session>(_db);
+	Db::discardRebuildDb(std::move(_rebuildDb));
 }
 
 void
-MediaScanner::scanAudioFile(const std::filesystem::path& file, bool forceScan, ScanStats& stats)
+MediaScanner::scheduleScan(bool force, const Wt::WDateTime& dateTime)
 {
-	Wt::WDateTime lastWriteTime;
-	try
-	{
-		lastWriteTime = getLastWriteTime(file);
-	}
-	catch (LmsException& e)
+	if (!isScanAllowed())
 	{
-		LMS_LOG(DBUPDATER, ERROR) << e.what();
-		stats.skips++;
+		LMS_LOG(DBUPDATER, INFO) << "Not holding the scanner lease, scan request ignored";
 		return;
 	}
 
-	if (!forceScan)
+	auto cb {[=](boost::system::error_code ec)
 	{
-		// Skip file if last write is the same
-		auto transaction {_dbSession.createSharedTransaction()};
-
-		const Track::pointer track {Track::getByPath(_dbSession, file)};
-
-		if (track && track->getLastWriteTime().toTime_t() == lastWriteTime.toTime_t()
-				&& track->getScanVersion() == _scanVersion)
-		{
-			stats.skips++;
+		if (ec)
 			return;
-		}
-	}
 
-	std::optional<MetaData::Track> trackInfo {_metadataParser->parse(file)};
-	if (!trackInfo)
-	{
-		stats.errors.emplace_back(file, ScanErrorType::CannotParseFile);
+		scan(force);
+	}};
+
+	if (dateTime.isNull())
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Scheduling next scan right now";
+		_scheduleTimer.expires_from_now(std::chrono::seconds {0});
+		_scheduleTimer.async_wait(cb);
+	}
+	else
+	{
+		std::chrono::system_clock::time_point timePoint {dateTime.toTimePoint()};
+		std::time_t t {std::chrono::system_clock::to_time_t(timePoint)};
+		char ctimeStr[26];
+
+		LMS_LOG(DBUPDATER, INFO) << "Scheduling next scan at " << std::string(::ctime_r(&t, ctimeStr));
+		_scheduleTimer.expires_at(timePoint);
+		_scheduleTimer.async_wait(cb);
+	}
+}
+
+void
+MediaScanner::setupScanThread() const
+{
+	CpuAffinity::setCurrentThreadAffinity(_cpuSet);
+}
+
+void
+MediaScanner::setupWorkerThread() const
+{
+	CpuAffinity::setCurrentThreadAffinity(_cpuSet);
+	if (_lowPriority)
+		lowerCurrentThreadPriority();
+}
+
+void
+MediaScanner::scan(bool forceScan)
+{
+	const SamplingProfiler::ScopedSubsystem profilerSubsystem {SamplingProfiler::Subsystem::Scan};
+
+	scanStarted().emit();
+
+	{
+		std::unique_lock lock {_statusMutex};
+		_curState = State::InProgress;
+		_nextScheduledScan = {};
+	}
+
+	setupScanThread();
+
+	ScanStats stats;
+	stats.startTime = Wt::WLocalDateTime::currentDateTime().toUTC();
+
+	LMS_LOG(UI, INFO) << "New scan started!";
+
+	refreshScanSettings();
+
+	const std::optional<ScanProgressStep> resumeStep {resumeFromCheckpoint(forceScan, stats)};
+	const bool filesScanned {resumeStep && *resumeStep > ScanProgressStep::ScanningFiles};
+
+	// Rebuilds are not resumed: the rebuilt database is discarded if the scan is interrupted
+	const bool rebuildDatabase {forceScan && _rebuildOnFullScan && !resumeStep};
+	const ScopedCleanup rebuildCleanup {[this] { discardDatabaseRebuild(); }};
+
+	// Missing files are checked again when resuming, as the move candidates are not persisted
+	// Not needed when rebuilding the database, as they are just not added
+	if (!filesScanned && !rebuildDatabase)
+	{
+		ScopedTimer timer {stats.getStepTimings(ScanProgressStep::ChekingForMissingFiles)};
+		removeMissingTracks(stats);
+	}
+
+	// Also used to find the new files while counting them, and on forced scans to only fingerprint the files that have no track
+	// Not needed when rebuilding the database, as there are no move candidates then
+	if (!filesScanned && !rebuildDatabase)
+		loadTrackFileInfos();
+
+	// The file count is restored when resuming
+	if (!resumeStep)
+	{
+		ScopedTimer timer {stats.getStepTimings(ScanProgressStep::DiscoveringFiles)};
+
+		if (_estimateFileCount)
+		{
+			estimateFileCount(stats);
+			LMS_LOG(DBUPDATER, DEBUG) << "-> Estimated nb files = " << stats.filesScanned;
+		}
+		else
+		{
+			LMS_LOG(DBUPDATER, DEBUG) << "Counting files in " << _mediaDirectories.size() << " media directory(ies)...";
+			countAllFiles(stats, _prioritizeNewFiles && !forceScan);
+			LMS_LOG(DBUPDATER, DEBUG) << "-> Nb files = " << stats.filesScanned;
+		}
+	}
+
+	LMS_LOG(UI, INFO) << "Checks complete, force scan = " << forceScan;
+
+	if (!filesScanned)
+	{
+		ScopedTimer timer {stats.getStepTimings(ScanProgressStep::ScanningFiles)};
+
+		if (rebuildDatabase)
+			startDatabaseRebuild();
+
+		if (!forceScan && _skipUnchangedDirectories)
+			loadScannedDirectoryInfos();
+
+		if (!_newFiles.empty())
+			scanNewFiles(stats);
+
+		LMS_LOG(DBUPDATER, INFO) << "Scanning " << _mediaDirectories.size() << " media directory(ies) using " << _deviceWalkers.size() << " walker(s)...";
+		scanMediaDirectories(forceScan, stats);
+		LMS_LOG(DBUPDATER, INFO) << "Scanning media directories DONE";
+
+		// Next steps query the whole database
+		if (_rebuildDb && !_scanCancellation.isCancelled())
+			_dbSession->createIndexes();
+
+		// Only save the explored directories if all their files have been processed
+		// A resumed scan did not explore all of them: keep the previous ones
+		if (_skipUnchangedDirectories && !_scanCancellation.isCancelled() && !resumeStep)
+			saveScannedDirectoryInfos();
+
+		if (!_scanCancellation.isCancelled())
+			saveCheckpoint(ScanProgressStep::FetchingTrackFeatures, {}, forceScan, stats);
+	}
+
+	_trackFileInfos.clear();
+	_scannedDirectoryInfos.clear();
+	_exploredDirectories.clear();
+	_newFiles.clear();
+	_prioritizedFiles.clear();
+	_lookupCache.clear();
+	for (const auto& walker : _deviceWalkers)
+		walker->resumeDirectory.reset();
+
+	{
+		ScopedTimer timer {stats.orphanRemovalTimings};
+		removeOrphanEntries();
+	}
+
+	{
+		ScopedTimer timer {stats.aggregatesUpdateTimings};
+		updateAggregates();
+	}
+
+	if (_rebuildDb)
+	{
+		if (_scanCancellation.isCancelled())
+			discardDatabaseRebuild();
+		else
+			replaceDatabaseByRebuild();
+	}
+
+	if (!_scanCancellation.isCancelled())
+	{
+		checkDuplicatedAudioFiles(stats);
+
+		if (!resumeStep || *resumeStep <= ScanProgressStep::FetchingTrackFeatures)
+		{
+			ScopedTimer timer {stats.getStepTimings(ScanProgressStep::FetchingTrackFeatures)};
+			fetchTrackFeatures(stats);
+
+			if (!_scanCancellation.isCancelled())
+				saveCheckpoint(ScanProgressStep::ReloadingSimilarityEngine, {}, forceScan, stats);
+		}
+
+		{
+			ScopedTimer timer {stats.getStepTimings(ScanProgressStep::ReloadingSimilarityEngine)};
+			reloadSimilarityEngine(stats);
+		}
+
+		if (!_coverSizes.empty())
+		{
+			ScopedTimer timer {stats.getStepTimings(ScanProgressStep::GeneratingCovers)};
+			generateCovers(stats);
+		}
+	}
+
+	LMS_LOG(DBUPDATER, INFO) << "Scan " << (_scanCancellation.isCancelled() ? "aborted" : "complete") << ". Changes = " << stats.nbChanges() << " (added = " << stats.additions << ", removed = " << stats.deletions << ", updated = " << stats.updates << ", moved = " << stats.moves << "), Not changed = " << stats.skips << ", Scanned = " << stats.scans << " (errors = " << stats.errors.size() << "), features fetched = " << stats.featuresFetched << ", covers generated = " << stats.coversGenerated << ",  duplicates = " << stats.duplicates.size();
+
+	{
+		std::ostringstream oss;
+		writeProfile(oss, stats);
+
+		std::string line;
+		std::istringstream iss {oss.str()};
+		while (std::getline(iss, line))
+			LMS_LOG(DBUPDATER, INFO) << "Profile: " << line;
+	}
+
+	_dbSession->optimize();
+
+	if (!_scanCancellation.isCancelled())
+	{
+		removeCheckpoint();
+
+		stats.stopTime = Wt::WLocalDateTime::currentDateTime().toUTC();
+		completeScanCount.inc();
+		scannedFileCount.inc(stats.scans);
+		scanDuration.record(std::chrono::duration_cast<std::chrono::microseconds>(stats.stopTime.toTimePoint() - stats.startTime.toTimePoint()));
+		{
+			std::unique_lock lock {_statusMutex};
+
+			_lastCompleteScanStats = std::move(stats);
+			_currentScanStepStats.reset();
+		}
+
+		LMS_LOG(DBUPDATER, DEBUG) << "Scan not aborted, scheduling next scan!";
+		scheduleNextScan();
+
+		_libraryGeneration++;
+		publishLibraryGeneration();
+		scanComplete().emit();
+	}
+	else
+	{
+		LMS_LOG(DBUPDATER, DEBUG) << "Scan aborted, not scheduling next scan! It will be resumed from the last checkpoint";
+
+		std::unique_lock lock {_statusMutex};
+
+		_curState = State::NotScheduled;
+		_currentScanStepStats.reset();
+	}
+}
+
+void
+MediaScanner::fetchTrackFeatures(ScanStats& stats)
+{
+	if (_recommendationEngineType != ScanSettings::RecommendationEngineType::Features)
+		return;
+
+	ScanStepStats stepStats{stats.startTime, ScanProgressStep::FetchingTrackFeatures};
+
+	const std::unordered_set<std::string> storedFeatureNames {Recommendation::getUsedTrackFeatureNames()};
+
+	// Features fetched by older versions only have the json data
+	{
+		std::vector<Database::IdType> trackFeaturesIds;
+		{
+			auto transaction {_dbSession->createSharedTransaction()};
+			trackFeaturesIds = Database::TrackFeatures::getIdsWithoutStoredFeatureValues(*_dbSession);
+		}
+
+		if (!trackFeaturesIds.empty())
+			LMS_LOG(DBUPDATER, INFO) << "Extracting stored features for " << trackFeaturesIds.size() << " track(s)...";
+
+		for (std::size_t i {}; i < trackFeaturesIds.size() && !_scanCancellation.isCancelled(); i += _writeBatchSize)
+		{
+			auto uniqueTransaction {_dbSession->createUniqueTransaction()};
+
+			for (std::size_t j {i}; j < std::min(i + _writeBatchSize, trackFeaturesIds.size()); ++j)
+			{
+				Database::TrackFeatures::pointer trackFeatures {Database::TrackFeatures::getById(*_dbSession, trackFeaturesIds[j])};
+				if (trackFeatures)
+					trackFeatures.modify()->storeFeatureValues(storedFeatureNames);
+			}
+		}
+	}
+
+	LMS_LOG(DBUPDATER, INFO) << "Fetching missing track features...";
+
+	// Several tracks may share the same MBID
+	std::vector<UUID> mbidsToFetch;
+	std::unordered_map<UUID, std::vector<Database::IdType>> trackIdsByMBID;
+
+	{
+		auto transaction {_dbSession->createSharedTransaction()};
+
+		auto tracks {Database::Track::getAllWithMBIDAndMissingFeatures(*_dbSession)};
+		for (const auto& track : tracks)
+		{
+			const UUID mbid {*track->getMBID()};
+
+			std::vector<Database::IdType>& trackIds {trackIdsByMBID[mbid]};
+			if (trackIds.empty())
+				mbidsToFetch.push_back(mbid);
+
+			trackIds.push_back(track.id());
+		}
+	}
+
+	stepStats.totalElems = mbidsToFetch.size();
+	notifyInProgress(stepStats);
+
+	LMS_LOG(DBUPDATER, INFO) << "Found " << mbidsToFetch.size() << " MBID(s) to fetch!";
+
+	std::vector<std::pair<Database::IdType, std::string>> pendingFeatures;
+
+	auto writePendingFeatures {[&]
+	{
+		auto uniqueTransaction {_dbSession->createUniqueTransaction()};
+
+		for (const auto& [trackId, data] : pendingFeatures)
+		{
+			Wt::Dbo::ptr<Database::Track> track {Database::Track::getById(*_dbSession, trackId)};
+			if (!track)
+				continue;
+
+			Database::TrackFeatures::create(*_dbSession, track, data, storedFeatureNames);
+			stats.featuresFetched++;
+		}
+
+		pendingFeatures.clear();
+	}};
+
+	AcousticBrainz::extractLowLevelFeatures(mbidsToFetch, _featuresFetchSettings,
+		[&](std::size_t requestedCount, const std::map<std::string, std::string>& lowLevelFeatures)
+		{
+			LMS_LOG(DBUPDATER, DEBUG) << "Fetched low level features for " << lowLevelFeatures.size() << "/" << requestedCount << " MBID(s)";
+
+			for (const auto& [mbid, data] : lowLevelFeatures)
+			{
+				const std::optional<UUID> uuid {UUID::fromString(mbid)};
+				if (!uuid)
+					continue;
+
+				for (Database::IdType trackId : trackIdsByMBID[*uuid])
+					pendingFeatures.emplace_back(trackId, data);
+			}
+
+			if (pendingFeatures.size() >= _writeBatchSize)
+				writePendingFeatures();
+
+			stepStats.processedElems += requestedCount;
+			notifyInProgressIfNeeded(stepStats);
+
+			return !_scanCancellation.isCancelled();
+		});
+
+	if (!pendingFeatures.empty())
+		writePendingFeatures();
+
+	notifyInProgress(stepStats);
+	LMS_LOG(DBUPDATER, INFO) << "Track features fetched!";
+}
+
+void
+MediaScanner::refreshScanSettings()
+{
+	std::vector<std::filesystem::path> mediaDirectories;
+	std::set<std::string> clusterTypeNames;
+	{
+		auto transaction {_dbSession->createSharedTransaction()};
+
+		const ScanSettings::pointer scanSettings {ScanSettings::get(*_dbSession)};
+
+		LMS_LOG(DBUPDATER, INFO) << "Using scan settings version " << scanSettings->getScanVersion();
+
+		_scanVersion = scanSettings->getScanVersion();
+		_startTime = scanSettings->getUpdateStartTime();
+		_updatePeriod = scanSettings->getUpdatePeriod();
+
+		{
+			const auto fileExtensions {scanSettings->getAudioFileExtensions()};
+			_fileExtensions.clear();
+			std::transform(std::cbegin(fileExtensions), std::end(fileExtensions), std::inserter(_fileExtensions, std::begin(_fileExtensions)),
+					[](const std::filesystem::path& extension) { return std::filesystem::path{ StringUtils::stringToLower(extension.string()) }; });
+		}
+		mediaDirectories = scanSettings->getMediaDirectories();
+		_recommendationEngineType = scanSettings->getRecommendationEngineType();
+
+		const auto clusterTypes = scanSettings->getClusterTypes();
+
+		std::transform(std::cbegin(clusterTypes), std::cend(clusterTypes),
+				std::inserter(clusterTypeNames, clusterTypeNames.begin()),
+				[](ClusterType::pointer clusterType) { return clusterType->getName(); });
+	}
+
+	// The sub directories of a directory immediately follow it
+	std::sort(std::begin(mediaDirectories), std::end(mediaDirectories));
+	mediaDirectories.erase(std::unique(std::begin(mediaDirectories), std::end(mediaDirectories)), std::end(mediaDirectories));
+	for (auto itMediaDirectory {std::begin(mediaDirectories)}; itMediaDirectory != std::end(mediaDirectories);)
+	{
+		// Would be explored twice
+		if (itMediaDirectory != std::begin(mediaDirectories) && isPathInParentPath(*itMediaDirectory, *std::prev(itMediaDirectory)))
+		{
+			LMS_LOG(DBUPDATER, WARNING) << "Ignoring media directory '" << itMediaDirectory->string() << "': nested in '" << std::prev(itMediaDirectory)->string() << "'";
+			itMediaDirectory = mediaDirectories.erase(itMediaDirectory);
+		}
+		else
+			++itMediaDirectory;
+	}
+
+	if (mediaDirectories != _mediaDirectories)
+	{
+		_mediaDirectories = std::move(mediaDirectories);
+		createDeviceWalkers();
+	}
+
+	for (const auto& walker : _deviceWalkers)
+		walker->parallelParser->setClusterTypeNames(clusterTypeNames);
+}
+
+void
+MediaScanner::createDeviceWalkers()
+{
+	_deviceWalkers.clear();
+
+	// Media directories on the same device compete for the same I/O: explore them one after the other
+	std::vector<std::vector<std::filesystem::path>> mediaDirectoryGroups;
+	std::map<std::uint64_t, std::size_t> mediaDirectoryGroupByDevice;
+	for (const std::filesystem::path& mediaDirectory : _mediaDirectories)
+	{
+		try
+		{
+			const auto [itGroup, inserted] {mediaDirectoryGroupByDevice.emplace(getDeviceId(mediaDirectory), mediaDirectoryGroups.size())};
+			if (inserted)
+				mediaDirectoryGroups.emplace_back();
+
+			mediaDirectoryGroups[itGroup->second].push_back(mediaDirectory);
+		}
+		catch (LmsException& e)
+		{
+			// The error is reported during the scan
+			LMS_LOG(DBUPDATER, WARNING) << "Cannot get device of media directory: " << e.what();
+			mediaDirectoryGroups.push_back({mediaDirectory});
+		}
+	}
+
+	// The parser workers are shared among the devices
+	std::size_t parserWorkerCount {std::max<std::size_t>(1, _parserWorkerCount / std::max<std::size_t>(1, mediaDirectoryGroups.size()))};
+	if (_deviceParserMaxWorkerCount > 0)
+		parserWorkerCount = std::min(parserWorkerCount, _deviceParserMaxWorkerCount);
+
+	for (std::vector<std::filesystem::path>& mediaDirectoryGroup : mediaDirectoryGroups)
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Exploring " << mediaDirectoryGroup.size() << " media directory(ies) from '" << mediaDirectoryGroup.front().string() << "' using " << parserWorkerCount << " parser worker(s)";
+
+		auto walker {std::make_unique<DeviceWalker>()};
+		walker->mediaDirectories = std::move(mediaDirectoryGroup);
+		walker->parallelParser = std::make_unique<ParallelParser>(parserWorkerCount, [] { return std::make_unique<MetaData::TagLibParser>(); }, // For now, always use TagLib
+				[this] { setupWorkerThread(); });
+		walker->parallelParser->setCacheTags(_cacheTags);
+
+		_deviceWalkers.push_back(std::move(walker));
+	}
+}
+
+MediaScanner::DeviceWalker*
+MediaScanner::getDeviceWalker(const std::filesystem::path& path)
+{
+	for (const auto& walker : _deviceWalkers)
+	{
+		for (const std::filesystem::path& mediaDirectory : walker->mediaDirectories)
+		{
+			if (path == mediaDirectory || isPathInParentPath(path, mediaDirectory))
+				return walker.get();
+		}
+	}
+
+	return nullptr;
+}
+
+bool
+MediaScanner::isWalkAborted() const
+{
+	return _walkAborted || _scanCancellation.isCancelled();
+}
+
+void
+MediaScanner::resetIoThrottle(DeviceWalker& walker)
+{
+	walker.throttleStartTime = std::chrono::steady_clock::now();
+	walker.throttledFileCount = 0;
+	walker.throttledByteCount = 0;
+}
+
+void
+MediaScanner::waitForIoBudget(DeviceWalker& walker, std::uintmax_t fileSize)
+{
+	constexpr std::chrono::milliseconds sleepPeriod {100};	// to react to aborts
+	constexpr std::chrono::seconds maxBurstDuration {1};
+
+	if (_pauseActiveStreamCount > 0 && ActiveStreamCounter::getCount() >= _pauseActiveStreamCount)
+	{
+		LMS_LOG(DBUPDATER, INFO) << "Pausing scan of '" << walker.mediaDirectories.front().string() << "', " << ActiveStreamCounter::getCount() << " active stream(s)";
+
+		while (!isWalkAborted() && ActiveStreamCounter::getCount() >= _pauseActiveStreamCount)
+			std::this_thread::sleep_for(sleepPeriod);
+
+		LMS_LOG(DBUPDATER, INFO) << "Resuming scan of '" << walker.mediaDirectories.front().string() << "'";
+
+		// Do not catch up the time spent paused
+		resetIoThrottle(walker);
+	}
+
+	if (_maxFilesPerSecond == 0 && _maxBytesPerSecond == 0)
+		return;
+
+	walker.throttledFileCount++;
+	walker.throttledByteCount += fileSize;
+
+	// Minimum time needed to process all the files so far without exceeding the limits
+	std::chrono::duration<double> minDuration {};
+	if (_maxFilesPerSecond > 0)
+		minDuration = std::max(minDuration, std::chrono::duration<double> {static_cast<double>(walker.throttledFileCount) / _maxFilesPerSecond});
+	if (_maxBytesPerSecond > 0)
+		minDuration = std::max(minDuration, std::chrono::duration<double> {static_cast<double>(walker.throttledByteCount) / _maxBytesPerSecond});
+
+	const auto wakeUpTime {walker.throttleStartTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(minDuration)};
+	auto now {std::chrono::steady_clock::now()};
+
+	// Late because of slow or skipped files: do not allow a long burst
+	if (wakeUpTime + maxBurstDuration < now)
+	{
+		resetIoThrottle(walker);
+		return;
+	}
+
+	while (!isWalkAborted() && now < wakeUpTime)
+	{
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(sleepPeriod, wakeUpTime - now));
+		now = std::chrono::steady_clock::now();
+	}
+}
+
+void
+MediaScanner::notifyInProgress(const ScanStepStats& stepStats)
+{
+	{
+		std::unique_lock lock {_statusMutex};
+		_currentScanStepStats = stepStats;
+	}
+
+	const std::chrono::system_clock::time_point now {std::chrono::system_clock::now()};
+	_sigScanInProgress(stepStats);
+	_lastScanInProgressEmit = now;
+}
+
+void
+MediaScanner::notifyInProgressIfNeeded(const ScanStepStats& stepStats)
+{
+	std::chrono::system_clock::time_point now {std::chrono::system_clock::now()};
+
+	if (std::chrono::duration_cast<std::chrono::seconds>(now - _lastScanInProgressEmit).count() > 1)
+		notifyInProgress(stepStats);
+}
+
+void
+MediaScanner::scanAudioFile(DeviceWalker& walker, Session& session, const std::filesystem::path& file, bool forceScan, ScanStats& stats)
+{
+	Wt::WDateTime lastWriteTime;
+	try
+	{
+		lastWriteTime = getLastWriteTime(file);
+	}
+	catch (LmsException& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << e.what();
+		stats.skips++;
+		return;
+	}
+
+	// Empty when rebuilding the database
+	auto itTrackFileInfo {_trackFileInfos.find(file)};
+
+	if (!forceScan)
+	{
+		// Skip file if last write is the same
+		if (itTrackFileInfo != std::cend(_trackFileInfos)
+				&& itTrackFileInfo->second.lastWriteTime == lastWriteTime.toTime_t()
+				&& itTrackFileInfo->second.scanVersion == _scanVersion)
+		{
+			// Fill in the file size without parsing the file again
+			if (itTrackFileInfo->second.fileSize == 0)
+			{
+				std::error_code ec;
+				const std::uintmax_t fileSize {std::filesystem::file_size(file, ec)};
+				if (!ec && fileSize != 0)
+				{
+					std::scoped_lock lock {_pendingWritesMutex};
+
+					if (!hasPendingWrites())
+						_pendingWritesStartTime = std::chrono::steady_clock::now();
+
+					_pendingFileSizes.emplace_back(PendingFileSize {itTrackFileInfo->second.id, fileSize});
+				}
+			}
+
+			stats.skips++;
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::uintmax_t fileSize {std::filesystem::file_size(file, ec)};
+	if (ec)
+		fileSize = 0;
+
+	// Unchanged file, only the scan version differs: build the track again from its cached tags, without reading the file
+	if (_cacheTags
+			&& !forceScan
+			&& fileSize != 0
+			&& itTrackFileInfo != std::cend(_trackFileInfos)
+			&& itTrackFileInfo->second.lastWriteTime == lastWriteTime.toTime_t()
+			&& itTrackFileInfo->second.fileSize == fileSize)
+	{
+		std::optional<std::vector<unsigned char>> cachedTags;
+		{
+			auto transaction {session.createSharedTransaction()};
+			cachedTags = Track::getCachedTags(session, itTrackFileInfo->second.id, lastWriteTime, fileSize);
+		}
+
+		if (cachedTags)
+		{
+			walker.parallelParser->pushCachedTags(file, lastWriteTime, fileSize, std::move(*cachedTags));
+			return;
+		}
+	}
+
+	waitForIoBudget(walker, fileSize);
+
+	// Same size: the audio part of the file is very likely unchanged (tags edited in place, new scan version, etc.)
+	const bool readAudioProperties {!_reuseAudioProperties
+		|| forceScan
+		|| fileSize == 0
+		|| itTrackFileInfo == std::cend(_trackFileInfos)
+		|| itTrackFileInfo->second.fileSize != fileSize};
+
+	std::string fingerprint;
+
+	bool hasMoveCandidates {};
+	{
+		std::scoped_lock lock {_pendingWritesMutex};
+		hasMoveCandidates = !_moveCandidates.empty();
+	}
+
+	// New file: it may be a missing track that has been moved
+	if (hasMoveCandidates && itTrackFileInfo == std::cend(_trackFileInfos))
+	{
+		try
+		{
+			fingerprint = computeFingerprint(file);
+		}
+		catch (LmsException& e)
+		{
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot compute fingerprint: " << e.what();
+		}
+
+		std::optional<IdType> movedTrackId;
+		if (!fingerprint.empty())
+		{
+			std::scoped_lock lock {_pendingWritesMutex};
+
+			auto itCandidate {_moveCandidates.find(fingerprint)};
+			if (itCandidate != std::end(_moveCandidates))
+				movedTrackId = itCandidate->second;
+		}
+
+		if (movedTrackId)
+		{
+			// Make sure this is not another copy of a known file
+			bool isKnownFile {};
+			{
+				auto transaction {session.createSharedTransaction()};
+				isKnownFile = static_cast<bool>(Track::getByPath(session, file));
+			}
+
+			if (!isKnownFile)
+			{
+				std::scoped_lock lock {_pendingWritesMutex};
+
+				// Another copy may have been found meanwhile on another device
+				if (_moveCandidates.erase(fingerprint) > 0)
+				{
+					if (!hasPendingWrites())
+						_pendingWritesStartTime = std::chrono::steady_clock::now();
+
+					_pendingMoves.emplace_back(PendingMove {*movedTrackId, file, lastWriteTime});
+					return;
+				}
+			}
+		}
+	}
+
+	walker.parallelParser->push(file, lastWriteTime, fileSize, readAudioProperties, fingerprint);
+}
+
+void
+MediaScanner::processParsedAudioFiles(bool waitForAll, ScanStats& stats)
+{
+	std::vector<ParallelParser::Result> parseResults;
+	for (const auto& walker : _deviceWalkers)
+	{
+		std::vector<ParallelParser::Result> walkerParseResults {walker->parallelParser->popResults(waitForAll)};
+		std::move(std::begin(walkerParseResults), std::end(walkerParseResults), std::back_inserter(parseResults));
+	}
+
+	for (const ParallelParser::Result& parseResult : parseResults)
+		stats.addParseDuration(parseResult.file, parseResult.parseDuration);
+
+	std::vector<ParallelParser::Result> pendingWrites;
+	std::vector<PendingMove> pendingMoves;
+	std::vector<PendingFileSize> pendingFileSizes;
+	{
+		std::scoped_lock lock {_pendingWritesMutex};
+
+		if (!parseResults.empty())
+		{
+			if (!hasPendingWrites())
+				_pendingWritesStartTime = std::chrono::steady_clock::now();
+
+			std::move(std::begin(parseResults), std::end(parseResults), std::back_inserter(_pendingWrites));
+		}
+
+		if (!hasPendingWrites())
+			return;
+
+		// Group the writes in a single transaction to reduce both the number of commits and the time spent holding the exclusive lock
+		if (!waitForAll
+				&& _pendingWrites.size() + _pendingMoves.size() + _pendingFileSizes.size() < _writeBatchSize
+				&& std::chrono::steady_clock::now() - _pendingWritesStartTime < _writeBatchMaxDuration)
+			return;
+
+		// The walkers keep on pushing while the batch is written
+		pendingWrites.swap(_pendingWrites);
+		pendingMoves.swap(_pendingMoves);
+		pendingFileSizes.swap(_pendingFileSizes);
+	}
+
+	std::chrono::steady_clock::time_point commitStart;
+	{
+		auto uniqueTransaction {_dbSession->createUniqueTransaction()};
+
+		for (const PendingMove& pendingMove : pendingMoves)
+		{
+			if (_scanCancellation.isCancelled())
+				break;
+
+			Track::pointer track {Track::getById(*_dbSession, pendingMove.trackId)};
+			if (!track)
+				continue;
+
+			LMS_LOG(DBUPDATER, INFO) << "Moving '" << track->getPath().string() << "' to '" << pendingMove.file.string() << "'";
+			track.modify()->setPath(pendingMove.file);
+			track.modify()->setLastWriteTime(pendingMove.lastWriteTime);
+			stats.moves++;
+		}
+
+		for (const ParallelParser::Result& parseResult : pendingWrites)
+		{
+			if (_scanCancellation.isCancelled())
+				break;
+
+			updateAudioFile(parseResult, stats);
+		}
+
+		for (const PendingFileSize& pendingFileSize : pendingFileSizes)
+		{
+			if (_scanCancellation.isCancelled())
+				break;
+
+			Track::pointer track {Track::getById(*_dbSession, pendingFileSize.trackId)};
+			if (track)
+				track.modify()->setFileSize(pendingFileSize.fileSize);
+		}
+
+		// Committed when the transaction goes out of scope
+		commitStart = std::chrono::steady_clock::now();
+	}
+	stats.dbCommitDurations.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - commitStart));
+}
+
+bool
+MediaScanner::hasPendingWrites() const
+{
+	return !_pendingWrites.empty() || !_pendingMoves.empty() || !_pendingFileSizes.empty();
+}
+
+void
+MediaScanner::clearPendingWrites()
+{
+	for (const auto& walker : _deviceWalkers)
+		walker->parallelParser->clear();
+
+	std::scoped_lock lock {_pendingWritesMutex};
+
+	_pendingWrites.clear();
+	_pendingMoves.clear();
+	_pendingFileSizes.clear();
+
+	// Keep the missing tracks as is, they will be checked again during the next scan
+	_moveCandidates.clear();
+}
+
+void
+MediaScanner::updateAudioFile(const ParallelParser::Result& parseResult, ScanStats& stats)
+{
+	const std::filesystem::path& file {parseResult.file};
+	const std::optional<MetaData::Track>& trackInfo {parseResult.trackInfo};
+
+	if (!trackInfo)
+	{
+		stats.errors.emplace_back(file, ScanErrorType::CannotParseFile);
 		return;
 	}
 
 	stats.scans++;
 
-	auto uniqueTransaction {_dbSession.createUniqueTransaction()};
+	_dbSession->checkUniqueLocked();
+
+	Track::pointer track {Track::getByPath(*_dbSession, file) };
+
+	bool hasAudioStreams {!trackInfo->audioStreams.empty()};
+	std::chrono::milliseconds duration {trackInfo->duration};
 
-	Track::pointer track {Track::getByPath(_dbSession, file) };
+	// Audio properties not read: reuse the ones of the known track
+	if (!parseResult.readAudioProperties && !hasAudioStreams && track)
+	{
+		hasAudioStreams = true;
+		duration = track->getDuration();
+	}
 
 	// We estimate this is an audio file if:
 	// - we found a least one audio stream
 	// - the duration is not null
-	if (trackInfo->audioStreams.empty())
+	if (!hasAudioStreams)
 	{
 		LMS_LOG(DBUPDATER, INFO) << "Skipped '" << file.string() << "' (no audio stream found)";
 
@@ -726,7 +1804,7 @@ MediaScanner::scanAudioFile(const std::filesystem::path& file, bool forceScan, S
 		stats.errors.emplace_back(ScanError {file, ScanErrorType::NoAudioTrack});
 		return;
 	}
-	if (trackInfo->duration == std::chrono::milliseconds::zero())
+	if (duration == std::chrono::milliseconds::zero())
 	{
 		LMS_LOG(DBUPDATER, INFO) << "Skipped '" << file.string() << "' (duration is 0)";
 
@@ -756,7 +1834,7 @@ MediaScanner::scanAudioFile(const std::filesystem::path& file, bool forceScan, S
 	if (!track)
 	{
 		// Create a new song
-		track = Track::create(_dbSession, file);
+		track = Track::create(*_dbSession, file);
 		LMS_LOG(DBUPDATER, INFO) << "Adding '" << file.string() << "'";
 		stats.additions++;
 	}
@@ -771,37 +1849,40 @@ MediaScanner::scanAudioFile(const std::filesystem::path& file, bool forceScan, S
 	assert(track);
 
 	track.modify()->clearArtistLinks();
-	for (const Artist::pointer& artist : getOrCreateArtists(_dbSession, trackInfo->artists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, artist, Database::TrackArtistLinkType::Artist));
+	for (const Artist::pointer& artist : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->artists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, artist, Database::TrackArtistLinkType::Artist));
 
-	for (const Artist::pointer& releaseArtist : getOrCreateArtists(_dbSession, trackInfo->albumArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, releaseArtist, Database::TrackArtistLinkType::ReleaseArtist));
+	for (const Artist::pointer& releaseArtist : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->albumArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, releaseArtist, Database::TrackArtistLinkType::ReleaseArtist));
 
-	for (const Artist::pointer& conductor : getOrCreateArtists(_dbSession, trackInfo->conductorArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, conductor, Database::TrackArtistLinkType::Conductor));
+	for (const Artist::pointer& conductor : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->conductorArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, conductor, Database::TrackArtistLinkType::Conductor));
 
-	for (const Artist::pointer& composer : getOrCreateArtists(_dbSession, trackInfo->composerArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, composer, Database::TrackArtistLinkType::Composer));
+	for (const Artist::pointer& composer : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->composerArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, composer, Database::TrackArtistLinkType::Composer));
 
-	for (const Artist::pointer& lyricist : getOrCreateArtists(_dbSession, trackInfo->lyricistArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, lyricist, Database::TrackArtistLinkType::Lyricist));
+	for (const Artist::pointer& lyricist : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->lyricistArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, lyricist, Database::TrackArtistLinkType::Lyricist));
 
-	for (const Artist::pointer& mixer : getOrCreateArtists(_dbSession, trackInfo->mixerArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, mixer, Database::TrackArtistLinkType::Mixer));
+	for (const Artist::pointer& mixer : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->mixerArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, mixer, Database::TrackArtistLinkType::Mixer));
 
-	for (const Artist::pointer& producer : getOrCreateArtists(_dbSession, trackInfo->producerArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, producer, Database::TrackArtistLinkType::Producer));
+	for (const Artist::pointer& producer : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->producerArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, producer, Database::TrackArtistLinkType::Producer));
 
-	for (const Artist::pointer& remixer : getOrCreateArtists(_dbSession, trackInfo->remixerArtists))
-		track.modify()->addArtistLink(Database::TrackArtistLink::create(_dbSession, track, remixer, Database::TrackArtistLinkType::Remixer));
+	for (const Artist::pointer& remixer : getOrCreateArtists(*_dbSession, _lookupCache, trackInfo->remixerArtists))
+		track.modify()->addArtistLink(Database::TrackArtistLink::create(*_dbSession, track, remixer, Database::TrackArtistLinkType::Remixer));
 
 	track.modify()->setScanVersion(_scanVersion);
+	if (!parseResult.fromCachedTags)
+		track.modify()->setFingerprint(parseResult.fingerprint);
 	if (trackInfo->album)
-		track.modify()->setRelease(getOrCreateRelease(_dbSession, *trackInfo->album));
-	track.modify()->setClusters(getOrCreateClusters(_dbSession, trackInfo->clusters));
-	track.modify()->setLastWriteTime(lastWriteTime);
+		track.modify()->setRelease(getOrCreateRelease(*_dbSession, _lookupCache, *trackInfo->album));
+	track.modify()->setClusters(getOrCreateClusters(*_dbSession, _lookupCache, trackInfo->clusters));
+	track.modify()->setLastWriteTime(parseResult.lastWriteTime);
+	track.modify()->setFileSize(parseResult.fileSize);
 	track.modify()->setName(title);
-	track.modify()->setDuration(trackInfo->duration);
+	track.modify()->setDuration(duration);
 	track.modify()->setAddedTime(Wt::WLocalDateTime::currentServerDateTime().toUTC());
 	track.modify()->setTrackNumber(trackInfo->trackNumber ? *trackInfo->trackNumber : 0);
 	track.modify()->setDiscNumber(trackInfo->discNumber ? *trackInfo->discNumber : 0);
@@ -825,42 +1906,372 @@ MediaScanner::scanAudioFile(const std::filesystem::path& file, bool forceScan, S
 		track.modify()->setTrackReplayGain(*trackInfo->trackReplayGain);
 	if (trackInfo->albumReplayGain)
 		track.modify()->setReleaseReplayGain(*trackInfo->albumReplayGain);
+
+	if (!parseResult.rawTags.empty())
+	{
+		// New tracks need their id
+		track.flush();
+		Track::setCachedTags(*_dbSession, track.id(), parseResult.lastWriteTime, parseResult.fileSize, parseResult.rawTags);
+	}
 }
 
 void
-MediaScanner::scanMediaDirectory(const std::filesystem::path& mediaDirectory, bool forceScan, ScanStats& stats)
+MediaScanner::scanMediaDirectories(bool forceScan, ScanStats& stats)
 {
+	// Period at which the scan thread writes the parsed files and reports the progress
+	constexpr std::chrono::milliseconds pollPeriod {20};
+
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::ScanningFiles};
 	stepStats.totalElems = stats.filesScanned;
+	const std::size_t resumedFileCount {stats.nbFiles()};	// not null if the scan is resumed
+	stepStats.processedElems = resumedFileCount;
 	notifyInProgress(stepStats);
 
-	exploreFilesRecursive(mediaDirectory, [&](std::error_code ec, const std::filesystem::path& path)
+	auto updateProgress {[&]
 	{
-		if (_abortScan)
-			return false;
+		stepStats.processedElems = resumedFileCount;
+		for (const auto& walker : _deviceWalkers)
+			stepStats.processedElems += walker->processedFileCount;
+
+		if (stepStats.processedElems > stepStats.totalElems)
+			stepStats.totalElems = stepStats.processedElems;
+	}};
+
+	for (const auto& walker : _deviceWalkers)
+	{
+		walker->stats = {};
+		walker->processedFileCount = 0;
+		walker->exploredDirectories.clear();
+		walker->lastDirectory = walker->resumeDirectory.value_or(std::filesystem::path {});
+		walker->paused = false;
+		walker->done = false;
+		resetIoThrottle(*walker);
+	}
+	_checkpointRequested = false;
+	_walkAborted = false;
+
+	// The devices are explored concurrently, the parsed files are written by this thread
+	std::vector<std::thread> walkerThreads;
+	for (const auto& walker : _deviceWalkers)
+		walkerThreads.emplace_back([this, &walker = *walker, forceScan]
+		{
+			const SamplingProfiler::ScopedSubsystem profilerSubsystem {SamplingProfiler::Subsystem::Scan};
+			walkMediaDirectories(walker, forceScan);
+		});
+
+	try
+	{
+		std::unique_lock lock {_walkMutex};
+		while (!_walkCondition.wait_for(lock, pollPeriod, [this]
+				{
+					return std::all_of(std::cbegin(_deviceWalkers), std::cend(_deviceWalkers), [](const auto& walker) { return walker->done; });
+				}))
+		{
+			lock.unlock();
+
+			processParsedAudioFiles(false, stats);
+			updateProgress();
+			notifyInProgressIfNeeded(stepStats);
+
+			saveCheckpointIfNeeded(forceScan, stats);
+
+			lock.lock();
+		}
+	}
+	catch (...)
+	{
+		// Do not leave the walkers running
+		_walkAborted = true;
+		{
+			std::scoped_lock lock {_walkMutex};
+			_checkpointRequested = false;
+		}
+		_walkCondition.notify_all();
+
+		for (std::thread& walkerThread : walkerThreads)
+			walkerThread.join();
+
+		_walkAborted = false;
+		throw;
+	}
+
+	for (std::thread& walkerThread : walkerThreads)
+		walkerThread.join();
+
+	mergeDeviceWalkerStats(stats);
+	updateProgress();
+
+	for (const auto& walker : _deviceWalkers)
+	{
+		std::move(std::begin(walker->exploredDirectories), std::end(walker->exploredDirectories), std::back_inserter(_exploredDirectories));
+		walker->exploredDirectories.clear();
+	}
+
+	// Now we know the exact number of files
+	if (_estimateFileCount && !_scanCancellation.isCancelled())
+		stats.filesScanned = stepStats.processedElems;
+
+	if (_scanCancellation.isCancelled())
+	{
+		clearPendingWrites();
+	}
+	else
+	{
+		processParsedAudioFiles(true, stats);
+		removeMoveCandidates(stats);
+	}
+
+	notifyInProgress(stepStats);
+}
+
+void
+MediaScanner::scanNewFiles(ScanStats& stats)
+{
+	// Most recently modified directories first: the ones that have just been added
+	std::unordered_map<std::filesystem::path, std::filesystem::file_time_type> directoryWriteTimes;
+	for (const std::filesystem::path& file : _newFiles)
+	{
+		auto [itDirectory, inserted] {directoryWriteTimes.try_emplace(file.parent_path())};
+		if (inserted)
+		{
+			std::error_code ec;
+			itDirectory->second = std::filesystem::last_write_time(itDirectory->first, ec);
+		}
+	}
+
+	std::sort(std::begin(_newFiles), std::end(_newFiles), [&](const std::filesystem::path& lhs, const std::filesystem::path& rhs)
+	{
+		const std::filesystem::file_time_type lhsWriteTime {directoryWriteTimes[lhs.parent_path()]};
+		const std::filesystem::file_time_type rhsWriteTime {directoryWriteTimes[rhs.parent_path()]};
+		if (lhsWriteTime != rhsWriteTime)
+			return lhsWriteTime > rhsWriteTime;
+
+		return lhs < rhs;
+	});
+
+	LMS_LOG(DBUPDATER, INFO) << "Scanning " << _newFiles.size() << " new file(s) first...";
+
+	const std::size_t changeCount {stats.nbChanges()};
+	for (const std::filesystem::path& file : _newFiles)
+	{
+		if (_scanCancellation.isCancelled())
+			break;
+
+		DeviceWalker* walker {getDeviceWalker(file)};
+		if (!walker)
+			continue;
+
+		scanAudioFile(*walker, *_dbSession, file, false, stats);
+		processParsedAudioFiles(false, stats);
+		_prioritizedFiles.insert(file);
+	}
+	_newFiles.clear();
+
+	// The walk cleans up the pending writes
+	if (_scanCancellation.isCancelled())
+		return;
+
+	processParsedAudioFiles(true, stats);
+
+	LMS_LOG(DBUPDATER, INFO) << "Scanning new files DONE, changes = " << stats.nbChanges() - changeCount;
+	if (stats.nbChanges() == changeCount)
+		return;
+
+	// Make the new releases available without waiting for the end of the scan
+	updateAggregates();
+	_libraryGeneration++;
+	libraryUpdated().emit();
+}
+
+void
+MediaScanner::walkMediaDirectories(DeviceWalker& walker, bool forceScan)
+{
+	setupWorkerThread();
+
+	try
+	{
+		Session session {getScanDb()};
+
+		for (const std::filesystem::path& mediaDirectory : walker.mediaDirectories)
+		{
+			if (isWalkAborted())
+				break;
+
+			// Already explored before the interruption
+			if (walker.resumeDirectory
+					&& *walker.resumeDirectory != mediaDirectory
+					&& !isPathInParentPath(*walker.resumeDirectory, mediaDirectory)
+					&& mediaDirectory < *walker.resumeDirectory)
+				continue;
+
+			LMS_LOG(DBUPDATER, DEBUG) << "Exploring media directory '" << mediaDirectory.string() << "'...";
+			scanDirectoryRecursive(walker, session, mediaDirectory, forceScan);
+			LMS_LOG(DBUPDATER, DEBUG) << "Exploring media directory '" << mediaDirectory.string() << "' DONE";
+		}
+	}
+	catch (std::exception& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Caught exception while exploring media directories: " << e.what();
+	}
+
+	{
+		std::scoped_lock lock {_walkMutex};
+		walker.done = true;
+	}
+	_walkCondition.notify_all();
+}
+
+void
+MediaScanner::scanDirectoryRecursive(DeviceWalker& walker, Session& session, const std::filesystem::path& directory, bool forceScan)
+{
+	if (isWalkAborted())
+		return;
+
+	Wt::WDateTime lastWriteTime;
+	try
+	{
+		lastWriteTime = getLastWriteTime(directory);
+	}
+	catch (LmsException& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << e.what();
+		walker.stats.errors.emplace_back(ScanError {directory, ScanErrorType::CannotReadFile});
+		return;
+	}
+
+	walker.exploredDirectories.emplace_back(directory, lastWriteTime);
+
+	// When resuming, the files of the directories leading to the last checkpoint directory are already committed
+	const bool onResumePath {walker.resumeDirectory && (*walker.resumeDirectory == directory || isPathInParentPath(*walker.resumeDirectory, directory))};
+	std::optional<std::filesystem::path> resumeSubDirectory;
+	if (onResumePath)
+	{
+		if (*walker.resumeDirectory == directory)
+			walker.resumeDirectory.reset();
+		else
+			resumeSubDirectory = directory / *walker.resumeDirectory->lexically_relative(directory).begin();
+	}
+
+	if (!forceScan && _skipUnchangedDirectories && !onResumePath)
+	{
+		// The entries of the directory did not change: only explore the known sub directories
+		auto itDirectoryInfo {_scannedDirectoryInfos.find(directory)};
+		if (itDirectoryInfo != std::cend(_scannedDirectoryInfos)
+				&& itDirectoryInfo->second.lastWriteTime == lastWriteTime.toTime_t()
+				&& itDirectoryInfo->second.scanVersion == _scanVersion)
+		{
+			walker.stats.skips += itDirectoryInfo->second.trackCount;
+			walker.processedFileCount += itDirectoryInfo->second.trackCount;
+
+			onDirectoryWalked(walker, directory);
+
+			for (const std::filesystem::path& subDirectory : itDirectoryInfo->second.subDirectories)
+				scanDirectoryRecursive(walker, session, subDirectory, forceScan);
+
+			return;
+		}
+	}
+
+	std::vector<std::filesystem::path> subDirectories;
+
+	std::error_code ec;
+	std::filesystem::directory_iterator itPath {directory, std::filesystem::directory_options::follow_directory_symlink, ec};
+	if (ec)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot process entry '" << directory.string() << "': " << ec.message();
+		walker.stats.errors.emplace_back(ScanError {directory, ScanErrorType::CannotReadFile, ec.message()});
+		return;
+	}
+
+	for (; itPath != std::filesystem::directory_iterator {}; itPath.increment(ec))
+	{
+		if (isWalkAborted())
+			return;
 
 		if (ec)
 		{
-			LMS_LOG(DBUPDATER, ERROR) << "Cannot process entry '" << path.string() << "': " << ec.message();
-			stats.errors.emplace_back(ScanError {path, ScanErrorType::CannotReadFile, ec.message()});
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot process entry '" << directory.string() << "': " << ec.message();
+			walker.stats.errors.emplace_back(ScanError {directory, ScanErrorType::CannotReadFile, ec.message()});
+			break;
+		}
+
+		const std::filesystem::path& path {itPath->path()};
+
+		if (std::filesystem::is_regular_file(path, ec))
+		{
+			if (!onResumePath && isFileSupported(path, _fileExtensions))
+			{
+				// Already counted in the stats by scanNewFiles
+				if (_prioritizedFiles.find(path) == std::cend(_prioritizedFiles))
+					scanAudioFile(walker, session, path, forceScan, walker.stats);
+				walker.processedFileCount++;
+			}
+		}
+		else if (!ec && std::filesystem::is_directory(path, ec))
+		{
+			subDirectories.push_back(path);
 		}
-		else if (isFileSupported(path, _fileExtensions))
+
+		if (ec)
 		{
-			scanAudioFile(path, forceScan, stats );
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot process entry '" << path.string() << "': " << ec.message();
+			walker.stats.errors.emplace_back(ScanError {path, ScanErrorType::CannotReadFile, ec.message()});
+			ec.clear();
+		}
+	}
+
+	if (!onResumePath)
+		onDirectoryWalked(walker, directory);
+
+	// Sorted to get the same exploration order across scans, as needed by checkpoints
+	std::sort(std::begin(subDirectories), std::end(subDirectories));
+	for (const std::filesystem::path& subDirectory : subDirectories)
+	{
+		// Already explored before the interruption
+		if (resumeSubDirectory && subDirectory < *resumeSubDirectory)
+			continue;
+
+		scanDirectoryRecursive(walker, session, subDirectory, forceScan);
+	}
+
+	// The checkpoint directory may not exist anymore
+	if (resumeSubDirectory)
+		walker.resumeDirectory.reset();
+}
+
+void
+MediaScanner::onDirectoryWalked(DeviceWalker& walker, const std::filesystem::path& directory)
+{
+	std::unique_lock lock {_walkMutex};
 
-			stepStats.processedElems++;
-			notifyInProgressIfNeeded(stepStats);
-		}
+	walker.lastDirectory = directory;
+	if (!_checkpointRequested)
+		return;
 
-		return true;
-	});
+	// Wait for the scan thread to commit the pushed files and to save the checkpoint
+	walker.paused = true;
+	_walkCondition.notify_all();
+	_walkCondition.wait(lock, [this] { return !_checkpointRequested; });
+	walker.paused = false;
+}
 
-	notifyInProgress(stepStats);
+void
+MediaScanner::mergeDeviceWalkerStats(ScanStats& stats)
+{
+	// The walkers are either paused or done
+	for (const auto& walker : _deviceWalkers)
+	{
+		stats.skips += walker->stats.skips;
+		walker->stats.skips = 0;
+
+		std::move(std::begin(walker->stats.errors), std::end(walker->stats.errors), std::back_inserter(stats.errors));
+		walker->stats.errors.clear();
+	}
 }
 
 // Check if a file exists and is still in a media directory
 static bool
-checkFile(const std::filesystem::path& p, const std::filesystem::path& mediaDirectory, const std::unordered_set<std::filesystem::path>& extensions)
+checkFile(const std::filesystem::path& p, const std::vector<std::filesystem::path>& mediaDirectories, const std::unordered_set<std::filesystem::path>& extensions)
 {
 	try
 	{
@@ -873,7 +2284,7 @@ checkFile(const std::filesystem::path& p, const std::filesystem::path& mediaDire
 			return false;
 		}
 
-		if (!isPathInParentPath(p, mediaDirectory))
+		if (std::none_of(std::cbegin(mediaDirectories), std::cend(mediaDirectories), [&](const std::filesystem::path& mediaDirectory) { return isPathInParentPath(p, mediaDirectory); }))
 		{
 			LMS_LOG(DBUPDATER, INFO) << "Removing '" << p.string() << "': out of media directory";
 			return false;
@@ -898,7 +2309,7 @@ checkFile(const std::filesystem::path& p, const std::filesystem::path& mediaDire
 void
 MediaScanner::removeMissingTracks(ScanStats& stats)
 {
-	static constexpr std::size_t batchSize {50};
+	static constexpr std::size_t batchSize {200};
 
 	ScanStepStats stepStats{stats.startTime, ScanProgressStep::ChekingForMissingFiles};
 
@@ -906,8 +2317,8 @@ MediaScanner::removeMissingTracks(ScanStats& stats)
 	std::size_t trackCount {};
 
 	{
-		auto transaction {_dbSession.createSharedTransaction()};
-		trackCount = Track::getCount(_dbSession);
+		auto transaction {_dbSession->createSharedTransaction()};
+		trackCount = Track::getCount(*_dbSession);
 	}
 	LMS_LOG(DBUPDATER, DEBUG) << trackCount << " tracks to be checked...";
 
@@ -923,33 +2334,25 @@ MediaScanner::removeMissingTracks(ScanStats& stats)
 		tracksToRemove.clear();
 
 		{
-			auto transaction {_dbSession.createSharedTransaction()};
-			trackPaths = Track::getAllPaths(_dbSession, i, batchSize);
+			auto transaction {_dbSession->createSharedTransaction()};
+			trackPaths = Track::getAllPaths(*_dbSession, i, batchSize);
 		}
 
-		for (const auto& [trackId, trackPath] : trackPaths)
-		{
-			if (_abortScan)
-				return;
-
-			if (!checkFile(trackPath, _mediaDirectory, _fileExtensions))
-				tracksToRemove.push_back(trackId);
+		if (_scanCancellation.isCancelled())
+			return;
 
-			stepStats.processedElems++;
-		}
+		tracksToRemove = getMissingTracks(trackPaths);
+		stepStats.processedElems += trackPaths.size();
 
 		if (!tracksToRemove.empty())
 		{
-			auto transaction {_dbSession.createUniqueTransaction()};
+			auto transaction {_dbSession->createUniqueTransaction()};
 
 			for (const IdType trackId : tracksToRemove)
 			{
-				Track::pointer track {Track::getById(_dbSession, trackId)};
+				Track::pointer track {Track::getById(*_dbSession, trackId)};
 				if (track)
-				{
-					track.remove();
-					stats.deletions++;
-				}
+					removeMissingTrack(track, stats);
 			}
 		}
 
@@ -963,56 +2366,430 @@ MediaScanner::removeMissingTracks(ScanStats& stats)
 }
 
 void
-MediaScanner::removeOrphanEntries()
+MediaScanner::removeMissingTracks(const std::filesystem::path& path, ScanStats& stats)
 {
-	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan clusters...";
+	std::vector<std::pair<Database::IdType, std::filesystem::path>> trackPaths;
 	{
-		auto transaction {_dbSession.createUniqueTransaction()};
+		auto transaction {_dbSession->createSharedTransaction()};
+		trackPaths = Track::getAllPathsUnder(*_dbSession, path);
+	}
 
-		// Now process orphan Cluster (no track)
-		auto clusters {Cluster::getAllOrphans(_dbSession)};
-		for (auto& cluster : clusters)
+	const std::vector<IdType> tracksToRemove {getMissingTracks(trackPaths)};
+	if (tracksToRemove.empty())
+		return;
+
+	auto transaction {_dbSession->createUniqueTransaction()};
+
+	for (const IdType trackId : tracksToRemove)
+	{
+		Track::pointer track {Track::getById(*_dbSession, trackId)};
+		if (track)
+			removeMissingTrack(track, stats);
+	}
+}
+
+std::vector<IdType>
+MediaScanner::getMissingTracks(const std::vector<std::pair<Database::IdType, std::filesystem::path>>& trackPaths)
+{
+	// Each check may be slow on network file systems: process them concurrently
+	std::vector<char> isValid(trackPaths.size());
+
+	// Not cancellable: unchecked files would be considered missing
+	Service<Scheduler>::get()->parallelFor(Scheduler::TaskClass::IO, _lowPriority ? Scheduler::Priority::Low : Scheduler::Priority::Normal, CancellationToken {}, trackPaths.size(),
+			[&](std::size_t i)
+			{
+				isValid[i] = checkFile(trackPaths[i].second, _mediaDirectories, _fileExtensions);
+			}, _fileCheckWorkerCount);
+
+	std::vector<IdType> missingTracks;
+	for (std::size_t i {}; i < trackPaths.size(); ++i)
+	{
+		if (!isValid[i])
+			missingTracks.push_back(trackPaths[i].first);
+	}
+
+	return missingTracks;
+}
+
+void
+MediaScanner::removeMissingTrack(Track::pointer track, ScanStats& stats)
+{
+	_dbSession->checkUniqueLocked();
+
+	// Keep the track until the end of the scan, in case the file reappears elsewhere
+	const std::string& fingerprint {track->getFingerprint()};
+	if (!fingerprint.empty())
+	{
+		std::scoped_lock lock {_pendingWritesMutex};
+		if (_moveCandidates.emplace(fingerprint, track.id()).second)
+			return;
+	}
+
+	track.remove();
+	stats.deletions++;
+}
+
+void
+MediaScanner::removeMoveCandidates(ScanStats& stats)
+{
+	std::unordered_map<std::string, Database::IdType> moveCandidates;
+	{
+		std::scoped_lock lock {_pendingWritesMutex};
+		moveCandidates.swap(_moveCandidates);
+	}
+
+	if (moveCandidates.empty())
+		return;
+
+	LMS_LOG(DBUPDATER, DEBUG) << "Removing " << moveCandidates.size() << " missing track(s)...";
+
+	{
+		auto transaction {_dbSession->createUniqueTransaction()};
+
+		for (const auto& [fingerprint, trackId] : moveCandidates)
 		{
-			LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan cluster '" << cluster->getName() << "'";
-			cluster.remove();
+			Track::pointer track {Track::getById(*_dbSession, trackId)};
+			if (track)
+			{
+				LMS_LOG(DBUPDATER, INFO) << "Removing '" << track->getPath().string() << "': missing";
+				track.remove();
+				stats.deletions++;
+			}
 		}
 	}
+}
 
-	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan artists...";
+void
+MediaScanner::refreshWatchers()
+{
+	if (!_watchEnabled)
+		return;
+
+	// Drop the watchers of the removed media directories
+	_watchers.erase(std::remove_if(std::begin(_watchers), std::end(_watchers), [this](const auto& watcher)
+			{
+				return !std::binary_search(std::cbegin(_mediaDirectories), std::cend(_mediaDirectories), watcher->getRootDirectory());
+			}), std::end(_watchers));
+
+	for (const std::filesystem::path& mediaDirectory : _mediaDirectories)
 	{
-		auto transaction {_dbSession.createUniqueTransaction()};
+		// Also retries the directories that could not be watched so far
+		if (std::any_of(std::cbegin(_watchers), std::cend(_watchers), [&](const auto& watcher) { return watcher->getRootDirectory() == mediaDirectory; }))
+			continue;
 
-		auto artists {Artist::getAllOrphans(_dbSession)};
-		for (auto& artist : artists)
+		try
+		{
+			_watchers.push_back(std::make_unique<FileSystemWatcher>(mediaDirectory, _watchDebounceDelay,
+					[this](const std::set<std::filesystem::path>& changedPaths, bool fullRescanNeeded)
+					{
+						_ioService.post([=]
+						{
+							if (_scanCancellation.isCancelled())
+								return;
+
+							if (fullRescanNeeded)
+								scheduleScan(false);
+							else
+								scanChangedPaths(changedPaths);
+						});
+					}));
+		}
+		catch (LmsException& e)
 		{
-			LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan artist '" << artist->getName() << "'";
-			artist.remove();
+			LMS_LOG(DBUPDATER, WARNING) << "Cannot watch media directory '" << mediaDirectory.string() << "': " << e.what() << ". Falling back on periodic scans only";
 		}
 	}
+}
 
-	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan releases...";
+void
+MediaScanner::scanChangedPaths(const std::set<std::filesystem::path>& changedPaths)
+{
+	if (!isScanAllowed())
+		return;
+
+	LMS_LOG(DBUPDATER, INFO) << "Processing " << changedPaths.size() << " changed path(s)...";
+
+	setupScanThread();
+
+	for (const auto& walker : _deviceWalkers)
+		resetIoThrottle(*walker);
+
+	ScanStats stats;
+	stats.startTime = Wt::WLocalDateTime::currentDateTime().toUTC();
+
+	// Remove first, so that moved files can be detected
+	for (const std::filesystem::path& changedPath : changedPaths)
+	{
+		if (_scanCancellation.isCancelled())
+			break;
+
+		removeMissingTracks(changedPath, stats);
+	}
+
+	for (const std::filesystem::path& changedPath : changedPaths)
+	{
+		if (_scanCancellation.isCancelled())
+			break;
+
+		// Not in a media directory anymore
+		DeviceWalker* walker {getDeviceWalker(changedPath)};
+		if (!walker)
+			continue;
+
+		std::error_code statusEc;
+		if (std::filesystem::is_directory(changedPath, statusEc))
+		{
+			exploreFilesRecursive(changedPath, [&](std::error_code ec, const std::filesystem::path& path)
+			{
+				if (_scanCancellation.isCancelled())
+					return false;
+
+				if (ec)
+					LMS_LOG(DBUPDATER, ERROR) << "Cannot process entry '" << path.string() << "': " << ec.message();
+				else if (isFileSupported(path, _fileExtensions))
+				{
+					scanAudioFile(*walker, *_dbSession, path, false, stats);
+					processParsedAudioFiles(false, stats);
+				}
+
+				return true;
+			});
+		}
+		else if (std::filesystem::is_regular_file(changedPath, statusEc) && isFileSupported(changedPath, _fileExtensions))
+		{
+			scanAudioFile(*walker, *_dbSession, changedPath, false, stats);
+			processParsedAudioFiles(false, stats);
+		}
+	}
+
+	if (_scanCancellation.isCancelled())
+	{
+		clearPendingWrites();
+		_lookupCache.clear();
+		return;
+	}
+
+	processParsedAudioFiles(true, stats);
+	removeMoveCandidates(stats);
+	_lookupCache.clear();
+
+	changedPathScanCount.inc();
+	scannedFileCount.inc(stats.scans);
+
+	LMS_LOG(DBUPDATER, INFO) << "Changed paths processed. Changes = " << stats.nbChanges() << " (added = " << stats.additions << ", removed = " << stats.deletions << ", updated = " << stats.updates << ", moved = " << stats.moves << "), errors = " << stats.errors.size();
+
+	if (stats.nbChanges() == 0)
+		return;
+
+	removeOrphanEntries();
+	updateAggregates();
+	_libraryGeneration++;
+	libraryUpdated().emit();
+	_recommendationEngine.load(true, _scanCancellation,
+			[](const Recommendation::IEngine::Progress& progress)
+			{
+				LMS_LOG(DBUPDATER, DEBUG) << "Reloading recommendation : " << progress.processedElems << "/" << progress.totalElems;
+			});
+
+	// The other nodes reload the classifier caches written just above
+	if (!_scanCancellation.isCancelled())
+		publishLibraryGeneration();
+}
+
+void
+MediaScanner::runLease()
+{
+	// Renewed well before expiry, so that a slow database does not make the lease change hands
+	const std::chrono::seconds renewPeriod {std::max<std::chrono::seconds>(std::chrono::seconds {1}, _leaseDuration / 3)};
+
+	while (true)
 	{
-		auto transaction {_dbSession.createUniqueTransaction()};
+		checkLease();
+
+		std::unique_lock lock {_leaseMutex};
+		if (_leaseCondition.wait_for(lock, renewPeriod, [this] { return _leaseQuit; }))
+			break;
+	}
 
-		auto releases {Release::getAllOrphans(_dbSession)};
-		for (auto& release : releases)
+	if (_leader)
+	{
+		Session& session {_db.getTLSSession()};
+		try
+		{
+			auto uniqueTransaction {session.createUniqueTransaction()};
+			ScannerLease::release(session, _nodeName);
+		}
+		catch (Wt::Dbo::Exception& e)
 		{
-			LMS_LOG(DBUPDATER, DEBUG) << "Removing orphan release '" << release->getName() << "'";
-			release.remove();
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot release scanner lease: " << e.what();
 		}
 	}
+}
+
+void
+MediaScanner::checkLease()
+{
+	Session& session {_db.getTLSSession()};
+
+	bool leader {};
+	std::optional<long long> libraryGeneration;
+	try
+	{
+		auto uniqueTransaction {session.createUniqueTransaction()};
+
+		leader = ScannerLease::acquire(session, _nodeName, _leaseDuration);
+		if (!leader)
+			libraryGeneration = ScannerLease::getLibraryGeneration(session);
+	}
+	catch (Wt::Dbo::Exception& e)
+	{
+		// Step down: the lease may be taken by another node once expired
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot check scanner lease: " << e.what();
+	}
+
+	if (leader != _leader)
+	{
+		if (leader)
+			onLeaseAcquired();
+		else
+			onLeaseLost();
+	}
+
+	if (libraryGeneration)
+	{
+		// The library loaded at startup is already up to date
+		if (_seenLibraryGeneration && *_seenLibraryGeneration != *libraryGeneration)
+			reloadPublishedLibrary();
+
+		_seenLibraryGeneration = libraryGeneration;
+	}
+}
+
+void
+MediaScanner::onLeaseAcquired()
+{
+	LMS_LOG(DBUPDATER, INFO) << "Scanner lease acquired, this node now scans the media directories";
+
+	_leader = true;
+	_seenLibraryGeneration.reset();
+
+	_ioService.post([this]
+	{
+		if (_scanCancellation.isCancelled())
+			return;
+
+		scheduleNextScan();
+	});
+}
+
+void
+MediaScanner::onLeaseLost()
+{
+	LMS_LOG(DBUPDATER, WARNING) << "Scanner lease lost, stopping scans";
+
+	_leader = false;
+	abortScan();
+
+	_ioService.post([this]
+	{
+		_watchers.clear();
+		scheduleNextScan();
+	});
+}
+
+void
+MediaScanner::reloadPublishedLibrary()
+{
+	LMS_LOG(DBUPDATER, INFO) << "New library generation published by the leader, reloading";
+
+	_ioService.post([this]
+	{
+		if (_scanCancellation.isCancelled())
+			return;
+
+		// Trained by the leader: only load its caches
+		_recommendationEngine.load(false, _scanCancellation,
+				[](const Recommendation::IEngine::Progress& progress)
+				{
+					LMS_LOG(DBUPDATER, DEBUG) << "Reloading recommendation : " << progress.processedElems << "/" << progress.totalElems;
+				});
+
+		_libraryGeneration++;
+		scanComplete().emit();
+	});
+}
+
+void
+MediaScanner::publishLibraryGeneration()
+{
+	if (!_leaderElection)
+		return;
+
+	Session& session {_db.getTLSSession()};
+	try
+	{
+		auto uniqueTransaction {session.createUniqueTransaction()};
+		ScannerLease::publishLibraryGeneration(session, _nodeName);
+	}
+	catch (Wt::Dbo::Exception& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Cannot publish library generation: " << e.what();
+	}
+}
+
+void
+MediaScanner::removeOrphanEntries()
+{
+	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan clusters...";
+	{
+		auto transaction {_dbSession->createUniqueTransaction()};
+
+		// Now process orphan Cluster (no track)
+		const std::size_t count {Cluster::removeAllOrphans(*_dbSession)};
+		LMS_LOG(DBUPDATER, DEBUG) << "Removed " << count << " orphan cluster(s)";
+	}
+
+	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan artists...";
+	{
+		auto transaction {_dbSession->createUniqueTransaction()};
+
+		const std::size_t count {Artist::removeAllOrphans(*_dbSession)};
+		LMS_LOG(DBUPDATER, DEBUG) << "Removed " << count << " orphan artist(s)";
+	}
+
+	LMS_LOG(DBUPDATER, DEBUG) << "Checking orphan releases...";
+	{
+		auto transaction {_dbSession->createUniqueTransaction()};
+
+		const std::size_t count {Release::removeAllOrphans(*_dbSession)};
+		LMS_LOG(DBUPDATER, DEBUG) << "Removed " << count << " orphan release(s)";
+	}
 
 	LMS_LOG(DBUPDATER, INFO) << "Check audio files done!";
 }
 
+void
+MediaScanner::updateAggregates()
+{
+	LMS_LOG(DBUPDATER, DEBUG) << "Updating aggregates...";
+
+	auto transaction {_dbSession->createUniqueTransaction()};
+
+	Release::updateAggregates(*_dbSession);
+	Artist::updateAggregates(*_dbSession);
+	Cluster::updateAggregates(*_dbSession);
+
+	LMS_LOG(DBUPDATER, DEBUG) << "Updating aggregates done!";
+}
+
 void
 MediaScanner::checkDuplicatedAudioFiles(ScanStats& stats)
 {
 	LMS_LOG(DBUPDATER, INFO) << "Checking duplicated audio files";
 
-	auto transaction {_dbSession.createSharedTransaction()};
+	auto transaction {_dbSession->createSharedTransaction()};
 
-	const std::vector<Track::pointer> tracks = Database::Track::getMBIDDuplicates(_dbSession);
+	const std::vector<Track::pointer> tracks = Database::Track::getMBIDDuplicates(*_dbSession);
 	for (const Track::pointer& track : tracks)
 	{
 		if (track->getMBID())
@@ -1038,8 +2815,85 @@ MediaScanner::reloadSimilarityEngine(ScanStats& stats)
 	}};
 
 	notifyInProgress(stepStats);
-	_recommendationEngine.load(stats.nbChanges() > 0, progressCallback);
+	_recommendationEngine.load(stats.nbChanges() > 0, _scanCancellation, progressCallback);
+	notifyInProgress(stepStats);
+}
+
+void
+MediaScanner::generateCovers(ScanStats& stats)
+{
+	CoverArt::IGrabber* coverArtGrabber {Service<CoverArt::IGrabber>::get()};
+	if (!coverArtGrabber)
+		return;
+
+	ScanStepStats stepStats {stats.startTime, ScanProgressStep::GeneratingCovers};
+
+	std::vector<IdType> releaseIds;
+	{
+		auto transaction {_dbSession->createSharedTransaction()};
+		releaseIds = Release::getAllIds(*_dbSession);
+	}
+
+	LMS_LOG(DBUPDATER, DEBUG) << "Generating covers for " << releaseIds.size() << " releases...";
+
+	stepStats.totalElems = releaseIds.size();
+	notifyInProgress(stepStats);
+
+	// Releases already up to date in the disk cache are quickly skipped
+	std::atomic<std::size_t> nextRelease {};
+	std::atomic<std::size_t> processedCount {};
+	std::atomic<std::size_t> generatedCount {};
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	Scheduler& scheduler {*Service<Scheduler>::get()};
+	const std::size_t workerCount {std::min(scheduler.getThreadCount(Scheduler::TaskClass::Cpu), releaseIds.size())};
+	std::size_t remainingWorkerCount {workerCount};
+
+	// Run at idle priority. The tasks themselves check for cancellation: they must all run for this wait to end
+	for (std::size_t i {}; i < workerCount; ++i)
+	{
+		scheduler.post(Scheduler::TaskClass::Cpu, Scheduler::Priority::Low, CancellationToken {}, [&]
+		{
+			Session session {_db};
+			for (std::size_t index {nextRelease++}; index < releaseIds.size() && !_scanCancellation.isCancelled(); index = nextRelease++)
+			{
+				for (const std::size_t size : _coverSizes)
+				{
+					try
+					{
+						if (coverArtGrabber->generateReleaseCover(session, releaseIds[index], size))
+							generatedCount++;
+					}
+					catch (std::exception& e)
+					{
+						LMS_LOG(DBUPDATER, ERROR) << "Cannot generate cover for release " << releaseIds[index] << ": " << e.what();
+					}
+				}
+
+				processedCount++;
+			}
+
+			std::scoped_lock lock {mutex};
+			remainingWorkerCount--;
+			condition.notify_one();
+		});
+	}
+
+	{
+		std::unique_lock lock {mutex};
+		while (!condition.wait_for(lock, std::chrono::seconds {1}, [&] { return remainingWorkerCount == 0; }))
+		{
+			stepStats.processedElems = processedCount;
+			notifyInProgressIfNeeded(stepStats);
+		}
+	}
+
+	stats.coversGenerated = generatedCount;
+	stepStats.processedElems = processedCount;
 	notifyInProgress(stepStats);
+
+	LMS_LOG(DBUPDATER, DEBUG) << generatedCount << " covers generated!";
 }
 
 } // namespace Scanner
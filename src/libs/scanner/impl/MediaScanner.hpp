@@ -19,9 +19,19 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <Wt/WDateTime.h>
 #include <Wt/WIOService.h>
@@ -29,11 +39,20 @@
 
 #include <boost/asio/system_timer.hpp>
 
+#include "database/Db.hpp"
 #include "database/Types.hpp"
+#include "database/ScanCheckpoint.hpp"
 #include "database/ScanSettings.hpp"
 #include "database/Session.hpp"
+#include "database/Track.hpp"
 #include "metadata/IParser.hpp"
 #include "scanner/IMediaScanner.hpp"
+#include "utils/CancellationToken.hpp"
+#include "utils/CpuAffinity.hpp"
+#include "AcousticBrainzUtils.hpp"
+#include "FileSystemWatcher.hpp"
+#include "LookupCache.hpp"
+#include "ParallelParser.hpp"
 
 class UUID;
 
@@ -59,9 +78,11 @@ class MediaScanner : public IMediaScanner
 		void requestImmediateScan(bool force) override;
 
 		Status getStatus() const override;
+		std::size_t getLibraryGeneration() const override { return _libraryGeneration; }
 
 		Wt::Signal<>& scanStarted() override { return _sigScanStarted; }
 		Wt::Signal<>& scanComplete() override { return _sigScanComplete; }
+		Wt::Signal<>& libraryUpdated() override { return _sigLibraryUpdated; }
 		Wt::Signal<ScanStepStats>& scanInProgress() override { return _sigScanInProgress; }
 		Wt::Signal<Wt::WDateTime>& scheduled() override { return _sigScheduled; }
 
@@ -79,36 +100,208 @@ class MediaScanner : public IMediaScanner
 		// Update database (scheduled callback)
 		void scan(bool force);
 
-		void scanMediaDirectory( const std::filesystem::path& mediaDirectory, bool forceScan, ScanStats& stats);
-		bool fetchTrackFeatures(Database::IdType trackId, const UUID& MBID);
+		// Explores the media directories located on a same device, using its own thread and parsers
+		// The walkers of the different devices run concurrently, the parsed files are written by the scan thread
+		struct DeviceWalker
+		{
+			std::vector<std::filesystem::path>	mediaDirectories;	// sorted
+			std::unique_ptr<ParallelParser>		parallelParser;
+
+			// I/O throttling, per device
+			std::chrono::steady_clock::time_point	throttleStartTime;
+			std::size_t								throttledFileCount {};
+			std::uintmax_t							throttledByteCount {};
+
+			// Current walk
+			ScanStats							stats;			// skips and errors, merged in the scan stats by the scan thread
+			std::atomic<std::size_t>			processedFileCount {};
+			std::vector<std::pair<std::filesystem::path, Wt::WDateTime>>	exploredDirectories;
+			std::optional<std::filesystem::path>	resumeDirectory;	// last directory whose files were committed before the interruption
+			std::filesystem::path				lastDirectory;	// last directory whose files have all been pushed to the parsers
+			bool								paused {};		// waiting for a checkpoint to be saved
+			bool								done {};
+		};
+
+		// Scan thread: CPU set only, as it holds the write transactions that the API and UI writes wait for
+		void setupScanThread() const;
+		// Walker and parser threads: CPU set and priority
+		void setupWorkerThread() const;
+		void createDeviceWalkers();
+		DeviceWalker* getDeviceWalker(const std::filesystem::path& path);
+		void scanMediaDirectories(bool forceScan, ScanStats& stats);
+		void walkMediaDirectories(DeviceWalker& walker, bool forceScan);
+		void scanDirectoryRecursive(DeviceWalker& walker, Database::Session& session, const std::filesystem::path& directory, bool forceScan);
+		void onDirectoryWalked(DeviceWalker& walker, const std::filesystem::path& directory);
+		void mergeDeviceWalkerStats(ScanStats& stats);
+		bool isWalkAborted() const;
+		void loadScannedDirectoryInfos();
+		void saveScannedDirectoryInfos();
+
+		// Checkpoints
+		bool isCheckpointResumable(const Database::ScanCheckpoint::pointer& checkpoint) const;
+		bool hasResumableCheckpoint();
+		std::optional<ScanProgressStep> resumeFromCheckpoint(bool& forceScan, ScanStats& stats);
+		void saveCheckpoint(ScanProgressStep step, const std::vector<std::filesystem::path>& directories, bool forceScan, const ScanStats& stats);
+		void saveCheckpointIfNeeded(bool forceScan, ScanStats& stats);
+		void removeCheckpoint();
+
+		// Full scans made in a new database, replacing the current one once done
+		Database::Db& getScanDb();
+		void startDatabaseRebuild();
+		void replaceDatabaseByRebuild();
+		void discardDatabaseRebuild();
+
+		// Watchers
+		void refreshWatchers();
+		void scanChangedPaths(const std::set<std::filesystem::path>& changedPaths);
 		void fetchTrackFeatures(ScanStats& stats);
 
+		// Leader election, when several processes share the database: only the lease holder scans
+		bool isScanAllowed() const { return !_leaderElection || _leader; }
+		void runLease();
+		void checkLease();
+		void onLeaseAcquired();
+		void onLeaseLost();
+		void reloadPublishedLibrary();
+		void publishLibraryGeneration();
+
 		// Helpers
 		void refreshScanSettings();
 
-		void countAllFiles(ScanStats& stats);
+		void countAllFiles(ScanStats& stats, bool collectNewFiles);
+		void scanNewFiles(ScanStats& stats);
+		void estimateFileCount(ScanStats& stats);
+		void loadTrackFileInfos();
 		void removeMissingTracks(ScanStats& stats);
+		void removeMissingTracks(const std::filesystem::path& path, ScanStats& stats);
+		std::vector<Database::IdType> getMissingTracks(const std::vector<std::pair<Database::IdType, std::filesystem::path>>& trackPaths);
+		void removeMissingTrack(Database::Track::pointer track, ScanStats& stats);
+		void removeMoveCandidates(ScanStats& stats);
 		void removeOrphanEntries();
+		void updateAggregates();
 		void checkDuplicatedAudioFiles(ScanStats& stats);
-		void scanAudioFile(const std::filesystem::path& file, bool forceScan, ScanStats& stats);
+		void scanAudioFile(DeviceWalker& walker, Database::Session& session, const std::filesystem::path& file, bool forceScan, ScanStats& stats);
 		Database::IdType doScanAudioFile(const std::filesystem::path& file, ScanStats& stats);
+		void processParsedAudioFiles(bool waitForAll, ScanStats& stats);
+		bool hasPendingWrites() const;	// _pendingWritesMutex must be held
+		void updateAudioFile(const ParallelParser::Result& parseResult, ScanStats& stats);
+		void clearPendingWrites();
+		void resetIoThrottle(DeviceWalker& walker);
+		void waitForIoBudget(DeviceWalker& walker, std::uintmax_t fileSize);
 		void notifyInProgressIfNeeded(const ScanStepStats& stats);
 		void notifyInProgress(const ScanStepStats& stats);
 		void reloadSimilarityEngine(ScanStats& stats);
+		void generateCovers(ScanStats& stats);
 
+		Database::Db&							_db;
 		Recommendation::IEngine&				_recommendationEngine;
 
 		std::mutex								_controlMutex;
-		std::atomic<bool>						_abortScan {};
+		CancellationToken						_scanCancellation;	// renewed after each abort
+		std::atomic<std::size_t>				_libraryGeneration {};
 		Wt::WIOService							_ioService;
 		boost::asio::system_timer				_scheduleTimer {_ioService};
 		Wt::Signal<>							_sigScanStarted;
 		Wt::Signal<>							_sigScanComplete;
+		Wt::Signal<>							_sigLibraryUpdated;
 		Wt::Signal<ScanStepStats>		_sigScanInProgress;
 		std::chrono::system_clock::time_point	_lastScanInProgressEmit {};
 		Wt::Signal<Wt::WDateTime>				_sigScheduled;
-		Database::Session						_dbSession;
-		std::unique_ptr<MetaData::IParser>		_metadataParser;
+		std::unique_ptr<Database::Session>		_dbSession;	// on the rebuilt database during a rebuild
+		const bool								_rebuildOnFullScan;
+		std::unique_ptr<Database::Db>			_rebuildDb;
+		std::vector<std::unique_ptr<DeviceWalker>>	_deviceWalkers;
+		const std::size_t						_parserWorkerCount;
+		const std::size_t						_deviceParserMaxWorkerCount;	// 0 means no limit
+		const std::size_t						_fileCheckWorkerCount;	// 0 means all the scheduler I/O threads
+		const std::size_t						_writeBatchSize;
+		const std::chrono::milliseconds			_writeBatchMaxDuration;
+		LookupCache								_lookupCache;
+
+		// Pending writes, filled by the walkers and written by the scan thread
+		std::mutex								_pendingWritesMutex;
+		std::vector<ParallelParser::Result>		_pendingWrites;
+		std::chrono::steady_clock::time_point	_pendingWritesStartTime;
+
+		// I/O throttling, to leave some bandwidth to the streams
+		const std::size_t						_maxFilesPerSecond;
+		const std::size_t						_maxBytesPerSecond;
+		const std::size_t						_pauseActiveStreamCount;
+		const bool								_lowPriority;
+		const CpuAffinity::CpuSet				_cpuSet;	// also used by the recommendation engine training, done by the scan thread
+
+		// Missing tracks, by fingerprint: they may reappear elsewhere during the scan
+		// Guarded by _pendingWritesMutex, as well as the pending moves and file sizes
+		std::unordered_map<std::string, Database::IdType>	_moveCandidates;
+		struct PendingMove
+		{
+			Database::IdType		trackId;
+			std::filesystem::path	file;
+			Wt::WDateTime			lastWriteTime;
+		};
+		std::vector<PendingMove>	_pendingMoves;
+
+		// Unchanged tracks scanned before their file size was recorded
+		struct PendingFileSize
+		{
+			Database::IdType	trackId;
+			std::uintmax_t		fileSize;
+		};
+		std::vector<PendingFileSize>	_pendingFileSizes;
+
+		// Snapshot of the tracks already in database, used to quickly skip unchanged files
+		struct TrackFileInfo
+		{
+			Database::IdType id;
+			std::time_t lastWriteTime;
+			std::size_t scanVersion;
+			std::uintmax_t fileSize;
+		};
+		std::unordered_map<std::filesystem::path, TrackFileInfo>	_trackFileInfos;
+
+		// Snapshot of the directories explored during the last scan, used to skip unchanged directories
+		struct ScannedDirectoryInfo
+		{
+			std::time_t lastWriteTime;
+			std::size_t scanVersion;
+			std::vector<std::filesystem::path> subDirectories;
+			std::size_t trackCount {};
+		};
+		const bool				_skipUnchangedDirectories;
+		const bool				_estimateFileCount;
+		const bool				_reuseAudioProperties;
+		const bool				_cacheTags;
+		const bool				_prioritizeNewFiles;
+		std::vector<std::filesystem::path>			_newFiles;			// supported files not in database, found while counting the files
+		std::unordered_set<std::filesystem::path>	_prioritizedFiles;	// already scanned before the walk, skipped by the walkers
+		const AcousticBrainz::FetchSettings	_featuresFetchSettings;
+		std::vector<std::size_t>	_coverSizes;	// release covers generated in the cover disk cache, at idle priority
+		std::unordered_map<std::filesystem::path, ScannedDirectoryInfo>	_scannedDirectoryInfos;
+		std::vector<std::pair<std::filesystem::path, Wt::WDateTime>>	_exploredDirectories;
+
+		// Progress of the current scan, to resume it if interrupted
+		const std::chrono::seconds				_checkpointInterval;
+		std::chrono::steady_clock::time_point	_lastCheckpointTime;
+
+		// Synchronization of the walkers with the scan thread
+		std::mutex								_walkMutex;
+		std::condition_variable					_walkCondition;		// signaled when a walker pauses or is done, and when the checkpoint is saved
+		bool									_checkpointRequested {};
+		std::atomic<bool>						_walkAborted {};
+
+		const bool								_watchEnabled;
+		const std::chrono::milliseconds			_watchDebounceDelay;
+		std::vector<std::unique_ptr<FileSystemWatcher>>	_watchers;	// one per media directory
+
+		const bool								_leaderElection;
+		const std::chrono::seconds				_leaseDuration;
+		const std::string						_nodeName;
+		std::atomic<bool>						_leader {};
+		std::optional<long long>				_seenLibraryGeneration;	// published by the leader, only used by the lease thread
+		std::mutex								_leaseMutex;
+		std::condition_variable					_leaseCondition;
+		bool									_leaseQuit {};
+		std::thread								_leaseThread;
 
 		mutable std::shared_mutex			_statusMutex;
 		State								_curState {State::NotScheduled};
@@ -121,7 +314,7 @@ class MediaScanner : public IMediaScanner
 		Wt::WTime				_startTime;
 		Database::ScanSettings::UpdatePeriod 	_updatePeriod {Database::ScanSettings::UpdatePeriod::Never};
 		std::unordered_set<std::filesystem::path> _fileExtensions;
-		std::filesystem::path			_mediaDirectory;
+		std::vector<std::filesystem::path>	_mediaDirectories;	// sorted
 		Database::ScanSettings::RecommendationEngineType _recommendationEngineType;
 
 }; // class MediaScanner
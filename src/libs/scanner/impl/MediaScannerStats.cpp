@@ -19,8 +19,27 @@
 
 #include "scanner/MediaScannerStats.hpp"
 
+#include <algorithm>
+#include <ostream>
+
 namespace Scanner {
 
+const char*
+getScanProgressStepName(ScanProgressStep step)
+{
+	switch (step)
+	{
+		case ScanProgressStep::ChekingForMissingFiles:		return "Checking for missing files";
+		case ScanProgressStep::DiscoveringFiles:			return "Discovering files";
+		case ScanProgressStep::ScanningFiles:				return "Scanning files";
+		case ScanProgressStep::FetchingTrackFeatures:		return "Fetching track features";
+		case ScanProgressStep::ReloadingSimilarityEngine:	return "Reloading similarity engine";
+		case ScanProgressStep::GeneratingCovers:			return "Generating covers";
+	}
+
+	return "?";
+}
+
 ScanError::ScanError(const std::filesystem::path& _file, ScanErrorType _error, const std::string& _systemError)
 : file {_file},
 error {_error},
@@ -31,13 +50,29 @@ systemError {_systemError}
 std::size_t
 ScanStats::nbFiles() const
 {
-	return skips + additions + updates;
+	return skips + additions + updates + moves;
 }
 
 std::size_t
 ScanStats::nbChanges() const
 {
-	return additions + deletions + updates;
+	return additions + deletions + updates + moves;
+}
+
+void
+ScanStats::addParseDuration(const std::filesystem::path& file, std::chrono::microseconds duration)
+{
+	parseDurationsByExtension[file.extension().string()].add(duration);
+
+	if (slowestParsedFiles.size() == maxSlowestParsedFiles && slowestParsedFiles.back().duration >= duration)
+		return;
+
+	auto it {std::upper_bound(std::begin(slowestParsedFiles), std::end(slowestParsedFiles), duration,
+			[](std::chrono::microseconds value, const FileParseDuration& entry) { return value > entry.duration; })};
+	slowestParsedFiles.insert(it, FileParseDuration {file, duration});
+
+	if (slowestParsedFiles.size() > maxSlowestParsedFiles)
+		slowestParsedFiles.pop_back();
 }
 
 unsigned
@@ -46,5 +81,71 @@ ScanStepStats::progress() const
 	return (processedElems / static_cast<float>(totalElems ? totalElems : 1)) * 100;
 }
 
+void
+DurationHistogram::add(std::chrono::microseconds duration)
+{
+	const auto itBound {std::find_if(std::cbegin(bucketUpperBoundsMs), std::cend(bucketUpperBoundsMs),
+			[&](unsigned boundMs) { return duration < std::chrono::milliseconds {boundMs}; })};
+	buckets[std::distance(std::cbegin(bucketUpperBoundsMs), itBound)]++;
+
+	count++;
+	total += duration;
+	max = std::max(max, duration);
+}
+
+std::chrono::microseconds
+DurationHistogram::mean() const
+{
+	return count ? total / static_cast<std::chrono::microseconds::rep>(count) : std::chrono::microseconds {};
+}
+
+static
+void
+writeHistogram(std::ostream& os, const DurationHistogram& histogram)
+{
+	os << "count = " << histogram.count
+		<< ", mean = " << histogram.mean().count() << "us"
+		<< ", max = " << histogram.max.count() << "us"
+		<< ", distribution =";
+
+	for (std::size_t i {}; i < histogram.buckets.size(); ++i)
+	{
+		if (i < DurationHistogram::bucketUpperBoundsMs.size())
+			os << " <" << DurationHistogram::bucketUpperBoundsMs[i] << "ms: ";
+		else
+			os << " >=" << DurationHistogram::bucketUpperBoundsMs.back() << "ms: ";
+		os << histogram.buckets[i];
+	}
+}
+
+void
+writeProfile(std::ostream& os, const ScanStats& stats)
+{
+	os << "Step timings:\n";
+	for (unsigned i {}; i < ScanProgressStepCount; ++i)
+	{
+		const ScanStepTimings& timings {stats.stepTimings[i]};
+		os << "  " << getScanProgressStepName(static_cast<ScanProgressStep>(i)) << ": wall = " << timings.wallTime.count() << "ms, cpu = " << timings.cpuTime.count() << "ms\n";
+	}
+	os << "  Removing orphan entries: wall = " << stats.orphanRemovalTimings.wallTime.count() << "ms, cpu = " << stats.orphanRemovalTimings.cpuTime.count() << "ms\n";
+	os << "  Updating aggregates: wall = " << stats.aggregatesUpdateTimings.wallTime.count() << "ms, cpu = " << stats.aggregatesUpdateTimings.cpuTime.count() << "ms\n";
+
+	os << "Parse durations:\n";
+	for (const auto& [extension, histogram] : stats.parseDurationsByExtension)
+	{
+		os << "  " << (extension.empty() ? "<none>" : extension) << ": ";
+		writeHistogram(os, histogram);
+		os << "\n";
+	}
+
+	os << "Slowest parsed files:\n";
+	for (const FileParseDuration& entry : stats.slowestParsedFiles)
+		os << "  " << entry.file.string() << ": " << entry.duration.count() << "us\n";
+
+	os << "Database commits: ";
+	writeHistogram(os, stats.dbCommitDurations);
+	os << "\n";
+}
+
 } // namespace Scanner
 
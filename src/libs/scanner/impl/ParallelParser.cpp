@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParallelParser.hpp"
+
+#include <cassert>
+
+#include "utils/Exception.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Path.hpp"
+
+namespace Scanner {
+
+ParallelParser::ParallelParser(std::size_t workerCount, ParserFactory parserFactory, WorkerInit workerInit)
+: _maxPendingJobs {workerCount * 4}
+, _workerInit {std::move(workerInit)}
+{
+	if (workerCount == 0)
+		throw LmsException {"Invalid parser worker count"};
+
+	LMS_LOG(DBUPDATER, INFO) << "Using " << workerCount << " parser worker(s)";
+
+	for (std::size_t i {}; i < workerCount; ++i)
+		_parsers.emplace_back(parserFactory());
+
+	for (std::size_t i {}; i < workerCount; ++i)
+		_workers.emplace_back([this, &parser = *_parsers[i]] { workerLoop(parser); });
+}
+
+ParallelParser::~ParallelParser()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+		_jobs.clear();
+	}
+	_jobsCondition.notify_all();
+
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+void
+ParallelParser::setClusterTypeNames(const std::set<std::string>& clusterTypeNames)
+{
+	std::scoped_lock lock {_mutex};
+
+	assert(_jobs.empty() && _ongoingJobCount == 0);
+
+	for (auto& parser : _parsers)
+		parser->setClusterTypeNames(clusterTypeNames);
+}
+
+void
+ParallelParser::setCacheTags(bool cacheTags)
+{
+	std::scoped_lock lock {_mutex};
+
+	assert(_jobs.empty() && _ongoingJobCount == 0);
+
+	_cacheTags = cacheTags;
+}
+
+void
+ParallelParser::push(const std::filesystem::path& file, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize, bool readAudioProperties, const std::string& fingerprint)
+{
+	pushJob(Job {file, lastWriteTime, fileSize, readAudioProperties, fingerprint, {}});
+}
+
+void
+ParallelParser::pushCachedTags(const std::filesystem::path& file, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize, std::vector<unsigned char> cachedTags)
+{
+	pushJob(Job {file, lastWriteTime, fileSize, true, {}, std::move(cachedTags)});
+}
+
+void
+ParallelParser::pushJob(Job job)
+{
+	{
+		std::unique_lock lock {_mutex};
+
+		_resultsCondition.wait(lock, [&] { return _jobs.size() < _maxPendingJobs; });
+		_jobs.push_back(std::move(job));
+	}
+
+	_jobsCondition.notify_one();
+}
+
+std::vector<ParallelParser::Result>
+ParallelParser::popResults(bool waitForAll)
+{
+	std::vector<Result> results;
+
+	std::unique_lock lock {_mutex};
+
+	if (waitForAll)
+		_resultsCondition.wait(lock, [&] { return _jobs.empty() && _ongoingJobCount == 0; });
+
+	results.swap(_results);
+
+	return results;
+}
+
+void
+ParallelParser::clear()
+{
+	std::unique_lock lock {_mutex};
+
+	_jobs.clear();
+	_resultsCondition.wait(lock, [&] { return _ongoingJobCount == 0; });
+	_results.clear();
+}
+
+void
+ParallelParser::workerLoop(MetaData::IParser& parser)
+{
+	if (_workerInit)
+		_workerInit();
+
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock lock {_mutex};
+
+			_jobsCondition.wait(lock, [&] { return _quit || !_jobs.empty(); });
+			if (_quit)
+				return;
+
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+			_ongoingJobCount++;
+		}
+		_resultsCondition.notify_all();
+
+		Result result {job.file, job.lastWriteTime, job.fileSize, job.readAudioProperties, {}, std::nullopt, {}, false, {}};
+		parseFile(parser, job, result);
+
+		{
+			std::scoped_lock lock {_mutex};
+
+			_results.emplace_back(std::move(result));
+			_ongoingJobCount--;
+		}
+		_resultsCondition.notify_all();
+	}
+}
+
+void
+ParallelParser::parseFile(MetaData::IParser& parser, Job& job, Result& result) const
+{
+	std::optional<MetaData::RawTrack> cachedRawTrack;
+	if (!job.cachedTags.empty())
+	{
+		cachedRawTrack = MetaData::deserializeRawTrack(job.cachedTags);
+		if (!cachedRawTrack)
+			LMS_LOG(DBUPDATER, DEBUG) << "Invalid cached tags for '" << job.file.string() << "', reading file";
+	}
+
+	// Kept as is when built from cached tags
+	if (!cachedRawTrack && job.fingerprint.empty())
+	{
+		try
+		{
+			job.fingerprint = computeFingerprint(job.file);
+		}
+		catch (LmsException& e)
+		{
+			LMS_LOG(DBUPDATER, ERROR) << "Cannot compute fingerprint: " << e.what();
+		}
+	}
+
+	const auto parseStart {std::chrono::steady_clock::now()};
+
+	try
+	{
+		if (cachedRawTrack)
+		{
+			// Audio properties may not have been read at that time
+			result.readAudioProperties = false;
+			result.fromCachedTags = true;
+			result.trackInfo = parser.parseRawTrack(*cachedRawTrack);
+		}
+		else
+		{
+			result.fingerprint = job.fingerprint;
+
+			parser.setReadAudioProperties(job.readAudioProperties);
+			const std::optional<MetaData::RawTrack> rawTrack {parser.readRawTrack(job.file)};
+			if (rawTrack)
+			{
+				result.trackInfo = parser.parseRawTrack(*rawTrack);
+				if (_cacheTags)
+					result.rawTags = MetaData::serializeRawTrack(*rawTrack);
+			}
+		}
+	}
+	catch (std::exception& e)
+	{
+		LMS_LOG(DBUPDATER, ERROR) << "Caught exception while parsing file '" << job.file.string() << "': " << e.what();
+	}
+
+	result.parseDuration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - parseStart);
+}
+
+} // namespace Scanner
+
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Wt/WDateTime.h>
+
+#include "metadata/IParser.hpp"
+
+namespace Scanner {
+
+// Parses files using a set of worker threads, each of them owning its own parser
+// Files are pushed by a single producer and results are popped by a single consumer
+class ParallelParser
+{
+	public:
+		struct Result
+		{
+			std::filesystem::path			file;
+			Wt::WDateTime					lastWriteTime;
+			std::uintmax_t					fileSize;
+			bool							readAudioProperties;	// if not set, the audio properties of the track may be missing
+			std::string						fingerprint;	// empty if it could not be computed, or if built from cached tags
+			std::optional<MetaData::Track>	trackInfo;
+			std::chrono::microseconds		parseDuration;
+			bool							fromCachedTags;	// the file has not been read
+			std::vector<unsigned char>		rawTags;	// serialized tags read from the file, empty if not to be cached
+		};
+
+		using ParserFactory = std::function<std::unique_ptr<MetaData::IParser>()>;
+		using WorkerInit = std::function<void()>;
+
+		// workerInit, if set, is called by each worker thread before parsing any file
+		ParallelParser(std::size_t workerCount, ParserFactory parserFactory, WorkerInit workerInit = {});
+		~ParallelParser();
+
+		ParallelParser(const ParallelParser&) = delete;
+		ParallelParser(ParallelParser&&) = delete;
+		ParallelParser& operator=(const ParallelParser&) = delete;
+		ParallelParser& operator=(ParallelParser&&) = delete;
+
+		std::size_t getWorkerCount() const { return _workers.size(); }
+
+		// Must not be called while files are being parsed
+		void setClusterTypeNames(const std::set<std::string>& clusterTypeNames);
+		// If set, the tags read from the files are also returned in serialized form, to be cached
+		void setCacheTags(bool cacheTags);
+
+		// Blocks if too many files are already waiting to be parsed
+		// The fingerprint is computed by the workers if not provided
+		void push(const std::filesystem::path& file, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize, bool readAudioProperties, const std::string& fingerprint = {});
+		// The track is built from tags previously read from the file (see MetaData::serializeRawTrack), the file is read only if they are invalid
+		void pushCachedTags(const std::filesystem::path& file, const Wt::WDateTime& lastWriteTime, std::uintmax_t fileSize, std::vector<unsigned char> cachedTags);
+
+		// Results are not ordered
+		// If waitForAll is set, wait for all the pushed files to be parsed
+		std::vector<Result> popResults(bool waitForAll);
+
+		// Drop pending files and results
+		void clear();
+
+	private:
+		struct Job
+		{
+			std::filesystem::path	file;
+			Wt::WDateTime			lastWriteTime;
+			std::uintmax_t			fileSize {};
+			bool					readAudioProperties {true};
+			std::string				fingerprint;
+			std::vector<unsigned char>	cachedTags;
+		};
+
+		void workerLoop(MetaData::IParser& parser);
+		void pushJob(Job job);
+		void parseFile(MetaData::IParser& parser, Job& job, Result& result) const;
+
+		const std::size_t	_maxPendingJobs;
+		const WorkerInit	_workerInit;
+		bool				_cacheTags {};
+
+		std::vector<std::unique_ptr<MetaData::IParser>> _parsers;
+		std::vector<std::thread>	_workers;
+
+		std::mutex					_mutex;
+		std::condition_variable		_jobsCondition;		// signaled when a job is added or on quit
+		std::condition_variable		_resultsCondition;	// signaled when a job is taken or a result is added
+		bool						_quit {};
+		std::deque<Job>				_jobs;
+		std::vector<Result>			_results;
+		std::size_t					_ongoingJobCount {};
+};
+
+} // namespace Scanner
+
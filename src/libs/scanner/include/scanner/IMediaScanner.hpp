@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <optional>
 
 #include <Wt/WDateTime.h>
@@ -64,12 +65,18 @@ class IMediaScanner
 
 		virtual Status getStatus() const = 0;
 
+		// Incremented each time the library contents change (scan complete, watched changes applied, new files published during a scan)
+		virtual std::size_t getLibraryGeneration() const = 0;
+
 		// Called just after scan start
 		virtual Wt::Signal<>& scanStarted() = 0;
 
 		// Called just after scan complete
 		virtual Wt::Signal<>& scanComplete() = 0;
 
+		// Called when the library contents changed without a scan completion: watched changes applied, new files published during a scan
+		virtual Wt::Signal<>& libraryUpdated() = 0;
+
 		// Called during scan in progress
 		virtual Wt::Signal<ScanStepStats>& scanInProgress() = 0;
 
@@ -21,7 +21,12 @@
 
 #include <Wt/WDateTime.h>
 
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <iosfwd>
+#include <map>
+#include <string>
 #include <vector>
 
 #include "database/Types.hpp"
@@ -64,8 +69,11 @@ namespace Scanner {
 		ScanningFiles,
 		FetchingTrackFeatures,
 		ReloadingSimilarityEngine,
+		GeneratingCovers,
 	};
-	static inline constexpr unsigned ScanProgressStepCount {5};
+	static inline constexpr unsigned ScanProgressStepCount {6};
+
+	const char* getScanProgressStepName(ScanProgressStep step);
 
 	// reduced scan stats
 	struct ScanStepStats
@@ -80,6 +88,32 @@ namespace Scanner {
 		unsigned		progress() const;
 	};
 
+	struct ScanStepTimings
+	{
+		std::chrono::milliseconds	wallTime {};
+		std::chrono::milliseconds	cpuTime {};		// process CPU time, includes the parser workers
+	};
+
+	struct DurationHistogram
+	{
+		// the last bucket holds the durations above the last bound
+		static inline constexpr std::array<unsigned, 7> bucketUpperBoundsMs {1, 5, 10, 50, 100, 500, 1000};
+
+		std::array<std::size_t, bucketUpperBoundsMs.size() + 1> buckets {};
+		std::size_t					count {};
+		std::chrono::microseconds	total {};
+		std::chrono::microseconds	max {};
+
+		void						add(std::chrono::microseconds duration);
+		std::chrono::microseconds	mean() const;
+	};
+
+	struct FileParseDuration
+	{
+		std::filesystem::path		file;
+		std::chrono::microseconds	duration;
+	};
+
 	struct ScanStats
 	{
 		Wt::WDateTime	startTime;
@@ -93,15 +127,33 @@ namespace Scanner {
 		std::size_t	additions {};		// added in DB
 		std::size_t	deletions {};		// removed from DB
 		std::size_t	updates {};			// updated file in DB
+		std::size_t	moves {};			// moved file, updated in DB without being scanned
 
 		std::size_t	featuresFetched {};	// features fetched in DB
+		std::size_t	coversGenerated {};	// release covers stored in the cover disk cache
 
 		std::vector<ScanError>		errors;
 		std::vector<ScanDuplicate>	duplicates;
 
+		// Profiling
+		static inline constexpr std::size_t maxSlowestParsedFiles {10};
+
+		std::array<ScanStepTimings, ScanProgressStepCount>	stepTimings;
+		ScanStepTimings									orphanRemovalTimings;
+		ScanStepTimings									aggregatesUpdateTimings;
+		std::map<std::string, DurationHistogram>		parseDurationsByExtension;
+		std::vector<FileParseDuration>					slowestParsedFiles;	// slowest first
+		DurationHistogram								dbCommitDurations;
+
 		std::size_t	nbFiles() const;
 		std::size_t	nbChanges() const;
+
+		ScanStepTimings&	getStepTimings(ScanProgressStep step) { return stepTimings[static_cast<unsigned>(step)]; }
+		void				addParseDuration(const std::filesystem::path& file, std::chrono::microseconds duration);
 	};
 
+	// Human readable dump of the profiling data
+	void writeProfile(std::ostream& os, const ScanStats& stats);
+
 }
 
@@ -47,6 +47,7 @@ variance(const std::vector<T>& vec)
 
 DataNormalizer::DataNormalizer(std::size_t inputDimCount)
 : _inputDimCount{inputDimCount}
+, _minmax(inputDimCount)
 {
 }
 
@@ -68,23 +69,46 @@ DataNormalizer::computeNormalizationFactors(const std::vector<InputVector>& inpu
 	if (inputVectors.empty())
 		throw Exception("Empty input vectors");
 
-	// For each dimension of the input, compute the min/max
-	_minmax.clear();
-	_minmax.resize(_inputDimCount);
+	_sampleCount = 0;
+	for (const InputVector& inputVector : inputVectors)
+		update(inputVector);
 
+	finalize();
+}
+
+void
+DataNormalizer::update(const InputVector& inputVector)
+{
+	checkSameDimensions(inputVector, _inputDimCount);
+
+	// For each dimension of the input, keep track of the min/max
+	const InputVector::value_type* values {inputVector.data()};
 	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
 	{
-		std::vector<InputVector::value_type> values;
+		const InputVector::value_type value {values[dimId]};
 
-		for (const auto& inputVector: inputVectors)
+		if (_sampleCount == 0)
 		{
-			checkSameDimensions(inputVector, _inputDimCount);
-			values.push_back(inputVector[dimId]);
+			_minmax[dimId] = {value, value};
+		}
+		else
+		{
+			_minmax[dimId].min = std::min(_minmax[dimId].min, value);
+			_minmax[dimId].max = std::max(_minmax[dimId].max, value);
 		}
-
-		auto result {std::minmax_element(values.begin(), values.end())};
-		_minmax[dimId] = {*result.first, *result.second};
 	}
+
+	_sampleCount++;
+}
+
+void
+DataNormalizer::finalize()
+{
+	if (_sampleCount == 0)
+		throw Exception("Empty input vectors");
+
+	// Next update starts a new computation
+	_sampleCount = 0;
 }
 
 InputVector::value_type
@@ -104,10 +128,14 @@ DataNormalizer::normalizeData(InputVector& a) const
 {
 	checkSameDimensions(a, _inputDimCount);
 
+	normalizeData(a.data());
+}
+
+void
+DataNormalizer::normalizeData(InputVector::value_type* data) const
+{
 	for (std::size_t dimId {}; dimId < _inputDimCount; ++dimId)
-	{
-		a[dimId] = normalizeValue(a[dimId], dimId);
-	}
+		data[dimId] = normalizeValue(data[dimId], dimId);
 }
 
 void
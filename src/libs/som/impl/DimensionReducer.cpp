@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "som/DimensionReducer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace SOM
+{
+
+namespace
+{
+	// Cyclic Jacobi method: diagonalizes the symmetric size * size matrix, whose values are stored row by row
+	// On return, the diagonal holds the eigenvalues and the columns of eigenVectors the matching eigenvectors
+	void
+	computeEigenDecomposition(std::vector<double>& matrix, std::size_t size, std::vector<double>& eigenVectors)
+	{
+		auto at {[size](std::vector<double>& values, std::size_t row, std::size_t column) -> double& { return values[row * size + column]; }};
+
+		eigenVectors.assign(size * size, 0);
+		for (std::size_t i {}; i < size; ++i)
+			at(eigenVectors, i, i) = 1;
+
+		constexpr std::size_t maxSweepCount {100};
+		for (std::size_t sweep {}; sweep < maxSweepCount; ++sweep)
+		{
+			double diagonalSum {};
+			double offDiagonalSum {};
+			for (std::size_t p {}; p < size; ++p)
+			{
+				diagonalSum += at(matrix, p, p) * at(matrix, p, p);
+				for (std::size_t q {p + 1}; q < size; ++q)
+					offDiagonalSum += at(matrix, p, q) * at(matrix, p, q);
+			}
+
+			if (offDiagonalSum <= diagonalSum * 1e-24)
+				break;
+
+			for (std::size_t p {}; p + 1 < size; ++p)
+			{
+				for (std::size_t q {p + 1}; q < size; ++q)
+				{
+					const double apq {at(matrix, p, q)};
+					if (apq == 0)
+						continue;
+
+					// Rotation that zeroes matrix[p][q]
+					const double theta {(at(matrix, q, q) - at(matrix, p, p)) / (2 * apq)};
+					const double t {(theta >= 0 ? 1. : -1.) / (std::abs(theta) + std::sqrt(theta * theta + 1))};
+					const double c {1 / std::sqrt(t * t + 1)};
+					const double s {t * c};
+
+					for (std::size_t k {}; k < size; ++k)
+					{
+						const double akp {at(matrix, k, p)};
+						const double akq {at(matrix, k, q)};
+						at(matrix, k, p) = c * akp - s * akq;
+						at(matrix, k, q) = s * akp + c * akq;
+					}
+					for (std::size_t k {}; k < size; ++k)
+					{
+						const double apk {at(matrix, p, k)};
+						const double aqk {at(matrix, q, k)};
+						at(matrix, p, k) = c * apk - s * aqk;
+						at(matrix, q, k) = s * apk + c * aqk;
+					}
+					for (std::size_t k {}; k < size; ++k)
+					{
+						const double vkp {at(eigenVectors, k, p)};
+						const double vkq {at(eigenVectors, k, q)};
+						at(eigenVectors, k, p) = c * vkp - s * vkq;
+						at(eigenVectors, k, q) = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+	}
+}
+
+DimensionReducer::DimensionReducer(std::size_t inputDimCount, std::size_t outputDimCount)
+: _inputDimCount {inputDimCount}
+, _outputDimCount {outputDimCount}
+, _weights {inputDimCount, 1}
+, _mean {inputDimCount}
+, _components(outputDimCount, InputVector {inputDimCount})
+{
+	if (outputDimCount == 0 || outputDimCount > inputDimCount)
+		throw Exception {"Bad output dimension count"};
+}
+
+void
+DimensionReducer::setDataWeights(const InputVector& weights)
+{
+	checkSameDimensions(weights, _inputDimCount);
+
+	_weights = weights;
+}
+
+void
+DimensionReducer::update(const InputVector& dataSample)
+{
+	checkSameDimensions(dataSample, _inputDimCount);
+
+	update(dataSample.data());
+}
+
+void
+DimensionReducer::update(const InputVector::value_type* data)
+{
+	if (_sampleCount == 0)
+	{
+		_sums.assign(_inputDimCount, 0);
+		_productSums.assign(_inputDimCount * (_inputDimCount + 1) / 2, 0);
+	}
+
+	std::size_t productIndex {};
+	for (std::size_t i {}; i < _inputDimCount; ++i)
+	{
+		_sums[i] += data[i];
+		for (std::size_t j {i}; j < _inputDimCount; ++j)
+			_productSums[productIndex++] += static_cast<double>(data[i]) * data[j];
+	}
+
+	_sampleCount++;
+}
+
+void
+DimensionReducer::finalize()
+{
+	if (_sampleCount == 0)
+		throw Exception("Empty input vectors");
+
+	const std::size_t size {_inputDimCount};
+
+	std::vector<double> mean(size);
+	for (std::size_t i {}; i < size; ++i)
+		mean[i] = _sums[i] / _sampleCount;
+
+	// Covariance of the weighted samples: distances between reduced data approximate the weighted distances between data
+	std::vector<double> covariance(size * size);
+	std::size_t productIndex {};
+	for (std::size_t i {}; i < size; ++i)
+	{
+		for (std::size_t j {i}; j < size; ++j)
+		{
+			const double value {(_productSums[productIndex++] / _sampleCount - mean[i] * mean[j]) * std::sqrt(static_cast<double>(_weights[i]) * _weights[j])};
+			covariance[i * size + j] = value;
+			covariance[j * size + i] = value;
+		}
+	}
+
+	std::vector<double> eigenVectors;
+	computeEigenDecomposition(covariance, size, eigenVectors);
+
+	std::vector<std::size_t> order(size);
+	std::iota(std::begin(order), std::end(order), 0);
+	std::stable_sort(std::begin(order), std::end(order), [&](std::size_t a, std::size_t b) { return covariance[a * size + a] > covariance[b * size + b]; });
+
+	for (std::size_t i {}; i < size; ++i)
+		_mean[i] = static_cast<InputVector::value_type>(mean[i]);
+
+	for (std::size_t outputDimId {}; outputDimId < _outputDimCount; ++outputDimId)
+	{
+		const std::size_t column {order[outputDimId]};
+
+		// Eigenvectors are defined up to their sign: make the largest value positive, so that results are reproducible
+		double largestValue {};
+		for (std::size_t i {}; i < size; ++i)
+		{
+			if (std::abs(eigenVectors[i * size + column]) > std::abs(largestValue))
+				largestValue = eigenVectors[i * size + column];
+		}
+		const double sign {largestValue < 0 ? -1. : 1.};
+
+		// Apply the weights here, so that reducing data is a plain projection
+		for (std::size_t i {}; i < size; ++i)
+			_components[outputDimId][i] = static_cast<InputVector::value_type>(sign * eigenVectors[i * size + column] * std::sqrt(static_cast<double>(_weights[i])));
+	}
+
+	// Next update starts a new computation
+	_sampleCount = 0;
+	_sums.clear();
+	_productSums.clear();
+}
+
+InputVector
+DimensionReducer::reduceData(const InputVector& data) const
+{
+	checkSameDimensions(data, _inputDimCount);
+
+	return reduceData(data.data());
+}
+
+InputVector
+DimensionReducer::reduceData(const InputVector::value_type* data) const
+{
+	InputVector res {_outputDimCount};
+	InputVector::value_type* resValues {res.data()};
+	const InputVector::value_type* mean {_mean.data()};
+
+	for (std::size_t outputDimId {}; outputDimId < _outputDimCount; ++outputDimId)
+	{
+		const InputVector::value_type* component {_components[outputDimId].data()};
+
+		InputVector::value_type value {};
+		for (std::size_t i {}; i < _inputDimCount; ++i)
+			value += component[i] * (data[i] - mean[i]);
+
+		resValues[outputDimId] = value;
+	}
+
+	return res;
+}
+
+InputVector::value_type
+DimensionReducer::getMean(std::size_t inputDimId) const
+{
+	return _mean[inputDimId];
+}
+
+void
+DimensionReducer::setMean(std::size_t inputDimId, InputVector::value_type mean)
+{
+	_mean[inputDimId] = mean;
+}
+
+const InputVector&
+DimensionReducer::getComponent(std::size_t outputDimId) const
+{
+	return _components[outputDimId];
+}
+
+void
+DimensionReducer::setComponent(std::size_t outputDimId, const InputVector& component)
+{
+	checkSameDimensions(component, _inputDimCount);
+
+	_components[outputDimId] = component;
+}
+
+} // namespace SOM
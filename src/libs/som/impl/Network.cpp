@@ -20,13 +20,21 @@
 #include "som/Network.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <chrono>
 #include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
 #include <random>
 #include <sstream>
+#include <tuple>
+#include <unordered_map>
 
+#include "som/SampleMatrix.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Random.hpp"
+#include "WorkerPool.hpp"
 
 namespace SOM
 {
@@ -81,20 +89,15 @@ Network::Network(Coordinate width, Coordinate height, std::size_t inputDimCount)
 :
 _inputDimCount {inputDimCount},
 _weights {inputDimCount, static_cast<InputVector::value_type>(1)},
-_refVectors {width, height, _inputDimCount},
-_distanceFunc {euclidianSquareDistance},
+_width {width},
+_height {height},
+_refVectorValues(static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * inputDimCount),
 _learningFactorFunc {defaultLearningFactor},
 _neighbourhoodFunc {defaultNeighbourhoodFunc}
 {
 	// init each vector with a random normalized value
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
-	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
-		{
-			for (InputVector::value_type& val : _refVectors.get({x,y}))
-				val = Random::getRealRandom<InputVector::value_type>(0, 1);
-		}
-	}
+	for (InputVector::value_type& val : _refVectorValues)
+		val = Random::getRealRandom<InputVector::value_type>(0, 1);
 }
 
 void
@@ -110,27 +113,27 @@ Network::setRefVector(const Position& position, const InputVector& data)
 {
 	checkSameDimensions(data, _inputDimCount);
 
-	_refVectors[position] = data;
+	std::copy(data.cbegin(), data.cend(), getRefVectorValues(position));
 }
 
 InputVector::Distance
 Network::getRefVectorsDistance(const Position& position1, const Position& position2) const
 {
-	return _distanceFunc(_refVectors.get(position1), _refVectors.get(position2), _weights);
+	return InputVector::computeEuclidianSquareDistance(getRefVectorValues(position1), getRefVectorValues(position2), _weights.data(), _inputDimCount);
 }
 
 InputVector::Distance
 Network::computeRefVectorsDistanceMean() const
 {
 	std::vector<InputVector::Distance> values;
-	values.reserve(2 * _refVectors.getHeight()*_refVectors.getWidth() - _refVectors.getWidth() - _refVectors.getHeight());
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	values.reserve(2 * _height*_width - _width - _height);
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			if (x != _refVectors.getWidth() - 1)
+			if (x != _width - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x + 1, y}));
-			if (y != _refVectors.getHeight() - 1)
+			if (y != _height - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x, y + 1}));
 		}
 	}
@@ -138,18 +141,18 @@ Network::computeRefVectorsDistanceMean() const
 	return std::accumulate(values.begin(), values.end(), 0.) / values.size();
 }
 
-double
+InputVector::Distance
 Network::computeRefVectorsDistanceMedian() const
 {
 	std::vector<InputVector::Distance> values;
-	values.reserve(2*_refVectors.getHeight()*_refVectors.getWidth() - _refVectors.getWidth() - _refVectors.getHeight());
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	values.reserve(2*_height*_width - _width - _height);
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			if (x != _refVectors.getWidth() - 1)
+			if (x != _width - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x + 1, y}));
-			if (y != _refVectors.getHeight() - 1)
+			if (y != _height - 1)
 				values.emplace_back(getRefVectorsDistance( {x, y}, {x, y + 1}));
 		}
 	}
@@ -162,13 +165,18 @@ Network::computeRefVectorsDistanceMedian() const
 void
 Network::dump(std::ostream& os) const
 {
-	os << "Width: " << _refVectors.getWidth() << ", Height: " << _refVectors.getHeight() << std::endl;;
+	os << "Width: " << _width << ", Height: " << _height << std::endl;;
 
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	for (Coordinate y {}; y < _height; ++y)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate x {}; x < _width; ++x)
 		{
-			os << _refVectors.get({x, y}) << " ";
+			const InputVector::value_type* values {getRefVectorValues({x, y})};
+
+			os << "[";
+			for (std::size_t i {}; i < _inputDimCount; ++i)
+				os << values[i] << " ";
+			os << "] ";
 		}
 
 		os << std::endl;
@@ -176,13 +184,162 @@ Network::dump(std::ostream& os) const
 	os << std::endl;
 }
 
+Network::ClosestRefVector
+Network::getClosestRefVectorInRows(const InputVector::value_type* data, Coordinate beginY, Coordinate endY) const
+{
+	ClosestRefVector closestRefVector;
+
+	// Ref vectors are stored contiguously, in the same order as they are visited here
+	const InputVector::value_type* refVectorValues {_refVectorValues.data() + static_cast<std::size_t>(beginY) * _width * _inputDimCount};
+
+	for (Coordinate y {beginY}; y < endY; ++y)
+	{
+		for (Coordinate x {}; x < _width; ++x)
+		{
+			const InputVector::Distance distance {InputVector::computeEuclidianSquareDistance(refVectorValues, data, _weights.data(), _inputDimCount)};
+			if (distance < closestRefVector.distance)
+			{
+				closestRefVector.distance = distance;
+				closestRefVector.position = {x, y};
+			}
+
+			refVectorValues += _inputDimCount;
+		}
+	}
+
+	return closestRefVector;
+}
+
 Position
 Network::getClosestRefVectorPosition(const InputVector& data) const
 {
-	return _refVectors.getPositionMinElement([&](const auto& a, const auto& b)
+	checkSameDimensions(data, _inputDimCount);
+
+	return findClosestRefVectorPosition(data.data());
+}
+
+Position
+Network::findClosestRefVectorPosition(const InputVector::value_type* data) const
+{
+	std::vector<ClosestRefVector> closestRefVectors(getUsedWorkerCount(_refVectorValues.size()));
+
+	forEachRowRange([&](std::size_t workerIndex, Coordinate beginY, Coordinate endY)
+	{
+		closestRefVectors[workerIndex] = getClosestRefVectorInRows(data, beginY, endY);
+	});
+
+	// Row ranges are sorted by worker index: keep the first closest ref vector, as a single threaded search would do
+	const ClosestRefVector* closestRefVector {&closestRefVectors.front()};
+	for (const ClosestRefVector& workerClosestRefVector : closestRefVectors)
+	{
+		if (workerClosestRefVector.distance < closestRefVector->distance)
+			closestRefVector = &workerClosestRefVector;
+	}
+
+	return closestRefVector->position;
+}
+
+template <typename SampleValuesGetter>
+void
+Network::findClosestRefVectorIndexes(std::size_t sampleCount, SampleValuesGetter getSampleValues, std::vector<std::size_t>& closestRefVectorIndexes) const
+{
+	// Weighted |r - x|^2 = |r|^2 - 2 r.x + |x|^2, where |x|^2 is the same for all the ref vectors of a sample
+	// The ref vector norms are computed once, and samples are processed by blocks so that each ref vector is read once per block
+	// Terms are summed in double precision, as the expansion loses the precision of the differences
+	constexpr std::size_t blockSize {4};
+	const std::size_t refVectorCount {static_cast<std::size_t>(_width) * _height};
+	const InputVector::value_type* weights {_weights.data()};
+
+	std::vector<double> refVectorNorms(refVectorCount);
+	for (std::size_t refVectorIndex {}; refVectorIndex < refVectorCount; ++refVectorIndex)
+	{
+		const InputVector::value_type* refVectorValues {getRefVectorValues({static_cast<Coordinate>(refVectorIndex % _width), static_cast<Coordinate>(refVectorIndex / _width)})};
+
+		double norm {};
+		for (std::size_t j {}; j < _inputDimCount; ++j)
+			norm += static_cast<double>(refVectorValues[j]) * refVectorValues[j] * weights[j];
+
+		refVectorNorms[refVectorIndex] = norm;
+	}
+
+	closestRefVectorIndexes.resize(sampleCount);
+
+	// Samples are split among the workers, each search is single threaded
+	forEachRange(sampleCount, _workerPool && sampleCount >= _workerPool->getWorkerCount() ? _workerPool->getWorkerCount() : 1,
+		[&](std::size_t /* workerIndex */, std::size_t begin, std::size_t end)
+		{
+			// -2 * weight * x for each sample of the block
+			std::vector<double> blockValues(blockSize * _inputDimCount);
+
+			for (std::size_t blockBegin {begin}; blockBegin < end; blockBegin += blockSize)
 			{
-				return (_distanceFunc(a, data, _weights) < _distanceFunc(b, data, _weights));
-			});
+				// Incomplete blocks are padded with their last sample
+				const std::size_t blockSampleCount {std::min(blockSize, end - blockBegin)};
+				for (std::size_t k {}; k < blockSize; ++k)
+				{
+					const InputVector::value_type* sampleValues {getSampleValues(blockBegin + std::min(k, blockSampleCount - 1))};
+					for (std::size_t j {}; j < _inputDimCount; ++j)
+						blockValues[k * _inputDimCount + j] = -2 * static_cast<double>(weights[j]) * sampleValues[j];
+				}
+
+				const double* sample0 {blockValues.data()};
+				const double* sample1 {sample0 + _inputDimCount};
+				const double* sample2 {sample1 + _inputDimCount};
+				const double* sample3 {sample2 + _inputDimCount};
+
+				double closestDistances[blockSize];
+				std::fill(std::begin(closestDistances), std::end(closestDistances), std::numeric_limits<double>::max());
+				std::size_t closestIndexes[blockSize] {};
+
+				// Ref vectors are stored contiguously, in index order
+				const InputVector::value_type* refVectorValues {_refVectorValues.data()};
+				for (std::size_t refVectorIndex {}; refVectorIndex < refVectorCount; ++refVectorIndex)
+				{
+					double distances[blockSize];
+					std::fill(std::begin(distances), std::end(distances), refVectorNorms[refVectorIndex]);
+
+					for (std::size_t j {}; j < _inputDimCount; ++j)
+					{
+						const double value {refVectorValues[j]};
+						distances[0] += value * sample0[j];
+						distances[1] += value * sample1[j];
+						distances[2] += value * sample2[j];
+						distances[3] += value * sample3[j];
+					}
+
+					for (std::size_t k {}; k < blockSize; ++k)
+					{
+						if (distances[k] < closestDistances[k])
+						{
+							closestDistances[k] = distances[k];
+							closestIndexes[k] = refVectorIndex;
+						}
+					}
+
+					refVectorValues += _inputDimCount;
+				}
+
+				for (std::size_t k {}; k < blockSampleCount; ++k)
+					closestRefVectorIndexes[blockBegin + k] = closestIndexes[k];
+			}
+		});
+}
+
+std::vector<Position>
+Network::getClosestRefVectorPositions(const SampleMatrix& dataSamples) const
+{
+	if (dataSamples.getInputDimCount() != _inputDimCount)
+		throw Exception("Bad data dimension count");
+
+	std::vector<std::size_t> closestRefVectorIndexes;
+	findClosestRefVectorIndexes(dataSamples.getSampleCount(), [&](std::size_t index) { return dataSamples.getSampleValues(index); }, closestRefVectorIndexes);
+
+	std::vector<Position> res;
+	res.reserve(closestRefVectorIndexes.size());
+	for (const std::size_t refVectorIndex : closestRefVectorIndexes)
+		res.push_back({static_cast<Coordinate>(refVectorIndex % _width), static_cast<Coordinate>(refVectorIndex / _width)});
+
+	return res;
 }
 
 std::optional<Position>
@@ -190,7 +347,7 @@ Network::getClosestRefVectorPosition(const InputVector& data, InputVector::Dista
 {
 	std::optional<Position> position {getClosestRefVectorPosition(data)};
 
-	if (_distanceFunc(data, _refVectors.get(*position), _weights) > maxDistance)
+	if (InputVector::computeEuclidianSquareDistance(data.data(), getRefVectorValues(*position), _weights.data(), _inputDimCount) > maxDistance)
 		position.reset();
 
 	return position;
@@ -199,109 +356,224 @@ Network::getClosestRefVectorPosition(const InputVector& data, InputVector::Dista
 std::optional<Position>
 Network::getClosestRefVectorPosition(const std::unordered_set<Position>& refVectorsPosition, InputVector::Distance maxDistance) const
 {
-	std::unordered_set<Position> neighboursPosition;
-	for (const Position& refVectorPosition : refVectorsPosition)
+	std::optional<Position> res;
+
+	growRegion(refVectorsPosition, maxDistance, [&](const Position& position)
 	{
-		if (refVectorPosition.y > 0)
-			neighboursPosition.insert({ refVectorPosition.x, refVectorPosition.y - 1 });
-		if (refVectorPosition.y < _refVectors.getHeight() - 1)
-			neighboursPosition.insert({ refVectorPosition.x, refVectorPosition.y + 1 });
-		if (refVectorPosition.x > 0)
-			neighboursPosition.insert({ refVectorPosition.x - 1, refVectorPosition.y });
-		if (refVectorPosition.x < _refVectors.getWidth() - 1)
-			neighboursPosition.insert({ refVectorPosition.x + 1, refVectorPosition.y });
-	}
+		res = position;
+		return false;
+	});
+
+	return res;
+}
+
+void
+Network::growRegion(const std::unordered_set<Position>& refVectorsPosition, InputVector::Distance maxDistance, const RegionGrowVisitor& visitor) const
+{
+	if (refVectorsPosition.empty())
+		return;
+
+	const std::size_t refVectorCount {static_cast<std::size_t>(_width) * _height};
+	auto toIndex {[&](const Position& position) { return position.x + static_cast<std::size_t>(_width) * position.y; }};
+	auto toPosition {[&](std::size_t index) { return Position {static_cast<Coordinate>(index % _width), static_cast<Coordinate>(index / _width)}; }};
 
-	// remove position that are in the input position
-	for (const auto& refVectorPosition : refVectorsPosition)
-		neighboursPosition.erase(refVectorPosition);
+	std::vector<bool> inRegion(refVectorCount);
+	std::vector<std::size_t> region;
+	for (const Position& position : refVectorsPosition)
+	{
+		if (position.x >= _width || position.y >= _height)
+			throw Exception {"Bad position"};
 
-	if (neighboursPosition.empty())
-		return std::nullopt;
+		inRegion[toIndex(position)] = true;
+		region.push_back(toIndex(position));
+	}
 
-	// Now compute the distance for each neighbour
-	struct NeighbourInfo
+	// Frontier: positions next to the region, with their distance to the closest position of the region
+	// Distances can only decrease as the region grows, outdated queue entries are skipped when popped
+	std::unordered_map<std::size_t, InputVector::Distance> frontierDistances;
+	struct FrontierEntry
 	{
-		Position position;
-		double distance;
+		InputVector::Distance distance;
+		std::size_t index;
+
+		bool operator>(const FrontierEntry& other) const { return std::tie(distance, index) > std::tie(other.distance, other.index); }
 	};
+	std::priority_queue<FrontierEntry, std::vector<FrontierEntry>, std::greater<FrontierEntry>> frontierQueue;
 
-	std::vector<NeighbourInfo> neighboursInfo;
-	for (const Position& neighbourPosition : neighboursPosition)
+	auto addNeighboursToFrontier {[&](std::size_t regionIndex)
 	{
-		auto min = std::min_element(refVectorsPosition.begin(), refVectorsPosition.end(),
-				[this, neighbourPosition](const auto& a, const auto& b)
-				{
-					return (this->getRefVectorsDistance(a, neighbourPosition) < this->getRefVectorsDistance(b, neighbourPosition));
-				});
+		const Position position {toPosition(regionIndex)};
+
+		auto addToFrontier {[&](const Position& neighbourPosition)
+		{
+			const std::size_t neighbourIndex {toIndex(neighbourPosition)};
+			if (inRegion[neighbourIndex] || frontierDistances.find(neighbourIndex) != std::cend(frontierDistances))
+				return;
+
+			InputVector::Distance distance {std::numeric_limits<InputVector::Distance>::max()};
+			for (const std::size_t index : region)
+				distance = std::min(distance, getRefVectorsDistance(neighbourPosition, toPosition(index)));
+
+			frontierDistances.emplace(neighbourIndex, distance);
+			frontierQueue.push(FrontierEntry {distance, neighbourIndex});
+		}};
 
-		InputVector::Distance distance {getRefVectorsDistance(neighbourPosition, *min)};
-		if (distance > maxDistance)
+		if (position.y > 0)
+			addToFrontier({position.x, position.y - 1});
+		if (position.y < _height - 1)
+			addToFrontier({position.x, position.y + 1});
+		if (position.x > 0)
+			addToFrontier({position.x - 1, position.y});
+		if (position.x < _width - 1)
+			addToFrontier({position.x + 1, position.y});
+	}};
+
+	for (const std::size_t index : region)
+		addNeighboursToFrontier(index);
+
+	while (!frontierQueue.empty())
+	{
+		const FrontierEntry entry {frontierQueue.top()};
+		frontierQueue.pop();
+
+		const auto itFrontier {frontierDistances.find(entry.index)};
+		if (itFrontier == std::cend(frontierDistances) || itFrontier->second != entry.distance)
 			continue;
 
-		neighboursInfo.emplace_back(NeighbourInfo {neighbourPosition, distance});
-	}
+		// Closest position of the frontier is too far, the others are even further
+		if (entry.distance > maxDistance)
+			return;
 
-	if (neighboursInfo.empty())
-		return std::nullopt;
+		frontierDistances.erase(itFrontier);
+		inRegion[entry.index] = true;
+		region.push_back(entry.index);
 
-	auto min {std::min_element(std::cbegin(neighboursInfo), std::cend(neighboursInfo),
-		[&](const auto& a, const auto& b)
+		if (!visitor(toPosition(entry.index)))
+			return;
+
+		// Update the distances of the frontier now that the region includes the new position
+		const Position addedPosition {toPosition(entry.index)};
+		for (auto& [index, distance] : frontierDistances)
 		{
-			return a.distance < b.distance;
-		})};
+			const InputVector::Distance newDistance {getRefVectorsDistance(toPosition(index), addedPosition)};
+			if (newDistance < distance)
+			{
+				distance = newDistance;
+				frontierQueue.push(FrontierEntry {distance, index});
+			}
+		}
+
+		addNeighboursToFrontier(entry.index);
+	}
+}
 
+static
+std::size_t
+computeSquareDistance(const Position& c1, const Position& c2)
+{
+	const std::size_t dx {c1.x > c2.x ? c1.x - c2.x : c2.x - c1.x};
+	const std::size_t dy {c1.y > c2.y ? c1.y - c2.y : c2.y - c1.y};
 
-	return min->position;
+	return dx * dx + dy * dy;
 }
 
-static Norm
-computePositionNorm(const Position& c1, const Position& c2)
+std::vector<InputVector::value_type>
+Network::computeNeighbourhoodWeights(InputVector::value_type factor, const CurrentIteration& iteration) const
 {
-	return std::sqrt((c1.x - c2.x) * (c1.x - c2.x) + (c1.y - c2.y) * (c1.y - c2.y));
+	const std::size_t maxSquareDistance {computeSquareDistance({0, 0}, {_width - 1, _height - 1})};
+
+	std::vector<InputVector::value_type> weights(maxSquareDistance + 1);
+	std::size_t lastUsedSquareDistance {};
+	for (std::size_t squareDistance {}; squareDistance <= maxSquareDistance; ++squareDistance)
+	{
+		weights[squareDistance] = factor * _neighbourhoodFunc(std::sqrt(static_cast<Norm>(squareDistance)), iteration);
+
+		// Far away ref vectors would not move anyway, and tiny weights lead to slow denormal computations
+		if (weights[squareDistance] < std::numeric_limits<InputVector::value_type>::epsilon())
+			weights[squareDistance] = 0;
+		else
+			lastUsedSquareDistance = squareDistance;
+	}
+
+	weights.resize(lastUsedSquareDistance + 1);
+
+	return weights;
 }
 
 void
-Network::updateRefVectors(const Position& closestRefVectorPosition, const InputVector& input, LearningFactor learningFactor, const CurrentIteration& iteration)
+Network::updateRefVectors(const Position& closestRefVectorPosition, const InputVector::value_type* input, const std::vector<InputVector::value_type>& neighbourhoodWeights)
 {
-	for (Coordinate y {}; y < _refVectors.getHeight(); ++y)
+	// Only visit the ref vectors that may be close enough to move
+	const Coordinate radius {static_cast<Coordinate>(std::sqrt(static_cast<Norm>(neighbourhoodWeights.size() - 1)))};
+	const Coordinate beginX {closestRefVectorPosition.x > radius ? closestRefVectorPosition.x - radius : 0};
+	const Coordinate endX {std::min<Coordinate>(_width, closestRefVectorPosition.x + radius + 1)};
+	const Coordinate beginY {closestRefVectorPosition.y > radius ? closestRefVectorPosition.y - radius : 0};
+	const Coordinate endY {std::min<Coordinate>(_height, closestRefVectorPosition.y + radius + 1)};
+
+	const std::size_t rowCount {static_cast<std::size_t>(endY - beginY)};
+	const std::size_t valueCount {rowCount * (endX - beginX) * _inputDimCount};
+
+	forEachRange(rowCount, getUsedWorkerCount(valueCount), [&](std::size_t /* workerIndex */, std::size_t begin, std::size_t end)
 	{
-		for (Coordinate x {}; x < _refVectors.getWidth(); ++x)
+		for (Coordinate y {static_cast<Coordinate>(beginY + begin)}; y < beginY + end; ++y)
 		{
-			InputVector& refVector {_refVectors.get({x, y})};
-
-			const Norm norm {computePositionNorm({x, y}, closestRefVectorPosition)};
+			for (Coordinate x {beginX}; x < endX; ++x)
+			{
+				const std::size_t squareDistance {computeSquareDistance({x, y}, closestRefVectorPosition)};
+				if (squareDistance >= neighbourhoodWeights.size())
+					continue;
 
-			InputVector delta {input - refVector};
-			delta *= (learningFactor * _neighbourhoodFunc(norm, iteration));
+				const InputVector::value_type factor {neighbourhoodWeights[squareDistance]};
+				if (factor == 0)
+					continue;
 
-			refVector += delta;
+				InputVector::moveTowards(getRefVectorValues({x, y}), input, factor, _inputDimCount);
+			}
 		}
-	}
+	});
 }
 
 void
-Network::train(const std::vector<InputVector>& inputData, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback)
+Network::train(const std::vector<InputVector>& inputData, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration)
 {
-	bool stopRequested {false};
-	std::vector<const InputVector*> inputDataShuffled;
+	for (const InputVector& input : inputData)
+		checkSameDimensions(input, _inputDimCount);
+
+	trainSamples(inputData.size(), [&](std::size_t index) { return inputData[index].data(); }, nbIterations, progressCallback, requestStopCallback, firstIteration);
+}
+
+void
+Network::train(const SampleMatrix& inputData, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration)
+{
+	if (inputData.getInputDimCount() != _inputDimCount)
+		throw Exception("Bad data dimension count");
+
+	trainSamples(inputData.getSampleCount(), [&](std::size_t index) { return inputData.getSampleValues(index); }, nbIterations, progressCallback, requestStopCallback, firstIteration);
+}
+
+template <typename SampleValuesGetter>
+void
+Network::trainSamples(std::size_t sampleCount, SampleValuesGetter getSampleValues, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration)
+{
+	if (_refVectorValues.empty())
+		return;
 
-	inputDataShuffled.reserve(inputData.size());
-	for (const auto& input : inputData)
-		inputDataShuffled.push_back(&input);
+	bool stopRequested {false};
+	std::vector<std::size_t> inputIndexesShuffled(sampleCount);
+	std::iota(std::begin(inputIndexesShuffled), std::end(inputIndexesShuffled), 0);
 
-	for (std::size_t i {}; i < nbIterations; ++i)
+	for (std::size_t i {firstIteration}; i < nbIterations; ++i)
 	{
 		CurrentIteration curIter {i, nbIterations};
 
 		if (progressCallback)
 			progressCallback(curIter);
 
-		Random::shuffleContainer(inputDataShuffled);
+		Random::shuffleContainer(inputIndexesShuffled);
 
-		const LearningFactor learningFactor {_learningFactorFunc(curIter)};
+		const std::vector<InputVector::value_type> neighbourhoodWeights {computeNeighbourhoodWeights(_learningFactorFunc(curIter), curIter)};
 
-		for (const InputVector* input : inputDataShuffled)
+		for (const std::size_t inputIndex : inputIndexesShuffled)
 		{
 			if (requestStopCallback)
 				stopRequested = requestStopCallback();
@@ -309,7 +581,8 @@ Network::train(const std::vector<InputVector>& inputData, std::size_t nbIteratio
 			if (stopRequested)
 				return;
 
-			updateRefVectors(getClosestRefVectorPosition(*input), *input, learningFactor, curIter);
+			const InputVector::value_type* input {getSampleValues(inputIndex)};
+			updateRefVectors(findClosestRefVectorPosition(input), input, neighbourhoodWeights);
 		}
 
 		if (stopRequested)
@@ -317,10 +590,203 @@ Network::train(const std::vector<InputVector>& inputData, std::size_t nbIteratio
 	}
 }
 
-const InputVector&
+void
+Network::trainBatch(const std::vector<InputVector>& inputData, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration)
+{
+	for (const InputVector& input : inputData)
+		checkSameDimensions(input, _inputDimCount);
+
+	trainBatchSamples(inputData.size(), [&](std::size_t index) { return inputData[index].data(); }, nbIterations, progressCallback, requestStopCallback, firstIteration);
+}
+
+void
+Network::trainBatch(const SampleMatrix& inputData, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration)
+{
+	if (inputData.getInputDimCount() != _inputDimCount)
+		throw Exception("Bad data dimension count");
+
+	trainBatchSamples(inputData.getSampleCount(), [&](std::size_t index) { return inputData.getSampleValues(index); }, nbIterations, progressCallback, requestStopCallback, firstIteration);
+}
+
+template <typename SampleValuesGetter>
+void
+Network::trainBatchSamples(std::size_t sampleCount, SampleValuesGetter getSampleValues, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration)
+{
+	if (_refVectorValues.empty())
+		return;
+
+	const std::size_t refVectorCount {static_cast<std::size_t>(_width) * _height};
+
+	std::vector<std::size_t> closestRefVectorIndexes(sampleCount);
+	std::vector<InputVector::value_type> inputSums(refVectorCount * _inputDimCount);
+	std::vector<std::size_t> inputCounts(refVectorCount);
+	std::vector<std::size_t> matchingRefVectorIndexes;
+
+	for (std::size_t i {firstIteration}; i < nbIterations; ++i)
+	{
+		CurrentIteration curIter {i, nbIterations};
+
+		if (progressCallback)
+			progressCallback(curIter);
+
+		if (requestStopCallback && requestStopCallback())
+			return;
+
+		// Find the closest ref vector of each input, using the ref vectors of the previous iteration
+		findClosestRefVectorIndexes(sampleCount, getSampleValues, closestRefVectorIndexes);
+
+		if (requestStopCallback && requestStopCallback())
+			return;
+
+		// Sum up the inputs matching each ref vector
+		std::fill(std::begin(inputSums), std::end(inputSums), 0);
+		std::fill(std::begin(inputCounts), std::end(inputCounts), 0);
+		for (std::size_t inputIndex {}; inputIndex < sampleCount; ++inputIndex)
+		{
+			const std::size_t refVectorIndex {closestRefVectorIndexes[inputIndex]};
+			const InputVector::value_type* inputValues {getSampleValues(inputIndex)};
+			InputVector::value_type* sumValues {inputSums.data() + refVectorIndex * _inputDimCount};
+
+			for (std::size_t j {}; j < _inputDimCount; ++j)
+				sumValues[j] += inputValues[j];
+
+			inputCounts[refVectorIndex]++;
+		}
+
+		matchingRefVectorIndexes.clear();
+		for (std::size_t refVectorIndex {}; refVectorIndex < refVectorCount; ++refVectorIndex)
+		{
+			if (inputCounts[refVectorIndex] > 0)
+				matchingRefVectorIndexes.push_back(refVectorIndex);
+		}
+
+		const std::vector<InputVector::value_type> neighbourhoodWeights {computeNeighbourhoodWeights(1, curIter)};
+
+		// Each ref vector becomes the mean of all the inputs, weighted by the neighbourhood of their matching ref vector
+		forEachRowRange([&](std::size_t /* workerIndex */, Coordinate beginY, Coordinate endY)
+		{
+			std::vector<InputVector::value_type> weightedSum(_inputDimCount);
+
+			for (Coordinate y {beginY}; y < endY; ++y)
+			{
+				for (Coordinate x {}; x < _width; ++x)
+				{
+					std::fill(std::begin(weightedSum), std::end(weightedSum), 0);
+					InputVector::value_type totalWeight {};
+
+					for (const std::size_t refVectorIndex : matchingRefVectorIndexes)
+					{
+						const Position matchingPosition {static_cast<Coordinate>(refVectorIndex % _width), static_cast<Coordinate>(refVectorIndex / _width)};
+						const std::size_t squareDistance {computeSquareDistance({x, y}, matchingPosition)};
+						if (squareDistance >= neighbourhoodWeights.size())
+							continue;
+
+						const InputVector::value_type weight {neighbourhoodWeights[squareDistance]};
+						if (weight == 0)
+							continue;
+
+						const InputVector::value_type* sumValues {inputSums.data() + refVectorIndex * _inputDimCount};
+						for (std::size_t j {}; j < _inputDimCount; ++j)
+							weightedSum[j] += weight * sumValues[j];
+
+						totalWeight += weight * inputCounts[refVectorIndex];
+					}
+
+					if (totalWeight < std::numeric_limits<InputVector::value_type>::epsilon())
+						continue;
+
+					InputVector::value_type* refVectorValues {getRefVectorValues({x, y})};
+					for (std::size_t j {}; j < _inputDimCount; ++j)
+						refVectorValues[j] = weightedSum[j] / totalWeight;
+				}
+			}
+		});
+	}
+}
+
+InputVector
 Network::getRefVector(const Position& position) const
 {
-	return _refVectors[position];
+	InputVector res {_inputDimCount};
+
+	const InputVector::value_type* values {getRefVectorValues(position)};
+	std::copy(values, values + _inputDimCount, res.begin());
+
+	return res;
+}
+
+Network::DistanceFunc
+Network::getDistanceFunc() const
+{
+	return euclidianSquareDistance;
+}
+
+void
+Network::setThreadCount(std::size_t threadCount)
+{
+	if (threadCount == 0)
+		throw Exception {"Invalid thread count"};
+
+	_workerPool = threadCount > 1 ? std::make_shared<WorkerPool>(threadCount) : nullptr;
+}
+
+std::size_t
+Network::getUsedWorkerCount(std::size_t valueCount) const
+{
+	// Below this number of values, synchronizing the threads costs more than what they save
+	constexpr std::size_t minValueCountPerWorker {4096};
+
+	if (!_workerPool || valueCount < minValueCountPerWorker * _workerPool->getWorkerCount())
+		return 1;
+
+	return _workerPool->getWorkerCount();
+}
+
+void
+Network::forEachRange(std::size_t count, std::size_t workerCount, const RangeFunc& func) const
+{
+	if (workerCount == 1)
+	{
+		func(0, 0, count);
+		return;
+	}
+
+	const std::size_t countPerWorker {(count + workerCount - 1) / workerCount};
+
+	_workerPool->run([&](std::size_t workerIndex)
+	{
+		const std::size_t begin {std::min(count, workerIndex * countPerWorker)};
+		const std::size_t end {std::min(count, begin + countPerWorker)};
+
+		func(workerIndex, begin, end);
+	});
+}
+
+void
+Network::forEachRowRange(const RowRangeFunc& func) const
+{
+	forEachRange(_height, getUsedWorkerCount(_refVectorValues.size()), [&](std::size_t workerIndex, std::size_t begin, std::size_t end)
+	{
+		func(workerIndex, static_cast<Coordinate>(begin), static_cast<Coordinate>(end));
+	});
+}
+
+const InputVector::value_type*
+Network::getRefVectorValues(const Position& position) const
+{
+	assert(position.x < _width);
+	assert(position.y < _height);
+
+	return _refVectorValues.data() + (position.x + static_cast<std::size_t>(_width) * position.y) * _inputDimCount;
+}
+
+InputVector::value_type*
+Network::getRefVectorValues(const Position& position)
+{
+	assert(position.x < _width);
+	assert(position.y < _height);
+
+	return _refVectorValues.data() + (position.x + static_cast<std::size_t>(_width) * position.y) * _inputDimCount;
 }
 
 
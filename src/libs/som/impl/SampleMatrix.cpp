@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "som/SampleMatrix.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "som/Network.hpp"
+
+namespace SOM
+{
+
+namespace {
+
+constexpr std::size_t minMappedSampleCapacity {1024};
+
+} // namespace
+
+SampleMatrix::SampleMatrix(std::size_t inputDimCount)
+: _inputDimCount {inputDimCount}
+{
+}
+
+SampleMatrix::SampleMatrix(std::size_t inputDimCount, const std::filesystem::path& file)
+: _inputDimCount {inputDimCount}
+, _file {file}
+{
+	if (_inputDimCount == 0)
+		throw Exception {"Invalid input dimension count"};
+
+	_fd = ::open(_file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (_fd < 0)
+		throw Exception {"Cannot create sample file '" + _file.string() + "': " + ::strerror(errno)};
+}
+
+SampleMatrix::~SampleMatrix()
+{
+	if (_fd < 0)
+		return;
+
+	if (_mappedValues)
+		::munmap(_mappedValues, _mappedSampleCapacity * _inputDimCount * sizeof(InputVector::value_type));
+
+	::close(_fd);
+
+	std::error_code ec;
+	std::filesystem::remove(_file, ec);
+}
+
+void
+SampleMatrix::append(const InputVector& sample)
+{
+	checkSameDimensions(sample, _inputDimCount);
+
+	if (_fd < 0)
+	{
+		_values.insert(std::end(_values), std::cbegin(sample), std::cend(sample));
+	}
+	else
+	{
+		if (_sampleCount == _mappedSampleCapacity)
+			growMappedFile();
+
+		std::copy(std::cbegin(sample), std::cend(sample), _mappedValues + _sampleCount * _inputDimCount);
+	}
+
+	_sampleCount++;
+}
+
+const InputVector::value_type*
+SampleMatrix::getSampleValues(std::size_t index) const
+{
+	return (_fd < 0 ? _values.data() : _mappedValues) + index * _inputDimCount;
+}
+
+InputVector::value_type*
+SampleMatrix::getSampleValues(std::size_t index)
+{
+	return (_fd < 0 ? _values.data() : _mappedValues) + index * _inputDimCount;
+}
+
+InputVector
+SampleMatrix::getSample(std::size_t index) const
+{
+	InputVector sample {_inputDimCount};
+	std::copy(getSampleValues(index), getSampleValues(index) + _inputDimCount, std::begin(sample));
+
+	return sample;
+}
+
+void
+SampleMatrix::growMappedFile()
+{
+	const std::size_t sampleSize {_inputDimCount * sizeof(InputVector::value_type)};
+	const std::size_t newCapacity {std::max(minMappedSampleCapacity, _mappedSampleCapacity * 2)};
+
+	if (::ftruncate(_fd, static_cast<off_t>(newCapacity * sampleSize)) < 0)
+		throw Exception {"Cannot resize sample file '" + _file.string() + "': " + ::strerror(errno)};
+
+	// Written pages are kept in the file, no need to copy them
+	if (_mappedValues)
+	{
+		::munmap(_mappedValues, _mappedSampleCapacity * sampleSize);
+		_mappedValues = nullptr;
+		_mappedSampleCapacity = 0;
+	}
+
+	void* mappedValues {::mmap(nullptr, newCapacity * sampleSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0)};
+	if (mappedValues == MAP_FAILED)
+		throw Exception {"Cannot map sample file '" + _file.string() + "': " + ::strerror(errno)};
+
+	_mappedValues = static_cast<InputVector::value_type*>(mappedValues);
+	_mappedSampleCapacity = newCapacity;
+}
+
+} // namespace SOM
+
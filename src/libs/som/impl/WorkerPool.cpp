@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "WorkerPool.hpp"
+
+#include "som/InputVector.hpp"
+
+namespace SOM
+{
+
+WorkerPool::WorkerPool(std::size_t workerCount)
+{
+	if (workerCount == 0)
+		throw Exception {"Invalid worker count"};
+
+	for (std::size_t i {1}; i < workerCount; ++i)
+		_threads.emplace_back([this, i] { threadLoop(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+	}
+	_jobCondition.notify_all();
+
+	for (std::thread& thread : _threads)
+		thread.join();
+}
+
+void
+WorkerPool::run(const Job& job)
+{
+	std::scoped_lock runLock {_runMutex};
+
+	{
+		std::scoped_lock lock {_mutex};
+
+		_job = &job;
+		_jobGeneration++;
+		_pendingThreadCount = _threads.size();
+	}
+	_jobCondition.notify_all();
+
+	job(0);
+
+	std::unique_lock lock {_mutex};
+	_doneCondition.wait(lock, [&] { return _pendingThreadCount == 0; });
+	_job = nullptr;
+}
+
+void
+WorkerPool::threadLoop(std::size_t workerIndex)
+{
+	std::size_t lastJobGeneration {};
+
+	while (true)
+	{
+		const Job* job;
+		{
+			std::unique_lock lock {_mutex};
+
+			_jobCondition.wait(lock, [&] { return _quit || _jobGeneration != lastJobGeneration; });
+			if (_quit)
+				return;
+
+			lastJobGeneration = _jobGeneration;
+			job = _job;
+		}
+
+		(*job)(workerIndex);
+
+		bool allDone;
+		{
+			std::scoped_lock lock {_mutex};
+			allDone = (--_pendingThreadCount == 0);
+		}
+
+		if (allDone)
+			_doneCondition.notify_one();
+	}
+}
+
+} // namespace SOM
+
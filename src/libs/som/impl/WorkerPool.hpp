@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SOM
+{
+
+// Runs the same job on a fixed set of workers and waits for all of them to complete
+// The calling thread is used as the first worker
+class WorkerPool
+{
+	public:
+		// job must not throw
+		using Job = std::function<void(std::size_t /* workerIndex */)>;
+
+		WorkerPool(std::size_t workerCount);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool(WorkerPool&&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+		WorkerPool& operator=(WorkerPool&&) = delete;
+
+		std::size_t getWorkerCount() const { return _threads.size() + 1; }
+
+		// Calls job once per worker, concurrent calls are serialized
+		void run(const Job& job);
+
+	private:
+		void threadLoop(std::size_t workerIndex);
+
+		std::mutex					_runMutex;
+		std::mutex					_mutex;
+		std::condition_variable		_jobCondition;	// signaled when a job is posted or on quit
+		std::condition_variable		_doneCondition;	// signaled when a thread is done with its job
+		const Job*					_job {};
+		std::size_t					_jobGeneration {};
+		std::size_t					_pendingThreadCount {};
+		bool						_quit {};
+		std::vector<std::thread>	_threads;
+};
+
+} // namespace SOM
+
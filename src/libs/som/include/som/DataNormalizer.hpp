@@ -46,7 +46,14 @@ class DataNormalizer
 
 		void computeNormalizationFactors(const std::vector<InputVector>& dataSamples);
 
+		// Incremental computation of the normalization factors, samples do not need to be kept
+		// finalize() throws if no sample has been provided
+		void update(const InputVector& dataSample);
+		void finalize();
+
 		void normalizeData(InputVector& data) const;
+		// data must point to getInputDimCount() values
+		void normalizeData(InputVector::value_type* data) const;
 
 		void dump(std::ostream& os) const;
 
@@ -56,6 +63,7 @@ class DataNormalizer
 		const std::size_t _inputDimCount;
 
 		std::vector<MinMax> _minmax; // Indexed min/max used to normalize data
+		std::size_t _sampleCount {};	// samples provided since the last finalize
 };
 
 } // namespace SOM
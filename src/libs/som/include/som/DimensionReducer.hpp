@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <vector>
+
+#include "Network.hpp"
+
+namespace SOM
+{
+
+// Principal component analysis: projects the data on the directions along which the samples vary the most
+// Training and classification costs are proportional to the dimension count, reducing it first speeds up both
+class DimensionReducer
+{
+	public:
+		// Throws if outputDimCount is 0 or greater than inputDimCount
+		DimensionReducer(std::size_t inputDimCount, std::size_t outputDimCount);
+
+		std::size_t getInputDimCount() const { return _inputDimCount; }
+		std::size_t getOutputDimCount() const { return _outputDimCount; }
+
+		// Weights of the input dimensions, as used by Network to compute distances (default is 1 for each)
+		// Must be set before providing the samples, reduced data is then to be compared using unit weights
+		void setDataWeights(const InputVector& weights);
+
+		// Incremental computation of the components, samples do not need to be kept
+		// finalize() throws if no sample has been provided
+		void update(const InputVector& dataSample);
+		// data must point to getInputDimCount() values
+		void update(const InputVector::value_type* data);
+		void finalize();
+
+		InputVector reduceData(const InputVector& data) const;
+		// data must point to getInputDimCount() values
+		InputVector reduceData(const InputVector::value_type* data) const;
+
+		InputVector::value_type getMean(std::size_t inputDimId) const;
+		void setMean(std::size_t inputDimId, InputVector::value_type mean);
+
+		// Components have getInputDimCount() dimensions, and are sorted by decreasing variance
+		const InputVector& getComponent(std::size_t outputDimId) const;
+		void setComponent(std::size_t outputDimId, const InputVector& component);
+
+	private:
+		std::size_t _inputDimCount;
+		std::size_t _outputDimCount;
+
+		InputVector _weights;
+		InputVector _mean;
+		std::vector<InputVector> _components;	// weights are applied to the components
+
+		// Samples provided since the last finalize
+		std::vector<double> _sums;
+		std::vector<double> _productSums;	// upper triangle of the inputDimCount * inputDimCount matrix, row by row
+		std::size_t _sampleCount {};
+};
+
+} // namespace SOM
@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <cmath>
+#include <ostream>
 
 #include "utils/Exception.hpp"
 
@@ -37,9 +38,13 @@ class Exception : public LmsException
 class InputVector
 {
 	public:
+#ifdef LMS_SOM_SINGLE_PRECISION
+		using value_type = float;
+#else
 		using value_type = double;
-		using Norm = double;
-		using Distance = double;
+#endif
+		using Norm = value_type;
+		using Distance = value_type;
 
 		InputVector(std::size_t nbDimensions, value_type defaultValue = value_type {}) : _values(nbDimensions, defaultValue) {}
 
@@ -53,6 +58,7 @@ class InputVector
 			return _values.size();
 		}
 
+		// Checked accesses, hot loops should work on data() instead
 		value_type& operator[](std::size_t index)
 		{
 			if (index >= getNbDimensions())
@@ -71,12 +77,12 @@ class InputVector
 
 		InputVector& operator+=(const InputVector& other)
 		{
-			if (!hasSameDimension(other.getNbDimensions()))
+			if (!hasSameDimension(other))
 				throw Exception {"Not the same dimension count"};
 
 			for (std::size_t i {}; i < _values.size(); ++i)
 			{
-				_values[i] += other[i];
+				_values[i] += other._values[i];
 			}
 
 			return *this;
@@ -84,12 +90,12 @@ class InputVector
 
 		InputVector& operator-=(const InputVector& other)
 		{
-			if (!hasSameDimension(other.getNbDimensions()))
+			if (!hasSameDimension(other))
 				throw Exception {"Not the same dimension count"};
 
 			for (std::size_t i {}; i < _values.size(); ++i)
 			{
-				_values[i] -= other[i];
+				_values[i] -= other._values[i];
 			}
 
 			return *this;
@@ -115,21 +121,63 @@ class InputVector
 
 		Distance computeEuclidianSquareDistance(const InputVector& other, const InputVector& weights) const
 		{
-			if (!hasSameDimension(other.getNbDimensions())
-				|| !hasSameDimension(weights.getNbDimensions()))
+			if (!hasSameDimension(other)
+				|| !hasSameDimension(weights))
 			{
 				throw Exception {"Not the same dimension count"};
 			}
 
-			Distance res {};
+			return computeEuclidianSquareDistance(_values.data(), other._values.data(), weights._values.data(), _values.size());
+		}
+
+		// a, b and w must point to size values
+		static Distance computeEuclidianSquareDistance(const value_type* a, const value_type* b, const value_type* w, std::size_t size)
+		{
+			// Use independent sums so that the compiler is allowed to vectorize the loop
+			Distance res0 {};
+			Distance res1 {};
+			Distance res2 {};
+			Distance res3 {};
 
-			for (std::size_t i {}; i < getNbDimensions(); ++i)
+			std::size_t i {};
+			for (; i + 4 <= size; i += 4)
 			{
-				const InputVector::value_type diff {_values[i] - other._values[i]};
-				res += diff * diff * weights._values[i];
+				const value_type diff0 {a[i] - b[i]};
+				const value_type diff1 {a[i + 1] - b[i + 1]};
+				const value_type diff2 {a[i + 2] - b[i + 2]};
+				const value_type diff3 {a[i + 3] - b[i + 3]};
+
+				res0 += diff0 * diff0 * w[i];
+				res1 += diff1 * diff1 * w[i + 1];
+				res2 += diff2 * diff2 * w[i + 2];
+				res3 += diff3 * diff3 * w[i + 3];
 			}
 
-			return res;
+			for (; i < size; ++i)
+			{
+				const value_type diff {a[i] - b[i]};
+				res0 += diff * diff * w[i];
+			}
+
+			return (res0 + res1) + (res2 + res3);
+		}
+
+		// ref += (input - ref) * factor, in place
+		// ref and input must point to size values
+		static void moveTowards(value_type* ref, const value_type* input, value_type factor, std::size_t size)
+		{
+			for (std::size_t i {}; i < size; ++i)
+				ref[i] += (input[i] - ref[i]) * factor;
+		}
+
+		value_type* data()
+		{
+			return _values.data();
+		}
+
+		const value_type* data() const
+		{
+			return _values.data();
 		}
 
 		std::vector<value_type>::iterator begin()
@@ -166,7 +214,7 @@ class InputVector
 
 		friend class InputVector operator-(const InputVector& a, const InputVector& b)
 		{
-			if (!a.hasSameDimension(b.getNbDimensions()))
+			if (!a.hasSameDimension(b))
 				throw Exception {"Not the same dimension count"};
 
 			InputVector res {a.getNbDimensions()};
@@ -24,6 +24,8 @@
 #include <functional>
 #include <vector>
 
+#include "InputVector.hpp"
+
 namespace SOM
 {
 
@@ -97,15 +99,25 @@ class Matrix
 		T& operator[](const Position& position) { return get(position); }
 		const T& operator[](const Position& position) const { return get(position); }
 
+		// func(element) returns the value to minimize, it is called once per element
 		template <typename Func>
 		Position getPositionMinElement(Func func) const
 		{
 			assert(!_values.empty());
 
-			auto it {std::min_element(_values.begin(), _values.end(), std::move(func))};
-			auto index {static_cast<Coordinate>(std::distance(_values.begin(), it))};
-
-			return {index % _height, index / _height};
+			std::size_t minIndex {};
+			auto minValue {func(_values.front())};
+			for (std::size_t index {1}; index < _values.size(); ++index)
+			{
+				auto value {func(_values[index])};
+				if (value < minValue)
+				{
+					minValue = std::move(value);
+					minIndex = index;
+				}
+			}
+
+			return {static_cast<Coordinate>(minIndex % _width), static_cast<Coordinate>(minIndex / _width)};
 		}
 
 	private:
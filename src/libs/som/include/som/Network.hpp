@@ -24,6 +24,8 @@
 #include <optional>
 #include <ostream>
 #include <functional>
+#include <limits>
+#include <memory>
 
 #include "InputVector.hpp"
 #include "Matrix.hpp"
@@ -38,6 +40,9 @@ void checkSameDimensions(const InputVector& a, std::size_t inputDimCount);
 std::ostream& operator<<(std::ostream& os, const InputVector& a);
 
 
+class SampleMatrix;
+class WorkerPool;
+
 class Network
 {
 	public:
@@ -45,14 +50,18 @@ class Network
 		// Init a network with random values
 		Network(Coordinate width, Coordinate height, std::size_t inputDimCount);
 
-		Coordinate getWidth() const { return _refVectors.getWidth(); }
-		Coordinate getHeight() const { return _refVectors.getHeight(); }
+		Coordinate getWidth() const { return _width; }
+		Coordinate getHeight() const { return _height; }
 		std::size_t getInputDimCount() const { return _inputDimCount; }
 		const InputVector& getDataWeights() const { return _weights; }
 
 		// Set weight for each dimension (default is 1 for each weight)
 		void setDataWeights(const InputVector& weights);
 
+		// Use several threads to search for the closest ref vectors and to update them during training
+		// Threads are only used on large enough networks (default is 1: everything is done by the calling thread)
+		void setThreadCount(std::size_t threadCount);
+
 		// use this to manually construct a network without training
 		void setRefVector(const Position& position, const InputVector& data);
 
@@ -64,14 +73,32 @@ class Network
 		};
 		using ProgressCallback = std::function<void(const CurrentIteration&)>;
 		using RequestStopCallback = std::function<bool()>;
-		void train(const std::vector<InputVector>& dataSamples, std::size_t nbIterations, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{});
+		// The progress callback is called before each iteration, when the previous ones are completed
+		// Set firstIteration to resume a training that has been stopped
+		void train(const std::vector<InputVector>& dataSamples, std::size_t nbIterations, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{}, std::size_t firstIteration = 0);
+		void train(const SampleMatrix& dataSamples, std::size_t nbIterations, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{}, std::size_t firstIteration = 0);
 
-		const InputVector& getRefVector(const Position& position) const;
+		// Batch training: the ref vectors are updated once per iteration, using all the samples
+		// Results do not depend on the sample order (apart from rounding) nor on the thread count
+		void trainBatch(const std::vector<InputVector>& dataSamples, std::size_t nbIterations, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{}, std::size_t firstIteration = 0);
+		void trainBatch(const SampleMatrix& dataSamples, std::size_t nbIterations, ProgressCallback = ProgressCallback{}, RequestStopCallback = RequestStopCallback{}, std::size_t firstIteration = 0);
+
+		InputVector getRefVector(const Position& position) const;
 		Position getClosestRefVectorPosition(const InputVector& data) const;
 		std::optional<Position> getClosestRefVectorPosition(const InputVector& data, InputVector::Distance maxDistance) const;
 
+		// Closest ref vector of each sample, much faster than calling getClosestRefVectorPosition on each of them
+		// Distances are computed as |r|^2 - 2 r.x, results may differ from getClosestRefVectorPosition on near ties
+		std::vector<Position> getClosestRefVectorPositions(const SampleMatrix& dataSamples) const;
+
+		// Returns the 4-neighbour of the set that is the closest to any of the set positions, if not further than maxDistance
 		std::optional<Position> getClosestRefVectorPosition(const std::unordered_set<Position>& refVectorsPosition, InputVector::Distance maxDistance) const;
 
+		// Same as repeatedly calling getClosestRefVectorPosition(set, maxDistance) and adding the result to the set, but each distance is computed once
+		// visitor is called for each added position, in order, and returns false to stop
+		using RegionGrowVisitor = std::function<bool(const Position& /* addedPosition */)>;
+		void growRegion(const std::unordered_set<Position>& refVectorsPosition, InputVector::Distance maxDistance, const RegionGrowVisitor& visitor) const;
+
 		InputVector::Distance getRefVectorsDistance(const Position& position1, const Position& position2) const;
 
 		InputVector::Distance computeRefVectorsDistanceMean() const;
@@ -84,8 +111,7 @@ class Network
 		// refVector(i+1) = refVector(i) + LearningFactor(i) * NeighbourhoodFunc(i) * (MatchingRefVector - refVector)
 
 		using DistanceFunc = std::function<InputVector::Distance(const InputVector& /* a */, const InputVector& /* b */, const InputVector& /* weights */)>;
-		void setDistanceFunc(DistanceFunc distanceFunc);
-		DistanceFunc getDistanceFunc() { return _distanceFunc; }
+		DistanceFunc getDistanceFunc() const;
 
 		using LearningFactorFunc = std::function<LearningFactor(const CurrentIteration&)>;
 		void setLearningFactorFunc(LearningFactorFunc learningFactorFunc);
@@ -95,15 +121,49 @@ class Network
 
 	private:
 
-		void updateRefVectors(const Position& closestRefVectorPosition, const InputVector& input, LearningFactor learningFactor, const CurrentIteration& iteration);
+		struct ClosestRefVector
+		{
+			Position position {};
+			InputVector::Distance distance {std::numeric_limits<InputVector::Distance>::max()};
+		};
+		// data must point to _inputDimCount values
+		ClosestRefVector getClosestRefVectorInRows(const InputVector::value_type* data, Coordinate beginY, Coordinate endY) const;
+		Position findClosestRefVectorPosition(const InputVector::value_type* data) const;
+		// Sets closestRefVectorIndexes[i] to the index of the closest ref vector of sample i
+		template <typename SampleValuesGetter>
+		void findClosestRefVectorIndexes(std::size_t sampleCount, SampleValuesGetter getSampleValues, std::vector<std::size_t>& closestRefVectorIndexes) const;
+
+		// getSampleValues(index) must return a pointer to the _inputDimCount values of the sample
+		template <typename SampleValuesGetter>
+		void trainSamples(std::size_t sampleCount, SampleValuesGetter getSampleValues, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration);
+		template <typename SampleValuesGetter>
+		void trainBatchSamples(std::size_t sampleCount, SampleValuesGetter getSampleValues, std::size_t nbIterations, ProgressCallback progressCallback, RequestStopCallback requestStopCallback, std::size_t firstIteration);
+
+		// Calls func on contiguous ranges [begin, end) of [0, count), sorted by worker index
+		using RangeFunc = std::function<void(std::size_t /* workerIndex */, std::size_t /* begin */, std::size_t /* end */)>;
+		void forEachRange(std::size_t count, std::size_t workerCount, const RangeFunc& func) const;
+
+		// Calls func on contiguous ranges of rows [beginY, endY), sorted by worker index
+		using RowRangeFunc = std::function<void(std::size_t /* workerIndex */, Coordinate /* beginY */, Coordinate /* endY */)>;
+		void forEachRowRange(const RowRangeFunc& func) const;
+		std::size_t getUsedWorkerCount(std::size_t valueCount) const;
+
+		const InputVector::value_type* getRefVectorValues(const Position& position) const;
+		InputVector::value_type* getRefVectorValues(const Position& position);
+		// Indexed by the square distance to the closest ref vector, beyond the last entry weights are 0
+		std::vector<InputVector::value_type> computeNeighbourhoodWeights(InputVector::value_type factor, const CurrentIteration& iteration) const;
+		void updateRefVectors(const Position& closestRefVectorPosition, const InputVector::value_type* input, const std::vector<InputVector::value_type>& neighbourhoodWeights);
 
 		std::size_t _inputDimCount {};
 		InputVector _weights;	// weight for each dimension
-		Matrix<InputVector> _refVectors;
+		Coordinate _width {};
+		Coordinate _height {};
+		std::vector<InputVector::value_type> _refVectorValues;	// width * height * inputDimCount values, ref vectors are stored one after another, row by row
 
-		DistanceFunc _distanceFunc;
 		LearningFactorFunc _learningFactorFunc;
 		NeighbourhoodFunc _neighbourhoodFunc;
+
+		std::shared_ptr<WorkerPool> _workerPool;	// shared by copies, calls are serialized
 };
 
 } // namespace SOM
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "InputVector.hpp"
+
+namespace SOM
+{
+
+// Samples stored one after another, either in memory or in a memory mapped file
+// When using a file, the system can drop the pages under memory pressure instead of keeping all the samples resident
+class SampleMatrix
+{
+	public:
+		// In memory storage
+		SampleMatrix(std::size_t inputDimCount);
+
+		// Storage in a memory mapped file, created or truncated. The file is removed on destruction
+		// Throws Exception if the file cannot be created
+		SampleMatrix(std::size_t inputDimCount, const std::filesystem::path& file);
+		~SampleMatrix();
+
+		SampleMatrix(const SampleMatrix&) = delete;
+		SampleMatrix(SampleMatrix&&) = delete;
+		SampleMatrix& operator=(const SampleMatrix&) = delete;
+		SampleMatrix& operator=(SampleMatrix&&) = delete;
+
+		std::size_t getInputDimCount() const { return _inputDimCount; }
+		std::size_t getSampleCount() const { return _sampleCount; }
+		bool isEmpty() const { return _sampleCount == 0; }
+
+		// Invalidates the pointers returned by getSampleValues
+		void append(const InputVector& sample);
+
+		// Points to getInputDimCount() values
+		const InputVector::value_type* getSampleValues(std::size_t index) const;
+		InputVector::value_type* getSampleValues(std::size_t index);
+
+		InputVector getSample(std::size_t index) const;
+
+	private:
+		void growMappedFile();
+
+		const std::size_t _inputDimCount;
+		std::size_t _sampleCount {};
+
+		// In memory storage
+		std::vector<InputVector::value_type> _values;
+
+		// File storage
+		std::filesystem::path _file;
+		int _fd {-1};
+		InputVector::value_type* _mappedValues {};
+		std::size_t _mappedSampleCapacity {};
+};
+
+} // namespace SOM
+
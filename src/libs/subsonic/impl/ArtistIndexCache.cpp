@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ArtistIndexCache.hpp"
+
+#include <optional>
+
+#include "database/Artist.hpp"
+#include "database/Session.hpp"
+
+namespace API::Subsonic
+{
+	using namespace Database;
+
+	static
+	std::optional<TrackArtistLinkType>
+	getLinkType(User::SubsonicArtistListMode mode)
+	{
+		switch (mode)
+		{
+			case User::SubsonicArtistListMode::AllArtists:
+				break;
+			case User::SubsonicArtistListMode::ReleaseArtists:
+				return TrackArtistLinkType::ReleaseArtist;
+			case User::SubsonicArtistListMode::TrackArtists:
+				return TrackArtistLinkType::Artist;
+		}
+
+		return std::nullopt;
+	}
+
+	std::shared_ptr<const ArtistIndexCache::Snapshot>
+	ArtistIndexCache::get(Session& session, User::SubsonicArtistListMode mode)
+	{
+		std::size_t generation;
+		{
+			std::scoped_lock lock {_mutex};
+
+			auto it {_snapshots.find(mode)};
+			if (it != std::cend(_snapshots))
+				return it->second;
+
+			generation = _generation;
+		}
+
+		// Build outside of the lock, several requests may end up doing the same work the first time
+		auto snapshot {std::make_shared<Snapshot>()};
+
+		bool more {};
+		const std::vector<Database::Artist::pointer> artists {Database::Artist::getByFilter(session,
+				{},
+				{},
+				getLinkType(mode),
+				Database::Artist::SortMethod::BySortName,
+				std::nullopt, more)};
+
+		snapshot->artists.reserve(artists.size());
+		for (const Database::Artist::pointer& artist : artists)
+			snapshot->artists.push_back(Entry {artist.id(), artist->getName(), artist->getCachedReleaseCount()});
+
+		std::scoped_lock lock {_mutex};
+
+		snapshot->lastModified = _lastModified;
+
+		// Do not keep listings that may have been built using data from before the last scan
+		if (generation == _generation)
+			_snapshots.emplace(mode, snapshot);
+
+		return snapshot;
+	}
+
+	void
+	ArtistIndexCache::invalidate()
+	{
+		std::scoped_lock lock {_mutex};
+
+		_generation++;
+		_lastModified = std::chrono::system_clock::now();
+		_snapshots.clear();
+	}
+}
+
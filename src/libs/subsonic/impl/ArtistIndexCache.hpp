@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "database/Types.hpp"
+#include "database/User.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace API::Subsonic
+{
+	// Keeps the artist listings used by getArtists/getIndexes, for each artist list mode
+	// Listings are built on first use and dropped when invalidated (once a scan is complete)
+	class ArtistIndexCache
+	{
+		public:
+			struct Entry
+			{
+				Database::IdType	id;
+				std::string			name;
+				std::size_t			releaseCount;
+			};
+
+			struct Snapshot
+			{
+				std::chrono::system_clock::time_point	lastModified;
+				std::vector<Entry>						artists;	// sorted by sort name
+			};
+
+			// Must be called within a transaction
+			std::shared_ptr<const Snapshot> get(Database::Session& session, Database::User::SubsonicArtistListMode mode);
+			void invalidate();
+
+		private:
+			std::mutex _mutex;
+			std::size_t _generation {};
+			std::chrono::system_clock::time_point _lastModified {std::chrono::system_clock::now()};
+			std::map<Database::User::SubsonicArtistListMode, std::shared_ptr<const Snapshot>> _snapshots;
+	};
+}
+
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CursorCache.hpp"
+
+namespace API::Subsonic
+{
+	std::optional<Database::Cursor>
+	CursorCache::get(const std::string& listingKey, std::size_t offset) const
+	{
+		std::scoped_lock lock {_mutex};
+
+		auto it {_entries.find(listingKey)};
+		if (it == std::cend(_entries) || it->second.offset != offset)
+			return std::nullopt;
+
+		return it->second.cursor;
+	}
+
+	void
+	CursorCache::set(const std::string& listingKey, std::size_t offset, const Database::Cursor& cursor)
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (_entries.size() >= maxEntryCount && _entries.find(listingKey) == std::cend(_entries))
+			_entries.clear();
+
+		_entries[listingKey] = Entry {offset, cursor};
+	}
+}
+
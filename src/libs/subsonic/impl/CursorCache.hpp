@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "database/Types.hpp"
+
+namespace API::Subsonic
+{
+	// Subsonic clients paginate listings using offsets
+	// Remembers where the last page given to a client ended, so that the next one
+	// can be fetched using keyset pagination instead of walking through all the previous entries
+	class CursorCache
+	{
+		public:
+			// listingKey must identify the listing (user, type, parameters)
+			std::optional<Database::Cursor> get(const std::string& listingKey, std::size_t offset) const;
+			void set(const std::string& listingKey, std::size_t offset, const Database::Cursor& cursor);
+
+		private:
+			static constexpr std::size_t maxEntryCount {1000};
+
+			struct Entry
+			{
+				std::size_t			offset;	// offset of the entry that follows the cursor
+				Database::Cursor	cursor;
+			};
+
+			mutable std::mutex _mutex;
+			std::unordered_map<std::string, Entry> _entries;
+	};
+}
+
@@ -0,0 +1,423 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LibraryCatalog.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <set>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <unordered_set>
+
+#include "database/Artist.hpp"
+#include "database/Cluster.hpp"
+#include "database/Release.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+#include "utils/Logger.hpp"
+#include "utils/String.hpp"
+
+namespace API::Subsonic
+{
+	using namespace Database;
+	using Row = LibraryCatalog::Row;
+
+	namespace
+	{
+		const std::string genreClusterName {"GENRE"};
+		constexpr std::size_t trackChunkSize {1000};
+
+		// Same order as SQLite's NOCASE collation: only ASCII letters are case folded
+		bool
+		isLessNoCase(std::string_view a, std::string_view b)
+		{
+			auto toLower {[](unsigned char c) { return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c; }};
+
+			return std::lexicographical_compare(std::cbegin(a), std::cend(a), std::cbegin(b), std::cend(b),
+					[&](char ca, char cb) { return toLower(static_cast<unsigned char>(ca)) < toLower(static_cast<unsigned char>(cb)); });
+		}
+
+		template <typename T, typename GetName>
+		std::string
+		joinArtistNames(const std::vector<T>& artists, GetName getName)
+		{
+			std::vector<std::string> names;
+			names.reserve(artists.size());
+			for (const T& artist : artists)
+				names.push_back(getName(artist));
+
+			return StringUtils::joinStrings(names, ", ");
+		}
+
+		struct TrackEntry
+		{
+			Row							releaseRow;
+			std::optional<std::size_t>	discNumber;
+			std::optional<std::size_t>	trackNumber;
+			IdType						id;
+			std::string					name;
+			std::optional<int>			year;
+			std::string					fileExtension;
+			std::uintmax_t				fileSize;
+			std::chrono::milliseconds	duration;
+			std::string					artistNames;
+			std::optional<IdType>		artistId;
+			Row							genre;
+		};
+
+		void
+		buildArtists(Session& session, LibraryCatalog::Artists& artists)
+		{
+			std::unordered_map<IdType, Row> rowById;
+
+			auto addListing {[&](User::SubsonicArtistListMode mode, std::optional<TrackArtistLinkType> linkType)
+			{
+				bool more {};
+				const std::vector<Artist::pointer> listedArtists {Artist::getByFilter(session, {}, {}, linkType, Artist::SortMethod::BySortName, std::nullopt, more)};
+
+				std::vector<Row>& rows {artists.bySortName[mode]};
+				rows.reserve(listedArtists.size());
+				for (const Artist::pointer& artist : listedArtists)
+				{
+					auto [it, inserted] {rowById.try_emplace(artist.id(), static_cast<Row>(artists.ids.size()))};
+					if (inserted)
+					{
+						artists.ids.push_back(artist.id());
+						artists.names.push_back(artist->getName());
+						artists.releaseCounts.push_back(artist->getCachedReleaseCount());
+					}
+					rows.push_back(it->second);
+				}
+			}};
+
+			addListing(User::SubsonicArtistListMode::AllArtists, std::nullopt);
+			addListing(User::SubsonicArtistListMode::ReleaseArtists, TrackArtistLinkType::ReleaseArtist);
+			addListing(User::SubsonicArtistListMode::TrackArtists, TrackArtistLinkType::Artist);
+		}
+	}
+
+	std::optional<Row>
+	LibraryCatalog::Snapshot::getReleaseRow(IdType releaseId) const
+	{
+		auto it {releases.rowById.find(releaseId)};
+		if (it == std::cend(releases.rowById))
+			return std::nullopt;
+
+		return it->second;
+	}
+
+	std::vector<Row>
+	LibraryCatalog::Snapshot::getReleasesByYear(int fromYear, int toYear, Range range) const
+	{
+		std::vector<Row> res;
+		std::unordered_set<Row> seenRows;
+		std::size_t skipCount {range.offset};
+
+		auto it {std::lower_bound(std::cbegin(releases.byYear), std::cend(releases.byYear), fromYear, [](const std::pair<int, Row>& entry, int year) { return entry.first < year; })};
+		for (; it != std::cend(releases.byYear) && it->first <= toYear && res.size() < range.limit; ++it)
+		{
+			// Releases are reported once, for their first year in range
+			if (!seenRows.insert(it->second).second)
+				continue;
+
+			if (skipCount > 0)
+			{
+				skipCount--;
+				continue;
+			}
+
+			res.push_back(it->second);
+		}
+
+		return res;
+	}
+
+	std::vector<Row>
+	LibraryCatalog::Snapshot::getReleasesByGenre(const std::string& genre, Range range) const
+	{
+		auto it {releases.byGenre.find(genre)};
+		if (it == std::cend(releases.byGenre))
+			return {};
+
+		return getRange(it->second, range);
+	}
+
+	std::vector<Row>
+	LibraryCatalog::Snapshot::getRange(const std::vector<Row>& rows, Range range)
+	{
+		if (range.offset >= rows.size())
+			return {};
+
+		const std::size_t count {std::min(range.limit, rows.size() - range.offset)};
+		return std::vector<Row>(std::cbegin(rows) + range.offset, std::cbegin(rows) + range.offset + count);
+	}
+
+	std::shared_ptr<const LibraryCatalog::Snapshot>
+	LibraryCatalog::get() const
+	{
+		std::scoped_lock lock {_mutex};
+		return _snapshot;
+	}
+
+	void
+	LibraryCatalog::clear()
+	{
+		std::scoped_lock lock {_mutex};
+		_snapshot.reset();
+	}
+
+	void
+	LibraryCatalog::build(Session& session)
+	{
+		std::scoped_lock buildLock {_buildMutex};
+
+		const auto start {std::chrono::steady_clock::now()};
+
+		auto snapshot {std::make_shared<Snapshot>()};
+		snapshot->buildTime = std::chrono::system_clock::now();
+
+		Releases& releases {snapshot->releases};
+		Tracks& tracks {snapshot->tracks};
+
+		{
+			auto transaction {session.createSharedTransaction()};
+
+			// Genres
+			std::optional<IdType> genreClusterTypeId;
+			std::unordered_map<IdType, Row> genreRowByClusterId;
+			if (const ClusterType::pointer clusterType {ClusterType::getByName(session, genreClusterName)})
+			{
+				genreClusterTypeId = clusterType.id();
+				for (const Cluster::pointer& cluster : clusterType->getClusters())
+				{
+					genreRowByClusterId.emplace(cluster.id(), static_cast<Row>(snapshot->genreNames.size()));
+					snapshot->genreNames.push_back(cluster->getName());
+				}
+			}
+			auto getGenreRow {[&](const Cluster::pointer& cluster)
+			{
+				auto it {genreRowByClusterId.find(cluster.id())};
+				return it != std::cend(genreRowByClusterId) ? it->second : noGenre;
+			}};
+
+			buildArtists(session, snapshot->artists);
+
+			// Releases
+			std::vector<IdType> releaseIds;
+			for (const Release::pointer& release : Release::getAll(session))
+			{
+				releases.rowById.emplace(release.id(), static_cast<Row>(releases.ids.size()));
+				releases.ids.push_back(release.id());
+				releases.names.push_back(release->getName());
+				releases.trackCounts.push_back(release->getCachedTracksCount());
+				releases.durations.push_back(release->getCachedDuration());
+				releaseIds.push_back(release.id());
+			}
+
+			const std::size_t releaseCount {releases.ids.size()};
+			releases.years.resize(releaseCount);
+			releases.lastWrittenTimes.resize(releaseCount);
+			releases.artistNames.resize(releaseCount);
+			releases.artistCounts.resize(releaseCount);
+			releases.artistIds.resize(releaseCount);
+			releases.genres.resize(releaseCount, noGenre);
+
+			for (const Release::ListEntry& entry : Release::getListEntries(session, releaseIds))
+			{
+				const Row row {releases.rowById[entry.id]};
+				releases.artistNames[row] = joinArtistNames(entry.artists, [](const ObjectRef& artist) { return artist.name; });
+				releases.artistCounts[row] = entry.artists.size();
+				if (entry.artists.size() == 1)
+					releases.artistIds[row] = entry.artists.front().id;
+			}
+
+			if (genreClusterTypeId)
+			{
+				for (const auto& [releaseId, cluster] : Release::getFirstClusterByRelease(session, releaseIds, *genreClusterTypeId))
+					releases.genres[releases.rowById[releaseId]] = getGenreRow(cluster);
+			}
+
+			// Tracks, loaded by chunks so that only a few of them are kept in the session at once
+			std::vector<TrackEntry> trackEntries;
+			std::vector<std::set<int>> trackYearsByRelease(releaseCount);	// unknown years are 0, as stored in the database
+			{
+				const std::vector<IdType> trackIds {Track::getAllIds(session)};
+				for (std::size_t offset {}; offset < trackIds.size(); offset += trackChunkSize)
+				{
+					const std::vector<IdType> chunkIds(std::cbegin(trackIds) + offset, std::cbegin(trackIds) + std::min(offset + trackChunkSize, trackIds.size()));
+
+					const auto artistsByTrack {Track::getArtistsByTrack(session, chunkIds, {TrackArtistLinkType::Artist})};
+					const auto genreByTrack {genreClusterTypeId ? Track::getFirstClusterByTrack(session, chunkIds, *genreClusterTypeId) : std::unordered_map<IdType, Cluster::pointer> {}};
+
+					for (const Track::pointer& track : Track::getByIds(session, chunkIds))
+					{
+						auto itRelease {releases.rowById.find(track->getRelease().id())};
+						if (itRelease == std::cend(releases.rowById))
+							continue;
+
+						const Row releaseRow {itRelease->second};
+
+						TrackEntry entry {releaseRow, track->getDiscNumber(), track->getTrackNumber(), track.id()};
+						entry.name = track->getName();
+						entry.year = track->getYear();
+						if (track->getPath().has_extension())
+							entry.fileExtension = track->getPath().extension().string();
+
+						entry.fileSize = track->getFileSize();
+						if (!entry.fileSize)
+						{
+							// Unknown until the next scan
+							std::error_code ec;
+							const auto fileSize {std::filesystem::file_size(track->getPath(), ec)};
+							if (!ec)
+								entry.fileSize = fileSize;
+						}
+
+						entry.duration = track->getDuration();
+
+						if (auto itArtists {artistsByTrack.find(track.id())}; itArtists != std::cend(artistsByTrack))
+						{
+							entry.artistNames = joinArtistNames(itArtists->second, [](const Artist::pointer& artist) { return artist->getName(); });
+							if (itArtists->second.size() == 1)
+								entry.artistId = itArtists->second.front().id();
+						}
+
+						entry.genre = noGenre;
+						if (auto itGenre {genreByTrack.find(track.id())}; itGenre != std::cend(genreByTrack))
+							entry.genre = getGenreRow(itGenre->second);
+
+						trackYearsByRelease[releaseRow].insert(entry.year.value_or(0));
+						releases.lastWrittenTimes[releaseRow] = std::max(releases.lastWrittenTimes[releaseRow], track->getLastWriteTime().toTime_t());
+
+						trackEntries.push_back(std::move(entry));
+					}
+				}
+			}
+
+			// Genres of all the tracks, not only the first one
+			if (genreClusterTypeId)
+			{
+				std::unordered_map<IdType, Row> releaseRowByTrackId;
+				for (const auto& [trackId, releaseId] : Track::getAllReleaseLinks(session))
+				{
+					if (auto it {releases.rowById.find(releaseId)}; it != std::cend(releases.rowById))
+						releaseRowByTrackId.emplace(trackId, it->second);
+				}
+
+				std::vector<std::vector<Row>> releasesByGenre(snapshot->genreNames.size());
+				for (const auto& [trackId, clusterId] : Track::getAllClusterLinks(session))
+				{
+					auto itGenre {genreRowByClusterId.find(clusterId)};
+					auto itRelease {releaseRowByTrackId.find(trackId)};
+					if (itGenre != std::cend(genreRowByClusterId) && itRelease != std::cend(releaseRowByTrackId))
+						releasesByGenre[itGenre->second].push_back(itRelease->second);
+				}
+
+				for (Row genreRow {}; genreRow < releasesByGenre.size(); ++genreRow)
+				{
+					std::vector<Row>& rows {releasesByGenre[genreRow]};
+					std::sort(std::begin(rows), std::end(rows));
+					rows.erase(std::unique(std::begin(rows), std::end(rows)), std::end(rows));
+					if (!rows.empty())
+						releases.byGenre.emplace(snapshot->genreNames[genreRow], std::move(rows));
+				}
+			}
+
+			// Same order as Release::getTracks
+			std::sort(std::begin(trackEntries), std::end(trackEntries), [](const TrackEntry& a, const TrackEntry& b)
+			{
+				return std::tie(a.releaseRow, a.discNumber, a.trackNumber, a.id) < std::tie(b.releaseRow, b.discNumber, b.trackNumber, b.id);
+			});
+
+			releases.firstTracks.reserve(releaseCount + 1);
+			for (TrackEntry& entry : trackEntries)
+			{
+				while (releases.firstTracks.size() <= entry.releaseRow)
+					releases.firstTracks.push_back(static_cast<Row>(tracks.ids.size()));
+
+				tracks.ids.push_back(entry.id);
+				tracks.names.push_back(std::move(entry.name));
+				tracks.trackNumbers.push_back(entry.trackNumber);
+				tracks.discNumbers.push_back(entry.discNumber);
+				tracks.years.push_back(entry.year);
+				tracks.fileExtensions.push_back(std::move(entry.fileExtension));
+				tracks.fileSizes.push_back(entry.fileSize);
+				tracks.durations.push_back(entry.duration);
+				tracks.artistNames.push_back(std::move(entry.artistNames));
+				tracks.artistIds.push_back(entry.artistId);
+				tracks.genres.push_back(entry.genre);
+			}
+			while (releases.firstTracks.size() <= releaseCount)
+				releases.firstTracks.push_back(static_cast<Row>(tracks.ids.size()));
+
+			// Same as Release::getReleaseYear: various years means no year
+			for (Row row {}; row < releaseCount; ++row)
+			{
+				const std::set<int>& years {trackYearsByRelease[row]};
+				if (years.size() == 1 && *years.begin() > 0)
+					releases.years[row] = *years.begin();
+
+				for (const int year : years)
+				{
+					if (year > 0)
+						releases.byYear.emplace_back(year, row);
+				}
+			}
+		}
+
+		// Orderings
+		auto isLessByName {[&](Row a, Row b)
+		{
+			if (isLessNoCase(releases.names[a], releases.names[b]))
+				return true;
+			if (isLessNoCase(releases.names[b], releases.names[a]))
+				return false;
+			return releases.ids[a] < releases.ids[b];
+		}};
+
+		releases.byName.resize(releases.ids.size());
+		std::iota(std::begin(releases.byName), std::end(releases.byName), 0);
+		std::sort(std::begin(releases.byName), std::end(releases.byName), isLessByName);
+
+		releases.byLastWritten.resize(releases.ids.size());
+		std::iota(std::begin(releases.byLastWritten), std::end(releases.byLastWritten), 0);
+		std::sort(std::begin(releases.byLastWritten), std::end(releases.byLastWritten), [&](Row a, Row b)
+		{
+			return std::tie(releases.lastWrittenTimes[b], releases.ids[a]) < std::tie(releases.lastWrittenTimes[a], releases.ids[b]);
+		});
+
+		std::sort(std::begin(releases.byYear), std::end(releases.byYear), [&](const std::pair<int, Row>& a, const std::pair<int, Row>& b)
+		{
+			if (a.first != b.first)
+				return a.first < b.first;
+			return isLessByName(a.second, b.second);
+		});
+
+		for (auto& [genre, rows] : releases.byGenre)
+			std::sort(std::begin(rows), std::end(rows), isLessByName);
+
+		LMS_LOG(API_SUBSONIC, INFO) << "Library catalog built in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms: "
+			<< snapshot->artists.ids.size() << " artists, " << releases.ids.size() << " releases, " << tracks.ids.size() << " tracks";
+
+		std::scoped_lock lock {_mutex};
+		_snapshot = std::move(snapshot);
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "database/Types.hpp"
+#include "database/User.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace API::Subsonic
+{
+	// In-memory copy of what the library-wide listings report: artist index, album lists and albums
+	// The library only changes during scans: a new snapshot is built from the database once a scan is complete,
+	// and requests served from it do not query the database for library data
+	// Values are stored by columns, objects being designated by their row in the columns
+	class LibraryCatalog
+	{
+		public:
+			using Row = std::uint32_t;
+			static constexpr Row noGenre {std::numeric_limits<Row>::max()};
+
+			struct Artists
+			{
+				std::vector<Database::IdType>	ids;
+				std::vector<std::string>		names;
+				std::vector<std::size_t>		releaseCounts;
+
+				std::map<Database::User::SubsonicArtistListMode, std::vector<Row>>	bySortName;	// listed artists for each mode
+			};
+
+			struct Releases
+			{
+				std::vector<Database::IdType>				ids;
+				std::vector<std::string>					names;
+				std::vector<std::optional<int>>				years;			// unset if unknown or various
+				std::vector<std::time_t>					lastWrittenTimes;	// most recent file write of the tracks
+				std::vector<std::size_t>					trackCounts;
+				std::vector<std::chrono::milliseconds>		durations;
+				std::vector<std::string>					artistNames;	// release artists, or artists if there is no release artist
+				std::vector<std::size_t>					artistCounts;
+				std::vector<std::optional<Database::IdType>>	artistIds;	// only set for a single artist
+				std::vector<Row>							genres;
+				std::vector<Row>							firstTracks;	// tracks of release n are rows [firstTracks[n], firstTracks[n + 1])
+
+				std::unordered_map<Database::IdType, Row>	rowById;
+
+				std::vector<Row>							byName;
+				std::vector<Row>							byLastWritten;	// most recent first
+				std::vector<std::pair<int, Row>>			byYear;			// one entry per track year of the release, ordered by year then name
+				std::unordered_map<std::string, std::vector<Row>>	byGenre;	// releases having at least one track of the genre, ordered by name
+			};
+
+			// Tracks that belong to a release, grouped by release
+			struct Tracks
+			{
+				std::vector<Database::IdType>				ids;
+				std::vector<std::string>					names;
+				std::vector<std::optional<std::size_t>>		trackNumbers;
+				std::vector<std::optional<std::size_t>>		discNumbers;
+				std::vector<std::optional<int>>				years;
+				std::vector<std::string>					fileExtensions;	// with the leading dot, empty if none
+				std::vector<std::uintmax_t>					fileSizes;		// 0 if unknown
+				std::vector<std::chrono::milliseconds>		durations;
+				std::vector<std::string>					artistNames;
+				std::vector<std::optional<Database::IdType>>	artistIds;	// only set for a single artist
+				std::vector<Row>							genres;
+			};
+
+			struct Snapshot
+			{
+				std::chrono::system_clock::time_point	buildTime;
+				std::vector<std::string>				genreNames;	// by genre row
+				Artists									artists;
+				Releases								releases;
+				Tracks									tracks;
+
+				std::optional<Row>	getReleaseRow(Database::IdType releaseId) const;
+				std::vector<Row>	getReleasesByYear(int fromYear, int toYear, Database::Range range) const;
+				std::vector<Row>	getReleasesByGenre(const std::string& genre, Database::Range range) const;
+				static std::vector<Row>	getRange(const std::vector<Row>& rows, Database::Range range);
+			};
+
+			// Unset until built
+			std::shared_ptr<const Snapshot> get() const;
+
+			// Replaces the current snapshot, must not be called within a transaction
+			void build(Database::Session& session);
+			void clear();
+
+		private:
+			std::mutex	_buildMutex;	// builds are serialized, so that the last one wins
+			mutable std::mutex	_mutex;
+			std::shared_ptr<const Snapshot> _snapshot;
+	};
+}
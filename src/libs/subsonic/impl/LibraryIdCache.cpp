@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LibraryIdCache.hpp"
+
+#include <algorithm>
+
+#include "database/Release.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+
+namespace API::Subsonic
+{
+	using namespace Database;
+
+	std::shared_ptr<const LibraryIdCache::Snapshot>
+	LibraryIdCache::get(Session& session)
+	{
+		std::size_t generation;
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (_snapshot)
+				return _snapshot;
+
+			generation = _generation;
+		}
+
+		// Build outside of the lock, several requests may end up doing the same work the first time
+		auto snapshot {std::make_shared<Snapshot>()};
+
+		snapshot->releaseIds = Release::getAllIds(session);
+		std::sort(std::begin(snapshot->releaseIds), std::end(snapshot->releaseIds));
+
+		snapshot->trackIds = Track::getAllIds(session);
+		std::sort(std::begin(snapshot->trackIds), std::end(snapshot->trackIds));
+
+		std::scoped_lock lock {_mutex};
+
+		// Do not keep lists that may have been built using data from before the last library change
+		if (generation == _generation)
+			_snapshot = snapshot;
+
+		return snapshot;
+	}
+
+	void
+	LibraryIdCache::invalidate()
+	{
+		std::scoped_lock lock {_mutex};
+
+		_generation++;
+		_snapshot.reset();
+	}
+}
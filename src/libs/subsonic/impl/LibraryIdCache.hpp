@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "database/Types.hpp"
+
+namespace Database
+{
+	class Session;
+}
+
+namespace API::Subsonic
+{
+	// Keeps the ids of all the releases and tracks, ordered by id
+	// Clients sync the whole library by paging through searches with an empty query: pages are then taken from these lists,
+	// rather than by scanning the tables up to the requested offset, and keep a stable order from one page to the next
+	// Lists are built on first use and dropped when invalidated (library changes)
+	class LibraryIdCache
+	{
+		public:
+			struct Snapshot
+			{
+				std::vector<Database::IdType>	releaseIds;
+				std::vector<Database::IdType>	trackIds;
+			};
+
+			// Must be called within a transaction
+			std::shared_ptr<const Snapshot> get(Database::Session& session);
+			void invalidate();
+
+		private:
+			std::mutex _mutex;
+			std::size_t _generation {};
+			std::shared_ptr<const Snapshot> _snapshot;
+	};
+}
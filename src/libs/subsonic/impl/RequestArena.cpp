@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RequestArena.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+namespace API::Subsonic
+{
+	namespace
+	{
+		// Enough for most responses (a page of albums or songs)
+		constexpr std::size_t threadBufferSize {256 * 1024};
+
+		thread_local RequestArena* currentArena {};
+
+		std::byte*
+		getThreadBuffer()
+		{
+			thread_local std::unique_ptr<std::array<std::byte, threadBufferSize>> buffer {std::make_unique<std::array<std::byte, threadBufferSize>>()};
+			return buffer->data();
+		}
+	}
+
+	// Nested arenas (not expected) do not share the thread buffer
+	RequestArena::RequestArena()
+	: _previousArena {currentArena}
+	{
+		if (_previousArena)
+			_resource.emplace(std::pmr::new_delete_resource());
+		else
+			_resource.emplace(getThreadBuffer(), threadBufferSize, std::pmr::new_delete_resource());
+
+		currentArena = this;
+	}
+
+	RequestArena::~RequestArena()
+	{
+		currentArena = _previousArena;
+	}
+
+	std::pmr::memory_resource*
+	RequestArena::getCurrentResource()
+	{
+		return currentArena ? &currentArena->getResource() : std::pmr::get_default_resource();
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory_resource>
+#include <optional>
+
+namespace API::Subsonic
+{
+	// Memory of the short lived objects built while handling a request (response nodes and their values), released at once when the request is done
+	// Allocations are served from a buffer kept by the thread for its next requests, then from larger and larger chunks of the upstream resource
+	// Objects allocated from it must not outlive it
+	class RequestArena
+	{
+		public:
+			RequestArena();
+			~RequestArena();
+
+			RequestArena(const RequestArena&) = delete;
+			RequestArena(RequestArena&&) = delete;
+			RequestArena& operator=(const RequestArena&) = delete;
+			RequestArena& operator=(RequestArena&&) = delete;
+
+			std::pmr::memory_resource& getResource() { return *_resource; }
+
+			// Arena of the request being handled by the calling thread, or the default resource if none
+			static std::pmr::memory_resource* getCurrentResource();
+
+		private:
+			RequestArena* const _previousArena;
+			std::optional<std::pmr::monotonic_buffer_resource> _resource;
+	};
+}
@@ -19,27 +19,49 @@
 
 #pragma once
 
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <unordered_set>
 
 #include <Wt/Http/Request.h>
 #include <Wt/Http/ResponseContinuation.h>
 
+#include "database/Types.hpp"
+#include "database/User.hpp"
 
 namespace Database
 {
+	class Db;
 	class Session;
 }
 
 namespace API::Subsonic
 {
 
+	// Authenticated user, resolved once per request
+	struct UserInfo
+	{
+		Database::IdType		id;
+		bool					isAdmin;
+		bool					transcodeEnable;
+		Database::AudioFormat	transcodeFormat;
+		Database::Bitrate		transcodeBitrate;
+		Database::User::SubsonicArtistListMode	artistListMode;
+	};
+
 	struct RequestContext
 	{
 		const Wt::Http::ParameterMap& parameters;
 		Database::Session& dbSession;
+		Database::Db& db;
+		std::pmr::memory_resource& memoryResource;	// released once the request is handled (see RequestArena)
 		std::string userName;
 		std::string clientName;
+		UserInfo user;
+
+		// Loaded on first use, for the response being built
+		std::optional<std::unordered_set<Database::IdType>> starredArtistIds;
 	};
 
 }
-
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "subsonic/RequestStats.hpp"
+
+#include <algorithm>
+
+namespace API::Subsonic
+{
+
+void
+RequestStats::addRequest(const std::string& endpoint, const Request& request)
+{
+	const auto itBucket {std::lower_bound(std::cbegin(latencyBuckets), std::cend(latencyBuckets), request.duration)};
+
+	std::scoped_lock lock {_mutex};
+
+	EndpointStats& stats {_stats[endpoint]};
+	stats.count++;
+	if (request.error)
+		stats.errorCount++;
+	stats.responseBytes += request.responseBytes;
+	stats.totalDuration += request.duration;
+	stats.totalAuthDuration += request.authDuration;
+	stats.totalHandlerDuration += request.handlerDuration;
+	stats.totalSerializationDuration += request.serializationDuration;
+	if (itBucket != std::cend(latencyBuckets))
+		stats.latencyBucketCounts[std::distance(std::cbegin(latencyBuckets), itBucket)]++;
+}
+
+RequestStats::Snapshot
+RequestStats::getSnapshot() const
+{
+	std::scoped_lock lock {_mutex};
+	return _stats;
+}
+
+} // namespace API::Subsonic
+
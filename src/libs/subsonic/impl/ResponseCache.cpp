@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResponseCache.hpp"
+
+#include "utils/HttpCache.hpp"
+
+namespace API::Subsonic
+{
+	std::shared_ptr<const ResponseCache::Entry>
+	ResponseCache::get(const std::string& responseKey, std::size_t libraryGeneration) const
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (libraryGeneration != _libraryGeneration)
+			return {};
+
+		auto it {_entries.find(responseKey)};
+		if (it == std::cend(_entries))
+			return {};
+
+		return it->second;
+	}
+
+	std::shared_ptr<const ResponseCache::Entry>
+	ResponseCache::set(const std::string& responseKey, std::size_t libraryGeneration, std::string body)
+	{
+		auto entry {std::make_shared<Entry>()};
+		entry->etag = HttpCache::computeETag(reinterpret_cast<const std::byte*>(body.data()), body.size());
+		entry->body = std::move(body);
+
+		std::scoped_lock lock {_mutex};
+
+		if (libraryGeneration != _libraryGeneration)
+		{
+			_entries.clear();
+			_libraryGeneration = libraryGeneration;
+		}
+
+		if (_entries.size() >= maxEntryCount && _entries.find(responseKey) == std::cend(_entries))
+			_entries.clear();
+
+		_entries[responseKey] = entry;
+
+		return entry;
+	}
+}
+
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace API::Subsonic
+{
+	// Keeps the serialized bodies of the responses that only change with the library contents
+	// All the entries are dropped when the library generation changes
+	class ResponseCache
+	{
+		public:
+			struct Entry
+			{
+				std::string	body;
+				std::string	etag;
+			};
+
+			// responseKey must identify the response (endpoint, format, API version, parameters)
+			std::shared_ptr<const Entry> get(const std::string& responseKey, std::size_t libraryGeneration) const;
+			std::shared_ptr<const Entry> set(const std::string& responseKey, std::size_t libraryGeneration, std::string body);
+
+		private:
+			static constexpr std::size_t maxEntryCount {256};
+
+			mutable std::mutex _mutex;
+			std::size_t _libraryGeneration {};
+			std::unordered_map<std::string, std::shared_ptr<const Entry>> _entries;
+	};
+}
+
@@ -19,14 +19,22 @@
 
 #include "Stream.hpp"
 
+#include <string_view>
+#include <unordered_map>
+
+#include <Wt/Utils.h>
+
 #include "av/AvTranscoder.hpp"
 #include "av/AvTranscodeResourceHandlerCreator.hpp"
 #include "av/AvTypes.hpp"
+#include "av/Hls.hpp"
+#include "av/TranscodeDecision.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/User.hpp"
 #include "utils/IResourceHandler.hpp"
 #include "utils/FileResourceHandlerCreator.hpp"
+#include "utils/Logger.hpp"
 #include "utils/Utils.hpp"
 #include "ParameterParsing.hpp"
 #include "SubsonicId.hpp"
@@ -51,10 +59,40 @@ userTranscodeFormatToAvFormat(AudioFormat format)
 	}
 }
 
+// Subsonic clients can only hint at what they play through the requested format
+static
+Av::ClientCapabilities
+getClientCapabilities(const std::optional<std::string>& format, const std::optional<std::size_t>& maxBitRate)
+{
+	Av::ClientCapabilities capabilities;
+
+	if (format)
+	{
+		static const std::unordered_map<std::string_view, std::string_view> formatToCodec
+		{
+			{"mp3", "mp3"},
+			{"aac", "aac"},
+			{"m4a", "aac"},
+			{"opus", "opus"},
+			{"ogg", "vorbis"},
+			{"vorbis", "vorbis"},
+		};
+
+		if (auto it {formatToCodec.find(*format)}; it != std::cend(formatToCodec))
+			capabilities.supportedCodecs = {std::string {it->second}};
+	}
+
+	capabilities.strictBitrate = maxBitRate && *maxBitRate != 0;
+
+	return capabilities;
+}
+
 struct StreamParameters
 {
 	std::filesystem::path trackPath;
+	std::chrono::milliseconds trackDuration;
 	std::optional<Av::TranscodeParameters> transcodeParameters;
+	Av::TranscodeClient transcodeClient;
 };
 
 static
@@ -70,26 +108,23 @@ getStreamParameters(RequestContext& context)
 
 	StreamParameters parameters;
 
-	auto transaction {context.dbSession.createSharedTransaction()};
-
 	{
+		auto transaction {context.dbSession.createSharedTransaction()};
+
 		auto track {Track::getById(context.dbSession, id.value)};
 		if (!track)
 			throw RequestedDataNotFoundError {};
 
 		parameters.trackPath = track->getPath();
+		parameters.trackDuration = track->getDuration();
 	}
 
 	{
-		const User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-		if (!user)
-			throw UserNotAuthorizedError {};
-
-		// format = "raw" => no transcode. Other format values will be ignored
-		const bool transcode {(!format || (*format != "raw")) && user->getSubsonicTranscodeEnable()};
+		// format = "raw" => no transcode. Other format values are hints of what the client can play
+		const bool transcode {(!format || (*format != "raw")) && context.user.transcodeEnable};
 		if (transcode)
 		{
-			std::size_t bitRate {user->getSubsonicTranscodeBitrate() / 1000};
+			std::size_t bitRate {context.user.transcodeBitrate / 1000};
 
 			// "If set to zero, no limit is imposed"
 			if (maxBitRate && *maxBitRate != 0)
@@ -98,16 +133,57 @@ getStreamParameters(RequestContext& context)
 			Av::TranscodeParameters transcodeParameters;
 
 			transcodeParameters.bitrate = bitRate * 1000;
-			transcodeParameters.format = userTranscodeFormatToAvFormat(user->getSubsonicTranscodeFormat());
+			transcodeParameters.format = userTranscodeFormatToAvFormat(context.user.transcodeFormat);
 			transcodeParameters.stripMetadata = false; // We want clients to use metadata (offline use, replay gain, etc.)
 
+			const Av::TranscodeDecision decision {Av::decideTranscodeMode(parameters.trackPath, transcodeParameters, getClientCapabilities(format, maxBitRate))};
+			LMS_LOG(API_SUBSONIC, DEBUG) << "Streaming track " << id.value << ": " << Av::transcodeModeToString(decision.mode) << ", " << decision.reason;
+			if (decision.mode == Av::TranscodeMode::Passthrough)
+				return parameters;
+
 			parameters.transcodeParameters = std::move(transcodeParameters);
+
+			// Clients usually ask for an estimated length when downloading tracks for offline use
+			parameters.transcodeClient.user = context.userName;
+			if (getParameterAs<bool>(context.parameters, "estimateContentLength").value_or(false))
+				parameters.transcodeClient.priority = Av::TranscodePriority::Background;
 		}
 	}
 
 	return parameters;
 }
 
+static
+void
+serveResource(const std::shared_ptr<IResourceHandler>& resourceHandler, const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+	resourceHandler->processRequest(request, response);
+
+	// Client gone: releasing the handler now stops its transcode, if no one else is reading it
+	if (!response.out())
+	{
+		LMS_LOG(API_SUBSONIC, DEBUG) << "Write failed, client gone";
+		return;
+	}
+
+	if (!resourceHandler->isFinished())
+	{
+		Wt::Http::ResponseContinuation *continuation = response.createContinuation();
+		continuation->setData(resourceHandler);
+
+		if (resourceHandler->isWaitingForData())
+		{
+			// Do not hold this server thread while the data is being produced
+			continuation->waitForMoreData();
+			resourceHandler->notifyWhenDataAvailable([weakContinuation = std::weak_ptr {continuation->shared_from_this()}]
+			{
+				if (auto lockedContinuation {weakContinuation.lock()})
+					lockedContinuation->haveMoreData();
+			});
+		}
+	}
+}
+
 void
 handleDownload(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response)
 {
@@ -137,12 +213,7 @@ handleDownload(RequestContext& context, const Wt::Http::Request& request, Wt::Ht
 		resourceHandler = Wt::cpp17::any_cast<std::shared_ptr<IResourceHandler>>(continuation->data());
 	}
 
-	resourceHandler->processRequest(request, response);
-	if (!resourceHandler->isFinished())
-	{
-		Wt::Http::ResponseContinuation *continuation = response.createContinuation();
-		continuation->setData(resourceHandler);
-	}
+	serveResource(resourceHandler, request, response);
 }
 
 void
@@ -155,7 +226,7 @@ handleStream(RequestContext& context, const Wt::Http::Request& request, Wt::Http
 	{
 		StreamParameters streamParameters {getStreamParameters(context)};
 		if (streamParameters.transcodeParameters)
-			resourceHandler = Av::createTranscodeResourceHandler(streamParameters.trackPath, *streamParameters.transcodeParameters);
+			resourceHandler = Av::createTranscodeResourceHandler(streamParameters.trackPath, *streamParameters.transcodeParameters, streamParameters.transcodeClient, streamParameters.trackDuration);
 		else
 			resourceHandler = createFileResourceHandler(streamParameters.trackPath);
 	}
@@ -164,12 +235,93 @@ handleStream(RequestContext& context, const Wt::Http::Request& request, Wt::Http
 		resourceHandler = Wt::cpp17::any_cast<std::shared_ptr<IResourceHandler>>(continuation->data());
 	}
 
-	resourceHandler->processRequest(request, response);
-	if (!resourceHandler->isFinished())
+	serveResource(resourceHandler, request, response);
+}
+
+void
+handleHls(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+	std::shared_ptr<IResourceHandler> resourceHandler;
+
+	Wt::Http::ResponseContinuation *continuation = request.continuation();
+	if (!continuation)
 	{
-		Wt::Http::ResponseContinuation *continuation = response.createContinuation();
-		continuation->setData(resourceHandler);
+		// Mandatory params
+		Id id {getMandatoryParameterAs<Id>(context.parameters, "id")};
+
+		// Optional params
+		std::vector<std::size_t> bitRates {getMultiParametersAs<std::size_t>(context.parameters, "bitRate")};
+		std::optional<std::size_t> segment {getParameterAs<std::size_t>(context.parameters, "segment")};
+
+		std::filesystem::path trackPath;
+		std::chrono::milliseconds trackDuration;
+		{
+			auto transaction {context.dbSession.createSharedTransaction()};
+
+			auto track {Track::getById(context.dbSession, id.value)};
+			if (!track)
+				throw RequestedDataNotFoundError {};
+
+			trackPath = track->getPath();
+			trackDuration = track->getDuration();
+
+			const std::size_t maxBitRate {context.user.transcodeBitrate / 1000};
+			if (bitRates.empty())
+				bitRates.push_back(maxBitRate);
+
+			for (std::size_t& bitRate : bitRates)
+				bitRate = clamp(bitRate, std::size_t {48}, maxBitRate);
+		}
+
+		if (!segment)
+		{
+			// Segments and variants are served by this same entry point, authenticated using the same parameters
+			auto createUrl {[&](std::size_t bitRate, std::optional<std::size_t> segmentIndex)
+			{
+				std::string url {"hls.m3u8?"};
+				for (const auto& [name, values] : context.parameters)
+				{
+					if (name == "bitRate" || name == "segment")
+						continue;
+
+					for (const std::string& value : values)
+						url += Wt::Utils::urlEncode(name) + "=" + Wt::Utils::urlEncode(value) + "&";
+				}
+				url += "bitRate=" + std::to_string(bitRate);
+				if (segmentIndex)
+					url += "&segment=" + std::to_string(*segmentIndex);
+
+				return url;
+			}};
+
+			response.setMimeType(Av::Hls::playlistMimeType);
+
+			if (bitRates.size() > 1)
+			{
+				std::vector<std::size_t> bitrates;
+				for (std::size_t bitRate : bitRates)
+					bitrates.push_back(bitRate * 1000);
+
+				response.out() << Av::Hls::createMasterPlaylist(bitrates, [&](std::size_t bitrate) { return createUrl(bitrate / 1000, std::nullopt); });
+			}
+			else
+				response.out() << Av::Hls::createMediaPlaylist(trackDuration, [&](std::size_t segmentIndex) { return createUrl(bitRates.front(), segmentIndex); });
+
+			return;
+		}
+
+		if (bitRates.size() != 1 || *segment >= Av::Hls::getSegmentCount(trackDuration))
+			throw RequestedDataNotFoundError {};
+
+		const Av::TranscodeClient client {context.userName, Av::TranscodePriority::Interactive};
+		resourceHandler = Av::createTranscodeResourceHandler(trackPath, Av::Hls::getSegmentParameters(bitRates.front() * 1000, *segment), client, trackDuration);
 	}
+	else
+	{
+		resourceHandler = Wt::cpp17::any_cast<std::shared_ptr<IResourceHandler>>(continuation->data());
+	}
+
+	serveResource(resourceHandler, request, response);
 }
 
 }
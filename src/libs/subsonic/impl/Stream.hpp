@@ -28,5 +28,7 @@ namespace API::Subsonic::Stream
 {
 	void handleDownload(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
 	void handleStream(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
+	// Serves the HLS playlists and their segments
+	void handleHls(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response);
 }
 
@@ -28,18 +28,18 @@ namespace API::Subsonic
 {
 
 std::optional<Id>
-IdFromString(const std::string& id)
+IdFromString(std::string_view id)
 {
 	if (id == "root")
 		return Id {Id::Type::Root};
 
-	std::vector<std::string> values {StringUtils::splitString(id, "-")};
+	const std::vector<std::string_view> values {StringUtils::splitStringViews(id, "-")};
 	if (values.size() != 2)
 		return std::nullopt;
 
 	Id res;
 
-	const std::string type {std::move(values[0])};
+	const std::string_view type {values[0]};
 	if (type == "ar")
 		res.type = Id::Type::Artist;
 	else if (type == "al")
@@ -18,10 +18,22 @@
  */
 #include "subsonic/SubsonicResource.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <ctime>
+#include <functional>
 #include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <Wt/WLocalDateTime.h>
 
@@ -36,14 +48,30 @@
 #include "database/TrackBookmark.hpp"
 #include "database/TrackList.hpp"
 #include "database/User.hpp"
+#include "database/UserStateJournal.hpp"
 #include "recommendation/IEngine.hpp"
+#include "scanner/IMediaScanner.hpp"
+#include "utils/HttpCache.hpp"
+#include "utils/HttpCompression.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include "utils/Random.hpp"
+#include "utils/Readiness.hpp"
+#include "utils/SamplingProfiler.hpp"
+#include "utils/Scheduler.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
+#include "utils/Tracing.hpp"
 #include "utils/Utils.hpp"
+#include "ArtistIndexCache.hpp"
+#include "CursorCache.hpp"
+#include "LibraryCatalog.hpp"
+#include "LibraryIdCache.hpp"
 #include "ParameterParsing.hpp"
+#include "RequestArena.hpp"
 #include "RequestContext.hpp"
+#include "ResponseCache.hpp"
 #include "Scan.hpp"
 #include "Stream.hpp"
 #include "SubsonicResponse.hpp"
@@ -68,10 +96,10 @@ namespace StringUtils
 {
 	template<>
 	std::optional<API::Subsonic::ClientVersion>
-	readAs(const std::string& str)
+	readAs(std::string_view str)
 	{
 		// Expects "X.Y.Z"
-		const auto numbers {StringUtils::splitString(str, ".")};
+		const auto numbers {StringUtils::splitStringViews(str, ".")};
 		if (numbers.size() < 2 || numbers.size() > 3)
 			return std::nullopt;
 
@@ -157,9 +185,148 @@ getClientInfo(const Wt::Http::ParameterMap& parameters)
 	return res;
 }
 
+static ArtistIndexCache artistIndexCache;
+static LibraryIdCache libraryIdCache;
+static LibraryCatalog libraryCatalog;
+
+namespace
+{
+	// Counts the bytes written to the underlying stream buffer
+	class CountingStreamBuf : public std::streambuf
+	{
+		public:
+			CountingStreamBuf(std::streambuf& dest) : _dest {dest} {}
+
+			std::size_t getCount() const { return _count; }
+
+		private:
+			int_type overflow(int_type c) override
+			{
+				if (traits_type::eq_int_type(c, traits_type::eof()))
+					return traits_type::not_eof(c);
+
+				if (traits_type::eq_int_type(_dest.sputc(traits_type::to_char_type(c)), traits_type::eof()))
+					return traits_type::eof();
+
+				_count++;
+				return c;
+			}
+
+			std::streamsize xsputn(const char* s, std::streamsize count) override
+			{
+				const std::streamsize written {_dest.sputn(s, count)};
+				_count += written;
+				return written;
+			}
+
+			int sync() override { return _dest.pubsync(); }
+
+			std::streambuf& _dest;
+			std::size_t _count {};
+	};
+
+	std::chrono::microseconds
+	elapsedSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	}
+
+	struct CompressionSettings
+	{
+		std::optional<HttpCompression::Encoding> encoding;	// not set if no compression
+		int level;
+		std::size_t threshold;
+	};
+
+	// Writes the response, accounting for the serialization time and the size on the wire
+	void
+	writeResponse(const std::function<void(std::ostream&)>& writeBody, ResponseFormat format, const CompressionSettings& compression, Wt::Http::Response& response, RequestStats::Request& requestStats)
+	{
+		const auto serializationStart {std::chrono::steady_clock::now()};
+		Tracing::Span span {"subsonic.serialization"};
+
+		response.setMimeType(ResponseFormatToMimeType(format));
+
+		CountingStreamBuf countingStreamBuf {*response.out().rdbuf()};
+		if (compression.encoding)
+		{
+			response.addHeader("Vary", "Accept-Encoding");
+
+			HttpCompression::CompressingStreamBuf compressingStreamBuf {countingStreamBuf, *compression.encoding, compression.level, compression.threshold, [&]
+			{
+				response.addHeader("Content-Encoding", HttpCompression::getEncodingName(*compression.encoding));
+			}};
+			{
+				std::ostream os {&compressingStreamBuf};
+				writeBody(os);
+			}
+			compressingStreamBuf.finish();
+		}
+		else
+		{
+			std::ostream os {&countingStreamBuf};
+			writeBody(os);
+		}
+
+		requestStats.serializationDuration = elapsedSince(serializationStart);
+		requestStats.responseBytes = countingStreamBuf.getCount();
+		span.setAttribute("bytes", std::to_string(requestStats.responseBytes));
+	}
+}
+
+// Requests are served from the database if the catalog cannot be built, rather than from an outdated one
+static
+void
+buildLibraryCatalog(Db& db)
+{
+	try
+	{
+		libraryCatalog.build(db.getTLSSession());
+	}
+	catch (std::exception& e)
+	{
+		LMS_LOG(API_SUBSONIC, ERROR) << "Cannot build library catalog: " << e.what();
+		libraryCatalog.clear();
+	}
+}
+
 SubsonicResource::SubsonicResource(Db& db)
 : _db {db}
+, _compressionLevel {static_cast<int>(std::min<unsigned long>(Service<IConfig>::get()->getULong("api-subsonic-compression-level", 6), 9))}
+, _compressionThreshold {Service<IConfig>::get()->getULong("api-subsonic-compression-threshold", 1024)}
 {
+	const bool useLibraryCatalog {Service<IConfig>::get()->getBool("api-subsonic-library-catalog", false)};
+
+	auto onLibraryChanged {[&db = _db, useLibraryCatalog]
+	{
+		artistIndexCache.invalidate();
+		libraryIdCache.invalidate();
+
+		if (useLibraryCatalog)
+		{
+			// The current catalog is outdated: serve from the database while rebuilding
+			libraryCatalog.clear();
+			buildLibraryCatalog(db);
+		}
+	}};
+	Service<Scanner::IMediaScanner>::get()->scanComplete().connect(onLibraryChanged);
+	Service<Scanner::IMediaScanner>::get()->libraryUpdated().connect(onLibraryChanged);
+
+	// Requests are served from the database until built
+	if (useLibraryCatalog)
+	{
+		Readiness::declare("library_catalog");
+		auto buildAtStartup {[&db = _db]
+		{
+			const Metrics::ScopedWarming warming {"library_catalog"};
+			buildLibraryCatalog(db);
+		}};
+
+		if (Scheduler* scheduler {Service<Scheduler>::get()})
+			scheduler->post(Scheduler::TaskClass::Cpu, Scheduler::Priority::Normal, CancellationToken {}, buildAtStartup);
+		else
+			buildAtStartup();
+	}
 }
 
 static
@@ -195,13 +362,25 @@ std::string parameterMapToDebugString(const Wt::Http::ParameterMap& parameterMap
 	return res;
 }
 
+static
+std::vector<IdType>
+getIdValues(const std::vector<Id>& ids)
+{
+	std::vector<IdType> res;
+	res.reserve(ids.size());
+
+	std::transform(std::cbegin(ids), std::cend(ids), std::back_inserter(res), [](const Id& id) { return id.value; });
+
+	return res;
+}
+
 static
 void
 checkUserIsMySelfOrAdmin(RequestContext& context, const std::string& username)
 {
 	if (username != context.userName)
 	{
-		User::pointer currentUser {User::getByLoginName(context.dbSession, context.userName)};
+		User::pointer currentUser {User::getById(context.dbSession, context.user.id)};
 		if (!currentUser)
 			throw RequestedDataNotFoundError {};
 
@@ -210,23 +389,20 @@ checkUserIsMySelfOrAdmin(RequestContext& context, const std::string& username)
 	}
 }
 
+// Allocated using the request arena
 static
-std::string
+std::pmr::string
 getArtistNames(const std::vector<Artist::pointer>& artists)
 {
-	if (artists.size() == 1)
-		return artists.front()->getName();
-
-	std::vector<std::string> names;
-	names.resize(artists.size());
-
-	std::transform(std::cbegin(artists), std::cend(artists), std::begin(names),
-			[](const Artist::pointer& artist)
-			{
-				return artist->getName();
-			});
+	std::pmr::string names {RequestArena::getCurrentResource()};
+	for (const Artist::pointer& artist : artists)
+	{
+		if (!names.empty())
+			names += ", ";
+		names += artist->getName();
+	}
 
-	return StringUtils::joinStrings(names, ", ");
+	return names;
 }
 
 static
@@ -265,6 +441,15 @@ getTrackPath(const Track::pointer& track)
 	return path;
 }
 
+static
+std::string
+timeToString(std::time_t t)
+{
+	std::tm gmTime;
+	std::ostringstream oss; oss << std::put_time(::gmtime_r(&t, &gmTime), "%FT%T");
+	return oss.str();
+}
+
 static
 std::string_view
 formatToSuffix(AudioFormat format)
@@ -281,9 +466,78 @@ formatToSuffix(AudioFormat format)
 	return "";
 }
 
+// The genre cluster type only changes with the library: resolved once per library generation
+// Must be called within a transaction
+static
+std::optional<IdType>
+getGenreClusterTypeId(Session& dbSession)
+{
+	static std::mutex mutex;
+	static std::optional<std::size_t> libraryGeneration;
+	static std::optional<IdType> genreClusterTypeId;
+
+	const std::size_t currentLibraryGeneration {Service<Scanner::IMediaScanner>::get()->getLibraryGeneration()};
+	{
+		std::scoped_lock lock {mutex};
+		if (libraryGeneration == currentLibraryGeneration)
+			return genreClusterTypeId;
+	}
+
+	std::optional<IdType> clusterTypeId;
+	if (const ClusterType::pointer clusterType {ClusterType::getByName(dbSession, genreClusterName)})
+		clusterTypeId = clusterType.id();
+
+	std::scoped_lock lock {mutex};
+	libraryGeneration = currentLibraryGeneration;
+	genreClusterTypeId = clusterTypeId;
+
+	return clusterTypeId;
+}
+
+// What track nodes report beyond the track itself, loaded for a whole list of tracks at once
+struct TrackNodesInfo
+{
+	std::unordered_map<IdType, std::vector<Artist::pointer>>	artists;
+	std::vector<Release::pointer>								releases; // keeps the releases loaded in the session
+	std::unordered_set<IdType>									starredTrackIds;
+	std::unordered_map<IdType, Cluster::pointer>				genres;
+};
+
+static
+TrackNodesInfo
+getTrackNodesInfo(Session& dbSession, const User::pointer& user, const std::vector<Track::pointer>& tracks)
+{
+	TrackNodesInfo info;
+
+	std::vector<IdType> trackIds;
+	std::vector<IdType> releaseIds;
+	{
+		std::unordered_set<IdType> seenReleaseIds;
+
+		trackIds.reserve(tracks.size());
+		for (const Track::pointer& track : tracks)
+		{
+			trackIds.push_back(track.id());
+
+			const Release::pointer release {track->getRelease()};
+			if (release && seenReleaseIds.insert(release.id()).second)
+				releaseIds.push_back(release.id());
+		}
+	}
+
+	info.artists = Track::getArtistsByTrack(dbSession, trackIds, {TrackArtistLinkType::Artist});
+	info.releases = Release::getByIds(dbSession, releaseIds);
+	info.starredTrackIds = user->getStarredTrackIds(trackIds);
+
+	if (const std::optional<IdType> genreClusterTypeId {getGenreClusterTypeId(dbSession)})
+		info.genres = Track::getFirstClusterByTrack(dbSession, trackIds, *genreClusterTypeId);
+
+	return info;
+}
+
 static
 Response::Node
-trackToResponseNode(const Track::pointer& track, Session& dbSession, const User::pointer& user)
+trackToResponseNode(const Track::pointer& track, const TrackNodesInfo& info, const User::pointer& user)
 {
 	Response::Node trackResponse;
 
@@ -298,11 +552,15 @@ trackToResponseNode(const Track::pointer& track, Session& dbSession, const User:
 		trackResponse.setAttribute("year", *track->getYear());
 
 	trackResponse.setAttribute("path", getTrackPath(track));
+	if (const std::uintmax_t fileSize {track->getFileSize()})
+		trackResponse.setAttribute("size", fileSize);
+	else
 	{
+		// Unknown until the next scan
 		std::error_code ec;
-		const auto fileSize {std::filesystem::file_size(track->getPath(), ec)};
+		const auto actualFileSize {std::filesystem::file_size(track->getPath(), ec)};
 		if (!ec)
-			trackResponse.setAttribute("size", fileSize);
+			trackResponse.setAttribute("size", actualFileSize);
 	}
 
 	if (track->getPath().has_extension())
@@ -316,10 +574,10 @@ trackToResponseNode(const Track::pointer& track, Session& dbSession, const User:
 
 	trackResponse.setAttribute("coverArt", IdToString({Id::Type::Track, track.id()}));
 
-	const std::vector<Artist::pointer>& artists {track->getArtists({TrackArtistLinkType::Artist})};
-	LMS_LOG(API_SUBSONIC, DEBUG) << "Artists count = " << artists.size();
-	if (!artists.empty())
+	if (auto itArtists {info.artists.find(track.id())}; itArtists != std::cend(info.artists))
 	{
+		const std::vector<Artist::pointer>& artists {itArtists->second};
+
 		trackResponse.setAttribute("artist", getArtistNames(artists));
 
 		if (artists.size() == 1)
@@ -336,17 +594,12 @@ trackToResponseNode(const Track::pointer& track, Session& dbSession, const User:
 	trackResponse.setAttribute("duration", std::chrono::duration_cast<std::chrono::seconds>(track->getDuration()).count());
 	trackResponse.setAttribute("type", "music");
 
-	if (user->hasStarredTrack(track))
+	if (info.starredTrackIds.find(track.id()) != std::cend(info.starredTrackIds))
 		trackResponse.setAttribute("starred", reportedStarredDate);
 
 	// Report the first GENRE for this track
-	ClusterType::pointer clusterType {ClusterType::getByName(dbSession, genreClusterName)};
-	if (clusterType)
-	{
-		auto clusters {track->getClusterGroups({clusterType}, 1)};
-		if (!clusters.empty() && !clusters.front().empty())
-			trackResponse.setAttribute("genre", clusters.front().front()->getName());
-	}
+	if (auto itGenre {info.genres.find(track.id())}; itGenre != std::cend(info.genres))
+		trackResponse.setAttribute("genre", itGenre->second->getName());
 
 	return trackResponse;
 }
@@ -367,17 +620,61 @@ trackBookmarkToResponseNode(const TrackBookmark::pointer& trackBookmark)
 	return trackBookmarkNode;
 }
 
+// What release nodes report beyond the release itself, loaded for a whole list of releases at once
+struct ReleaseNodesInfo
+{
+	std::unordered_map<IdType, std::vector<Artist::pointer>>	releaseArtists;
+	std::unordered_map<IdType, std::vector<Artist::pointer>>	artists;
+	std::unordered_set<IdType>									starredReleaseIds;
+	std::unordered_map<IdType, Cluster::pointer>				genres; // only for id3
+};
+
+static
+ReleaseNodesInfo
+getReleaseNodesInfo(Session& dbSession, const User::pointer& user, const std::vector<Release::pointer>& releases, bool id3)
+{
+	ReleaseNodesInfo info;
+
+	std::vector<IdType> releaseIds;
+	releaseIds.reserve(releases.size());
+	for (const Release::pointer& release : releases)
+		releaseIds.push_back(release.id());
+
+	info.releaseArtists = Release::getArtistsByRelease(dbSession, releaseIds, TrackArtistLinkType::ReleaseArtist);
+	{
+		// Artists are only reported for releases that have no release artist
+		std::vector<IdType> remainingReleaseIds;
+		for (const IdType releaseId : releaseIds)
+		{
+			if (info.releaseArtists.find(releaseId) == std::cend(info.releaseArtists))
+				remainingReleaseIds.push_back(releaseId);
+		}
+
+		info.artists = Release::getArtistsByRelease(dbSession, remainingReleaseIds, TrackArtistLinkType::Artist);
+	}
+
+	info.starredReleaseIds = user->getStarredReleaseIds(releaseIds);
+
+	if (id3)
+	{
+		if (const std::optional<IdType> genreClusterTypeId {getGenreClusterTypeId(dbSession)})
+			info.genres = Release::getFirstClusterByRelease(dbSession, releaseIds, *genreClusterTypeId);
+	}
+
+	return info;
+}
+
 static
 Response::Node
-releaseToResponseNode(const Release::pointer& release, Session& dbSession, const User::pointer& user, bool id3)
+releaseToResponseNode(const Release::pointer& release, const ReleaseNodesInfo& info, bool id3)
 {
 	Response::Node albumNode;
 
 	if (id3)
 	{
 		albumNode.setAttribute("name", release->getName());
-		albumNode.setAttribute("songCount", release->getTracksCount());
-		albumNode.setAttribute("duration", std::to_string(std::chrono::duration_cast<std::chrono::seconds>(release->getDuration()).count()));
+		albumNode.setAttribute("songCount", release->getCachedTracksCount());
+		albumNode.setAttribute("duration", std::to_string(std::chrono::duration_cast<std::chrono::seconds>(release->getCachedDuration()).count()));
 	}
 	else
 	{
@@ -385,12 +682,7 @@ releaseToResponseNode(const Release::pointer& release, Session& dbSession, const
 		albumNode.setAttribute("isDir", true);
 	}
 
-	{
-		std::time_t t {release->getLastWritten().toTime_t()};
-		std::tm gmTime;
-		std::ostringstream oss; oss << std::put_time(::gmtime_r(&t, &gmTime), "%FT%T");
-		albumNode.setAttribute("created", oss.str());
-	}
+	albumNode.setAttribute("created", timeToString(release->getLastWritten().toTime_t()));
 
 	albumNode.setAttribute("id", IdToString({Id::Type::Release, release.id()}));
 	albumNode.setAttribute("coverArt", IdToString({Id::Type::Release, release.id()}));
@@ -398,9 +690,11 @@ releaseToResponseNode(const Release::pointer& release, Session& dbSession, const
 	if (releaseYear)
 		albumNode.setAttribute("year", *releaseYear);
 
-	auto artists {release->getReleaseArtists()};
-	if (artists.empty())
-		artists = release->getArtists();
+	std::vector<Artist::pointer> artists;
+	if (auto itArtists {info.releaseArtists.find(release.id())}; itArtists != std::cend(info.releaseArtists))
+		artists = itArtists->second;
+	else if (auto itArtists {info.artists.find(release.id())}; itArtists != std::cend(info.artists))
+		artists = itArtists->second;
 
 	if (artists.empty() && !id3)
 	{
@@ -426,17 +720,12 @@ releaseToResponseNode(const Release::pointer& release, Session& dbSession, const
 
 	if (id3)
 	{
-		// Report the first GENRE for this track
-		ClusterType::pointer clusterType {ClusterType::getByName(dbSession, genreClusterName)};
-		if (clusterType)
-		{
-			auto clusters {release->getClusterGroups({clusterType}, 1)};
-			if (!clusters.empty() && !clusters.front().empty())
-				albumNode.setAttribute("genre", clusters.front().front()->getName());
-		}
+		// Report the first GENRE for this release
+		if (auto itGenre {info.genres.find(release.id())}; itGenre != std::cend(info.genres))
+			albumNode.setAttribute("genre", itGenre->second->getName());
 	}
 
-	if (user->hasStarredRelease(release))
+	if (info.starredReleaseIds.find(release.id()) != std::cend(info.starredReleaseIds))
 		albumNode.setAttribute("starred", reportedStarredDate);
 
 	return albumNode;
@@ -444,7 +733,30 @@ releaseToResponseNode(const Release::pointer& release, Session& dbSession, const
 
 static
 Response::Node
-artistToResponseNode(const User::pointer& user, const Artist::pointer& artist, bool id3)
+releaseToResponseNode(const Release::pointer& release, Session& dbSession, const User::pointer& user, bool id3)
+{
+	return releaseToResponseNode(release, getReleaseNodesInfo(dbSession, user, {release}, id3), id3);
+}
+
+static
+const std::unordered_set<IdType>&
+getStarredArtistIds(RequestContext& context)
+{
+	if (!context.starredArtistIds)
+	{
+		const User::pointer user {User::getById(context.dbSession, context.user.id)};
+		if (!user)
+			throw UserNotAuthorizedError {};
+
+		context.starredArtistIds = user->getStarredArtistIds();
+	}
+
+	return *context.starredArtistIds;
+}
+
+static
+Response::Node
+artistToResponseNode(RequestContext& context, const Artist::pointer& artist, bool id3)
 {
 	Response::Node artistNode;
 
@@ -452,14 +764,174 @@ artistToResponseNode(const User::pointer& user, const Artist::pointer& artist, b
 	artistNode.setAttribute("name", artist->getName());
 
 	if (id3)
-		artistNode.setAttribute("albumCount", artist->getReleaseCount());
+		artistNode.setAttribute("albumCount", artist->getCachedReleaseCount());
 
-	if (user->hasStarredArtist(artist))
+	const std::unordered_set<IdType>& starredArtistIds {getStarredArtistIds(context)};
+	if (starredArtistIds.find(artist.id()) != std::cend(starredArtistIds))
 		artistNode.setAttribute("starred", reportedStarredDate);
 
 	return artistNode;
 }
 
+static
+Response::Node
+artistIndexEntryToResponseNode(IdType artistId, const std::string& name, std::size_t releaseCount, bool starred, bool id3)
+{
+	Response::Node artistNode;
+
+	artistNode.setAttribute("id", IdToString({Id::Type::Artist, artistId}));
+	artistNode.setAttribute("name", name);
+
+	if (id3)
+		artistNode.setAttribute("albumCount", releaseCount);
+
+	if (starred)
+		artistNode.setAttribute("starred", reportedStarredDate);
+
+	return artistNode;
+}
+
+// Same as getTrackPath, using the catalog
+static
+std::string
+getTrackPath(const LibraryCatalog::Snapshot& catalog, LibraryCatalog::Row trackRow, LibraryCatalog::Row releaseRow)
+{
+	const LibraryCatalog::Releases& releases {catalog.releases};
+	const LibraryCatalog::Tracks& tracks {catalog.tracks};
+
+	std::string path;
+
+	if (releases.artistCounts[releaseRow] > 1)
+		path = "Various Artists/";
+	else if (releases.artistCounts[releaseRow] == 1)
+		path = makeNameFilesystemCompatible(releases.artistNames[releaseRow]) + "/";
+
+	path += makeNameFilesystemCompatible(releases.names[releaseRow]) + "/";
+
+	if (tracks.discNumbers[trackRow])
+		path += std::to_string(*tracks.discNumbers[trackRow]) + "-";
+	if (tracks.trackNumbers[trackRow])
+		path += std::to_string(*tracks.trackNumbers[trackRow]) + "-";
+
+	path += makeNameFilesystemCompatible(tracks.names[trackRow]);
+	path += tracks.fileExtensions[trackRow];
+
+	return path;
+}
+
+// Same as trackToResponseNode, using the catalog
+static
+Response::Node
+catalogTrackToResponseNode(const LibraryCatalog::Snapshot& catalog, LibraryCatalog::Row trackRow, LibraryCatalog::Row releaseRow, bool starred, const UserInfo& user)
+{
+	const LibraryCatalog::Releases& releases {catalog.releases};
+	const LibraryCatalog::Tracks& tracks {catalog.tracks};
+
+	Response::Node trackResponse;
+
+	trackResponse.setAttribute("id", IdToString({Id::Type::Track, tracks.ids[trackRow]}));
+	trackResponse.setAttribute("isDir", false);
+	trackResponse.setAttribute("title", tracks.names[trackRow]);
+	if (tracks.trackNumbers[trackRow])
+		trackResponse.setAttribute("track", *tracks.trackNumbers[trackRow]);
+	if (tracks.discNumbers[trackRow])
+		trackResponse.setAttribute("discNumber", *tracks.discNumbers[trackRow]);
+	if (tracks.years[trackRow])
+		trackResponse.setAttribute("year", *tracks.years[trackRow]);
+
+	trackResponse.setAttribute("path", getTrackPath(catalog, trackRow, releaseRow));
+	if (tracks.fileSizes[trackRow])
+		trackResponse.setAttribute("size", tracks.fileSizes[trackRow]);
+
+	if (!tracks.fileExtensions[trackRow].empty())
+		trackResponse.setAttribute("suffix", std::string_view {tracks.fileExtensions[trackRow]}.substr(1));
+
+	if (user.transcodeEnable)
+		trackResponse.setAttribute("transcodedSuffix", formatToSuffix(user.transcodeFormat));
+
+	trackResponse.setAttribute("coverArt", IdToString({Id::Type::Track, tracks.ids[trackRow]}));
+
+	if (!tracks.artistNames[trackRow].empty())
+	{
+		trackResponse.setAttribute("artist", tracks.artistNames[trackRow]);
+
+		if (tracks.artistIds[trackRow])
+			trackResponse.setAttribute("artistId", IdToString({Id::Type::Artist, *tracks.artistIds[trackRow]}));
+	}
+
+	trackResponse.setAttribute("album", releases.names[releaseRow]);
+	trackResponse.setAttribute("albumId", IdToString({Id::Type::Release, releases.ids[releaseRow]}));
+	trackResponse.setAttribute("parent", IdToString({Id::Type::Release, releases.ids[releaseRow]}));
+
+	trackResponse.setAttribute("duration", std::chrono::duration_cast<std::chrono::seconds>(tracks.durations[trackRow]).count());
+	trackResponse.setAttribute("type", "music");
+
+	if (starred)
+		trackResponse.setAttribute("starred", reportedStarredDate);
+
+	if (tracks.genres[trackRow] != LibraryCatalog::noGenre)
+		trackResponse.setAttribute("genre", catalog.genreNames[tracks.genres[trackRow]]);
+
+	return trackResponse;
+}
+
+// Same as releaseToResponseNode, using the catalog
+static
+Response::Node
+catalogReleaseToResponseNode(const LibraryCatalog::Snapshot& catalog, LibraryCatalog::Row row, bool starred, bool id3)
+{
+	const LibraryCatalog::Releases& releases {catalog.releases};
+
+	Response::Node albumNode;
+
+	if (id3)
+	{
+		albumNode.setAttribute("name", releases.names[row]);
+		albumNode.setAttribute("songCount", releases.trackCounts[row]);
+		albumNode.setAttribute("duration", std::to_string(std::chrono::duration_cast<std::chrono::seconds>(releases.durations[row]).count()));
+	}
+	else
+	{
+		albumNode.setAttribute("title", releases.names[row]);
+		albumNode.setAttribute("isDir", true);
+	}
+
+	albumNode.setAttribute("created", timeToString(releases.lastWrittenTimes[row]));
+
+	albumNode.setAttribute("id", IdToString({Id::Type::Release, releases.ids[row]}));
+	albumNode.setAttribute("coverArt", IdToString({Id::Type::Release, releases.ids[row]}));
+	if (releases.years[row])
+		albumNode.setAttribute("year", *releases.years[row]);
+
+	if (releases.artistCounts[row] == 0)
+	{
+		if (!id3)
+			albumNode.setAttribute("parent", IdToString({Id::Type::Root}));
+	}
+	else
+	{
+		albumNode.setAttribute("artist", releases.artistNames[row]);
+
+		if (releases.artistIds[row])
+		{
+			if (id3)
+				albumNode.setAttribute("artistId", IdToString({Id::Type::Artist, *releases.artistIds[row]}));
+			else
+				albumNode.setAttribute("parent", IdToString({Id::Type::Artist, *releases.artistIds[row]}));
+		}
+		else if (!id3)
+			albumNode.setAttribute("parent", IdToString({Id::Type::Root}));
+	}
+
+	if (id3 && releases.genres[row] != LibraryCatalog::noGenre)
+		albumNode.setAttribute("genre", catalog.genreNames[releases.genres[row]]);
+
+	if (starred)
+		albumNode.setAttribute("starred", reportedStarredDate);
+
+	return albumNode;
+}
+
 static
 Response::Node
 clusterToResponseNode(const Cluster::pointer& cluster)
@@ -467,8 +939,8 @@ clusterToResponseNode(const Cluster::pointer& cluster)
 	Response::Node clusterNode;
 
 	clusterNode.setValue(cluster->getName());
-	clusterNode.setAttribute("songCount", cluster->getTracksCount());
-	clusterNode.setAttribute("albumCount", cluster->getReleasesCount());
+	clusterNode.setAttribute("songCount", cluster->getCachedTracksCount());
+	clusterNode.setAttribute("albumCount", cluster->getCachedReleasesCount());
 
 	return clusterNode;
 }
@@ -553,7 +1025,7 @@ handleCreatePlaylistRequest(RequestContext& context)
 
 	auto transaction {context.dbSession.createUniqueTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -576,14 +1048,7 @@ handleCreatePlaylistRequest(RequestContext& context)
 		tracklist = TrackList::create(context.dbSession, *name, TrackList::Type::Playlist, false, user);
 	}
 
-	for (const Id& trackId : trackIds)
-	{
-		Track::pointer track {Track::getById(context.dbSession, trackId.value)};
-		if (!track)
-			continue;
-
-		TrackListEntry::create(context.dbSession, track, tracklist );
-	}
+	TrackList::appendTracks(context.dbSession, tracklist, getIdValues(trackIds));
 
 	return Response::createOkResponse(context);
 }
@@ -623,7 +1088,7 @@ handleDeletePlaylistRequest(RequestContext& context)
 
 	auto transaction {context.dbSession.createUniqueTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -685,7 +1150,7 @@ handleGetRandomSongsRequest(RequestContext& context)
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -694,8 +1159,69 @@ handleGetRandomSongsRequest(RequestContext& context)
 	Response response {Response::createOkResponse(context)};
 
 	Response::Node& randomSongsNode {response.createNode("randomSongs")};
+	const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 	for (const Track::pointer& track : tracks)
-		randomSongsNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		randomSongsNode.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
+
+	return response;
+}
+
+static CursorCache albumListCursorCache;
+
+// Library-wide listings are served from the catalog, nullopt for the other types
+static
+std::optional<Response>
+handleGetAlbumListRequestFromCatalog(const RequestContext& context, const LibraryCatalog::Snapshot& catalog, const std::string& type, Range range, bool id3)
+{
+	std::vector<LibraryCatalog::Row> rows;
+
+	if (type == "alphabeticalByName")
+	{
+		rows = LibraryCatalog::Snapshot::getRange(catalog.releases.byName, range);
+	}
+	else if (type == "byGenre")
+	{
+		// Mandatory param
+		const std::string genre {getMandatoryParameterAs<std::string>(context.parameters, "genre")};
+
+		rows = catalog.getReleasesByGenre(genre, range);
+	}
+	else if (type == "byYear")
+	{
+		const int fromYear {getMandatoryParameterAs<int>(context.parameters, "fromYear")};
+		const int toYear {getMandatoryParameterAs<int>(context.parameters, "toYear")};
+
+		rows = catalog.getReleasesByYear(fromYear, toYear, range);
+	}
+	else if (type == "newest")
+	{
+		rows = LibraryCatalog::Snapshot::getRange(catalog.releases.byLastWritten, range);
+	}
+	else
+		return std::nullopt;
+
+	std::vector<IdType> releaseIds;
+	releaseIds.reserve(rows.size());
+	for (const LibraryCatalog::Row row : rows)
+		releaseIds.push_back(catalog.releases.ids[row]);
+
+	// User state is not part of the catalog
+	std::unordered_set<IdType> starredReleaseIds;
+	{
+		auto transaction {context.dbSession.createSharedTransaction()};
+
+		const User::pointer user {User::getById(context.dbSession, context.user.id)};
+		if (!user)
+			throw UserNotAuthorizedError {};
+
+		starredReleaseIds = user->getStarredReleaseIds(releaseIds);
+	}
+
+	Response response {Response::createOkResponse(context)};
+	Response::Node& albumListNode {response.createNode(id3 ? "albumList2" : "albumList")};
+
+	for (const LibraryCatalog::Row row : rows)
+		albumListNode.addArrayChild("album", catalogReleaseToResponseNode(catalog, row, starredReleaseIds.find(catalog.releases.ids[row]) != std::cend(starredReleaseIds), id3));
 
 	return response;
 }
@@ -713,17 +1239,38 @@ handleGetAlbumListRequestCommon(const RequestContext& context, bool id3)
 
 	const Range range {offset, size};
 
+	if (const std::shared_ptr<const LibraryCatalog::Snapshot> catalog {libraryCatalog.get()})
+	{
+		if (std::optional<Response> response {handleGetAlbumListRequestFromCatalog(context, *catalog, type, range, id3)})
+			return std::move(*response);
+	}
+
 	std::vector<Release::pointer> releases;
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
+	// Listings ordered by name use keyset pagination if the client asks for the page that follows the last one it got
+	auto getReleasesOrderedByName {[&](const std::string& listingKey, const auto& getByCursor, const auto& getByRange)
+	{
+		const std::optional<Cursor> cursor {offset > 0 ? albumListCursorCache.get(listingKey, offset) : std::nullopt};
+
+		bool moreResults {};
+		std::vector<Release::pointer> res {(offset == 0 || cursor) ? getByCursor(cursor, moreResults) : getByRange(moreResults)};
+		if (!res.empty())
+			albumListCursorCache.set(listingKey, offset + res.size(), Cursor {res.back()->getName(), res.back().id()});
+
+		return res;
+	}};
+
 	if (type == "alphabeticalByName")
 	{
-		releases = Release::getAll(context.dbSession, range);
+		releases = getReleasesOrderedByName(context.userName + "/" + type,
+				[&](const std::optional<Cursor>& cursor, bool& moreResults) { return Release::getByFilter(context.dbSession, {}, {}, cursor, size, moreResults); },
+				[&](bool& moreResults) { return Release::getByFilter(context.dbSession, {}, {}, range, moreResults); });
 	}
 	else if (type == "alphabeticalByArtist")
 	{
@@ -740,8 +1287,10 @@ handleGetAlbumListRequestCommon(const RequestContext& context, bool id3)
 			Cluster::pointer cluster {clusterType->getCluster(genre)};
 			if (cluster)
 			{
-				bool more;
-				releases = Release::getByFilter(context.dbSession, {cluster.id()}, {}, range, more);
+				const IdType clusterId {cluster.id()};
+				releases = getReleasesOrderedByName(context.userName + "/" + type + "/" + std::to_string(clusterId),
+						[&](const std::optional<Cursor>& cursor, bool& moreResults) { return Release::getByFilter(context.dbSession, {clusterId}, {}, cursor, size, moreResults); },
+						[&](bool& moreResults) { return Release::getByFilter(context.dbSession, {clusterId}, {}, range, moreResults); });
 			}
 		}
 	}
@@ -774,8 +1323,9 @@ handleGetAlbumListRequestCommon(const RequestContext& context, bool id3)
 	}
 	else if (type == "starred")
 	{
-		bool moreResults {};
-		releases = Release::getStarred(context.dbSession, user, {}, range, moreResults);
+		releases = getReleasesOrderedByName(context.userName + "/" + type,
+				[&](const std::optional<Cursor>& cursor, bool& moreResults) { return Release::getStarred(context.dbSession, user, {}, cursor, size, moreResults); },
+				[&](bool& moreResults) { return Release::getStarred(context.dbSession, user, {}, range, moreResults); });
 	}
 	else
 		throw NotImplementedGenericError {};
@@ -783,8 +1333,9 @@ handleGetAlbumListRequestCommon(const RequestContext& context, bool id3)
 	Response response {Response::createOkResponse(context)};
 	Response::Node& albumListNode {response.createNode(id3 ? "albumList2" : "albumList")};
 
+	const ReleaseNodesInfo releasesInfo {getReleaseNodesInfo(context.dbSession, user, releases, id3)};
 	for (const Release::pointer& release : releases)
-		albumListNode.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, id3));
+		albumListNode.addArrayChild("album", releaseToResponseNode(release, releasesInfo, id3));
 
 	return response;
 }
@@ -803,6 +1354,45 @@ handleGetAlbumList2Request(RequestContext& context)
 	return handleGetAlbumListRequestCommon(context, true /* id3 */);
 }
 
+static
+Response
+handleGetAlbumRequestFromCatalog(const RequestContext& context, const LibraryCatalog::Snapshot& catalog, IdType releaseId)
+{
+	const std::optional<LibraryCatalog::Row> releaseRow {catalog.getReleaseRow(releaseId)};
+	if (!releaseRow)
+		throw RequestedDataNotFoundError {};
+
+	const LibraryCatalog::Row firstTrackRow {catalog.releases.firstTracks[*releaseRow]};
+	const LibraryCatalog::Row endTrackRow {catalog.releases.firstTracks[*releaseRow + 1]};
+
+	// User state is not part of the catalog
+	bool releaseStarred {};
+	std::unordered_set<IdType> starredTrackIds;
+	{
+		auto transaction {context.dbSession.createSharedTransaction()};
+
+		const User::pointer user {User::getById(context.dbSession, context.user.id)};
+		if (!user)
+			throw UserNotAuthorizedError {};
+
+		releaseStarred = !user->getStarredReleaseIds({releaseId}).empty();
+		starredTrackIds = user->getStarredTrackIds(std::vector<IdType>(std::cbegin(catalog.tracks.ids) + firstTrackRow, std::cbegin(catalog.tracks.ids) + endTrackRow));
+	}
+
+	Response response {Response::createOkResponse(context)};
+	Response::Node releaseNode {catalogReleaseToResponseNode(catalog, *releaseRow, releaseStarred, true /* id3 */)};
+
+	for (LibraryCatalog::Row trackRow {firstTrackRow}; trackRow < endTrackRow; ++trackRow)
+	{
+		const bool trackStarred {starredTrackIds.find(catalog.tracks.ids[trackRow]) != std::cend(starredTrackIds)};
+		releaseNode.addArrayChild("song", catalogTrackToResponseNode(catalog, trackRow, *releaseRow, trackStarred, context.user));
+	}
+
+	response.addNode("album", std::move(releaseNode));
+
+	return response;
+}
+
 static
 Response
 handleGetAlbumRequest(RequestContext& context)
@@ -813,13 +1403,16 @@ handleGetAlbumRequest(RequestContext& context)
 	if (id.type != Id::Type::Release)
 		throw BadParameterGenericError {"id"};
 
+	if (const std::shared_ptr<const LibraryCatalog::Snapshot> catalog {libraryCatalog.get()})
+		return handleGetAlbumRequestFromCatalog(context, *catalog, id.value);
+
 	auto transaction {context.dbSession.createSharedTransaction()};
 
 	Release::pointer release {Release::getById(context.dbSession, id.value)};
 	if (!release)
 		throw RequestedDataNotFoundError {};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -827,8 +1420,9 @@ handleGetAlbumRequest(RequestContext& context)
 	Response::Node releaseNode {releaseToResponseNode(release, context.dbSession, user, true /* id3 */)};
 
 	auto tracks {release->getTracks()};
+	const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 	for (const Track::pointer& track : tracks)
-		releaseNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		releaseNode.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
 
 	response.addNode("album", std::move(releaseNode));
 
@@ -851,16 +1445,17 @@ handleGetArtistRequest(RequestContext& context)
 	if (!artist)
 		throw RequestedDataNotFoundError {};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
 	Response response {Response::createOkResponse(context)};
-	Response::Node artistNode {artistToResponseNode(user, artist, true /* id3 */)};
+	Response::Node artistNode {artistToResponseNode(context, artist, true /* id3 */)};
 
 	auto releases {artist->getReleases()};
+	const ReleaseNodesInfo releasesInfo {getReleaseNodesInfo(context.dbSession, user, releases, true /* id3 */)};
 	for (const Release::pointer& release : releases)
-		artistNode.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, true /* id3 */));
+		artistNode.addArrayChild("album", releaseToResponseNode(release, releasesInfo, true /* id3 */));
 
 	response.addNode("artist", std::move(artistNode));
 
@@ -894,24 +1489,24 @@ handleGetArtistInfoRequestCommon(RequestContext& context, bool id3)
 			artistInfoNode.createChild("musicBrainzId").setValue(artistMBID->getAsString());
 	}
 
-	auto similarArtistsId {Service<Recommendation::IEngine>::get()->getSimilarArtists(context.dbSession,
+	// Most similar artists first
+	Recommendation::IEngine::RankedResults rankedSimilarArtists;
+	Service<Recommendation::IEngine>::get()->getRankedSimilarArtists(context.dbSession,
 			id.value,
 			{TrackArtistLinkType::Artist, TrackArtistLinkType::ReleaseArtist},
-			count)};
+			count,
+			rankedSimilarArtists);
+
+	std::vector<IdType> similarArtistsId;
+	for (const Recommendation::IEngine::ScoredId& similarArtist : rankedSimilarArtists)
+		similarArtistsId.push_back(similarArtist.id);
 
 	{
 		auto transaction {context.dbSession.createSharedTransaction()};
 
-		User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-		if (!user)
-			throw UserNotAuthorizedError {};
-
-		for ( const auto& similarArtistId : similarArtistsId )
-		{
-			Artist::pointer similarArtist {Artist::getById(context.dbSession, similarArtistId)};
-			if (similarArtist)
-				artistInfoNode.addArrayChild("similarArtist", artistToResponseNode(user, similarArtist, id3));
-		}
+		const std::vector<Artist::pointer> similarArtists {Artist::getByIds(context.dbSession, similarArtistsId)};
+		for (const Artist::pointer& similarArtist : similarArtists)
+			artistInfoNode.addArrayChild("similarArtist", artistToResponseNode(context, similarArtist, id3));
 	}
 
 	return response;
@@ -933,46 +1528,56 @@ handleGetArtistInfo2Request(RequestContext& context)
 
 static
 Response
-handleGetArtistsRequest(RequestContext& context)
+handleGetArtistsRequestCommon(RequestContext& context, bool id3)
 {
-	Response response {Response::createOkResponse(context)};
-	Response::Node& artistsNode {response.createNode("artists")};
+	// Optional params
+	const std::optional<long long> ifModifiedSince {id3 ? std::nullopt : getParameterAs<long long>(context.parameters, "ifModifiedSince")};
 
-	Response::Node& indexNode {artistsNode.createArrayChild("index")};
-	indexNode.setAttribute("name", "?");
+	Response response {Response::createOkResponse(context)};
+	Response::Node& artistsNode {response.createNode(id3 ? "artists" : "indexes")};
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw UserNotAuthorizedError {};
+	// Listed from the catalog if any, starred artists are still read from the database
+	const std::shared_ptr<const LibraryCatalog::Snapshot> catalog {libraryCatalog.get()};
+	const std::shared_ptr<const ArtistIndexCache::Snapshot> snapshot {catalog ? nullptr : artistIndexCache.get(context.dbSession, context.user.artistListMode)};
 
-	std::optional<TrackArtistLinkType> linkType;
-	switch (user->getSubsonicArtistListMode())
+	if (!id3)
 	{
-		case User::SubsonicArtistListMode::AllArtists:
-			break;
-		case User::SubsonicArtistListMode::ReleaseArtists:
-			linkType = TrackArtistLinkType::ReleaseArtist;
-			break;
-		case User::SubsonicArtistListMode::TrackArtists:
-			linkType = TrackArtistLinkType::Artist;
-			break;
+		const std::chrono::system_clock::time_point lastModifiedTime {catalog ? catalog->buildTime : snapshot->lastModified};
+		const long long lastModified {std::chrono::duration_cast<std::chrono::milliseconds>(lastModifiedTime.time_since_epoch()).count()};
+		artistsNode.setAttribute("lastModified", lastModified);
+
+		if (ifModifiedSince && *ifModifiedSince >= lastModified)
+			return response;
 	}
 
-	bool more {};
-	const std::vector<Artist::pointer> artists {Artist::getByFilter(context.dbSession,
-			{},
-			{},
-			linkType,
-			Artist::SortMethod::BySortName,
-			std::nullopt, more)};
-	for (const Artist::pointer& artist : artists)
-		indexNode.addArrayChild("artist", artistToResponseNode(user, artist, true /* id3 */));
+	Response::Node& indexNode {artistsNode.createArrayChild("index")};
+	indexNode.setAttribute("name", "?");
+
+	const std::unordered_set<IdType>& starredArtistIds {getStarredArtistIds(context)};
+	if (catalog)
+	{
+		const LibraryCatalog::Artists& artists {catalog->artists};
+		for (const LibraryCatalog::Row row : artists.bySortName.at(context.user.artistListMode))
+			indexNode.addArrayChild("artist", artistIndexEntryToResponseNode(artists.ids[row], artists.names[row], artists.releaseCounts[row], starredArtistIds.find(artists.ids[row]) != std::cend(starredArtistIds), id3));
+	}
+	else
+	{
+		for (const ArtistIndexCache::Entry& artist : snapshot->artists)
+			indexNode.addArrayChild("artist", artistIndexEntryToResponseNode(artist.id, artist.name, artist.releaseCount, starredArtistIds.find(artist.id) != std::cend(starredArtistIds), id3));
+	}
 
 	return response;
 }
 
+static
+Response
+handleGetArtistsRequest(RequestContext& context)
+{
+	return handleGetArtistsRequestCommon(context, true /* id3 */);
+}
+
 static
 Response
 handleGetMusicDirectoryRequest(RequestContext& context)
@@ -987,7 +1592,7 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1000,7 +1605,7 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 			bool moreResults{};
 			auto artists {Artist::getAll(context.dbSession, Artist::SortMethod::BySortName, std::nullopt, moreResults)};
 			for (const Artist::pointer& artist : artists)
-				directoryNode.addArrayChild("child", artistToResponseNode(user, artist, false /* no id3 */));
+				directoryNode.addArrayChild("child", artistToResponseNode(context, artist, false /* no id3 */));
 
 			break;
 		}
@@ -1014,8 +1619,9 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 			directoryNode.setAttribute("name", makeNameFilesystemCompatible(artist->getName()));
 
 			auto releases {artist->getReleases()};
+			const ReleaseNodesInfo releasesInfo {getReleaseNodesInfo(context.dbSession, user, releases, false /* no id3 */)};
 			for (const Release::pointer& release : releases)
-				directoryNode.addArrayChild("child", releaseToResponseNode(release, context.dbSession, user, false /* no id3 */));
+				directoryNode.addArrayChild("child", releaseToResponseNode(release, releasesInfo, false /* no id3 */));
 
 			break;
 		}
@@ -1029,8 +1635,9 @@ handleGetMusicDirectoryRequest(RequestContext& context)
 			directoryNode.setAttribute("name", makeNameFilesystemCompatible(release->getName()));
 
 			auto tracks {release->getTracks()};
+			const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 			for (const Track::pointer& track : tracks)
-				directoryNode.addArrayChild("child", trackToResponseNode(track, context.dbSession, user));
+				directoryNode.addArrayChild("child", trackToResponseNode(track, tracksInfo, user));
 
 			break;
 		}
@@ -1082,42 +1689,7 @@ static
 Response
 handleGetIndexesRequest(RequestContext& context)
 {
-	Response response {Response::createOkResponse(context)};
-	Response::Node& artistsNode {response.createNode("indexes")};
-
-	Response::Node& indexNode {artistsNode.createArrayChild("index")};
-	indexNode.setAttribute("name", "?");
-
-	auto transaction {context.dbSession.createSharedTransaction()};
-
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw UserNotAuthorizedError {};
-
-	std::optional<TrackArtistLinkType> linkType;
-	switch (user->getSubsonicArtistListMode())
-	{
-		case User::SubsonicArtistListMode::AllArtists:
-			break;
-		case User::SubsonicArtistListMode::ReleaseArtists:
-			linkType = TrackArtistLinkType::ReleaseArtist;
-			break;
-		case User::SubsonicArtistListMode::TrackArtists:
-			linkType = TrackArtistLinkType::Artist;
-			break;
-	}
-
-	bool more {};
-	const std::vector<Artist::pointer> artists {Artist::getByFilter(context.dbSession,
-			{},
-			{},
-			linkType,
-			Artist::SortMethod::BySortName,
-			std::nullopt, more)};
-	for (const Artist::pointer& artist : artists)
-		indexNode.addArrayChild("artist", artistToResponseNode(user, artist, false /* no id3 */));
-
-	return response;
+	return handleGetArtistsRequestCommon(context, false /* no id3 */);
 }
 
 static
@@ -1143,18 +1715,14 @@ handleGetSimilarSongsRequestCommon(RequestContext& context, bool id3)
 	if (!artist)
 		throw RequestedDataNotFoundError {};
 
-	const User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	const User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
 	// "Returns a random collection of songs from the given artist and similar artists"
 	auto tracks {artist->getRandomTracks(count / 2)};
-	for (const Database::IdType similarArtistId : similarArtistIds)
+	for (const Artist::pointer& similarArtist : Artist::getByIds(context.dbSession, std::vector<IdType>(std::cbegin(similarArtistIds), std::cend(similarArtistIds))))
 	{
-		const Artist::pointer similarArtist {Artist::getById(context.dbSession, similarArtistId)};
-		if (!similarArtist)
-			continue;
-
 		auto similarArtistTracks {similarArtist->getRandomTracks((count / 2) / 5)};
 
 		tracks.insert(std::end(tracks),
@@ -1166,8 +1734,9 @@ handleGetSimilarSongsRequestCommon(RequestContext& context, bool id3)
 
 	Response response {Response::createOkResponse(context)};
 	Response::Node& similarSongsNode {response.createNode(id3 ? "similarSongs2" : "similarSongs")};
+	const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 	for (const Track::pointer& track : tracks)
-		similarSongsNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		similarSongsNode.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
 
 	return response;
 }
@@ -1192,7 +1761,7 @@ handleGetStarredRequestCommon(RequestContext& context, bool id3)
 {
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1203,21 +1772,23 @@ handleGetStarredRequestCommon(RequestContext& context, bool id3)
 		bool moreResults {};
 		const auto artists {Artist::getStarred(context.dbSession, user, {}, std::nullopt, Artist::SortMethod::BySortName, std::nullopt, moreResults)};
 		for (const Artist::pointer& artist : artists)
-			starredNode.addArrayChild("artist", artistToResponseNode(user, artist, id3));
+			starredNode.addArrayChild("artist", artistToResponseNode(context, artist, id3));
 	}
 
 	{
 		bool moreResults {};
 		const auto releases {Release::getStarred(context.dbSession, user, {}, std::nullopt, moreResults)};
+		const ReleaseNodesInfo releasesInfo {getReleaseNodesInfo(context.dbSession, user, releases, id3)};
 		for (const Release::pointer& release : releases)
-			starredNode.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, id3));
+			starredNode.addArrayChild("album", releaseToResponseNode(release, releasesInfo, id3));
 	}
 
 	{
 		bool moreResults {};
 		const auto tracks {Track::getStarred(context.dbSession, user, {}, std::nullopt, moreResults)};
+		const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 		for (const Track::pointer& track : tracks)
-			starredNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+			starredNode.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
 	}
 
 	return response;
@@ -1266,7 +1837,7 @@ handleGetPlaylistRequest(RequestContext& context)
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1277,9 +1848,10 @@ handleGetPlaylistRequest(RequestContext& context)
 	Response response {Response::createOkResponse(context)};
 	Response::Node playlistNode {tracklistToResponseNode(tracklist, context.dbSession)};
 
-	auto entries {tracklist->getEntries()};
-	for (const TrackListEntry::pointer& entry : entries)
-		playlistNode.addArrayChild("entry", trackToResponseNode(entry->getTrack(), context.dbSession, user));
+	const auto tracks {tracklist->getTracks()};
+	const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
+	for (const Track::pointer& track : tracks)
+		playlistNode.addArrayChild("entry", trackToResponseNode(track, tracksInfo, user));
 
 	response.addNode("playlist", playlistNode );
 
@@ -1292,7 +1864,7 @@ handleGetPlaylistsRequest(RequestContext& context)
 {
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1329,7 +1901,7 @@ handleGetSongsByGenreRequest(RequestContext& context)
 	if (!cluster)
 		throw RequestedDataNotFoundError {};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1338,8 +1910,9 @@ handleGetSongsByGenreRequest(RequestContext& context)
 
 	bool more;
 	auto tracks {Track::getByFilter(context.dbSession, {cluster.id()}, {}, Range {offset, size}, more)};
+	const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 	for (const Track::pointer& track : tracks)
-		songsByGenreNode.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+		songsByGenreNode.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
 
 	return response;
 }
@@ -1399,30 +1972,79 @@ handleSearchRequestCommon(RequestContext& context, bool id3)
 
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
 	Response response {Response::createOkResponse(context)};
 	Response::Node& searchResult2Node {response.createNode(id3 ? "searchResult3" : "searchResult2")};
 
+	// Clients sync the whole library by paging through an empty query: serve the pages from ordered id lists
+	// Some clients send the empty query quoted
+	const std::string_view trimmedQuery {StringUtils::stringTrimView(query)};
+	if (trimmedQuery.empty() || trimmedQuery == "\"\"")
+	{
+		auto getPage {[](const std::vector<IdType>& ids, std::size_t offset, std::size_t count)
+		{
+			if (offset >= ids.size())
+				return std::vector<IdType> {};
+
+			return std::vector<IdType>(std::next(std::cbegin(ids), offset), std::next(std::cbegin(ids), offset + std::min(count, ids.size() - offset)));
+		}};
+
+		{
+			const std::shared_ptr<const ArtistIndexCache::Snapshot> artistIndex {artistIndexCache.get(context.dbSession, User::SubsonicArtistListMode::AllArtists)};
+
+			std::vector<IdType> artistIds;
+			if (artistOffset < artistIndex->artists.size())
+			{
+				const std::size_t count {std::min(artistCount, artistIndex->artists.size() - artistOffset)};
+				for (std::size_t i {artistOffset}; i < artistOffset + count; ++i)
+					artistIds.push_back(artistIndex->artists[i].id);
+			}
+
+			for (const Artist::pointer& artist : Artist::getByIds(context.dbSession, artistIds))
+				searchResult2Node.addArrayChild("artist", artistToResponseNode(context, artist, id3));
+		}
+
+		const std::shared_ptr<const LibraryIdCache::Snapshot> libraryIds {libraryIdCache.get(context.dbSession)};
+
+		{
+			const std::vector<Release::pointer> releases {Release::getByIds(context.dbSession, getPage(libraryIds->releaseIds, albumOffset, albumCount))};
+			const ReleaseNodesInfo releasesInfo {getReleaseNodesInfo(context.dbSession, user, releases, id3)};
+			for (const Release::pointer& release : releases)
+				searchResult2Node.addArrayChild("album", releaseToResponseNode(release, releasesInfo, id3));
+		}
+
+		{
+			const std::vector<Track::pointer> tracks {Track::getByIds(context.dbSession, getPage(libraryIds->trackIds, songOffset, songCount))};
+			const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
+			for (const Track::pointer& track : tracks)
+				searchResult2Node.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
+		}
+
+		return response;
+	}
+
 	bool more;
 	{
 		auto artists {Artist::getByFilter(context.dbSession, {}, keywords, std::nullopt, Artist::SortMethod::BySortName, Range {artistOffset, artistCount}, more)};
 		for (const Artist::pointer& artist : artists)
-			searchResult2Node.addArrayChild("artist", artistToResponseNode(user, artist, id3));
+			searchResult2Node.addArrayChild("artist", artistToResponseNode(context, artist, id3));
 	}
 
 	{
 		auto releases {Release::getByFilter(context.dbSession, {}, keywords, Range {albumOffset, albumCount}, more)};
+		const ReleaseNodesInfo releasesInfo {getReleaseNodesInfo(context.dbSession, user, releases, id3)};
 		for (const Release::pointer& release : releases)
-			searchResult2Node.addArrayChild("album", releaseToResponseNode(release, context.dbSession, user, id3));
+			searchResult2Node.addArrayChild("album", releaseToResponseNode(release, releasesInfo, id3));
 	}
 
 	{
 		auto tracks {Track::getByFilter(context.dbSession, {}, keywords, Range {songOffset, songCount}, more)};
+		const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
 		for (const Track::pointer& track : tracks)
-			searchResult2Node.addArrayChild("song", trackToResponseNode(track, context.dbSession, user));
+			searchResult2Node.addArrayChild("song", trackToResponseNode(track, tracksInfo, user));
 	}
 
 	return response;
@@ -1479,38 +2101,16 @@ handleStarRequest(RequestContext& context)
 {
 	StarParameters params {getStarParameters(context.parameters)};
 
-	auto transaction {context.dbSession.createSharedTransaction()};
-
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw UserNotAuthorizedError {};
+	const IdType userId {context.user.id};
 
+	// Unknown objects are skipped when the updates are written
+	UserStateJournal& journal {context.db.getUserStateJournal()};
 	for (const Id& id : params.artistIds)
-	{
-		Artist::pointer artist {Artist::getById(context.dbSession, id.value)};
-		if (!artist)
-			continue;
-
-		user.modify()->starArtist(artist);
-	}
-
+		journal.setArtistStarred(userId, id.value, true);
 	for (const Id& id : params.releaseIds)
-	{
-		Release::pointer release {Release::getById(context.dbSession, id.value)};
-		if (!release)
-			continue;
-
-		user.modify()->starRelease(release);
-	}
-
+		journal.setReleaseStarred(userId, id.value, true);
 	for (const Id& id : params.trackIds)
-	{
-		Track::pointer track {Track::getById(context.dbSession, id.value)};
-		if (!track)
-			continue;
-
-		user.modify()->starTrack(track);
-	}
+		journal.setTrackStarred(userId, id.value, true);
 
 	return Response::createOkResponse(context);
 }
@@ -1535,39 +2135,16 @@ handleUnstarRequest(RequestContext& context)
 {
 	StarParameters params {getStarParameters(context.parameters)};
 
-	auto transaction {context.dbSession.createSharedTransaction()};
-
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw RequestedDataNotFoundError {};
+	const IdType userId {context.user.id};
 
+	// Unknown objects are skipped when the updates are written
+	UserStateJournal& journal {context.db.getUserStateJournal()};
 	for (const Id& id : params.artistIds)
-	{
-		Artist::pointer artist {Artist::getById(context.dbSession, id.value)};
-		if (!artist)
-			continue;
-
-		user.modify()->unstarArtist(artist);
-	}
-
+		journal.setArtistStarred(userId, id.value, false);
 	for (const Id& id : params.releaseIds)
-	{
-		Release::pointer release {Release::getById(context.dbSession, id.value)};
-		if (!release)
-			continue;
-
-		user.modify()->unstarRelease(release);
-	}
-
+		journal.setReleaseStarred(userId, id.value, false);
 	for (const Id& id : params.trackIds)
-	{
-		Track::pointer track {Track::getById(context.dbSession, id.value)};
-		if (!track)
-			continue;
-
-		user.modify()->unstarTrack(track);
-	}
-
+		journal.setTrackStarred(userId, id.value, false);
 
 	return Response::createOkResponse(context);
 }
@@ -1582,20 +2159,12 @@ handleScrobble(RequestContext& context)
 	if (!std::all_of(std::cbegin(ids), std::cend(ids), [](const Id& id) { return id.type == Id::Type::Track; }))
 		throw BadParameterGenericError {"id"};
 
-	auto transaction {context.dbSession.createUniqueTransaction()};
-
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw RequestedDataNotFoundError {};
+	const IdType userId {context.user.id};
 
+	// Unknown tracks are skipped when the updates are written
+	UserStateJournal& journal {context.db.getUserStateJournal()};
 	for (Id id : ids)
-	{
-		Track::pointer track {Track::getById(context.dbSession, id.value)};
-		if (!track)
-			continue;
-
-		TrackListEntry::create(context.dbSession, track, user->getPlayedTrackList(context.dbSession));
-	}
+		journal.addListen(userId, id.value);
 
 	return Response::createOkResponse(context);
 }
@@ -1653,7 +2222,7 @@ handleUpdatePlaylistRequest(RequestContext& context)
 
 	auto transaction {context.dbSession.createUniqueTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1684,14 +2253,7 @@ handleUpdatePlaylistRequest(RequestContext& context)
 	}
 
 	// Add tracks
-	for (const Id& trackIdToAdd : trackIdsToAdd)
-	{
-		Track::pointer track {Track::getById(context.dbSession, trackIdToAdd.value)};
-		if (!track)
-			continue;
-
-		TrackListEntry::create(context.dbSession, track, tracklist );
-	}
+	TrackList::appendTracks(context.dbSession, tracklist, getIdValues(trackIdsToAdd));
 
 	return Response::createOkResponse(context);
 }
@@ -1702,7 +2264,7 @@ handleGetBookmarks(RequestContext& context)
 {
 	auto transaction {context.dbSession.createSharedTransaction()};
 
-	User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
+	User::pointer user {User::getById(context.dbSession, context.user.id)};
 	if (!user)
 		throw UserNotAuthorizedError {};
 
@@ -1711,10 +2273,16 @@ handleGetBookmarks(RequestContext& context)
 	Response response {Response::createOkResponse(context)};
 	Response::Node& bookmarksNode {response.createNode("bookmarks")};
 
+	std::vector<Track::pointer> tracks;
+	tracks.reserve(bookmarks.size());
+	for (const TrackBookmark::pointer& bookmark : bookmarks)
+		tracks.push_back(bookmark->getTrack());
+	const TrackNodesInfo tracksInfo {getTrackNodesInfo(context.dbSession, user, tracks)};
+
 	for (const TrackBookmark::pointer& bookmark : bookmarks)
 	{
 		Response::Node bookmarkNode {trackBookmarkToResponseNode(bookmark)};
-		bookmarkNode.addArrayChild("entry", trackToResponseNode(bookmark->getTrack(), context.dbSession, user));
+		bookmarkNode.addArrayChild("entry", trackToResponseNode(bookmark->getTrack(), tracksInfo, user));
 
 		bookmarksNode.addArrayChild("bookmark", std::move(bookmarkNode));
 	}
@@ -1734,24 +2302,23 @@ handleCreateBookmark(RequestContext& context)
 	unsigned long position {getMandatoryParameterAs<unsigned long>(context.parameters, "position")};
 	const std::optional<std::string> comment {getParameterAs<std::string>(context.parameters, "comment")};
 
-	auto transaction {context.dbSession.createUniqueTransaction()};
+	IdType userId {};
+	{
+		auto transaction {context.dbSession.createSharedTransaction()};
 
-	const User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw UserNotAuthorizedError {};
+		const User::pointer user {User::getById(context.dbSession, context.user.id)};
+		if (!user)
+			throw UserNotAuthorizedError {};
 
-	const Track::pointer track {Track::getById(context.dbSession, id.value)};
-	if (!track)
-		throw RequestedDataNotFoundError {};
+		const Track::pointer track {Track::getById(context.dbSession, id.value)};
+		if (!track)
+			throw RequestedDataNotFoundError {};
 
-	// Replace any existing bookmark
-	auto bookmark {TrackBookmark::getByUser(context.dbSession, user, track)};
-	if (!bookmark)
-		bookmark = TrackBookmark::create(context.dbSession, user, track);
+		userId = user.id();
+	}
 
-	bookmark.modify()->setOffset(std::chrono::milliseconds {position});
-	if (comment)
-		bookmark.modify()->setComment(*comment);
+	// Replaces any existing bookmark
+	context.db.getUserStateJournal().setBookmark(userId, id.value, std::chrono::milliseconds {position}, comment);
 
 	return Response::createOkResponse(context);
 }
@@ -1765,21 +2332,25 @@ handleDeleteBookmark(RequestContext& context)
 	if (id.type != Id::Type::Track)
 		throw BadParameterGenericError {"id"};
 
-	auto transaction {context.dbSession.createUniqueTransaction()};
+	IdType userId {};
+	{
+		auto transaction {context.dbSession.createSharedTransaction()};
 
-	const User::pointer user {User::getByLoginName(context.dbSession, context.userName)};
-	if (!user)
-		throw UserNotAuthorizedError {};
+		const User::pointer user {User::getById(context.dbSession, context.user.id)};
+		if (!user)
+			throw UserNotAuthorizedError {};
 
-	const Track::pointer track {Track::getById(context.dbSession, id.value)};
-	if (!track)
-		throw RequestedDataNotFoundError {};
+		const Track::pointer track {Track::getById(context.dbSession, id.value)};
+		if (!track)
+			throw RequestedDataNotFoundError {};
 
-	auto bookmark {TrackBookmark::getByUser(context.dbSession, user, track)};
-	if (!bookmark)
-		throw RequestedDataNotFoundError {};
+		if (!TrackBookmark::getByUser(context.dbSession, user, track))
+			throw RequestedDataNotFoundError {};
+
+		userId = user.id();
+	}
 
-	bookmark.remove();
+	context.db.getUserStateJournal().removeBookmark(userId, id.value);
 
 	return Response::createOkResponse(context);
 }
@@ -1793,7 +2364,7 @@ handleNotImplemented(RequestContext&)
 
 static
 void
-handleGetCoverArt(RequestContext& context, const Wt::Http::Request& /*request*/, Wt::Http::Response& response)
+handleGetCoverArt(RequestContext& context, const Wt::Http::Request& request, Wt::Http::Response& response)
 {
 	// Mandatory params
 	Id id {getMandatoryParameterAs<Id>(context.parameters, "id")};
@@ -1814,17 +2385,54 @@ handleGetCoverArt(RequestContext& context, const Wt::Http::Request& /*request*/,
 			throw BadParameterGenericError {"id"};
 	}
 
+	// Clients must check the cover did not change since the last time
+	if (HttpCache::handleConditionalRequest(request, response, HttpCache::computeETag(cover->getData(), cover->getDataSize()), "private, no-cache"))
+		return;
+
 	response.out().write(reinterpret_cast<const char*>(cover->getData()), cover->getDataSize());
 	response.setMimeType(std::string {cover->getMimeType()});
 }
 
 using RequestHandlerFunc = std::function<Response(RequestContext& context)>;
+// Set for the responses that can be cached until the library changes: returns what they depend on, besides the library
+using ResponseCacheKeyFunc = std::function<std::string(RequestContext& context)>;
 struct RequestEntryPointInfo
 {
 	RequestHandlerFunc	func;
 	bool			mustBeAdmin;
+	ResponseCacheKeyFunc	cacheKeyFunc {};
+	bool			updatesUserState {};	// only queues updates in the user state journal, does not read them
 };
 
+static ResponseCache responseCache;
+
+static
+std::string
+getNoResponseCacheKey(RequestContext&)
+{
+	return {};
+}
+
+static
+std::string
+getArtistsResponseCacheKey(RequestContext& context)
+{
+	// The listing depends on the user settings and on the starred artists
+	auto transaction {context.dbSession.createSharedTransaction()};
+
+	const std::unordered_set<IdType>& starredArtistIdSet {getStarredArtistIds(context)};
+	std::vector<IdType> starredArtistIds {std::cbegin(starredArtistIdSet), std::cend(starredArtistIdSet)};
+	std::sort(std::begin(starredArtistIds), std::end(starredArtistIds));
+
+	std::string starredArtists;
+	for (const IdType starredArtistId : starredArtistIds)
+		starredArtists += std::to_string(starredArtistId) + ",";
+
+	return std::to_string(static_cast<int>(context.user.artistListMode))
+		+ "/" + std::to_string(std::hash<std::string>{}(starredArtists))
+		+ "/" + getParameterAs<std::string>(context.parameters, "ifModifiedSince").value_or("");
+}
+
 static std::unordered_map<std::string, RequestEntryPointInfo> requestEntryPoints
 {
 	// System
@@ -1832,11 +2440,11 @@ static std::unordered_map<std::string, RequestEntryPointInfo> requestEntryPoints
 	{"getLicense",		{handleGetLicenseRequest,		false}},
 
 	// Browsing
-	{"getMusicFolders",	{handleGetMusicFoldersRequest,		false}},
-	{"getIndexes",		{handleGetIndexesRequest,		false}},
+	{"getMusicFolders",	{handleGetMusicFoldersRequest,		false,	getNoResponseCacheKey}},
+	{"getIndexes",		{handleGetIndexesRequest,		false,	getArtistsResponseCacheKey}},
 	{"getMusicDirectory",	{handleGetMusicDirectoryRequest,	false}},
-	{"getGenres",		{handleGetGenresRequest,		false}},
-	{"getArtists",		{handleGetArtistsRequest,		false}},
+	{"getGenres",		{handleGetGenresRequest,		false,	getNoResponseCacheKey}},
+	{"getArtists",		{handleGetArtistsRequest,		false,	getArtistsResponseCacheKey}},
 	{"getArtist",		{handleGetArtistRequest,		false}},
 	{"getAlbum",		{handleGetAlbumRequest,			false}},
 	{"getSong",		{handleNotImplemented,			false}},
@@ -1877,10 +2485,10 @@ static std::unordered_map<std::string, RequestEntryPointInfo> requestEntryPoints
 	{"getAvatar",		{handleNotImplemented,			false}},
 
 	// Media annotation
-	{"star",			{handleStarRequest,				false}},
-	{"unstar",			{handleUnstarRequest,			false}},
+	{"star",			{handleStarRequest,				false,	{},	true}},
+	{"unstar",			{handleUnstarRequest,			false,	{},	true}},
 	{"setRating",		{handleNotImplemented,			false}},
-	{"scrobble",		{handleScrobble,				false}},
+	{"scrobble",		{handleScrobble,				false,	{},	true}},
 
 	// Sharing
 	{"getShares",		{handleNotImplemented,			false}},
@@ -1920,7 +2528,7 @@ static std::unordered_map<std::string, RequestEntryPointInfo> requestEntryPoints
 
 	// Bookmarks
 	{"getBookmarks",	{handleGetBookmarks,			false}},
-	{"createBookmark",	{handleCreateBookmark,			false}},
+	{"createBookmark",	{handleCreateBookmark,			false,	{},	true}},
 	{"deleteBookmark",	{handleDeleteBookmark,			false}},
 	{"getPlayQueue",	{handleNotImplemented,			false}},
 	{"savePlayQueue",	{handleNotImplemented,			false}},
@@ -1936,15 +2544,38 @@ static std::unordered_map<std::string, MediaRetrievalHandlerFunc> mediaRetrieval
 	// Media retrieval
 	{"download",		Stream::handleDownload},
 	{"stream",			Stream::handleStream},
+	{"hls.m3u8",		Stream::handleHls},
 	{"getCoverArt",		handleGetCoverArt},
 };
 
+static
+UserInfo
+getUserInfo(Session& session, const std::string& loginName)
+{
+	auto transaction {session.createSharedTransaction()};
+
+	const User::pointer user {User::getByLoginName(session, loginName)};
+	if (!user)
+		throw UserNotAuthorizedError {};
+
+	return UserInfo {user.id(),
+		user->isAdmin(),
+		user->getSubsonicTranscodeEnable(),
+		user->getSubsonicTranscodeFormat(),
+		user->getSubsonicTranscodeBitrate(),
+		user->getSubsonicArtistListMode()};
+}
+
 void
 SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Response &response)
 {
 	static std::atomic<std::size_t> curRequestId {};
 
+	const SamplingProfiler::ScopedSubsystem profilerSubsystem {SamplingProfiler::Subsystem::Request};
+	// First, so that everything allocated from it while handling the request is released before
+	RequestArena arena;
 	const std::size_t requestId {curRequestId++};
+	const auto requestStart {std::chrono::steady_clock::now()};
 
 	LMS_LOG(API_SUBSONIC, DEBUG) << "Handling request " << requestId << " '" << request.pathInfo() << "', continuation = " << (request.continuation() ? "true" : "false") << ", params = " << parameterMapToDebugString(request.getParameterMap());
 
@@ -1959,15 +2590,30 @@ SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Resp
 
 	std::string clientName;
 
+	// Only the known endpoints are accounted separately
+	const std::string endpoint {requestEntryPoints.find(requestPath) != std::cend(requestEntryPoints) || mediaRetrievalHandlers.find(requestPath) != std::cend(mediaRetrievalHandlers) ? requestPath : "unknown"};
+	RequestStats::Request requestStats;
+	requestStats.error = true;	// until handled
+
+	Tracing::RequestTrace trace {"subsonic/" + endpoint};
+
+	CompressionSettings compression {std::nullopt, _compressionLevel, _compressionThreshold};
+	if (_compressionLevel > 0)
+		compression.encoding = HttpCompression::getAcceptedEncoding(request);
+
 	try
 	{
 		// Mandatory parameters
 		const ClientInfo clientInfo {getClientInfo(parameters)};
 
 		clientName = clientInfo.name;
+		trace.setAttribute("client", clientInfo.name);
+		trace.setAttribute("user", clientInfo.user);
 
 		Session& dbSession {_db.getTLSSession()};
 
+		const auto authStart {std::chrono::steady_clock::now()};
+		std::optional<Tracing::Span> authSpan {std::in_place, "subsonic.auth"};
 		switch (Service<Auth::IPasswordService>::get()->checkUserPassword(dbSession,
 					boost::asio::ip::address::from_string(request.clientAddress()),
 					clientInfo.user, clientInfo.password))
@@ -1979,35 +2625,91 @@ SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Resp
 			case Auth::IPasswordService::PasswordCheckResult::Throttled:
 				throw LoginThrottledGenericError {};
 		}
+		requestStats.authDuration = elapsedSince(authStart);
+		authSpan.reset();
 
-		RequestContext requestContext {parameters, dbSession, clientInfo.user, clientInfo.name};
+		RequestContext requestContext {parameters, dbSession, _db, arena.getResource(), clientInfo.user, clientInfo.name, getUserInfo(dbSession, clientInfo.user)};
 
 		auto itEntryPoint {requestEntryPoints.find(requestPath)};
 		if (itEntryPoint != requestEntryPoints.end())
 		{
-			if (itEntryPoint->second.mustBeAdmin)
+			const auto handlerStart {std::chrono::steady_clock::now()};
+			if (itEntryPoint->second.mustBeAdmin && !requestContext.user.isAdmin)
+				throw UserNotAuthorizedError {};
+
+			// Stars, listens and bookmarks are queued: write the pending ones so that they are visible to this request
+			if (!itEntryPoint->second.updatesUserState)
 			{
-				auto transaction {dbSession.createSharedTransaction()};
+				UserStateJournal& journal {_db.getUserStateJournal()};
+				if (journal.hasPendingUpdates(requestContext.user.id))
+					journal.flush();
+			}
 
-				User::pointer user {User::getByLoginName(dbSession, clientInfo.user)};
-				if (!user || !user->isAdmin())
-					throw UserNotAuthorizedError {};
+			std::optional<std::string> responseCacheKey;
+			std::size_t libraryGeneration {};
+			std::shared_ptr<const ResponseCache::Entry> cachedResponse;
+			if (itEntryPoint->second.cacheKeyFunc)
+			{
+				responseCacheKey = requestPath + "/" + (format == ResponseFormat::json ? "json" : "xml") + "/" + std::to_string(Response::getAPIMinorVersion(clientName))
+					+ "/" + itEntryPoint->second.cacheKeyFunc(requestContext);
+				libraryGeneration = Service<Scanner::IMediaScanner>::get()->getLibraryGeneration();
+				cachedResponse = responseCache.get(*responseCacheKey, libraryGeneration);
 			}
 
-			Response resp {(itEntryPoint->second.func)(requestContext)};
+			if (cachedResponse)
+				trace.setAttribute("cached", "true");
+			else
+			{
+				std::optional<Tracing::Span> handlerSpan {std::in_place, "subsonic.handler"};
+				Response resp {(itEntryPoint->second.func)(requestContext)};
+				handlerSpan.reset();
+
+				if (responseCacheKey)
+				{
+					std::ostringstream oss;
+					resp.write(oss, format);
+					cachedResponse = responseCache.set(*responseCacheKey, libraryGeneration, oss.str());
+				}
+				else
+				{
+					requestStats.handlerDuration = elapsedSince(handlerStart);
+					writeResponse([&](std::ostream& os) { resp.write(os, format); }, format, compression, response, requestStats);
+				}
+			}
 
-			resp.write(response.out(), format);
-			response.setMimeType(ResponseFormatToMimeType(format));
+			if (cachedResponse)
+			{
+				requestStats.handlerDuration = elapsedSince(handlerStart);
+
+				// Strong validators must differ per content coding
+				std::string etag {cachedResponse->etag};
+				if (compression.encoding && cachedResponse->body.size() > compression.threshold)
+					etag = HttpCache::getEncodedETag(etag, HttpCompression::getEncodingName(*compression.encoding));
+
+				// Clients must check the response did not change since the last time
+				if (!HttpCache::handleConditionalRequest(request, response, etag, "private, no-cache"))
+					writeResponse([&](std::ostream& os) { os << cachedResponse->body; }, format, compression, response, requestStats);
+			}
 
 			LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId << " '" << requestPath << "' handled!";
+			requestStats.error = false;
+			requestStats.duration = elapsedSince(requestStart);
+			_requestStats.addRequest(endpoint, requestStats);
 			return;
 		}
 
 		auto itStreamHandler {mediaRetrievalHandlers.find(requestPath)};
 		if (itStreamHandler != mediaRetrievalHandlers.end())
 		{
+			const auto handlerStart {std::chrono::steady_clock::now()};
+			const Tracing::Span handlerSpan {"subsonic.handler"};
 			itStreamHandler->second(requestContext, request, response);
+			requestStats.handlerDuration = elapsedSince(handlerStart);
+
 			LMS_LOG(API_SUBSONIC, DEBUG) << "Request " << requestId  << " '" << requestPath << "' handled!";
+			requestStats.error = false;
+			requestStats.duration = elapsedSince(requestStart);
+			_requestStats.addRequest(endpoint, requestStats);
 			return;
 		}
 
@@ -2019,9 +2721,12 @@ SubsonicResource::handleRequest(const Wt::Http::Request &request, Wt::Http::Resp
 		LMS_LOG(API_SUBSONIC, ERROR) << "Error while processing request '" << requestPath << "'"
 			<< ", params = [" << parameterMapToDebugString(request.getParameterMap()) << "]"
 			<< ", code = " << static_cast<int>(e.getCode()) << ", msg = '" << e.getMessage() << "'";
+		trace.setAttribute("error", std::to_string(static_cast<int>(e.getCode())));
 		Response resp {Response::createFailedResponse(clientName, e)};
-		resp.write(response.out(), format);
-		response.setMimeType(ResponseFormatToMimeType(format));
+		writeResponse([&](std::ostream& os) { resp.write(os, format); }, format, compression, response, requestStats);
+
+		requestStats.duration = elapsedSince(requestStart);
+		_requestStats.addRequest(endpoint, requestStats);
 	}
 }
 
@@ -19,20 +19,198 @@
 
 #include "SubsonicResponse.hpp"
 
-#include <Wt/Json/Array.h>
-#include <Wt/Json/Object.h>
-#include <Wt/Json/Value.h>
-#include <Wt/Json/Serializer.h>
-
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/property_tree/xml_parser.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 
 #include "utils/Exception.hpp"
 #include "utils/String.hpp"
 
+#include "RequestArena.hpp"
+
 namespace API::Subsonic
 {
 
+namespace
+{
+	// Output is gathered in a buffer and written to the stream by large chunks, avoiding the per call stream overhead
+	class OutputBuffer
+	{
+		public:
+			OutputBuffer(std::ostream& os) : _os {os}
+			{
+				_buffer.reserve(_flushThreshold + 1024);
+			}
+
+			~OutputBuffer()
+			{
+				flush();
+			}
+
+			OutputBuffer(const OutputBuffer&) = delete;
+			OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+			void append(char c)
+			{
+				_buffer.push_back(c);
+			}
+
+			void append(std::string_view str)
+			{
+				_buffer.append(str.data(), str.size());
+				if (_buffer.size() >= _flushThreshold)
+					flush();
+			}
+
+			void appendInteger(long long value)
+			{
+				char buffer[24];
+				const std::to_chars_result res {std::to_chars(std::begin(buffer), std::end(buffer), value)};
+				append(std::string_view {buffer, static_cast<std::size_t>(res.ptr - buffer)});
+			}
+
+			void flush()
+			{
+				_os.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+				_buffer.clear();
+			}
+
+		private:
+			static constexpr std::size_t _flushThreshold {64 * 1024};
+
+			std::ostream& _os;
+			std::string _buffer;
+	};
+
+	// Bytes are checked 8 at a time, using plain 64 bit arithmetic
+	constexpr std::uint64_t
+	broadcastByte(unsigned char c)
+	{
+		return 0x0101010101010101ULL * c;
+	}
+
+	// Non zero if one of the bytes of x is less than n, n must not exceed 128
+	constexpr std::uint64_t
+	hasByteLessThan(std::uint64_t x, unsigned char n)
+	{
+		return (x - broadcastByte(n)) & ~x & broadcastByte(0x80);
+	}
+
+	// Non zero if one of the bytes of x is c
+	constexpr std::uint64_t
+	hasByte(std::uint64_t x, unsigned char c)
+	{
+		return hasByteLessThan(x ^ broadcastByte(c), 1);
+	}
+
+	constexpr bool
+	isXMLSpecialChar(char c)
+	{
+		return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+	}
+
+	constexpr bool
+	isJSONSpecialChar(char c)
+	{
+		return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+	}
+
+	// Returns the position of the first char matching isSpecialChar from pos, or the string size
+	// ChunkHasSpecialChar must tell if one of 8 packed chars may match
+	template <typename ChunkHasSpecialChar, typename IsSpecialChar>
+	std::size_t
+	findSpecialChar(std::string_view str, std::size_t pos, ChunkHasSpecialChar chunkHasSpecialChar, IsSpecialChar isSpecialChar)
+	{
+		while (pos + sizeof(std::uint64_t) <= str.size())
+		{
+			std::uint64_t chunk;
+			std::memcpy(&chunk, str.data() + pos, sizeof(chunk));
+			if (chunkHasSpecialChar(chunk))
+				break;
+
+			pos += sizeof(chunk);
+		}
+
+		while (pos < str.size() && !isSpecialChar(str[pos]))
+			pos++;
+
+		return pos;
+	}
+
+	// Clean runs are copied in bulk, only special chars are handled one by one
+	template <typename ChunkHasSpecialChar, typename IsSpecialChar, typename WriteSpecialChar>
+	void
+	writeEscaped(OutputBuffer& output, std::string_view str, ChunkHasSpecialChar chunkHasSpecialChar, IsSpecialChar isSpecialChar, WriteSpecialChar writeSpecialChar)
+	{
+		std::size_t pos {};
+		while (pos < str.size())
+		{
+			const std::size_t specialCharPos {findSpecialChar(str, pos, chunkHasSpecialChar, isSpecialChar)};
+			output.append(str.substr(pos, specialCharPos - pos));
+			if (specialCharPos == str.size())
+				break;
+
+			writeSpecialChar(str[specialCharPos]);
+			pos = specialCharPos + 1;
+		}
+	}
+
+	void
+	writeXMLEscaped(OutputBuffer& output, std::string_view str)
+	{
+		auto chunkHasSpecialChar {[](std::uint64_t chunk)
+		{
+			return hasByte(chunk, '&') || hasByte(chunk, '<') || hasByte(chunk, '>') || hasByte(chunk, '"') || hasByte(chunk, '\'');
+		}};
+
+		writeEscaped(output, str, chunkHasSpecialChar, isXMLSpecialChar, [&](char c)
+		{
+			switch (c)
+			{
+				case '&': output.append("&amp;"); break;
+				case '<': output.append("&lt;"); break;
+				case '>': output.append("&gt;"); break;
+				case '"': output.append("&quot;"); break;
+				case '\'': output.append("&apos;"); break;
+			}
+		});
+	}
+
+	void
+	writeJSONString(OutputBuffer& output, std::string_view str)
+	{
+		auto chunkHasSpecialChar {[](std::uint64_t chunk)
+		{
+			return hasByte(chunk, '"') || hasByte(chunk, '\\') || hasByteLessThan(chunk, 0x20);
+		}};
+
+		output.append('"');
+		writeEscaped(output, str, chunkHasSpecialChar, isJSONSpecialChar, [&](char c)
+		{
+			switch (c)
+			{
+				case '"': output.append("\\\""); break;
+				case '\\': output.append("\\\\"); break;
+				case '\b': output.append("\\b"); break;
+				case '\f': output.append("\\f"); break;
+				case '\n': output.append("\\n"); break;
+				case '\r': output.append("\\r"); break;
+				case '\t': output.append("\\t"); break;
+				default:
+				{
+					constexpr std::string_view hexDigits {"0123456789abcdef"};
+					const unsigned char value {static_cast<unsigned char>(c)};
+					const char escaped[] {'\\', 'u', '0', '0', hexDigits[value >> 4], hexDigits[value & 0xF]};
+					output.append(std::string_view {escaped, sizeof(escaped)});
+				}
+			}
+		});
+		output.append('"');
+	}
+}
+
 std::string
 ResponseFormatToMimeType(ResponseFormat format)
 {
@@ -45,13 +223,20 @@ ResponseFormatToMimeType(ResponseFormat format)
 	return "";
 }
 
+Response::Node::Node()
+: _attributes {RequestArena::getCurrentResource()}
+, _children {RequestArena::getCurrentResource()}
+, _childrenArrays {RequestArena::getCurrentResource()}
+{
+}
+
 void
 Response::Node::setValue(std::string_view value)
 {
 	if (!_children.empty() || !_childrenArrays.empty())
 		throw LmsException {"Node already has children"};
 
-	_value = std::string {value};
+	_value = std::pmr::string {value, getMemoryResource()};
 }
 
 void
@@ -66,7 +251,21 @@ Response::Node::setValue(long long value)
 void
 Response::Node::setAttribute(std::string_view key, std::string_view value)
 {
-	_attributes[std::string {key}] = std::string {value};
+	setAttributeValue(key, std::pmr::string {value, getMemoryResource()});
+}
+
+void
+Response::Node::setAttributeValue(std::string_view key, Value value)
+{
+	auto it {std::find_if(std::begin(_attributes), std::end(_attributes), [&](const auto& attribute) { return attribute.first == key; })};
+	if (it != std::end(_attributes))
+		it->second = std::move(value);
+	else
+	{
+		if (_attributes.empty())
+			_attributes.reserve(16); // enough for most entries (songs, albums)
+		_attributes.emplace_back(key, std::move(value));
+	}
 }
 
 void
@@ -165,53 +364,69 @@ Response::write(std::ostream& os, ResponseFormat format)
 void
 Response::writeXML(std::ostream& os)
 {
-	std::function<boost::property_tree::ptree(const Response::Node&)> nodeToPropertyTree = [&] (const Response::Node& node)
-	{
-		boost::property_tree::ptree res;
+	OutputBuffer output {os};
 
-		for (auto itAttribute : node._attributes)
+	auto writeValue {[&](const Node::Value& value)
+	{
+		if (std::holds_alternative<std::pmr::string>(value))
+			writeXMLEscaped(output, std::get<std::pmr::string>(value));
+		else if (std::holds_alternative<bool>(value))
+			output.append(std::get<bool>(value) ? "true" : "false");
+		else if (std::holds_alternative<long long>(value))
+			output.appendInteger(std::get<long long>(value));
+	}};
+
+	std::function<void(const std::string&, const Response::Node&)> writeNode = [&] (const std::string& key, const Response::Node& node)
+	{
+		output.append('<');
+		output.append(key);
+		for (const auto& [name, value] : node._attributes)
 		{
-			if (std::holds_alternative<std::string>(itAttribute.second))
-				res.put("<xmlattr>." + itAttribute.first, std::get<std::string>(itAttribute.second));
-			else if (std::holds_alternative<bool>(itAttribute.second))
-				res.put("<xmlattr>." + itAttribute.first, std::get<bool>(itAttribute.second));
-			else if (std::holds_alternative<long long>(itAttribute.second))
-				res.put("<xmlattr>." + itAttribute.first, std::get<long long>(itAttribute.second));
+			output.append(' ');
+			output.append(name);
+			output.append("=\"");
+			writeValue(value);
+			output.append('"');
 		}
 
 		if (node._value)
 		{
-			const auto& value {*node._value};
-
-			if (std::holds_alternative<std::string>(value))
-				res.put_value(std::get<std::string>(value));
-			else if (std::holds_alternative<bool>(value))
-				res.put_value(std::get<bool>(value));
-			else if (std::holds_alternative<long long>(value))
-				res.put_value(std::get<long long>(value));
+			output.append('>');
+			writeValue(*node._value);
+			output.append("</");
+			output.append(key);
+			output.append('>');
+			return;
 		}
-		else
-		{
-			for (auto itChildNode : node._children)
-			{
-				for (const Response::Node& childNode : itChildNode.second)
-					res.add_child(itChildNode.first, nodeToPropertyTree(childNode));
-			}
-
-			for (auto itChildArrayNode : node._childrenArrays)
-			{
-				const std::vector<Response::Node>& childArrayNodes {itChildArrayNode.second};
 
-				for (const Response::Node& childNode : childArrayNodes )
-					res.add_child(itChildArrayNode.first, nodeToPropertyTree(childNode));
-			}
+		if (node._children.empty() && node._childrenArrays.empty())
+		{
+			output.append("/>");
+			return;
 		}
 
-		return res;
+		output.append('>');
+		for (const auto& [childKey, childNodes] : node._children)
+		{
+			for (const Response::Node& childNode : childNodes)
+				writeNode(childKey, childNode);
+		}
+		for (const auto& [childKey, childNodes] : node._childrenArrays)
+		{
+			for (const Response::Node& childNode : childNodes)
+				writeNode(childKey, childNode);
+		}
+		output.append("</");
+		output.append(key);
+		output.append('>');
 	};
 
-	boost::property_tree::ptree root {nodeToPropertyTree(_root)};
-	boost::property_tree::write_xml(os, root);
+	output.append("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+	for (const auto& [key, nodes] : _root._children)
+	{
+		for (const Response::Node& node : nodes)
+			writeNode(key, node);
+	}
 }
 
 unsigned
@@ -229,56 +444,72 @@ Response::getAPIMinorVersion(std::string_view clientName)
 void
 Response::writeJSON(std::ostream& os)
 {
-	namespace Json = Wt::Json;
+	OutputBuffer output {os};
 
-	std::function<Json::Object(const Response::Node&)> nodeToJsonObject = [&] (const Response::Node& node)
+	auto writeValue {[&](const Node::Value& value)
 	{
-		Json::Object res;
-
-		auto valueToJsonValue {[](const Node::Value& value) -> Json::Value
+		if (std::holds_alternative<std::pmr::string>(value))
+			writeJSONString(output, std::get<std::pmr::string>(value));
+		else if (std::holds_alternative<bool>(value))
+			output.append(std::get<bool>(value) ? "true" : "false");
+		else if (std::holds_alternative<long long>(value))
+			output.appendInteger(std::get<long long>(value));
+	}};
+
+	std::function<void(const Response::Node&)> writeObject = [&] (const Response::Node& node)
+	{
+		bool first {true};
+		auto writeKey {[&](std::string_view key)
 		{
-			if (std::holds_alternative<std::string>(value))
-				return Json::Value {std::get<std::string>(value)};
-			else if (std::holds_alternative<bool>(value))
-				return Json::Value {std::get<bool>(value)};
-			else if (std::holds_alternative<long long>(value))
-				return Json::Value {std::get<long long>(value)};
-
-			throw LmsException("Unexpected value type");
+			if (!first)
+				output.append(',');
+			first = false;
+
+			writeJSONString(output, key);
+			output.append(':');
 		}};
 
-		for (auto itAttribute : node._attributes)
-			res[itAttribute.first] = valueToJsonValue(itAttribute.second);
+		output.append('{');
+		for (const auto& [name, value] : node._attributes)
+		{
+			writeKey(name);
+			writeValue(value);
+		}
 
 		if (node._value)
 		{
-			res["value"] = valueToJsonValue(*node._value);
+			writeKey("value");
+			writeValue(*node._value);
 		}
 		else
 		{
-			for (auto itChildNode : node._children)
+			// A key can only appear once in an object: the last child wins
+			for (const auto& [childKey, childNodes] : node._children)
 			{
-				for (const Response::Node& childNode : itChildNode.second)
-					res[itChildNode.first] = nodeToJsonObject(childNode);
+				if (childNodes.empty())
+					continue;
+
+				writeKey(childKey);
+				writeObject(childNodes.back());
 			}
 
-			for (auto itChildArrayNode : node._childrenArrays)
+			for (const auto& [childKey, childNodes] : node._childrenArrays)
 			{
-				const std::vector<Response::Node>& childArrayNodes {itChildArrayNode .second};
-
-				Json::Array array;
-				for (const Response::Node& childNode : childArrayNodes )
-					array.emplace_back(nodeToJsonObject(childNode));
-
-				res[itChildArrayNode.first] = std::move(array);
+				writeKey(childKey);
+				output.append('[');
+				for (std::size_t i {}; i < childNodes.size(); ++i)
+				{
+					if (i > 0)
+						output.append(',');
+					writeObject(childNodes[i]);
+				}
+				output.append(']');
 			}
 		}
-
-		return res;
+		output.append('}');
 	};
 
-	Json::Object root {nodeToJsonObject(_root)};
-	os << Json::serialize(root);
+	writeObject(_root);
 }
 
 } // namespace
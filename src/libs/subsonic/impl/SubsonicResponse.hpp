@@ -19,9 +19,12 @@
 #pragma once
 
 #include <map>
+#include <memory_resource>
 #include <optional>
+#include <ostream>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -182,18 +185,22 @@ class BadParameterFormatGenericError : public GenericError
 class Response
 {
 	public:
+		// Nodes and their values are allocated using the arena of the request being handled when created (see RequestArena), if any
 		class Node
 		{
 			public:
+				Node();
+
+				// Attribute keys are not copied: they must outlive the response (string literals)
 				void setAttribute(std::string_view key, std::string_view value);
 
 				template <typename T, std::enable_if_t<std::is_arithmetic<T>::value>* = nullptr>
 				void setAttribute(std::string_view key, T value)
 				{
 					if constexpr (std::is_same<bool, T>::value)
-						_attributes[std::string {key}] = value;
+						setAttributeValue(key, value);
 					else
-						_attributes[std::string {key}] = static_cast<long long>(value);
+						setAttributeValue(key, static_cast<long long>(value));
 				}
 
 				// A Node has either a value or some children
@@ -207,11 +214,15 @@ class Response
 
 			private:
 				friend class Response;
-				using Value = std::variant<std::string, bool, long long>;
-				std::map<std::string, Value> _attributes;
+				using Value = std::variant<std::pmr::string, bool, long long>;
+				void setAttributeValue(std::string_view key, Value value);
+				std::pmr::memory_resource* getMemoryResource() const { return _attributes.get_allocator().resource(); }
+
+				// Few attributes per node: flat storage, in insertion order
+				std::pmr::vector<std::pair<std::string_view, Value>> _attributes;
 				std::optional<Value> _value;
-				std::map<std::string, std::vector<Node>> _children;
-				std::map<std::string, std::vector<Node>> _childrenArrays;
+				std::pmr::map<std::string, std::pmr::vector<Node>> _children;
+				std::pmr::map<std::string, std::pmr::vector<Node>> _childrenArrays;
 		};
 
 		static Response createOkResponse(const RequestContext& context);
@@ -232,6 +243,7 @@ class Response
 		static unsigned getAPIMinorVersion(std::string_view clientName);
 	private:
 
+		// Directly written to the output stream, without building an intermediate document
 		void writeJSON(std::ostream& os);
 		void writeXML(std::ostream& os);
 
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace API::Subsonic
+{
+
+// Collects the count, errors, latencies and response sizes of the requests, by endpoint
+// Thread safe
+class RequestStats
+{
+	public:
+		// Upper bounds of the latency histogram buckets
+		static constexpr std::array<std::chrono::milliseconds, 11> latencyBuckets {
+			std::chrono::milliseconds {5}, std::chrono::milliseconds {10}, std::chrono::milliseconds {25}, std::chrono::milliseconds {50},
+			std::chrono::milliseconds {100}, std::chrono::milliseconds {250}, std::chrono::milliseconds {500}, std::chrono::milliseconds {1000},
+			std::chrono::milliseconds {2500}, std::chrono::milliseconds {5000}, std::chrono::milliseconds {10000},
+		};
+
+		struct Request
+		{
+			bool						error {};
+			std::size_t					responseBytes {};	// serialized API responses only
+			std::chrono::microseconds	duration {};
+			std::chrono::microseconds	authDuration {};
+			std::chrono::microseconds	handlerDuration {};	// includes the database queries
+			std::chrono::microseconds	serializationDuration {};
+		};
+
+		struct EndpointStats
+		{
+			std::size_t					count {};
+			std::size_t					errorCount {};
+			std::size_t					responseBytes {};
+			std::chrono::microseconds	totalDuration {};
+			std::chrono::microseconds	totalAuthDuration {};
+			std::chrono::microseconds	totalHandlerDuration {};
+			std::chrono::microseconds	totalSerializationDuration {};
+			std::array<std::size_t, latencyBuckets.size()> latencyBucketCounts {};	// not cumulative, slower requests are only in count
+		};
+
+		using Snapshot = std::map<std::string, EndpointStats>; // by endpoint
+
+		RequestStats() = default;
+		RequestStats(const RequestStats&) = delete;
+		RequestStats(RequestStats&&) = delete;
+		RequestStats& operator=(const RequestStats&) = delete;
+		RequestStats& operator=(RequestStats&&) = delete;
+
+		void addRequest(const std::string& endpoint, const Request& request);
+
+		Snapshot getSnapshot() const;
+
+	private:
+		mutable std::mutex	_mutex;
+		Snapshot			_stats;
+};
+
+} // namespace API::Subsonic
+
@@ -21,6 +21,8 @@
 #include <Wt/WResource.h>
 #include <Wt/Http/Response.h>
 
+#include "subsonic/RequestStats.hpp"
+
 namespace Database
 {
 	class Db;
@@ -35,11 +37,17 @@ class SubsonicResource final : public Wt::WResource
 		SubsonicResource(Database::Db& db);
 
 		static std::string getPath() { return "rest/"; }
+
+		const RequestStats& getRequestStats() const { return _requestStats; }
+
 	private:
 
 		void handleRequest(const Wt::Http::Request &request, Wt::Http::Response &response) override;
 
 		Database::Db& _db;
+		const int _compressionLevel;
+		const std::size_t _compressionThreshold;
+		RequestStats _requestStats;
 };
 
 } // namespace
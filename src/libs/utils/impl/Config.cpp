@@ -28,10 +28,32 @@ std::unique_ptr<IConfig> createConfig(const std::filesystem::path& p)
 }
 
 Config::Config(const std::filesystem::path& p)
+: _path {p}
+, _config {readFile(p)}
 {
+}
+
+void
+Config::reload()
+{
+	std::unique_ptr<libconfig::Config> config {readFile(_path)};
+
+	{
+		std::unique_lock lock {_mutex};
+		_config.swap(config);
+	}
+
+	LMS_LOG(MAIN, INFO) << "Reloaded config file '" << _path.string() << "'";
+}
+
+std::unique_ptr<libconfig::Config>
+Config::readFile(const std::filesystem::path& p)
+{
+	auto config {std::make_unique<libconfig::Config>()};
+
 	try
 	{
-		_config.readFile(p.string().c_str());
+		config->readFile(p.string().c_str());
 	}
 	catch( libconfig::FileIOException& e)
 	{
@@ -45,13 +67,17 @@ Config::Config(const std::filesystem::path& p)
 	{
 		throw LmsException {"Cannot open config file '" + p.string() + "': " + e.what()};
 	}
+
+	return config;
 }
 
 std::string
 Config::getString(const std::string& setting, const std::string& def, const std::unordered_set<std::string>& allowedValues)
 {
+	std::shared_lock lock {_mutex};
+
 	try {
-		std::string res {(const char*)_config.lookup(setting)};
+		std::string res {(const char*)_config->lookup(setting)};
 
 		if (!allowedValues.empty() && allowedValues.find(res) == std::cend(allowedValues))
 		{
@@ -70,8 +96,10 @@ Config::getString(const std::string& setting, const std::string& def, const std:
 std::filesystem::path
 Config::getPath(const std::string& setting, const std::filesystem::path& path)
 {
+	std::shared_lock lock {_mutex};
+
 	try {
-		const char* res = _config.lookup(setting);
+		const char* res = _config->lookup(setting);
 		return std::filesystem::path {std::string(res)};
 	}
 	catch (std::exception &e)
@@ -83,8 +111,10 @@ Config::getPath(const std::string& setting, const std::filesystem::path& path)
 unsigned long
 Config::getULong(const std::string& setting, unsigned long def)
 {
+	std::shared_lock lock {_mutex};
+
 	try {
-		return static_cast<unsigned int>(_config.lookup(setting));
+		return static_cast<unsigned int>(_config->lookup(setting));
 	}
 	catch (...)
 	{
@@ -95,8 +125,10 @@ Config::getULong(const std::string& setting, unsigned long def)
 long
 Config::getLong(const std::string& setting, long def)
 {
+	std::shared_lock lock {_mutex};
+
 	try {
-		return _config.lookup(setting);
+		return _config->lookup(setting);
 	}
 	catch (...)
 	{
@@ -107,8 +139,10 @@ Config::getLong(const std::string& setting, long def)
 bool
 Config::getBool(const std::string& setting, bool def)
 {
+	std::shared_lock lock {_mutex};
+
 	try {
-		return _config.lookup(setting);
+		return _config->lookup(setting);
 	}
 	catch (...)
 	{
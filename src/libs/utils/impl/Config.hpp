@@ -20,6 +20,9 @@
 
 #include "utils/IConfig.hpp"
 
+#include <memory>
+#include <shared_mutex>
+
 #include <libconfig.h++>
 
 // Used to get config values from configuration files
@@ -40,9 +43,13 @@ class Config final : public IConfig
 		unsigned long	getULong(const std::string& setting, unsigned long def = 0) override;
 		long		getLong(const std::string& setting, long def = 0) override;
 		bool		getBool(const std::string& setting, bool def = false) override;
+		void		reload() override;
 
 	private:
+		static std::unique_ptr<libconfig::Config> readFile(const std::filesystem::path& p);
 
-		libconfig::Config _config;
+		const std::filesystem::path			_path;
+		std::shared_mutex					_mutex;	// lookups are done while the file may be reloaded
+		std::unique_ptr<libconfig::Config>	_config;
 };
 
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/CpuAffinity.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+
+#include "utils/Exception.hpp"
+#include "utils/Logger.hpp"
+#include "utils/String.hpp"
+
+namespace CpuAffinity
+{
+
+namespace {
+
+	std::optional<unsigned>
+	readCpuIndex(std::string_view str)
+	{
+		str = StringUtils::stringTrimView(str);
+		if (str.empty() || str.find_first_not_of("0123456789") != std::string_view::npos)
+			return std::nullopt;
+
+		const std::optional<unsigned> index {StringUtils::readAs<unsigned>(str)};
+		if (!index || *index >= CPU_SETSIZE)
+			return std::nullopt;
+
+		return index;
+	}
+
+	std::optional<CpuSet>
+	getCurrentThreadAffinity()
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (const int res {::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set)}; res != 0)
+		{
+			LMS_LOG(UTILS, ERROR) << "Cannot get thread CPU affinity: " << ::strerror(res);
+			return std::nullopt;
+		}
+
+		CpuSet cpuSet;
+		for (unsigned cpu {}; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &set))
+				cpuSet.push_back(cpu);
+		}
+
+		return cpuSet;
+	}
+
+} // namespace
+
+CpuSet
+parseCpuSet(std::string_view str)
+{
+	CpuSet cpuSet;
+
+	for (const std::string_view range : StringUtils::splitStringViews(str, ","))
+	{
+		if (StringUtils::stringTrimView(range).empty())
+			continue;
+
+		const std::size_t separator {range.find('-')};
+		const std::optional<unsigned> first {readCpuIndex(range.substr(0, separator))};
+		const std::optional<unsigned> last {separator == std::string_view::npos ? first : readCpuIndex(range.substr(separator + 1))};
+		if (!first || !last || *first > *last)
+			throw LmsException {"Invalid CPU set '" + std::string {str} + "'"};
+
+		for (unsigned cpu {*first}; cpu <= *last; ++cpu)
+			cpuSet.push_back(cpu);
+	}
+
+	std::sort(std::begin(cpuSet), std::end(cpuSet));
+	cpuSet.erase(std::unique(std::begin(cpuSet), std::end(cpuSet)), std::end(cpuSet));
+
+	return cpuSet;
+}
+
+void
+setCurrentThreadAffinity(const CpuSet& cpuSet)
+{
+	if (cpuSet.empty())
+		return;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const unsigned cpu : cpuSet)
+		CPU_SET(cpu, &set);
+
+	// Fails if none of the CPUs is online
+	if (const int res {::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set)}; res != 0)
+		LMS_LOG(UTILS, ERROR) << "Cannot set thread CPU affinity: " << ::strerror(res);
+}
+
+ScopedAffinity::ScopedAffinity(const CpuSet& cpuSet)
+{
+	if (cpuSet.empty())
+		return;
+
+	if (std::optional<CpuSet> previousCpuSet {getCurrentThreadAffinity()})
+	{
+		_previousCpuSet = std::move(*previousCpuSet);
+		setCurrentThreadAffinity(cpuSet);
+	}
+}
+
+ScopedAffinity::~ScopedAffinity()
+{
+	setCurrentThreadAffinity(_previousCpuSet);
+}
+
+} // namespace CpuAffinity
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Executor.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include "utils/Logger.hpp"
+
+Executor::Executor(std::size_t threadCount, const std::string& name, const CpuAffinity::CpuSet& cpuSet)
+: _name {name}
+, _cpuSet {cpuSet}
+{
+	setThreadCount(threadCount);
+}
+
+Executor::~Executor()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+		_tasks.clear();
+	}
+	_condition.notify_all();
+
+	for (std::thread& thread : _threads)
+		thread.join();
+}
+
+void
+Executor::setThreadCount(std::size_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+	std::vector<std::thread> stoppedThreads;
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (_threadCount == threadCount)
+			return;
+
+		LMS_LOG(UTILS, INFO) << "Using " << threadCount << " thread(s) for the " << _name << " executor";
+		_threadCount = threadCount;
+
+		// Threads stopped by a previous call
+		for (auto it {std::begin(_threads)}; it != std::end(_threads); )
+		{
+			if (std::find(std::cbegin(_stoppedThreadIds), std::cend(_stoppedThreadIds), it->get_id()) != std::cend(_stoppedThreadIds))
+			{
+				stoppedThreads.push_back(std::move(*it));
+				it = _threads.erase(it);
+			}
+			else
+				++it;
+		}
+		_stoppedThreadIds.clear();
+
+		for (; _runningThreadCount < threadCount; ++_runningThreadCount)
+		{
+			_threads.emplace_back([this]
+			{
+				CpuAffinity::setCurrentThreadAffinity(_cpuSet);
+				threadLoop();
+			});
+		}
+	}
+	_condition.notify_all();
+
+	for (std::thread& thread : stoppedThreads)
+		thread.join();
+}
+
+void
+Executor::post(Task task)
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_tasks.push_back(std::move(task));
+	}
+
+	_condition.notify_one();
+}
+
+void
+Executor::threadLoop()
+{
+	while (true)
+	{
+		Task task;
+
+		{
+			std::unique_lock lock {_mutex};
+
+			_condition.wait(lock, [&] { return _quit || _runningThreadCount > _threadCount || !_tasks.empty(); });
+			if (_quit)
+				return;
+
+			if (_runningThreadCount > _threadCount)
+			{
+				_runningThreadCount--;
+				_stoppedThreadIds.push_back(std::this_thread::get_id());
+				return;
+			}
+
+			task = std::move(_tasks.front());
+			_tasks.pop_front();
+		}
+
+		try
+		{
+			task();
+		}
+		catch (std::exception& e)
+		{
+			LMS_LOG(UTILS, ERROR) << "Caught exception in executor task: " << e.what();
+		}
+	}
+}
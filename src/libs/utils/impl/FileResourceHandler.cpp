@@ -19,9 +19,18 @@
 
 #include "FileResourceHandler.hpp"
 
-#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "utils/Executor.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 
 std::unique_ptr<IResourceHandler>
 createFileResourceHandler(const std::filesystem::path& path)
@@ -35,30 +44,42 @@ FileResourceHandler::FileResourceHandler(const std::filesystem::path& path)
 {
 }
 
+FileResourceHandler::~FileResourceHandler() = default;
+
+FileResourceHandler::ReadState::~ReadState()
+{
+	if (fd >= 0)
+		::close(fd);
+}
 
 void
 FileResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 {
-	::uint64_t startByte {_offset};
-	std::ifstream ifs {_path.string().c_str(), std::ios::in | std::ios::binary};
-
-	if (startByte == 0)
+	if (_readState->fd < 0)
 	{
-		if (!ifs)
+		::uint64_t startByte {};
+
+		_readState->fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (_readState->fd < 0)
 		{
-			LMS_LOG(UTILS, ERROR) << "Cannot open file stream for '" << _path.string() << "'";
+			LMS_LOG(UTILS, ERROR) << "Cannot open file '" << _path.string() << "': " << ::strerror(errno);
 			response.setStatus(404);
 			_isFinished = true;
 			return;
 		}
-		else
+
+		struct ::stat fileStat;
+		if (::fstat(_readState->fd, &fileStat) != 0)
 		{
-			response.setStatus(200);
+			LMS_LOG(UTILS, ERROR) << "Cannot stat file '" << _path.string() << "': " << ::strerror(errno);
+			response.setStatus(404);
+			_isFinished = true;
+			return;
 		}
 
-		ifs.seekg(0, std::ios::end);
-		const ::uint64_t fileSize {static_cast<::uint64_t>(ifs.tellg())};
-		ifs.seekg(0, std::ios::beg);
+		response.setStatus(200);
+
+		const ::uint64_t fileSize {static_cast<::uint64_t>(fileStat.st_size)};
 
 		LMS_LOG(UTILS, DEBUG) << "File '" << _path.string() << "', fileSize = " << fileSize;
 
@@ -97,33 +118,115 @@ FileResourceHandler::processRequest(const Wt::Http::Request& request, Wt::Http::
 			_beyondLastByte = fileSize;
 			response.setContentLength(_beyondLastByte);
 		}
+
+		// The file is read sequentially: let the kernel read ahead more aggressively
+		::posix_fadvise(_readState->fd, startByte, _beyondLastByte - startByte, POSIX_FADV_SEQUENTIAL);
+
+		_offset = startByte;
 	}
-	else if (!ifs)
+
+	MediaIOExecutor* executor {Service<MediaIOExecutor>::get()};
+	if (!executor)
 	{
-		LMS_LOG(UTILS, ERROR) << "Cannot reopen file stream for '" << _path.string() << "'";
-		_isFinished = true;
+		// No executor: read from this server thread
+		std::vector<char>& buffer {_readState->buffer};
+		buffer.resize(std::min<::uint64_t>(_chunkSize, _beyondLastByte - _offset));
+
+		ssize_t readSize;
+		do
+		{
+			readSize = ::pread(_readState->fd, buffer.data(), buffer.size(), _offset);
+		}
+		while (readSize < 0 && errno == EINTR);
+
+		writeChunk(response, buffer.data(), readSize, readSize < 0 ? errno : 0);
+		if (!_isFinished)
+		{
+			// Start reading the next chunk while this one is being sent
+			::posix_fadvise(_readState->fd, _offset, _chunkSize, POSIX_FADV_WILLNEED);
+		}
 		return;
 	}
 
-	ifs.seekg(static_cast<std::istream::pos_type>(startByte));
+	if (!_readStarted)
+	{
+		// Nothing to write yet, the caller has to wait for the data
+		startRead(*executor);
+		return;
+	}
 
-	std::vector<char> buf;
-	buf.resize(_chunkSize);
+	{
+		std::scoped_lock lock {_readState->mutex};
+		if (_readState->readPending)
+			return;
+	}
 
-	::uint64_t restSize = _beyondLastByte - startByte;
-	::uint64_t pieceSize = buf.size() > restSize ? restSize : buf.size();
+	_readStarted = false;
+	writeChunk(response, _readState->buffer.data(), _readState->readSize, _readState->readErrno);
+
+	// Read the next chunk while this one is being sent
+	if (!_isFinished)
+		startRead(*executor);
+}
 
-	ifs.read(&buf[0], pieceSize);
-	const ::uint64_t actualPieceSize {static_cast<::uint64_t>(ifs.gcount())};
-	response.out().write(&buf[0], actualPieceSize);
+void
+FileResourceHandler::startRead(MediaIOExecutor& executor)
+{
+	const ::uint64_t pieceSize {std::min<::uint64_t>(_chunkSize, _beyondLastByte - _offset)};
+
+	{
+		std::scoped_lock lock {_readState->mutex};
+		_readState->readPending = true;
+	}
+	_readStarted = true;
+
+	executor.post([state = _readState, offset = _offset, pieceSize]
+	{
+		state->buffer.resize(pieceSize);
+
+		ssize_t readSize;
+		do
+		{
+			readSize = ::pread(state->fd, state->buffer.data(), pieceSize, offset);
+		}
+		while (readSize < 0 && errno == EINTR);
+		const int readErrno {readSize < 0 ? errno : 0};
+
+		std::function<void()> callback;
+		{
+			std::scoped_lock lock {state->mutex};
+
+			state->readSize = readSize;
+			state->readErrno = readErrno;
+			state->readPending = false;
+			callback.swap(state->callback);
+		}
+
+		if (callback)
+			callback();
+	});
+}
+
+void
+FileResourceHandler::writeChunk(Wt::Http::Response& response, const char* data, ssize_t readSize, int readErrno)
+{
+	if (readSize < 0)
+	{
+		LMS_LOG(UTILS, ERROR) << "Cannot read file '" << _path.string() << "': " << ::strerror(readErrno);
+		_isFinished = true;
+		return;
+	}
+
+	const ::uint64_t restSize {_beyondLastByte - _offset};
+	const ::uint64_t actualPieceSize {static_cast<::uint64_t>(readSize)};
+	response.out().write(data, actualPieceSize);
 
 	LMS_LOG(UTILS, DEBUG) << "Written " << actualPieceSize << " bytes";
 
 	LMS_LOG(UTILS, DEBUG) << "Progress: " << actualPieceSize << "/" << restSize;
-	if (ifs.good() && actualPieceSize < restSize)
+	if (actualPieceSize > 0 && actualPieceSize < restSize)
 	{
-		_offset = startByte + actualPieceSize;
-
+		_offset += actualPieceSize;
 		LMS_LOG(UTILS, DEBUG) << "Job not complete! Next chunk offset = " << _offset;
 	}
 	else
@@ -139,4 +242,25 @@ FileResourceHandler::isFinished() const
 	return _isFinished;
 }
 
+bool
+FileResourceHandler::isWaitingForData() const
+{
+	std::scoped_lock lock {_readState->mutex};
+	return _readState->readPending;
+}
+
+void
+FileResourceHandler::notifyWhenDataAvailable(std::function<void()> callback)
+{
+	{
+		std::scoped_lock lock {_readState->mutex};
+		if (_readState->readPending)
+		{
+			_readState->callback = std::move(callback);
+			return;
+		}
+	}
 
+	// Read already done
+	callback();
+}
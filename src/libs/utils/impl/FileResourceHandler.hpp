@@ -20,24 +20,60 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils/ActiveStreamCounter.hpp"
 #include "utils/IResourceHandler.hpp"
 
+class MediaIOExecutor;
+
 class FileResourceHandler final : public IResourceHandler
 {
 	public:
 		FileResourceHandler(const std::filesystem::path& filePath);
+		~FileResourceHandler();
+
+		FileResourceHandler(const FileResourceHandler&) = delete;
+		FileResourceHandler(FileResourceHandler&&) = delete;
+		FileResourceHandler& operator=(const FileResourceHandler&) = delete;
+		FileResourceHandler& operator=(FileResourceHandler&&) = delete;
 
 	private:
 
 		void processRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
 		bool isFinished() const override;
+		bool isWaitingForData() const override;
+		void notifyWhenDataAvailable(std::function<void()> callback) override;
+
+		void startRead(MediaIOExecutor& executor);
+		void writeChunk(Wt::Http::Response& response, const char* data, ssize_t readSize, int readErrno);
 
 		static constexpr std::size_t _chunkSize {262144};
 
+		// Shared with the read tasks, that may outlive the handler
+		struct ReadState
+		{
+			~ReadState();
+
+			int						fd {-1}; // kept open by all the continuations
+			std::mutex				mutex;
+			bool					readPending {};
+			std::function<void()>	callback; // called once the pending read is done
+			std::vector<char>		buffer; // reused by all the continuations, only accessed by the read task while a read is pending
+			ssize_t					readSize {};
+			int						readErrno {};
+		};
+
 		std::filesystem::path	_path;
+		std::shared_ptr<ReadState>	_readState {std::make_shared<ReadState>()};
 		::uint64_t		_beyondLastByte {};
 		::uint64_t		_offset {};
+		bool			_readStarted {}; // a read of the chunk at _offset has been posted and not consumed yet
 		bool			_isFinished {};
+		ActiveStreamCounter	_activeStreamCounter;
 
 };
 
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/HttpCache.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+
+#include "utils/Crc32Calculator.hpp"
+#include "utils/String.hpp"
+
+namespace HttpCache {
+
+std::string
+computeETag(const std::byte* data, std::size_t dataSize)
+{
+	Utils::Crc32Calculator crc32;
+	crc32.processBytes(data, dataSize);
+
+	std::ostringstream oss;
+	oss << "\"" << std::hex << dataSize << "-" << std::setw(8) << std::setfill('0') << crc32.getResult() << "\"";
+
+	return oss.str();
+}
+
+std::string
+getEncodedETag(const std::string& etag, std::string_view encodingName)
+{
+	// Inside the quotes
+	std::string res {etag, 0, etag.size() - 1};
+	res += "-";
+	res += encodingName;
+	res += "\"";
+
+	return res;
+}
+
+bool
+handleConditionalRequest(const Wt::Http::Request& request, Wt::Http::Response& response, const std::string& etag, const std::string& cacheControl)
+{
+	response.addHeader("ETag", etag);
+	response.addHeader("Cache-Control", cacheControl);
+
+	const std::string ifNoneMatch {request.headerValue("If-None-Match")};
+	if (ifNoneMatch.empty())
+		return false;
+
+	for (const std::string& tag : StringUtils::splitString(ifNoneMatch, ","))
+	{
+		// Weak comparison, as per RFC 7232
+		const std::string trimmedTag {StringUtils::stringTrim(tag)};
+		std::string_view value {trimmedTag};
+		if (value.substr(0, 2) == "W/")
+			value.remove_prefix(2);
+
+		if (value == "*" || value == etag)
+		{
+			response.setStatus(304);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+} // namespace HttpCache
+
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/HttpCompression.hpp"
+
+#include <zlib.h>
+
+#include <Wt/Http/Request.h>
+
+#include "utils/Exception.hpp"
+#include "utils/String.hpp"
+
+namespace HttpCompression {
+
+std::optional<Encoding>
+getAcceptedEncoding(const Wt::Http::Request& request)
+{
+	const std::string acceptEncoding {request.headerValue("Accept-Encoding")};
+	if (acceptEncoding.empty())
+		return std::nullopt;
+
+	bool gzipAccepted {};
+	bool deflateAccepted {};
+	for (const std::string& entry : StringUtils::splitString(acceptEncoding, ","))
+	{
+		const std::vector<std::string> params {StringUtils::splitString(entry, ";")};
+		if (params.empty())
+			continue;
+
+		// Only honor explicit refusals ("q=0"), other weights are not used
+		bool refused {};
+		for (std::size_t i {1}; i < params.size(); ++i)
+		{
+			const std::string param {StringUtils::stringTrim(params[i])};
+			if (param.size() >= 3 && param.compare(0, 2, "q=") == 0)
+			{
+				const std::optional<float> weight {StringUtils::readAs<float>(param.substr(2))};
+				refused = weight && *weight == 0;
+			}
+		}
+		if (refused)
+			continue;
+
+		const std::string name {StringUtils::stringToLower(StringUtils::stringTrim(params.front()))};
+		if (name == "gzip")
+			gzipAccepted = true;
+		else if (name == "deflate")
+			deflateAccepted = true;
+	}
+
+	if (gzipAccepted)
+		return Encoding::Gzip;
+	if (deflateAccepted)
+		return Encoding::Deflate;
+
+	return std::nullopt;
+}
+
+const char*
+getEncodingName(Encoding encoding)
+{
+	switch (encoding)
+	{
+		case Encoding::Gzip: return "gzip";
+		case Encoding::Deflate: return "deflate";
+	}
+
+	return "";
+}
+
+struct CompressingStreamBuf::ZStream
+{
+	z_stream stream {};
+};
+
+CompressingStreamBuf::CompressingStreamBuf(std::streambuf& dest, Encoding encoding, int level, std::size_t threshold, std::function<void()> onCompressionStarted)
+: _dest {dest}
+, _encoding {encoding}
+, _level {level}
+, _threshold {threshold}
+, _onCompressionStarted {std::move(onCompressionStarted)}
+{
+	_pending.reserve(_threshold);
+}
+
+CompressingStreamBuf::~CompressingStreamBuf()
+{
+	if (_zstream)
+		::deflateEnd(&_zstream->stream);
+}
+
+CompressingStreamBuf::int_type
+CompressingStreamBuf::overflow(int_type c)
+{
+	if (traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+
+	const char ch {traits_type::to_char_type(c)};
+	return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+std::streamsize
+CompressingStreamBuf::xsputn(const char* s, std::streamsize count)
+{
+	if (_finished)
+		return 0;
+
+	if (!_zstream)
+	{
+		if (_pending.size() + count <= _threshold)
+		{
+			_pending.insert(std::end(_pending), s, s + count);
+			return count;
+		}
+
+		startCompression();
+	}
+
+	compress(s, count, false);
+	return count;
+}
+
+void
+CompressingStreamBuf::startCompression()
+{
+	auto zstream {std::make_unique<ZStream>()};
+
+	// windowBits + 16 makes zlib write a gzip wrapper instead of a zlib one
+	const int windowBits {_encoding == Encoding::Gzip ? 15 + 16 : 15};
+	if (::deflateInit2(&zstream->stream, _level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw LmsException {"Cannot init deflate stream"};
+
+	_zstream = std::move(zstream);
+	_output.resize(16 * 1024);
+
+	if (_onCompressionStarted)
+		_onCompressionStarted();
+
+	compress(_pending.data(), _pending.size(), false);
+	_pending.clear();
+	_pending.shrink_to_fit();
+}
+
+void
+CompressingStreamBuf::compress(const char* data, std::size_t size, bool flush)
+{
+	z_stream& stream {_zstream->stream};
+
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	stream.avail_in = static_cast<uInt>(size);
+
+	int res;
+	do
+	{
+		stream.next_out = reinterpret_cast<Bytef*>(_output.data());
+		stream.avail_out = static_cast<uInt>(_output.size());
+
+		res = ::deflate(&stream, flush ? Z_FINISH : Z_NO_FLUSH);
+		if (res == Z_STREAM_ERROR)
+			throw LmsException {"Deflate failed"};
+
+		const std::size_t produced {_output.size() - stream.avail_out};
+		if (produced > 0)
+			_dest.sputn(_output.data(), produced);
+	}
+	while (stream.avail_out == 0 || (flush && res != Z_STREAM_END));
+}
+
+void
+CompressingStreamBuf::finish()
+{
+	if (_finished)
+		return;
+	_finished = true;
+
+	if (_zstream)
+		compress(nullptr, 0, true);
+	else
+		_dest.sputn(_pending.data(), _pending.size());
+}
+
+} // namespace HttpCompression
+
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/Logger.hpp"
+#include "utils/Readiness.hpp"
+
+namespace Metrics
+{
+	namespace
+	{
+		template <typename T>
+		struct Entry
+		{
+			std::string			help;
+			std::unique_ptr<T>	metric;
+		};
+
+		struct Registry
+		{
+			std::mutex	mutex;
+			std::map<std::string, Entry<Counter>>	counters;
+			std::map<std::string, Entry<Gauge>>		gauges;
+			std::map<std::string, Entry<Histogram>>	histograms;
+		};
+
+		Registry&
+		getRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		template <typename T>
+		T&
+		getMetric(std::map<std::string, Entry<T>>& metrics, const std::string& name, const std::string& help)
+		{
+			std::scoped_lock lock {getRegistry().mutex};
+
+			Entry<T>& entry {metrics[name]};
+			if (!entry.metric)
+			{
+				entry.help = help;
+				entry.metric = std::make_unique<T>();
+			}
+
+			return *entry.metric;
+		}
+
+		constexpr std::size_t subBucketBits {4};
+		static_assert(Histogram::subBucketCount == std::size_t {1} << subBucketBits);
+	}
+
+	void
+	Histogram::record(std::chrono::microseconds duration)
+	{
+		const std::uint64_t value {static_cast<std::uint64_t>(std::max<std::chrono::microseconds::rep>(duration.count(), 0))};
+
+		_bucketCounts[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		_count.fetch_add(1, std::memory_order_relaxed);
+		_sum.fetch_add(value, std::memory_order_relaxed);
+
+		std::uint64_t max {_max.load(std::memory_order_relaxed)};
+		while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+			;
+	}
+
+	std::size_t
+	Histogram::getBucketIndex(std::uint64_t value)
+	{
+		value = std::min(value, maxValue - 1);
+
+		if (value < subBucketCount)
+			return value;
+
+		// Values in [2^msb, 2^(msb + 1)) are split in subBucketCount buckets
+		const std::size_t msb {static_cast<std::size_t>(63 - __builtin_clzll(value))};
+		const std::size_t shift {msb - subBucketBits};
+
+		return subBucketCount * (shift + 1) + static_cast<std::size_t>((value >> shift) - subBucketCount);
+	}
+
+	std::uint64_t
+	Histogram::getBucketUpperBound(std::size_t index)
+	{
+		if (index < subBucketCount)
+			return index + 1;
+
+		const std::size_t shift {index / subBucketCount - 1};
+		const std::uint64_t subBucket {index % subBucketCount};
+
+		return (subBucketCount + subBucket + 1) << shift;
+	}
+
+	Histogram::Snapshot
+	Histogram::getSnapshot() const
+	{
+		Snapshot snapshot;
+		snapshot.bucketCounts.reserve(bucketCount);
+		for (const std::atomic<std::uint64_t>& bucketCount : _bucketCounts)
+			snapshot.bucketCounts.push_back(bucketCount.load(std::memory_order_relaxed));
+
+		// Concurrent updates may be partially seen: use the bucket counts so that percentiles are consistent
+		for (const std::uint64_t bucketCount : snapshot.bucketCounts)
+			snapshot.count += bucketCount;
+		snapshot.sum = std::chrono::microseconds {_sum.load(std::memory_order_relaxed)};
+		snapshot.max = std::chrono::microseconds {_max.load(std::memory_order_relaxed)};
+
+		return snapshot;
+	}
+
+	std::chrono::microseconds
+	Histogram::Snapshot::getPercentile(double percentile) const
+	{
+		if (count == 0)
+			return std::chrono::microseconds {};
+
+		const std::uint64_t rank {std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(percentile, 0.0, 1.0) * count)))};
+
+		std::uint64_t cumulativeCount {};
+		for (std::size_t i {}; i < bucketCounts.size(); ++i)
+		{
+			cumulativeCount += bucketCounts[i];
+			if (cumulativeCount >= rank)
+				return std::min(max, std::chrono::microseconds {getBucketUpperBound(i)});
+		}
+
+		return max;
+	}
+
+	Counter&
+	getCounter(const std::string& name, const std::string& help)
+	{
+		return getMetric(getRegistry().counters, name, help);
+	}
+
+	Gauge&
+	getGauge(const std::string& name, const std::string& help)
+	{
+		return getMetric(getRegistry().gauges, name, help);
+	}
+
+	Histogram&
+	getHistogram(const std::string& name, const std::string& help)
+	{
+		return getMetric(getRegistry().histograms, name, help);
+	}
+
+	ScopedWarming::ScopedWarming(const std::string& task)
+	: _task {task}
+	, _gauge {getGauge("lms_warming{task=\"" + task + "\"}", "Set while the startup warm-up task is running")}
+	{
+		Readiness::declare(_task);
+		_gauge.add(1);
+	}
+
+	ScopedWarming::~ScopedWarming()
+	{
+		_gauge.add(-1);
+
+		const auto duration {std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start)};
+		LMS_LOG(UTILS, INFO) << "Warm-up task '" << _task << "' done in " << duration.count() << " ms";
+		Readiness::setReady(_task, duration);
+	}
+
+	Snapshot
+	getSnapshot()
+	{
+		Registry& registry {getRegistry()};
+
+		Snapshot snapshot;
+
+		std::scoped_lock lock {registry.mutex};
+
+		for (const auto& [name, entry] : registry.counters)
+			snapshot.counters.emplace(name, Snapshot::CounterValue {entry.help, entry.metric->get()});
+		for (const auto& [name, entry] : registry.gauges)
+			snapshot.gauges.emplace(name, Snapshot::GaugeValue {entry.help, entry.metric->get()});
+		for (const auto& [name, entry] : registry.histograms)
+			snapshot.histograms.emplace(name, Snapshot::HistogramValue {entry.help, entry.metric->getSnapshot()});
+
+		return snapshot;
+	}
+}
@@ -25,6 +25,9 @@
 
 #include <array>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
 
 #include <boost/tokenizer.hpp>
 
@@ -58,6 +61,46 @@ computeCrc32(const std::filesystem::path& p)
 	return crc32.getResult();
 }
 
+std::string
+computeFingerprint(const std::filesystem::path& p)
+{
+	static constexpr std::uintmax_t chunkSize {64 * 1024};
+
+	std::ifstream ifs {p.string().c_str(), std::ios_base::binary};
+	if (!ifs)
+		throw LmsException("Failed to open file '" + p.string() + "'" );
+
+	ifs.seekg(0, std::ios_base::end);
+	const std::streamoff fileSize {ifs.tellg()};
+	if (fileSize < 0)
+		throw LmsException("Failed to get size of file '" + p.string() + "'" );
+
+	Utils::Crc32Calculator crc32;
+	std::vector<char> buffer(chunkSize);
+
+	auto processChunk {[&](std::streamoff offset, std::streamoff size)
+	{
+		ifs.seekg(offset);
+		ifs.read(buffer.data(), size);
+		if (ifs.gcount() != size)
+			throw LmsException("Failed to read file '" + p.string() + "'" );
+
+		crc32.processBytes(reinterpret_cast<const std::byte*>(buffer.data()), size);
+	}};
+
+	const std::streamoff headSize {std::min<std::streamoff>(fileSize, chunkSize)};
+	processChunk(0, headSize);
+
+	const std::streamoff tailOffset {std::max<std::streamoff>(headSize, fileSize - chunkSize)};
+	if (tailOffset < fileSize)
+		processChunk(tailOffset, fileSize - tailOffset);
+
+	std::ostringstream oss;
+	oss << fileSize << "-" << std::hex << std::setw(8) << std::setfill('0') << crc32.getResult();
+
+	return oss.str();
+}
+
 bool
 ensureDirectory(const std::filesystem::path& dir)
 {
@@ -78,6 +121,17 @@ getLastWriteTime(const std::filesystem::path& file)
 	return Wt::WDateTime::fromTime_t(sb.st_mtime);
 }
 
+std::uint64_t
+getDeviceId(const std::filesystem::path& file)
+{
+	struct stat sb {};
+
+	if (stat(file.string().c_str(), &sb) == -1)
+		throw LmsException("Failed to get stats on file '" + file.string() + "'" );
+
+	return sb.st_dev;
+}
+
 void
 exploreFilesRecursive(const std::filesystem::path& directory, std::function<bool(std::error_code, const std::filesystem::path&)> cb)
 {
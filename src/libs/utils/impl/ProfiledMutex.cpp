@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/ProfiledMutex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils/Metrics.hpp"
+
+#include "Symbols.hpp"
+
+namespace LockProfiling
+{
+	// Registered on first profiled acquisition, so that nothing is reported if profiling is disabled
+	struct LockMetrics
+	{
+		LockMetrics(const std::string& name) : name {name} {}
+
+		void
+		registerMetrics()
+		{
+			std::call_once(registered, [this]
+			{
+				wait = &Metrics::getHistogram("lms_lock_wait_seconds{lock=\"" + name + "\"}", "Time spent waiting for the lock");
+				hold = &Metrics::getHistogram("lms_lock_hold_seconds{lock=\"" + name + "\"}", "Time the lock is held");
+				contentions = &Metrics::getCounter("lms_lock_contentions_total{lock=\"" + name + "\"}", "Number of acquisitions that had to wait for the lock");
+			});
+		}
+
+		const std::string	name;
+		std::once_flag		registered;
+		Metrics::Histogram*	wait {};
+		Metrics::Histogram*	hold {};
+		Metrics::Counter*	contentions {};
+	};
+
+	struct CallSiteMetrics
+	{
+		CallSiteMetrics(const std::string& labels)
+			: wait {Metrics::getCounter("lms_lock_call_site_wait_microseconds_total{" + labels + "}", "Time spent waiting for the lock, by call site")}
+			, hold {Metrics::getCounter("lms_lock_call_site_hold_microseconds_total{" + labels + "}", "Time the lock is held, by call site")}
+		{}
+
+		Metrics::Counter&	wait;
+		Metrics::Counter&	hold;
+	};
+
+	namespace
+	{
+		std::atomic<bool> enabled {};
+
+		struct Registry
+		{
+			std::mutex	mutex;	// not profiled!
+			std::map<std::string, std::unique_ptr<LockMetrics>, std::less<>>	locks;
+			std::map<std::pair<const LockMetrics*, const void*>, std::unique_ptr<CallSiteMetrics>>	callSites;
+		};
+
+		Registry&
+		getRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		std::string
+		escapeLabelValue(const std::string& value)
+		{
+			std::string escaped;
+			for (const char c : value)
+			{
+				if (c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		CallSiteMetrics&
+		getCallSiteMetrics(const LockMetrics& lock, const void* callSite)
+		{
+			// Avoids taking the registry lock on each acquisition
+			thread_local std::unordered_map<const void*, std::unordered_map<const void*, CallSiteMetrics*>> cache;
+
+			CallSiteMetrics*& cached {cache[&lock][callSite]};
+			if (!cached)
+			{
+				Registry& registry {getRegistry()};
+				std::scoped_lock registryLock {registry.mutex};
+
+				std::unique_ptr<CallSiteMetrics>& metrics {registry.callSites[{&lock, callSite}]};
+				if (!metrics)
+					metrics = std::make_unique<CallSiteMetrics>("lock=\"" + lock.name + "\",call_site=\"" + escapeLabelValue(resolveFunctionName(callSite)) + "\"");
+				cached = metrics.get();
+			}
+
+			return *cached;
+		}
+
+		LockMetrics&
+		getLockMetrics(std::string_view name)
+		{
+			Registry& registry {getRegistry()};
+			std::scoped_lock registryLock {registry.mutex};
+
+			auto it {registry.locks.find(name)};
+			if (it == std::cend(registry.locks))
+				it = registry.locks.emplace(std::string {name}, std::make_unique<LockMetrics>(std::string {name})).first;
+
+			return *it->second;
+		}
+
+		std::chrono::microseconds
+		elapsedSince(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point now)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(now - start);
+		}
+
+		template <typename TryAcquire, typename Acquire>
+		Hold
+		acquire(LockMetrics& lock, const void* callSite, TryAcquire tryAcquire, Acquire acquire)
+		{
+			if (!enabled.load(std::memory_order_relaxed))
+			{
+				acquire();
+				return {};
+			}
+
+			lock.registerMetrics();
+			CallSiteMetrics& callSiteMetrics {getCallSiteMetrics(lock, callSite)};
+
+			const auto start {std::chrono::steady_clock::now()};
+			if (!tryAcquire())
+			{
+				lock.contentions->inc();
+				acquire();
+			}
+			const auto acquireTime {std::chrono::steady_clock::now()};
+
+			const std::chrono::microseconds wait {elapsedSince(start, acquireTime)};
+			lock.wait->record(wait);
+			callSiteMetrics.wait.inc(wait.count());
+
+			return Hold {&callSiteMetrics, acquireTime};
+		}
+
+		void
+		release(LockMetrics& lock, const Hold& hold)
+		{
+			if (!hold.callSite)
+				return;
+
+			const std::chrono::microseconds holdDuration {elapsedSince(hold.acquireTime, std::chrono::steady_clock::now())};
+			lock.hold->record(holdDuration);
+			hold.callSite->hold.inc(holdDuration.count());
+		}
+
+		// Shared holds of the current thread
+		thread_local std::vector<std::pair<const void*, Hold>> sharedHolds;
+
+		Hold
+		popSharedHold(const void* mutex)
+		{
+			auto it {std::find_if(std::rbegin(sharedHolds), std::rend(sharedHolds), [=](const auto& sharedHold) { return sharedHold.first == mutex; })};
+			if (it == std::rend(sharedHolds))
+				return {};	// locked while profiling was disabled
+
+			const Hold hold {it->second};
+			sharedHolds.erase(std::next(it).base());
+			return hold;
+		}
+	}
+
+	void
+	setEnabled(bool value)
+	{
+		enabled.store(value, std::memory_order_relaxed);
+	}
+}
+
+using namespace LockProfiling;
+
+ProfiledMutex::ProfiledMutex(std::string_view name)
+	: _metrics {getLockMetrics(name)}
+{
+}
+
+// The return address must be the one of the caller
+__attribute__((noinline))
+void
+ProfiledMutex::lock()
+{
+	lock(__builtin_return_address(0));
+}
+
+void
+ProfiledMutex::lock(const void* callSite)
+{
+	_hold = acquire(_metrics, callSite, [this] { return _mutex.try_lock(); }, [this] { _mutex.lock(); });
+}
+
+bool
+ProfiledMutex::try_lock()
+{
+	if (!_mutex.try_lock())
+		return false;
+
+	_hold = {};
+	return true;
+}
+
+void
+ProfiledMutex::unlock()
+{
+	const Hold hold {_hold};
+	_mutex.unlock();
+	release(_metrics, hold);
+}
+
+ProfiledSharedMutex::ProfiledSharedMutex(std::string_view name)
+	: _metrics {getLockMetrics(name)}
+{
+}
+
+__attribute__((noinline))
+void
+ProfiledSharedMutex::lock()
+{
+	lock(__builtin_return_address(0));
+}
+
+void
+ProfiledSharedMutex::lock(const void* callSite)
+{
+	_hold = acquire(_metrics, callSite, [this] { return _mutex.try_lock(); }, [this] { _mutex.lock(); });
+}
+
+bool
+ProfiledSharedMutex::try_lock()
+{
+	if (!_mutex.try_lock())
+		return false;
+
+	_hold = {};
+	return true;
+}
+
+void
+ProfiledSharedMutex::unlock()
+{
+	const Hold hold {_hold};
+	_mutex.unlock();
+	release(_metrics, hold);
+}
+
+__attribute__((noinline))
+void
+ProfiledSharedMutex::lock_shared()
+{
+	lock_shared(__builtin_return_address(0));
+}
+
+void
+ProfiledSharedMutex::lock_shared(const void* callSite)
+{
+	const Hold hold {acquire(_metrics, callSite, [this] { return _mutex.try_lock_shared(); }, [this] { _mutex.lock_shared(); })};
+	if (hold.callSite)
+		sharedHolds.emplace_back(this, hold);
+}
+
+bool
+ProfiledSharedMutex::try_lock_shared()
+{
+	return _mutex.try_lock_shared();
+}
+
+void
+ProfiledSharedMutex::unlock_shared()
+{
+	const Hold hold {popSharedHold(this)};
+	_mutex.unlock_shared();
+	release(_metrics, hold);
+}
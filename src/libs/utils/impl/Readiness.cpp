@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Readiness.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace Readiness
+{
+	namespace
+	{
+		struct Registry
+		{
+			std::mutex	mutex;
+			std::map<std::string, std::optional<std::chrono::milliseconds>>	subsystems;
+		};
+
+		Registry&
+		getRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+	}
+
+	void
+	declare(const std::string& subsystem)
+	{
+		Registry& registry {getRegistry()};
+
+		std::scoped_lock lock {registry.mutex};
+		registry.subsystems.try_emplace(subsystem);
+	}
+
+	void
+	setReady(const std::string& subsystem, std::chrono::milliseconds warmUpDuration)
+	{
+		Registry& registry {getRegistry()};
+
+		std::scoped_lock lock {registry.mutex};
+		std::optional<std::chrono::milliseconds>& state {registry.subsystems[subsystem]};
+		if (!state)
+			state = warmUpDuration;
+	}
+
+	std::vector<SubsystemState>
+	getStates()
+	{
+		Registry& registry {getRegistry()};
+
+		std::vector<SubsystemState> res;
+
+		std::scoped_lock lock {registry.mutex};
+		res.reserve(registry.subsystems.size());
+		for (const auto& [name, warmUpDuration] : registry.subsystems)
+			res.push_back({name, warmUpDuration});
+
+		return res;
+	}
+}
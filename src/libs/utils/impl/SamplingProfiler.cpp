@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/SamplingProfiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "utils/Logger.hpp"
+
+#include "Symbols.hpp"
+
+namespace SamplingProfiler
+{
+	namespace
+	{
+		constexpr int samplingFrequency {99};	// not in phase with periodic tasks
+		constexpr std::size_t maxFrameCount {48};
+		constexpr int skippedFrameCount {2};	// signal handler and signal trampoline
+		constexpr std::size_t maxSampleCount {1 << 16};	// about 25 MiB, allocated during captures only
+		constexpr std::chrono::seconds maxDuration {300};
+
+		struct Sample
+		{
+			Subsystem							subsystem;
+			int									frameCount;
+			std::array<void*, maxFrameCount>	frames;
+		};
+
+		// initial-exec, so that no allocation can occur when accessed from the signal handler
+		thread_local __attribute__((tls_model("initial-exec"))) Subsystem currentSubsystem {Subsystem::None};
+
+		std::atomic<bool> enabled {};
+
+		// Shared with the signal handler
+		std::atomic<bool>			sampling {};
+		std::atomic<std::size_t>	activeHandlerCount {};
+		std::atomic<std::size_t>	reservedSampleCount {};
+		Sample*						samples {};
+
+		void
+		onProfilingSignal(int)
+		{
+			const int savedErrno {errno};
+
+			activeHandlerCount.fetch_add(1);
+			if (sampling.load())
+			{
+				const std::size_t index {reservedSampleCount.fetch_add(1, std::memory_order_relaxed)};
+				if (index < maxSampleCount)
+				{
+					Sample& sample {samples[index]};
+					sample.subsystem = currentSubsystem;
+					sample.frameCount = ::backtrace(sample.frames.data(), maxFrameCount);
+				}
+			}
+			activeHandlerCount.fetch_sub(1);
+
+			errno = savedErrno;
+		}
+
+		bool
+		installSignalHandler()
+		{
+			// backtrace loads the unwinder on first call, which is not safe within a signal handler
+			void* frame;
+			::backtrace(&frame, 1);
+
+			struct sigaction action {};
+			action.sa_handler = onProfilingSignal;
+			action.sa_flags = SA_RESTART;
+			sigemptyset(&action.sa_mask);
+
+			return sigaction(SIGPROF, &action, nullptr) == 0;
+		}
+
+		void
+		setTimer(std::chrono::microseconds period)
+		{
+			itimerval timer {};
+			timer.it_interval.tv_sec = period.count() / 1'000'000;
+			timer.it_interval.tv_usec = period.count() % 1'000'000;
+			timer.it_value = timer.it_interval;
+
+			setitimer(ITIMER_PROF, &timer, nullptr);
+		}
+
+		const char*
+		getSubsystemName(Subsystem subsystem)
+		{
+			switch (subsystem)
+			{
+				case Subsystem::None:		return "other";
+				case Subsystem::Request:	return "request";
+				case Subsystem::Scan:		return "scan";
+				case Subsystem::Train:		return "train";
+				case Subsystem::Transcode:	return "transcode";
+			}
+
+			return "other";
+		}
+
+		std::string
+		foldStacks(const std::vector<Sample>& samples, std::size_t sampleCount)
+		{
+			std::unordered_map<const void*, std::string> functionNames;
+			auto getFunctionName {[&](const void* address) -> const std::string&
+			{
+				auto it {functionNames.find(address)};
+				if (it == std::cend(functionNames))
+				{
+					std::string name {resolveFunctionName(address)};
+					std::replace(std::begin(name), std::end(name), ';', ':');	// frame separator
+					it = functionNames.emplace(address, std::move(name)).first;
+				}
+
+				return it->second;
+			}};
+
+			std::map<std::string, std::size_t> stackCounts;
+			for (std::size_t i {}; i < sampleCount; ++i)
+			{
+				const Sample& sample {samples[i]};
+
+				std::string stack {getSubsystemName(sample.subsystem)};
+				for (int frame {sample.frameCount - 1}; frame >= skippedFrameCount; --frame)
+				{
+					// Outer frames are return addresses, that may point past the end of the calling function
+					const char* address {static_cast<const char*>(sample.frames[frame])};
+					if (frame > skippedFrameCount)
+						address -= 1;
+
+					stack += ';';
+					stack += getFunctionName(address);
+				}
+
+				stackCounts[stack]++;
+			}
+
+			std::string res;
+			for (const auto& [stack, count] : stackCounts)
+				res += stack + " " + std::to_string(count) + "\n";
+
+			return res;
+		}
+
+		class Profiler
+		{
+			public:
+				~Profiler();
+
+				bool startCapture(std::chrono::seconds duration);
+				bool isCaptureRunning() const;
+				std::shared_ptr<const CaptureResult> getLastCaptureResult() const;
+
+			private:
+				void runCapture(std::chrono::seconds duration);
+
+				mutable std::mutex			_mutex;
+				std::condition_variable		_quitCondition;
+				bool						_quit {};
+				bool						_signalHandlerInstalled {};
+				bool						_captureRunning {};
+				std::thread					_thread;
+				std::shared_ptr<const CaptureResult>	_lastCaptureResult;
+		};
+
+		Profiler::~Profiler()
+		{
+			{
+				std::scoped_lock lock {_mutex};
+				_quit = true;
+			}
+			_quitCondition.notify_all();
+
+			if (_thread.joinable())
+				_thread.join();
+		}
+
+		bool
+		Profiler::startCapture(std::chrono::seconds duration)
+		{
+			std::scoped_lock lock {_mutex};
+
+			if (_captureRunning)
+				return false;
+
+			if (!_signalHandlerInstalled)
+			{
+				if (!installSignalHandler())
+				{
+					LMS_LOG(MAIN, ERROR) << "Cannot install the profiling signal handler";
+					return false;
+				}
+				_signalHandlerInstalled = true;
+			}
+
+			// Previous capture thread is done
+			if (_thread.joinable())
+				_thread.join();
+
+			_captureRunning = true;
+			_thread = std::thread {[this, duration] { runCapture(std::clamp(duration, std::chrono::seconds {1}, maxDuration)); }};
+
+			return true;
+		}
+
+		bool
+		Profiler::isCaptureRunning() const
+		{
+			std::scoped_lock lock {_mutex};
+			return _captureRunning;
+		}
+
+		std::shared_ptr<const CaptureResult>
+		Profiler::getLastCaptureResult() const
+		{
+			std::scoped_lock lock {_mutex};
+			return _lastCaptureResult;
+		}
+
+		void
+		Profiler::runCapture(std::chrono::seconds duration)
+		{
+			LMS_LOG(MAIN, INFO) << "Starting a " << duration.count() << " s profiling capture";
+
+			std::vector<Sample> buffer(maxSampleCount);
+			samples = buffer.data();
+			reservedSampleCount = 0;
+
+			const auto startTime {std::chrono::system_clock::now()};
+			sampling = true;
+			setTimer(std::chrono::microseconds {1'000'000 / samplingFrequency});
+
+			{
+				std::unique_lock lock {_mutex};
+				_quitCondition.wait_for(lock, duration, [this] { return _quit; });
+			}
+
+			setTimer(std::chrono::microseconds {0});
+			sampling = false;
+			// Handlers that have seen sampling set may still be writing their sample
+			while (activeHandlerCount.load() > 0)
+				std::this_thread::yield();
+			samples = nullptr;
+
+			const std::size_t sampleCount {std::min(reservedSampleCount.load(), maxSampleCount)};
+			CaptureResult result {startTime, duration, sampleCount, reservedSampleCount.load() - sampleCount, foldStacks(buffer, sampleCount)};
+
+			LMS_LOG(MAIN, INFO) << "Profiling capture complete: " << result.sampleCount << " samples, " << result.droppedSampleCount << " dropped";
+
+			std::scoped_lock lock {_mutex};
+			_lastCaptureResult = std::make_shared<const CaptureResult>(std::move(result));
+			_captureRunning = false;
+		}
+
+		Profiler&
+		getProfiler()
+		{
+			static Profiler profiler;
+			return profiler;
+		}
+	}
+
+	ScopedSubsystem::ScopedSubsystem(Subsystem subsystem)
+	: _previousSubsystem {currentSubsystem}
+	{
+		currentSubsystem = subsystem;
+	}
+
+	ScopedSubsystem::~ScopedSubsystem()
+	{
+		currentSubsystem = _previousSubsystem;
+	}
+
+	void
+	setEnabled(bool enable)
+	{
+		enabled = enable;
+	}
+
+	bool
+	isEnabled()
+	{
+		return enabled;
+	}
+
+	bool
+	startCapture(std::chrono::seconds duration)
+	{
+		if (!enabled)
+			return false;
+
+		return getProfiler().startCapture(duration);
+	}
+
+	bool
+	isCaptureRunning()
+	{
+		return getProfiler().isCaptureRunning();
+	}
+
+	std::shared_ptr<const CaptureResult>
+	getLastCaptureResult()
+	{
+		return getProfiler().getLastCaptureResult();
+	}
+}
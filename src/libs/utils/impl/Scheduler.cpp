@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "utils/Logger.hpp"
+#include "utils/ThreadPriority.hpp"
+
+namespace {
+
+	std::size_t
+	getActualThreadCount(std::size_t threadCount)
+	{
+		return threadCount ? threadCount : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+} // namespace
+
+Scheduler::Scheduler(std::size_t cpuThreadCount, std::size_t ioThreadCount, const CpuAffinity::CpuSet& cpuSet)
+: _cpuSet {cpuSet}
+{
+	cpuThreadCount = getActualThreadCount(cpuThreadCount);
+	ioThreadCount = getActualThreadCount(ioThreadCount);
+
+	LMS_LOG(UTILS, INFO) << "Scheduler: using " << cpuThreadCount << " CPU thread(s) and " << ioThreadCount << " I/O thread(s), per priority level";
+
+	setThreadCount(_cpuQueue, cpuThreadCount, false);
+	setThreadCount(_cpuLowPriorityQueue, cpuThreadCount, true);
+	setThreadCount(_ioQueue, ioThreadCount, false);
+	setThreadCount(_ioLowPriorityQueue, ioThreadCount, true);
+}
+
+Scheduler::~Scheduler()
+{
+	stopThreads(_cpuQueue);
+	stopThreads(_cpuLowPriorityQueue);
+	stopThreads(_ioQueue);
+	stopThreads(_ioLowPriorityQueue);
+}
+
+std::size_t
+Scheduler::getThreadCount(TaskClass taskClass) const
+{
+	return taskClass == TaskClass::Cpu ? _cpuQueue.threadCount : _ioQueue.threadCount;
+}
+
+void
+Scheduler::setThreadCount(TaskClass taskClass, std::size_t threadCount)
+{
+	threadCount = getActualThreadCount(threadCount);
+	if (getThreadCount(taskClass) == threadCount)
+		return;
+
+	LMS_LOG(UTILS, INFO) << "Scheduler: using " << threadCount << " " << (taskClass == TaskClass::Cpu ? "CPU" : "I/O") << " thread(s), per priority level";
+
+	setThreadCount(getQueue(taskClass, Priority::Normal), threadCount, false);
+	setThreadCount(getQueue(taskClass, Priority::Low), threadCount, true);
+}
+
+void
+Scheduler::post(TaskClass taskClass, Priority priority, CancellationToken cancellation, Task task)
+{
+	Queue& queue {getQueue(taskClass, priority)};
+
+	{
+		std::scoped_lock lock {queue.mutex};
+		queue.entries[priority == Priority::High ? 0 : 1].push_back(Entry {std::move(cancellation), std::move(task)});
+	}
+
+	queue.condition.notify_one();
+}
+
+bool
+Scheduler::parallelFor(TaskClass taskClass, Priority priority, const CancellationToken& cancellation, std::size_t count, const std::function<void(std::size_t)>& func, std::size_t maxParallelism)
+{
+	// Helpers may only start once the loop is over: they must not use anything owned by the caller once it is closed
+	struct LoopState
+	{
+		std::atomic<std::size_t>	nextIndex {};
+		std::mutex					mutex;
+		std::condition_variable		condition;	// signaled when a helper is done
+		bool						closed {};
+		std::size_t					activeHelperCount {};
+	};
+	auto state {std::make_shared<LoopState>()};
+
+	auto runLoop {[&func, &cancellation, count](LoopState& loopState)
+	{
+		for (std::size_t index {loopState.nextIndex++}; index < count && !cancellation.isCancelled(); index = loopState.nextIndex++)
+			func(index);
+	}};
+
+	const std::size_t parallelism {std::min(count, maxParallelism ? maxParallelism : getThreadCount(taskClass))};
+	for (std::size_t i {1}; i < parallelism; ++i)
+	{
+		post(taskClass, priority, cancellation, [state, runLoop]
+		{
+			{
+				std::scoped_lock lock {state->mutex};
+				if (state->closed)
+					return;
+
+				state->activeHelperCount++;
+			}
+
+			runLoop(*state);
+
+			{
+				std::scoped_lock lock {state->mutex};
+				state->activeHelperCount--;
+			}
+			state->condition.notify_all();
+		});
+	}
+
+	runLoop(*state);
+
+	{
+		std::unique_lock lock {state->mutex};
+
+		state->closed = true;
+		state->condition.wait(lock, [&] { return state->activeHelperCount == 0; });
+	}
+
+	return !cancellation.isCancelled();
+}
+
+Scheduler::Queue&
+Scheduler::getQueue(TaskClass taskClass, Priority priority)
+{
+	const bool lowPriority {priority == Priority::Low};
+
+	switch (taskClass)
+	{
+		case TaskClass::Cpu:
+			return lowPriority ? _cpuLowPriorityQueue : _cpuQueue;
+		case TaskClass::IO:
+			break;
+	}
+
+	return lowPriority ? _ioLowPriorityQueue : _ioQueue;
+}
+
+void
+Scheduler::setThreadCount(Queue& queue, std::size_t threadCount, bool lowPriority)
+{
+	std::vector<std::thread> stoppedThreads;
+	{
+		std::scoped_lock lock {queue.mutex};
+
+		queue.threadCount = threadCount;
+
+		// Threads stopped by a previous call
+		for (auto it {std::begin(queue.threads)}; it != std::end(queue.threads); )
+		{
+			if (std::find(std::cbegin(queue.stoppedThreadIds), std::cend(queue.stoppedThreadIds), it->get_id()) != std::cend(queue.stoppedThreadIds))
+			{
+				stoppedThreads.push_back(std::move(*it));
+				it = queue.threads.erase(it);
+			}
+			else
+				++it;
+		}
+		queue.stoppedThreadIds.clear();
+
+		for (; queue.runningThreadCount < threadCount; ++queue.runningThreadCount)
+		{
+			queue.threads.emplace_back([this, &queue, lowPriority]
+			{
+				CpuAffinity::setCurrentThreadAffinity(_cpuSet);
+				if (lowPriority)
+					lowerCurrentThreadPriority();
+
+				threadLoop(queue);
+			});
+		}
+	}
+	queue.condition.notify_all();
+
+	for (std::thread& thread : stoppedThreads)
+		thread.join();
+}
+
+void
+Scheduler::stopThreads(Queue& queue)
+{
+	{
+		std::scoped_lock lock {queue.mutex};
+
+		queue.quit = true;
+		for (std::deque<Entry>& entries : queue.entries)
+			entries.clear();
+	}
+	queue.condition.notify_all();
+
+	for (std::thread& thread : queue.threads)
+		thread.join();
+}
+
+void
+Scheduler::threadLoop(Queue& queue)
+{
+	while (true)
+	{
+		Entry entry;
+
+		{
+			std::unique_lock lock {queue.mutex};
+
+			auto itEntries {std::end(queue.entries)};
+			queue.condition.wait(lock, [&]
+			{
+				itEntries = std::find_if(std::begin(queue.entries), std::end(queue.entries), [](const std::deque<Entry>& entries) { return !entries.empty(); });
+				return queue.quit || queue.runningThreadCount > queue.threadCount || itEntries != std::end(queue.entries);
+			});
+			if (queue.quit)
+				return;
+
+			if (queue.runningThreadCount > queue.threadCount)
+			{
+				queue.runningThreadCount--;
+				queue.stoppedThreadIds.push_back(std::this_thread::get_id());
+				return;
+			}
+
+			entry = std::move(itEntries->front());
+			itEntries->pop_front();
+		}
+
+		if (entry.cancellation.isCancelled())
+			continue;
+
+		try
+		{
+			entry.task();
+		}
+		catch (std::exception& e)
+		{
+			LMS_LOG(UTILS, ERROR) << "Scheduler: caught exception in task: " << e.what();
+		}
+	}
+}
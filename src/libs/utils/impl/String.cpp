@@ -19,58 +19,48 @@
 
 #include "utils/String.hpp"
 
+#include <algorithm>
 #include <iomanip>
 #include <unordered_map>
 
-#include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string.hpp>
 
 namespace StringUtils {
 
-bool
-readList(const std::string& str, const std::string& separators, std::list<std::string>& results)
+template<>
+std::optional<std::string>
+readAs(std::string_view str)
+{
+	return std::string {str};
+}
+
+std::vector<std::string_view>
+splitStringViews(std::string_view string, std::string_view separators)
 {
-	std::string curStr;
+	std::vector<std::string_view> res;
 
-	for (char c : str)
+	std::string_view::size_type tokenBegin {string.find_first_not_of(separators)};
+	while (tokenBegin != std::string_view::npos)
 	{
-		if (separators.find(c) != std::string::npos) {
-			if (!curStr.empty()) {
-				results.push_back(curStr);
-				curStr.clear();
-			}
-		}
-		else {
-			if (curStr.empty() && std::isspace(c))
-				continue;
+		const std::string_view::size_type tokenEnd {string.find_first_of(separators, tokenBegin)};
+		res.push_back(string.substr(tokenBegin, tokenEnd == std::string_view::npos ? std::string_view::npos : tokenEnd - tokenBegin));
 
-			curStr.push_back(c);
-		}
+		tokenBegin = tokenEnd == std::string_view::npos ? std::string_view::npos : string.find_first_not_of(separators, tokenEnd);
 	}
 
-	if (!curStr.empty())
-		results.push_back(curStr);
-
-	return !str.empty();
-}
+	if (res.empty())
+		res.push_back({});
 
-template<>
-std::optional<std::string>
-readAs(const std::string& str)
-{
-	return str;
+	return res;
 }
 
 std::vector<std::string>
-splitString(const std::string& string, const std::string& separators)
+splitString(std::string_view string, std::string_view separators)
 {
-	std::string str {stringTrim(string, separators)};
-
-	std::vector<std::string> res;
-	boost::algorithm::split(res, str, boost::is_any_of(separators), boost::token_compress_on);
+	const std::vector<std::string_view> views {splitStringViews(string, separators)};
 
-	return res;
+	return std::vector<std::string>(std::cbegin(views), std::cend(views));
 }
 
 std::string
@@ -80,11 +70,17 @@ joinStrings(const std::vector<std::string>& strings, const std::string& delimite
 }
 
 std::string
-stringTrim(const std::string& str, const std::string& whitespace)
+stringTrim(std::string_view str, std::string_view whitespace)
+{
+	return std::string {stringTrimView(str, whitespace)};
+}
+
+std::string_view
+stringTrimView(std::string_view str, std::string_view whitespace)
 {
 	const auto strBegin = str.find_first_not_of(whitespace);
-	if (strBegin == std::string::npos)
-		return ""; // no content
+	if (strBegin == std::string_view::npos)
+		return {}; // no content
 
 	const auto strEnd = str.find_last_not_of(whitespace);
 	const auto strRange = strEnd - strBegin + 1;
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Symbols.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+std::string
+resolveFunctionName(const void* address)
+{
+	Dl_info info {};
+	if (!dladdr(address, &info))
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%p", address);
+		return buffer;
+	}
+
+	if (info.dli_sname)
+	{
+		int status {};
+		std::unique_ptr<char, decltype(&std::free)> demangled {abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status), &std::free};
+		return status == 0 ? demangled.get() : info.dli_sname;
+	}
+
+	std::string module {info.dli_fname ? info.dli_fname : "?"};
+	module = module.substr(module.find_last_of('/') + 1);
+
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "+0x%zx", static_cast<std::size_t>(static_cast<const char*>(address) - static_cast<const char*>(info.dli_fbase)));
+	return module + buffer;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/ThreadPriority.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "utils/Logger.hpp"
+
+namespace {
+
+// Not exposed by the libc, see linux/ioprio.h
+constexpr int ioprioWhoProcess {1};
+constexpr int ioprioClassIdle {3};
+constexpr int ioprioClassShift {13};
+
+} // namespace
+
+void
+lowerCurrentThreadPriority()
+{
+	thread_local bool done {};
+	if (done)
+		return;
+
+	done = true;
+
+	struct sched_param param {};
+	if (const int res {::pthread_setschedparam(::pthread_self(), SCHED_IDLE, &param)}; res != 0)
+		LMS_LOG(UTILS, ERROR) << "Cannot set thread scheduling policy: " << ::strerror(res);
+
+	// Who = 0 means the calling thread
+	if (::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift) < 0)
+		LMS_LOG(UTILS, ERROR) << "Cannot set thread I/O priority: " << ::strerror(errno);
+}
+
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/Tracing.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+
+namespace Tracing
+{
+	namespace
+	{
+		// Requests doing a lot of transactions must not use unbounded memory
+		constexpr std::size_t maxSpanCount {1024};
+
+		Settings settings;
+		bool enabled {};
+
+		std::mutex outputMutex;
+		std::ofstream output;
+
+		thread_local Trace* currentTrace {};
+
+		std::string
+		generateTraceId()
+		{
+			// 128 bits, as expected by OpenTelemetry
+			std::string id;
+			for (std::size_t i {}; i < 4; ++i)
+			{
+				char buffer[9];
+				std::snprintf(buffer, sizeof(buffer), "%08x", static_cast<unsigned>(Random::getRandGenerator()()));
+				id += buffer;
+			}
+			return id;
+		}
+
+		void
+		writeJsonString(std::ostream& os, std::string_view str)
+		{
+			os << '"';
+			for (const char c : str)
+			{
+				switch (c)
+				{
+					case '"': os << "\\\""; break;
+					case '\\': os << "\\\\"; break;
+					case '\n': os << "\\n"; break;
+					case '\r': os << "\\r"; break;
+					case '\t': os << "\\t"; break;
+					default:
+						if (static_cast<unsigned char>(c) < 0x20)
+						{
+							char buffer[7];
+							std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+							os << buffer;
+						}
+						else
+							os << c;
+				}
+			}
+			os << '"';
+		}
+
+		std::chrono::microseconds
+		toMicroseconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+		}
+	}
+
+	class Trace
+	{
+		public:
+			Trace(std::string_view name, bool sampled)
+				: _sampled {sampled}
+			{
+				_spans.push_back(SpanRecord {std::string {name}, std::nullopt, _startTime, {}, {}});
+			}
+
+			std::optional<std::size_t>
+			openSpan(std::string_view name)
+			{
+				if (_spans.size() >= maxSpanCount)
+				{
+					_droppedSpanCount++;
+					return std::nullopt;
+				}
+
+				_spans.push_back(SpanRecord {std::string {name}, _currentSpan, std::chrono::steady_clock::now(), {}, {}});
+				_currentSpan = _spans.size() - 1;
+				return _currentSpan;
+			}
+
+			void
+			closeSpan(std::size_t index)
+			{
+				SpanRecord& span {_spans[index]};
+				span.duration = std::chrono::steady_clock::now() - span.start;
+				_currentSpan = span.parent.value_or(0);
+			}
+
+			void
+			setAttribute(std::size_t index, std::string_view key, std::string_view value)
+			{
+				_spans[index].attributes.emplace_back(key, value);
+			}
+
+			// Closes the root span
+			bool
+			finish()
+			{
+				closeSpan(0);
+				return _sampled || (settings.slowThreshold && _spans.front().duration >= *settings.slowThreshold);
+			}
+
+			std::string
+			toJson() const
+			{
+				std::ostringstream oss;
+
+				const SpanRecord& root {_spans.front()};
+				oss << "{\"traceId\":\"" << _id << "\",\"name\":";
+				writeJsonString(oss, root.name);
+				oss << ",\"startTimeUnixUs\":" << std::chrono::duration_cast<std::chrono::microseconds>(_startSystemTime.time_since_epoch()).count()
+					<< ",\"durationUs\":" << toMicroseconds(root.duration).count()
+					<< ",\"sampled\":" << (_sampled ? "true" : "false")
+					<< ",\"droppedSpanCount\":" << _droppedSpanCount;
+				writeAttributes(oss, root);
+
+				// Span ids are indexes, the root span being 0
+				oss << ",\"spans\":[";
+				for (std::size_t i {1}; i < _spans.size(); ++i)
+				{
+					const SpanRecord& span {_spans[i]};
+					if (i > 1)
+						oss << ',';
+					oss << "{\"id\":" << i << ",\"parentId\":" << span.parent.value_or(0) << ",\"name\":";
+					writeJsonString(oss, span.name);
+					oss << ",\"startUs\":" << toMicroseconds(span.start - _startTime).count()
+						<< ",\"durationUs\":" << toMicroseconds(span.duration).count();
+					writeAttributes(oss, span);
+					oss << '}';
+				}
+				oss << "]}";
+
+				return oss.str();
+			}
+
+		private:
+			struct SpanRecord
+			{
+				std::string									name;
+				std::optional<std::size_t>					parent;
+				std::chrono::steady_clock::time_point		start;
+				std::chrono::steady_clock::duration			duration;
+				std::vector<std::pair<std::string, std::string>>	attributes;
+			};
+
+			static void
+			writeAttributes(std::ostream& os, const SpanRecord& span)
+			{
+				if (span.attributes.empty())
+					return;
+
+				os << ",\"attributes\":{";
+				for (std::size_t i {}; i < span.attributes.size(); ++i)
+				{
+					if (i > 0)
+						os << ',';
+					writeJsonString(os, span.attributes[i].first);
+					os << ':';
+					writeJsonString(os, span.attributes[i].second);
+				}
+				os << '}';
+			}
+
+			const std::string								_id {generateTraceId()};
+			const bool										_sampled;
+			const std::chrono::system_clock::time_point		_startSystemTime {std::chrono::system_clock::now()};
+			const std::chrono::steady_clock::time_point		_startTime {std::chrono::steady_clock::now()};
+			std::vector<SpanRecord>							_spans;
+			std::size_t										_currentSpan {};
+			std::size_t										_droppedSpanCount {};
+	};
+
+	void
+	setup(const Settings& newSettings)
+	{
+		settings = newSettings;
+		enabled = settings.samplePercent > 0 || settings.slowThreshold;
+
+		if (enabled && !settings.outputFile.empty())
+		{
+			output.open(settings.outputFile, std::ios::app);
+			if (!output.is_open())
+				LMS_LOG(UTILS, ERROR) << "Cannot open trace file '" << settings.outputFile.string() << "', traces will be logged";
+		}
+
+		if (enabled)
+			LMS_LOG(UTILS, INFO) << "Tracing " << settings.samplePercent << "% of the requests"
+				<< (settings.slowThreshold ? ", and the ones taking more than " + std::to_string(settings.slowThreshold->count()) + " ms" : "");
+	}
+
+	RequestTrace::RequestTrace(std::string_view name)
+	{
+		if (!enabled || currentTrace)
+			return;
+
+		const bool sampled {settings.samplePercent >= 100 || static_cast<unsigned>(Random::getRandom(0, 99)) < settings.samplePercent};
+		// Slow requests can only be known at the end: all of them have to be recorded
+		if (!sampled && !settings.slowThreshold)
+			return;
+
+		_trace = std::make_unique<Trace>(name, sampled);
+		currentTrace = _trace.get();
+	}
+
+	RequestTrace::~RequestTrace()
+	{
+		if (!_trace)
+			return;
+
+		currentTrace = nullptr;
+		if (!_trace->finish())
+			return;
+
+		const std::string json {_trace->toJson()};
+
+		std::scoped_lock lock {outputMutex};
+		if (output.is_open())
+			output << json << std::endl;
+		else
+			LMS_LOG(UTILS, INFO) << "Trace: " << json;
+	}
+
+	void
+	RequestTrace::setAttribute(std::string_view key, std::string_view value)
+	{
+		if (_trace)
+			_trace->setAttribute(0, key, value);
+	}
+
+	Span::Span(std::string_view name)
+	{
+		if (!currentTrace)
+			return;
+
+		if (const std::optional<std::size_t> index {currentTrace->openSpan(name)})
+		{
+			_trace = currentTrace;
+			_index = *index;
+		}
+	}
+
+	Span::~Span()
+	{
+		if (_trace)
+			_trace->closeSpan(_index);
+	}
+
+	void
+	Span::setAttribute(std::string_view key, std::string_view value)
+	{
+		if (_trace)
+			_trace->setAttribute(_index, key, value);
+	}
+}
@@ -19,7 +19,7 @@
 
 #include "utils/UUID.hpp"
 
-#include <regex>
+#include <algorithm>
 
 #include "utils/String.hpp"
 
@@ -27,32 +27,103 @@ namespace StringUtils
 {
 	template <>
 	std::optional<UUID>
-	readAs(const std::string& str)
+	readAs(std::string_view str)
 	{
 		return UUID::fromString(str);
 	}
 }
 
-static
-bool
-stringIsUUID(std::string_view str)
+namespace
 {
-	static const std::regex re { R"([0-9a-fA-F]{8}\-[0-9a-fA-F]{4}\-[0-9a-fA-F]{4}\-[0-9a-fA-F]{4}\-[0-9a-fA-F]{12})"};
+	constexpr std::size_t stringSize {36};
+	constexpr std::array<std::size_t, 4> dashPositions {8, 13, 18, 23};
 
-	return std::regex_match(std::cbegin(str), std::cend(str), re);
+	// -1 if not an hex digit
+	int
+	hexDigitValue(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+
+		return -1;
+	}
+
+	bool
+	isDashPosition(std::size_t pos)
+	{
+		return std::find(std::cbegin(dashPositions), std::cend(dashPositions), pos) != std::cend(dashPositions);
+	}
 }
 
-UUID::UUID(std::string_view str)
-	: _value {StringUtils::stringToLower(str)}
+std::optional<UUID>
+UUID::fromString(std::string_view str)
 {
+	if (str.size() != stringSize)
+		return std::nullopt;
+
+	Bytes bytes;
+	std::size_t byteIndex {};
+	int highNibble {-1};
+
+	for (std::size_t pos {}; pos < str.size(); ++pos)
+	{
+		if (isDashPosition(pos))
+		{
+			if (str[pos] != '-')
+				return std::nullopt;
+			continue;
+		}
+
+		const int value {hexDigitValue(str[pos])};
+		if (value < 0)
+			return std::nullopt;
+
+		if (highNibble < 0)
+		{
+			highNibble = value;
+		}
+		else
+		{
+			bytes[byteIndex++] = static_cast<std::uint8_t>((highNibble << 4) | value);
+			highNibble = -1;
+		}
+	}
+
+	return UUID {bytes};
 }
 
 std::optional<UUID>
-UUID::fromString(std::string_view str)
+UUID::fromBytes(const std::vector<unsigned char>& bytes)
 {
-	if (!stringIsUUID(str))
+	if (bytes.size() != byteCount)
 		return std::nullopt;
 
-	return UUID {str};
+	Bytes res;
+	std::copy(std::cbegin(bytes), std::cend(bytes), std::begin(res));
+
+	return UUID {res};
 }
 
+std::string
+UUID::getAsString() const
+{
+	static constexpr char hexDigits[] {"0123456789abcdef"};
+
+	std::string res;
+	res.reserve(stringSize);
+
+	for (std::size_t i {}; i < _bytes.size(); ++i)
+	{
+		if (isDashPosition(res.size()))
+			res.push_back('-');
+
+		res.push_back(hexDigits[_bytes[i] >> 4]);
+		res.push_back(hexDigits[_bytes[i] & 0x0F]);
+	}
+
+	return res;
+}
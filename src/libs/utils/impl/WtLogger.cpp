@@ -19,14 +19,148 @@
 
 #include "utils/WtLogger.hpp"
 
+#include <chrono>
+
 #include <Wt/WApplication.h>
 #include <Wt/WLogger.h>
+#include <Wt/WServer.h>
 
 #include "utils/Logger.hpp"
 
+namespace {
+
+	// Max delay before the logs are written
+	constexpr std::chrono::milliseconds writePeriod {50};
+
+} // namespace
+
+WtLogger::WtLogger()
+: _slots {std::make_unique<Slot[]>(queueSize)}
+{
+	static_assert((queueSize & (queueSize - 1)) == 0);
+
+	for (std::atomic<int>& activeSeverity : _activeSeverities)
+		activeSeverity = -1;
+
+	for (std::size_t i {}; i < queueSize; ++i)
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+	_thread = std::thread {[this] { run(); }};
+}
+
+WtLogger::~WtLogger()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+	}
+	_quitCondition.notify_all();
+
+	_thread.join();
+}
+
+bool
+WtLogger::isEnabled(Module, Severity severity) const
+{
+	std::atomic<int>& activeSeverity {_activeSeverities[static_cast<std::size_t>(severity)]};
+
+	const int active {activeSeverity.load(std::memory_order_relaxed)};
+	if (active >= 0)
+		return active;
+
+	// The Wt configuration is only known once the server is created, and does not change
+	Wt::WServer* server {Wt::WServer::instance()};
+	if (!server)
+		return true;
+
+	const bool res {server->logger().logging(getSeverityName(severity))};
+	activeSeverity.store(res, std::memory_order_relaxed);
+
+	return res;
+}
+
 void
 WtLogger::processLog(const Log& log)
 {
-	Wt::log(getSeverityName(log.getSeverity())) << Wt::WLogger::sep << "[" << getModuleName(log.getModule()) << "]" << Wt::WLogger::sep << log.getMessage();
+	Record record {log.getSeverity(), log.getModule(), log.getMessage()};
+	if (!push(std::move(record)))
+		writeRecord(record);
 }
 
+void
+WtLogger::writeRecord(const Record& record)
+{
+	Wt::log(getSeverityName(record.severity)) << Wt::WLogger::sep << "[" << getModuleName(record.module) << "]" << Wt::WLogger::sep << record.message;
+}
+
+bool
+WtLogger::push(Record&& record)
+{
+	std::size_t position {_pushPosition.load(std::memory_order_relaxed)};
+	Slot* slot;
+
+	while (true)
+	{
+		slot = &_slots[position & (queueSize - 1)];
+
+		const std::size_t sequence {slot->sequence.load(std::memory_order_acquire)};
+		if (sequence == position)
+		{
+			// Free slot, try to reserve it
+			if (_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (sequence < position)
+		{
+			// Not yet popped: full
+			return false;
+		}
+		else
+		{
+			// Taken by another producer
+			position = _pushPosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->record = std::move(record);
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool
+WtLogger::pop(Record& record)
+{
+	Slot& slot {_slots[_popPosition & (queueSize - 1)]};
+
+	if (slot.sequence.load(std::memory_order_acquire) != _popPosition + 1)
+		return false;
+
+	record = std::move(slot.record);
+	slot.sequence.store(_popPosition + queueSize, std::memory_order_release);
+	++_popPosition;
+
+	return true;
+}
+
+void
+WtLogger::run()
+{
+	Record record;
+
+	while (true)
+	{
+		while (pop(record))
+			writeRecord(record);
+
+		std::unique_lock lock {_mutex};
+		if (_quit)
+			break;
+
+		_quitCondition.wait_for(lock, writePeriod);
+	}
+
+	// Logs pushed during the last wait
+	while (pop(record))
+		writeRecord(record);
+}
@@ -19,8 +19,16 @@
 
 #include "utils/Zipper.hpp"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
 #include <cstddef>
-#include <fstream>
+#include <cstring>
+#include <type_traits>
 
 #include <Wt/WDate.h>
 #include <Wt/WTime.h>
@@ -251,35 +259,86 @@ namespace Zip
 			static constexpr SizeType getHeaderSize() { return 22; }
 	};
 
-	Zipper::Zipper(const std::map<std::string, std::filesystem::path>& files, const Wt::WDateTime& lastModifiedTime)
+	template <typename FileContext>
+	static
+	std::uint16_t
+	getGeneralPurposeFlags(const FileContext& fileContext)
+	{
+		if (fileContext.knownCrc32)
+			return ZipHeader::GeneralPurposeFlag::LanguageEncoding;
+
+		return ZipHeader::GeneralPurposeFlag::LanguageEncoding | ZipHeader::GeneralPurposeFlag::UseDataDescriptor;
+	}
+
+	Zipper::~Zipper()
+	{
+		closeCurrentFile();
+		if (_nextFileFd >= 0)
+			::close(_nextFileFd);
+	}
+
+	template <typename T>
+	static
+	void
+	processLayoutValue(Utils::Crc32Calculator& layoutCrc32, T value)
+	{
+		static_assert(std::is_integral_v<T>);
+		layoutCrc32.processBytes(reinterpret_cast<const std::byte*>(&value), sizeof(value));
+	}
+
+	Zipper::Zipper(const std::map<std::string, FileEntry>& files, const Wt::WDateTime& lastModifiedTime)
 	{
-		for (const auto& [filename, filePath] : files)
+		Utils::Crc32Calculator layoutCrc32;
+
+		for (const auto& [filename, fileEntry] : files)
 		{
+			const std::filesystem::path& filePath {fileEntry.path};
+
 			FileContext fileContext;
 			fileContext.filePath = filePath;
 
-			std::error_code ec;
-			fileContext.fileSize = std::filesystem::file_size(filePath, ec);
-			if (ec)
-				throw ZipperException {"Cannot get file size for '" + filePath.string() + "': " + ec.message()};
+			if (fileEntry.fileSize && fileEntry.fileLastWrite.isValid())
+			{
+				fileContext.fileSize = *fileEntry.fileSize;
+				fileContext.fileLastWrite = fileEntry.fileLastWrite;
+			}
+			else
+			{
+				std::error_code ec;
+				fileContext.fileSize = std::filesystem::file_size(filePath, ec);
+				if (ec)
+					throw ZipperException {"Cannot get file size for '" + filePath.string() + "': " + ec.message()};
 
+				fileContext.fileLastWrite = getLastWriteTime(filePath);
+			}
+			if (fileEntry.crc32 && fileEntry.crc32FileLastWrite == fileContext.fileLastWrite)
+				fileContext.knownCrc32 = fileEntry.crc32;
 			if (lastModifiedTime.isValid())
 				fileContext.lastModifiedTime = lastModifiedTime;
 			else
-				fileContext.lastModifiedTime = getLastWriteTime(filePath);
-
-			_files[filename] = std::move(fileContext);
+				fileContext.lastModifiedTime = fileContext.fileLastWrite;
 
 			_totalZipSize += LocalFileHeader::getHeaderSize();
 			_totalZipSize += filename.size();
 			_totalZipSize += Zip64ExtendedInformationExtraField::getHeaderSize();
 			_totalZipSize += fileContext.fileSize;
-			_totalZipSize += DataDescriptor::getHeaderSize();
+			if (!fileContext.knownCrc32)
+				_totalZipSize += DataDescriptor::getHeaderSize();
 			_totalZipSize += CentralDirectoryHeader::getHeaderSize();
 			_totalZipSize += filename.size();
 			_totalZipSize += Zip64ExtendedInformationExtraField::getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {});
+
+			layoutCrc32.processBytes(reinterpret_cast<const std::byte*>(filename.c_str()), filename.size() + 1);
+			processLayoutValue(layoutCrc32, fileContext.fileSize);
+			processLayoutValue(layoutCrc32, static_cast<std::int64_t>(fileContext.lastModifiedTime.toTime_t()));
+			processLayoutValue(layoutCrc32, fileContext.knownCrc32.value_or(0));
+			processLayoutValue(layoutCrc32, static_cast<std::uint8_t>(fileContext.knownCrc32.has_value()));
+
+			_files[filename] = std::move(fileContext);
 		}
 
+		_layoutChecksum = layoutCrc32.getResult();
+
 		_totalZipSize += Zip64EndOfCentralDirectoryRecord::getHeaderSize();
 		_totalZipSize += Zip64EndOfCentralDirectoryLocator::getHeaderSize();
 		_totalZipSize += EndOfCentralDirectoryRecord::getHeaderSize();
@@ -293,75 +352,156 @@ namespace Zip
 		// make sure we have some room for the headers
 		assert(bufferSize >= minOutputBufferSize);
 
-		SizeType nbTotalWrittenBytes {};
+		SizeType nbTotalWrittenBytes {writePendingBytes(buffer, bufferSize)};
+		buffer += nbTotalWrittenBytes;
+		bufferSize -= nbTotalWrittenBytes;
 
 		while (!isComplete() && (bufferSize >= minOutputBufferSize))
 		{
-			SizeType nbWrittenBytes {};
+			const SizeType nbWrittenBytes {writeStep(buffer, bufferSize)};
 
-			switch (_writeState)
-			{
-				case WriteState::LocalFileHeader:
-					nbWrittenBytes = writeLocalFileHeader(buffer, bufferSize);
-					break;
+			buffer += nbWrittenBytes;
+			bufferSize -= nbWrittenBytes;
+			_currentZipOffset += nbWrittenBytes;
+			nbTotalWrittenBytes += nbWrittenBytes ;
+		}
 
-				case WriteState::LocalFileHeaderFileName:
-					nbWrittenBytes = writeLocalFileHeaderFileName(buffer, bufferSize);
-					break;
+		return nbTotalWrittenBytes;
+	}
 
-				case WriteState::LocalFileHeaderExtraFields:
-					nbWrittenBytes = writeLocalFileHeaderExtraFields(buffer, bufferSize);
-					break;
+	SizeType
+	Zipper::writePendingBytes(std::byte* buffer, SizeType bufferSize)
+	{
+		const SizeType nbBytesToCopy {std::min<SizeType>(_pendingBytes.size(), bufferSize)};
 
-				case WriteState::FileData:
-					nbWrittenBytes = writeFileData(buffer, bufferSize);
-					break;
+		std::copy(std::cbegin(_pendingBytes), std::next(std::cbegin(_pendingBytes), nbBytesToCopy), buffer);
+		_pendingBytes.erase(std::cbegin(_pendingBytes), std::next(std::cbegin(_pendingBytes), nbBytesToCopy));
 
-				case WriteState::DataDescriptor:
-					nbWrittenBytes = writeDataDescriptor(buffer, bufferSize);
-					break;
+		return nbBytesToCopy;
+	}
 
-				case WriteState::CentralDirectoryHeader:
-					nbWrittenBytes = writeCentralDirectoryHeader(buffer, bufferSize);
-					break;
+	void
+	Zipper::seek(SizeType offset)
+	{
+		assert(_currentZipOffset == 0);
 
-				case WriteState::CentralDirectoryHeaderFileName:
-					nbWrittenBytes = writeCentralDirectoryHeaderFileName(buffer, bufferSize);
-					break;
+		if (offset > _totalZipSize)
+			throw ZipperException {"Cannot seek beyond the end of the archive"};
 
-				case WriteState::CentralDirectoryHeaderExtraFields:
-					nbWrittenBytes = writeCentralDirectoryHeaderExtraFields(buffer, bufferSize);
-					break;
+		std::vector<std::byte> buffer(minOutputBufferSize);
 
-				case WriteState::Zip64EndOfCentralDirectoryRecord:
-					nbWrittenBytes = writeZip64EndOfCentralDirectoryRecord(buffer, bufferSize);
-					break;
+		while (_currentZipOffset < offset)
+		{
+			const SizeType nbBytesToSkip {offset - _currentZipOffset};
 
-				case WriteState::Zip64EndOfCentralDirectoryLocator:
-					nbWrittenBytes = writeZip64EndOfCentralDirectoryLocator(buffer, bufferSize);
-					break;
+			if (_writeState == WriteState::FileData && _currentFile->second.knownCrc32)
+			{
+				// No need to read the data
+				const SizeType nbFileBytesToSkip {std::min(_currentFile->second.fileSize - _currentOffset, nbBytesToSkip)};
+				if (nbFileBytesToSkip > 0)
+				{
+					_currentOffset += nbFileBytesToSkip;
+					_currentZipOffset += nbFileBytesToSkip;
+					continue;
+				}
+			}
+			else if (_writeState == WriteState::FileData && buffer.size() < nbBytesToSkip)
+			{
+				// Reading the data is required to compute the CRC32
+				buffer.resize(std::min<SizeType>(nbBytesToSkip, 262144));
+			}
 
-				case WriteState::EndOfCentralDirectoryRecord:
-					nbWrittenBytes = writeEndOfCentralDirectoryRecord(buffer, bufferSize);
-					break;
+			const SizeType nbWrittenBytes {writeStep(buffer.data(), std::min<SizeType>(buffer.size(), std::max(nbBytesToSkip, minOutputBufferSize)))};
+			_currentZipOffset += nbWrittenBytes;
 
-				case WriteState::Complete:
-					break;
+			if (_currentZipOffset > offset)
+			{
+				// Partially skipped record: the rest is written first by writeSome()
+				const SizeType nbPendingBytes {_currentZipOffset - offset};
+				_pendingBytes.assign(std::next(std::cbegin(buffer), nbWrittenBytes - nbPendingBytes), std::next(std::cbegin(buffer), nbWrittenBytes));
 			}
+		}
+	}
 
-			buffer += nbWrittenBytes;
-			bufferSize -= nbWrittenBytes;
-			_currentZipOffset += nbWrittenBytes;
-			nbTotalWrittenBytes += nbWrittenBytes ;
+	SizeType
+	Zipper::writeStep(std::byte* buffer, SizeType bufferSize)
+	{
+		SizeType nbWrittenBytes {};
+
+		switch (_writeState)
+		{
+			case WriteState::LocalFileHeader:
+				nbWrittenBytes = writeLocalFileHeader(buffer, bufferSize);
+				break;
+
+			case WriteState::LocalFileHeaderFileName:
+				nbWrittenBytes = writeLocalFileHeaderFileName(buffer, bufferSize);
+				break;
+
+			case WriteState::LocalFileHeaderExtraFields:
+				nbWrittenBytes = writeLocalFileHeaderExtraFields(buffer, bufferSize);
+				break;
+
+			case WriteState::FileData:
+				nbWrittenBytes = writeFileData(buffer, bufferSize);
+				break;
+
+			case WriteState::DataDescriptor:
+				nbWrittenBytes = writeDataDescriptor(buffer, bufferSize);
+				break;
+
+			case WriteState::CentralDirectoryHeader:
+				nbWrittenBytes = writeCentralDirectoryHeader(buffer, bufferSize);
+				break;
+
+			case WriteState::CentralDirectoryHeaderFileName:
+				nbWrittenBytes = writeCentralDirectoryHeaderFileName(buffer, bufferSize);
+				break;
+
+			case WriteState::CentralDirectoryHeaderExtraFields:
+				nbWrittenBytes = writeCentralDirectoryHeaderExtraFields(buffer, bufferSize);
+				break;
+
+			case WriteState::Zip64EndOfCentralDirectoryRecord:
+				nbWrittenBytes = writeZip64EndOfCentralDirectoryRecord(buffer, bufferSize);
+				break;
+
+			case WriteState::Zip64EndOfCentralDirectoryLocator:
+				nbWrittenBytes = writeZip64EndOfCentralDirectoryLocator(buffer, bufferSize);
+				break;
+
+			case WriteState::EndOfCentralDirectoryRecord:
+				nbWrittenBytes = writeEndOfCentralDirectoryRecord(buffer, bufferSize);
+				break;
+
+			case WriteState::Complete:
+				break;
 		}
 
-		return nbTotalWrittenBytes;
+		return nbWrittenBytes;
 	}
 
 	bool
 	Zipper::isComplete() const
 	{
-		return _writeState == WriteState::Complete;
+		return _writeState == WriteState::Complete && _pendingBytes.empty();
+	}
+
+	std::vector<Zipper::ComputedCrc32>
+	Zipper::getComputedCrc32s() const
+	{
+		std::vector<ComputedCrc32> res;
+
+		if (!isComplete())
+			return res;
+
+		for (const auto& [filename, fileContext] : _files)
+		{
+			if (!fileContext.knownCrc32)
+				res.push_back(ComputedCrc32 {fileContext.filePath, fileContext.fileLastWrite, fileContext.fileCrc32.getResult()});
+		}
+
+		return res;
 	}
 
 	SizeType
@@ -382,9 +522,9 @@ namespace Zip
 
 		header.setSignature();
 		header.setVersionNeededToExtract(ZipHeader::VersionNeededToExtract);
-		header.setGeneralPurposeFlags(ZipHeader::GeneralPurposeFlag::LanguageEncoding | ZipHeader::GeneralPurposeFlag::UseDataDescriptor);
+		header.setGeneralPurposeFlags(getGeneralPurposeFlags(_currentFile->second));
 		header.setCompressionMethod(ZipHeader::CompressionMethod::NoCompression);
-		header.setCrc32UncompressedData(ZipHeader::UnknownCrc32);
+		header.setCrc32UncompressedData(_currentFile->second.knownCrc32 ? *_currentFile->second.knownCrc32 : ZipHeader::UnknownCrc32);
 		header.setCompressedSize();
 		header.setUncompressedSize();
 		header.setLastModifiedDateTime(_currentFile->second.lastModifiedTime);
@@ -430,8 +570,10 @@ namespace Zip
 
 		header.setTag();
 		header.setSize();
-		header.setUncompressedSize(ZipHeader::UnknownFileSize);
-		header.setCompressedSize(ZipHeader::UnknownFileSize);
+		// Sizes are only known up front along with the CRC32
+		const SizeType fileSize {_currentFile->second.knownCrc32 ? _currentFile->second.fileSize : ZipHeader::UnknownFileSize};
+		header.setUncompressedSize(fileSize);
+		header.setCompressedSize(fileSize);
 
 		_writeState = WriteState::FileData;
 		return header.getHeaderSize();
@@ -444,36 +586,136 @@ namespace Zip
 
 		if (_currentOffset == _currentFile->second.fileSize)
 		{
+			closeCurrentFile();
 			_currentOffset = 0;
-			_writeState = WriteState::DataDescriptor;
+			if (_currentFile->second.knownCrc32)
+			{
+				++_currentFile;
+				_writeState = WriteState::LocalFileHeader;
+			}
+			else
+				_writeState = WriteState::DataDescriptor;
 			return 0;
 		}
 
-		const std::string filePath {_currentFile->second.filePath.string()};
+		if (_currentFileFd < 0)
+			openCurrentFile();
 
-		std::ifstream ifs {filePath.c_str(), std::ios_base::binary};
-		if (!ifs)
-			throw ZipperException {"File '" + filePath + "' does no longer exist!"};
-
-		ifs.seekg(0, std::ios::end);
-		const ::uint64_t fileSize {static_cast<::uint64_t>(ifs.tellg())};
-		ifs.seekg(0, std::ios::beg);
+		const SizeType nbBytesToRead {std::min(_currentFile->second.fileSize - _currentOffset, bufferSize)};
 
-		if (fileSize != _currentFile->second.fileSize)
-			throw ZipperException {"File '" + filePath + "': size mismatch!"};
+		ssize_t readSize;
+		do
+		{
+			readSize = ::pread(_currentFileFd, buffer, nbBytesToRead, _currentOffset);
+		}
+		while (readSize < 0 && errno == EINTR);
 
-		const SizeType nbBytesToRead {std::min(static_cast<std::size_t>(fileSize) - _currentOffset, bufferSize)};
+		if (readSize < 0)
+			throw ZipperException {"Cannot read file '" + _currentFile->second.filePath.string() + "': " + ::strerror(errno)};
+		if (readSize == 0)
+			throw ZipperException {"File '" + _currentFile->second.filePath.string() + "': size mismatch!"};
 
-		ifs.seekg(_currentOffset, std::ios::beg);
-		ifs.read(reinterpret_cast<char*>(buffer), nbBytesToRead );
-		const ::uint64_t actualReadSize {static_cast<::uint64_t>(ifs.gcount())};
+		const ::uint64_t actualReadSize {static_cast<::uint64_t>(readSize)};
 
-		_currentFile->second.fileCrc32.processBytes(buffer, actualReadSize);
+		if (!_currentFile->second.knownCrc32)
+			_currentFile->second.fileCrc32.processBytes(buffer, actualReadSize);
 		_currentOffset += actualReadSize;
 
+		// Let the next chunks be read while this one is being sent
+		readAhead(readAheadChunkCount * bufferSize);
+
 		return actualReadSize;
 	}
 
+	void
+	Zipper::readAhead(SizeType readAheadSize)
+	{
+		const SizeType remainingFileSize {_currentFile->second.fileSize - _currentOffset};
+		if (remainingFileSize > 0)
+			::posix_fadvise(_currentFileFd, _currentOffset, std::min(remainingFileSize, readAheadSize), POSIX_FADV_WILLNEED);
+
+		if (remainingFileSize >= readAheadSize || _nextFileFd >= 0)
+			return;
+
+		// Close to the end of the file: also prefetch the start of the next one
+		const auto itNextFile {std::next(_currentFile)};
+		if (itNextFile == std::end(_files))
+			return;
+
+		try
+		{
+			_nextFileFd = openFile(itNextFile->second);
+			_nextFile = itNextFile;
+			::posix_fadvise(_nextFileFd, 0, std::min(itNextFile->second.fileSize, readAheadSize - remainingFileSize), POSIX_FADV_WILLNEED);
+		}
+		catch (ZipperException&)
+		{
+			// will be reported when the file is actually written
+		}
+	}
+
+	int
+	Zipper::openFile(const FileContext& fileContext)
+	{
+		const std::string filePath {fileContext.filePath.string()};
+
+		const int fd {::open(filePath.c_str(), O_RDONLY | O_CLOEXEC)};
+		if (fd < 0)
+			throw ZipperException {"File '" + filePath + "' does no longer exist!"};
+
+		struct ::stat fileStat;
+		if (::fstat(fd, &fileStat) != 0 || static_cast<SizeType>(fileStat.st_size) != fileContext.fileSize)
+		{
+			::close(fd);
+			throw ZipperException {"File '" + filePath + "': size mismatch!"};
+		}
+
+		// The headers, and the CRC32 if known, were computed for that version of the file
+		if (fileStat.st_mtime != fileContext.fileLastWrite.toTime_t())
+		{
+			::close(fd);
+			throw ZipperException {"File '" + filePath + "': modified since the archive was created!"};
+		}
+
+		// The file is read sequentially, until the end
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		return fd;
+	}
+
+	void
+	Zipper::openCurrentFile()
+	{
+		assert(_currentFileFd < 0);
+
+		if (_nextFileFd >= 0)
+		{
+			// already opened by readAhead() while writing the previous file
+			if (_nextFile == _currentFile)
+			{
+				_currentFileFd = _nextFileFd;
+				_nextFileFd = -1;
+				return;
+			}
+
+			// skipped by seek()
+			::close(_nextFileFd);
+			_nextFileFd = -1;
+		}
+
+		_currentFileFd = openFile(_currentFile->second);
+	}
+
+	void
+	Zipper::closeCurrentFile()
+	{
+		if (_currentFileFd < 0)
+			return;
+
+		::close(_currentFileFd);
+		_currentFileFd = -1;
+	}
+
 	SizeType
 	Zipper::writeDataDescriptor(std::byte* buffer, SizeType bufferSize)
 	{
@@ -514,12 +756,12 @@ namespace Zip
 		header.setSignature();
 		header.setVersionMadeBy(ZipHeader::VersionMadeBy);
 		header.setVersionNeededToExtract(ZipHeader::VersionNeededToExtract);
-		header.setGeneralPurposeFlags(ZipHeader::GeneralPurposeFlag::LanguageEncoding | ZipHeader::GeneralPurposeFlag::UseDataDescriptor);
+		header.setGeneralPurposeFlags(getGeneralPurposeFlags(_currentFile->second));
 		header.setCompressionMethod(ZipHeader::CompressionMethod::NoCompression);
 		header.setCompressedSize();
 		header.setUncompressedSize();
 		header.setLastModifiedDateTime(_currentFile->second.lastModifiedTime);
-		header.setCrc32UncompressedData(_currentFile->second.fileCrc32.getResult());
+		header.setCrc32UncompressedData(_currentFile->second.getCrc32());
 		header.setFileNameLength(_currentFile->first.size());
 		header.setExtraFieldLength(Zip64ExtendedInformationExtraField::getHeaderSize(Zip64ExtendedInformationExtraField::WithFileOffset {}));
 		header.setFileCommentLength(0);
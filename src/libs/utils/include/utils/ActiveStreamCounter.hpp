@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2020 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+// Counts the streams being served, so that background tasks can leave them the I/O bandwidth
+// Resource handlers just have to own an instance during their lifetime
+class ActiveStreamCounter
+{
+	public:
+		ActiveStreamCounter();
+		~ActiveStreamCounter();
+
+		ActiveStreamCounter(const ActiveStreamCounter&) = delete;
+		ActiveStreamCounter(ActiveStreamCounter&&) = delete;
+		ActiveStreamCounter& operator=(const ActiveStreamCounter&) = delete;
+		ActiveStreamCounter& operator=(ActiveStreamCounter&&) = delete;
+
+		// Process wide
+		static std::size_t getCount();
+};
+
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Cancellation flag shared by all the copies of a token
+// The owner requests the cancellation, the tasks poll the token
+class CancellationToken
+{
+	public:
+		CancellationToken() : _cancelled {std::make_shared<std::atomic<bool>>(false)} {}
+
+		void cancel() { *_cancelled = true; }
+		bool isCancelled() const { return *_cancelled; }
+
+	private:
+		std::shared_ptr<std::atomic<bool>> _cancelled;
+};
+
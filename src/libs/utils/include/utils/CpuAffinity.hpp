@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+// Restricts threads to some CPUs, so that pools do not compete for the same cores (and stay on the same NUMA node)
+// Threads and child processes inherit the affinity of the thread that creates them
+namespace CpuAffinity
+{
+	// Sorted CPU indexes, empty means no restriction
+	using CpuSet = std::vector<unsigned>;
+
+	// Same syntax as taskset -c, for example "0-7,16-23", empty string gives an empty set
+	// Throws LmsException if malformed
+	CpuSet parseCpuSet(std::string_view str);
+
+	// Does nothing if cpuSet is empty, errors are logged
+	void setCurrentThreadAffinity(const CpuSet& cpuSet);
+
+	// Restricts the calling thread while in scope, so that the threads and processes it creates meanwhile inherit cpuSet
+	class ScopedAffinity
+	{
+		public:
+			ScopedAffinity(const CpuSet& cpuSet);
+			~ScopedAffinity();
+
+			ScopedAffinity(const ScopedAffinity&) = delete;
+			ScopedAffinity(ScopedAffinity&&) = delete;
+			ScopedAffinity& operator=(const ScopedAffinity&) = delete;
+			ScopedAffinity& operator=(ScopedAffinity&&) = delete;
+
+		private:
+			CpuSet _previousCpuSet;	// empty if unchanged
+	};
+} // namespace CpuAffinity
@@ -68,6 +68,16 @@ class EnumSet
 			return _bitfield & (underlying_type{ 1 } << static_cast<underlying_type>(value));
 		}
 
+		constexpr bool operator==(const EnumSet& other) const
+		{
+			return _bitfield == other._bitfield;
+		}
+
+		constexpr bool operator!=(const EnumSet& other) const
+		{
+			return _bitfield != other._bitfield;
+		}
+
 		class iterator
 		{
 			public:
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/CpuAffinity.hpp"
+
+// Runs posted tasks on a fixed set of threads, in posting order
+// Used to keep the server threads away from blocking or lengthy work
+class Executor
+{
+	public:
+		using Task = std::function<void()>;
+
+		// threadCount = 0 means one thread per hardware thread
+		// The threads are restricted to cpuSet, if not empty
+		Executor(std::size_t threadCount, const std::string& name, const CpuAffinity::CpuSet& cpuSet = {});
+		virtual ~Executor();
+
+		Executor(const Executor&) = delete;
+		Executor(Executor&&) = delete;
+		Executor& operator=(const Executor&) = delete;
+		Executor& operator=(Executor&&) = delete;
+
+		std::size_t getThreadCount() const { return _threadCount; }
+
+		// Threads are started or stopped at once, stopped ones first complete their current task
+		// 0 means one thread per hardware thread
+		void setThreadCount(std::size_t threadCount);
+
+		// Pending tasks are dropped on destruction
+		void post(Task task);
+
+	private:
+		void threadLoop();
+
+		const std::string			_name;
+		const CpuAffinity::CpuSet	_cpuSet;
+		std::atomic<std::size_t>	_threadCount {};	// requested one
+
+		std::mutex					_mutex;
+		std::condition_variable		_condition;	// signaled when a task is posted, on thread count change or on quit
+		bool						_quit {};
+		std::deque<Task>			_tasks;
+		std::vector<std::thread>	_threads;			// including the stopped ones, not joined yet
+		std::size_t					_runningThreadCount {};
+		std::vector<std::thread::id>	_stoppedThreadIds;
+};
+
+// Distinct types so that each pool can be registered as its own service
+
+// Blocking media file reads
+class MediaIOExecutor final : public Executor
+{
+	public:
+		using Executor::Executor;
+};
+
+// CPU bound work (cover decoding and resizing)
+class CpuExecutor final : public Executor
+{
+	public:
+		using Executor::Executor;
+};
+
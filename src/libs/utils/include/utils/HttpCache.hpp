@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Wt::Http
+{
+	class Request;
+	class Response;
+}
+
+namespace HttpCache {
+
+// Strong entity tag, derived from the contents
+std::string
+computeETag(const std::byte* data, std::size_t dataSize);
+
+// Strong entity tag of the same contents sent using a content coding (gzip, deflate, ...)
+std::string
+getEncodedETag(const std::string& etag, std::string_view encodingName);
+
+// Sets the validator and the caching policy on the response
+// Returns true if the client already has this version: the response is then a 304 and no body must be sent
+bool
+handleConditionalRequest(const Wt::Http::Request& request, Wt::Http::Response& response, const std::string& etag, const std::string& cacheControl);
+
+} // namespace HttpCache
+
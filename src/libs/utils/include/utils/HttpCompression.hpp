@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <streambuf>
+#include <vector>
+
+namespace Wt::Http
+{
+	class Request;
+}
+
+namespace HttpCompression {
+
+enum class Encoding
+{
+	Gzip,
+	Deflate,
+};
+
+// Preferred encoding among the ones accepted by the client (Accept-Encoding header)
+std::optional<Encoding>
+getAcceptedEncoding(const Wt::Http::Request& request);
+
+// Value of the Content-Encoding header
+const char*
+getEncodingName(Encoding encoding);
+
+// Compresses the written data into the destination stream buffer
+// Data is first kept uncompressed: compression only starts once more than threshold bytes have been written,
+// onCompressionStarted being called just before anything is written to dest (time to set the headers)
+// Small payloads are written as is by finish(), that must be called once everything has been written
+class CompressingStreamBuf final : public std::streambuf
+{
+	public:
+		CompressingStreamBuf(std::streambuf& dest, Encoding encoding, int level, std::size_t threshold, std::function<void()> onCompressionStarted);
+		~CompressingStreamBuf();
+
+		CompressingStreamBuf(const CompressingStreamBuf&) = delete;
+		CompressingStreamBuf(CompressingStreamBuf&&) = delete;
+		CompressingStreamBuf& operator=(const CompressingStreamBuf&) = delete;
+		CompressingStreamBuf& operator=(CompressingStreamBuf&&) = delete;
+
+		void finish();
+
+	private:
+		int_type overflow(int_type c) override;
+		std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+		void startCompression();
+		void compress(const char* data, std::size_t size, bool flush);
+
+		struct ZStream;
+
+		std::streambuf&						_dest;
+		const Encoding						_encoding;
+		const int							_level;
+		const std::size_t					_threshold;
+		const std::function<void()>			_onCompressionStarted;
+		std::vector<char>					_pending;	// uncompressed data, until the threshold is reached
+		std::unique_ptr<ZStream>			_zstream;	// set once the compression has started
+		std::vector<char>					_output;
+		bool								_finished {};
+};
+
+} // namespace HttpCompression
+
@@ -35,6 +35,10 @@ class IConfig
 		virtual unsigned long	getULong(const std::string& setting, unsigned long def = 0) = 0;
 		virtual long		getLong(const std::string& setting, long def = 0) = 0;
 		virtual bool		getBool(const std::string& setting, bool def = false) = 0;
+
+		// Reads the configuration file again, the values in use are kept on error (throws LmsException)
+		// Only some settings are applied again once running, see the configuration file
+		virtual void		reload() = 0;
 };
 
 
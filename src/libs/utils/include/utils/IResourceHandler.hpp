@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include <Wt/Http/Request.h>
 #include <Wt/Http/Response.h>
 
@@ -30,5 +32,10 @@ class IResourceHandler
 
 		virtual void processRequest(const Wt::Http::Request& request, Wt::Http::Response& response) = 0;
 		virtual bool isFinished() const = 0;
+
+		// Asynchronous handlers may produce nothing if no data is available yet
+		// In that case, the continuation must wait for more data and be resumed once the callback is called (possibly from another thread)
+		virtual bool isWaitingForData() const { return false; }
+		virtual void notifyWhenDataAvailable(std::function<void()> /*callback*/) {}
 };
 
@@ -79,8 +79,38 @@ class Logger
 {
 	public:
 		virtual ~Logger() = default;
+
+		// Checked before building the message
+		virtual bool isEnabled(Module module, Severity severity) const = 0;
 		virtual void processLog(const Log& log) = 0;
 };
 
-#define LMS_LOG(module, severity)	Log(Service<Logger>::get(), Module::module, Severity::severity).getOstream()
+// Debug logs can be removed at compile time
+constexpr bool
+isLogCompiled(Severity severity)
+{
+#ifdef LMS_DISABLE_DEBUG_LOGS
+	return severity != Severity::DEBUG;
+#else
+	(void)severity;
+	return true;
+#endif
+}
+
+inline bool
+isLogEnabled(Module module, Severity severity)
+{
+	const Logger* logger {Service<Logger>::get()};
+	return logger && logger->isEnabled(module, severity);
+}
+
+// Turns the stream expression into a void one, in order to be used in the conditional operator
+struct LogVoidify
+{
+	void operator&(std::ostream&) {}
+};
+
+// Nothing after LMS_LOG is evaluated if the log is not enabled
+#define LMS_LOG(module, severity) \
+	!(isLogCompiled(Severity::severity) && isLogEnabled(Module::module, Severity::severity)) ? (void)0 : LogVoidify {} & Log(Service<Logger>::get(), Module::module, Severity::severity).getOstream()
 
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process wide registry of counters, gauges and latency histograms, cheap enough to be updated on hot paths
+// Metrics are created on first use and live until the end of the process: references to them can be kept
+namespace Metrics
+{
+	class Counter
+	{
+		public:
+			void inc(std::uint64_t value = 1) { _value.fetch_add(value, std::memory_order_relaxed); }
+			std::uint64_t get() const { return _value.load(std::memory_order_relaxed); }
+
+		private:
+			std::atomic<std::uint64_t> _value {};
+	};
+
+	class Gauge
+	{
+		public:
+			void set(std::int64_t value) { _value.store(value, std::memory_order_relaxed); }
+			void add(std::int64_t value) { _value.fetch_add(value, std::memory_order_relaxed); }
+			std::int64_t get() const { return _value.load(std::memory_order_relaxed); }
+
+		private:
+			std::atomic<std::int64_t> _value {};
+	};
+
+	// Durations in microseconds, counted in log-linear buckets: each power of two range is split in subBucketCount buckets
+	// so that percentiles are known within 1/subBucketCount of their value, whatever their magnitude (up to maxValue)
+	class Histogram
+	{
+		public:
+			static constexpr std::size_t subBucketCount {16};
+			static constexpr std::uint64_t maxValue {std::uint64_t {1} << 36};	// about 19 hours, larger values are counted as this one
+			static constexpr std::size_t bucketCount {subBucketCount * (36 - 4 + 1)};
+
+			void record(std::chrono::microseconds duration);
+
+			struct Snapshot
+			{
+				std::uint64_t				count {};
+				std::chrono::microseconds	sum {};
+				std::chrono::microseconds	max {};
+				std::vector<std::uint64_t>	bucketCounts;	// bucketCount entries
+
+				// Upper bound of the bucket the requested percentile falls in, percentile in [0, 1]
+				std::chrono::microseconds getPercentile(double percentile) const;
+			};
+			Snapshot getSnapshot() const;
+
+			static std::size_t getBucketIndex(std::uint64_t value);
+			static std::uint64_t getBucketUpperBound(std::size_t index);	// excluded
+
+		private:
+			std::array<std::atomic<std::uint64_t>, bucketCount>	_bucketCounts {};
+			std::atomic<std::uint64_t>	_count {};
+			std::atomic<std::uint64_t>	_sum {};
+			std::atomic<std::uint64_t>	_max {};
+	};
+
+	// Records the time spent in its scope
+	class ScopedTimer
+	{
+		public:
+			ScopedTimer(Histogram& histogram) : _histogram {histogram} {}
+			~ScopedTimer() { _histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start)); }
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer(ScopedTimer&&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+		private:
+			Histogram& _histogram;
+			const std::chrono::steady_clock::time_point _start {std::chrono::steady_clock::now()};
+	};
+
+	// Names follow the Prometheus conventions (lms_<subsystem>_<name>_<unit>), and may carry labels (name{label="value"})
+	// Metrics of the same name and different labels make a family, sharing the help of the first one
+	// Getting a metric takes a lock: keep a reference to it rather than getting it on each update
+	Counter&	getCounter(const std::string& name, const std::string& help);
+	Gauge&		getGauge(const std::string& name, const std::string& help);
+	Histogram&	getHistogram(const std::string& name, const std::string& help);
+
+	// Set while a startup warm-up task runs: data loaded in the background while requests are already served (possibly slower or degraded)
+	// Reported as lms_warming{task="<task>"}, the task being the readiness subsystem that is ready once done (see Readiness.hpp)
+	class ScopedWarming
+	{
+		public:
+			ScopedWarming(const std::string& task);
+			~ScopedWarming();
+
+			ScopedWarming(const ScopedWarming&) = delete;
+			ScopedWarming(ScopedWarming&&) = delete;
+			ScopedWarming& operator=(const ScopedWarming&) = delete;
+			ScopedWarming& operator=(ScopedWarming&&) = delete;
+
+		private:
+			const std::string _task;
+			Gauge& _gauge;
+			const std::chrono::steady_clock::time_point _start {std::chrono::steady_clock::now()};
+	};
+
+	struct Snapshot
+	{
+		struct CounterValue
+		{
+			std::string		help;
+			std::uint64_t	value;
+		};
+		struct GaugeValue
+		{
+			std::string		help;
+			std::int64_t	value;
+		};
+		struct HistogramValue
+		{
+			std::string			help;
+			Histogram::Snapshot	value;
+		};
+
+		// By name
+		std::map<std::string, CounterValue>		counters;
+		std::map<std::string, GaugeValue>		gauges;
+		std::map<std::string, HistogramValue>	histograms;
+	};
+	Snapshot getSnapshot();
+}
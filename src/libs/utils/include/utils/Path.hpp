@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <string>
@@ -28,6 +29,10 @@
 
 std::uint32_t computeCrc32(const std::filesystem::path& p);
 
+// Cheap content fingerprint, using the file size and the first and last 64KiB
+// Throws LmsException on error
+std::string computeFingerprint(const std::filesystem::path& p);
+
 // Make sure the given path is a directory
 // Create it if needed
 bool ensureDirectory(const std::filesystem::path& dir);
@@ -35,6 +40,9 @@ bool ensureDirectory(const std::filesystem::path& dir);
 // Get the last write time since Epoch
 Wt::WDateTime getLastWriteTime(const std::filesystem::path& dir);
 
+// Identifier of the device holding the file, throws LmsException on error
+std::uint64_t getDeviceId(const std::filesystem::path& file);
+
 void exploreFilesRecursive(const std::filesystem::path& directory, std::function<bool(std::error_code, const std::filesystem::path&)> cb);
 
 namespace std
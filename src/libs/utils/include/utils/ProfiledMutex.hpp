@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+
+// Mutexes that can report their contention: time spent waiting for them and holding them, by lock name and by call site
+// Profiling is disabled by default, these mutexes then only cost an extra check on lock
+// Reported through the metrics registry (lms_lock_* metrics)
+namespace LockProfiling
+{
+	void setEnabled(bool enabled);
+
+	struct LockMetrics;
+	struct CallSiteMetrics;
+
+	// Time the lock was acquired and by whom, unset if not profiled
+	struct Hold
+	{
+		CallSiteMetrics*						callSite {};
+		std::chrono::steady_clock::time_point	acquireTime;
+	};
+}
+
+class ProfiledMutex
+{
+	public:
+		explicit ProfiledMutex(std::string_view name);
+
+		ProfiledMutex(const ProfiledMutex&) = delete;
+		ProfiledMutex(ProfiledMutex&&) = delete;
+		ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+		ProfiledMutex& operator=(ProfiledMutex&&) = delete;
+
+		// Lockable: the call site is the caller of lock(), usually the function that creates the lock guard
+		void lock();
+		bool try_lock();
+		void unlock();
+
+		// When locking on behalf of another function
+		void lock(const void* callSite);
+
+	private:
+		LockProfiling::LockMetrics&	_metrics;
+		std::mutex					_mutex;
+		LockProfiling::Hold			_hold;	// only accessed by the holder
+};
+
+class ProfiledSharedMutex
+{
+	public:
+		explicit ProfiledSharedMutex(std::string_view name);
+
+		ProfiledSharedMutex(const ProfiledSharedMutex&) = delete;
+		ProfiledSharedMutex(ProfiledSharedMutex&&) = delete;
+		ProfiledSharedMutex& operator=(const ProfiledSharedMutex&) = delete;
+		ProfiledSharedMutex& operator=(ProfiledSharedMutex&&) = delete;
+
+		// SharedLockable, see ProfiledMutex
+		void lock();
+		bool try_lock();
+		void unlock();
+		void lock_shared();
+		bool try_lock_shared();
+		void unlock_shared();
+
+		void lock(const void* callSite);
+		void lock_shared(const void* callSite);
+
+	private:
+		LockProfiling::LockMetrics&	_metrics;
+		std::shared_mutex			_mutex;
+		LockProfiling::Hold			_hold;	// exclusive holds, shared holds are tracked by their threads
+};
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <algorithm>
+#include <iterator>
 #include <random>
 
 namespace Random {
@@ -52,6 +53,24 @@ shuffleContainer(Container& container)
 	std::shuffle(std::begin(container), std::end(container), getRandGenerator());
 }
 
+// Only the first count elements are shuffled, using elements picked from the whole container
+// Linear in count instead of the container size
+template <typename Container>
+void
+shuffleContainerPartially(Container& container, std::size_t count)
+{
+	const std::size_t size {static_cast<std::size_t>(std::distance(std::begin(container), std::end(container)))};
+	if (size < 2)
+		return;
+
+	auto it {std::begin(container)};
+	for (std::size_t i {}; i < std::min(count, size - 1); ++i, ++it)
+	{
+		std::uniform_int_distribution<std::size_t> dist {i, size - 1};
+		std::iter_swap(it, std::next(std::begin(container), dist(getRandGenerator())));
+	}
+}
+
 template <typename Container>
 typename Container::const_iterator
 pickRandom(const Container& container)
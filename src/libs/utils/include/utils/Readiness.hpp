@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Process wide readiness state of the subsystems that warm up in the background after startup
+// A node is ready to serve traffic at full speed once all the declared subsystems are ready
+// A ready subsystem stays ready, even if it is reloaded later
+namespace Readiness
+{
+	// Declares a subsystem as pending, no-op if already declared
+	// Must be done before the server is started, so that the node is not reported ready before its work is even scheduled
+	void declare(const std::string& subsystem);
+
+	// Implicitly declares the subsystem
+	void setReady(const std::string& subsystem, std::chrono::milliseconds warmUpDuration);
+
+	struct SubsystemState
+	{
+		std::string									name;
+		std::optional<std::chrono::milliseconds>	warmUpDuration;	// set once ready
+	};
+	std::vector<SubsystemState> getStates();	// ordered by name
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Built-in CPU sampling profiler, meant to be triggered on a running server for a given duration
+// Threads tag what they are working on (always on, only costs a thread local store), and samples are only taken during captures
+// Captures produce folded stacks ("subsystem;outermost frame;...;innermost frame count"), to be rendered using flamegraph.pl
+namespace SamplingProfiler
+{
+	enum class Subsystem
+	{
+		None,
+		Request,
+		Scan,
+		Train,
+		Transcode,
+	};
+
+	// Tags the samples taken on the current thread during its lifetime
+	class ScopedSubsystem
+	{
+		public:
+			ScopedSubsystem(Subsystem subsystem);
+			~ScopedSubsystem();
+
+			ScopedSubsystem(const ScopedSubsystem&) = delete;
+			ScopedSubsystem(ScopedSubsystem&&) = delete;
+			ScopedSubsystem& operator=(const ScopedSubsystem&) = delete;
+			ScopedSubsystem& operator=(ScopedSubsystem&&) = delete;
+
+		private:
+			const Subsystem _previousSubsystem;
+	};
+
+	// Captures are refused until enabled
+	void setEnabled(bool enabled);
+	bool isEnabled();
+
+	// Samples the process CPU time at about 100 Hz for duration, in a background thread
+	// Returns false if disabled or if a capture is already running
+	bool startCapture(std::chrono::seconds duration);
+	bool isCaptureRunning();
+
+	struct CaptureResult
+	{
+		std::chrono::system_clock::time_point	startTime;
+		std::chrono::seconds					duration;
+		std::size_t								sampleCount;
+		std::size_t								droppedSampleCount;	// samples that did not fit in the buffer
+		std::string								foldedStacks;
+	};
+	// Last completed capture, null if none
+	std::shared_ptr<const CaptureResult> getLastCaptureResult();
+}
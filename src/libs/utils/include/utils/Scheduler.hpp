@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/CancellationToken.hpp"
+#include "utils/CpuAffinity.hpp"
+
+// Process wide scheduler for the background work (scanner, recommendation engine, ...)
+// CPU bound and blocking I/O tasks run on distinct threads, so that waiting for I/O does not hold cores
+// Within a class, tasks are run by priority, then in posting order
+class Scheduler
+{
+	public:
+		enum class TaskClass
+		{
+			Cpu,
+			IO,
+		};
+
+		enum class Priority
+		{
+			High,
+			Normal,
+			Low,	// run on dedicated threads, at idle CPU and I/O priorities: only use what the others leave
+		};
+
+		using Task = std::function<void()>;
+
+		// 0 means one thread per hardware thread
+		// The threads are restricted to cpuSet, if not empty
+		Scheduler(std::size_t cpuThreadCount, std::size_t ioThreadCount, const CpuAffinity::CpuSet& cpuSet = {});
+		~Scheduler();
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler(Scheduler&&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+		Scheduler& operator=(Scheduler&&) = delete;
+
+		std::size_t getThreadCount(TaskClass taskClass) const;
+
+		// Threads are started or stopped at once, stopped ones first complete their current task
+		// 0 means one thread per hardware thread
+		void setThreadCount(TaskClass taskClass, std::size_t threadCount);
+
+		// The task is dropped if the token is cancelled before it starts
+		// Pending tasks are dropped on destruction
+		void post(TaskClass taskClass, Priority priority, CancellationToken cancellation, Task task);
+
+		// Calls func for each index in [0, count), using at most maxParallelism threads (0 means all the threads of the class)
+		// func must not throw
+		// The calling thread takes part in the work, so that this can safely be called from a task
+		// Returns false if cancelled before completion
+		bool parallelFor(TaskClass taskClass, Priority priority, const CancellationToken& cancellation, std::size_t count, const std::function<void(std::size_t)>& func, std::size_t maxParallelism = 0);
+
+	private:
+		struct Entry
+		{
+			CancellationToken	cancellation;
+			Task				task;
+		};
+
+		// One per task class and OS priority
+		struct Queue
+		{
+			std::atomic<std::size_t>	threadCount {};	// requested one
+			std::mutex					mutex;
+			std::condition_variable		condition;	// signaled when a task is posted, on thread count change or on quit
+			bool						quit {};
+			std::array<std::deque<Entry>, 2> entries;	// by priority
+			std::vector<std::thread>	threads;			// including the stopped ones, not joined yet
+			std::size_t					runningThreadCount {};
+			std::vector<std::thread::id>	stoppedThreadIds;
+		};
+
+		Queue& getQueue(TaskClass taskClass, Priority priority);
+		void setThreadCount(Queue& queue, std::size_t threadCount, bool lowPriority);
+		static void stopThreads(Queue& queue);
+		static void threadLoop(Queue& queue);
+
+		const CpuAffinity::CpuSet	_cpuSet;
+
+		Queue	_cpuQueue;
+		Queue	_cpuLowPriorityQueue;
+		Queue	_ioQueue;
+		Queue	_ioLowPriorityQueue;
+};
+
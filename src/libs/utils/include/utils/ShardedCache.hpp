@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils/Metrics.hpp"
+#include "utils/ProfiledMutex.hpp"
+
+template<typename Value>
+struct UnitWeigher
+{
+	std::size_t operator()(const Value&) const { return 1; }
+};
+
+// Bounded cache shared by several threads
+// Entries are spread over shards having their own lock, each shard evicting its least recently used entries
+// once the weight of its entries exceeds its share of the max weight (entry count with UnitWeigher, data size, etc.)
+// Values are copied out of the cache: use shared pointers for values that are expensive to copy
+// Reported as lms_<name>_cache_* metrics, and as the <name>_cache lock
+template<typename Key, typename Value, typename Weigher = UnitWeigher<Value>, typename Hash = std::hash<Key>>
+class ShardedCache
+{
+	public:
+		ShardedCache(const std::string& name, std::size_t maxWeight, std::size_t shardCount = 16, Weigher weigher = {})
+		: _maxShardWeight {maxWeight / std::max<std::size_t>(1, shardCount)}
+		, _weigher {std::move(weigher)}
+		, _hits {Metrics::getCounter("lms_" + name + "_cache_hits_total", "Number of entries found in the " + name + " cache")}
+		, _misses {Metrics::getCounter("lms_" + name + "_cache_misses_total", "Number of entries not found in the " + name + " cache")}
+		, _loadWaits {Metrics::getCounter("lms_" + name + "_cache_load_waits_total", "Number of misses of the " + name + " cache that waited for the same entry being loaded by another thread")}
+		, _entryCount {Metrics::getGauge("lms_" + name + "_cache_entries", "Number of entries in the " + name + " cache")}
+		, _weight {Metrics::getGauge("lms_" + name + "_cache_weight", "Total weight of the entries in the " + name + " cache")}
+		{
+			for (std::size_t i {}; i < std::max<std::size_t>(1, shardCount); ++i)
+				_shards.push_back(std::make_unique<Shard>(name + "_cache"));
+		}
+
+		~ShardedCache() { clear(); }
+
+		ShardedCache(const ShardedCache&) = delete;
+		ShardedCache(ShardedCache&&) = delete;
+		ShardedCache& operator=(const ShardedCache&) = delete;
+		ShardedCache& operator=(ShardedCache&&) = delete;
+
+		std::optional<Value> get(const Key& key)
+		{
+			Shard& shard {getShard(key)};
+
+			std::scoped_lock lock {shard.mutex};
+			return getLocked(shard, key);
+		}
+
+		// Values heavier than the share of a shard are not cached
+		void put(const Key& key, Value value)
+		{
+			const std::size_t weight {_weigher(value)};
+			const std::size_t maxShardWeight {_maxShardWeight};
+			Shard& shard {getShard(key)};
+
+			std::scoped_lock lock {shard.mutex};
+
+			if (auto it {shard.index.find(key)}; it != std::cend(shard.index))
+				eraseLocked(shard, it->second);
+
+			if (weight > maxShardWeight)
+				return;
+
+			while (shard.weight + weight > maxShardWeight && !shard.entries.empty())
+				eraseLocked(shard, std::prev(std::end(shard.entries)));
+
+			shard.entries.push_front(Entry {key, std::move(value), weight});
+			shard.index.emplace(key, std::begin(shard.entries));
+			shard.weight += weight;
+			_entryCount.add(1);
+			_weight.add(static_cast<std::int64_t>(weight));
+		}
+
+		enum class LoadSource
+		{
+			Cache,
+			PendingLoad,	// loaded by another thread
+			Loader,
+		};
+
+		// Single flight: concurrent misses for the same key wait for the value being loaded by the first one, instead of loading it again
+		// The loader returns an optional value, only cached if set. Exceptions thrown by the loader are also reported to the waiters
+		// The loader must not wait for the loading of the same key
+		template<typename Loader>
+		std::optional<Value> getOrLoad(const Key& key, Loader loader, LoadSource* source = nullptr)
+		{
+			Shard& shard {getShard(key)};
+
+			std::optional<std::promise<std::optional<Value>>> promise;
+			std::shared_future<std::optional<Value>> pendingLoad;
+			{
+				std::scoped_lock lock {shard.mutex};
+
+				if (std::optional<Value> value {getLocked(shard, key)})
+				{
+					if (source)
+						*source = LoadSource::Cache;
+					return value;
+				}
+
+				if (auto it {shard.pendingLoads.find(key)}; it != std::cend(shard.pendingLoads))
+				{
+					pendingLoad = it->second;
+					_loadWaits.inc();
+				}
+				else
+				{
+					promise.emplace();
+					shard.pendingLoads.emplace(key, promise->get_future().share());
+				}
+			}
+
+			if (pendingLoad.valid())
+			{
+				if (source)
+					*source = LoadSource::PendingLoad;
+				return pendingLoad.get();
+			}
+
+			if (source)
+				*source = LoadSource::Loader;
+
+			std::optional<Value> value;
+			try
+			{
+				value = loader();
+				if (value)
+					put(key, *value);
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+				removePendingLoad(shard, key);
+				throw;
+			}
+
+			promise->set_value(value);
+			removePendingLoad(shard, key);
+
+			return value;
+		}
+
+		bool erase(const Key& key)
+		{
+			Shard& shard {getShard(key)};
+
+			std::scoped_lock lock {shard.mutex};
+
+			auto it {shard.index.find(key)};
+			if (it == std::cend(shard.index))
+				return false;
+
+			eraseLocked(shard, it->second);
+			return true;
+		}
+
+		// predicate(const Key&, const Value&), called with the shard locked
+		template<typename Predicate>
+		std::size_t eraseIf(Predicate predicate)
+		{
+			std::size_t count {};
+
+			for (const auto& shard : _shards)
+			{
+				std::scoped_lock lock {shard->mutex};
+
+				for (auto it {std::begin(shard->entries)}; it != std::end(shard->entries); )
+				{
+					auto itEntry {it++};
+					if (predicate(std::as_const(itEntry->key), std::as_const(itEntry->value)))
+					{
+						eraseLocked(*shard, itEntry);
+						count++;
+					}
+				}
+			}
+
+			return count;
+		}
+
+		// visitor(const Key&, const Value&), called with the shard locked
+		template<typename Visitor>
+		void visit(Visitor visitor)
+		{
+			for (const auto& shard : _shards)
+			{
+				std::scoped_lock lock {shard->mutex};
+
+				for (const Entry& entry : shard->entries)
+					visitor(entry.key, entry.value);
+			}
+		}
+
+		// Least recently used entries are evicted at once if the max weight decreases
+		void setMaxWeight(std::size_t maxWeight)
+		{
+			_maxShardWeight = maxWeight / _shards.size();
+
+			for (const auto& shard : _shards)
+			{
+				std::scoped_lock lock {shard->mutex};
+
+				while (shard->weight > _maxShardWeight && !shard->entries.empty())
+					eraseLocked(*shard, std::prev(std::end(shard->entries)));
+			}
+		}
+
+		void clear()
+		{
+			eraseIf([](const Key&, const Value&) { return true; });
+		}
+
+		struct Stats
+		{
+			std::size_t		entryCount {};
+			std::size_t		weight {};
+			std::uint64_t	hits {};
+			std::uint64_t	misses {};
+		};
+
+		// Hits and misses since the last call
+		Stats getStats()
+		{
+			Stats stats;
+			for (const auto& shard : _shards)
+			{
+				std::scoped_lock lock {shard->mutex};
+				stats.entryCount += shard->entries.size();
+				stats.weight += shard->weight;
+			}
+			stats.hits = _hitCount.exchange(0);
+			stats.misses = _missCount.exchange(0);
+
+			return stats;
+		}
+
+	private:
+		struct Entry
+		{
+			Key			key;
+			Value		value;
+			std::size_t	weight;
+		};
+		using Entries = std::list<Entry>;	// most recently used first
+
+		struct Shard
+		{
+			Shard(const std::string& lockName) : mutex {lockName} {}
+
+			ProfiledMutex	mutex;
+			Entries			entries;
+			std::unordered_map<Key, typename Entries::iterator, Hash>	index;
+			std::size_t		weight {};
+			std::unordered_map<Key, std::shared_future<std::optional<Value>>, Hash>	pendingLoads;
+		};
+
+		Shard& getShard(const Key& key)
+		{
+			// The shard must not depend on the bits that select the buckets in the shard
+			const std::uint64_t hash {static_cast<std::uint64_t>(_hash(key)) * 0x9E3779B97F4A7C15ULL};
+			return *_shards[(hash >> 32) % _shards.size()];
+		}
+
+		std::optional<Value> getLocked(Shard& shard, const Key& key)
+		{
+			auto it {shard.index.find(key)};
+			if (it == std::cend(shard.index))
+			{
+				_missCount++;
+				_misses.inc();
+				return std::nullopt;
+			}
+
+			_hitCount++;
+			_hits.inc();
+			shard.entries.splice(std::begin(shard.entries), shard.entries, it->second);
+			return it->second->value;
+		}
+
+		void eraseLocked(Shard& shard, typename Entries::iterator itEntry)
+		{
+			shard.weight -= itEntry->weight;
+			_entryCount.add(-1);
+			_weight.add(-static_cast<std::int64_t>(itEntry->weight));
+
+			shard.index.erase(itEntry->key);
+			shard.entries.erase(itEntry);
+		}
+
+		void removePendingLoad(Shard& shard, const Key& key)
+		{
+			std::scoped_lock lock {shard.mutex};
+			shard.pendingLoads.erase(key);
+		}
+
+		std::atomic<std::size_t>	_maxShardWeight;
+		const Weigher		_weigher;
+		const Hash			_hash {};
+		std::vector<std::unique_ptr<Shard>>	_shards;
+
+		std::atomic<std::uint64_t>	_hitCount {};
+		std::atomic<std::uint64_t>	_missCount {};
+		Metrics::Counter&	_hits;
+		Metrics::Counter&	_misses;
+		Metrics::Counter&	_loadWaits;
+		Metrics::Gauge&		_entryCount;
+		Metrics::Gauge&		_weight;
+};
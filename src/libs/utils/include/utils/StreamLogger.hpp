@@ -26,7 +26,8 @@ class StreamLogger final : public Logger
 	public:
 		StreamLogger(std::ostream& oss);
 
-		void processLog(const Log& log);
+		bool isEnabled(Module, Severity) const override { return true; }
+		void processLog(const Log& log) override;
 
 	private:
 		std::ostream& _os;
@@ -19,10 +19,12 @@
 
 #pragma once
 
+#include <charconv>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
 #define QUOTEME(x) QUOTEME_1(x)
@@ -30,14 +32,22 @@
 
 namespace StringUtils {
 
+// Empty tokens are skipped, but an empty string gives one empty token
 std::vector<std::string>
-splitString(const std::string& string, const std::string& separators);
+splitString(std::string_view string, std::string_view separators);
+
+// Same as splitString, the views refer to string
+std::vector<std::string_view>
+splitStringViews(std::string_view string, std::string_view separators);
 
 std::string
 joinStrings(const std::vector<std::string>& strings, const std::string& delimiter);
 
 std::string
-stringTrim(const std::string& str, const std::string& whitespaces = " \t");
+stringTrim(std::string_view str, std::string_view whitespaces = " \t");
+
+std::string_view
+stringTrimView(std::string_view str, std::string_view whitespaces = " \t");
 
 std::string
 stringTrimEnd(const std::string& str, const std::string& whitespaces = " \t");
@@ -55,21 +65,34 @@ std::string
 bufferToString(const std::vector<unsigned char>& data);
 
 template<typename T>
-std::optional<T> readAs(const std::string& str)
+std::optional<T> readAs(std::string_view str)
 {
 	T res;
 
-	std::istringstream iss ( str );
-	iss >> res;
-	if (iss.fail())
-		return std::nullopt;
+	if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+	{
+		// As the stream extraction: leading spaces and plus sign are accepted, trailing characters are ignored
+		str = str.substr(std::min(str.find_first_not_of(" \t\n\v\f\r"), str.size()));
+		if (!str.empty() && str.front() == '+')
+			str.remove_prefix(1);
+
+		if (std::from_chars(str.data(), str.data() + str.size(), res).ec != std::errc {})
+			return std::nullopt;
+	}
+	else
+	{
+		std::istringstream iss {std::string {str}};
+		iss >> res;
+		if (iss.fail())
+			return std::nullopt;
+	}
 
 	return res;
 }
 
 template<>
 std::optional<std::string>
-readAs(const std::string& str);
+readAs(std::string_view str);
 
 [[nodiscard]]
 std::string
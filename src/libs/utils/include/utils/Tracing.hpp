@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Request scoped tracing: the time spent by a request is broken down in nested spans (lock waits, transactions, covers, transcodes...)
+// Spans are attached to the trace of the current thread, they cost a clock read and a push when traced, and nothing otherwise
+// Traced requests are written as JSON lines, one per request
+namespace Tracing
+{
+	struct Settings
+	{
+		unsigned								samplePercent {};	// percentage of the requests that are traced
+		std::optional<std::chrono::milliseconds>	slowThreshold;	// requests taking longer than this are traced too
+		std::filesystem::path					outputFile;			// appended, the log is used if empty
+	};
+
+	// Tracing is disabled until set up, must be called before serving requests
+	void setup(const Settings& settings);
+
+	class Trace;
+
+	// Root span of a request: the spans created by the same thread are recorded in it until its destruction
+	// Has no effect if the thread already has a trace
+	class RequestTrace
+	{
+		public:
+			RequestTrace(std::string_view name);
+			~RequestTrace();	// writes the trace if sampled or slow
+
+			RequestTrace(const RequestTrace&) = delete;
+			RequestTrace(RequestTrace&&) = delete;
+			RequestTrace& operator=(const RequestTrace&) = delete;
+			RequestTrace& operator=(RequestTrace&&) = delete;
+
+			void setAttribute(std::string_view key, std::string_view value);
+
+		private:
+			std::unique_ptr<Trace> _trace;	// unset if the request is not traced
+	};
+
+	// Records the time spent in its scope, nested in the span of the enclosing scope
+	// Does nothing if the thread has no trace
+	class Span
+	{
+		public:
+			Span(std::string_view name);
+			~Span();
+
+			Span(const Span&) = delete;
+			Span(Span&&) = delete;
+			Span& operator=(const Span&) = delete;
+			Span& operator=(Span&&) = delete;
+
+			void setAttribute(std::string_view key, std::string_view value);
+
+		private:
+			Trace*		_trace {};
+			std::size_t	_index {};
+	};
+}
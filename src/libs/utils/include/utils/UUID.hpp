@@ -19,29 +19,65 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "utils/String.hpp"
 
+// 16 byte binary UUID
 class UUID
 {
 	public:
+		static constexpr std::size_t byteCount {16};
+		using Bytes = std::array<std::uint8_t, byteCount>;
 
+		// Accepts the 8-4-4-4-12 hex form, case insensitive
 		static std::optional<UUID> fromString(std::string_view str);
+		// nullopt if bytes is not byteCount long (empty for instance)
+		static std::optional<UUID> fromBytes(const std::vector<unsigned char>& bytes);
 
-		std::string_view getAsString() const { return _value; }
+		// Lower case, 8-4-4-4-12 form
+		std::string getAsString() const;
+		std::vector<unsigned char> getAsBytes() const { return {std::cbegin(_bytes), std::cend(_bytes)}; }
+		const Bytes& getBytes() const { return _bytes; }
+
+		bool operator==(const UUID& other) const { return _bytes == other._bytes; }
+		bool operator!=(const UUID& other) const { return _bytes != other._bytes; }
+		bool operator<(const UUID& other) const { return _bytes < other._bytes; }
 
 	private:
-		UUID(std::string_view value);
-		std::string _value;
+		UUID(const Bytes& bytes) : _bytes {bytes} {}
+		Bytes _bytes;
 };
 
+namespace std
+{
+	template <>
+	struct hash<UUID>
+	{
+		std::size_t operator()(const UUID& uuid) const
+		{
+			// UUIDs are already well distributed, just fold them
+			const UUID::Bytes& bytes {uuid.getBytes()};
+
+			std::uint64_t res {};
+			for (std::size_t i {}; i < bytes.size(); ++i)
+				res ^= static_cast<std::uint64_t>(bytes[i]) << ((i % 8) * 8);
+
+			return std::hash<std::uint64_t> {}(res);
+		}
+	};
+}
+
 namespace StringUtils
 {
 	template <>
 	std::optional<UUID>
-	readAs(const std::string& str);
+	readAs(std::string_view str);
 }
 
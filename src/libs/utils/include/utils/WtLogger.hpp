@@ -19,11 +19,65 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include "Logger.hpp"
 
+// Logs are written by a background thread
+// They are pushed into a lock free queue, only written synchronously if this queue is full
 class WtLogger final : public Logger
 {
 	public:
+		WtLogger();
+		~WtLogger();
+
+		WtLogger(const WtLogger&) = delete;
+		WtLogger(WtLogger&&) = delete;
+		WtLogger& operator=(const WtLogger&) = delete;
+		WtLogger& operator=(WtLogger&&) = delete;
+
+		// Only depends on the severity, using the Wt log configuration
+		bool isEnabled(Module module, Severity severity) const override;
 		void processLog(const Log& log) override;
-};
 
+	private:
+		struct Record
+		{
+			Severity	severity;
+			Module		module;
+			std::string	message;
+		};
+
+		// Bounded multiple producers, single consumer queue
+		struct Slot
+		{
+			std::atomic<std::size_t>	sequence;
+			Record						record;
+		};
+
+		static constexpr std::size_t queueSize {8192}; // must be a power of 2
+
+		static void writeRecord(const Record& record);
+		bool push(Record&& record);
+		bool pop(Record& record);
+		void run();
+
+		// per severity: -1 if not yet known, depends on the Wt log configuration
+		mutable std::array<std::atomic<int>, 5> _activeSeverities;
+
+		std::unique_ptr<Slot[]>		_slots;
+		alignas(64) std::atomic<std::size_t> _pushPosition {};
+		alignas(64) std::size_t		_popPosition {};	// only used by the writer thread
+
+		std::mutex					_mutex;
+		std::condition_variable		_quitCondition;
+		bool						_quit {};
+		std::thread					_thread;
+};
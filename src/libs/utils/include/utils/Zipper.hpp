@@ -19,8 +19,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <map>
+#include <optional>
+#include <vector>
 
 #include <Wt/WDateTime.h>
 
@@ -36,12 +39,32 @@ namespace Zip
 		using LmsException::LmsException;
 	};
 
+	struct FileEntry
+	{
+		std::filesystem::path			path;
+		std::optional<std::uint32_t>	crc32;	// if known, written up front instead of in a data descriptor
+		Wt::WDateTime					crc32FileLastWrite;	// crc32 is ignored if the file has been written since
+
+		// If both known (as stored in the database), the file is not accessed until its data is written
+		// Opening the file then fails if it does not match anymore
+		std::optional<SizeType>			fileSize;
+		Wt::WDateTime					fileLastWrite;
+	};
+
 	// Very simple on-the-fly zip creator, "store" method only
 	class Zipper
 	{
 		public:
 
-			Zipper(const std::map<std::string, std::filesystem::path>& files, const Wt::WDateTime& lastModifiedTime = {});
+			// files: by name in the archive
+			// Files are only opened while their data is written
+			Zipper(const std::map<std::string, FileEntry>& files, const Wt::WDateTime& lastModifiedTime = {});
+			~Zipper();
+
+			Zipper(const Zipper&) = delete;
+			Zipper(Zipper&&) = delete;
+			Zipper& operator=(const Zipper&) = delete;
+			Zipper& operator=(Zipper&&) = delete;
 
 			static constexpr SizeType minOutputBufferSize {64};
 			SizeType writeSome(std::byte* buffer, SizeType bufferSize);
@@ -49,8 +72,29 @@ namespace Zip
 
 			SizeType getTotalZipFile() const { return _totalZipSize; }
 
+			// Changes with anything that affects the generated bytes (file names, sizes, dates, known CRC32s)
+			std::uint32_t getLayoutChecksum() const { return _layoutChecksum; }
+
+			// Skip the first bytes of the archive, must be called before writing anything
+			// The file data is only read if its CRC32 is not known
+			void seek(SizeType offset);
+
+			// CRC32 of the files that had no known CRC32, once complete
+			struct ComputedCrc32
+			{
+				std::filesystem::path	path;
+				Wt::WDateTime			fileLastWrite;	// when the zipper was created
+				std::uint32_t			crc32;
+			};
+			std::vector<ComputedCrc32> getComputedCrc32s() const;
+
 		private:
 			void setComplete();
+			SizeType writeStep(std::byte* buffer, SizeType bufferSize);
+			SizeType writePendingBytes(std::byte* buffer, SizeType bufferSize);
+			void openCurrentFile();
+			void closeCurrentFile();
+			void readAhead(SizeType readAheadSize);
 
 			SizeType writeLocalFileHeader(std::byte* buffer, SizeType bufferSize);
 			SizeType writeLocalFileHeaderFileName(std::byte* buffer, SizeType bufferSize);
@@ -68,14 +112,19 @@ namespace Zip
 			{
 				std::filesystem::path filePath;
 				SizeType fileSize;
+				Wt::WDateTime fileLastWrite;
 				Wt::WDateTime lastModifiedTime;
-				Utils::Crc32Calculator fileCrc32;
+				std::optional<std::uint32_t> knownCrc32;
+				Utils::Crc32Calculator fileCrc32; // only computed if not known
+				std::uint32_t getCrc32() const { return knownCrc32 ? *knownCrc32 : fileCrc32.getResult(); }
 				SizeType localFileHeaderOffset {};
 			};
 
 			using FileContainer = std::map<std::string, FileContext>;
 			FileContainer _files;
 
+			static int openFile(const FileContext& fileContext);
+
 			enum class WriteState
 			{
 				LocalFileHeader,
@@ -93,13 +142,19 @@ namespace Zip
 			};
 
 			SizeType _totalZipSize {};
+			std::uint32_t _layoutChecksum {};
 			WriteState _writeState {WriteState::LocalFileHeader};
 			FileContainer::iterator _currentFile;
+			int _currentFileFd {-1};	// kept open while the file data is being written
+			FileContainer::iterator _nextFile;
+			int _nextFileFd {-1};		// _nextFile, opened ahead to prefetch its first bytes
+			static constexpr SizeType readAheadChunkCount {4};	// in output buffer sizes
 			SizeType _currentOffset {};
 			SizeType _currentZipOffset {};
 			SizeType _centralDirectoryOffset {};
 			SizeType _centralDirectorySize {};
 			SizeType _zip64EndOfCentralDirectoryRecordOffset {};
+			std::vector<std::byte> _pendingBytes;	// remaining part of a record partially skipped by seek()
 	};
 
 } // namespace Zip
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MetricsResource.hpp"
+
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include <unistd.h>
+
+#include <Wt/Http/Response.h>
+
+#include "av/TranscodeStats.hpp"
+#include "database/QueryStats.hpp"
+#include "subsonic/RequestStats.hpp"
+#include "ui/LmsApplication.hpp"
+#include "utils/Metrics.hpp"
+
+namespace {
+
+	double
+	toSeconds(std::chrono::microseconds duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	std::string
+	escapeLabelValue(const std::string& value)
+	{
+		std::string res;
+		res.reserve(value.size());
+
+		for (const char c : value)
+		{
+			switch (c)
+			{
+				case '\\':	res += "\\\\"; break;
+				case '"':	res += "\\\""; break;
+				case '\n':	res += "\\n"; break;
+				default:	res += c; break;
+			}
+		}
+
+		return res;
+	}
+
+	std::optional<std::size_t>
+	getResidentMemorySize()
+	{
+		std::ifstream statm {"/proc/self/statm"};
+
+		std::size_t totalPages {};
+		std::size_t residentPages {};
+		if (!(statm >> totalPages >> residentPages))
+			return std::nullopt;
+
+		return residentPages * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	}
+
+	void
+	writeHeader(std::ostream& os, const char* name, const char* type, const char* help)
+	{
+		os << "# HELP " << name << " " << help << "\n";
+		os << "# TYPE " << name << " " << type << "\n";
+	}
+
+	// Registry names may carry labels, as in family{label="value"}: returns the family and the labels
+	std::pair<std::string, std::string>
+	splitRegistryName(const std::string& name)
+	{
+		const std::size_t labelsPos {name.find('{')};
+		if (labelsPos == std::string::npos || name.back() != '}')
+			return {name, ""};
+
+		return {name.substr(0, labelsPos), name.substr(labelsPos + 1, name.size() - labelsPos - 2)};
+	}
+
+	template <typename Func>
+	void
+	writeQueryMetric(std::ostream& os, const Database::QueryStats::Snapshot& snapshot, const char* name, const char* type, const char* help, Func func)
+	{
+		writeHeader(os, name, type, help);
+		for (const auto& [queryShape, stats] : snapshot.queries)
+			os << name << "{query=\"" << escapeLabelValue(queryShape) << "\"} " << func(stats) << "\n";
+	}
+
+	template <typename Func>
+	void
+	writeLockWaitMetric(std::ostream& os, const Database::QueryStats::Snapshot& snapshot, const char* name, const char* type, const char* help, Func func)
+	{
+		writeHeader(os, name, type, help);
+		os << name << "{transaction=\"shared\"} " << func(snapshot.sharedTransactions) << "\n";
+		os << name << "{transaction=\"unique\"} " << func(snapshot.uniqueTransactions) << "\n";
+	}
+
+	template <typename Func>
+	void
+	writeEndpointMetric(std::ostream& os, const API::Subsonic::RequestStats::Snapshot& snapshot, const char* name, const char* type, const char* help, Func func)
+	{
+		writeHeader(os, name, type, help);
+		for (const auto& [endpoint, stats] : snapshot)
+			os << name << "{endpoint=\"" << escapeLabelValue(endpoint) << "\"} " << func(stats) << "\n";
+	}
+
+} // namespace
+
+MetricsResource::MetricsResource(const Database::QueryStats* queryStats, const API::Subsonic::RequestStats* subsonicRequestStats)
+: _queryStats {queryStats}
+, _subsonicRequestStats {subsonicRequestStats}
+{
+}
+
+MetricsResource::~MetricsResource()
+{
+	beingDeleted();
+}
+
+void
+MetricsResource::handleRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+{
+	using Database::QueryStats;
+
+	response.setMimeType("text/plain; version=0.0.4");
+	std::ostream& os {response.out()};
+
+	const Av::TranscodeStats transcodeStats {Av::getTranscodeStats()};
+	writeHeader(os, "lms_transcode_running", "gauge", "Number of running transcodes");
+	os << "lms_transcode_running " << transcodeStats.runningCount << "\n";
+	writeHeader(os, "lms_transcode_queued", "gauge", "Number of transcodes waiting to be run, by priority");
+	os << "lms_transcode_queued{priority=\"interactive\"} " << transcodeStats.queuedInteractiveCount << "\n";
+	os << "lms_transcode_queued{priority=\"background\"} " << transcodeStats.queuedBackgroundCount << "\n";
+	os << "lms_transcode_queued{priority=\"idle\"} " << transcodeStats.queuedIdleCount << "\n";
+
+	writeMemoryMetrics(os);
+	writeRegistryMetrics(os);
+
+	if (_subsonicRequestStats)
+		writeSubsonicRequestMetrics(os);
+
+	if (!_queryStats)
+		return;
+
+	const QueryStats::Snapshot snapshot {_queryStats->getSnapshot()};
+
+	writeQueryMetric(os, snapshot, "lms_db_query_count", "counter", "Number of executions, by query shape",
+			[](const QueryStats::QueryShapeStats& stats) { return stats.count; });
+	writeQueryMetric(os, snapshot, "lms_db_query_rows_total", "counter", "Number of returned rows, by query shape",
+			[](const QueryStats::QueryShapeStats& stats) { return stats.rowCount; });
+	writeQueryMetric(os, snapshot, "lms_db_query_duration_seconds_total", "counter", "Time spent executing the query and fetching its rows, by query shape",
+			[](const QueryStats::QueryShapeStats& stats) { return toSeconds(stats.totalDuration); });
+	writeQueryMetric(os, snapshot, "lms_db_query_duration_seconds_max", "gauge", "Longest execution, by query shape",
+			[](const QueryStats::QueryShapeStats& stats) { return toSeconds(stats.maxDuration); });
+
+	writeLockWaitMetric(os, snapshot, "lms_db_transaction_lock_waits_total", "counter", "Number of transactions that acquired the database lock",
+			[](const QueryStats::LockWaitStats& stats) { return stats.count; });
+	writeLockWaitMetric(os, snapshot, "lms_db_transaction_lock_wait_seconds_total", "counter", "Time spent waiting for the database lock",
+			[](const QueryStats::LockWaitStats& stats) { return toSeconds(stats.totalWait); });
+	writeLockWaitMetric(os, snapshot, "lms_db_transaction_lock_wait_seconds_max", "gauge", "Longest wait for the database lock",
+			[](const QueryStats::LockWaitStats& stats) { return toSeconds(stats.maxWait); });
+}
+
+void
+MetricsResource::writeMemoryMetrics(std::ostream& os) const
+{
+	const std::size_t sessionCount {UserInterface::LmsApplication::getSessionCount()};
+	writeHeader(os, "lms_ui_sessions", "gauge", "Number of web UI sessions");
+	os << "lms_ui_sessions " << sessionCount << "\n";
+
+	const std::optional<std::size_t> residentMemorySize {getResidentMemorySize()};
+	if (!residentMemorySize)
+		return;
+
+	writeHeader(os, "lms_process_resident_memory_bytes", "gauge", "Resident memory size of the process");
+	os << "lms_process_resident_memory_bytes " << *residentMemorySize << "\n";
+
+	// Also accounts for the memory shared by all the sessions: only meaningful with many sessions or when compared over time
+	if (sessionCount > 0)
+	{
+		writeHeader(os, "lms_ui_session_resident_memory_bytes", "gauge", "Resident memory size of the process divided by the number of web UI sessions");
+		os << "lms_ui_session_resident_memory_bytes " << *residentMemorySize / sessionCount << "\n";
+	}
+}
+
+void
+MetricsResource::writeRegistryMetrics(std::ostream& os) const
+{
+	const Metrics::Snapshot snapshot {Metrics::getSnapshot()};
+
+	// Names are sorted: the metrics of a family are adjacent and share a single header
+	std::string lastFamily;
+	auto writeFamilyHeader {[&](const std::string& family, const char* type, const std::string& help)
+	{
+		if (family == lastFamily)
+			return;
+
+		writeHeader(os, family.c_str(), type, help.c_str());
+		lastFamily = family;
+	}};
+
+	for (const auto& [name, counter] : snapshot.counters)
+	{
+		writeFamilyHeader(splitRegistryName(name).first, "counter", counter.help);
+		os << name << " " << counter.value << "\n";
+	}
+
+	for (const auto& [name, gauge] : snapshot.gauges)
+	{
+		writeFamilyHeader(splitRegistryName(name).first, "gauge", gauge.help);
+		os << name << " " << gauge.value << "\n";
+	}
+
+	// Exported as summaries: the registry buckets are too fine grained to be sent as is
+	for (const auto& [name, histogram] : snapshot.histograms)
+	{
+		const auto [family, labels] {splitRegistryName(name)};
+		writeFamilyHeader(family, "summary", histogram.help);
+
+		const std::string quantileLabelPrefix {labels.empty() ? "" : labels + ","};
+		for (const double quantile : {0.5, 0.9, 0.99})
+			os << family << "{" << quantileLabelPrefix << "quantile=\"" << quantile << "\"} " << toSeconds(histogram.value.getPercentile(quantile)) << "\n";
+
+		const std::string labelSuffix {labels.empty() ? "" : "{" + labels + "}"};
+		os << family << "_sum" << labelSuffix << " " << toSeconds(histogram.value.sum) << "\n";
+		os << family << "_count" << labelSuffix << " " << histogram.value.count << "\n";
+	}
+}
+
+void
+MetricsResource::writeSubsonicRequestMetrics(std::ostream& os) const
+{
+	using API::Subsonic::RequestStats;
+
+	const RequestStats::Snapshot snapshot {_subsonicRequestStats->getSnapshot()};
+
+	writeEndpointMetric(os, snapshot, "lms_subsonic_requests_total", "counter", "Number of Subsonic API requests, by endpoint",
+			[](const RequestStats::EndpointStats& stats) { return stats.count; });
+	writeEndpointMetric(os, snapshot, "lms_subsonic_request_errors_total", "counter", "Number of Subsonic API requests that ended with an error, by endpoint",
+			[](const RequestStats::EndpointStats& stats) { return stats.errorCount; });
+	writeEndpointMetric(os, snapshot, "lms_subsonic_response_bytes_total", "counter", "Size of the serialized Subsonic API responses, by endpoint",
+			[](const RequestStats::EndpointStats& stats) { return stats.responseBytes; });
+	writeEndpointMetric(os, snapshot, "lms_subsonic_request_auth_seconds_total", "counter", "Time spent authenticating the Subsonic API requests, by endpoint",
+			[](const RequestStats::EndpointStats& stats) { return toSeconds(stats.totalAuthDuration); });
+	writeEndpointMetric(os, snapshot, "lms_subsonic_request_handler_seconds_total", "counter", "Time spent in the Subsonic API handlers, including the database queries, by endpoint",
+			[](const RequestStats::EndpointStats& stats) { return toSeconds(stats.totalHandlerDuration); });
+	writeEndpointMetric(os, snapshot, "lms_subsonic_request_serialization_seconds_total", "counter", "Time spent serializing the Subsonic API responses, by endpoint",
+			[](const RequestStats::EndpointStats& stats) { return toSeconds(stats.totalSerializationDuration); });
+
+	constexpr const char* durationName {"lms_subsonic_request_duration_seconds"};
+	writeHeader(os, durationName, "histogram", "Subsonic API request latencies, by endpoint");
+	for (const auto& [endpoint, stats] : snapshot)
+	{
+		const std::string label {escapeLabelValue(endpoint)};
+
+		std::size_t cumulativeCount {};
+		for (std::size_t i {}; i < RequestStats::latencyBuckets.size(); ++i)
+		{
+			cumulativeCount += stats.latencyBucketCounts[i];
+			os << durationName << "_bucket{endpoint=\"" << label << "\",le=\"" << std::chrono::duration<double>(RequestStats::latencyBuckets[i]).count() << "\"} " << cumulativeCount << "\n";
+		}
+		os << durationName << "_bucket{endpoint=\"" << label << "\",le=\"+Inf\"} " << stats.count << "\n";
+		os << durationName << "_sum{endpoint=\"" << label << "\"} " << toSeconds(stats.totalDuration) << "\n";
+		os << durationName << "_count{endpoint=\"" << label << "\"} " << stats.count << "\n";
+	}
+}
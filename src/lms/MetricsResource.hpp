@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Wt/WResource.h>
+
+namespace Database
+{
+	class QueryStats;
+}
+
+namespace API::Subsonic
+{
+	class RequestStats;
+}
+
+// Exposes the transcode stats, the memory usage, the process wide metrics registry, the database query stats and the Subsonic API request stats (if any), using the Prometheus text format
+class MetricsResource final : public Wt::WResource
+{
+	public:
+		MetricsResource(const Database::QueryStats* queryStats, const API::Subsonic::RequestStats* subsonicRequestStats);
+		~MetricsResource();
+
+		static std::string getPath() { return "metrics"; }
+
+	private:
+		void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+		void writeMemoryMetrics(std::ostream& os) const;
+		void writeRegistryMetrics(std::ostream& os) const;
+		void writeSubsonicRequestMetrics(std::ostream& os) const;
+
+		const Database::QueryStats* _queryStats;
+		const API::Subsonic::RequestStats* _subsonicRequestStats;
+};
+
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PreTranscoder.hpp"
+
+#include <set>
+#include <string>
+
+#include "av/PreTranscode.hpp"
+#include "database/Db.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+#include "database/TrackList.hpp"
+#include "database/User.hpp"
+#include "utils/Logger.hpp"
+
+namespace {
+
+	Av::Format
+	userTranscodeFormatToAvFormat(Database::AudioFormat format)
+	{
+		switch (format)
+		{
+			case Database::AudioFormat::MP3:			return Av::Format::MP3;
+			case Database::AudioFormat::OGG_OPUS:		return Av::Format::OGG_OPUS;
+			case Database::AudioFormat::MATROSKA_OPUS:	return Av::Format::MATROSKA_OPUS;
+			case Database::AudioFormat::OGG_VORBIS:		return Av::Format::OGG_VORBIS;
+			case Database::AudioFormat::WEBM_VORBIS:	return Av::Format::WEBM_VORBIS;
+			default:									return Av::Format::OGG_OPUS;
+		}
+	}
+
+} // namespace
+
+PreTranscoder::PreTranscoder(Database::Db& db, std::size_t trackCount, const std::vector<std::size_t>& webBitrates)
+: _db {db}
+, _trackCount {trackCount}
+, _webBitrates {webBitrates}
+{
+	LMS_LOG(TRANSCODE, INFO) << "Pre-transcoding the " << _trackCount << " most played tracks of each user";
+
+	_thread = std::thread {[this] { run(); }};
+}
+
+PreTranscoder::~PreTranscoder()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+	}
+	_condition.notify_all();
+
+	_thread.join();
+}
+
+void
+PreTranscoder::requestRun()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_runRequested = true;
+	}
+	_condition.notify_all();
+}
+
+void
+PreTranscoder::run()
+{
+	while (true)
+	{
+		{
+			std::unique_lock lock {_mutex};
+
+			_condition.wait(lock, [&] { return _quit || _runRequested; });
+			if (_quit)
+				return;
+
+			_runRequested = false;
+		}
+
+		const std::vector<Job> jobs {getJobs()};
+
+		LMS_LOG(TRANSCODE, INFO) << "Pre-transcode started, " << jobs.size() << " transcode(s) to check";
+
+		std::size_t failedCount {};
+		for (const Job& job : jobs)
+		{
+			if (_quit)
+				return;
+
+			if (!Av::preTranscode(job.trackPath, job.parameters, _quit) && !_quit)
+			{
+				LMS_LOG(TRANSCODE, ERROR) << "Cannot pre-transcode '" << job.trackPath.string() << "'";
+				failedCount++;
+			}
+		}
+
+		LMS_LOG(TRANSCODE, INFO) << "Pre-transcode complete, " << failedCount << " failure(s)";
+	}
+}
+
+std::vector<PreTranscoder::Job>
+PreTranscoder::getJobs()
+{
+	std::vector<Job> jobs;
+	std::set<std::string> keys;
+
+	auto addJob {[&](const std::filesystem::path& trackPath, const Av::TranscodeParameters& parameters)
+	{
+		// Users share the same outputs
+		if (keys.insert(Av::computeTranscodeKey(trackPath, parameters)).second)
+			jobs.push_back(Job {trackPath, parameters});
+	}};
+
+	Database::Session session {_db};
+	auto transaction {session.createSharedTransaction()};
+
+	for (const Database::User::pointer& user : Database::User::getAll(session))
+	{
+		const Database::TrackList::pointer playedTrackList {user->getPlayedTrackList(session)};
+		if (!playedTrackList)
+			continue;
+
+		bool moreResults;
+		for (const Database::Track::pointer& track : playedTrackList->getTopTracks({}, Database::Range {0, _trackCount}, moreResults))
+		{
+			// Same parameters as the ones used by the Subsonic API and by the web player when streaming whole tracks
+			if (user->getSubsonicTranscodeEnable())
+			{
+				Av::TranscodeParameters parameters;
+				parameters.format = userTranscodeFormatToAvFormat(user->getSubsonicTranscodeFormat());
+				parameters.bitrate = user->getSubsonicTranscodeBitrate();
+				parameters.stripMetadata = false;
+				addJob(track->getPath(), parameters);
+			}
+
+			for (const std::size_t bitrate : _webBitrates)
+			{
+				Av::TranscodeParameters parameters;
+				parameters.format = Av::Format::OGG_OPUS; // web player default format
+				parameters.bitrate = bitrate;
+				parameters.stripMetadata = true;
+				addJob(track->getPath(), parameters);
+			}
+		}
+	}
+
+	return jobs;
+}
+
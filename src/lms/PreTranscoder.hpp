@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "av/AvTranscoder.hpp"
+
+namespace Database
+{
+	class Db;
+}
+
+// Fills the transcode cache with the most played tracks of each user, so that they can be played without waiting for the transcoder
+// Runs on its own thread, each time a run is requested
+class PreTranscoder
+{
+	public:
+		// trackCount: number of most played tracks per user
+		// webBitrates: bitrates of the web player transcodes, in bps
+		PreTranscoder(Database::Db& db, std::size_t trackCount, const std::vector<std::size_t>& webBitrates);
+		~PreTranscoder();
+
+		PreTranscoder(const PreTranscoder&) = delete;
+		PreTranscoder(PreTranscoder&&) = delete;
+		PreTranscoder& operator=(const PreTranscoder&) = delete;
+		PreTranscoder& operator=(PreTranscoder&&) = delete;
+
+		// Does nothing if a run is already requested, can be called from any thread
+		void requestRun();
+
+	private:
+		struct Job
+		{
+			std::filesystem::path		trackPath;
+			Av::TranscodeParameters		parameters;
+		};
+
+		void run();
+		std::vector<Job> getJobs();
+
+		Database::Db&					_db;
+		const std::size_t				_trackCount;
+		const std::vector<std::size_t>	_webBitrates;
+
+		std::mutex					_mutex;
+		std::condition_variable		_condition;
+		bool						_runRequested {};
+		std::atomic<bool>			_quit {};
+		std::thread					_thread;
+};
+
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ReadinessResource.hpp"
+
+#include <algorithm>
+#include <ostream>
+
+#include <Wt/Http/Response.h>
+
+#include "utils/Readiness.hpp"
+
+ReadinessResource::~ReadinessResource()
+{
+	beingDeleted();
+}
+
+void
+ReadinessResource::handleRequest(const Wt::Http::Request&, Wt::Http::Response& response)
+{
+	// States are taken first, so that the status is consistent with the listed subsystems
+	const std::vector<Readiness::SubsystemState> states {Readiness::getStates()};
+	const bool ready {std::all_of(std::cbegin(states), std::cend(states), [](const Readiness::SubsystemState& state) { return state.warmUpDuration.has_value(); })};
+
+	response.setStatus(ready ? 200 : 503);
+	response.setMimeType("text/plain");
+	response.addHeader("Cache-Control", "no-store");
+
+	std::ostream& os {response.out()};
+	os << (ready ? "ready" : "warming") << "\n";
+	for (const Readiness::SubsystemState& state : states)
+	{
+		os << state.name << " ";
+		if (state.warmUpDuration)
+			os << "ready " << state.warmUpDuration->count() << " ms\n";
+		else
+			os << "pending\n";
+	}
+}
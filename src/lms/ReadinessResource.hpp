@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Wt/WResource.h>
+
+// Reports the readiness of the subsystems that warm up after startup (see utils/Readiness.hpp), for load balancers
+// Status is 200 once all of them are ready and 503 before, the body lists the state of each subsystem
+class ReadinessResource final : public Wt::WResource
+{
+	public:
+		~ReadinessResource();
+
+		static std::string getPath() { return "ready"; }
+
+	private:
+		void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+};
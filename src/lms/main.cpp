@@ -17,8 +17,14 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
+#include <csignal>
+#include <future>
+#include <string_view>
 #include <thread>
 
+#include <pthread.h>
+
 #include <boost/property_tree/xml_parser.hpp>
 
 #include <Wt/WServer.h>
@@ -28,16 +34,190 @@
 #include "auth/IPasswordService.hpp"
 #include "av/AvInfo.hpp"
 #include "av/AvTranscoder.hpp"
+#include "av/ITranscodeCache.hpp"
+#include "av/TranscodeStats.hpp"
 #include "cover/ICoverArtGrabber.hpp"
 #include "database/Db.hpp"
+#include "database/QueryStats.hpp"
 #include "database/Session.hpp"
 #include "scanner/IMediaScanner.hpp"
 #include "recommendation/IEngine.hpp"
 #include "subsonic/SubsonicResource.hpp"
+#include "ui/LibraryCache.hpp"
 #include "ui/LmsApplication.hpp"
+#include "utils/CpuAffinity.hpp"
+#include "utils/Exception.hpp"
+#include "utils/Executor.hpp"
 #include "utils/IConfig.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/ProfiledMutex.hpp"
+#include "utils/Readiness.hpp"
+#include "utils/SamplingProfiler.hpp"
+#include "utils/Scheduler.hpp"
 #include "utils/Service.hpp"
+#include "utils/String.hpp"
+#include "utils/Tracing.hpp"
 #include "utils/WtLogger.hpp"
+#include "MetricsResource.hpp"
+#include "PreTranscoder.hpp"
+#include "ReadinessResource.hpp"
+
+static
+unsigned long
+getHttpServerThreadCount()
+{
+	const unsigned long configHttpServerThreadCount {Service<IConfig>::get()->getULong("http-server-thread-count", 0)};
+
+	// Reserve at least 2 threads since we still have some blocking IO (for example when reading from ffmpeg)
+	return configHttpServerThreadCount ? configHttpServerThreadCount : std::max<unsigned long>(2, std::thread::hardware_concurrency());
+}
+
+static
+std::size_t
+getCpuThreadCount()
+{
+	const unsigned long configCpuThreadCount {Service<IConfig>::get()->getULong("cpu-thread-count", 0)};
+
+	return configCpuThreadCount ? configCpuThreadCount : std::max<unsigned long>(1, std::thread::hardware_concurrency());
+}
+
+static
+std::size_t
+getDbReadConnectionCount()
+{
+	const unsigned long configDbReadConnectionCount {Service<IConfig>::get()->getULong("db-read-connection-count", 0)};
+
+	// One connection per http server thread and per CPU executor thread, plus some for the background services (scanner, recommendation engine, ...)
+	return configDbReadConnectionCount ? configDbReadConnectionCount : getHttpServerThreadCount() + getCpuThreadCount() + 4;
+}
+
+static
+Database::ConnectionSettings
+getDbConnectionSettings()
+{
+	IConfig& config {*Service<IConfig>::get()};
+
+	Database::ConnectionSettings settings;
+
+	if (const unsigned long cacheSizeKiB {config.getULong("db-cache-size", 0)})
+		settings.cacheSizeKiB = cacheSizeKiB;
+	if (const unsigned long mmapSizeMiB {config.getULong("db-mmap-size", 0)})
+		settings.mmapSize = static_cast<std::size_t>(mmapSizeMiB) * 1024 * 1024;
+	settings.tempStoreInMemory = config.getBool("db-temp-store-memory", false);
+	if (const unsigned long busyTimeout {config.getULong("db-busy-timeout", 0)})
+		settings.busyTimeout = std::chrono::milliseconds {busyTimeout};
+	if (const long walAutoCheckpoint {config.getLong("db-wal-autocheckpoint", -1)}; walAutoCheckpoint >= 0)
+		settings.walAutoCheckpoint = static_cast<std::size_t>(walAutoCheckpoint);
+	settings.statementCacheMaxSize = config.getULong("db-statement-cache-max-size", 256);
+
+	return settings;
+}
+
+static
+Database::QueryStatsSettings
+getDbQueryStatsSettings()
+{
+	IConfig& config {*Service<IConfig>::get()};
+
+	Database::QueryStatsSettings settings;
+
+	settings.enabled = config.getBool("db-query-stats", false);
+	if (const unsigned long slowQueryThreshold {config.getULong("db-slow-query-threshold", 0)})
+		settings.slowQueryThreshold = std::chrono::milliseconds {slowQueryThreshold};
+
+	return settings;
+}
+
+static
+Tracing::Settings
+getTracingSettings()
+{
+	IConfig& config {*Service<IConfig>::get()};
+
+	Tracing::Settings settings;
+
+	settings.samplePercent = std::min<unsigned long>(100, config.getULong("tracing-sample-percent", 0));
+	if (const unsigned long slowRequestThreshold {config.getULong("tracing-slow-request-threshold", 0)})
+		settings.slowThreshold = std::chrono::milliseconds {slowRequestThreshold};
+	settings.outputFile = config.getPath("tracing-file", "");
+
+	return settings;
+}
+
+// Logs the time elapsed since the previous startup phase
+class StartupPhaseTimer
+{
+	public:
+		std::chrono::milliseconds phaseDone(std::string_view phase)
+		{
+			const auto now {std::chrono::steady_clock::now()};
+			const auto duration {std::chrono::duration_cast<std::chrono::milliseconds>(now - _phaseStart)};
+			_phaseStart = now;
+
+			LMS_LOG(MAIN, INFO) << "Startup phase '" << phase << "' done in " << duration.count() << " ms (total " << std::chrono::duration_cast<std::chrono::milliseconds>(now - _start).count() << " ms)";
+			return duration;
+		}
+
+	private:
+		const std::chrono::steady_clock::time_point _start {std::chrono::steady_clock::now()};
+		std::chrono::steady_clock::time_point _phaseStart {_start};
+};
+
+// Settings that can be changed while running, on SIGHUP or from the admin interface
+// Others (http server and CPU threads, database connections, disk caches, ...) need a restart
+static
+void
+reloadSettings()
+{
+	IConfig& config {*Service<IConfig>::get()};
+
+	try
+	{
+		config.reload();
+	}
+	catch (const LmsException& e)
+	{
+		LMS_LOG(MAIN, ERROR) << "Cannot reload settings: " << e.what();
+		return;
+	}
+
+	Service<MediaIOExecutor>::get()->setThreadCount(config.getULong("media-io-thread-count", 4));
+	Service<Scheduler>::get()->setThreadCount(Scheduler::TaskClass::Cpu, config.getULong("background-cpu-thread-count", 0));
+	Service<Scheduler>::get()->setThreadCount(Scheduler::TaskClass::IO, config.getULong("background-io-thread-count", 0));
+
+	const std::size_t maxThrottlerEntryCount {config.getULong("login-throttler-max-entries", 10000)};
+	Service<Auth::IAuthTokenService>::get()->setMaxThrottlerEntryCount(maxThrottlerEntryCount);
+	Service<Auth::IPasswordService>::get()->setMaxThrottlerEntryCount(maxThrottlerEntryCount);
+	Service<Auth::IPasswordService>::get()->setCheckLimits(config.getULong("login-max-concurrent-password-checks", 0),
+			config.getULong("login-max-pending-password-checks", 16));
+
+	Service<CoverArt::IGrabber>::get()->setMaxCacheSize(config.getULong("cover-max-cache-size", 30) * 1000 * 1000);
+
+	Av::setTranscodeLimits(config.getULong("transcode-max-concurrent", 0), config.getULong("transcode-max-concurrent-per-user", 0));
+}
+
+// Replaces Wt::WServer::waitForShutdown, that does not return on SIGHUP
+// The signals must have been blocked in all the threads
+static
+void
+waitForShutdown(const sigset_t& signals)
+{
+	while (true)
+	{
+		int signal {};
+		if (::sigwait(&signals, &signal) != 0)
+			continue;
+
+		if (signal != SIGHUP)
+		{
+			LMS_LOG(MAIN, INFO) << "Received signal " << signal;
+			return;
+		}
+
+		LMS_LOG(MAIN, INFO) << "Received SIGHUP, reloading settings...";
+		reloadSettings();
+	}
+}
 
 static
 std::vector<std::string>
@@ -49,7 +229,6 @@ generateWtConfig(std::string execPath)
 	const std::filesystem::path wtLogFilePath {Service<IConfig>::get()->getPath("log-file", "/var/log/lms.log")};
 	const std::filesystem::path wtAccessLogFilePath {Service<IConfig>::get()->getPath("access-log-file", "/var/log/lms.access.log")};
 	const std::filesystem::path wtResourcesPath {Service<IConfig>::get()->getPath("wt-resources", "/usr/share/Wt/resources")};
-	const unsigned long configHttpServerThreadCount {Service<IConfig>::get()->getULong("http-server-thread-count", 0)};
 
 	args.push_back(execPath);
 	args.push_back("--config=" + wtConfigPath.string());
@@ -76,11 +255,7 @@ generateWtConfig(std::string execPath)
 	if (!wtAccessLogFilePath.empty())
 		args.push_back("--accesslog=" + wtAccessLogFilePath.string());
 
-	{
-		// Reserve at least 2 threads since we still have some blocking IO (for example when reading from ffmpeg)
-		const unsigned long httpServerThreadCount {configHttpServerThreadCount ? configHttpServerThreadCount : std::max<unsigned long>(2, std::thread::hardware_concurrency())};
-		args.push_back("--threads=" + std::to_string(httpServerThreadCount));
-	}
+	args.push_back("--threads=" + std::to_string(getHttpServerThreadCount()));
 
 	// Generate the wt_config.xml file
 	boost::property_tree::ptree pt;
@@ -137,6 +312,13 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 
+	// Blocked before any thread is created, so that they are only handled by waitForShutdown
+	sigset_t signals;
+	sigemptyset(&signals);
+	for (const int signal : {SIGHUP, SIGINT, SIGQUIT, SIGTERM})
+		sigaddset(&signals, signal);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
 	try
 	{
 		// Make pstream work with ffmpeg
@@ -144,6 +326,13 @@ int main(int argc, char* argv[])
 
 		Service<IConfig> config {createConfig(configFilePath)};
 		Service<Logger> logger {std::make_unique<WtLogger>()};
+		Tracing::setup(getTracingSettings());
+		LockProfiling::setEnabled(config->getBool("lock-profiling", false));
+		SamplingProfiler::setEnabled(config->getBool("sampling-profiler", false));
+
+		// Latency sensitive request work is kept away from the background and transcode work
+		const CpuAffinity::CpuSet httpCpuSet {CpuAffinity::parseCpuSet(config->getString("http-cpu-set", ""))};
+		const CpuAffinity::CpuSet backgroundCpuSet {CpuAffinity::parseCpuSet(config->getString("background-cpu-set", ""))};
 
 		// Make sure the working directory exists
 		std::filesystem::create_directories(config->getPath("working-dir"));
@@ -162,53 +351,151 @@ int main(int argc, char* argv[])
 		Wt::WServer server {argv[0]};
 		server.setServerConfiguration(wtServerArgs.size(), const_cast<char**>(&wtArgv[0]));
 
+		StartupPhaseTimer startupPhaseTimer;
+
 		// lib init
 		Av::Transcoder::init();
+		startupPhaseTimer.phaseDone("transcoder init");
+
+		// Independent of the database: their disk caches are indexed while the database is being prepared
+		auto transcodeCacheFuture {std::async(std::launch::async, [&]() -> std::unique_ptr<Av::ITranscodeCache>
+		{
+			const Metrics::ScopedWarming warming {"transcode_cache"};
+			const std::uintmax_t transcodeCacheMaxSize {static_cast<std::uintmax_t>(config->getULong("transcode-cache-max-size", 0)) * 1024 * 1024};
+			return transcodeCacheMaxSize > 0 ? Av::createTranscodeCache(config->getPath("working-dir") / "cache" / "transcode", transcodeCacheMaxSize) : nullptr;
+		})};
+		auto coverArtGrabberFuture {std::async(std::launch::async, [&]
+		{
+			const Metrics::ScopedWarming warming {"cover_cache"};
+			return CoverArt::createGrabber(argv[0],
+				server.appRoot() + "/images/unknown-cover.jpg",
+				config->getULong("cover-max-cache-size", 30) * 1000 * 1000,
+				config->getULong("cover-max-file-size", 10) * 1000 * 1000,
+				config->getULong("cover-jpeg-quality", 75),
+				config->getULong("cover-webp-quality", 75),
+				config->getPath("working-dir") / "cache" / "cover",
+				config->getULong("cover-max-disk-cache-size", 100) * 1000 * 1000);
+		})};
 
 		// Initializing a connection pool to the database that will be shared along services
-		Database::Db database {config->getPath("working-dir") / "lms.db"};
+		Database::Db database {config->getPath("working-dir") / "lms.db",
+			getDbReadConnectionCount(),
+			config->getBool("db-concurrent-reads", false) ? Database::Db::ConcurrencyMode::ConcurrentReads : Database::Db::ConcurrencyMode::Exclusive,
+			getDbConnectionSettings(),
+			getDbQueryStatsSettings()};
+		startupPhaseTimer.phaseDone("database open");
 		{
 			Database::Session session {database};
 			session.prepareTables();
-			session.optimize();
+		}
+		Readiness::setReady("database", startupPhaseTimer.phaseDone("database preparation"));
+		if (config->getBool("db-maintenance-enable", true))
+		{
+			Database::MaintenanceSettings maintenanceSettings;
+			maintenanceSettings.walCheckpointThreshold = static_cast<std::uintmax_t>(config->getULong("db-maintenance-wal-checkpoint-threshold", 64)) * 1024 * 1024;
+			maintenanceSettings.optimizePeriod = std::chrono::minutes {std::max<unsigned long>(1, config->getULong("db-maintenance-optimize-period", 60))};
+			maintenanceSettings.maxListenCount = config->getULong("db-maintenance-max-listen-count", 10000);
+			database.startMaintenance(maintenanceSettings);
+		}
+		{
+			Database::UserStateJournalSettings userStateJournalSettings;
+			userStateJournalSettings.flushPeriod = std::chrono::seconds {std::max<unsigned long>(1, config->getULong("db-user-state-flush-period", 5))};
+			database.startUserStateJournal(userStateJournalSettings);
 		}
 
 		UserInterface::LmsApplicationGroupContainer appGroups;
 
 		// Service initialization order is important
-		Service<Auth::IAuthTokenService> authTokenService {Auth::createAuthTokenService(config->getULong("login-throttler-max-entriees", 10000))};
-		Service<Auth::IPasswordService> passwordService {Auth::createPasswordService(config->getULong("login-throttler-max-entriees", 10000))};
-		Service<CoverArt::IGrabber> coverArtService {CoverArt::createGrabber(argv[0],
-				server.appRoot() + "/images/unknown-cover.jpg",
-				config->getULong("cover-max-cache-size", 30) * 1000 * 1000,
-				config->getULong("cover-max-file-size", 10) * 1000 * 1000,
-				config->getULong("cover-jpeg-quality", 75))};
+		Service<Auth::IAuthTokenService> authTokenService {Auth::createAuthTokenService(database, config->getULong("login-throttler-max-entries", 10000))};
+		Service<Auth::IPasswordService> passwordService {Auth::createPasswordService(config->getULong("login-throttler-max-entries", 10000),
+				config->getULong("login-max-concurrent-password-checks", 0),
+				config->getULong("login-max-pending-password-checks", 16))};
+		startupPhaseTimer.phaseDone("auth services");
+		Service<Av::ITranscodeCache> transcodeCacheService {transcodeCacheFuture.get()};
+		Service<CoverArt::IGrabber> coverArtService {coverArtGrabberFuture.get()};
+		startupPhaseTimer.phaseDone("disk caches (remaining wait)");
+		// Shared by the background services, declared first so that it is stopped last
+		Service<Scheduler> schedulerService {std::make_unique<Scheduler>(config->getULong("background-cpu-thread-count", 0), config->getULong("background-io-thread-count", 0), backgroundCpuSet)};
+
+		// Warm-up work is done in the background, the server is started meanwhile:
+		// statistics used by the query planner (below), recommendation engine (by the scanner) and Subsonic library catalog
+		Readiness::declare("db_statistics");
+		schedulerService->post(Scheduler::TaskClass::IO, Scheduler::Priority::Normal, CancellationToken {}, [&database]
+		{
+			const Metrics::ScopedWarming warming {"db_statistics"};
+			Database::Session session {database};
+			session.optimize();
+		});
 		Service<Recommendation::IEngine> recommendationEngineService {Recommendation::createEngine(database)};
 		Service<Scanner::IMediaScanner> mediaScannerService {Scanner::createMediaScanner(database, *recommendationEngineService)};
+		Service<UserInterface::LibraryCache> libraryCacheService {std::make_unique<UserInterface::LibraryCache>()};
+		startupPhaseTimer.phaseDone("background services");
+
+		// Blocking and CPU bound work is moved off the http server threads, which are kept for short requests
+		// Declared after the services they use, so that they are stopped first
+		Service<MediaIOExecutor> mediaIOExecutorService {std::make_unique<MediaIOExecutor>(config->getULong("media-io-thread-count", 4), "media I/O", httpCpuSet)};
+		Service<CpuExecutor> cpuExecutorService {std::make_unique<CpuExecutor>(getCpuThreadCount(), "CPU", httpCpuSet)};
+
+		std::unique_ptr<PreTranscoder> preTranscoder;
+		if (Service<Av::ITranscodeCache>::get() && config->getULong("pre-transcode-track-count", 0) > 0)
+		{
+			std::vector<std::size_t> webBitrates;
+			for (const std::string& bitrate : StringUtils::splitString(config->getString("pre-transcode-web-bitrates", ""), " ,"))
+			{
+				if (const auto value {StringUtils::readAs<std::size_t>(bitrate)})
+					webBitrates.push_back(*value * 1000);
+			}
+
+			preTranscoder = std::make_unique<PreTranscoder>(database, config->getULong("pre-transcode-track-count", 0), webBitrates);
+			preTranscoder->requestRun();
+		}
 
 		mediaScannerService->scanComplete().connect([&]()
 		{
-			// Flush cover cache even if no changes:
+			// Check the cover cache even if no changes:
 			// covers may be external files that changed and we don't keep track of them
-			coverArtService->flushCache();
+			{
+				Database::Session session {database};
+				coverArtService->flushCache(session);
+			}
+
+			// Play counts may have changed as well
+			if (preTranscoder)
+				preTranscoder->requestRun();
 		});
 
 		API::Subsonic::SubsonicResource subsonicResource {database};
+		startupPhaseTimer.phaseDone("Subsonic API");
 
 		// bind API resources
 		if (config->getBool("api-subsonic", true))
 			server.addResource(&subsonicResource, subsonicResource.getPath());
 
+		std::unique_ptr<MetricsResource> metricsResource;
+		if (config->getBool("metrics", false) || database.getQueryStats())
+		{
+			metricsResource = std::make_unique<MetricsResource>(database.getQueryStats(), config->getBool("api-subsonic", true) ? &subsonicResource.getRequestStats() : nullptr);
+			server.addResource(metricsResource.get(), metricsResource->getPath());
+		}
+
+		ReadinessResource readinessResource;
+		server.addResource(&readinessResource, readinessResource.getPath());
+
 		// bind UI entry point
 		server.addEntryPoint(Wt::EntryPointType::Application,
 				std::bind(UserInterface::LmsApplication::create,
 					std::placeholders::_1, std::ref(database), std::ref(appGroups)));
 
 		LMS_LOG(MAIN, INFO) << "Starting server...";
-		server.start();
+		{
+			// The http server threads inherit the affinity of this thread
+			const CpuAffinity::ScopedAffinity httpAffinity {httpCpuSet};
+			server.start();
+		}
+		startupPhaseTimer.phaseDone("server start");
 
 		LMS_LOG(MAIN, INFO) << "Now running...";
-		Wt::WServer::waitForShutdown();
+		waitForShutdown(signals);
 
 		LMS_LOG(MAIN, INFO) << "Stopping server...";
 		server.stop();
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LibraryCache.hpp"
+
+#include "scanner/IMediaScanner.hpp"
+#include "utils/Service.hpp"
+
+namespace UserInterface
+{
+	std::size_t
+	LibraryCache::getLibraryGeneration()
+	{
+		return Service<Scanner::IMediaScanner>::get()->getLibraryGeneration();
+	}
+
+	std::shared_ptr<const void>
+	LibraryCache::find(const std::string& key, std::size_t libraryGeneration) const
+	{
+		std::scoped_lock lock {_mutex};
+
+		if (libraryGeneration != _libraryGeneration)
+			return {};
+
+		auto it {_entries.find(key)};
+		if (it == std::cend(_entries))
+			return {};
+
+		return it->second;
+	}
+
+	void
+	LibraryCache::store(const std::string& key, std::size_t libraryGeneration, std::shared_ptr<const void> value)
+	{
+		std::scoped_lock lock {_mutex};
+
+		// Values computed before the last changes must not replace newer ones
+		if (libraryGeneration < _libraryGeneration)
+			return;
+
+		if (libraryGeneration != _libraryGeneration)
+		{
+			_entries.clear();
+			_libraryGeneration = libraryGeneration;
+		}
+
+		if (_entries.size() >= maxEntryCount && _entries.find(key) == std::cend(_entries))
+			_entries.clear();
+
+		_entries[key] = std::move(value);
+	}
+} // namespace UserInterface
+
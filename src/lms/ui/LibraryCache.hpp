@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace UserInterface
+{
+	// Process wide cache of the library views that are the same for all the sessions
+	// All the entries are dropped when the library generation changes (scan complete, watched changes applied)
+	class LibraryCache
+	{
+		public:
+			// key must identify both the type of the value and the view (mode, filters, range...)
+			// computeFunc is called without holding any lock, several sessions may compute the same value the first time
+			template <typename T, typename ComputeFunc>
+			std::shared_ptr<const T>
+			get(const std::string& key, ComputeFunc computeFunc)
+			{
+				const std::size_t libraryGeneration {getLibraryGeneration()};
+
+				if (std::shared_ptr<const void> value {find(key, libraryGeneration)})
+					return std::static_pointer_cast<const T>(value);
+
+				std::shared_ptr<const T> value {std::make_shared<const T>(computeFunc())};
+				store(key, libraryGeneration, value);
+
+				return value;
+			}
+
+		private:
+			static std::size_t getLibraryGeneration();
+
+			std::shared_ptr<const void> find(const std::string& key, std::size_t libraryGeneration) const;
+			void store(const std::string& key, std::size_t libraryGeneration, std::shared_ptr<const void> value);
+
+			static constexpr std::size_t maxEntryCount {1024};
+
+			mutable std::mutex _mutex;
+			std::size_t _libraryGeneration {};
+			std::unordered_map<std::string, std::shared_ptr<const void>> _entries;
+	};
+} // namespace UserInterface
+
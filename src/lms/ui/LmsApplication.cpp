@@ -20,6 +20,7 @@
 #include "LmsApplication.hpp"
 
 #include <Wt/WAnchor.h>
+#include <Wt/WContainerWidget.h>
 #include <Wt/WEnvironment.h>
 #include <Wt/WLineEdit.h>
 #include <Wt/WPushButton.h>
@@ -36,6 +37,7 @@
 #include "database/User.hpp"
 #include "explore/Explore.hpp"
 #include "explore/Filters.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
@@ -117,6 +119,24 @@ LmsApplication::getUserLoginName()
 	return getUser()->getLoginName();
 }
 
+static std::atomic<std::size_t> sessionCount {};
+
+LmsApplication::SessionCounter::SessionCounter()
+{
+	sessionCount++;
+}
+
+LmsApplication::SessionCounter::~SessionCounter()
+{
+	sessionCount--;
+}
+
+std::size_t
+LmsApplication::getSessionCount()
+{
+	return sessionCount;
+}
+
 LmsApplication::LmsApplication(const Wt::WEnvironment& env,
 		Database::Db& db,
 		LmsApplicationGroupContainer& appGroups)
@@ -130,6 +150,7 @@ LmsApplication::LmsApplication(const Wt::WEnvironment& env,
 	// Add a resource bundle
 	messageResourceBundle().use(appRoot() + "admin-database");
 	messageResourceBundle().use(appRoot() + "admin-initwizard");
+	messageResourceBundle().use(appRoot() + "admin-metricscontroller");
 	messageResourceBundle().use(appRoot() + "admin-scannercontroller");
 	messageResourceBundle().use(appRoot() + "admin-user");
 	messageResourceBundle().use(appRoot() + "admin-users");
@@ -248,7 +269,13 @@ LmsApplication::finalize()
 Wt::WLink
 LmsApplication::createArtistLink(Database::Artist::pointer artist)
 {
-	return Wt::WLink {Wt::LinkType::InternalPath, "/artist/" + std::to_string(artist.id())};
+	return createArtistLink(artist.id());
+}
+
+Wt::WLink
+LmsApplication::createArtistLink(Database::IdType artistId)
+{
+	return Wt::WLink {Wt::LinkType::InternalPath, "/artist/" + std::to_string(artistId)};
 }
 
 std::unique_ptr<Wt::WAnchor>
@@ -266,10 +293,31 @@ LmsApplication::createArtistAnchor(Database::Artist::pointer artist, bool addTex
 	return res;
 }
 
+std::unique_ptr<Wt::WAnchor>
+LmsApplication::createArtistAnchor(const Database::ObjectRef& artist, bool addText)
+{
+	auto res = std::make_unique<Wt::WAnchor>(createArtistLink(artist.id));
+
+	if (addText)
+	{
+		res->setTextFormat(Wt::TextFormat::Plain);
+		res->setText(Wt::WString::fromUTF8(artist.name));
+		res->setToolTip(Wt::WString::fromUTF8(artist.name), Wt::TextFormat::Plain);
+	}
+
+	return res;
+}
+
 Wt::WLink
 LmsApplication::createReleaseLink(Database::Release::pointer release)
 {
-	return Wt::WLink {Wt::LinkType::InternalPath, "/release/" + std::to_string(release.id())};
+	return createReleaseLink(release.id());
+}
+
+Wt::WLink
+LmsApplication::createReleaseLink(Database::IdType releaseId)
+{
+	return Wt::WLink {Wt::LinkType::InternalPath, "/release/" + std::to_string(releaseId)};
 }
 
 std::unique_ptr<Wt::WAnchor>
@@ -288,6 +336,22 @@ LmsApplication::createReleaseAnchor(Database::Release::pointer release, bool add
 	return res;
 }
 
+std::unique_ptr<Wt::WAnchor>
+LmsApplication::createReleaseAnchor(const Database::ObjectRef& release, bool addText)
+{
+	auto res = std::make_unique<Wt::WAnchor>(createReleaseLink(release.id));
+
+	if (addText)
+	{
+		res->setWordWrap(false);
+		res->setTextFormat(Wt::TextFormat::Plain);
+		res->setText(Wt::WString::fromUTF8(release.name));
+		res->setToolTip(Wt::WString::fromUTF8(release.name), Wt::TextFormat::Plain);
+	}
+
+	return res;
+}
+
 std::unique_ptr<Wt::WText>
 LmsApplication::createCluster(Database::Cluster::pointer cluster, bool canDelete)
 {
@@ -354,6 +418,25 @@ enum IdxRoot
 	IdxAdminUser,
 };
 
+// Rarely used views are only constructed when first displayed
+static
+void
+createViewIfNeeded(Wt::WStackedWidget& stack, int index)
+{
+	Wt::WContainerWidget* container {static_cast<Wt::WContainerWidget*>(stack.widget(index))};
+	if (container->count() > 0)
+		return;
+
+	switch (index)
+	{
+		case IdxSettings:		container->addNew<SettingsView>(); break;
+		case IdxAdminDatabase:	container->addNew<DatabaseSettingsView>(); break;
+		case IdxAdminUsers:		container->addNew<UsersView>(); break;
+		case IdxAdminUser:		container->addNew<UserView>(); break;
+		default:				break;
+	}
+}
+
 static
 void
 handlePathChange(Wt::WStackedWidget& stack, bool isAdmin)
@@ -389,6 +472,9 @@ handlePathChange(Wt::WStackedWidget& stack, bool isAdmin)
 			if (view.admin && !isAdmin)
 				break;
 
+			if (view.index >= IdxSettings)
+				createViewIfNeeded(stack, view.index);
+
 			stack.setCurrentIndex(view.index);
 			return;
 		}
@@ -487,7 +573,7 @@ LmsApplication::createHome()
 
 	Explore* explore = mainStack->addNew<Explore>(filters);
 	_playQueue = mainStack->addNew<PlayQueue>();
-	mainStack->addNew<SettingsView>();
+	mainStack->addNew<Wt::WContainerWidget>(); // settings, see createViewIfNeeded
 
 	searchEdit->enterPressed().connect([=]
 	{
@@ -503,9 +589,9 @@ LmsApplication::createHome()
 	// Admin stuff
 	if (isUserAdmin())
 	{
-		mainStack->addNew<DatabaseSettingsView>();
-		mainStack->addNew<UsersView>();
-		mainStack->addNew<UserView>();
+		mainStack->addNew<Wt::WContainerWidget>(); // database settings
+		mainStack->addNew<Wt::WContainerWidget>(); // users
+		mainStack->addNew<Wt::WContainerWidget>(); // user
 	}
 
 	explore->tracksAction.connect([this] (PlayQueueAction action, const std::vector<Database::IdType>& trackIds)
@@ -526,6 +612,11 @@ LmsApplication::createHome()
 	{
 		_playQueue->playNext();
 	});
+	_mediaPlayer->playbackNearEnd.connect([this]
+	{
+		if (const std::optional<Database::IdType> trackId {_playQueue->getNextTrackId()})
+			_mediaPlayer->prefetchTrack(*trackId);
+	});
 
 	_playQueue->trackSelected.connect([this] (Database::IdType trackId, bool play, float replayGain)
 	{
@@ -554,17 +645,47 @@ LmsApplication::createHome()
 		{
 			Wt::WServer::instance()->post(sessionId, [this]
 			{
+				// Covers may have changed: new URLs so that browsers do not use their cached images
+				_imageResource->setChanged();
+
 				_events.dbScanned.emit();
 				triggerUpdate();
 			});
 		});
 
-		Service<Scanner::IMediaScanner>::get()->scanInProgress().connect(this, [=] (Scanner::ScanStepStats stepStats)
+		const std::chrono::milliseconds scanProgressPeriod {Service<IConfig>::get()->getULong("scanner-ui-progress-period", 1000)};
+		Service<Scanner::IMediaScanner>::get()->scanInProgress().connect(this, [=, state = _scanProgressState] (Scanner::ScanStepStats stepStats)
 		{
+			if (!state->listening)
+				return;
+
+			{
+				std::scoped_lock lock {state->mutex};
+
+				state->latestStats = stepStats;
+
+				const auto now {std::chrono::steady_clock::now()};
+				if (state->deliveryPending || now - state->lastDelivery < scanProgressPeriod)
+					return;
+
+				state->deliveryPending = true;
+				state->lastDelivery = now;
+			}
+
 			Wt::WServer::instance()->post(sessionId, [=]
 			{
-				_events.dbScanInProgress.emit(stepStats);
-				triggerUpdate();
+				std::optional<Scanner::ScanStepStats> latestStats;
+				{
+					std::scoped_lock lock {state->mutex};
+					latestStats.swap(state->latestStats);
+					state->deliveryPending = false;
+				}
+
+				if (latestStats)
+				{
+					_events.dbScanInProgress.emit(*latestStats);
+					triggerUpdate();
+				}
 			});
 		});
 
@@ -607,10 +728,27 @@ LmsApplication::createHome()
 
 	internalPathChanged().connect([=]
 	{
-		handlePathChange(*mainStack, isUserAdmin());
+		const bool isAdmin {isUserAdmin()};
+		handlePathChange(*mainStack, isAdmin);
+		updateScanProgressListening(isAdmin);
 	});
 
-	handlePathChange(*mainStack, isUserAdmin());
+	const bool isAdmin {isUserAdmin()};
+	handlePathChange(*mainStack, isAdmin);
+	updateScanProgressListening(isAdmin);
+}
+
+void
+LmsApplication::updateScanProgressListening(bool isAdmin)
+{
+	const bool listening {isAdmin && internalPathMatches("/admin/database")};
+	if (_scanProgressState->listening.exchange(listening) == listening || !listening)
+		return;
+
+	// The progress events have been skipped while not listening: catch up
+	const Scanner::IMediaScanner::Status status {Service<Scanner::IMediaScanner>::get()->getStatus()};
+	if (status.currentState == Scanner::IMediaScanner::State::InProgress && status.currentScanStepStats)
+		_events.dbScanInProgress.emit(*status.currentScanStepStats);
 }
 
 void
@@ -19,11 +19,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <optional>
 
 #include <Wt/WApplication.h>
 #include <Wt/WPopupMenu.h>
 
+#include "database/Types.hpp"
 #include "scanner/IMediaScanner.hpp"
 
 #include "LmsApplicationGroup.hpp"
@@ -78,11 +82,15 @@ class LmsApplication : public Wt::WApplication
 		static std::unique_ptr<Wt::WApplication> create(const Wt::WEnvironment& env, Database::Db& db, LmsApplicationGroupContainer& appGroups);
 		static LmsApplication* instance();
 
+		// Number of live UI sessions, thread safe
+		static std::size_t getSessionCount();
+
 		// Session application data
 		std::shared_ptr<ImageResource> getImageResource() { return _imageResource; }
 		std::shared_ptr<AudioTranscodeResource> getAudioTranscodeResource() { return _audioTranscodeResource; }
 		std::shared_ptr<AudioFileResource> getAudioFileResource() { return _audioFileResource; }
 		Database::Session& getDbSession(); // always thread safe
+		Database::Db& getDb() { return _db; } // to get sessions from other threads
 
 		Wt::Dbo::ptr<Database::User> getUser();
 		bool isUserAuthStrong() const; // user must be logged in prior this call
@@ -100,6 +108,11 @@ class LmsApplication : public Wt::WApplication
 		static std::unique_ptr<Wt::WAnchor> createArtistAnchor(Wt::Dbo::ptr<Database::Artist> artist, bool addText = true);
 		static Wt::WLink createReleaseLink(Wt::Dbo::ptr<Database::Release> release);
 		static std::unique_ptr<Wt::WAnchor> createReleaseAnchor(Wt::Dbo::ptr<Database::Release> release, bool addText = true);
+		// Variants that do not need the objects to be loaded
+		static Wt::WLink createArtistLink(Database::IdType artistId);
+		static std::unique_ptr<Wt::WAnchor> createArtistAnchor(const Database::ObjectRef& artist, bool addText = true);
+		static Wt::WLink createReleaseLink(Database::IdType releaseId);
+		static std::unique_ptr<Wt::WAnchor> createReleaseAnchor(const Database::ObjectRef& release, bool addText = true);
 		static std::unique_ptr<Wt::WText> createCluster(Wt::Dbo::ptr<Database::Cluster> cluster, bool canDelete = false);
 		Wt::WPopupMenu* createPopupMenu();
 
@@ -124,7 +137,16 @@ class LmsApplication : public Wt::WApplication
 		void finalize() override;
 
 		void createHome();
+		void updateScanProgressListening(bool isAdmin);
+
+		// Members are destroyed even if the constructor throws
+		struct SessionCounter
+		{
+			SessionCounter();
+			~SessionCounter();
+		};
 
+		SessionCounter							_sessionCounter;
 		Database::Db&							_db;
 		Wt::Signal<>							_preQuit;
 		LmsApplicationGroupContainer&   		_appGroups;
@@ -137,6 +159,18 @@ class LmsApplication : public Wt::WApplication
 		MediaPlayer*							_mediaPlayer {};
 		PlayQueue*								_playQueue {};
 		std::unique_ptr<Wt::WPopupMenu>			_popupMenu {};
+
+		// Scan progress events are coalesced: only the latest stats are delivered, at most once per period,
+		// and only if the session displays the scanner page. Shared with the scanner thread
+		struct ScanProgressState
+		{
+			std::atomic<bool>						listening {};
+			std::mutex								mutex;
+			std::optional<Scanner::ScanStepStats>	latestStats;
+			bool									deliveryPending {};
+			std::chrono::steady_clock::time_point	lastDelivery;
+		};
+		std::shared_ptr<ScanProgressState>		_scanProgressState {std::make_shared<ScanProgressState>()};
 };
 
 
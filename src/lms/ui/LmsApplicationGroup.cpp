@@ -81,7 +81,7 @@ LmsApplicationGroup::postOthers(std::function<void()> func) const
 LmsApplicationGroup&
 LmsApplicationGroupContainer::get(Database::IdType userId)
 {
-	std::unique_lock<std::mutex> lock {_mutex};
+	std::unique_lock lock {_mutex};
 
 	return _apps[userId];
 }
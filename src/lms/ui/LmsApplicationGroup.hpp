@@ -26,6 +26,7 @@
 #include <Wt/WEnvironment.h>
 
 #include "database/Types.hpp"
+#include "utils/ProfiledMutex.hpp"
 
 namespace UserInterface {
 
@@ -62,7 +63,7 @@ class LmsApplicationGroupContainer
 
 	private:
 		std::map<Database::IdType /* userId */, LmsApplicationGroup> _apps;
-		std::mutex _mutex;
+		ProfiledMutex _mutex {"ui_application_groups"};
 };
 
 } // UserInterface
@@ -29,9 +29,9 @@
 #include "database/Release.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
-#include "database/TrackList.hpp"
 #include "database/Types.hpp"
 #include "database/User.hpp"
+#include "database/UserStateJournal.hpp"
 
 #include "resource/ImageResource.hpp"
 #include "resource/AudioTranscodeResource.hpp"
@@ -194,6 +194,7 @@ static MediaPlayer::Settings settingsfromJSString(const std::string& strSettings
 MediaPlayer::MediaPlayer()
 : Wt::WTemplate {Wt::WString::tr("Lms.MediaPlayer.template")},
   playbackEnded {this, "playbackEnded"},
+  playbackNearEnd {this, "playbackNearEnd"},
   playPrevious {this, "playPrevious"},
   playNext {this, "playNext"},
   _settingsLoaded {this, "settingsLoaded"}
@@ -293,18 +294,33 @@ MediaPlayer::loadTrack(Database::IdType trackId, bool play, float replayGain)
 	wApp->doJavaScript(oss.str());
 
 	{
-		auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-		const Database::Track::pointer track {Database::Track::getById(LmsApp->getDbSession(), trackId)};
-		if (track)
-			Database::TrackListEntry::create(LmsApp->getDbSession(), track, LmsApp->getUser()->getPlayedTrackList(LmsApp->getDbSession()));
+		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
-	};
+		// Written in the background, along with the other user state updates
+		LmsApp->getDb().getUserStateJournal().addListen(LmsApp->getUser().id(), trackId);
+	}
 
 	_trackIdLoaded = trackId;
 	trackLoaded.emit(*_trackIdLoaded);
 }
 
+void
+MediaPlayer::prefetchTrack(Database::IdType trackId)
+{
+	LMS_LOG(UI, DEBUG) << "Prefetching track ID = " << trackId;
+
+	std::ostringstream oss;
+	oss
+		<< "var params = {"
+		<< " nativeResource: \"" << LmsApp->getAudioFileResource()->getUrl(trackId) << "\","
+		<< " transcodeResource: \"" << LmsApp->getAudioTranscodeResource()->getUrl(trackId) << "\","
+		<< "};";
+	oss << "LMS.mediaplayer.prefetchTrack(params)";
+
+	LMS_LOG(UI, DEBUG) << "Running js = '" << oss.str() << "'";
+	wApp->doJavaScript(oss.str());
+}
+
 void
 MediaPlayer::stop()
 {
@@ -92,6 +92,8 @@ class MediaPlayer : public Wt::WTemplate
 		std::optional<Database::IdType> getTrackLoaded() const { return _trackIdLoaded; }
 
 		void loadTrack(Database::IdType trackId, bool play, float replayGain);
+		// Makes the browser start reading the track, so that it can be played right away once loaded
+		void prefetchTrack(Database::IdType trackId);
 		void stop();
 
 		std::optional<Settings>	getSettings() const { return _settings; }
@@ -99,6 +101,7 @@ class MediaPlayer : public Wt::WTemplate
 
 		// Signals
 		Wt::JSignal<>			playbackEnded;
+		Wt::JSignal<>			playbackNearEnd; // emitted once per loaded track
 		Wt::JSignal<> 			playPrevious;
 		Wt::JSignal<> 			playNext;
 		Wt::Signal<Database::IdType>	trackLoaded;
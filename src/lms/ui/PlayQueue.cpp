@@ -19,6 +19,8 @@
 
 #include "PlayQueue.hpp"
 
+#include <algorithm>
+
 #include <Wt/WText.h>
 #include <Wt/WText.h>
 
@@ -27,16 +29,17 @@
 #include "database/Track.hpp"
 #include "database/TrackList.hpp"
 #include "database/User.hpp"
-#include "recommendation/IEngine.hpp"
+#include "database/UserStateJournal.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Random.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
 
+#include "common/CoverImage.hpp"
 #include "common/LoadingIndicator.hpp"
-#include "resource/ImageResource.hpp"
 #include "LmsApplication.hpp"
 #include "MediaPlayer.hpp"
+#include "RadioGenerator.hpp"
 #include "TrackStringUtils.hpp"
 
 namespace UserInterface {
@@ -68,6 +71,7 @@ PlayQueue::PlayQueue()
 
 	_entriesContainer = bindNew<Wt::WContainerWidget>("entries");
 	hideLoadingIndicator();
+	hideTopLoadingIndicator();
 
 	Wt::WText* shuffleBtn = bindNew<Wt::WText>("shuffle-btn", Wt::WString::tr("Lms.PlayQueue.template.shuffle-btn"), Wt::TextFormat::XHTML);
 	setToolTip(*shuffleBtn, Wt::WString::tr("Lms.PlayQueue.shuffle"));
@@ -77,14 +81,13 @@ PlayQueue::PlayQueue()
 			auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
 
 			Database::TrackList::pointer trackList {getTrackList()};
-			auto entries {trackList->getEntries()};
-			Random::shuffleContainer(entries);
+			auto trackIds {trackList->getTrackIds()};
+			Random::shuffleContainer(trackIds);
 
 			getTrackList().modify()->clear();
-			for (const auto& entry : entries)
-				Database::TrackListEntry::create(LmsApp->getDbSession(), entry->getTrack(), trackList);
+			Database::TrackList::appendTracks(LmsApp->getDbSession(), trackList, trackIds);
 		}
-		_entriesContainer->clear();
+		clearEntries();
 		addSome();
 	});
 
@@ -147,6 +150,7 @@ PlayQueue::PlayQueue()
 
 				std::size_t trackPos {};
 
+				LmsApp->getDb().getUserStateJournal().flush();
 				{
 					auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 					trackPos = LmsApp->getUser()->getCurPlayingTrackPos();
@@ -165,6 +169,8 @@ PlayQueue::PlayQueue()
 		_tracklistId = trackList.id();
 	}
 
+	_radioGenerator = std::make_shared<RadioGenerator>(_tracklistId);
+
 	updateInfo();
 	addSome();
 }
@@ -204,6 +210,27 @@ PlayQueue::hideLoadingIndicator()
 	bindEmpty("loading-indicator");
 }
 
+void
+PlayQueue::displayTopLoadingIndicator()
+{
+	_topLoadingIndicator = bindWidget<Wt::WTemplate>("top-loading-indicator", createLoadingIndicator());
+	_topLoadingIndicator->scrollVisibilityChanged().connect([this](bool visible)
+	{
+		if (!visible)
+			return;
+
+		addSomeBefore();
+		updateCurrentTrack(true);
+	});
+}
+
+void
+PlayQueue::hideTopLoadingIndicator()
+{
+	_topLoadingIndicator = nullptr;
+	bindEmpty("top-loading-indicator");
+}
+
 Database::TrackList::pointer
 PlayQueue::getTrackList() const
 {
@@ -225,9 +252,19 @@ PlayQueue::clearTracks()
 		getTrackList().modify()->clear();
 	}
 
+	_radioGenerator->reset();
+
+	clearEntries();
+	updateInfo();
+}
+
+void
+PlayQueue::clearEntries()
+{
 	hideLoadingIndicator();
+	hideTopLoadingIndicator();
 	_entriesContainer->clear();
-	updateInfo();
+	_firstEntryPos = 0;
 }
 
 void
@@ -245,6 +282,7 @@ PlayQueue::loadTrack(std::size_t pos, bool play)
 
 	Database::IdType trackId {};
 	bool addRadioTrack {};
+	bool prefetchRadioTracks {};
 	std::optional<float> replayGain {};
 	{
 		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
@@ -266,6 +304,8 @@ PlayQueue::loadTrack(std::size_t pos, bool play)
 		// If last and radio mode, fill the next song
 		if (_radioMode && pos == tracklist->getCount() - 1)
 			addRadioTrack = true;
+		else if (_radioMode && pos + 2 == tracklist->getCount())
+			prefetchRadioTracks = true;
 
 		_trackPos = pos;
 		auto track = tracklist->getEntry(*_trackPos)->getTrack();
@@ -274,12 +314,15 @@ PlayQueue::loadTrack(std::size_t pos, bool play)
 
 		replayGain = getReplayGain(pos, track);
 
+		// Written in the background, the track changes often
 		if (!LmsApp->getUser()->isDemo())
-			LmsApp->getUser().modify()->setCurPlayingTrackPos(pos);
+			LmsApp->getDb().getUserStateJournal().setCurPlayingTrackPos(LmsApp->getUser().id(), pos);
 	}
 
 	if (addRadioTrack)
 		enqueueRadioTracks();
+	else if (prefetchRadioTracks)
+		_radioGenerator->prefetch();
 
 	updateCurrentTrack(true);
 
@@ -310,6 +353,26 @@ PlayQueue::playNext()
 	loadTrack(*_trackPos + 1, true);
 }
 
+std::optional<Database::IdType>
+PlayQueue::getNextTrackId() const
+{
+	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+
+	Database::TrackList::pointer tracklist {getTrackList()};
+
+	// Same logic as loadTrack
+	std::size_t pos {_trackPos ? *_trackPos + 1 : 0};
+	if (pos >= tracklist->getCount())
+	{
+		if (!_repeatAll || tracklist->getCount() == 0)
+			return std::nullopt;
+
+		pos = 0;
+	}
+
+	return tracklist->getEntry(pos)->getTrack().id();
+}
+
 void
 PlayQueue::updateInfo()
 {
@@ -321,10 +384,10 @@ PlayQueue::updateInfo()
 void
 PlayQueue::updateCurrentTrack(bool selected)
 {
-	if (!_trackPos || *_trackPos >= static_cast<std::size_t>(_entriesContainer->count()))
+	if (!_trackPos || *_trackPos < _firstEntryPos || *_trackPos >= _firstEntryPos + _entriesContainer->count())
 		return;
 
-	Wt::WTemplate* entry {static_cast<Wt::WTemplate*>(_entriesContainer->widget(*_trackPos))};
+	Wt::WTemplate* entry {static_cast<Wt::WTemplate*>(_entriesContainer->widget(*_trackPos - _firstEntryPos))};
 	if (entry)
 		entry->bindString("is-selected", selected ? "Lms-playqueue-selected" : "");
 }
@@ -339,19 +402,9 @@ PlayQueue::enqueueTracks(const std::vector<Database::IdType>& trackIds)
 
 		auto tracklist {getTrackList()};
 
-		std::size_t nbTracksToEnqueue {tracklist->getCount() + trackIds.size() > _nbMaxEntries ? _nbMaxEntries - tracklist->getCount() : trackIds.size()};
-		for (Database::IdType trackId : trackIds)
-		{
-			Database::Track::pointer track {Database::Track::getById(LmsApp->getDbSession(), trackId)};
-			if (!track)
-				continue;
-
-			if (nbTracksQueued == nbTracksToEnqueue)
-				break;
-
-			Database::TrackListEntry::create(LmsApp->getDbSession(), track, tracklist);
-			nbTracksQueued++;
-		}
+		const std::size_t trackCount {tracklist->getCount()};
+		if (trackCount < _nbMaxEntries)
+			nbTracksQueued = Database::TrackList::appendTracks(LmsApp->getDbSession(), tracklist, trackIds, _nbMaxEntries - trackCount);
 	}
 
 	updateInfo();
@@ -409,103 +462,142 @@ PlayQueue::addSome()
 
 	auto tracklist = getTrackList();
 
-	auto tracklistEntries = tracklist->getEntries(_entriesContainer->count(), 50);
+	auto tracklistEntries = tracklist->getEntries(_firstEntryPos + _entriesContainer->count(), _batchSize);
 	for (const Database::TrackListEntry::pointer& tracklistEntry : tracklistEntries)
+		_entriesContainer->addWidget(createEntry(tracklistEntry));
+
+	// Drop the entries that are now far above
+	while (static_cast<std::size_t>(_entriesContainer->count()) > _nbMaxRenderedEntries)
 	{
-		const auto tracklistEntryId {tracklistEntry.id()};
-		const auto track {tracklistEntry->getTrack()};
+		_entriesContainer->removeWidget(_entriesContainer->widget(0));
+		_firstEntryPos++;
+	}
 
-		Wt::WTemplate* entry = _entriesContainer->addNew<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry"));
+	updateLoadingIndicators(tracklist->getCount());
+}
 
-		entry->bindString("name", Wt::WString::fromUTF8(track->getName()), Wt::TextFormat::Plain);
+void
+PlayQueue::addSomeBefore()
+{
+	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
-		const auto artists {track->getArtists({Database::TrackArtistLinkType::Artist})};
-		const auto release {track->getRelease()};
+	auto tracklist = getTrackList();
 
-		if (!artists.empty() || release)
-			entry->setCondition("if-has-artists-or-release", true);
+	const std::size_t nbEntries {std::min(_firstEntryPos, _batchSize)};
+	_firstEntryPos -= nbEntries;
 
-		if (!artists.empty())
-		{
-			entry->setCondition("if-has-artists", true);
+	auto tracklistEntries = tracklist->getEntries(_firstEntryPos, nbEntries);
+	int index {};
+	for (const Database::TrackListEntry::pointer& tracklistEntry : tracklistEntries)
+		_entriesContainer->insertWidget(index++, createEntry(tracklistEntry));
 
-			Wt::WContainerWidget* artistContainer {entry->bindNew<Wt::WContainerWidget>("artists")};
-			for (const auto& artist : artists)
-			{
-				Wt::WTemplate* a {artistContainer->addNew<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry-artist"))};
-				a->bindWidget("artist", LmsApplication::createArtistAnchor(artist));
-			}
-		}
-		if (release)
+	// Drop the entries that are now far below
+	while (static_cast<std::size_t>(_entriesContainer->count()) > _nbMaxRenderedEntries)
+		_entriesContainer->removeWidget(_entriesContainer->widget(_entriesContainer->count() - 1));
+
+	updateLoadingIndicators(tracklist->getCount());
+}
+
+void
+PlayQueue::updateLoadingIndicators(std::size_t trackCount)
+{
+	if (_firstEntryPos > 0)
+		displayTopLoadingIndicator();
+	else
+		hideTopLoadingIndicator();
+
+	if (_firstEntryPos + _entriesContainer->count() < trackCount)
+		displayLoadingIndicator();
+	else
+		hideLoadingIndicator();
+}
+
+std::unique_ptr<Wt::WTemplate>
+PlayQueue::createEntry(const Database::TrackListEntry::pointer& tracklistEntry)
+{
+	const auto tracklistEntryId {tracklistEntry.id()};
+	const auto track {tracklistEntry->getTrack()};
+
+	auto entryPtr {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry"))};
+	Wt::WTemplate* entry {entryPtr.get()};
+
+	entry->bindString("name", Wt::WString::fromUTF8(track->getName()), Wt::TextFormat::Plain);
+
+	const auto artists {track->getArtists({Database::TrackArtistLinkType::Artist})};
+	const auto release {track->getRelease()};
+
+	if (!artists.empty() || release)
+		entry->setCondition("if-has-artists-or-release", true);
+
+	if (!artists.empty())
+	{
+		entry->setCondition("if-has-artists", true);
+
+		Wt::WContainerWidget* artistContainer {entry->bindNew<Wt::WContainerWidget>("artists")};
+		for (const auto& artist : artists)
 		{
-			entry->setCondition("if-has-release", true);
-			entry->bindWidget("release", LmsApplication::createReleaseAnchor(release));
-			{
-				Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false));
-				auto cover = std::make_unique<Wt::WImage>();
-				cover->setImageLink(LmsApp->getImageResource()->getReleaseUrl(release.id(), ImageResource::Size::Large));
-				cover->setStyleClass("Lms-cover");
-				cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
-				anchor->setImage(std::move(cover));
-			}
+			Wt::WTemplate* a {artistContainer->addNew<Wt::WTemplate>(Wt::WString::tr("Lms.PlayQueue.template.entry-artist"))};
+			a->bindWidget("artist", LmsApplication::createArtistAnchor(artist));
 		}
-		else
+	}
+	if (release)
+	{
+		entry->setCondition("if-has-release", true);
+		entry->bindWidget("release", LmsApplication::createReleaseAnchor(release));
 		{
-			auto cover = entry->bindNew<Wt::WImage>("cover");
-			cover->setImageLink(LmsApp->getImageResource()->getTrackUrl(track.id(), ImageResource::Size::Large));
-			cover->setStyleClass("Lms-cover");
-			cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
+			Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false));
+			anchor->setImage(createReleaseCover(release.id(), CoverLayout::List));
 		}
+	}
+	else
+	{
+		entry->bindWidget("cover", createTrackCover(track.id(), CoverLayout::List));
+	}
 
-		entry->bindString("duration", trackDurationToString(track->getDuration()), Wt::TextFormat::Plain);
+	entry->bindString("duration", trackDurationToString(track->getDuration()), Wt::TextFormat::Plain);
 
-		Wt::WText* playBtn = entry->bindNew<Wt::WText>("play-btn", Wt::WString::tr("Lms.PlayQueue.template.play-btn"), Wt::TextFormat::XHTML);
-		playBtn->clicked().connect(std::bind([=]
-		{
-			auto pos = _entriesContainer->indexOf(entry);
-			if (pos >= 0)
-				loadTrack(pos, true);
-		}));
+	Wt::WText* playBtn = entry->bindNew<Wt::WText>("play-btn", Wt::WString::tr("Lms.PlayQueue.template.play-btn"), Wt::TextFormat::XHTML);
+	playBtn->clicked().connect(std::bind([=]
+	{
+		const int index {_entriesContainer->indexOf(entry)};
+		if (index >= 0)
+			loadTrack(_firstEntryPos + index, true);
+	}));
 
-		Wt::WText* delBtn = entry->bindNew<Wt::WText>("del-btn", Wt::WString::tr("Lms.PlayQueue.template.delete-btn"), Wt::TextFormat::XHTML);
-		delBtn->clicked().connect(std::bind([=]
+	Wt::WText* delBtn = entry->bindNew<Wt::WText>("del-btn", Wt::WString::tr("Lms.PlayQueue.template.delete-btn"), Wt::TextFormat::XHTML);
+	delBtn->clicked().connect(std::bind([=]
+	{
+		// Remove the entry n both the widget tree and the playqueue
 		{
-			// Remove the entry n both the widget tree and the playqueue
-			{
-				auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-				Database::TrackListEntry::pointer entryToRemove {Database::TrackListEntry::getById(LmsApp->getDbSession(), tracklistEntryId)};
-				entryToRemove.remove();
-			}
+			auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
 
-			if (_trackPos)
-			{
-				auto pos {_entriesContainer->indexOf(entry)};
-				if (pos > 0 && *_trackPos >= static_cast<std::size_t>(pos))
-					(*_trackPos)--;
-			}
+			Database::TrackListEntry::pointer entryToRemove {Database::TrackListEntry::getById(LmsApp->getDbSession(), tracklistEntryId)};
+			entryToRemove.remove();
+		}
 
-			_entriesContainer->removeWidget(entry);
+		if (_trackPos)
+		{
+			const std::size_t pos {_firstEntryPos + _entriesContainer->indexOf(entry)};
+			if (pos > 0 && *_trackPos >= pos)
+				(*_trackPos)--;
+		}
 
-			updateInfo();
-		}));
+		_entriesContainer->removeWidget(entry);
 
-	}
+		updateInfo();
+	}));
 
-	if (static_cast<std::size_t>(_entriesContainer->count()) < tracklist->getCount())
-		displayLoadingIndicator();
-	else
-		hideLoadingIndicator();
+	return entryPtr;
 }
 
 void
 PlayQueue::enqueueRadioTracks()
 {
-	const auto similarTrackIds {Service<Recommendation::IEngine>::get()->getSimilarTracksFromTrackList(LmsApp->getDbSession(), _tracklistId, 3)};
-
-	std::vector<Database::IdType> trackToAddIds(std::cbegin(similarTrackIds), std::cend(similarTrackIds));
-	Random::shuffleContainer(trackToAddIds);
-	enqueueTracks(trackToAddIds);
+	_radioGenerator->getNextTracks(3, [this](const std::vector<Database::IdType>& trackIds)
+	{
+		if (!trackIds.empty())
+			enqueueTracks(trackIds);
+	});
 }
 
 std::optional<float>
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
 
 #include <Wt/WContainerWidget.h>
@@ -35,10 +36,13 @@ namespace Similarity {
 namespace Database {
 	class Track;
 	class TrackList;
+	class TrackListEntry;
 }
 
 namespace UserInterface {
 
+class RadioGenerator;
+
 class PlayQueue : public Wt::WTemplate
 {
 	public:
@@ -52,6 +56,9 @@ class PlayQueue : public Wt::WTemplate
 		// play the previous track in the queue
 		void playPrevious();
 
+		// track to be played by playNext, if any
+		std::optional<Database::IdType> getNextTrackId() const;
+
 		// Signal emitted when a track is to be load(and optionally played)
 		Wt::Signal<Database::IdType /*trackId*/, bool /*play*/, float /* replayGain */> trackSelected;
 
@@ -63,8 +70,11 @@ class PlayQueue : public Wt::WTemplate
 		bool isFull() const;
 
 		void clearTracks();
+		void clearEntries();
 		std::size_t enqueueTracks(const std::vector<Database::IdType>& trackIds);
 		void addSome();
+		void addSomeBefore();
+		std::unique_ptr<Wt::WTemplate> createEntry(const Wt::Dbo::ptr<Database::TrackListEntry>& tracklistEntry);
 		void enqueueRadioTracks();
 		void updateInfo();
 		void updateCurrentTrack(bool selected);
@@ -72,6 +82,9 @@ class PlayQueue : public Wt::WTemplate
 		void updateRadioBtn();
 		void displayLoadingIndicator();
 		void hideLoadingIndicator();
+		void displayTopLoadingIndicator();
+		void hideTopLoadingIndicator();
+		void updateLoadingIndicators(std::size_t trackCount);
 
 		void loadTrack(std::size_t pos, bool play);
 		void stop();
@@ -81,17 +94,23 @@ class PlayQueue : public Wt::WTemplate
 		std::optional<float> getReplayGain(std::size_t pos, const Wt::Dbo::ptr<Database::Track>& track) const;
 
 		static inline constexpr std::size_t _nbMaxEntries {1000};
+		static inline constexpr std::size_t _batchSize {50};
+		// Only a window of the queue is rendered, entries scrolled away are removed from the widget tree
+		static inline constexpr std::size_t _nbMaxRenderedEntries {_batchSize * 3};
 
 		bool _repeatAll {};
 		bool _radioMode {};
 		bool _mediaPlayerSettingsLoaded {};
 		Database::IdType _tracklistId {};
 		Wt::WContainerWidget* _entriesContainer {};
+		std::size_t _firstEntryPos {};	// position in the queue of the first rendered entry
 		Wt::WTemplate* _loadingIndicator {};
+		Wt::WTemplate* _topLoadingIndicator {};
 		Wt::WText* _nbTracks {};
 		Wt::WText* _repeatBtn {};
 		Wt::WText* _radioBtn {};
 		std::optional<std::size_t> _trackPos;	// current track position, if set
+		std::shared_ptr<RadioGenerator> _radioGenerator;
 };
 
 } // namespace UserInterface
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RadioGenerator.hpp"
+
+#include <Wt/WServer.h>
+
+#include "database/Db.hpp"
+#include "recommendation/IEngine.hpp"
+#include "utils/Executor.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+#include "utils/Service.hpp"
+
+#include "LmsApplication.hpp"
+
+namespace UserInterface {
+
+RadioGenerator::RadioGenerator(Database::IdType trackListId)
+: _trackListId {trackListId}
+, _sessionId {LmsApp->sessionId()}
+{
+}
+
+void
+RadioGenerator::getNextTracks(std::size_t count, TracksCallback callback)
+{
+	if (_candidates.size() >= count)
+	{
+		_pendingRequest.reset();
+		callback(popCandidates(count));
+		prefetch();
+		return;
+	}
+
+	_pendingRequest = PendingRequest {count, std::move(callback)};
+	if (!_fetching)
+		fetchCandidates();
+}
+
+void
+RadioGenerator::prefetch()
+{
+	if (!_fetching && _candidates.size() < _minCandidateCount)
+		fetchCandidates();
+}
+
+void
+RadioGenerator::reset()
+{
+	_candidates.clear();
+	_pendingRequest.reset();
+	_fetching = false;
+	_generation++;
+}
+
+void
+RadioGenerator::fetchCandidates()
+{
+	_fetching = true;
+
+	auto fetch {[&db = LmsApp->getDb(), trackListId = _trackListId, sessionId = _sessionId, generation = _generation, weakSelf = weak_from_this()]
+	{
+		std::vector<Database::IdType> trackIds;
+		try
+		{
+			const auto similarTrackIds {Service<Recommendation::IEngine>::get()->getSimilarTracksFromTrackList(db.getTLSSession(), trackListId, _fetchedCandidateCount)};
+			trackIds.assign(std::cbegin(similarTrackIds), std::cend(similarTrackIds));
+		}
+		catch (std::exception& e)
+		{
+			LMS_LOG(UI, ERROR) << "Cannot get radio tracks: " << e.what();
+		}
+
+		Wt::WServer::instance()->post(sessionId, [weakSelf, generation, trackIds {std::move(trackIds)}]() mutable
+		{
+			if (auto self {weakSelf.lock()})
+			{
+				self->onCandidatesFetched(generation, std::move(trackIds));
+				LmsApp->triggerUpdate();
+			}
+		});
+	}};
+
+	// Similarity searches may take a while: keep them away from the playback path
+	if (CpuExecutor* executor {Service<CpuExecutor>::get()})
+		executor->post(std::move(fetch));
+	else
+		fetch();
+}
+
+void
+RadioGenerator::onCandidatesFetched(std::size_t generation, std::vector<Database::IdType> trackIds)
+{
+	// Queue contents changed meanwhile
+	if (generation != _generation)
+		return;
+
+	_fetching = false;
+
+	LMS_LOG(UI, DEBUG) << "Fetched " << trackIds.size() << " radio candidates";
+
+	const std::unordered_set<Database::IdType> candidateIds(std::cbegin(_candidates), std::cend(_candidates));
+
+	Random::shuffleContainer(trackIds);
+	for (const Database::IdType trackId : trackIds)
+	{
+		if (_historyIds.find(trackId) == std::cend(_historyIds) && candidateIds.find(trackId) == std::cend(candidateIds))
+			_candidates.push_back(trackId);
+	}
+
+	if (_pendingRequest)
+	{
+		// Hand out what we have, a new fetch is only made on the next request
+		PendingRequest request {std::move(*_pendingRequest)};
+		_pendingRequest.reset();
+
+		request.callback(popCandidates(request.count));
+	}
+}
+
+std::vector<Database::IdType>
+RadioGenerator::popCandidates(std::size_t count)
+{
+	std::vector<Database::IdType> res;
+
+	while (res.size() < count && !_candidates.empty())
+	{
+		const Database::IdType trackId {_candidates.front()};
+		_candidates.pop_front();
+
+		if (!_historyIds.insert(trackId).second)
+			continue;
+
+		_history.push_back(trackId);
+		if (_history.size() > _maxHistorySize)
+		{
+			_historyIds.erase(_history.front());
+			_history.pop_front();
+		}
+
+		res.push_back(trackId);
+	}
+
+	return res;
+}
+
+} // namespace UserInterface
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "database/Types.hpp"
+
+namespace UserInterface {
+
+// Provides the tracks to append to the play queue in radio mode
+// Tracks similar to the queue are fetched by batches in the background, and handed out a few at a time
+// Must only be used from the session
+class RadioGenerator : public std::enable_shared_from_this<RadioGenerator>
+{
+	public:
+		RadioGenerator(Database::IdType trackListId);
+
+		RadioGenerator(const RadioGenerator&) = delete;
+		RadioGenerator(RadioGenerator&&) = delete;
+		RadioGenerator& operator=(const RadioGenerator&) = delete;
+		RadioGenerator& operator=(RadioGenerator&&) = delete;
+
+		using TracksCallback = std::function<void(const std::vector<Database::IdType>& /* trackIds */)>;
+		// The callback is called once tracks are available: immediately if there are enough candidates, later otherwise
+		// Replaces any request still waiting for candidates
+		void getNextTracks(std::size_t count, TracksCallback callback);
+
+		// Fetches candidates in advance, if running low
+		void prefetch();
+
+		// Drops the candidates and the pending request, to be called when the queue contents are replaced
+		void reset();
+
+	private:
+		void fetchCandidates();
+		void onCandidatesFetched(std::size_t generation, std::vector<Database::IdType> trackIds);
+		std::vector<Database::IdType> popCandidates(std::size_t count);
+
+		static inline constexpr std::size_t _fetchedCandidateCount {30};
+		static inline constexpr std::size_t _minCandidateCount {10};	// a fetch is started below this count
+		static inline constexpr std::size_t _maxHistorySize {250};
+
+		struct PendingRequest
+		{
+			std::size_t		count;
+			TracksCallback	callback;
+		};
+
+		const Database::IdType			_trackListId;
+		const std::string				_sessionId;
+		std::deque<Database::IdType>	_candidates;
+		std::deque<Database::IdType>	_history;	// tracks recently handed out, most recent last
+		std::unordered_set<Database::IdType>	_historyIds;
+		std::optional<PendingRequest>	_pendingRequest;
+		bool							_fetching {};
+		std::size_t						_generation {};	// incremented on reset, to discard the results of ongoing fetches
+};
+
+} // namespace UserInterface
@@ -25,6 +25,7 @@
 #include <Wt/WPushButton.h>
 #include <Wt/WString.h>
 #include <Wt/WTemplateFormView.h>
+#include <Wt/WTextArea.h>
 
 #include "database/Cluster.hpp"
 #include "database/ScanSettings.hpp"
@@ -35,6 +36,7 @@
 
 #include "common/Validators.hpp"
 #include "common/ValueStringModel.hpp"
+#include "MetricsController.hpp"
 #include "ScannerController.hpp"
 #include "LmsApplication.hpp"
 
@@ -47,7 +49,7 @@ class DatabaseSettingsModel : public Wt::WFormModel
 {
 	public:
 		// Associate each field with a unique string literal.
-		static inline const Field MediaDirectoryField {"media-directory"};
+		static inline const Field MediaDirectoriesField {"media-directory"};
 		static inline const Field UpdatePeriodField {"update-period"};
 		static inline const Field UpdateStartTimeField {"update-start-time"};
 		static inline const Field RecommendationEngineTypeField {"recommendation-engine-type"};
@@ -57,15 +59,15 @@ class DatabaseSettingsModel : public Wt::WFormModel
 		{
 			initializeModels();
 
-			addField(MediaDirectoryField);
+			addField(MediaDirectoriesField);
 			addField(UpdatePeriodField);
 			addField(UpdateStartTimeField);
 			addField(RecommendationEngineTypeField);
 			addField(TagsField);
 
-			auto dirValidator {std::make_shared<DirectoryValidator>()};
+			auto dirValidator {std::make_shared<DirectoriesValidator>()};
 			dirValidator->setMandatory(true);
-			setValidator(MediaDirectoryField, dirValidator);
+			setValidator(MediaDirectoriesField, dirValidator);
 
 			setValidator(UpdatePeriodField, createMandatoryValidator());
 			setValidator(UpdateStartTimeField, createMandatoryValidator());
@@ -86,7 +88,12 @@ class DatabaseSettingsModel : public Wt::WFormModel
 
 			const ScanSettings::pointer scanSettings {ScanSettings::get(LmsApp->getDbSession())};
 
-			setValue(MediaDirectoryField, scanSettings->getMediaDirectory().string());
+			{
+				std::vector<std::string> mediaDirectories;
+				for (const std::filesystem::path& mediaDirectory : scanSettings->getMediaDirectories())
+					mediaDirectories.push_back(mediaDirectory.string());
+				setValue(MediaDirectoriesField, StringUtils::joinStrings(mediaDirectories, "\n"));
+			}
 
 			auto periodRow {_updatePeriodModel->getRowFromValue(scanSettings->getUpdatePeriod())};
 			if (periodRow)
@@ -115,7 +122,16 @@ class DatabaseSettingsModel : public Wt::WFormModel
 
 			ScanSettings::pointer scanSettings {ScanSettings::get(LmsApp->getDbSession())};
 
-			scanSettings.modify()->setMediaDirectory(valueText(MediaDirectoryField).toUTF8());
+			{
+				std::vector<std::filesystem::path> mediaDirectories;
+				for (const std::string_view line : StringUtils::splitStringViews(valueText(MediaDirectoriesField).toUTF8(), "\r\n"))
+				{
+					const std::string mediaDirectory {StringUtils::stringTrim(line)};
+					if (!mediaDirectory.empty())
+						mediaDirectories.emplace_back(mediaDirectory);
+				}
+				scanSettings.modify()->setMediaDirectories(mediaDirectories);
+			}
 
 			auto updatePeriodRow {_updatePeriodModel->getRowFromString(valueText(UpdatePeriodField))};
 			if (updatePeriodRow)
@@ -186,8 +202,8 @@ DatabaseSettingsView::refreshView()
 	auto t {addNew<Wt::WTemplateFormView>(Wt::WString::tr("Lms.Admin.Database.template"))};
 	auto model {std::make_shared<DatabaseSettingsModel>()};
 
-	// Media Directory
-	t->setFormWidget(DatabaseSettingsModel::MediaDirectoryField, std::make_unique<Wt::WLineEdit>());
+	// Media Directories, one per line
+	t->setFormWidget(DatabaseSettingsModel::MediaDirectoriesField, std::make_unique<Wt::WTextArea>());
 
 	// Update Period
 	auto updatePeriod {std::make_unique<Wt::WComboBox>()};
@@ -213,6 +229,7 @@ DatabaseSettingsView::refreshView()
 	Wt::WPushButton *immScanBtn = t->bindWidget("immediate-scan-btn", std::make_unique<Wt::WPushButton>(Wt::WString::tr("Lms.Admin.Database.immediate-scan")));
 
 	t->bindNew<ScannerController>("scanner-controller");
+	t->bindNew<MetricsController>("metrics-controller");
 
 	saveBtn->clicked().connect([=]
 	{
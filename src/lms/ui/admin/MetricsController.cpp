@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MetricsController.hpp"
+
+#include <array>
+#include <csignal>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string_view>
+
+#include <unistd.h>
+
+#include <Wt/Http/Response.h>
+#include <Wt/WComboBox.h>
+#include <Wt/WDateTime.h>
+#include <Wt/WPushButton.h>
+#include <Wt/WResource.h>
+#include <Wt/WTable.h>
+#include <Wt/WText.h>
+#include <Wt/WTimer.h>
+
+#include "utils/Metrics.hpp"
+#include "utils/SamplingProfiler.hpp"
+
+namespace UserInterface {
+
+namespace {
+
+	constexpr std::chrono::seconds refreshPeriod {2};
+	constexpr std::array<std::chrono::seconds, 4> profilerDurations {std::chrono::seconds {10}, std::chrono::seconds {30}, std::chrono::seconds {60}, std::chrono::seconds {180}};
+
+	// Folded stacks of the last capture, as read when downloaded
+	class ProfileResource : public Wt::WResource
+	{
+		public:
+			ProfileResource()
+			{
+				suggestFileName("lms-profile.folded");
+			}
+
+			~ProfileResource()
+			{
+				beingDeleted();
+			}
+
+			void handleRequest(const Wt::Http::Request&, Wt::Http::Response& response) override
+			{
+				response.setMimeType("text/plain");
+
+				if (const std::shared_ptr<const SamplingProfiler::CaptureResult> result {SamplingProfiler::getLastCaptureResult()})
+					response.out() << result->foldedStacks;
+			}
+	};
+
+	std::string
+	durationToString(std::chrono::microseconds duration)
+	{
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(1);
+
+		if (duration >= std::chrono::seconds {1})
+			oss << std::chrono::duration<double>(duration).count() << " s";
+		else
+			oss << std::chrono::duration<double, std::milli>(duration).count() << " ms";
+
+		return oss.str();
+	}
+
+	std::string
+	rateToString(double rate)
+	{
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(1) << rate << "/s";
+		return oss.str();
+	}
+
+	void
+	setHeader(Wt::WTable& table, std::initializer_list<const char*> columnKeys)
+	{
+		table.setHeaderCount(1);
+
+		int column {};
+		for (const char* key : columnKeys)
+			table.elementAt(0, column++)->addNew<Wt::WText>(Wt::WString::tr(key));
+	}
+
+	void
+	addRow(Wt::WTable& table, std::initializer_list<Wt::WString> values)
+	{
+		const int row {table.rowCount()};
+
+		int column {};
+		for (const Wt::WString& value : values)
+			table.elementAt(row, column++)->addNew<Wt::WText>(value, Wt::TextFormat::Plain);
+	}
+
+	void
+	clearRows(Wt::WTable& table)
+	{
+		while (table.rowCount() > 1)
+			table.removeRow(table.rowCount() - 1);
+	}
+
+	// "lms_cover_disk_cache_hits_total" -> "lms_cover_disk_cache"
+	std::optional<std::string>
+	getCacheName(const std::string& hitCounterName)
+	{
+		constexpr std::string_view suffix {"_hits_total"};
+		if (hitCounterName.size() <= suffix.size() || hitCounterName.compare(hitCounterName.size() - suffix.size(), suffix.size(), suffix) != 0)
+			return std::nullopt;
+
+		return hitCounterName.substr(0, hitCounterName.size() - suffix.size());
+	}
+
+} // namespace
+
+MetricsController::MetricsController()
+: WTemplate {Wt::WString::tr("Lms.Admin.MetricsController.template")}
+{
+	addFunction("tr", &Wt::WTemplate::Functions::tr);
+
+	_counters = bindNew<Wt::WTable>("counters");
+	_counters->addStyleClass("table table-condensed");
+	setHeader(*_counters, {"Lms.Admin.MetricsController.name", "Lms.Admin.MetricsController.value", "Lms.Admin.MetricsController.rate"});
+
+	_histograms = bindNew<Wt::WTable>("histograms");
+	_histograms->addStyleClass("table table-condensed");
+	setHeader(*_histograms, {"Lms.Admin.MetricsController.name", "Lms.Admin.MetricsController.count", "Lms.Admin.MetricsController.p50", "Lms.Admin.MetricsController.p90", "Lms.Admin.MetricsController.p99", "Lms.Admin.MetricsController.max"});
+
+	_cacheRatios = bindNew<Wt::WTable>("cache-ratios");
+	_cacheRatios->addStyleClass("table table-condensed");
+	setHeader(*_cacheRatios, {"Lms.Admin.MetricsController.name", "Lms.Admin.MetricsController.hit-ratio", "Lms.Admin.MetricsController.requests"});
+
+	if (SamplingProfiler::isEnabled())
+	{
+		setCondition("if-profiler", true);
+
+		_profilerDuration = bindNew<Wt::WComboBox>("profiler-duration");
+		for (const std::chrono::seconds duration : profilerDurations)
+			_profilerDuration->addItem(std::to_string(duration.count()) + " s");
+
+		_profilerStart = bindNew<Wt::WPushButton>("profiler-start", Wt::WString::tr("Lms.Admin.MetricsController.profiler-start"));
+		_profilerStart->clicked().connect(this, [this]
+		{
+			const std::size_t durationIndex {static_cast<std::size_t>(std::max(_profilerDuration->currentIndex(), 0))};
+			SamplingProfiler::startCapture(profilerDurations[std::min(durationIndex, profilerDurations.size() - 1)]);
+			refreshProfilerStatus();
+		});
+
+		_profilerDownload = bindNew<Wt::WPushButton>("profiler-download", Wt::WString::tr("Lms.Admin.MetricsController.profiler-download"));
+		Wt::WLink link {std::make_shared<ProfileResource>()};
+		link.setTarget(Wt::LinkTarget::NewWindow);
+		_profilerDownload->setLink(link);
+
+		bindEmpty("profiler-status");
+	}
+
+	// Handled by the main thread, as on SIGHUP: the signal must be sent to the process, not to this thread
+	Wt::WPushButton* reloadSettings {bindNew<Wt::WPushButton>("reload-settings", Wt::WString::tr("Lms.Admin.MetricsController.reload-settings"))};
+	reloadSettings->setToolTip(Wt::WString::tr("Lms.Admin.MetricsController.reload-settings-help"));
+	bindEmpty("reload-settings-status");
+	reloadSettings->clicked().connect(this, [this]
+	{
+		::kill(::getpid(), SIGHUP);
+		bindString("reload-settings-status", Wt::WString::tr("Lms.Admin.MetricsController.reload-settings-requested"));
+	});
+
+	Wt::WTimer* timer {addChild(std::make_unique<Wt::WTimer>())};
+	timer->setInterval(refreshPeriod);
+	timer->timeout().connect(this, [this] { refreshContents(); });
+	timer->start();
+
+	refreshContents();
+}
+
+void
+MetricsController::refreshContents()
+{
+	const Metrics::Snapshot snapshot {Metrics::getSnapshot()};
+
+	const auto now {std::chrono::steady_clock::now()};
+	const double elapsedSeconds {std::chrono::duration<double>(now - _lastRefreshTime).count()};
+	const bool hasPreviousValues {!_lastCounterValues.empty()};
+
+	clearRows(*_counters);
+	for (const auto& [name, counter] : snapshot.counters)
+	{
+		Wt::WString rate;
+		if (hasPreviousValues)
+		{
+			auto itPrevious {_lastCounterValues.find(name)};
+			const std::uint64_t previousValue {itPrevious != std::cend(_lastCounterValues) ? itPrevious->second : 0};
+			rate = rateToString((counter.value - previousValue) / elapsedSeconds);
+		}
+
+		addRow(*_counters, {name, std::to_string(counter.value), rate});
+		_counters->rowAt(_counters->rowCount() - 1)->elementAt(0)->setToolTip(counter.help);
+		_lastCounterValues[name] = counter.value;
+	}
+	for (const auto& [name, gauge] : snapshot.gauges)
+	{
+		addRow(*_counters, {name, std::to_string(gauge.value), {}});
+		_counters->rowAt(_counters->rowCount() - 1)->elementAt(0)->setToolTip(gauge.help);
+	}
+	_lastRefreshTime = now;
+
+	clearRows(*_histograms);
+	for (const auto& [name, histogram] : snapshot.histograms)
+	{
+		const Metrics::Histogram::Snapshot& value {histogram.value};
+		addRow(*_histograms, {name,
+				std::to_string(value.count),
+				durationToString(value.getPercentile(0.5)),
+				durationToString(value.getPercentile(0.9)),
+				durationToString(value.getPercentile(0.99)),
+				durationToString(value.max)});
+		_histograms->rowAt(_histograms->rowCount() - 1)->elementAt(0)->setToolTip(histogram.help);
+	}
+
+	// Caches report their hits and misses using "<cache>_hits_total" and "<cache>_misses_total" counters
+	clearRows(*_cacheRatios);
+	for (const auto& [name, counter] : snapshot.counters)
+	{
+		const std::optional<std::string> cacheName {getCacheName(name)};
+		if (!cacheName)
+			continue;
+
+		auto itMisses {snapshot.counters.find(*cacheName + "_misses_total")};
+		if (itMisses == std::cend(snapshot.counters))
+			continue;
+
+		const std::uint64_t requestCount {counter.value + itMisses->second.value};
+		std::ostringstream ratio;
+		if (requestCount > 0)
+			ratio << std::fixed << std::setprecision(1) << (100.0 * counter.value / requestCount) << " %";
+
+		addRow(*_cacheRatios, {*cacheName, ratio.str(), std::to_string(requestCount)});
+	}
+
+	if (SamplingProfiler::isEnabled())
+		refreshProfilerStatus();
+}
+
+void
+MetricsController::refreshProfilerStatus()
+{
+	const bool captureRunning {SamplingProfiler::isCaptureRunning()};
+	const std::shared_ptr<const SamplingProfiler::CaptureResult> result {SamplingProfiler::getLastCaptureResult()};
+
+	_profilerStart->setEnabled(!captureRunning);
+	_profilerDownload->setEnabled(!captureRunning && result);
+
+	if (captureRunning)
+		bindString("profiler-status", Wt::WString::tr("Lms.Admin.MetricsController.profiler-capture-running"));
+	else if (result)
+		bindString("profiler-status", Wt::WString::tr("Lms.Admin.MetricsController.profiler-last-capture")
+				.arg(result->sampleCount)
+				.arg(result->duration.count())
+				.arg(Wt::WDateTime {result->startTime}.toString())
+				.arg(result->droppedSampleCount));
+	else
+		bindString("profiler-status", Wt::WString::tr("Lms.Admin.MetricsController.profiler-no-capture"));
+}
+
+} // namespace UserInterface
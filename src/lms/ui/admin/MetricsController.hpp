@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <Wt/WTemplate.h>
+
+namespace Wt
+{
+	class WComboBox;
+	class WPushButton;
+	class WTable;
+}
+
+namespace UserInterface
+{
+	// Live view of the process wide metrics registry: counter rates, latency percentiles and cache hit ratios
+	// Also controls the sampling profiler captures, if enabled, and reloads the settings
+	class MetricsController : public Wt::WTemplate
+	{
+		public:
+			MetricsController();
+
+		private:
+			void refreshContents();
+			void refreshProfilerStatus();
+
+			Wt::WTable*	_counters {};
+			Wt::WTable*	_histograms {};
+			Wt::WTable*	_cacheRatios {};
+
+			Wt::WComboBox*		_profilerDuration {};
+			Wt::WPushButton*	_profilerStart {};
+			Wt::WPushButton*	_profilerDownload {};
+
+			// Previous refresh, to compute the rates
+			std::chrono::steady_clock::time_point	_lastRefreshTime;
+			std::map<std::string, std::uint64_t>	_lastCounterValues;
+	};
+} // namespace UserInterface
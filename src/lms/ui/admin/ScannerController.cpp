@@ -100,6 +100,11 @@ class ReportResource : public Wt::WResource
 					response.out() << " - " << duplicateReasonToWString(duplicate.reason).toUTF8() << '\n';
 				}
 			}
+
+			response.out() << std::endl;
+
+			response.out() << Wt::WString::tr("Lms.Admin.ScannerController.profile-header").toUTF8() << std::endl;
+			Scanner::writeProfile(response.out(), _stats);
 		}
 
 	private:
@@ -242,6 +247,13 @@ ScannerController::refreshContents()
 					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-reloading-similarity-engine")
 						.arg(status.currentScanStepStats->progress()));
 					break;
+
+				case Scanner::ScanProgressStep::GeneratingCovers:
+					bindString("step-status", Wt::WString::tr("Lms.Admin.ScannerController.step-generating-covers")
+						.arg(status.currentScanStepStats->processedElems)
+						.arg(status.currentScanStepStats->totalElems)
+						.arg(status.currentScanStepStats->progress()));
+					break;
 			}
 			break;
 	}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CoverImage.hpp"
+
+#include "resource/ImageResource.hpp"
+#include "LmsApplication.hpp"
+
+namespace UserInterface
+{
+	static
+	std::string
+	getSizes(CoverLayout layout)
+	{
+		// Must match the bootstrap columns of the entry templates
+		switch (layout)
+		{
+			case CoverLayout::Grid:	return "(min-width: 992px) 17vw, (min-width: 768px) 25vw, 50vw";
+			case CoverLayout::List:	return "(min-width: 768px) 17vw, 25vw";
+		}
+		return "100vw";
+	}
+
+	template <typename GetUrlFunc>
+	static
+	std::unique_ptr<Wt::WImage>
+	createCover(CoverLayout layout, GetUrlFunc getUrl)
+	{
+		auto cover {std::make_unique<Wt::WImage>()};
+
+		// Same sizes as the ones generated in the cover disk cache, see scanner-generate-cover-sizes
+		cover->setImageLink(getUrl(ImageResource::Size::Large));
+		cover->setAttributeValue("srcset", getUrl(ImageResource::Size::Small) + " " + std::to_string(static_cast<std::size_t>(ImageResource::Size::Small)) + "w, "
+				+ getUrl(ImageResource::Size::Large) + " " + std::to_string(static_cast<std::size_t>(ImageResource::Size::Large)) + "w");
+		cover->setAttributeValue("sizes", getSizes(layout));
+		cover->setAttributeValue("loading", "lazy");
+		cover->setStyleClass("Lms-cover");
+		cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
+
+		return cover;
+	}
+
+	std::unique_ptr<Wt::WImage>
+	createReleaseCover(Database::IdType releaseId, CoverLayout layout)
+	{
+		return createCover(layout, [&](ImageResource::Size size) { return LmsApp->getImageResource()->getReleaseUrl(releaseId, size); });
+	}
+
+	std::unique_ptr<Wt::WImage>
+	createTrackCover(Database::IdType trackId, CoverLayout layout)
+	{
+		return createCover(layout, [&](ImageResource::Size size) { return LmsApp->getImageResource()->getTrackUrl(trackId, size); });
+	}
+}
+
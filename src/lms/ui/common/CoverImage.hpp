@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Wt/WImage.h>
+
+#include "database/Types.hpp"
+
+namespace UserInterface
+{
+	// Layout the cover is displayed in, used to tell the browser which size it needs
+	enum class CoverLayout
+	{
+		Grid,
+		List,
+	};
+
+	// Covers are only requested by the browser when they are about to be visible,
+	// at the smallest generated size that fits the displayed size
+	std::unique_ptr<Wt::WImage> createReleaseCover(Database::IdType releaseId, CoverLayout layout);
+	std::unique_ptr<Wt::WImage> createTrackCover(Database::IdType trackId, CoverLayout layout);
+}
+
@@ -23,6 +23,8 @@
 
 #include <Wt/WLengthValidator.h>
 
+#include "utils/String.hpp"
+
 namespace UserInterface {
 
 std::shared_ptr<Wt::WValidator>
@@ -66,5 +68,43 @@ DirectoryValidator::validate(const Wt::WString& input) const
 		return Wt::WValidator::Result(Wt::ValidationState::Invalid, Wt::WString::tr("Lms.not-a-directory"));
 }
 
+Wt::WValidator::Result
+DirectoriesValidator::validate(const Wt::WString& input) const
+{
+	const std::string inputStr {input.toUTF8()};
+	if (StringUtils::stringTrim(inputStr, " \t\r\n").empty())
+		return Wt::WValidator::validate({});
+
+	const DirectoryValidator directoryValidator;
+	std::vector<std::filesystem::path> directories;
+	for (const std::string_view line : StringUtils::splitStringViews(inputStr, "\r\n"))
+	{
+		const std::string directory {StringUtils::stringTrimEnd(StringUtils::stringTrim(line), "/\\")};
+		if (directory.empty())
+			continue;
+
+		const Wt::WValidator::Result result {directoryValidator.validate(Wt::WString::fromUTF8(directory))};
+		if (result.state() != Wt::ValidationState::Valid)
+			return Wt::WValidator::Result(Wt::ValidationState::Invalid, Wt::WString::fromUTF8(directory + ": ") + result.message());
+
+		directories.emplace_back(directory);
+	}
+
+	// Files would be scanned twice
+	for (const std::filesystem::path& directory : directories)
+	{
+		for (const std::filesystem::path& otherDirectory : directories)
+		{
+			if (&directory == &otherDirectory)
+				continue;
+
+			const std::filesystem::path relativePath {directory.lexically_relative(otherDirectory)};
+			if (!relativePath.empty() && *relativePath.begin() != "..")
+				return Wt::WValidator::Result(Wt::ValidationState::Invalid, Wt::WString::tr("Lms.nested-directories"));
+		}
+	}
+
+	return Wt::WValidator::Result(Wt::ValidationState::Valid);
+}
 
 } // namespace UserInterface
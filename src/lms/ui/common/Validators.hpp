@@ -37,5 +37,12 @@ class DirectoryValidator : public Wt::WValidator
 
 };
 
+// One directory per line, directories must not be nested
+class DirectoriesValidator : public Wt::WValidator
+{
+	public:
+		Wt::WValidator::Result validate(const Wt::WString& input) const override;
+};
+
 } // namespace UserInterface
 
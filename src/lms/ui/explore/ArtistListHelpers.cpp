@@ -34,6 +34,15 @@ namespace UserInterface::ArtistListHelpers
 		return res;
 	}
 
+	std::unique_ptr<Wt::WTemplate>
+	createEntry(const Database::ObjectRef& artist)
+	{
+		auto res {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.Explore.Artists.template.entry"))};
+		res->bindWidget("name", LmsApplication::createArtistAnchor(artist));
+
+		return res;
+	}
+
 	std::unique_ptr<Wt::WTemplate>
 	createEntrySmall(const Wt::Dbo::ptr<Database::Artist>& artist)
 	{
@@ -43,5 +52,14 @@ namespace UserInterface::ArtistListHelpers
 		return res;
 	}
 
+	std::unique_ptr<Wt::WTemplate>
+	createEntrySmall(const Database::ObjectRef& artist)
+	{
+		auto res {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.Explore.Artists.template.entry-small"))};
+		res->bindWidget("name", LmsApplication::createArtistAnchor(artist));
+
+		return res;
+	}
+
 }
 
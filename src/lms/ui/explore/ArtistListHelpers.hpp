@@ -33,6 +33,8 @@ namespace Database
 namespace UserInterface::ArtistListHelpers
 {
 	std::unique_ptr<Wt::WTemplate> createEntry(const Wt::Dbo::ptr<Database::Artist>& artist);
+	std::unique_ptr<Wt::WTemplate> createEntry(const Database::ObjectRef& artist);
 	std::unique_ptr<Wt::WTemplate> createEntrySmall(const Wt::Dbo::ptr<Database::Artist>& artist);
+	std::unique_ptr<Wt::WTemplate> createEntrySmall(const Database::ObjectRef& artist);
 }
 
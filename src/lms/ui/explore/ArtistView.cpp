@@ -29,6 +29,7 @@
 #include "database/ScanSettings.hpp"
 #include "database/Session.hpp"
 #include "database/User.hpp"
+#include "database/UserStateJournal.hpp"
 #include "recommendation/IEngine.hpp"
 #include "utils/Logger.hpp"
 #include "utils/String.hpp"
@@ -137,6 +138,11 @@ Artist::refreshView()
 					artistsAction.emit(PlayQueueAction::PlayLast, {*artistId});
 				});
 
+			// Stars may have been queued using the Subsonic API
+			Database::UserStateJournal& journal {LmsApp->getDb().getUserStateJournal()};
+			if (journal.hasPendingUpdates(LmsApp->getUser().id()))
+				journal.flush();
+
 			bool isStarred {};
 			{
 				auto transaction {LmsApp->getDbSession().createSharedTransaction()};
@@ -147,16 +153,10 @@ Artist::refreshView()
 			popup->addItem(Wt::WString::tr(isStarred ? "Lms.Explore.unstar" : "Lms.Explore.star"))
 				->triggered().connect(this, [=]
 					{
-						auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-						auto artist {Database::Artist::getById(LmsApp->getDbSession(), *artistId)};
-						if (!artist)
-							return;
-
-						if (isStarred)
-							LmsApp->getUser().modify()->unstarArtist(artist);
-						else
-							LmsApp->getUser().modify()->starArtist(artist);
+						// Queued after the pending Subsonic stars, so that the last change wins
+						Database::UserStateJournal& journal {LmsApp->getDb().getUserStateJournal()};
+						journal.setArtistStarred(LmsApp->getUser().id(), *artistId, !isStarred);
+						journal.flush();
 					});
 			popup->addItem(Wt::WString::tr("Lms.Explore.download"))
 				->setLink(Wt::WLink {std::make_unique<DownloadArtistResource>(*artistId)});
@@ -183,14 +183,9 @@ Artist::refreshSimilarArtists(const std::unordered_set<Database::IdType>& simila
 	setCondition("if-has-similar-artists", true);
 	Wt::WContainerWidget* similarArtistsContainer {bindNew<Wt::WContainerWidget>("similar-artists")};
 
-	for (Database::IdType artistId : similarArtistsId)
-	{
-		const Database::Artist::pointer similarArtist{Database::Artist::getById(LmsApp->getDbSession(), artistId)};
-		if (!similarArtist)
-			continue;
-
+	const std::vector<Database::Artist::pointer> similarArtists {Database::Artist::getByIds(LmsApp->getDbSession(), std::vector<Database::IdType>(std::cbegin(similarArtistsId), std::cend(similarArtistsId)))};
+	for (const Database::Artist::pointer& similarArtist : similarArtists)
 		similarArtistsContainer->addWidget(ArtistListHelpers::createEntrySmall(similarArtist));
-	}
 }
 
 void
@@ -201,7 +196,7 @@ Artist::refreshLinks(const Database::Artist::pointer& artist)
 	{
 		setCondition("if-has-mbid", true);
 
-		Wt::WLink link {"https://musicbrainz.org/artist/" + std::string {mbid->getAsString()}};
+		Wt::WLink link {"https://musicbrainz.org/artist/" + mbid->getAsString()};
 		link.setTarget(Wt::LinkTarget::NewWindow);
 
 		bindNew<Wt::WAnchor>("mbid-link", link, Wt::WString::tr("Lms.Explore.musicbrainz-artist"));
@@ -30,9 +30,11 @@
 #include "database/TrackArtistLink.hpp"
 #include "database/TrackList.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 
 #include "common/LoadingIndicator.hpp"
 #include "ArtistListHelpers.hpp"
+#include "LibraryCache.hpp"
 #include "LmsApplication.hpp"
 #include "Filters.hpp"
 
@@ -40,6 +42,22 @@ using namespace Database;
 
 namespace UserInterface {
 
+namespace {
+
+struct ArtistsPage
+{
+	struct Entry
+	{
+		ObjectRef	artist;
+		std::string	sortName;	// for keyset pagination
+	};
+
+	std::vector<Entry>	entries;
+	bool				moreResults {};
+};
+
+} // namespace
+
 using ArtistLinkModel = ValueStringModel<std::optional<TrackArtistLinkType>>;
 
 Artists::Artists(Filters* filters)
@@ -91,6 +109,7 @@ Artists::refreshView()
 {
 	_container->clear();
 	_randomArtists.clear();
+	_cursor.reset();
 	addSome();
 }
 
@@ -166,12 +185,7 @@ Artists::getRandomArtists(std::optional<Range> range, bool& moreResults)
 		auto itBegin {std::cbegin(_randomArtists) + std::min(range ? range->offset : 0, _randomArtists.size())};
 		auto itEnd {std::cbegin(_randomArtists) + std::min(range ? range->offset + range->limit : _randomArtists.size(), _randomArtists.size())};
 
-		for (auto it {itBegin}; it != itEnd; ++it)
-		{
-			Artist::pointer artist {Artist::getById(LmsApp->getDbSession(), *it)};
-			if (artist)
-				artists.push_back(artist);
-		}
+		artists = Artist::getByIds(LmsApp->getDbSession(), std::vector<Database::IdType>(itBegin, itEnd));
 
 		moreResults = (itEnd != std::cend(_randomArtists));
 	}
@@ -195,6 +209,10 @@ Artists::getArtists(std::optional<Range> range, bool& moreResults)
 			range = Range {0, *modeLimit};
 	}
 
+	// Use keyset pagination when displaying the next entries of the modes ordered by name
+	const bool useCursor {range && _mode == Mode::All && (range->offset == 0 || (_cursor && range->offset == _cursorOffset))};
+	const std::optional<Cursor> cursor {useCursor && range->offset > 0 ? _cursor : std::nullopt};
+
 	switch (_mode)
 	{
 		case Mode::Random:
@@ -233,18 +251,32 @@ Artists::getArtists(std::optional<Range> range, bool& moreResults)
 			break;
 
 		case Mode::All:
-			artists = Artist::getByFilter(LmsApp->getDbSession(),
-						_filters->getClusterIds(),
-						{},
-						linkType,
-						Artist::SortMethod::BySortName,
-						range, moreResults);
+			if (useCursor)
+				artists = Artist::getByFilter(LmsApp->getDbSession(),
+							_filters->getClusterIds(),
+							{},
+							linkType,
+							Artist::SortMethod::BySortName,
+							cursor, range->limit, moreResults);
+			else
+				artists = Artist::getByFilter(LmsApp->getDbSession(),
+							_filters->getClusterIds(),
+							{},
+							linkType,
+							Artist::SortMethod::BySortName,
+							range, moreResults);
 			break;
 
 		default:
 			break;
 	}
 
+	if (useCursor && !artists.empty())
+	{
+		_cursor = Cursor {artists.back()->getSortName(), artists.back().id()};
+		_cursorOffset = range->offset + artists.size();
+	}
+
 	if (range && modeLimit && (range->offset + range->limit == *modeLimit))
 		moreResults = false;
 
@@ -256,13 +288,39 @@ Artists::addSome()
 {
 	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
-	bool moreResults {};
-	for (const Artist::pointer& artist : getArtists(Range {static_cast<std::size_t>(_container->count()), batchSize}, moreResults))
+	const Range range {static_cast<std::size_t>(_container->count()), batchSize};
+	const std::optional<TrackArtistLinkType> linkType {static_cast<ArtistLinkModel*>(_linkType->model().get())->getValue(_linkType->currentIndex())};
+
+	auto fetchPage {[&]
+	{
+		ArtistsPage page;
+		for (const Artist::pointer& artist : getArtists(range, page.moreResults))
+			page.entries.push_back(ArtistsPage::Entry {ObjectRef {artist.id(), artist->getName()}, artist->getSortName()});
+
+		return page;
+	}};
+
+	// The other modes depend on the user or are shuffled per session
+	const bool isLibraryWide {_mode == Mode::RecentlyAdded || _mode == Mode::All};
+	const std::shared_ptr<const ArtistsPage> page {isLibraryWide
+		? Service<LibraryCache>::get()->get<ArtistsPage>("artists/" + std::to_string(static_cast<int>(_mode))
+				+ "/" + (linkType ? std::to_string(static_cast<int>(*linkType)) : "")
+				+ "/" + _filters->getCacheKey() + "/" + std::to_string(range.offset), fetchPage)
+		: std::make_shared<const ArtistsPage>(fetchPage())};
+
+	// Pages from the cache did not go through getArtists
+	if (_mode == Mode::All && !page->entries.empty())
+	{
+		_cursor = Cursor {page->entries.back().sortName, page->entries.back().artist.id};
+		_cursorOffset = range.offset + page->entries.size();
+	}
+
+	for (const ArtistsPage::Entry& entry : page->entries)
 	{
-		_container->addWidget(ArtistListHelpers::createEntry(artist));
+		_container->addWidget(ArtistListHelpers::createEntry(entry.artist));
 	}
 
-	if (moreResults)
+	if (page->moreResults)
 		displayLoadingIndicator();
 	else
 		hideLoadingIndicator();
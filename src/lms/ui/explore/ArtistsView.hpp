@@ -20,6 +20,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -77,6 +78,8 @@ class Artists : public Wt::WTemplate
 
 		Mode _mode {defaultMode};
 		std::vector<Database::IdType> _randomArtists;
+		std::optional<Database::Cursor> _cursor;	// last displayed entry, if displayed using keyset pagination
+		std::size_t _cursorOffset {};
 		Filters* _filters {};
 		Wt::WTemplate* _loadingIndicator {};
 		Wt::WContainerWidget* _container {};
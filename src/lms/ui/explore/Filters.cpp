@@ -19,6 +19,9 @@
 
 #include "Filters.hpp"
 
+#include <memory>
+#include <vector>
+
 #include <Wt/WComboBox.h>
 #include <Wt/WDialog.h>
 #include <Wt/WPushButton.h>
@@ -26,11 +29,43 @@
 
 #include "database/Cluster.hpp"
 #include "database/Session.hpp"
+#include "utils/Service.hpp"
 
+#include "LibraryCache.hpp"
 #include "LmsApplication.hpp"
 
 namespace UserInterface {
 
+namespace {
+
+struct ClusterTypeEntry
+{
+	Database::ObjectRef					type;
+	std::vector<Database::ObjectRef>	clusters;
+};
+using ClusterTypeEntries = std::vector<ClusterTypeEntry>;
+
+std::shared_ptr<const ClusterTypeEntries>
+getClusterTypeEntries()
+{
+	return Service<LibraryCache>::get()->get<ClusterTypeEntries>("filters/cluster-types", []
+	{
+		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+
+		ClusterTypeEntries entries;
+		for (const Database::ClusterType::pointer& type : Database::ClusterType::getAllUsed(LmsApp->getDbSession()))
+		{
+			ClusterTypeEntry& entry {entries.emplace_back(ClusterTypeEntry {Database::ObjectRef {type.id(), type->getName()}, {}})};
+			for (const Database::Cluster::pointer& cluster : type->getClusters())
+				entry.clusters.push_back(Database::ObjectRef {cluster.id(), cluster->getName()});
+		}
+
+		return entries;
+	});
+}
+
+} // namespace
+
 void
 Filters::showDialog()
 {
@@ -48,42 +83,36 @@ Filters::showDialog()
 	Wt::WPushButton* cancelBtn = container->bindNew<Wt::WPushButton>("cancel-btn", Wt::WString::tr("Lms.cancel"));
 	cancelBtn->clicked().connect(dialog.get(), &Wt::WDialog::reject);
 
-	// Populate data
+	// Populate data, shared by all the sessions
+	const std::shared_ptr<const ClusterTypeEntries> clusterTypes {getClusterTypeEntries()};
+	auto valueIds {std::make_shared<std::vector<Database::IdType>>()}; // cluster ids, by value combo index
+
+	auto populateValues {[=](std::size_t typeIndex)
 	{
-		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+		valueCombo->clear();
+		valueIds->clear();
 
-		const auto types {Database::ClusterType::getAllUsed(LmsApp->getDbSession())};
-		for (const Database::ClusterType::pointer& type : types)
-			typeCombo->addItem(Wt::WString::fromUTF8(type->getName()));
+		if (typeIndex >= clusterTypes->size())
+			return;
 
-		if (!types.empty())
+		for (const Database::ObjectRef& cluster : (*clusterTypes)[typeIndex].clusters)
 		{
-			const auto values {types.front()->getClusters()};
-
-			for (const Database::Cluster::pointer& value : values)
+			if (_filterIds.find(cluster.id) == _filterIds.end())
 			{
-				if (_filterIds.find(value.id()) == _filterIds.end())
-					valueCombo->addItem(Wt::WString::fromUTF8(value->getName()));
+				valueCombo->addItem(Wt::WString::fromUTF8(cluster.name));
+				valueIds->push_back(cluster.id);
 			}
 		}
-	}
-
-	typeCombo->changed().connect([=]
-	{
-		const std::string name {typeCombo->valueText().toUTF8()};
-
-		valueCombo->clear();
+	}};
 
-		auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+	for (const ClusterTypeEntry& type : *clusterTypes)
+		typeCombo->addItem(Wt::WString::fromUTF8(type.type.name));
 
-		auto clusterType = Database::ClusterType::getByName(LmsApp->getDbSession(), name);
+	populateValues(0);
 
-		const auto values = clusterType->getClusters();
-		for (const Database::Cluster::pointer& value : values)
-		{
-			if (_filterIds.find(value.id()) == _filterIds.end())
-				valueCombo->addItem(Wt::WString::fromUTF8(value->getName()));
-		}
+	typeCombo->changed().connect([=]
+	{
+		populateValues(static_cast<std::size_t>(typeCombo->currentIndex()));
 	});
 
 	dialog->setModal(true);
@@ -97,30 +126,29 @@ Filters::showDialog()
 		if (dialog->result() != Wt::DialogCode::Accepted)
 			return;
 
-		const std::string type {typeCombo->valueText().toUTF8()};
-		const std::string value {valueCombo->valueText().toUTF8()};
-
-		// TODO use a model to store the cluster.id() values
-		Database::IdType clusterId {};
-
-		{
-			auto transaction {LmsApp->getDbSession().createSharedTransaction()};
+		const int valueIndex {valueCombo->currentIndex()};
+		if (valueIndex < 0 || static_cast<std::size_t>(valueIndex) >= valueIds->size())
+			return;
 
-			Database::ClusterType::pointer clusterType {Database::ClusterType::getByName(LmsApp->getDbSession(), type)};
-			if (!clusterType)
-				return;
+		add((*valueIds)[valueIndex]);
+	});
 
-			Database::Cluster::pointer cluster {clusterType->getCluster(value)};
-			if (!cluster)
-				return;
+	dialog->show();
+}
 
-			clusterId = cluster.id();
-		}
+std::string
+Filters::getCacheKey() const
+{
+	std::string res;
 
-		add(clusterId);
-	});
+	for (const Database::IdType clusterId : _filterIds)
+	{
+		if (!res.empty())
+			res += ",";
+		res += std::to_string(clusterId);
+	}
 
-	dialog->show();
+	return res;
 }
 
 void
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <set>
+#include <string>
+
 #include <Wt/WContainerWidget.h>
 #include <Wt/WSignal.h>
 #include <Wt/WTemplate.h>
@@ -37,6 +40,7 @@ class Filters : public Wt::WTemplate
 		void add(Database::IdType clusterId);
 
 		std::set<Database::IdType> getClusterIds() const { return _filterIds; }
+		std::string getCacheKey() const; // identifies the selected clusters in LibraryCache keys
 
 		Wt::Signal<>& updated() { return _sigUpdated; }
 
@@ -25,7 +25,7 @@
 
 #include "database/Artist.hpp"
 #include "database/Release.hpp"
-#include "resource/ImageResource.hpp"
+#include "common/CoverImage.hpp"
 
 #include "LmsApplication.hpp"
 
@@ -43,11 +43,7 @@ namespace UserInterface::ReleaseListHelpers
 		entry->bindWidget("release-name", LmsApplication::createReleaseAnchor(release));
 
 		Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false));
-		auto cover = std::make_unique<Wt::WImage>();
-		cover->setImageLink(LmsApp->getImageResource()->getReleaseUrl(release.id(), ImageResource::Size::Large));
-		cover->setStyleClass("Lms-cover");
-		cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
-		anchor->setImage(std::move(cover));
+		anchor->setImage(createReleaseCover(release.id(), CoverLayout::Grid));
 
 		auto artists = release->getReleaseArtists();
 		if (artists.empty())
@@ -94,9 +90,27 @@ namespace UserInterface::ReleaseListHelpers
 	}
 
 	std::unique_ptr<Wt::WTemplate>
-	createEntry(const Release::pointer& release)
+	createEntry(const Release::ListEntry& release)
 	{
-		return createEntry(release, Artist::pointer {}, false /*year*/);
+		auto entry {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.Explore.Releases.template.entry-grid"))};
+
+		entry->bindWidget("release-name", LmsApplication::createReleaseAnchor(ObjectRef {release.id, release.name}));
+
+		Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(ObjectRef {release.id, release.name}, false));
+		anchor->setImage(createReleaseCover(release.id, CoverLayout::Grid));
+
+		if (release.artists.size() > 1)
+		{
+			entry->setCondition("if-has-artist", true);
+			entry->bindNew<Wt::WText>("artist-name", Wt::WString::tr("Lms.Explore.various-artists"));
+		}
+		else if (release.artists.size() == 1)
+		{
+			entry->setCondition("if-has-artist", true);
+			entry->bindWidget("artist-name", LmsApplication::createArtistAnchor(release.artists.front()));
+		}
+
+		return entry;
 	}
 
 	std::unique_ptr<Wt::WTemplate>
@@ -23,15 +23,16 @@
 
 #include <Wt/WTemplate.h>
 
+#include "database/Release.hpp"
+
 namespace Database
 {
 	class Artist;
-	class Release;
 }
 
 namespace UserInterface::ReleaseListHelpers
 {
-	std::unique_ptr<Wt::WTemplate> createEntry(const Wt::Dbo::ptr<Database::Release>& release);
+	std::unique_ptr<Wt::WTemplate> createEntry(const Database::Release::ListEntry& release);
 	std::unique_ptr<Wt::WTemplate> createEntryForArtist(const Wt::Dbo::ptr<Database::Release>& release, const Wt::Dbo::ptr<Database::Artist>& artist);
 } // namespace UserInterface
 
@@ -22,6 +22,7 @@
 #include "database/Release.hpp"
 #include "database/Session.hpp"
 #include "database/User.hpp"
+#include "database/UserStateJournal.hpp"
 #include "resource/DownloadResource.hpp"
 #include "LmsApplication.hpp"
 
@@ -46,6 +47,11 @@ namespace UserInterface
 						releasesAction.emit(PlayQueueAction::PlayLast, {releaseId});
 					});
 
+			// Stars may have been queued using the Subsonic API
+			Database::UserStateJournal& journal {LmsApp->getDb().getUserStateJournal()};
+			if (journal.hasPendingUpdates(LmsApp->getUser().id()))
+				journal.flush();
+
 			bool isStarred {};
 			{
 				auto transaction {LmsApp->getDbSession().createSharedTransaction()};
@@ -57,16 +63,10 @@ namespace UserInterface
 			popup->addItem(Wt::WString::tr(isStarred ? "Lms.Explore.unstar" : "Lms.Explore.star"))
 				->triggered().connect(&target, [=]
 					{
-						auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-						auto release {Database::Release::getById(LmsApp->getDbSession(), releaseId)};
-						if (!release)
-							return;
-
-						if (isStarred)
-							LmsApp->getUser().modify()->unstarRelease(release);
-						else
-							LmsApp->getUser().modify()->starRelease(release);
+						// Queued after the pending Subsonic stars, so that the last change wins
+						Database::UserStateJournal& journal {LmsApp->getDb().getUserStateJournal()};
+						journal.setReleaseStarred(LmsApp->getUser().id(), releaseId, !isStarred);
+						journal.flush();
 					});
 			popup->addItem(Wt::WString::tr("Lms.Explore.download"))
 				->setLink(Wt::WLink {std::make_unique<DownloadReleaseResource>(releaseId)});
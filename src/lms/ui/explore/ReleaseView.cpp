@@ -299,7 +299,7 @@ Release::refreshLinks(const Database::Release::pointer& release)
 	{
 		setCondition("if-has-mbid", true);
 
-		Wt::WLink link {"https://musicbrainz.org/release/" + std::string {mbid->getAsString()}};
+		Wt::WLink link {"https://musicbrainz.org/release/" + mbid->getAsString()};
 		link.setTarget(Wt::LinkTarget::NewWindow);
 
 		bindNew<Wt::WAnchor>("mbid-link", link, Wt::WString::tr("Lms.Explore.musicbrainz-release"));
@@ -315,14 +315,9 @@ Release::refreshSimilarReleases(const std::unordered_set<Database::IdType>& simi
 	setCondition("if-has-similar-releases", true);
 	auto* similarReleasesContainer {bindNew<Wt::WContainerWidget>("similar-releases")};
 
-	for (Database::IdType id : similarReleasesId)
-	{
-		Database::Release::pointer similarRelease{Database::Release::getById(LmsApp->getDbSession(), id)};
-		if (!similarRelease)
-			continue;
-
+	const std::vector<Database::Release::ListEntry> similarReleases {Database::Release::getListEntries(LmsApp->getDbSession(), std::vector<Database::IdType>(std::cbegin(similarReleasesId), std::cend(similarReleasesId)))};
+	for (const Database::Release::ListEntry& similarRelease : similarReleases)
 		similarReleasesContainer->addWidget(ReleaseListHelpers::createEntry(similarRelease));
-	}
 }
 
 } // namespace UserInterface
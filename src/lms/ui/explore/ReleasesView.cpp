@@ -31,18 +31,30 @@
 #include "database/TrackList.hpp"
 #include "database/User.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 #include "utils/String.hpp"
 
 #include "common/LoadingIndicator.hpp"
 #include "resource/ImageResource.hpp"
 #include "ReleaseListHelpers.hpp"
 #include "Filters.hpp"
+#include "LibraryCache.hpp"
 #include "LmsApplication.hpp"
 
 using namespace Database;
 
 namespace UserInterface {
 
+namespace {
+
+struct ReleasesPage
+{
+	std::vector<Release::ListEntry>	entries;
+	bool							moreResults {};
+};
+
+} // namespace
+
 Releases::Releases(Filters* filters)
 : Wt::WTemplate {Wt::WString::tr("Lms.Explore.Releases.template")},
 _filters {filters}
@@ -106,6 +118,7 @@ Releases::refreshView()
 {
 	_container->clear();
 	_randomReleases.clear();
+	_cursor.reset();
 	addSome();
 }
 
@@ -139,17 +152,42 @@ Releases::hideLoadingIndicator()
 void
 Releases::addSome()
 {
-	bool moreResults {};
-
 	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
-	const auto releases {getReleases(Range {static_cast<std::size_t>(_container->count()), batchSize}, moreResults)};
 
-	for (const Release::pointer& release : releases)
+	const Range range {static_cast<std::size_t>(_container->count()), batchSize};
+
+	auto fetchPage {[&]
+	{
+		ReleasesPage page;
+		const auto releases {getReleases(range, page.moreResults)};
+
+		std::vector<IdType> releaseIds;
+		releaseIds.reserve(releases.size());
+		std::transform(std::cbegin(releases), std::cend(releases), std::back_inserter(releaseIds), [](const Release::pointer& release) { return release.id(); });
+
+		page.entries = Release::getListEntries(LmsApp->getDbSession(), releaseIds);
+		return page;
+	}};
+
+	// The other modes depend on the user or are shuffled per session
+	const bool isLibraryWide {_mode == Mode::RecentlyAdded || _mode == Mode::All};
+	const std::shared_ptr<const ReleasesPage> page {isLibraryWide
+		? Service<LibraryCache>::get()->get<ReleasesPage>("releases/" + std::to_string(static_cast<int>(_mode)) + "/" + _filters->getCacheKey() + "/" + std::to_string(range.offset), fetchPage)
+		: std::make_shared<const ReleasesPage>(fetchPage())};
+
+	// Pages from the cache did not go through getReleases
+	if (_mode == Mode::All && !page->entries.empty())
+	{
+		_cursor = Cursor {page->entries.back().name, page->entries.back().id};
+		_cursorOffset = range.offset + page->entries.size();
+	}
+
+	for (const Release::ListEntry& release : page->entries)
 	{
 		_container->addWidget(ReleaseListHelpers::createEntry(release));
 	}
 
-	if (moreResults)
+	if (page->moreResults)
 		displayLoadingIndicator();
 	else
 		hideLoadingIndicator();
@@ -167,12 +205,7 @@ Releases::getRandomReleases(std::optional<Range> range, bool& moreResults)
 		auto itBegin {std::cbegin(_randomReleases) + std::min(range ? range->offset : 0, _randomReleases.size())};
 		auto itEnd {std::cbegin(_randomReleases) + std::min(range ? range->offset + range->limit : _randomReleases.size(), _randomReleases.size())};
 
-		for (auto it {itBegin}; it != itEnd; ++it)
-		{
-			Release::pointer release {Release::getById(LmsApp->getDbSession(), *it)};
-			if (release)
-				releases.push_back(release);
-		}
+		releases = Release::getByIds(LmsApp->getDbSession(), std::vector<Database::IdType>(itBegin, itEnd));
 
 		moreResults = (itEnd != std::cend(_randomReleases));
 	}
@@ -194,6 +227,10 @@ Releases::getReleases(std::optional<Range> range, bool& moreResults)
 			range = Range {0, *modeLimit};
 	}
 
+	// Use keyset pagination when displaying the next entries of the modes ordered by name
+	const bool useCursor {range && (_mode == Mode::Starred || _mode == Mode::All) && (range->offset == 0 || (_cursor && range->offset == _cursorOffset))};
+	const std::optional<Cursor> cursor {useCursor && range->offset > 0 ? _cursor : std::nullopt};
+
 	switch (_mode)
 	{
 		case Mode::Random:
@@ -201,7 +238,10 @@ Releases::getReleases(std::optional<Range> range, bool& moreResults)
 			break;
 
 		case Mode::Starred:
-			releases = Release::getStarred(LmsApp->getDbSession(), LmsApp->getUser(), _filters->getClusterIds(), range, moreResults);
+			if (useCursor)
+				releases = Release::getStarred(LmsApp->getDbSession(), LmsApp->getUser(), _filters->getClusterIds(), cursor, range->limit, moreResults);
+			else
+				releases = Release::getStarred(LmsApp->getDbSession(), LmsApp->getUser(), _filters->getClusterIds(), range, moreResults);
 			break;
 
 		case Mode::RecentlyPlayed:
@@ -217,10 +257,19 @@ Releases::getReleases(std::optional<Range> range, bool& moreResults)
 			break;
 
 		case Mode::All:
-			releases = Release::getByFilter(LmsApp->getDbSession(), _filters->getClusterIds(), {}, range, moreResults);
+			if (useCursor)
+				releases = Release::getByFilter(LmsApp->getDbSession(), _filters->getClusterIds(), {}, cursor, range->limit, moreResults);
+			else
+				releases = Release::getByFilter(LmsApp->getDbSession(), _filters->getClusterIds(), {}, range, moreResults);
 			break;
 	}
 
+	if (useCursor && !releases.empty())
+	{
+		_cursor = Cursor {releases.back()->getName(), releases.back().id()};
+		_cursorOffset = range->offset + releases.size();
+	}
+
 	if (range && modeLimit && (range->offset + range->limit == *modeLimit))
 		moreResults = false;
 
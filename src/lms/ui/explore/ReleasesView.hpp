@@ -81,6 +81,8 @@ class Releases : public Wt::WTemplate
 		Mode _mode {defaultMode};
 		Filters* _filters {};
 		std::vector<Database::IdType> _randomReleases;
+		std::optional<Database::Cursor> _cursor;	// last displayed entry, if displayed using keyset pagination
+		std::size_t _cursorOffset {};
 		Wt::WContainerWidget* _container {};
 		Wt::WTemplate* _loadingIndicator {};
 };
@@ -19,6 +19,10 @@
 
 #include "SearchView.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
 #include <Wt/WAnchor.h>
 #include <Wt/WImage.h>
 
@@ -26,6 +30,7 @@
 #include "database/Release.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
+#include "utils/String.hpp"
 
 #include "resource/ImageResource.hpp"
 #include "ArtistListHelpers.hpp"
@@ -35,27 +40,92 @@
 #include "TrackListHelpers.hpp"
 
 static constexpr std::size_t maxEntries {6};
+static constexpr std::chrono::milliseconds searchDelay {250};
 
 namespace UserInterface
 {
+	namespace
+	{
+		// Keywords are completed or appended while the user types: the matching entries can only be fewer
+		bool
+		isRefinement(const std::vector<std::string>& previousKeywords, const std::vector<std::string>& keywords)
+		{
+			if (keywords.size() < previousKeywords.size())
+				return false;
+
+			return std::equal(std::cbegin(previousKeywords), std::cend(previousKeywords), std::cbegin(keywords),
+				[](const std::string& previousKeyword, const std::string& keyword) { return keyword.compare(0, previousKeyword.size(), previousKeyword) == 0; });
+		}
+
+		// Only the 'LIKE' clauses can be evaluated here the same way the database does
+		bool
+		canMatchInMemory(const std::vector<std::string>& keywords)
+		{
+			if (LmsApp->getDbSession().canUseSearchIndex(keywords))
+				return false;
+
+			// LIKE wildcards
+			return std::none_of(std::cbegin(keywords), std::cend(keywords), [](const std::string& keyword) { return keyword.find_first_of("%_") != std::string::npos; });
+		}
+
+		// Same as 'LIKE': case insensitive for ASCII characters only
+		bool
+		matchesAllKeywords(const std::string& str, const std::vector<std::string>& keywords)
+		{
+			auto toLower {[](unsigned char c) { return static_cast<char>(c < 0x80 ? std::tolower(c) : c); }};
+
+			std::string lowerStr;
+			std::transform(std::cbegin(str), std::cend(str), std::back_inserter(lowerStr), toLower);
+
+			return std::all_of(std::cbegin(keywords), std::cend(keywords), [&](const std::string& keyword)
+			{
+				std::string lowerKeyword;
+				std::transform(std::cbegin(keyword), std::cend(keyword), std::back_inserter(lowerKeyword), toLower);
+
+				return lowerStr.find(lowerKeyword) != std::string::npos;
+			});
+		}
+	}
 
 	SearchView::SearchView(Filters* filters)
 	: Wt::WTemplate {Wt::WString::tr("Lms.Explore.Search.template")}
 	, _filters {filters}
+	, _searchTimer {addChild(std::make_unique<Wt::WTimer>())}
 	{
 		addFunction("tr", &Wt::WTemplate::Functions::tr);
 
-		_filters->updated().connect([=]
+		// Superseded searches are cancelled by restarting the timer
+		_searchTimer->setSingleShot(true);
+		_searchTimer->setInterval(searchDelay);
+		_searchTimer->timeout().connect([=]
 		{
+			if (_keywords && *_keywords == _pendingKeywords)
+				return;
+
+			_keywords = _pendingKeywords;
 			refreshView();
 		});
+
+		_filters->updated().connect([=]
+		{
+			clearResults();
+			if (_keywords)
+				refreshView();
+		});
+
+		LmsApp->dbScanned.connect(this, [=]
+		{
+			clearResults();
+		});
 	}
 
 	void
 	SearchView::refreshView(const Wt::WString& searchText)
 	{
-		_keywords = StringUtils::splitString(searchText.toUTF8(), " ");
-		refreshView();
+		_pendingKeywords = StringUtils::splitString(searchText.toUTF8(), " ");
+
+		_searchTimer->stop();
+		_searchTimer->start();
 	}
 
 	void
@@ -70,44 +140,103 @@ namespace UserInterface
 		searchTracks();
 	}
 
+	void
+	SearchView::clearResults()
+	{
+		_artists.reset();
+		_releases.reset();
+		_tracks.reset();
+	}
+
+	template <typename T, typename MatchFunc, typename FetchFunc>
+	void
+	SearchView::updateResults(std::optional<SearchResults<T>>& results, const std::vector<std::string>& keywords, MatchFunc matchFunc, FetchFunc fetchFunc)
+	{
+		if (results && results->complete && isRefinement(results->keywords, keywords))
+		{
+			// Switching between the search index and 'LIKE' clauses may bring new matches
+			const bool sameMatchMethod {LmsApp->getDbSession().canUseSearchIndex(results->keywords) == LmsApp->getDbSession().canUseSearchIndex(keywords)};
+
+			if (sameMatchMethod && (results->entries.empty() || canMatchInMemory(keywords)))
+			{
+				results->entries.erase(std::remove_if(std::begin(results->entries), std::end(results->entries),
+							[&](const T& entry) { return !matchFunc(entry, keywords); }),
+							std::end(results->entries));
+				results->keywords = keywords;
+				return;
+			}
+		}
+
+		bool moreResults {};
+		std::vector<T> entries {fetchFunc(moreResults)};
+		results = SearchResults<T> {keywords, std::move(entries), !moreResults};
+	}
+
 	void
 	SearchView::searchArtists()
 	{
-		bool more;
-		const auto artists {Database::Artist::getByFilter(LmsApp->getDbSession(),
-								_filters->getClusterIds(),
-								_keywords,
-								std::nullopt,
-								Database::Artist::SortMethod::BySortName,
-								Database::Range {0, maxEntries}, more)};
-
-		if (!artists.empty())
+		updateResults(_artists, *_keywords,
+			[](const ArtistEntry& entry, const std::vector<std::string>& keywords)
+			{
+				return matchesAllKeywords(entry.artist.name, keywords) || matchesAllKeywords(entry.sortName, keywords);
+			},
+			[this](bool& moreResults)
+			{
+				const auto artists {Database::Artist::getByFilter(LmsApp->getDbSession(),
+										_filters->getClusterIds(),
+										*_keywords,
+										std::nullopt,
+										Database::Artist::SortMethod::BySortName,
+										Database::Range {0, maxEntries}, moreResults)};
+
+				std::vector<ArtistEntry> entries;
+				entries.reserve(artists.size());
+				std::transform(std::cbegin(artists), std::cend(artists), std::back_inserter(entries),
+					[](const Database::Artist::pointer& artist) { return ArtistEntry {Database::ObjectRef {artist.id(), artist->getName()}, artist->getSortName()}; });
+
+				return entries;
+			});
+
+		if (!_artists->entries.empty())
 		{
 			setCondition("if-artists", true);
 
 			auto* container {bindNew<Wt::WContainerWidget>("artists")};
 
-			for (const Database::Artist::pointer& artist : artists)
-				container->addWidget(ArtistListHelpers::createEntrySmall(artist));
+			for (const ArtistEntry& entry : _artists->entries)
+				container->addWidget(ArtistListHelpers::createEntrySmall(entry.artist));
 		}
 	}
 
 	void
 	SearchView::searchReleases()
 	{
-		bool more;
-		const auto releases {Database::Release::getByFilter(LmsApp->getDbSession(),
-								_filters->getClusterIds(),
-								_keywords,
-								Database::Range {0, maxEntries}, more)};
+		updateResults(_releases, *_keywords,
+			[](const Database::Release::ListEntry& entry, const std::vector<std::string>& keywords)
+			{
+				return matchesAllKeywords(entry.name, keywords);
+			},
+			[this](bool& moreResults)
+			{
+				const auto releases {Database::Release::getByFilter(LmsApp->getDbSession(),
+										_filters->getClusterIds(),
+										*_keywords,
+										Database::Range {0, maxEntries}, moreResults)};
+
+				std::vector<Database::IdType> releaseIds;
+				releaseIds.reserve(releases.size());
+				std::transform(std::cbegin(releases), std::cend(releases), std::back_inserter(releaseIds), [](const Database::Release::pointer& release) { return release.id(); });
+
+				return Database::Release::getListEntries(LmsApp->getDbSession(), releaseIds);
+			});
 
-		if (!releases.empty())
+		if (!_releases->entries.empty())
 		{
 			setCondition("if-releases", true);
 
 			auto* container {bindNew<Wt::WContainerWidget>("releases")};
 
-			for (const Database::Release::pointer& release : releases)
+			for (const Database::Release::ListEntry& release : _releases->entries)
 				container->addWidget(ReleaseListHelpers::createEntry(release));
 		}
 	}
@@ -115,19 +244,32 @@ namespace UserInterface
 	void
 	SearchView::searchTracks()
 	{
-		bool more;
-		const auto tracks {Database::Track::getByFilter(LmsApp->getDbSession(),
-								_filters->getClusterIds(),
-								_keywords,
-								Database::Range {0, maxEntries}, more)};
+		updateResults(_tracks, *_keywords,
+			[](const Database::Track::ListEntry& entry, const std::vector<std::string>& keywords)
+			{
+				return matchesAllKeywords(entry.name, keywords);
+			},
+			[this](bool& moreResults)
+			{
+				const auto tracks {Database::Track::getByFilter(LmsApp->getDbSession(),
+										_filters->getClusterIds(),
+										*_keywords,
+										Database::Range {0, maxEntries}, moreResults)};
+
+				std::vector<Database::IdType> trackIds;
+				trackIds.reserve(tracks.size());
+				std::transform(std::cbegin(tracks), std::cend(tracks), std::back_inserter(trackIds), [](const Database::Track::pointer& track) { return track.id(); });
+
+				return Database::Track::getListEntries(LmsApp->getDbSession(), trackIds);
+			});
 
-		if (!tracks.empty())
+		if (!_tracks->entries.empty())
 		{
 			setCondition("if-tracks", true);
 
 			auto* container {bindNew<Wt::WContainerWidget>("tracks")};
 
-			for (const Database::Track::pointer& track : tracks)
+			for (const Database::Track::ListEntry& track : _tracks->entries)
 				container->addWidget(TrackListHelpers::createEntry(track, tracksAction));
 		}
 	}
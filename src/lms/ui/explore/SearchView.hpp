@@ -19,11 +19,16 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 #include <vector>
 
 #include <Wt/WTemplate.h>
+#include <Wt/WTimer.h>
 
+#include "database/Release.hpp"
+#include "database/Track.hpp"
+#include "database/Types.hpp"
 #include "PlayQueueAction.hpp"
 
 namespace UserInterface {
@@ -37,16 +42,42 @@ class SearchView : public Wt::WTemplate
 
 		PlayQueueActionSignal tracksAction;
 
+		// The search is delayed until the user stops typing
 		void refreshView(const Wt::WString& searchText);
 
 	private:
+		// Results of the last search, kept to refine them when keywords are completed
+		template <typename T>
+		struct SearchResults
+		{
+			std::vector<std::string>	keywords;
+			std::vector<T>				entries;
+			bool						complete {};	// set if there is no other matching entry
+		};
+
+		struct ArtistEntry
+		{
+			Database::ObjectRef	artist;
+			std::string			sortName;
+		};
+
+		template <typename T, typename MatchFunc, typename FetchFunc>
+		static void updateResults(std::optional<SearchResults<T>>& results, const std::vector<std::string>& keywords, MatchFunc matchFunc, FetchFunc fetchFunc);
+
 		void refreshView();
+		void clearResults();
 		void searchArtists();
 		void searchReleases();
 		void searchTracks();
 
 		Filters* _filters {};
-		std::vector<std::string> _keywords;
+		Wt::WTimer* _searchTimer {};
+		std::vector<std::string> _pendingKeywords;
+		std::optional<std::vector<std::string>> _keywords;	// keywords of the displayed results
+
+		std::optional<SearchResults<ArtistEntry>>					_artists;
+		std::optional<SearchResults<Database::Release::ListEntry>>	_releases;
+		std::optional<SearchResults<Database::Track::ListEntry>>	_tracks;
 };
 
 } // namespace UserInterface
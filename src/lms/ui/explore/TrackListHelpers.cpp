@@ -24,11 +24,8 @@
 #include <Wt/WImage.h>
 #include <Wt/WText.h>
 
-#include "database/Artist.hpp"
-#include "database/Release.hpp"
-#include "database/Track.hpp"
 #include "resource/DownloadResource.hpp"
-#include "resource/ImageResource.hpp"
+#include "common/CoverImage.hpp"
 #include "LmsApplication.hpp"
 #include "MediaPlayer.hpp"
 #include "TrackPopup.hpp"
@@ -39,17 +36,17 @@ using namespace Database;
 namespace UserInterface::TrackListHelpers
 {
 	std::unique_ptr<Wt::WTemplate>
-	createEntry(const Wt::Dbo::ptr<Database::Track>& track, PlayQueueActionSignal& tracksAction)
+	createEntry(const Track::ListEntry& track, PlayQueueActionSignal& tracksAction)
 	{
 		auto entry {std::make_unique<Wt::WTemplate>(Wt::WString::tr("Lms.Explore.Tracks.template.entry"))};
 		auto* entryPtr {entry.get()};
 
-		Wt::WText* name {entry->bindNew<Wt::WText>("name", Wt::WString::fromUTF8(track->getName()), Wt::TextFormat::Plain)};
-		name->setToolTip(Wt::WString::fromUTF8(track->getName()));
+		Wt::WText* name {entry->bindNew<Wt::WText>("name", Wt::WString::fromUTF8(track.name), Wt::TextFormat::Plain)};
+		name->setToolTip(Wt::WString::fromUTF8(track.name));
 
-		const auto artists {track->getArtists({TrackArtistLinkType::Artist})};
-		const Release::pointer release {track->getRelease()};
-		const IdType trackId {track.id()};
+		const std::vector<ObjectRef>& artists {track.artists};
+		const std::optional<ObjectRef>& release {track.release};
+		const IdType trackId {track.id};
 
 		if (!artists.empty() || release)
 			entry->setCondition("if-has-artists-or-release", true);
@@ -59,35 +56,28 @@ namespace UserInterface::TrackListHelpers
 			entry->setCondition("if-has-artists", true);
 
 			Wt::WContainerWidget* artistContainer {entry->bindNew<Wt::WContainerWidget>("artists")};
-			for (const Artist::pointer& artist : artists)
+			for (const ObjectRef& artist : artists)
 			{
 				Wt::WTemplate* a {artistContainer->addNew<Wt::WTemplate>(Wt::WString::tr("Lms.Explore.Tracks.template.entry-artist"))};
 				a->bindWidget("artist", LmsApplication::createArtistAnchor(artist));
 			}
 		}
 
-		if (track->getRelease())
+		if (release)
 		{
 			entry->setCondition("if-has-release", true);
-			entry->bindWidget("release", LmsApplication::createReleaseAnchor(track->getRelease()));
+			entry->bindWidget("release", LmsApplication::createReleaseAnchor(*release));
 			{
-				Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(release, false));
-				auto cover = std::make_unique<Wt::WImage>();
-				cover->setImageLink(LmsApp->getImageResource()->getReleaseUrl(release.id(), ImageResource::Size::Large));
-				cover->setStyleClass("Lms-cover");
-				cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
-				anchor->setImage(std::move(cover));
+				Wt::WAnchor* anchor = entry->bindWidget("cover", LmsApplication::createReleaseAnchor(*release, false));
+				anchor->setImage(createReleaseCover(release->id, CoverLayout::List));
 			}
 		}
 		else
 		{
-			auto cover = entry->bindNew<Wt::WImage>("cover");
-			cover->setImageLink(LmsApp->getImageResource()->getTrackUrl(trackId, ImageResource::Size::Large));
-			cover->setStyleClass("Lms-cover");
-			cover->setAttributeValue("onload", LmsApp->javaScriptClass() + ".onLoadCover(this)");
+			entry->bindWidget("cover", createTrackCover(trackId, CoverLayout::List));
 		}
 
-		entry->bindString("duration", trackDurationToString(track->getDuration()), Wt::TextFormat::Plain);
+		entry->bindString("duration", trackDurationToString(track.duration), Wt::TextFormat::Plain);
 
 		Wt::WText* playBtn = entry->bindNew<Wt::WText>("play-btn", Wt::WString::tr("Lms.Explore.template.play-btn"), Wt::TextFormat::XHTML);
 		playBtn->clicked().connect([trackId, &tracksAction]
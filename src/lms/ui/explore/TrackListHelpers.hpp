@@ -22,15 +22,12 @@
 #include <memory>
 
 #include <Wt/WTemplate.h>
-#include "PlayQueueAction.hpp"
 
-namespace Database
-{
-	class Track;
-}
+#include "database/Track.hpp"
+#include "PlayQueueAction.hpp"
 
 namespace UserInterface::TrackListHelpers
 {
-	std::unique_ptr<Wt::WTemplate> createEntry(const Wt::Dbo::ptr<Database::Track>& track, PlayQueueActionSignal& tracksAction);
+	std::unique_ptr<Wt::WTemplate> createEntry(const Database::Track::ListEntry& track, PlayQueueActionSignal& tracksAction);
 } // namespace UserInterface
 
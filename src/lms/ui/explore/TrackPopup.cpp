@@ -22,6 +22,7 @@
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/User.hpp"
+#include "database/UserStateJournal.hpp"
 #include "resource/DownloadResource.hpp"
 #include "LmsApplication.hpp"
 
@@ -41,6 +42,11 @@ namespace UserInterface
 					tracksAction.emit(PlayQueueAction::PlayLast, {trackId});
 				});
 
+			// Stars may have been queued using the Subsonic API
+			Database::UserStateJournal& journal {LmsApp->getDb().getUserStateJournal()};
+			if (journal.hasPendingUpdates(LmsApp->getUser().id()))
+				journal.flush();
+
 			bool isStarred {};
 			{
 				auto transaction {LmsApp->getDbSession().createSharedTransaction()};
@@ -51,16 +57,10 @@ namespace UserInterface
 			popup->addItem(Wt::WString::tr(isStarred ? "Lms.Explore.unstar" : "Lms.Explore.star"))
 				->triggered().connect(&target, [=]
 					{
-						auto transaction {LmsApp->getDbSession().createUniqueTransaction()};
-
-						auto track {Database::Track::getById(LmsApp->getDbSession(), trackId)};
-						if (!track)
-							return;
-
-						if (isStarred)
-							LmsApp->getUser().modify()->unstarTrack(track);
-						else
-							LmsApp->getUser().modify()->starTrack(track);
+						// Queued after the pending Subsonic stars, so that the last change wins
+						Database::UserStateJournal& journal {LmsApp->getDb().getUserStateJournal()};
+						journal.setTrackStarred(LmsApp->getUser().id(), trackId, !isStarred);
+						journal.flush();
 					});
 			popup->addItem(Wt::WString::tr("Lms.Explore.download"))
 				->setLink(Wt::WLink {std::make_unique<DownloadTrackResource>(trackId)});
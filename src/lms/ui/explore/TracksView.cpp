@@ -19,6 +19,8 @@
 
 #include "TracksView.hpp"
 
+#include <algorithm>
+
 #include <Wt/WAnchor.h>
 #include <Wt/WMenu.h>
 #include <Wt/WLineEdit.h>
@@ -31,11 +33,13 @@
 #include "database/TrackList.hpp"
 
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 #include "utils/String.hpp"
 
 #include "common/LoadingIndicator.hpp"
 #include "resource/ImageResource.hpp"
 #include "Filters.hpp"
+#include "LibraryCache.hpp"
 #include "LmsApplication.hpp"
 #include "MediaPlayer.hpp"
 #include "TrackListHelpers.hpp"
@@ -45,6 +49,16 @@ using namespace Database;
 
 namespace UserInterface {
 
+namespace {
+
+struct TracksPage
+{
+	std::vector<Track::ListEntry>	entries;
+	bool							moreResults {};
+};
+
+} // namespace
+
 Tracks::Tracks(Filters* filters)
 : Wt::WTemplate {Wt::WString::tr("Lms.Explore.Tracks.template")},
 _filters {filters}
@@ -112,6 +126,7 @@ Tracks::refreshView()
 {
 	_tracksContainer->clear();
 	_randomTracks.clear();
+	_cursor.reset();
 	addSome();
 }
 
@@ -154,12 +169,7 @@ Tracks::getRandomTracks(std::optional<Range> range, bool& moreResults)
 		auto itBegin {std::cbegin(_randomTracks) + std::min(range ? range->offset : 0, _randomTracks.size())};
 		auto itEnd {std::cbegin(_randomTracks) + std::min(range ? range->offset + range->limit : _randomTracks.size(), _randomTracks.size())};
 
-		for (auto it {itBegin}; it != itEnd; ++it)
-		{
-			const Track::pointer track {Track::getById(LmsApp->getDbSession(), *it)};
-			if (track)
-				tracks.push_back(track);
-		}
+		tracks = Track::getByIds(LmsApp->getDbSession(), std::vector<Database::IdType>(itBegin, itEnd));
 
 		moreResults = (itEnd != std::cend(_randomTracks));
 	}
@@ -181,6 +191,10 @@ Tracks::getTracks(std::optional<Range> range, bool& moreResults)
 			range = Range {0, *modeLimit};
 	}
 
+	// Use keyset pagination when displaying the next entries of the modes ordered by id
+	const bool useCursor {range && _mode == Mode::All && (range->offset == 0 || (_cursor && range->offset == _cursorOffset))};
+	const std::optional<Cursor> cursor {useCursor && range->offset > 0 ? _cursor : std::nullopt};
+
 	switch (_mode)
 	{
 		case Mode::Random:
@@ -204,10 +218,19 @@ Tracks::getTracks(std::optional<Range> range, bool& moreResults)
 			break;
 
 		case Mode::All:
-			tracks = Track::getByFilter(LmsApp->getDbSession(), _filters->getClusterIds(), {}, range, moreResults);
+			if (useCursor)
+				tracks = Track::getByFilter(LmsApp->getDbSession(), _filters->getClusterIds(), {}, cursor, range->limit, moreResults);
+			else
+				tracks = Track::getByFilter(LmsApp->getDbSession(), _filters->getClusterIds(), {}, range, moreResults);
 			break;
 	}
 
+	if (useCursor && !tracks.empty())
+	{
+		_cursor = Cursor {{}, tracks.back().id()};
+		_cursorOffset = range->offset + tracks.size();
+	}
+
 	if (range && modeLimit && (range->offset + range->limit == *modeLimit))
 		moreResults = false;
 
@@ -234,13 +257,40 @@ Tracks::addSome()
 {
 	auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
-	bool moreResults;
-	for (const Track::pointer& track : getTracks(Range {static_cast<std::size_t>(_tracksContainer->count()), batchSize}, moreResults))
+	const Range range {static_cast<std::size_t>(_tracksContainer->count()), batchSize};
+
+	auto fetchPage {[&]
+	{
+		TracksPage page;
+		const auto tracks {getTracks(range, page.moreResults)};
+
+		std::vector<IdType> trackIds;
+		trackIds.reserve(tracks.size());
+		std::transform(std::cbegin(tracks), std::cend(tracks), std::back_inserter(trackIds), [](const Track::pointer& track) { return track.id(); });
+
+		page.entries = Track::getListEntries(LmsApp->getDbSession(), trackIds);
+		return page;
+	}};
+
+	// The other modes depend on the user or are shuffled per session
+	const bool isLibraryWide {_mode == Mode::RecentlyAdded || _mode == Mode::All};
+	const std::shared_ptr<const TracksPage> page {isLibraryWide
+		? Service<LibraryCache>::get()->get<TracksPage>("tracks/" + std::to_string(static_cast<int>(_mode)) + "/" + _filters->getCacheKey() + "/" + std::to_string(range.offset), fetchPage)
+		: std::make_shared<const TracksPage>(fetchPage())};
+
+	// Pages from the cache did not go through getTracks
+	if (_mode == Mode::All && !page->entries.empty())
+	{
+		_cursor = Cursor {{}, page->entries.back().id};
+		_cursorOffset = range.offset + page->entries.size();
+	}
+
+	for (const Track::ListEntry& track : page->entries)
 	{
 		_tracksContainer->addWidget(TrackListHelpers::createEntry(track, tracksAction));
 	}
 
-	if (moreResults)
+	if (page->moreResults)
 		displayLoadingIndicator();
 	else
 		hideLoadingIndicator();
@@ -79,6 +79,8 @@ class Tracks : public Wt::WTemplate
 		Mode _mode {defaultMode};
 		Filters* _filters {};
 		std::vector<Database::IdType> _randomTracks;
+		std::optional<Database::Cursor> _cursor;	// last displayed entry, if displayed using keyset pagination
+		std::size_t _cursorOffset {};
 		Wt::WContainerWidget* _tracksContainer {};
 		Wt::WTemplate* _loadingIndicator {};
 };
@@ -107,6 +107,17 @@ AudioFileResource::handleRequest(const Wt::Http::Request& request,
 	{
 		auto* continuation {response.createContinuation()};
 		continuation->setData(fileResourceHandler);
+
+		if (fileResourceHandler->isWaitingForData())
+		{
+			// Do not hold this server thread while the file is being read
+			continuation->waitForMoreData();
+			fileResourceHandler->notifyWhenDataAvailable([weakContinuation = std::weak_ptr {continuation->shared_from_this()}]
+			{
+				if (auto lockedContinuation {weakContinuation.lock()})
+					lockedContinuation->haveMoreData();
+			});
+		}
 	}
 }
 
@@ -22,9 +22,11 @@
 #include <Wt/Http/Response.h>
 
 #include "av/AvTranscoder.hpp"
+#include "av/AvTranscodeResourceHandlerCreator.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/User.hpp"
+#include "utils/IResourceHandler.hpp"
 #include "utils/Logger.hpp"
 #include "utils/String.hpp"
 
@@ -36,7 +38,7 @@ namespace StringUtils
 {
 	template <>
 	std::optional<Database::AudioFormat>
-	readAs(const std::string& str)
+	readAs(std::string_view str)
 	{
 
 		auto encodedFormat {readAs<int>(str)};
@@ -119,18 +121,18 @@ void
 AudioTranscodeResource::handleRequest(const Wt::Http::Request& request,
 		Wt::Http::Response& response)
 {
-	std::shared_ptr<Av::Transcoder> transcoder;
+	std::shared_ptr<IResourceHandler> resourceHandler;
 
 	// First, see if this request is for a continuation
 	Wt::Http::ResponseContinuation *continuation = request.continuation();
 	if (continuation)
 	{
 		LOG(DEBUG) << "Continuation! " << continuation ;
-		transcoder = Wt::cpp17::any_cast<std::shared_ptr<Av::Transcoder>>(continuation->data());
+		resourceHandler = Wt::cpp17::any_cast<std::shared_ptr<IResourceHandler>>(continuation->data());
 	}
 	else
 	{
-		LOG(DEBUG) << "First request: creating transcoder";
+		LOG(DEBUG) << "First request: creating transcode resource handler";
 
 		// mandatory parameters
 		auto trackId {readParameterAs<Database::IdType>(request, "trackid")};
@@ -148,6 +150,7 @@ AudioTranscodeResource::handleRequest(const Wt::Http::Request& request,
 		auto offset {readParameterAs<std::size_t>(request, "offset")};
 
 		std::filesystem::path trackPath;
+		std::chrono::milliseconds trackDuration;
 		{
 			auto transaction {LmsApp->getDbSession().createSharedTransaction()};
 
@@ -159,6 +162,7 @@ AudioTranscodeResource::handleRequest(const Wt::Http::Request& request,
 			}
 
 			trackPath = track->getPath();
+			trackDuration = track->getDuration();
 
 			if (Database::User::audioTranscodeAllowedBitrates.find(*bitrate) == std::cend(Database::User::audioTranscodeAllowedBitrates))
 			{
@@ -173,41 +177,36 @@ AudioTranscodeResource::handleRequest(const Wt::Http::Request& request,
 		parameters.bitrate = *bitrate;
 		parameters.offset = std::chrono::seconds {offset ? *offset : 0};
 
-		transcoder = std::make_shared<Av::Transcoder>(trackPath, parameters);
-		if (!transcoder->start())
-		{
-			LOG(ERROR) << "Cannot start transcoder";
-			return;
-		}
-
-		LOG(DEBUG) << "Transcoder started";
-
-		std::string mimeType {transcoder->getOutputMimeType()};
-		response.setMimeType(mimeType);
-		LOG(DEBUG) << "Mime type set to '" << mimeType << "'";
+		Av::TranscodeClient client;
+		client.user = LmsApp->getUserLoginName();
+		client.priority = Av::TranscodePriority::Interactive;
 
+		// Served from the transcode cache if possible
+		resourceHandler = Av::createTranscodeResourceHandler(trackPath, parameters, client, trackDuration);
 	}
 
-	if (!transcoder->isComplete())
+	resourceHandler->processRequest(request, response);
+	if (!response.out())
 	{
-		std::vector<unsigned char> data;
-		data.reserve(_chunkSize);
-
-		transcoder->process(data, _chunkSize);
-
-		response.out().write(reinterpret_cast<char*>(&data[0]), data.size());
-		LOG(DEBUG) << "Written " << data.size() << " bytes! complete = " << (transcoder->isComplete() ? "true" : "false");
-
-		if (!response.out())
-		{
-			LOG(ERROR) << "Write failed!";
-		}
+		LOG(ERROR) << "Write failed!";
+		return;
 	}
 
-	if (!transcoder->isComplete() && response.out())
+	if (!resourceHandler->isFinished())
 	{
 		continuation = response.createContinuation();
-		continuation->setData(transcoder);
+		continuation->setData(resourceHandler);
+
+		if (resourceHandler->isWaitingForData())
+		{
+			// Do not hold this server thread while the data is being produced
+			continuation->waitForMoreData();
+			resourceHandler->notifyWhenDataAvailable([weakContinuation = std::weak_ptr {continuation->shared_from_this()}]
+			{
+				if (auto lockedContinuation {weakContinuation.lock()})
+					lockedContinuation->haveMoreData();
+			});
+		}
 	}
 	else
 		LOG(DEBUG) << "No more data!";
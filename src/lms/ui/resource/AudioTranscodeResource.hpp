@@ -41,10 +41,6 @@ class AudioTranscodeResource : public Wt::WResource
 
 		void handleRequest(const Wt::Http::Request& request,
 				Wt::Http::Response& response);
-
-	private:
-
-		static constexpr std::size_t	_chunkSize {262144};
 };
 
 } // namespace UserInterface
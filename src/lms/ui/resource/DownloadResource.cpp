@@ -19,19 +19,22 @@
 
 #include "DownloadResource.hpp"
 
-#include <array>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <unordered_map>
 
 #include <Wt/Http/Response.h>
-#include <Wt/WLocalDateTime.h>
 
 #include "database/Artist.hpp"
 #include "database/Release.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "utils/Exception.hpp"
+#include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Service.hpp"
 #include "utils/Zipper.hpp"
 
 #include "LmsApplication.hpp"
@@ -40,42 +43,134 @@
 
 namespace UserInterface {
 
+namespace {
+
+struct DownloadContext
+{
+	std::unique_ptr<Zip::Zipper>	zipper;
+	Zip::SizeType					remainingBytes {};
+	std::vector<std::byte>			buffer;
+};
+
+std::size_t
+getChunkSize()
+{
+	static const std::size_t chunkSize {std::max<std::size_t>(Service<IConfig>::get()->getULong("download-chunk-size", 256) * 1024, Zip::Zipper::minOutputBufferSize)};
+	return chunkSize;
+}
+
+std::string
+computeETag(const Zip::Zipper& zipper)
+{
+	std::ostringstream oss;
+	oss << "\"" << std::hex << zipper.getTotalZipFile() << "-" << std::setw(8) << std::setfill('0') << zipper.getLayoutChecksum() << "\"";
+
+	return oss.str();
+}
+
+} // namespace
+
 DownloadResource::~DownloadResource()
 {
 	beingDeleted();
 }
 
+// Next downloads of these files will not have to compute them again
+static
+void
+saveComputedCrc32s(const Zip::Zipper& zipper)
+{
+	const std::vector<Zip::Zipper::ComputedCrc32> computedCrc32s {zipper.getComputedCrc32s()};
+	if (computedCrc32s.empty())
+		return;
+
+	Database::Session& session {LmsApp->getDbSession()};
+	auto transaction {session.createUniqueTransaction()};
+
+	for (const Zip::Zipper::ComputedCrc32& computedCrc32 : computedCrc32s)
+	{
+		const Database::Track::pointer track {Database::Track::getByPath(session, computedCrc32.path)};
+		if (track && track->getLastWriteTime() == computedCrc32.fileLastWrite)
+			track.modify()->setCrc32(computedCrc32.crc32, computedCrc32.fileLastWrite);
+	}
+}
+
 void
 DownloadResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 {
 	try
 	{
-		std::shared_ptr<Zip::Zipper> zipper;
+		std::shared_ptr<DownloadContext> context;
 
 		// First, see if this request is for a continuation
 		Wt::Http::ResponseContinuation *continuation = request.continuation();
 		if (continuation)
-			zipper = Wt::cpp17::any_cast<std::shared_ptr<Zip::Zipper>>(continuation->data());
+			context = Wt::cpp17::any_cast<std::shared_ptr<DownloadContext>>(continuation->data());
 		else
 		{
-			zipper = createZipper();
-			response.setContentLength(zipper->getTotalZipFile());
+			std::unique_ptr<Zip::Zipper> zipper {createZipper()};
+			if (!zipper)
+				return;
+
+			const Zip::SizeType totalZipSize {zipper->getTotalZipFile()};
+			const std::string etag {computeETag(*zipper)};
+
 			response.setMimeType("application/zip");
+			response.addHeader("Accept-Ranges", "bytes");
+			response.addHeader("ETag", etag);
+
+			// Only resume if the archive is still the same
+			const std::string ifRange {request.headerValue("If-Range")};
+			const bool useRanges {ifRange.empty() || ifRange == etag};
+			const Wt::Http::Request::ByteRangeSpecifier ranges {useRanges ? request.getRanges(totalZipSize) : Wt::Http::Request::ByteRangeSpecifier {}};
+			if (!ranges.isSatisfiable())
+			{
+				std::ostringstream contentRange;
+				contentRange << "bytes */" << totalZipSize;
+				response.setStatus(416); // Requested range not satisfiable
+				response.addHeader("Content-Range", contentRange.str());
+				return;
+			}
+
+			context = std::make_shared<DownloadContext>();
+			if (ranges.size() == 1)
+			{
+				LOG(DEBUG) << "Range requested = " << ranges[0].firstByte() << "/" << ranges[0].lastByte();
+
+				zipper->seek(ranges[0].firstByte());
+				context->remainingBytes = ranges[0].lastByte() + 1 - ranges[0].firstByte();
+
+				std::ostringstream contentRange;
+				contentRange << "bytes " << ranges[0].firstByte() << "-" << ranges[0].lastByte() << "/" << totalZipSize;
+				response.setStatus(206);
+				response.addHeader("Content-Range", contentRange.str());
+			}
+			else
+				context->remainingBytes = totalZipSize;
+
+			response.setContentLength(context->remainingBytes);
+			context->zipper = std::move(zipper);
+			context->buffer.resize(getChunkSize());
 		}
 
-		if (!zipper)
+		if (!context)
 			return;
 
-		std::array<std::byte, bufferSize> buffer;
-		std::size_t nbWrittenBytes {zipper->writeSome(buffer.data(), buffer.size())};
+		Zip::Zipper& zipper {*context->zipper};
+
+		// Written bytes beyond the requested range, if any, are just not sent
+		const Zip::SizeType nbWrittenBytes {std::min(zipper.writeSome(context->buffer.data(), context->buffer.size()), context->remainingBytes)};
+		context->remainingBytes -= nbWrittenBytes;
 
-		response.out().write(reinterpret_cast<const char *>(buffer.data()), nbWrittenBytes);
+		response.out().write(reinterpret_cast<const char *>(context->buffer.data()), nbWrittenBytes);
 
-		if (!zipper->isComplete())
+		if (context->remainingBytes > 0 && !zipper.isComplete())
 		{
 			auto* continuation {response.createContinuation()};
-			continuation->setData(zipper);
+			continuation->setData(context);
 		}
+		else if (zipper.isComplete())
+			saveComputedCrc32s(zipper);
 	}
 	catch (Zip::ZipperException& exception)
 	{
@@ -146,29 +241,45 @@ static
 std::unique_ptr<Zip::Zipper>
 createZipper(const std::vector<Database::Track::pointer>& tracks)
 {
-	std::map<std::string, std::filesystem::path> files;
+	std::map<std::string, Zip::FileEntry> files;
+
+	// Computed once per release, as getting the release artists takes a query
+	std::unordered_map<Database::IdType, std::string> releaseDirectoryNames;
 
 	for (const Database::Track::pointer& track : tracks)
 	{
-		std::string releaseName;
-		std::string releaseArtistName;
+		std::string fileName;
 		if (auto release {track->getRelease()})
 		{
-			releaseName = getReleasePathName(release);
-			releaseArtistName = getReleaseArtistPathName(release);
+			auto [itDirectoryName, inserted] {releaseDirectoryNames.try_emplace(release.id())};
+			if (inserted)
+			{
+				const std::string releaseArtistName {getReleaseArtistPathName(release)};
+				const std::string releaseName {getReleasePathName(release)};
+
+				if (!releaseArtistName.empty())
+					itDirectoryName->second += releaseArtistName + "/";
+				if (!releaseName.empty())
+					itDirectoryName->second += releaseName + "/";
+			}
+
+			fileName = itDirectoryName->second;
 		}
-
-		std::string fileName;
-		if (!releaseArtistName.empty())
-			fileName += releaseArtistName + "/";
-		if (!releaseName.empty())
-			fileName += releaseName + "/";
 		fileName += getTrackPathName(track);
 
-		files.emplace(fileName, track->getPath());
+		Zip::FileEntry fileEntry {track->getPath(), track->getCrc32(), track->getLastWriteTime()};
+		// Saves a stat per file on archive creation, the files are checked when opened
+		if (track->getFileSize() > 0)
+		{
+			fileEntry.fileSize = track->getFileSize();
+			fileEntry.fileLastWrite = track->getLastWriteTime();
+		}
+
+		files.emplace(fileName, std::move(fileEntry));
 	}
 
-	return std::make_unique<Zip::Zipper>(files, Wt::WLocalDateTime::currentDateTime().toUTC());
+	// Use the file dates so that the archive does not change between requests, for resumed downloads
+	return std::make_unique<Zip::Zipper>(files);
 }
 
 DownloadArtistResource::DownloadArtistResource(Database::IdType artistId)
@@ -30,8 +30,6 @@ namespace UserInterface {
 class DownloadResource : public Wt::WResource
 {
 	public:
-		static constexpr std::size_t bufferSize {32768};
-
 		~DownloadResource();
 
 	private:
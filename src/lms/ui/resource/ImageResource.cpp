@@ -19,12 +19,17 @@
 
 #include "ImageResource.hpp"
 
+#include <functional>
+
 #include <Wt/WApplication.h>
 #include <Wt/Http/Response.h>
 
 #include "cover/ICoverArtGrabber.hpp"
+#include "database/Db.hpp"
 #include "database/Track.hpp"
 #include "utils/Exception.hpp"
+#include "utils/Executor.hpp"
+#include "utils/HttpCache.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Service.hpp"
 #include "utils/String.hpp"
@@ -35,6 +40,24 @@
 
 namespace UserInterface {
 
+namespace {
+
+	using CoverGetter = std::function<std::shared_ptr<CoverArt::IEncodedImage>(Database::Session&)>;
+
+	// Continuation data, set by the CPU executor
+	struct PendingCover
+	{
+		std::shared_ptr<CoverArt::IEncodedImage> cover;
+	};
+
+	void
+	writeCover(Wt::Http::Response& response, const CoverArt::IEncodedImage& cover)
+	{
+		response.out().write(reinterpret_cast<const char *>(cover.getData()), cover.getDataSize());
+	}
+
+} // namespace
+
 ImageResource::~ImageResource()
 {
 	beingDeleted();
@@ -55,6 +78,15 @@ ImageResource::getTrackUrl(Database::IdType trackId, Size size) const
 void
 ImageResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
 {
+	if (Wt::Http::ResponseContinuation* continuation {request.continuation()})
+	{
+		// Resumed once the cover has been computed, headers are already sent
+		const auto pendingCover {Wt::cpp17::any_cast<std::shared_ptr<PendingCover>>(continuation->data())};
+		if (pendingCover->cover)
+			writeCover(response, *pendingCover->cover);
+		return;
+	}
+
 	// Retrieve parameters
 	const std::string *trackIdStr = request.getParameter("trackid");
 	const std::string *releaseIdStr = request.getParameter("releaseid");
@@ -74,7 +106,10 @@ ImageResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 		return;
 	}
 
-	std::shared_ptr<CoverArt::IEncodedImage> cover;
+	// Browsers advertise the image formats they support
+	const CoverArt::ImageFormat format {request.headerValue("Accept").find("image/webp") != std::string::npos ? CoverArt::ImageFormat::WebP : CoverArt::ImageFormat::JPEG};
+
+	CoverGetter getCover;
 
 	if (trackIdStr)
 	{
@@ -87,7 +122,10 @@ ImageResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 			return;
 		}
 
-		cover = Service<CoverArt::IGrabber>::get()->getFromTrack(LmsApp->getDbSession(), *trackId, *size);
+		getCover = [trackId = *trackId, size = *size, format](Database::Session& session)
+		{
+			return Service<CoverArt::IGrabber>::get()->getFromTrack(session, trackId, size, format);
+		};
 	}
 	else if (releaseIdStr)
 	{
@@ -97,7 +135,10 @@ ImageResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 		if (!releaseId)
 			return;
 
-		cover = Service<CoverArt::IGrabber>::get()->getFromRelease(LmsApp->getDbSession(), *releaseId, *size);
+		getCover = [releaseId = *releaseId, size = *size, format](Database::Session& session)
+		{
+			return Service<CoverArt::IGrabber>::get()->getFromRelease(session, releaseId, size, format);
+		};
 	}
 	else
 	{
@@ -105,9 +146,50 @@ ImageResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Respons
 		return;
 	}
 
-	response.setMimeType(std::string {cover->getMimeType()});
+	const CoverArt::IGrabber& grabber {*Service<CoverArt::IGrabber>::get()};
+	const bool isWebP {format == CoverArt::ImageFormat::WebP && grabber.isFormatSupported(CoverArt::ImageFormat::WebP)};
+
+	if (grabber.isFormatSupported(CoverArt::ImageFormat::WebP))
+		response.addHeader("Vary", "Accept");
+
+	// The resource URL changes after each scan (see LmsApplication): for a given URL and format, the cover does not change
+	// Tagging the URL rather than the contents lets the headers be sent before the cover is computed, and revalidations skip it
+	const std::string etagSource {request.queryString() + (isWebP ? "|webp" : "|jpeg")};
+	if (HttpCache::handleConditionalRequest(request, response, HttpCache::computeETag(reinterpret_cast<const std::byte*>(etagSource.data()), etagSource.size()), "private, max-age=31536000"))
+		return;
+
+	// Covers are always encoded using the requested format, if supported
+	response.setMimeType(isWebP ? "image/webp" : "image/jpeg");
+
+	CpuExecutor* executor {Service<CpuExecutor>::get()};
+	if (!executor)
+	{
+		writeCover(response, *getCover(LmsApp->getDbSession()));
+		return;
+	}
+
+	// Decoding and resizing a cover may take a while: do not hold this server thread meanwhile
+	auto pendingCover {std::make_shared<PendingCover>()};
+
+	Wt::Http::ResponseContinuation* continuation {response.createContinuation()};
+	continuation->setData(pendingCover);
+	continuation->waitForMoreData();
+
+	executor->post([&db = LmsApp->getDb(), getCover = std::move(getCover), pendingCover, weakContinuation = std::weak_ptr {continuation->shared_from_this()}]
+	{
+		try
+		{
+			pendingCover->cover = getCover(db.getTLSSession());
+		}
+		catch (std::exception& e)
+		{
+			LOG(ERROR) << "Cannot get cover: " << e.what();
+		}
 
-	response.out().write(reinterpret_cast<const char *>(cover->getData()), cover->getDataSize());
+		// Always resume, so that the request is answered
+		if (auto lockedContinuation {weakContinuation.lock()})
+			lockedContinuation->haveMoreData();
+	});
 }
 
 } // namespace UserInterface
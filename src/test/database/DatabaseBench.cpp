@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Measures the hot database queries on synthetic libraries of several sizes
+// Results are written to stdout, one CSV line per measurement
+// The libraries only depend on their track count, so that results can be compared across commits
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "database/Artist.hpp"
+#include "database/Cluster.hpp"
+#include "database/Db.hpp"
+#include "database/Release.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+#include "database/TrackArtistLink.hpp"
+#include "database/TrackList.hpp"
+#include "database/User.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+
+using namespace Database;
+
+namespace {
+
+const std::vector<std::string> words
+{
+	"black", "blue", "city", "cold", "dance", "dark", "dawn", "dream", "echo", "fire",
+	"ghost", "glass", "gold", "heart", "light", "lost", "moon", "night", "ocean", "rain",
+	"river", "road", "shadow", "silver", "sky", "star", "stone", "storm", "summer", "wind",
+};
+
+constexpr std::size_t genreCount {30};
+constexpr std::size_t moodCount {8};
+constexpr std::size_t resultCount {50};	// typical page size
+
+struct Library
+{
+	std::size_t				trackCount;
+	std::vector<IdType>		trackIds;
+	std::vector<IdType>		genreIds;
+	std::vector<IdType>		moodIds;
+	IdType					genreClusterTypeId;
+	IdType					userId;
+	IdType					trackListId;
+};
+
+std::string
+pickName(std::mt19937& generator, std::size_t wordCount)
+{
+	std::uniform_int_distribution<std::size_t> wordDistribution {0, words.size() - 1};
+
+	std::string res;
+	for (std::size_t i {}; i < wordCount; ++i)
+	{
+		if (!res.empty())
+			res += ' ';
+		res += words[wordDistribution(generator)];
+	}
+
+	return res;
+}
+
+// About 10 tracks per release, 4 releases per artist, one genre and one mood per track
+// 5% of the tracks and releases are starred, and the user has listened to half as many tracks as the library has
+Library
+populateLibrary(Session& session, std::size_t trackCount)
+{
+	std::mt19937 generator {static_cast<std::mt19937::result_type>(trackCount)};
+
+	Library library {trackCount, {}, {}, {}, {}, {}, {}};
+
+	const std::size_t releaseCount {std::max<std::size_t>(1, trackCount / 10)};
+	const std::size_t artistCount {std::max<std::size_t>(1, releaseCount / 4)};
+
+	std::vector<Release::pointer> releases;
+	std::vector<Artist::pointer> artists;
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		auto getOrCreateClusterType {[&](const std::string& name)
+		{
+			ClusterType::pointer clusterType {ClusterType::getByName(session, name)};
+			return clusterType ? clusterType : ClusterType::create(session, name);
+		}};
+
+		const ClusterType::pointer genreType {getOrCreateClusterType("GENRE")};
+		const ClusterType::pointer moodType {getOrCreateClusterType("MOOD")};
+		library.genreClusterTypeId = genreType.id();
+		for (std::size_t i {}; i < genreCount; ++i)
+			library.genreIds.push_back(Cluster::create(session, genreType, "genre" + std::to_string(i)).id());
+		for (std::size_t i {}; i < moodCount; ++i)
+			library.moodIds.push_back(Cluster::create(session, moodType, "mood" + std::to_string(i)).id());
+
+		for (std::size_t i {}; i < artistCount; ++i)
+			artists.push_back(Artist::create(session, pickName(generator, 2)));
+		for (std::size_t i {}; i < releaseCount; ++i)
+			releases.push_back(Release::create(session, pickName(generator, 3)));
+
+		const User::pointer user {User::create(session, "bench")};
+		library.userId = user.id();
+		library.trackListId = TrackList::create(session, "bench", TrackList::Type::Internal, false, user).id();
+	}
+
+	std::uniform_int_distribution<std::size_t> genreDistribution {0, genreCount - 1};
+	std::uniform_int_distribution<std::size_t> moodDistribution {0, moodCount - 1};
+	std::uniform_int_distribution<int> dayDistribution {0, 3650};
+	std::bernoulli_distribution starDistribution {0.05};
+
+	constexpr std::size_t batchSize {1000};
+	const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+	while (library.trackIds.size() < trackCount)
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		const User::pointer user {User::getById(session, library.userId)};
+		for (std::size_t i {}; i < batchSize && library.trackIds.size() < trackCount; ++i)
+		{
+			const std::size_t trackIndex {library.trackIds.size()};
+			const std::size_t releaseIndex {trackIndex * releaseCount / trackCount};
+			const Release::pointer& release {releases[releaseIndex]};
+			const Artist::pointer& artist {artists[releaseIndex % artistCount]};
+
+			Track::pointer track {Track::create(session, "/bench/" + std::to_string(trackIndex) + ".mp3")};
+			track.modify()->setName(pickName(generator, 3));
+			track.modify()->setTrackNumber(static_cast<int>(trackIndex % 10 + 1));
+			track.modify()->setDuration(std::chrono::seconds {200});
+			track.modify()->setYear(1960 + static_cast<int>(releaseIndex % 60));
+			track.modify()->setFileSize(5'000'000);
+			track.modify()->setRelease(release);
+			track.modify()->setClusters({Cluster::getById(session, library.genreIds[genreDistribution(generator)]), Cluster::getById(session, library.moodIds[moodDistribution(generator)])});
+			track.modify()->setLastWriteTime(now.addDays(-dayDistribution(generator)));
+			track.modify()->addArtistLink(TrackArtistLink::create(session, track, artist, TrackArtistLinkType::Artist));
+			track.modify()->addArtistLink(TrackArtistLink::create(session, track, artist, TrackArtistLinkType::ReleaseArtist));
+
+			if (starDistribution(generator))
+				user.modify()->starTrack(track);
+			if (trackIndex % 10 == 0 && starDistribution(generator))
+				user.modify()->starRelease(release);
+
+			library.trackIds.push_back(track.id());
+		}
+	}
+
+	// Listens, biased towards the first tracks
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		const TrackList::pointer trackList {TrackList::getById(session, library.trackListId)};
+		std::geometric_distribution<std::size_t> listenDistribution {10.0 / trackCount};
+		for (std::size_t i {}; i < trackCount / 2; ++i)
+		{
+			const std::size_t trackIndex {std::min(listenDistribution(generator), trackCount - 1)};
+			TrackListEntry::create(session, Track::getById(session, library.trackIds[trackIndex]), trackList);
+		}
+	}
+
+	return library;
+}
+
+// Runs func until minDuration is reached, returns the mean duration of one call
+std::chrono::nanoseconds
+measure(std::chrono::milliseconds minDuration, std::size_t& callCount, const std::function<void(std::size_t /* callIndex */)>& func)
+{
+	callCount = 0;
+
+	const auto start {std::chrono::steady_clock::now()};
+	std::chrono::steady_clock::duration elapsed {};
+	do
+	{
+		func(callCount++);
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	while (elapsed < minDuration);
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) / callCount;
+}
+
+void
+printHeader()
+{
+	std::cout << "benchmark,tracks,calls,ns_per_call,calls_per_second,results_per_call" << std::endl;
+}
+
+void
+printResult(const std::string& benchmark, const Library& library, std::size_t callCount, std::chrono::nanoseconds durationPerCall, std::size_t resultCount)
+{
+	const double callsPerSecond {durationPerCall.count() > 0 ? 1e9 / durationPerCall.count() : 0};
+
+	std::cout << benchmark
+		<< "," << library.trackCount
+		<< "," << callCount
+		<< "," << durationPerCall.count()
+		<< "," << callsPerSecond
+		<< "," << static_cast<double>(resultCount) / callCount << std::endl;
+}
+
+// Each call uses its own read transaction, as requests do
+void
+bench(Session& session, const Library& library, std::chrono::milliseconds minDuration, const std::string& benchmark, const std::function<std::size_t(std::size_t /* callIndex */)>& func)
+{
+	std::size_t callCount;
+	std::size_t resultCount {};
+	const auto duration {measure(minDuration, callCount, [&](std::size_t callIndex)
+	{
+		auto transaction {session.createSharedTransaction()};
+		resultCount += func(callIndex);
+	})};
+
+	printResult(benchmark, library, callCount, duration, resultCount);
+}
+
+void
+benchLibrary(Session& session, const Library& library, std::chrono::milliseconds minDuration)
+{
+	const Range range {0, resultCount};
+	bool moreResults;
+
+	auto getKeywords {[](std::size_t callIndex) { return std::vector<std::string> {words[callIndex % words.size()]}; }};
+	auto getGenre {[&](std::size_t callIndex) { return library.genreIds[callIndex % library.genreIds.size()]; }};
+	auto getMood {[&](std::size_t callIndex) { return library.moodIds[callIndex % library.moodIds.size()]; }};
+	auto getTrackId {[&](std::size_t callIndex) { return library.trackIds[(callIndex * 7919) % library.trackIds.size()]; }};
+
+	bench(session, library, minDuration, "track_filter_keywords", [&](std::size_t callIndex)
+	{
+		return Track::getByFilter(session, {}, getKeywords(callIndex), range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "track_filter_clusters", [&](std::size_t callIndex)
+	{
+		return Track::getByFilter(session, {getGenre(callIndex), getMood(callIndex)}, {}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "track_filter_keywords_clusters", [&](std::size_t callIndex)
+	{
+		return Track::getByFilter(session, {getGenre(callIndex)}, getKeywords(callIndex), range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "release_filter_keywords", [&](std::size_t callIndex)
+	{
+		return Release::getByFilter(session, {}, getKeywords(callIndex), range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "release_filter_clusters", [&](std::size_t callIndex)
+	{
+		return Release::getByFilter(session, {getGenre(callIndex)}, {}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "artist_filter_keywords", [&](std::size_t callIndex)
+	{
+		return Artist::getByFilter(session, {}, getKeywords(callIndex), std::nullopt, Artist::SortMethod::BySortName, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "track_similar", [&](std::size_t callIndex)
+	{
+		return Track::getSimilarTracks(session, {getTrackId(callIndex)}, 0, resultCount).size();
+	});
+
+	bench(session, library, minDuration, "track_last_written", [&](std::size_t)
+	{
+		return Track::getLastWritten(session, std::nullopt, {}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "release_last_written", [&](std::size_t)
+	{
+		return Release::getLastWritten(session, std::nullopt, {}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "track_starred", [&](std::size_t)
+	{
+		return Track::getStarred(session, User::getById(session, library.userId), {}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "release_starred", [&](std::size_t)
+	{
+		return Release::getStarred(session, User::getById(session, library.userId), {}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "tracklist_top_releases", [&](std::size_t)
+	{
+		return TrackList::getById(session, library.trackListId)->getTopReleases({}, range, moreResults).size();
+	});
+
+	bench(session, library, minDuration, "tracklist_top_releases_cluster", [&](std::size_t callIndex)
+	{
+		return TrackList::getById(session, library.trackListId)->getTopReleases({getGenre(callIndex)}, range, moreResults).size();
+	});
+
+	// Queries made to report a page of songs in the Subsonic API (see getTrackNodesInfo)
+	bench(session, library, minDuration, "subsonic_song_nodes", [&](std::size_t callIndex)
+	{
+		std::vector<IdType> trackIds;
+		for (std::size_t i {}; i < resultCount; ++i)
+			trackIds.push_back(getTrackId(callIndex * resultCount + i));
+
+		const std::vector<Track::pointer> tracks {Track::getByIds(session, trackIds)};
+
+		std::vector<IdType> releaseIds;
+		for (const Track::pointer& track : tracks)
+		{
+			if (const Release::pointer release {track->getRelease()})
+				releaseIds.push_back(release.id());
+		}
+
+		const auto artists {Track::getArtistsByTrack(session, trackIds, {TrackArtistLinkType::Artist})};
+		const auto releases {Release::getByIds(session, releaseIds)};
+		const auto starredTrackIds {User::getById(session, library.userId)->getStarredTrackIds(trackIds)};
+		const auto genres {Track::getFirstClusterByTrack(session, trackIds, library.genreClusterTypeId)};
+
+		return tracks.size();
+	});
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	// usage: bench-database [min_duration_ms [max_track_count]]
+	const std::chrono::milliseconds minDuration {argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500};
+	const std::size_t maxTrackCount {argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100'000};
+
+	if (maxTrackCount == 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [min_duration_ms [max_track_count]]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		// log to stderr, not to mix with the results
+		Service<Logger> logger {std::make_unique<StreamLogger>(std::cerr)};
+
+		printHeader();
+
+		for (std::size_t trackCount : {1'000, 10'000, 100'000})
+		{
+			if (trackCount > maxTrackCount)
+				break;
+
+			const std::filesystem::path tmpFile {std::tmpnam(nullptr)};
+
+			{
+				Db db {tmpFile};
+				Session session {db};
+				session.prepareTables();
+
+				const Library library {populateLibrary(session, trackCount)};
+				session.optimize();
+
+				benchLibrary(session, library, minDuration);
+			}
+
+			std::filesystem::remove(tmpFile);
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
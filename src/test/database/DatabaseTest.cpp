@@ -19,17 +19,24 @@
 
 #include <cstdlib>
 
+#include <algorithm>
 #include <filesystem>
 #include <list>
+#include <memory>
 
 #include "database/Artist.hpp"
 #include "database/Cluster.hpp"
 #include "database/Db.hpp"
+#include "database/QueryStats.hpp"
 #include "database/Release.hpp"
+#include "database/ScanCheckpoint.hpp"
+#include "database/ScanSettings.hpp"
+#include "database/ScannedDirectory.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
 #include "database/TrackArtistLink.hpp"
 #include "database/TrackBookmark.hpp"
+#include "database/TrackFeatures.hpp"
 #include "database/TrackList.hpp"
 #include "database/User.hpp"
 
@@ -172,7 +179,375 @@ testSingleTrack(Session& session)
 
 		CHECK(Track::getAll(session).size() == 1);
 		CHECK(Track::getCount(session) == 1);
+		CHECK(Track::getById(session, track.getId()));
+		CHECK(!Track::getById(session, track.getId() + 1));
+	}
+}
+
+static
+void
+testSingleTrackFileInfos(Session& session)
+{
+	ScopedTrack track {session, "MyTrackFile"};
+
+	const Wt::WDateTime lastWriteTime {Wt::WDateTime::fromTime_t(1000)};
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track.get().modify()->setLastWriteTime(lastWriteTime);
+		track.get().modify()->setScanVersion(5);
+		track.get().modify()->setFileSize(123456);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto fileInfos {Track::getAllFileInfos(session)};
+		CHECK(fileInfos.size() == 1);
+		CHECK(fileInfos.front().id == track.getId());
+		CHECK(fileInfos.front().path == "MyTrackFile");
+		CHECK(fileInfos.front().lastWriteTime == lastWriteTime);
+		CHECK(fileInfos.front().scanVersion == 5);
+		CHECK(fileInfos.front().fileSize == 123456);
+	}
+}
+
+static
+void
+testSingleTrackCachedTags(Session& session)
+{
+	ScopedTrack track {session, "MyTrackFile"};
+
+	const Wt::WDateTime lastWriteTime {Wt::WDateTime::fromTime_t(1000)};
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(!Track::getCachedTags(session, track.getId(), lastWriteTime, 123456));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		Track::setCachedTags(session, track.getId(), lastWriteTime, 123456, {1, 2, 0, 3});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto tags {Track::getCachedTags(session, track.getId(), lastWriteTime, 123456)};
+		CHECK(tags);
+		CHECK(*tags == std::vector<unsigned char>({1, 2, 0, 3}));
+
+		// File changed since
+		CHECK(!Track::getCachedTags(session, track.getId(), Wt::WDateTime::fromTime_t(1001), 123456));
+		CHECK(!Track::getCachedTags(session, track.getId(), lastWriteTime, 123457));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		Track::setCachedTags(session, track.getId(), Wt::WDateTime::fromTime_t(1001), 123456, {4});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(!Track::getCachedTags(session, track.getId(), lastWriteTime, 123456));
 
+		const auto tags {Track::getCachedTags(session, track.getId(), Wt::WDateTime::fromTime_t(1001), 123456)};
+		CHECK(tags);
+		CHECK(*tags == std::vector<unsigned char>({4}));
+	}
+}
+
+static
+void
+testSingleTrackRemovedUsingSql(Session& session)
+{
+	auto transaction {session.createUniqueTransaction()};
+
+	// Still loaded in the session when removed
+	const Track::pointer track {Track::create(session, "MyTrackFile")};
+	const IdType trackId {track.id()};
+	CHECK(Track::getById(session, trackId));
+
+	session.getDboSession().execute("DELETE FROM track WHERE id = ?").bind(trackId);
+	CHECK(!Track::getById(session, trackId));
+}
+
+static
+void
+testSingleTrackMove(Session& session)
+{
+	ScopedTrack track {session, "/music/a/1.mp3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		CHECK(track->getFingerprint().empty());
+		track.get().modify()->setFingerprint("1234-abcdef01");
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track.get().modify()->setPath("/music/b/1.mp3");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(!Track::getByPath(session, "/music/a/1.mp3"));
+		CHECK(Track::getByPath(session, "/music/b/1.mp3").id() == track.getId());
+		CHECK(track->getFingerprint() == "1234-abcdef01");
+	}
+}
+
+static
+void
+testMultiTracksPathsUnder(Session& session)
+{
+	ScopedTrack track1 {session, "/music/a/1.mp3"};
+	ScopedTrack track2 {session, "/music/a/b/2.mp3"};
+	ScopedTrack track3 {session, "/music/ab/3.mp3"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(Track::getAllPathsUnder(session, "/music").size() == 3);
+		CHECK(Track::getAllPathsUnder(session, "/music/a").size() == 2);
+		CHECK(Track::getAllPathsUnder(session, "/music/a/b").size() == 1);
+		CHECK(Track::getAllPathsUnder(session, "/music/a/1.mp3").size() == 1);
+		CHECK(Track::getAllPathsUnder(session, "/music/a/1.mp3").front().first == track1.getId());
+		CHECK(Track::getAllPathsUnder(session, "/music/c").empty());
+	}
+}
+
+static
+void
+testMultiTracksRandom(Session& session)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const std::vector<IdType> trackIds {Track::getAllIdsRandom(session, {}, 2)};
+		CHECK(trackIds.size() == 2);
+		CHECK(trackIds[0] != trackIds[1]);
+		for (const IdType trackId : trackIds)
+			CHECK(trackId == track1.getId() || trackId == track2.getId() || trackId == track3.getId());
+
+		CHECK(Track::getAllIdsRandom(session, {}).size() == 3);
+		CHECK(Track::getAllIdsRandom(session, {}, 10).size() == 3);
+		CHECK(Track::getAllIdsRandom(session, {}, 0).empty());
+
+		const auto tracks {Track::getAllRandom(session, {}, 2)};
+		CHECK(tracks.size() == 2);
+		CHECK(tracks[0].id() != tracks[1].id());
+
+		const auto releases {Release::getAllRandom(session, {}, 2)};
+		CHECK(releases.size() == 1);
+		CHECK(releases.front().id() == release.getId());
+	}
+}
+
+static
+void
+testMultiTracksGetByIds(Session& session)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedArtist artist {session, "MyArtist"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto tracks {Track::getByIds(session, {track3.getId(), track1.getId(), track3.getId() + 42, track2.getId()})};
+		CHECK(tracks.size() == 3);
+		CHECK(tracks[0].id() == track3.getId());
+		CHECK(tracks[1].id() == track1.getId());
+		CHECK(tracks[2].id() == track2.getId());
+
+		CHECK(Track::getByIds(session, {}).empty());
+
+		const auto releases {Release::getByIds(session, {release.getId()})};
+		CHECK(releases.size() == 1);
+		CHECK(releases.front().id() == release.getId());
+
+		const auto artists {Artist::getByIds(session, {artist.getId() + 42, artist.getId()})};
+		CHECK(artists.size() == 1);
+		CHECK(artists.front().id() == artist.getId());
+	}
+}
+
+static
+void
+testSingleTrackFeatures(Session& session)
+{
+	ScopedTrack track {session, "MyTrack"};
+
+	const std::string data {R"({"lowlevel": {"average_loudness": 0.5, "barkbands": {"mean": [1.5, 2.5, 3.5]}}, "tonal": {"key_strength": 0.25}})"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackFeatures::create(session, track.get(), data, {"lowlevel.average_loudness", "lowlevel.barkbands.mean"});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(TrackFeatures::getIdsWithoutStoredFeatureValues(session).empty());
+
+		const FeatureValuesMap stored {TrackFeatures::getFeatureValuesMapByTrack(session, track.getId(), {"lowlevel.barkbands.mean"})};
+		CHECK(stored.size() == 1);
+		CHECK(stored.at("lowlevel.barkbands.mean") == FeatureValues({1.5, 2.5, 3.5}));
+
+		// Not stored, parsed from the json data
+		const FeatureValuesMap parsed {TrackFeatures::getFeatureValuesMapByTrack(session, track.getId(), {"lowlevel.average_loudness", "tonal.key_strength"})};
+		CHECK(parsed.size() == 2);
+		CHECK(parsed.at("lowlevel.average_loudness") == FeatureValues({0.5}));
+		CHECK(parsed.at("tonal.key_strength") == FeatureValues({0.25}));
+
+		const auto encodedFeatureValues {TrackFeatures::getEncodedFeatureValues(session, 0, 10)};
+		CHECK(encodedFeatureValues.size() == 1);
+		CHECK(encodedFeatureValues.front().trackId == track.getId());
+		CHECK(TrackFeatures::getEncodedFeatureValues(session, track.getId(), 10).empty());
+
+		const std::optional<FeatureValuesMap> decoded {TrackFeatures::decodeFeatureValues(encodedFeatureValues.front().data, {"lowlevel.barkbands.mean"})};
+		CHECK(decoded);
+		CHECK(decoded->at("lowlevel.barkbands.mean") == FeatureValues({1.5, 2.5, 3.5}));
+		CHECK(!TrackFeatures::decodeFeatureValues(encodedFeatureValues.front().data, {"tonal.key_strength"}));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track.get()->getTrackFeatures().remove();
+	}
+}
+
+static
+void
+testMultiScannedDirectories(Session& session)
+{
+	const Wt::WDateTime lastWriteTime {Wt::WDateTime::fromTime_t(1000)};
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScannedDirectory::create(session, "/music", lastWriteTime, 1);
+		ScannedDirectory::create(session, "/music/a", lastWriteTime, 1);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto directories {ScannedDirectory::getAll(session)};
+		CHECK(directories.size() == 2);
+		CHECK(std::all_of(std::cbegin(directories), std::cend(directories), [&](const ScannedDirectory::pointer& directory) { return directory->getLastWriteTime() == lastWriteTime && directory->getScanVersion() == 1; }));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScannedDirectory::removeAll(session);
+		CHECK(ScannedDirectory::getAll(session).empty());
+	}
+}
+
+static
+void
+testQueryShape(Session&)
+{
+	CHECK(QueryStats::getQueryShape("SELECT id FROM track WHERE id IN (?, ?, ?) LIMIT 10 OFFSET 20") == "SELECT id FROM track WHERE id IN (?...) LIMIT ? OFFSET ?");
+	CHECK(QueryStats::getQueryShape("SELECT t1.id FROM track t1 WHERE t1.name = 'it''s' AND t1.year = ?") == "SELECT t1.id FROM track t1 WHERE t1.name = ? AND t1.year = ?");
+	CHECK(QueryStats::getQueryShape("pragma busy_timeout=1000") == "pragma busy_timeout=?");
+}
+
+static
+void
+testScanSettingsMediaDirectories(Session& session)
+{
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanSettings::pointer scanSettings {ScanSettings::get(session)};
+		CHECK(scanSettings);
+		scanSettings.modify()->setMediaDirectories({"/music/", "", "/mnt/music"});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanSettings::pointer scanSettings {ScanSettings::get(session)};
+		CHECK(scanSettings->getMediaDirectories() == std::vector<std::filesystem::path>({"/music", "/mnt/music"}));
+
+		scanSettings.modify()->setMediaDirectories({});
+		CHECK(scanSettings->getMediaDirectories().empty());
+	}
+}
+
+static
+void
+testScanCheckpoint(Session& session)
+{
+	const Wt::WDateTime startTime {Wt::WDateTime::fromTime_t(1000)};
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanCheckpoint::Counters counters;
+		counters.filesScanned = 10;
+		counters.additions = 4;
+		counters.skips = 3;
+
+		ScanCheckpoint::pointer checkpoint {ScanCheckpoint::getOrCreate(session)};
+		checkpoint.modify()->setScanVersion(2);
+		checkpoint.modify()->setForceScan(true);
+		checkpoint.modify()->setMediaDirectories({"/music", "/mnt/music"});
+		checkpoint.modify()->setStep(2);
+		checkpoint.modify()->setDirectories({"/music/a", "/mnt/music/b"});
+		checkpoint.modify()->setStartTime(startTime);
+		checkpoint.modify()->setCounters(counters);
+
+		CHECK(ScanCheckpoint::getOrCreate(session) == checkpoint);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const ScanCheckpoint::pointer checkpoint {ScanCheckpoint::get(session)};
+		CHECK(checkpoint);
+		CHECK(checkpoint->getScanVersion() == 2);
+		CHECK(checkpoint->isForceScan());
+		CHECK(checkpoint->getMediaDirectories() == std::vector<std::filesystem::path>({"/music", "/mnt/music"}));
+		CHECK(checkpoint->getStep() == 2);
+		CHECK(checkpoint->getDirectories() == std::vector<std::filesystem::path>({"/music/a", "/mnt/music/b"}));
+		CHECK(checkpoint->getStartTime() == startTime);
+
+		const ScanCheckpoint::Counters counters {checkpoint->getCounters()};
+		CHECK(counters.filesScanned == 10);
+		CHECK(counters.additions == 4);
+		CHECK(counters.skips == 3);
+		CHECK(counters.deletions == 0);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		ScanCheckpoint::removeAll(session);
+		CHECK(!ScanCheckpoint::get(session));
 	}
 }
 
@@ -195,6 +570,31 @@ testSingleArtist(Session& session)
 	}
 }
 
+static
+void
+testSingleArtistMBID(Session& session)
+{
+	const std::optional<UUID> mbid {UUID::fromString("5B11F4CE-A62D-471E-81FC-A69A8278C7DA")};
+	CHECK(mbid);
+	CHECK(mbid->getAsString() == "5b11f4ce-a62d-471e-81fc-a69a8278c7da");
+
+	ScopedArtist artist {session, "MyArtist", mbid};
+	ScopedArtist otherArtist {session, "MyOtherArtist"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(artist->getMBID() == mbid);
+		CHECK(!otherArtist->getMBID());
+
+		auto foundArtist {Artist::getByMBID(session, *mbid)};
+		CHECK(foundArtist);
+		CHECK(foundArtist.id() == artist.getId());
+
+		CHECK(!Artist::getByMBID(session, *UUID::fromString("5b11f4ce-a62d-471e-81fc-a69a8278c7db")));
+	}
+}
+
 static
 void
 testSingleRelease(Session& session)
@@ -439,6 +839,40 @@ testSingleArtistSearchByName(Session& session)
 	}
 }
 
+static
+void
+testSingleTrackSearchByName(Session& session)
+{
+	ScopedTrack track {session, "MyTrackFile"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		track.get().modify()->setName("My Track Name");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool more {};
+		CHECK(Track::getByFilter(session, {}, {"Trac"}, std::nullopt, more).size() == 1);
+		CHECK(Track::getByFilter(session, {}, {"my", "name"}, std::nullopt, more).size() == 1);
+		CHECK(Track::getByFilter(session, {}, {"Other"}, std::nullopt, more).empty());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		track.get().modify()->setName("Other Name");
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool more {};
+		CHECK(Track::getByFilter(session, {}, {"Other"}, std::nullopt, more).size() == 1);
+		CHECK(Track::getByFilter(session, {}, {"Trac"}, std::nullopt, more).empty());
+	}
+}
+
 static
 void
 testMultiArtistsSortMethod(Session& session)
@@ -594,6 +1028,52 @@ testMultiTracksSingleReleaseTotalDiscTrack(Session& session)
 	}
 }
 
+static
+void
+testMultiReleasesCursor(Session& session)
+{
+	// same names to check that entries are ordered by id too
+	ScopedRelease release1 {session, "MyRelease"};
+	ScopedRelease release2 {session, "myrelease"};
+	ScopedRelease release3 {session, "A Release"};
+
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release1.get());
+		track2.get().modify()->setRelease(release2.get());
+		track3.get().modify()->setRelease(release3.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		std::vector<IdType> releaseIds;
+		std::optional<Cursor> cursor;
+		bool more {true};
+		while (more)
+		{
+			const auto releases {Release::getByFilter(session, {}, {}, cursor, 1, more)};
+			CHECK(releases.size() == 1);
+
+			releaseIds.push_back(releases.front().id());
+			cursor = Cursor {releases.front()->getName(), releases.front().id()};
+		}
+
+		CHECK(releaseIds.size() == 3);
+		CHECK(releaseIds[0] == release3.getId());
+		CHECK(releaseIds[1] == std::min(release1.getId(), release2.getId()));
+		CHECK(releaseIds[2] == std::max(release1.getId(), release2.getId()));
+
+		CHECK(Release::getByFilter(session, {}, {}, cursor, 1, more).empty());
+		CHECK(!more);
+	}
+}
+
 static
 void
 testMultiTracksSingleReleaseFirstTrack(Session& session)
@@ -750,6 +1230,54 @@ testMultipleTracksSingleCluster(Session& session)
 	}
 }
 
+static
+void
+testMultipleTracksMultipleClustersFilter(Session& session)
+{
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster1 {session, clusterType.lockAndGet(), "MyCluster1"};
+	ScopedCluster cluster2 {session, clusterType.lockAndGet(), "MyCluster2"};
+	ScopedCluster cluster3 {session, clusterType.lockAndGet(), "MyCluster3"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		cluster1.get().modify()->addTrack(track1.get());
+		cluster1.get().modify()->addTrack(track2.get());
+		cluster2.get().modify()->addTrack(track2.get());
+		cluster2.get().modify()->addTrack(track3.get());
+		cluster3.get().modify()->addTrack(track1.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		auto tracks {Track::getByClusters(session, {cluster1.getId(), cluster2.getId()})};
+		CHECK(tracks.size() == 1);
+		CHECK(tracks.front().id() == track2.getId());
+
+		CHECK(Track::getByClusters(session, {cluster2.getId(), cluster3.getId()}).empty());
+		CHECK(Track::getByClusters(session, {cluster1.getId(), cluster2.getId(), cluster3.getId()}).empty());
+	}
+
+	// The cluster index must be rebuilt
+	{
+		auto transaction {session.createUniqueTransaction()};
+		cluster1.get().modify()->addTrack(track3.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		auto tracks {Track::getByClusters(session, {cluster1.getId(), cluster2.getId()})};
+		CHECK(tracks.size() == 2);
+		CHECK(std::any_of(std::cbegin(tracks), std::cend(tracks), [&](const Track::pointer& track) { return track.id() == track2.getId(); }));
+		CHECK(std::any_of(std::cbegin(tracks), std::cend(tracks), [&](const Track::pointer& track) { return track.id() == track3.getId(); }));
+	}
+}
+
 static
 void
 testMultipleTracksMultipleClustersTopRelease(Session& session)
@@ -881,6 +1409,10 @@ testMultipleTracksSingleClusterSimilarity(Session& session)
 							return similarTrack.id() == track.getId();
 						}) != std::cend(tracks));
 		}
+
+		// number of tracks is not a power of two
+		const auto similarTracks3 {Track::getSimilarTracks(session, {tracks.front().getId(), std::next(std::cbegin(tracks), 1)->getId(), std::next(std::cbegin(tracks), 2)->getId()})};
+		CHECK(similarTracks3.size() == tracks.size() - 3);
 	}
 }
 
@@ -1016,7 +1548,7 @@ testSingleTrackSingleArtistMultiClusters(Session& session)
 	}
 
 	{
-		auto transaction {session.createSharedTransaction()};
+		auto transaction {session.createUniqueTransaction()};
 
 		auto artists {Artist::getByClusters(session, {cluster1.getId()}, Artist::SortMethod::ByName)};
 		CHECK(artists.size() == 1);
@@ -1161,6 +1693,59 @@ testMultiTracksSingleArtistSingleRelease(Session& session)
 
 }
 
+static
+void
+testMultiTracksAggregates(Session& session)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedArtist artist {session, "MyArtist"};
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster {session, clusterType.lockAndGet(), "MyCluster"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		for (ScopedTrack* track : {&track1, &track2})
+		{
+			track->get().modify()->setRelease(release.get());
+			track->get().modify()->setDuration(std::chrono::seconds {10});
+			TrackArtistLink::create(session, track->get(), artist.get(), TrackArtistLinkType::Artist);
+			cluster.get().modify()->addTrack(track->get());
+		}
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(release->getCachedTracksCount() == 0);
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		Release::updateAggregates(session);
+		Artist::updateAggregates(session);
+		Cluster::updateAggregates(session);
+
+		release.get().reread();
+		artist.get().reread();
+		cluster.get().reread();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(release->getCachedTracksCount() == 2);
+		CHECK(release->getCachedDuration() == std::chrono::seconds {20});
+		CHECK(artist->getCachedReleaseCount() == 1);
+		CHECK(artist->getCachedTracksCount() == 2);
+		CHECK(cluster->getCachedTracksCount() == 2);
+		CHECK(cluster->getCachedReleasesCount() == 1);
+	}
+}
+
 static
 void
 testSingleTrackSingleReleaseSingleArtist(Session& session)
@@ -1280,6 +1865,53 @@ testSingleTrackSingleReleaseSingleArtistMultiClusters(Session& session)
 	}
 }
 
+static
+void
+testRemoveAllOrphans(Session& session)
+{
+	ScopedTrack track {session, "MyTrack"};
+	ScopedArtist artist {session, "MyArtist"};
+	ScopedRelease release {session, "MyRelease"};
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster {session, clusterType.lockAndGet(), "MyCluster"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackArtistLink::create(session, track.get(), artist.get(), TrackArtistLinkType::Artist);
+		track.get().modify()->setRelease(release.get());
+		cluster.get().modify()->addTrack(track.get());
+
+		Artist::create(session, "MyOrphanArtist1");
+		Artist::create(session, "MyOrphanArtist2");
+		Release::create(session, "MyOrphanRelease");
+		Cluster::create(session, clusterType.get(), "MyOrphanCluster");
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		CHECK(Cluster::removeAllOrphans(session) == 1);
+		CHECK(Artist::removeAllOrphans(session) == 2);
+		CHECK(Release::removeAllOrphans(session) == 1);
+
+		CHECK(Cluster::removeAllOrphans(session) == 0);
+		CHECK(Artist::removeAllOrphans(session) == 0);
+		CHECK(Release::removeAllOrphans(session) == 0);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(Cluster::getAll(session).size() == 1);
+		CHECK(Artist::getAll(session).size() == 1);
+		CHECK(Release::getAll(session).size() == 1);
+		CHECK(track->getArtists({TrackArtistLinkType::Artist}).size() == 1);
+		CHECK(track->getRelease() == release.get());
+		CHECK(track->getClusters().size() == 1);
+	}
+}
+
 static
 void
 testSingleUser(Session& session)
@@ -1318,6 +1950,10 @@ testSingleStarredArtist(Session& session)
 
 		CHECK(user->hasStarredArtist(artist.get()));
 
+		const auto starredArtistIds {user->getStarredArtistIds()};
+		CHECK(starredArtistIds.size() == 1);
+		CHECK(starredArtistIds.count(artist.getId()) == 1);
+
 		bool hasMore {};
 		auto artists {Artist::getStarred(session, user.get(), {}, std::nullopt, Artist::SortMethod::BySortName, std::nullopt, hasMore)};
 		CHECK(artists.size() == 1);
@@ -1380,6 +2016,154 @@ testSingleStarredTrack(Session& session)
 	}
 }
 
+static
+void
+testMultiTracksBatchLoaders(Session& session)
+{
+	ScopedRelease release {session, "MyRelease"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+	ScopedClusterType clusterType {session, "MyClusterType"};
+	ScopedCluster cluster1 {session, clusterType.lockAndGet(), "MyCluster1"};
+	ScopedCluster cluster2 {session, clusterType.lockAndGet(), "MyCluster2"};
+	ScopedUser user {session, "MyUser"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release.get());
+		track2.get().modify()->setRelease(release.get());
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track1.get(), artist2.get(), TrackArtistLinkType::ReleaseArtist);
+		cluster1.get().modify()->addTrack(track1.get());
+		cluster1.get().modify()->addTrack(track2.get());
+		cluster2.get().modify()->addTrack(track2.get());
+		user.get().modify()->starTrack(track2.get());
+		user.get().modify()->starRelease(release.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const std::vector<IdType> trackIds {track1.getId(), track2.getId()};
+
+		const auto artists {Track::getArtistsByTrack(session, trackIds, {TrackArtistLinkType::Artist})};
+		CHECK(artists.size() == 1);
+		CHECK(artists.at(track1.getId()).size() == 1);
+		CHECK(artists.at(track1.getId()).front().id() == artist1.getId());
+		CHECK(Track::getArtistsByTrack(session, trackIds, {}).at(track1.getId()).size() == 2);
+		CHECK(Track::getArtistsByTrack(session, {}, {}).empty());
+
+		const auto clusters {Track::getFirstClusterByTrack(session, trackIds, clusterType.getId())};
+		CHECK(clusters.size() == 2);
+		CHECK(clusters.at(track1.getId()).id() == cluster1.getId());
+		CHECK(clusters.at(track2.getId()).id() == cluster1.getId());
+
+		const auto starredTrackIds {user->getStarredTrackIds(trackIds)};
+		CHECK(starredTrackIds.size() == 1);
+		CHECK(starredTrackIds.count(track2.getId()) == 1);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const std::vector<IdType> releaseIds {release.getId()};
+
+		const auto releases {Release::getByIds(session, releaseIds)};
+		CHECK(releases.size() == 1);
+		CHECK(releases.front().id() == release.getId());
+
+		const auto releaseArtists {Release::getArtistsByRelease(session, releaseIds, TrackArtistLinkType::ReleaseArtist)};
+		CHECK(releaseArtists.size() == 1);
+		CHECK(releaseArtists.at(release.getId()).size() == 1);
+		CHECK(releaseArtists.at(release.getId()).front().id() == artist2.getId());
+
+		const auto clusters {Release::getFirstClusterByRelease(session, releaseIds, clusterType.getId())};
+		CHECK(clusters.size() == 1);
+		CHECK(clusters.at(release.getId()).id() == cluster1.getId());
+
+		CHECK(user->getStarredReleaseIds(releaseIds).count(release.getId()) == 1);
+	}
+}
+
+static
+void
+testMultiTracksListEntries(Session& session)
+{
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedTrack track3 {session, "MyTrack3"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release1.get());
+		track1.get().modify()->setDuration(std::chrono::seconds {42});
+		track2.get().modify()->setRelease(release1.get());
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track1.get(), artist2.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track2.get(), artist2.get(), TrackArtistLinkType::ReleaseArtist);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(Track::getListEntries(session, {}).empty());
+
+		const auto entries {Track::getListEntries(session, {track3.getId(), track1.getId(), track3.getId() + 1000, track2.getId()})};
+		CHECK(entries.size() == 3);
+		CHECK(entries[0].id == track3.getId());
+		CHECK(!entries[0].release);
+		CHECK(entries[0].artists.empty());
+		CHECK(entries[1].id == track1.getId());
+		CHECK(entries[1].name == "MyTrack1");
+		CHECK(entries[1].duration == std::chrono::seconds {42});
+		CHECK(entries[1].release && entries[1].release->id == release1.getId());
+		CHECK(entries[1].release->name == "MyRelease1");
+		CHECK(entries[1].artists.size() == 2);
+		CHECK(entries[1].artists[0].id == artist1.getId());
+		CHECK(entries[1].artists[0].name == "MyArtist1");
+		CHECK(entries[1].artists[1].id == artist2.getId());
+		CHECK(entries[2].id == track2.getId());
+		CHECK(entries[2].artists.empty());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(Release::getListEntries(session, {}).empty());
+
+		const auto entries {Release::getListEntries(session, {release2.getId(), release1.getId()})};
+		CHECK(entries.size() == 2);
+		CHECK(entries[0].id == release2.getId());
+		CHECK(entries[0].name == "MyRelease2");
+		CHECK(entries[0].artists.empty());
+		CHECK(entries[1].id == release1.getId());
+		CHECK(entries[1].artists.size() == 1);
+		CHECK(entries[1].artists.front().id == artist2.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track2.get().modify()->setRelease({});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		const auto entries {Release::getListEntries(session, {release1.getId()})};
+		CHECK(entries.size() == 1);
+		CHECK(entries.front().artists.size() == 2);
+	}
+}
+
 static
 void
 testSingleTrackList(Session& session)
@@ -1405,21 +2189,62 @@ testSingleTrackListMultipleTrack(Session& session)
 	ScopedTrackList trackList {session, "MytrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
 	std::list<ScopedTrack> tracks;
 
-	for (std::size_t i {}; i < 10; ++i)
+	for (std::size_t i {}; i < 10; ++i)
+	{
+		tracks.emplace_back(session, "MyTrack" + std::to_string(i));
+
+		auto transaction {session.createUniqueTransaction()};
+		TrackListEntry::create(session, tracks.back().get(), trackList.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(trackList->getCount() == tracks.size());
+		const auto trackIds {trackList->getTrackIds()};
+		for (auto trackId : trackIds)
+			CHECK(std::any_of(std::cbegin(tracks), std::cend(tracks), [trackId](const ScopedTrack& track) { return track.getId() == trackId; }));
+	}
+}
+
+static
+void
+testSingleTrackListAppendTracks(Session& session)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MyTrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
+	std::list<ScopedTrack> tracks;
+	std::vector<IdType> createdTrackIds;
+
+	for (std::size_t i {}; i < 600; ++i)
 	{
 		tracks.emplace_back(session, "MyTrack" + std::to_string(i));
+		createdTrackIds.push_back(tracks.back().getId());
+	}
+
+	// reversed, with a duplicate and an unknown id
+	std::vector<IdType> trackIds (std::crbegin(createdTrackIds), std::crend(createdTrackIds));
+	trackIds.push_back(createdTrackIds.front());
+	trackIds.insert(std::next(std::begin(trackIds), 3), createdTrackIds.back() + 1000);
 
+	{
 		auto transaction {session.createUniqueTransaction()};
-		TrackListEntry::create(session, tracks.back().get(), trackList.get());
+
+		CHECK(TrackList::appendTracks(session, trackList.get(), {}) == 0);
+		CHECK(TrackList::appendTracks(session, trackList.get(), trackIds, 2) == 2);
+		CHECK(TrackList::appendTracks(session, trackList.get(), trackIds) == 601);
 	}
 
 	{
 		auto transaction {session.createSharedTransaction()};
 
-		CHECK(trackList->getCount() == tracks.size());
-		const auto trackIds {trackList->getTrackIds()};
-		for (auto trackId : trackIds)
-			CHECK(std::any_of(std::cbegin(tracks), std::cend(tracks), [trackId](const ScopedTrack& track) { return track.getId() == trackId; }));
+		const auto entries {trackList->getEntries()};
+		CHECK(entries.size() == 603);
+		CHECK(entries[0]->getTrack().id() == createdTrackIds[599]);
+		CHECK(entries[1]->getTrack().id() == createdTrackIds[598]);
+		for (std::size_t i {}; i < 600; ++i)
+			CHECK(entries[2 + i]->getTrack().id() == createdTrackIds[599 - i]);
+		CHECK(entries[602]->getTrack().id() == createdTrackIds[0]);
 	}
 }
 
@@ -1766,6 +2591,260 @@ testSingleTrackListMultipleTrackMultiClustersRecentlyPlayed(Session& session)
 	}
 }
 
+static
+void
+testSingleTrackListPlayStats(Session& session)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MyTrackList", TrackList::Type::Internal, false, user.lockAndGet()};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+	ScopedArtist artist1 {session, "MyArtist1"};
+	ScopedArtist artist2 {session, "MyArtist2"};
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setRelease(release1.get());
+		track2.get().modify()->setRelease(release2.get());
+		TrackArtistLink::create(session, track1.get(), artist1.get(), TrackArtistLinkType::Artist);
+		TrackArtistLink::create(session, track2.get(), artist2.get(), TrackArtistLinkType::Artist);
+
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		TrackListEntry::create(session, track2.get(), trackList.get());
+		TrackListEntry::create(session, track2.get(), trackList.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool moreResults {};
+		const auto topTracks {trackList->getTopTracks({}, std::nullopt, moreResults)};
+		CHECK(topTracks.size() == 2);
+		CHECK(topTracks[0].id() == track2.getId());
+		CHECK(topTracks[1].id() == track1.getId());
+
+		const auto topReleases {trackList->getTopReleases({}, std::nullopt, moreResults)};
+		CHECK(topReleases.size() == 2);
+		CHECK(topReleases[0].id() == release2.getId());
+
+		const auto topArtists {trackList->getTopArtists({}, std::nullopt, std::nullopt, moreResults)};
+		CHECK(topArtists.size() == 2);
+		CHECK(topArtists[0].id() == artist2.getId());
+
+		const auto recentTracks {trackList->getTracksReverse({}, std::nullopt, moreResults)};
+		CHECK(recentTracks.size() == 2);
+		CHECK(recentTracks[0].id() == track2.getId());
+	}
+
+	TrackListEntry::pointer lastEntry;
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		lastEntry = TrackListEntry::create(session, track1.get(), trackList.get());
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool moreResults {};
+		const auto topTracks {trackList->getTopTracks({}, Range {0, 1}, moreResults)};
+		CHECK(moreResults);
+		CHECK(topTracks.size() == 1);
+		CHECK(topTracks[0].id() == track1.getId());
+
+		const auto recentReleases {trackList->getReleasesReverse({}, std::nullopt, moreResults)};
+		CHECK(recentReleases.size() == 2);
+		CHECK(recentReleases[0].id() == release1.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		lastEntry.remove();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool moreResults {};
+		const auto topTracks {trackList->getTopTracks({}, std::nullopt, moreResults)};
+		CHECK(topTracks.size() == 2);
+
+		const auto recentTracks {trackList->getTracksReverse({}, std::nullopt, moreResults)};
+		CHECK(recentTracks.size() == 2);
+		CHECK(recentTracks[0].id() == track1.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		trackList.get().modify()->clear();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool moreResults {};
+		CHECK(trackList->getTopTracks({}, std::nullopt, moreResults).empty());
+		CHECK(trackList->getTopReleases({}, std::nullopt, moreResults).empty());
+		CHECK(trackList->getArtistsReverse({}, std::nullopt, std::nullopt, moreResults).empty());
+	}
+}
+
+
+static
+void
+testSingleTrackListCompaction(Session& session)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MyTrackList", TrackList::Type::Internal, false, user.lockAndGet()};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		TrackListEntry::create(session, track2.get(), trackList.get());
+		TrackListEntry::create(session, track1.get(), trackList.get());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		CHECK(TrackList::compactEntries(session, trackList.get(), 2) == 2);
+		CHECK(TrackList::compactEntries(session, trackList.get(), 2) == 0);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(trackList->getCount() == 2);
+
+		// Compacted entries are still counted
+		bool moreResults {};
+		const auto topTracks {trackList->getTopTracks({}, std::nullopt, moreResults)};
+		CHECK(topTracks.size() == 2);
+		CHECK(topTracks[0].id() == track1.getId());
+		CHECK(topTracks[1].id() == track2.getId());
+
+		const auto recentTracks {trackList->getTracksReverse({}, std::nullopt, moreResults)};
+		CHECK(recentTracks.size() == 2);
+		CHECK(recentTracks[0].id() == track1.getId());
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		// Only the remaining entries are uncounted
+		trackList.get().modify()->clear();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		bool moreResults {};
+		const auto topTracks {trackList->getTopTracks({}, std::nullopt, moreResults)};
+		CHECK(topTracks.size() == 1);
+		CHECK(topTracks[0].id() == track1.getId());
+	}
+}
+
+static
+void
+testSingleTrackListStats(Session& session)
+{
+	ScopedUser user {session, "MyUser"};
+	ScopedTrackList trackList {session, "MyTrackList", TrackList::Type::Playlist, false, user.lockAndGet()};
+	ScopedTrack track1 {session, "MyTrack1"};
+	ScopedTrack track2 {session, "MyTrack2"};
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		track1.get().modify()->setDuration(std::chrono::seconds {10});
+		track2.get().modify()->setDuration(std::chrono::seconds {20});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(trackList->isEmpty());
+		CHECK(trackList->getCount() == 0);
+		CHECK(trackList->getDuration() == std::chrono::seconds {0});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		TrackListEntry::create(session, track1.get(), trackList.get());
+		CHECK(TrackList::appendTracks(session, trackList.get(), {track2.getId()}) == 1);
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(trackList->getCount() == 3);
+		CHECK(trackList->getDuration() == std::chrono::seconds {40});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		// Counted once per entry
+		track1.get().modify()->setDuration(std::chrono::seconds {15});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(trackList->getDuration() == std::chrono::seconds {50});
+	}
+
+	{
+		ScopedTrack track3 {session, "MyTrack3"};
+		{
+			auto transaction {session.createUniqueTransaction()};
+
+			track3.get().modify()->setDuration(std::chrono::seconds {5});
+			TrackListEntry::create(session, track3.get(), trackList.get());
+		}
+
+		{
+			auto transaction {session.createSharedTransaction()};
+
+			CHECK(trackList->getCount() == 4);
+			CHECK(trackList->getDuration() == std::chrono::seconds {55});
+		}
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		// Entries of removed tracks are removed
+		CHECK(trackList->getCount() == 3);
+		CHECK(trackList->getDuration() == std::chrono::seconds {50});
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		trackList.get().modify()->clear();
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+
+		CHECK(trackList->isEmpty());
+		CHECK(trackList->getDuration() == std::chrono::seconds {0});
+	}
+}
 
 static
 void
@@ -1911,6 +2990,54 @@ testMultipleTracksMultipleReleasesMultiClusters(Session& session)
 	}
 }
 
+static
+void
+testPrecomputedSimilarReleases(Session& session)
+{
+	ScopedRelease release1 {session, "MyRelease1"};
+	ScopedRelease release2 {session, "MyRelease2"};
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		CHECK(!Release::hasPrecomputedSimilarReleases(session));
+		CHECK(Release::getPrecomputedSimilarReleaseIds(session, release1.getId(), 10).empty());
+	}
+
+	{
+		ScopedRelease release3 {session, "MyRelease3"};
+
+		{
+			auto transaction {session.createUniqueTransaction()};
+			Release::setPrecomputedSimilarReleases(session, {{release1.getId(), {release3.getId(), release2.getId()}}, {release2.getId(), {release1.getId()}}});
+		}
+
+		{
+			auto transaction {session.createSharedTransaction()};
+			CHECK(Release::hasPrecomputedSimilarReleases(session));
+			CHECK((Release::getPrecomputedSimilarReleaseIds(session, release1.getId(), 10) == std::vector<IdType> {release3.getId(), release2.getId()}));
+			CHECK((Release::getPrecomputedSimilarReleaseIds(session, release1.getId(), 1) == std::vector<IdType> {release3.getId()}));
+			CHECK((Release::getPrecomputedSimilarReleaseIds(session, release2.getId(), 10) == std::vector<IdType> {release1.getId()}));
+			CHECK(Release::getPrecomputedSimilarReleaseIds(session, release3.getId(), 10).empty());
+		}
+	}
+
+	// Entries referring to removed releases are removed too
+	{
+		auto transaction {session.createSharedTransaction()};
+		CHECK((Release::getPrecomputedSimilarReleaseIds(session, release1.getId(), 10) == std::vector<IdType> {release2.getId()}));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+		Release::setPrecomputedSimilarReleases(session, {});
+	}
+
+	{
+		auto transaction {session.createSharedTransaction()};
+		CHECK(!Release::hasPrecomputedSimilarReleases(session));
+	}
+}
+
 static
 void
 testSingleTrackSingleUserSingleBookmark(Session& session)
@@ -1947,6 +3074,65 @@ testSingleTrackSingleUserSingleBookmark(Session& session)
 	}
 }
 
+static
+void
+testRebuildDb(Db& db, Session& session)
+{
+	IdType userId;
+	IdType trackId;
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		User::pointer user {User::create(session, "MyUser")};
+		Track::pointer track {Track::create(session, "/tmp/track1.mp3")};
+		Track::create(session, "/tmp/removed.mp3");
+
+		user.modify()->starTrack(track);
+		TrackList::pointer trackList {TrackList::create(session, "MyTrackList", TrackList::Type::Playlist, false, user)};
+		TrackListEntry::create(session, track, trackList);
+
+		userId = user.id();
+		trackId = track.id();
+	}
+
+	{
+		std::unique_ptr<Db> rebuildDb {db.createRebuildDb()};
+		{
+			Session rebuildSession {*rebuildDb};
+			auto transaction {rebuildSession.createUniqueTransaction()};
+
+			// Ids are not kept in the rebuilt database
+			Track::create(rebuildSession, "/tmp/track2.mp3");
+			Track::create(rebuildSession, "/tmp/track1.mp3");
+		}
+		db.replaceByRebuildDb(std::move(rebuildDb));
+	}
+
+	{
+		auto transaction {session.createUniqueTransaction()};
+
+		CHECK(Track::getAll(session).size() == 2);
+		CHECK(!Track::getByPath(session, "/tmp/removed.mp3"));
+
+		const Track::pointer track {Track::getByPath(session, "/tmp/track1.mp3")};
+		CHECK(track);
+		CHECK(track.id() != trackId);
+
+		User::pointer user {User::getById(session, userId)};
+		CHECK(user);
+		CHECK(user->hasStarredTrack(track));
+
+		const auto trackLists {TrackList::getAll(session)};
+		CHECK(trackLists.size() == 1);
+		CHECK(trackLists.front()->getCount() == 1);
+		CHECK(trackLists.front()->getEntry(0)->getTrack() == track);
+
+		user.remove();
+		for (Track::pointer t : Track::getAll(session))
+			t.remove();
+	}
+}
+
 static
 void
 testDatabaseEmpty(Session& session)
@@ -1957,6 +3143,8 @@ testDatabaseEmpty(Session& session)
 	CHECK(Cluster::getAll(session).empty());
 	CHECK(ClusterType::getAll(session).empty());
 	CHECK(Release::getAll(session).empty());
+	CHECK(!ScanCheckpoint::get(session));
+	CHECK(ScannedDirectory::getAll(session).empty());
 	CHECK(Track::getAll(session).empty());
 	CHECK(TrackBookmark::getAll(session).empty());
 	CHECK(TrackList::getAll(session).empty());
@@ -1994,7 +3182,20 @@ int main()
 		RUN_TEST(testRemoveDefaultEntries);
 
 		RUN_TEST(testSingleTrack);
+		RUN_TEST(testSingleTrackFileInfos);
+		RUN_TEST(testSingleTrackCachedTags);
+		RUN_TEST(testSingleTrackRemovedUsingSql);
+		RUN_TEST(testSingleTrackMove);
+		RUN_TEST(testMultiTracksPathsUnder);
+		RUN_TEST(testMultiTracksRandom);
+		RUN_TEST(testMultiTracksGetByIds);
+		RUN_TEST(testSingleTrackFeatures);
+		RUN_TEST(testMultiScannedDirectories);
+		RUN_TEST(testScanSettingsMediaDirectories);
+		RUN_TEST(testScanCheckpoint);
+		RUN_TEST(testQueryShape);
 		RUN_TEST(testSingleArtist);
+		RUN_TEST(testSingleArtistMBID);
 		RUN_TEST(testSingleRelease);
 		RUN_TEST(testSingleCluster);
 
@@ -2003,15 +3204,18 @@ int main()
 		RUN_TEST(testSingleTrackMultiArtists);
 
 		RUN_TEST(testSingleArtistSearchByName);
+		RUN_TEST(testSingleTrackSearchByName);
 		RUN_TEST(testMultiArtistsSortMethod);
 
 		RUN_TEST(testSingleTrackSingleRelease);
 		RUN_TEST(testMultiTracksSingleReleaseTotalDiscTrack);
 		RUN_TEST(testMultiTracksSingleReleaseFirstTrack);
+		RUN_TEST(testMultiReleasesCursor);
 
 		RUN_TEST(testSingleTrackSingleCluster);
 		RUN_TEST(testMultipleTracksSingleCluster);
 
+		RUN_TEST(testMultipleTracksMultipleClustersFilter);
 		RUN_TEST(testMultipleTracksMultipleClustersTopRelease);
 
 		RUN_TEST(testMultipleTracksSingleClusterSimilarity);
@@ -2024,25 +3228,37 @@ int main()
 		RUN_TEST(testMultiTracksSingleArtistSingleRelease);
 
 		RUN_TEST(testSingleTrackSingleReleaseSingleArtist);
+		RUN_TEST(testMultiTracksAggregates);
 
 		RUN_TEST(testSingleTrackSingleReleaseSingleArtistSingleCluster);
 		RUN_TEST(testSingleTrackSingleReleaseSingleArtistMultiClusters);
 
+		RUN_TEST(testRemoveAllOrphans);
+
 		RUN_TEST(testSingleUser);
 
 		RUN_TEST(testSingleStarredArtist);
 		RUN_TEST(testSingleStarredRelease);
 		RUN_TEST(testSingleStarredTrack);
+		RUN_TEST(testMultiTracksBatchLoaders);
+		RUN_TEST(testMultiTracksListEntries);
 
 		RUN_TEST(testSingleTrackList);
 		RUN_TEST(testSingleTrackListMultipleTrack);
+		RUN_TEST(testSingleTrackListAppendTracks);
 		RUN_TEST(testSingleTrackListMultipleTrackSingleCluster);
 		RUN_TEST(testSingleTrackListMultipleTrackMultiClusters);
 		RUN_TEST(testSingleTrackListMultipleTrackMultiClustersRecentlyPlayed);
+		RUN_TEST(testSingleTrackListPlayStats);
+		RUN_TEST(testSingleTrackListCompaction);
+		RUN_TEST(testSingleTrackListStats);
 		RUN_TEST(testMultipleTracksMultipleArtistsMultiClusters);
 		RUN_TEST(testMultipleTracksMultipleReleasesMultiClusters);
+		RUN_TEST(testPrecomputedSimilarReleases);
 
 		RUN_TEST(testSingleTrackSingleUserSingleBookmark);
+
+		runTest("testRebuildDb", [&db](Session& session) { testRebuildDb(db, session); });
 	}
 	catch (std::exception& e)
 	{
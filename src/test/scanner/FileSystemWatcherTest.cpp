@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include "utils/StreamLogger.hpp"
+
+#include "FileSystemWatcher.hpp"
+
+using namespace Scanner;
+
+#define CHECK(PRED)  \
+	do \
+	{ \
+		if (!(PRED)) \
+		{ \
+			std::string error {"Predicate FAILED '" + std::string {#PRED} + "' at " + __FUNCTION__ + "@l." + std::to_string(__LINE__)}; \
+			std::cerr << error << std::endl; \
+			throw std::runtime_error {error}; \
+		} \
+	} while (0)
+
+static constexpr std::chrono::milliseconds debounceDelay {100};
+static constexpr std::chrono::seconds batchTimeout {5};
+
+class ScopedTmpDirectory final
+{
+	public:
+		ScopedTmpDirectory()
+		{
+			std::string pattern {(std::filesystem::temp_directory_path() / "lms-test-watcher-XXXXXX").string()};
+			if (!::mkdtemp(pattern.data()))
+				throw std::runtime_error {"Cannot create temporary directory"};
+
+			_path = pattern;
+		}
+		~ScopedTmpDirectory() { std::filesystem::remove_all(_path); }
+
+		ScopedTmpDirectory(const ScopedTmpDirectory&) = delete;
+		ScopedTmpDirectory(ScopedTmpDirectory&&) = delete;
+		ScopedTmpDirectory operator=(const ScopedTmpDirectory&) = delete;
+		ScopedTmpDirectory operator=(ScopedTmpDirectory&&) = delete;
+
+		const std::filesystem::path& getPath() const { return _path; }
+
+	private:
+		std::filesystem::path _path;
+};
+
+// Collects the batches reported by the watcher
+// The watcher thread can be held in the callback, so that the events queue up meanwhile
+class BatchCollector
+{
+	public:
+		struct Batch
+		{
+			std::set<std::filesystem::path>	changedPaths;
+			bool							fullRescanNeeded;
+		};
+
+		FileSystemWatcher::ChangesCallback getCallback()
+		{
+			return [this](const std::set<std::filesystem::path>& changedPaths, bool fullRescanNeeded)
+			{
+				std::unique_lock lock {_mutex};
+				_batches.push_back(Batch {changedPaths, fullRescanNeeded});
+				_condition.notify_all();
+
+				_condition.wait(lock, [this] { return !_holdWatcher; });
+			};
+		}
+
+		std::optional<Batch> waitForBatch()
+		{
+			std::unique_lock lock {_mutex};
+			if (!_condition.wait_for(lock, batchTimeout, [this] { return !_batches.empty(); }))
+				return std::nullopt;
+
+			Batch batch {std::move(_batches.front())};
+			_batches.pop_front();
+			return batch;
+		}
+
+		void setHoldWatcher(bool hold)
+		{
+			std::scoped_lock lock {_mutex};
+			_holdWatcher = hold;
+			_condition.notify_all();
+		}
+
+	private:
+		std::mutex					_mutex;
+		std::condition_variable		_condition;
+		std::deque<Batch>			_batches;
+		bool						_holdWatcher {};
+};
+
+static
+void
+writeFile(const std::filesystem::path& path)
+{
+	std::ofstream file {path, std::ios_base::app};
+	file << "data";
+}
+
+static
+std::size_t
+getMaxQueuedEvents()
+{
+	std::size_t maxQueuedEvents {16384};
+
+	std::ifstream file {"/proc/sys/fs/inotify/max_queued_events"};
+	file >> maxQueuedEvents;
+
+	return maxQueuedEvents;
+}
+
+static
+void
+testCreateMoveDelete()
+{
+	ScopedTmpDirectory tmpDirectory;
+	const std::filesystem::path& root {tmpDirectory.getPath()};
+
+	BatchCollector collector;
+	FileSystemWatcher watcher {root, debounceDelay, collector.getCallback()};
+
+	// Several changes in a row are reported in a single batch
+	writeFile(root / "file1.mp3");
+	writeFile(root / "file2.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK(!batch->fullRescanNeeded);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "file1.mp3", root / "file2.mp3"}));
+	}
+
+	std::filesystem::rename(root / "file1.mp3", root / "file3.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK(!batch->fullRescanNeeded);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "file1.mp3", root / "file3.mp3"}));
+	}
+
+	std::filesystem::remove(root / "file2.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK(!batch->fullRescanNeeded);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "file2.mp3"}));
+	}
+}
+
+static
+void
+testSubDirectories()
+{
+	ScopedTmpDirectory tmpDirectory;
+	const std::filesystem::path& root {tmpDirectory.getPath()};
+
+	std::filesystem::create_directory(root / "existing");
+
+	BatchCollector collector;
+	FileSystemWatcher watcher {root, debounceDelay, collector.getCallback()};
+
+	// Directories present at startup are watched
+	writeFile(root / "existing" / "file.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "existing" / "file.mp3"}));
+	}
+
+	// New directories are reported, and then watched
+	std::filesystem::create_directory(root / "new");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "new"}));
+	}
+
+	writeFile(root / "new" / "file.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "new" / "file.mp3"}));
+	}
+
+	// Moving a directory out reports it
+	std::filesystem::rename(root / "new", root / "existing" / "moved");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "new", root / "existing" / "moved"}));
+	}
+
+	// The moved directory is still watched
+	std::filesystem::remove(root / "existing" / "moved" / "file.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK(batch->changedPaths.count(root / "existing" / "moved" / "file.mp3") == 1);
+	}
+}
+
+static
+void
+testQueueOverflow()
+{
+	ScopedTmpDirectory tmpDirectory;
+	const std::filesystem::path& root {tmpDirectory.getPath()};
+
+	BatchCollector collector;
+	FileSystemWatcher watcher {root, debounceDelay, collector.getCallback()};
+
+	// Hold the watcher in its callback, so that it does not read the events while they are generated
+	collector.setHoldWatcher(true);
+	writeFile(root / "first.mp3");
+	CHECK(collector.waitForBatch());
+
+	// Identical consecutive events are merged by inotify: alternate between two files
+	const std::size_t eventCount {getMaxQueuedEvents() + 16};
+	for (std::size_t i {}; i < eventCount; ++i)
+		writeFile(root / (i % 2 ? "odd.mp3" : "even.mp3"));
+
+	collector.setHoldWatcher(false);
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK(batch->fullRescanNeeded);
+	}
+
+	// Back to incremental changes
+	writeFile(root / "last.mp3");
+	{
+		const auto batch {collector.waitForBatch()};
+		CHECK(batch);
+		CHECK(!batch->fullRescanNeeded);
+		CHECK((batch->changedPaths == std::set<std::filesystem::path> {root / "last.mp3"}));
+	}
+}
+
+int main()
+{
+	try
+	{
+		// log to stdout
+		Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
+
+		auto runTest = [](const std::string& name, std::function<void()> testFunc)
+		{
+			std::cout << "Running test '" << name << "'..." << std::endl;
+			testFunc();
+			std::cout << "Running test '" << name << "': SUCCESS" << std::endl;
+		};
+
+#define RUN_TEST(test)	runTest(#test, test)
+
+		RUN_TEST(testCreateMoveDelete);
+		RUN_TEST(testSubDirectories);
+		RUN_TEST(testQueueOverflow);
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Measures the SOM primitives on synthetic datasets
+// Results are written to stdout, one CSV line per measurement
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "som/DataNormalizer.hpp"
+#include "som/Network.hpp"
+
+using namespace SOM;
+
+namespace {
+
+struct Dataset
+{
+	std::size_t sampleCount;
+	std::size_t dimCount;
+	std::vector<InputVector> samples;
+};
+
+// Gaussian clusters, so that the data looks a bit like real features
+Dataset
+generateDataset(std::size_t sampleCount, std::size_t dimCount)
+{
+	constexpr std::size_t clusterCount {32};
+
+	std::mt19937 generator {static_cast<std::mt19937::result_type>(sampleCount * 1000 + dimCount)};
+	std::uniform_real_distribution<InputVector::value_type> centerDistribution {-10, 10};
+	std::normal_distribution<InputVector::value_type> noiseDistribution {0, 1};
+	std::uniform_int_distribution<std::size_t> clusterDistribution {0, clusterCount - 1};
+
+	std::vector<InputVector> centers(clusterCount, InputVector {dimCount});
+	for (InputVector& center : centers)
+	{
+		for (std::size_t i {}; i < dimCount; ++i)
+			center[i] = centerDistribution(generator);
+	}
+
+	Dataset dataset {sampleCount, dimCount, {}};
+	dataset.samples.reserve(sampleCount);
+	for (std::size_t i {}; i < sampleCount; ++i)
+	{
+		InputVector sample {centers[clusterDistribution(generator)]};
+		for (std::size_t j {}; j < dimCount; ++j)
+			sample[j] += noiseDistribution(generator);
+
+		dataset.samples.emplace_back(std::move(sample));
+	}
+
+	DataNormalizer normalizer {dimCount};
+	normalizer.computeNormalizationFactors(dataset.samples);
+	for (InputVector& sample : dataset.samples)
+		normalizer.normalizeData(sample);
+
+	return dataset;
+}
+
+// Same sizing rule as the features classifier (about 1.5 samples per neuron)
+Coordinate
+getNetworkSize(std::size_t sampleCount)
+{
+	return std::max<Coordinate>(static_cast<Coordinate>(std::sqrt(sampleCount / 1.5)), 1);
+}
+
+// Runs func until minDuration is reached, returns the mean duration of one call
+std::chrono::nanoseconds
+measure(std::chrono::milliseconds minDuration, std::size_t& callCount, const std::function<void(std::size_t /* callIndex */)>& func)
+{
+	callCount = 0;
+
+	const auto start {std::chrono::steady_clock::now()};
+	std::chrono::steady_clock::duration elapsed {};
+	do
+	{
+		func(callCount++);
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	while (elapsed < minDuration);
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) / callCount;
+}
+
+void
+printHeader()
+{
+	std::cout << "benchmark,samples,dimensions,width,height,threads,calls,ns_per_call,calls_per_second" << std::endl;
+}
+
+void
+printResult(const std::string& benchmark, const Dataset& dataset, const Network& network, std::size_t threadCount, std::size_t callCount, std::chrono::nanoseconds durationPerCall)
+{
+	const double callsPerSecond {durationPerCall.count() > 0 ? 1e9 / durationPerCall.count() : 0};
+
+	std::cout << benchmark
+		<< "," << dataset.sampleCount
+		<< "," << dataset.dimCount
+		<< "," << network.getWidth()
+		<< "," << network.getHeight()
+		<< "," << threadCount
+		<< "," << callCount
+		<< "," << durationPerCall.count()
+		<< "," << callsPerSecond << std::endl;
+}
+
+void
+benchDataset(const Dataset& dataset, std::size_t threadCount, std::chrono::milliseconds minDuration, std::size_t maxTrainSampleCount)
+{
+	const Coordinate size {getNetworkSize(dataset.sampleCount)};
+
+	Network network {size, size, dataset.dimCount};
+	network.setThreadCount(threadCount);
+
+	// Training on a subset keeps the large datasets tractable, throughput is reported per sample
+	const std::vector<InputVector> trainSamples {std::cbegin(dataset.samples), std::next(std::cbegin(dataset.samples), std::min(maxTrainSampleCount, dataset.samples.size()))};
+
+	{
+		std::size_t callCount;
+		const auto duration {measure(minDuration, callCount, [&](std::size_t) { network.train(trainSamples, 1); })};
+		printResult("train_sample", dataset, network, threadCount, callCount * trainSamples.size(), duration / trainSamples.size());
+	}
+
+	{
+		std::size_t callCount;
+		const auto duration {measure(minDuration, callCount, [&](std::size_t) { network.trainBatch(trainSamples, 1); })};
+		printResult("train_batch_sample", dataset, network, threadCount, callCount * trainSamples.size(), duration / trainSamples.size());
+	}
+
+	{
+		std::size_t callCount;
+		Coordinate checksum {};
+		const auto duration {measure(minDuration, callCount, [&](std::size_t callIndex)
+		{
+			checksum += network.getClosestRefVectorPosition(dataset.samples[callIndex % dataset.samples.size()]).x;
+		})};
+		printResult("closest_ref_vector", dataset, network, threadCount, callCount, duration);
+		if (checksum == std::numeric_limits<Coordinate>::max())
+			std::cerr << "unexpected checksum" << std::endl;
+	}
+
+	{
+		const InputVector::Distance maxDistance {network.computeRefVectorsDistanceMean() * 2};
+
+		std::mt19937 generator {static_cast<std::mt19937::result_type>(dataset.sampleCount)};
+		std::uniform_int_distribution<Coordinate> coordinateDistribution {0, size - 1};
+
+		// Typical size of the position sets built from a few seed tracks
+		constexpr std::size_t setCount {64};
+		constexpr std::size_t positionCountPerSet {16};
+		std::vector<std::unordered_set<Position>> positionSets(setCount);
+		for (auto& positions : positionSets)
+		{
+			while (positions.size() < std::min<std::size_t>(positionCountPerSet, size * size))
+				positions.insert(Position {coordinateDistribution(generator), coordinateDistribution(generator)});
+		}
+
+		std::size_t callCount;
+		std::size_t foundCount {};
+		const auto duration {measure(minDuration, callCount, [&](std::size_t callIndex)
+		{
+			if (network.getClosestRefVectorPosition(positionSets[callIndex % positionSets.size()], maxDistance))
+				foundCount++;
+		})};
+		printResult("closest_ref_vector_from_set", dataset, network, threadCount, callCount, duration);
+		if (foundCount > callCount)
+			std::cerr << "unexpected found count" << std::endl;
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	// usage: bench-som [thread_count [min_duration_ms [max_train_sample_count]]]
+	const std::size_t threadCount {argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1};
+	const std::chrono::milliseconds minDuration {argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500};
+	const std::size_t maxTrainSampleCount {argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2000};
+
+	if (threadCount == 0 || maxTrainSampleCount == 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [thread_count [min_duration_ms [max_train_sample_count]]]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	printHeader();
+
+	for (std::size_t sampleCount : {1'000, 10'000, 100'000})
+	{
+		for (std::size_t dimCount : {10, 50, 150})
+		{
+			const Dataset dataset {generateDataset(sampleCount, dimCount)};
+			benchDataset(dataset, threadCount, minDuration, maxTrainSampleCount);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
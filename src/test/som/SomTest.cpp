@@ -17,12 +17,19 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <sstream>
+#include <utility>
 #include <cassert>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <optional>
 
 #include "som/DataNormalizer.hpp"
+#include "som/DimensionReducer.hpp"
 #include "som/Network.hpp"
+#include "som/SampleMatrix.hpp"
 
 using namespace SOM;
 
@@ -52,6 +59,369 @@ int main()
 		assert(std::abs(test3[1] - 1) < EPSILON);
 	}
 
+	{
+		InputVector test1 {6};
+		InputVector test2 {6};
+		InputVector weights {6, 1};
+		for (std::size_t i {}; i < 6; ++i)
+		{
+			test1[i] = static_cast<InputVector::value_type>(i);
+			test2[i] = static_cast<InputVector::value_type>(2 * i);
+		}
+		weights[5] = 2;
+
+		// 0 + 1 + 4 + 9 + 16 + 2 * 25
+		assert(std::abs(test1.computeEuclidianSquareDistance(test2, weights) - 80) < EPSILON);
+		assert(std::abs(test2.computeEuclidianSquareDistance(test1, weights) - 80) < EPSILON);
+	}
+
+	{
+		Network network {3, 2, 2};
+
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				InputVector refVector {2};
+				refVector[0] = x;
+				refVector[1] = y;
+				network.setRefVector({x, y}, refVector);
+			}
+		}
+
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				const InputVector refVector {network.getRefVector({x, y})};
+				assert(std::abs(refVector[0] - x) < EPSILON);
+				assert(std::abs(refVector[1] - y) < EPSILON);
+
+				assert((network.getClosestRefVectorPosition(refVector) == Position {x, y}));
+			}
+		}
+
+		assert(std::abs(network.getRefVectorsDistance({0, 0}, {2, 1}) - 5) < EPSILON);
+	}
+
+	{
+		// Large enough for the threads to be actually used
+		Network network {64, 48, 8};
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				InputVector refVector {8};
+				for (std::size_t i {}; i < refVector.getNbDimensions(); ++i)
+					refVector[i] = static_cast<InputVector::value_type>((x * 7 + y * 13 + i * 3) % 17);
+				network.setRefVector({x, y}, refVector);
+			}
+		}
+
+		Network threadedNetwork {network};
+		threadedNetwork.setThreadCount(4);
+
+		SampleMatrix samples {8};
+		for (std::size_t i {}; i < 50; ++i)
+		{
+			InputVector input {8};
+			for (std::size_t j {}; j < input.getNbDimensions(); ++j)
+				input[j] = static_cast<InputVector::value_type>((i * 5 + j * 11) % 17);
+
+			assert(network.getClosestRefVectorPosition(input) == threadedNetwork.getClosestRefVectorPosition(input));
+			samples.append(input);
+		}
+
+		// Values are small integers: the batch search computes the exact same distances
+		const std::vector<Position> positions {network.getClosestRefVectorPositions(samples)};
+		assert(positions == threadedNetwork.getClosestRefVectorPositions(samples));
+		assert(positions.size() == samples.getSampleCount());
+		for (std::size_t i {}; i < positions.size(); ++i)
+			assert(positions[i] == network.getClosestRefVectorPosition(samples.getSample(i)));
+
+		std::vector<InputVector> trainData {InputVector {8, 1}, InputVector {8, 10}};
+		threadedNetwork.train(trainData, 2);
+	}
+
+	{
+		// Batch training does not depend on the sample order nor on the thread count
+		Network network {40, 30, 4};
+
+		std::vector<InputVector> trainData;
+		for (std::size_t i {}; i < 200; ++i)
+		{
+			InputVector input {4};
+			for (std::size_t j {}; j < input.getNbDimensions(); ++j)
+				input[j] = static_cast<InputVector::value_type>((i * 7 + j * 3) % 23) / 23;
+			trainData.push_back(input);
+		}
+
+		Network threadedNetwork {network};
+		threadedNetwork.setThreadCount(4);
+
+		network.trainBatch(trainData, 3);
+
+		std::reverse(std::begin(trainData), std::end(trainData));
+		threadedNetwork.trainBatch(trainData, 3);
+
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				const InputVector refVector {network.getRefVector({x, y})};
+				const InputVector threadedRefVector {threadedNetwork.getRefVector({x, y})};
+				for (std::size_t i {}; i < refVector.getNbDimensions(); ++i)
+					assert(std::abs(refVector[i] - threadedRefVector[i]) < EPSILON);
+			}
+		}
+
+		for (const InputVector& input : trainData)
+			assert(network.getClosestRefVectorPosition(input) == threadedNetwork.getClosestRefVectorPosition(input));
+	}
+
+	{
+		// A batch training stopped and resumed gives the same results as an uninterrupted one
+		Network network {20, 15, 3};
+
+		std::vector<InputVector> trainData;
+		for (std::size_t i {}; i < 100; ++i)
+		{
+			InputVector input {3};
+			for (std::size_t j {}; j < input.getNbDimensions(); ++j)
+				input[j] = static_cast<InputVector::value_type>((i * 11 + j * 7) % 19) / 19;
+			trainData.push_back(input);
+		}
+
+		Network resumedNetwork {network};
+
+		network.trainBatch(trainData, 4);
+
+		std::size_t currentIteration {};
+		resumedNetwork.trainBatch(trainData, 4,
+				[&](const Network::CurrentIteration& iteration) { currentIteration = iteration.idIteration; },
+				[&] { return currentIteration == 2; });
+		assert(currentIteration == 2);
+
+		resumedNetwork.trainBatch(trainData, 4,
+				[&](const Network::CurrentIteration& iteration) { assert(iteration.idIteration >= 2); },
+				{},
+				2);
+
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				const InputVector refVector {network.getRefVector({x, y})};
+				const InputVector resumedRefVector {resumedNetwork.getRefVector({x, y})};
+				for (std::size_t i {}; i < refVector.getNbDimensions(); ++i)
+					assert(std::abs(refVector[i] - resumedRefVector[i]) < EPSILON);
+			}
+		}
+	}
+
+	{
+		// Growing a region gives the same positions as repeatedly looking for the closest neighbour of the set
+		Network network {12, 9, 3};
+
+		auto getClosestNeighbour {[&](const std::unordered_set<Position>& positions, InputVector::Distance maxDistance)
+		{
+			std::optional<Position> res;
+			InputVector::Distance resDistance {};
+			for (Coordinate y {}; y < network.getHeight(); ++y)
+			{
+				for (Coordinate x {}; x < network.getWidth(); ++x)
+				{
+					const Position position {x, y};
+					if (positions.count(position))
+						continue;
+
+					const bool isNeighbour {(x > 0 && positions.count({x - 1, y})) || positions.count({x + 1, y}) || (y > 0 && positions.count({x, y - 1})) || positions.count({x, y + 1})};
+					if (!isNeighbour)
+						continue;
+
+					InputVector::Distance distance {std::numeric_limits<InputVector::Distance>::max()};
+					for (const Position& other : positions)
+						distance = std::min(distance, network.getRefVectorsDistance(position, other));
+
+					if (distance <= maxDistance && (!res || distance < resDistance))
+					{
+						res = position;
+						resDistance = distance;
+					}
+				}
+			}
+			return res;
+		}};
+
+		const InputVector::Distance maxDistance {network.computeRefVectorsDistanceMedian()};
+
+		std::unordered_set<Position> positions {{3, 4}, {10, 1}};
+		std::unordered_set<Position> expectedPositions {positions};
+
+		std::size_t addedCount {};
+		network.growRegion(positions, maxDistance, [&](const Position& position)
+		{
+			const std::optional<Position> expectedPosition {getClosestNeighbour(expectedPositions, maxDistance)};
+			assert(expectedPosition);
+			assert(*expectedPosition == position);
+
+			expectedPositions.insert(position);
+			return ++addedCount < 50;
+		});
+		assert(addedCount == 50 || !getClosestNeighbour(expectedPositions, maxDistance));
+
+		assert(network.getClosestRefVectorPosition(positions, maxDistance) == getClosestNeighbour(positions, maxDistance));
+		assert(!network.getClosestRefVectorPosition(positions, 0));
+	}
+
+	{
+		// Incremental normalization gives the same factors as the normalization of the whole samples
+		std::vector<InputVector> samples;
+		for (const auto& [value0, value1] : {std::pair {3, 2}, std::pair {-1, 5}, std::pair {7, 0}})
+		{
+			InputVector sample {2};
+			sample[0] = value0;
+			sample[1] = value1;
+			samples.push_back(sample);
+		}
+
+		DataNormalizer normalizer {2};
+		normalizer.computeNormalizationFactors(samples);
+
+		DataNormalizer incrementalNormalizer {2};
+		for (const InputVector& sample : samples)
+			incrementalNormalizer.update(sample);
+		incrementalNormalizer.finalize();
+
+		for (std::size_t i {}; i < 2; ++i)
+		{
+			assert(normalizer.getValue(i).min == incrementalNormalizer.getValue(i).min);
+			assert(normalizer.getValue(i).max == incrementalNormalizer.getValue(i).max);
+		}
+		assert(incrementalNormalizer.getValue(0).min == -1);
+		assert(incrementalNormalizer.getValue(1).max == 5);
+
+		bool thrown {};
+		try
+		{
+			DataNormalizer {2}.finalize();
+		}
+		catch (const Exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	{
+		// Samples lying on a weighted plane are reduced to 2 dimensions without changing their weighted distances
+		InputVector weights {3, 1};
+		weights[1] = 4;
+
+		std::vector<InputVector> samples;
+		for (std::size_t i {}; i < 100; ++i)
+		{
+			const InputVector::value_type a {static_cast<InputVector::value_type>((i * 7) % 11)};
+			const InputVector::value_type b {static_cast<InputVector::value_type>((i * 3) % 13)};
+
+			InputVector sample {3};
+			sample[0] = a + b;
+			sample[1] = a - b;
+			sample[2] = 2 * a + 0.5 * b;
+			samples.push_back(sample);
+		}
+
+		DimensionReducer reducer {3, 2};
+		reducer.setDataWeights(weights);
+		for (const InputVector& sample : samples)
+			reducer.update(sample);
+		reducer.finalize();
+
+		const InputVector unitWeights {2, 1};
+		for (std::size_t i {1}; i < samples.size(); ++i)
+		{
+			const InputVector::Distance distance {samples[i].computeEuclidianSquareDistance(samples[0], weights)};
+			const InputVector::Distance reducedDistance {reducer.reduceData(samples[i]).computeEuclidianSquareDistance(reducer.reduceData(samples[0]), unitWeights)};
+			assert(std::abs(distance - reducedDistance) < EPSILON * std::max<InputVector::Distance>(distance, 1));
+		}
+
+		// Components are sorted by decreasing variance
+		auto getVariance {[&](std::size_t outputDimId)
+		{
+			InputVector::value_type res {};
+			for (const InputVector& sample : samples)
+			{
+				const InputVector::value_type value {reducer.reduceData(sample)[outputDimId]};
+				res += value * value;
+			}
+			return res;
+		}};
+		assert(getVariance(0) >= getVariance(1));
+
+		bool thrown {};
+		try
+		{
+			DimensionReducer {2, 3};
+		}
+		catch (const Exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	{
+		// Training from a sample matrix, in memory or in a file, gives the same results as training from the samples
+		const std::filesystem::path sampleFile {std::filesystem::temp_directory_path() / "lms-test-som-samples.bin"};
+
+		Network network {10, 10, 3};
+		Network memoryNetwork {network};
+		Network fileNetwork {network};
+
+		std::vector<InputVector> trainData;
+		SampleMatrix memorySamples {3};
+		{
+			SampleMatrix fileSamples {3, sampleFile};
+
+			for (std::size_t i {}; i < 3000; ++i)
+			{
+				InputVector input {3};
+				for (std::size_t j {}; j < input.getNbDimensions(); ++j)
+					input[j] = static_cast<InputVector::value_type>((i * 13 + j * 5) % 31) / 31;
+
+				trainData.push_back(input);
+				memorySamples.append(input);
+				fileSamples.append(input);
+			}
+
+			assert(fileSamples.getSampleCount() == trainData.size());
+			for (std::size_t i {}; i < trainData.size(); ++i)
+			{
+				const InputVector sample {fileSamples.getSample(i)};
+				for (std::size_t j {}; j < sample.getNbDimensions(); ++j)
+					assert(sample[j] == trainData[i][j]);
+			}
+
+			network.trainBatch(trainData, 2);
+			memoryNetwork.trainBatch(memorySamples, 2);
+			fileNetwork.trainBatch(fileSamples, 2);
+
+			fileNetwork.train(fileSamples, 1);
+		}
+		assert(!std::filesystem::exists(sampleFile));
+
+		for (Coordinate y {}; y < network.getHeight(); ++y)
+		{
+			for (Coordinate x {}; x < network.getWidth(); ++x)
+			{
+				const InputVector refVector {network.getRefVector({x, y})};
+				const InputVector memoryRefVector {memoryNetwork.getRefVector({x, y})};
+				for (std::size_t i {}; i < refVector.getNbDimensions(); ++i)
+					assert(refVector[i] == memoryRefVector[i]);
+			}
+		}
+	}
+
 	{
 		Network network {2, 2, 1};
 
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "av/AvInfo.hpp"
+#include "av/AvTranscoder.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+
+namespace {
+
+	// Lets the command line override the transcode backend of the config file
+	class BenchConfig final : public IConfig
+	{
+		public:
+			BenchConfig(std::unique_ptr<IConfig> config, std::optional<std::string> backend)
+				: _config {std::move(config)}
+				, _backend {std::move(backend)}
+			{}
+
+		private:
+			std::string getString(const std::string& setting, const std::string& def, const std::unordered_set<std::string>& allowedValues) override
+			{
+				if (setting == "transcode-backend" && _backend)
+					return *_backend;
+
+				return _config->getString(setting, def, allowedValues);
+			}
+			std::filesystem::path getPath(const std::string& setting, const std::filesystem::path& def) override { return _config->getPath(setting, def); }
+			unsigned long getULong(const std::string& setting, unsigned long def) override { return _config->getULong(setting, def); }
+			long getLong(const std::string& setting, long def) override { return _config->getLong(setting, def); }
+			bool getBool(const std::string& setting, bool def) override { return _config->getBool(setting, def); }
+			void reload() override { _config->reload(); }
+
+			std::unique_ptr<IConfig> _config;
+			const std::optional<std::string> _backend;
+	};
+
+	const std::map<std::string, Av::Format> formatsByName
+	{
+		{"mp3",				Av::Format::MP3},
+		{"ogg_opus",		Av::Format::OGG_OPUS},
+		{"matroska_opus",	Av::Format::MATROSKA_OPUS},
+		{"ogg_vorbis",		Av::Format::OGG_VORBIS},
+		{"webm_vorbis",		Av::Format::WEBM_VORBIS},
+		{"mpegts_aac",		Av::Format::MPEGTS_AAC},
+	};
+
+	struct InputFile
+	{
+		std::filesystem::path		path;
+		std::chrono::milliseconds	duration;
+	};
+
+	struct TranscodeResult
+	{
+		bool						success {};
+		std::chrono::microseconds	timeToFirstByte {};
+		std::chrono::microseconds	duration {};
+		std::uint64_t				outputSize {};
+		std::chrono::milliseconds	mediaDuration {};
+	};
+
+	struct ResourceUsage
+	{
+		std::chrono::microseconds	cpuTime {};	// user + system, this process and its terminated children (ffmpeg)
+		long						maxRssKB {};	// this process
+		long						childrenMaxRssKB {};	// largest terminated child
+	};
+
+	std::chrono::microseconds
+	toMicroseconds(const struct timeval& tv)
+	{
+		return std::chrono::seconds {tv.tv_sec} + std::chrono::microseconds {tv.tv_usec};
+	}
+
+	ResourceUsage
+	getResourceUsage()
+	{
+		struct rusage self {};
+		struct rusage children {};
+		::getrusage(RUSAGE_SELF, &self);
+		::getrusage(RUSAGE_CHILDREN, &children);
+
+		ResourceUsage res;
+		res.cpuTime = toMicroseconds(self.ru_utime) + toMicroseconds(self.ru_stime) + toMicroseconds(children.ru_utime) + toMicroseconds(children.ru_stime);
+		res.maxRssKB = self.ru_maxrss;
+		res.childrenMaxRssKB = children.ru_maxrss;
+
+		return res;
+	}
+
+	TranscodeResult
+	transcode(const InputFile& file, const Av::TranscodeParameters& parameters)
+	{
+		TranscodeResult res;
+		res.mediaDuration = file.duration;
+
+		const auto start {std::chrono::steady_clock::now()};
+
+		Av::Transcoder transcoder {file.path, parameters};
+		if (!transcoder.start())
+			return res;
+
+		std::vector<unsigned char> output;
+		while (!transcoder.isComplete())
+		{
+			transcoder.process(output, 65536);
+			if (!output.empty() && res.outputSize == 0)
+				res.timeToFirstByte = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+			res.outputSize += output.size();
+		}
+
+		res.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		res.success = transcoder.isSuccessful();
+
+		return res;
+	}
+
+	// Each stream transcodes all the files, starting from a different one
+	void
+	runBench(const std::vector<InputFile>& files, const Av::TranscodeParameters& parameters, std::size_t streamCount)
+	{
+		std::vector<std::vector<TranscodeResult>> results(streamCount);
+
+		const ResourceUsage usageBefore {getResourceUsage()};
+		const auto start {std::chrono::steady_clock::now()};
+
+		std::vector<std::thread> streams;
+		for (std::size_t i {}; i < streamCount; ++i)
+		{
+			streams.emplace_back([&, i]
+			{
+				for (std::size_t j {}; j < files.size(); ++j)
+					results[i].push_back(transcode(files[(i + j) % files.size()], parameters));
+			});
+		}
+		for (std::thread& stream : streams)
+			stream.join();
+
+		const std::chrono::duration<double> wallTime {std::chrono::steady_clock::now() - start};
+		const ResourceUsage usageAfter {getResourceUsage()};
+
+		std::size_t failureCount {};
+		std::vector<std::chrono::microseconds> timesToFirstByte;
+		std::uint64_t outputSize {};
+		std::chrono::milliseconds mediaDuration {};
+		for (const auto& streamResults : results)
+		{
+			for (const TranscodeResult& result : streamResults)
+			{
+				if (!result.success)
+				{
+					failureCount++;
+					continue;
+				}
+
+				timesToFirstByte.push_back(result.timeToFirstByte);
+				outputSize += result.outputSize;
+				mediaDuration += result.mediaDuration;
+			}
+		}
+
+		std::sort(std::begin(timesToFirstByte), std::end(timesToFirstByte));
+		auto getTimeToFirstByteMs {[&](double percentile)
+		{
+			if (timesToFirstByte.empty())
+				return 0.;
+
+			const std::size_t index {std::min(timesToFirstByte.size() - 1, static_cast<std::size_t>(percentile * timesToFirstByte.size()))};
+			return std::chrono::duration<double, std::milli> {timesToFirstByte[index]}.count();
+		}};
+
+		const double cpuSeconds {std::chrono::duration<double> {usageAfter.cpuTime - usageBefore.cpuTime}.count()};
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "streams = " << streamCount
+			<< ", transcodes = " << (streamCount * files.size()) << " (" << failureCount << " failed)"
+			<< ", TTFB p50/p90/max = " << getTimeToFirstByteMs(0.5) << "/" << getTimeToFirstByteMs(0.9) << "/" << getTimeToFirstByteMs(1) << " ms"
+			<< ", throughput = " << (outputSize / wallTime.count() / 1024) << " KiB/s (" << (outputSize / wallTime.count() / 1024 / streamCount) << " KiB/s per stream)"
+			<< ", speed = " << (std::chrono::duration<double> {mediaDuration}.count() / wallTime.count() / streamCount) << "x realtime per stream"
+			<< ", CPU = " << (cpuSeconds / wallTime.count() / streamCount * 100) << "% of a core per stream"
+			<< std::endl;
+	}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		// log to stderr, the report goes to stdout
+		Service<Logger> logger {std::make_unique<StreamLogger>(std::cerr)};
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("conf,c", po::value<std::string>()->default_value("/etc/lms.conf"), "LMS config file")
+		("backend,b", po::value<std::string>(), "Transcode backend (\"libav\" or \"ffmpeg\"), overrides the config file")
+		("file,f", po::value<std::vector<std::string>>()->required(), "Sample file to be transcoded (can be repeated)")
+		("format", po::value<std::vector<std::string>>()->default_value({"ogg_opus"}, "ogg_opus"), "Output format: mp3, ogg_opus, matroska_opus, ogg_vorbis, webm_vorbis, mpegts_aac (can be repeated)")
+		("bitrate", po::value<std::vector<unsigned>>()->default_value({128}, "128"), "Output bitrate in kbps (can be repeated)")
+		("streams,n", po::value<std::vector<std::size_t>>()->default_value({1}, "1"), "Number of concurrent transcodes (can be repeated)")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+		po::notify(vm);
+
+		std::optional<std::string> backend;
+		if (vm.count("backend"))
+			backend = vm["backend"].as<std::string>();
+
+		Service<IConfig> config {std::make_unique<BenchConfig>(createConfig(vm["conf"].as<std::string>()), backend)};
+		Av::Transcoder::init();
+
+		std::vector<InputFile> files;
+		for (const std::string& file : vm["file"].as<std::vector<std::string>>())
+			files.push_back(InputFile {file, Av::MediaFile {file}.getDuration()});
+
+		for (const std::string& formatName : vm["format"].as<std::vector<std::string>>())
+		{
+			auto itFormat {formatsByName.find(formatName)};
+			if (itFormat == std::cend(formatsByName))
+				throw std::runtime_error {"Unknown format '" + formatName + "'"};
+
+			for (const unsigned bitrate : vm["bitrate"].as<std::vector<unsigned>>())
+			{
+				Av::TranscodeParameters parameters;
+				parameters.format = itFormat->second;
+				parameters.bitrate = bitrate * 1000;
+
+				for (const std::size_t streamCount : vm["streams"].as<std::vector<std::size_t>>())
+				{
+					std::cout << formatName << " @ " << bitrate << " kbps: ";
+					runBench(files, parameters, std::max<std::size_t>(streamCount, 1));
+				}
+			}
+		}
+
+		const ResourceUsage usage {getResourceUsage()};
+		std::cout << "Peak RSS = " << (usage.maxRssKB / 1024) << " MiB, largest ffmpeg process peak RSS = " << (usage.childrenMaxRssKB / 1024) << " MiB" << std::endl;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
@@ -17,10 +17,24 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -31,8 +45,10 @@
 #include "database/Track.hpp"
 #include "utils/IConfig.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
 
 static
 void
@@ -51,6 +67,175 @@ dumpTrackCovers(Database::Session& session, CoverArt::ImageSize width)
 	}
 }
 
+// Peak and current resident set sizes, in kB
+static
+std::string
+getMemoryUsage()
+{
+	std::string res;
+
+	std::ifstream ifs {"/proc/self/status"};
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		if (line.rfind("VmHWM:", 0) == 0 || line.rfind("VmRSS:", 0) == 0)
+			res += (res.empty() ? "" : ", ") + StringUtils::stringTrim(line.substr(0, 6)) + " " + StringUtils::stringTrim(line.substr(6));
+	}
+
+	return res;
+}
+
+static
+void
+printDurations(const std::string& name, std::vector<std::chrono::microseconds>& durations, std::chrono::duration<double> elapsed)
+{
+	if (durations.empty())
+		return;
+
+	std::sort(std::begin(durations), std::end(durations));
+
+	auto percentile {[&](std::size_t p) { return durations[(durations.size() - 1) * p / 100].count() / 1000.; }};
+
+	std::chrono::microseconds total {};
+	for (std::chrono::microseconds duration : durations)
+		total += duration;
+
+	std::cout << std::left << std::setw(8) << name << std::right
+		<< " covers = " << std::setw(7) << durations.size()
+		<< ", " << std::setw(8) << durations.size() / elapsed.count() << " covers/s"
+		<< ", mean = " << std::setw(8) << total.count() / 1000. / durations.size() << "ms"
+		<< ", p50 = " << std::setw(8) << percentile(50) << "ms"
+		<< ", p99 = " << std::setw(8) << percentile(99) << "ms"
+		<< ", max = " << std::setw(8) << durations.back().count() / 1000. << "ms" << std::endl;
+}
+
+// Differences of the grabber metrics during a benchmark pass
+static
+void
+printMetrics(const Metrics::Snapshot& before, const Metrics::Snapshot& after)
+{
+	auto getCounterDelta {[&](const std::string& name) -> std::uint64_t
+	{
+		const auto itAfter {after.counters.find(name)};
+		if (itAfter == std::cend(after.counters))
+			return 0;
+
+		const auto itBefore {before.counters.find(name)};
+		return itAfter->second.value - (itBefore == std::cend(before.counters) ? 0 : itBefore->second.value);
+	}};
+
+	auto printHitRatio {[&](const std::string& name, const std::string& cacheName)
+	{
+		const std::uint64_t hits {getCounterDelta("lms_" + cacheName + "_hits_total")};
+		const std::uint64_t misses {getCounterDelta("lms_" + cacheName + "_misses_total")};
+		std::cout << "  " << std::left << std::setw(12) << name << std::right
+			<< " hits = " << std::setw(7) << hits
+			<< ", misses = " << std::setw(7) << misses
+			<< ", hit ratio = " << std::setw(6) << (hits + misses > 0 ? hits * 100. / (hits + misses) : 0.) << "%" << std::endl;
+	}};
+
+	auto printStep {[&](const std::string& name, const std::string& histogramName)
+	{
+		const auto itAfter {after.histograms.find(histogramName)};
+		if (itAfter == std::cend(after.histograms))
+			return;
+
+		const auto itBefore {before.histograms.find(histogramName)};
+		const std::uint64_t count {itAfter->second.value.count - (itBefore == std::cend(before.histograms) ? 0 : itBefore->second.value.count)};
+		const std::chrono::microseconds sum {itAfter->second.value.sum - (itBefore == std::cend(before.histograms) ? std::chrono::microseconds {} : itBefore->second.value.sum)};
+
+		std::cout << "  " << std::left << std::setw(12) << name << std::right
+			<< " images = " << std::setw(7) << count
+			<< ", total = " << std::setw(9) << sum.count() / 1000000. << "s"
+			<< ", mean = " << std::setw(8) << (count > 0 ? sum.count() / 1000. / count : 0.) << "ms" << std::endl;
+	}};
+
+	printHitRatio("memory cache", "cover_memory_cache");
+	printHitRatio("disk cache", "cover_disk_cache");
+	printStep("decode", "lms_cover_decode_duration_seconds");
+	printStep("resize", "lms_cover_resize_duration_seconds");
+	printStep("encode", "lms_cover_encode_duration_seconds");
+}
+
+// Gets the covers of the releases at each size using several threads, and reports the throughput
+// Covers are requested twice: first with empty caches (cold), then again once cached (warm)
+// If enabled, the disk cache is then tested using a new grabber, whose memory cache is empty
+static
+void
+benchmark(Database::Db& db, const std::function<std::unique_ptr<CoverArt::IGrabber>()>& createGrabber, const std::vector<CoverArt::ImageSize>& sizes, std::optional<std::size_t> maxReleaseCount, CoverArt::ImageFormat format, std::size_t threadCount, bool diskCache)
+{
+	std::vector<Database::IdType> releaseIds;
+	{
+		Database::Session session {db};
+		auto transaction {session.createSharedTransaction()};
+		releaseIds = Database::Release::getAllIds(session);
+	}
+	if (maxReleaseCount && releaseIds.size() > *maxReleaseCount)
+		releaseIds.resize(*maxReleaseCount);
+
+	std::vector<std::pair<Database::IdType, CoverArt::ImageSize>> requests;
+	for (Database::IdType releaseId : releaseIds)
+	{
+		for (CoverArt::ImageSize size : sizes)
+			requests.emplace_back(releaseId, size);
+	}
+
+	std::cout << "Getting " << requests.size() << " covers (" << releaseIds.size() << " releases, " << sizes.size() << " size(s)) using " << threadCount << " thread(s)..." << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+
+	auto runPass {[&](const std::string& name, CoverArt::IGrabber& grabber)
+	{
+		// Durations by thread
+		std::vector<std::vector<std::chrono::microseconds>> threadDurations(threadCount);
+		std::atomic<std::size_t> nextRequest {};
+
+		const Metrics::Snapshot metricsBefore {Metrics::getSnapshot()};
+		const auto start {std::chrono::steady_clock::now()};
+		{
+			std::vector<std::thread> threads;
+			for (std::size_t threadIndex {}; threadIndex < threadCount; ++threadIndex)
+			{
+				threads.emplace_back([&, threadIndex]
+				{
+					Database::Session session {db};
+					for (std::size_t index {nextRequest++}; index < requests.size(); index = nextRequest++)
+					{
+						const auto requestStart {std::chrono::steady_clock::now()};
+						grabber.getFromRelease(session, requests[index].first, requests[index].second, format);
+						threadDurations[threadIndex].push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - requestStart));
+					}
+				});
+			}
+
+			for (std::thread& thread : threads)
+				thread.join();
+		}
+		const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+		const Metrics::Snapshot metricsAfter {Metrics::getSnapshot()};
+
+		std::vector<std::chrono::microseconds> durations;
+		for (const std::vector<std::chrono::microseconds>& threadDuration : threadDurations)
+			durations.insert(std::end(durations), std::cbegin(threadDuration), std::cend(threadDuration));
+
+		std::cout << "Elapsed: " << elapsed.count() << "s" << std::endl;
+		printDurations(name, durations, elapsed);
+		printMetrics(metricsBefore, metricsAfter);
+		std::cout << "Memory: " << getMemoryUsage() << std::endl;
+	}};
+
+	{
+		const std::unique_ptr<CoverArt::IGrabber> grabber {createGrabber()};
+		runPass("cold", *grabber);
+		runPass("warm", *grabber);
+	}
+
+	if (diskCache)
+	{
+		const std::unique_ptr<CoverArt::IGrabber> grabber {createGrabber()};
+		runPass("disk", *grabber);
+	}
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -69,7 +254,14 @@ int main(int argc, char *argv[])
         ("default-cover,d", po::value<std::string>(), "Default cover path")
         ("tracks,t", "dump covers for tracks")
 		("size,s", po::value<unsigned>()->default_value(512), "Requested cover size")
-		("quality,q", po::value<unsigned>()->default_value(75), "JPEG quality (1-100)")
+		("quality,q", po::value<unsigned>(), "JPEG quality (1-100), overrides cover-jpeg-quality")
+		("webp-quality", po::value<unsigned>(), "WebP quality (1-100), overrides cover-webp-quality")
+		("bench,b", "Benchmark: get the release covers, with cold and then warm caches")
+		("sizes", po::value<std::string>()->default_value("128 512"), "Benchmark: requested cover sizes")
+		("format", po::value<std::string>()->default_value("jpeg"), "Benchmark: requested cover format (jpeg, webp)")
+		("count", po::value<std::size_t>(), "Benchmark: max release count")
+		("disk-cache-size", po::value<std::size_t>()->default_value(0), "Benchmark: disk cache size in MB, 0 to disable. A temporary directory is used")
+		("threads", po::value<std::size_t>()->default_value(std::max<std::size_t>(1, std::thread::hardware_concurrency())), "Thread count used to benchmark")
         ;
 
         po::variables_map vm;
@@ -83,18 +275,56 @@ int main(int argc, char *argv[])
 
 		Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
 
-		Service<CoverArt::IGrabber> coverArtService {CoverArt::createGrabber(argv[0],
+		const unsigned jpegQuality {vm.count("quality") ? vm["quality"].as<unsigned>() : static_cast<unsigned>(config->getULong("cover-jpeg-quality", 75))};
+		const unsigned webpQuality {vm.count("webp-quality") ? vm["webp-quality"].as<unsigned>() : static_cast<unsigned>(config->getULong("cover-webp-quality", 75))};
+		const std::size_t diskCacheSize {vm["disk-cache-size"].as<std::size_t>() * 1000 * 1000};
+		const std::filesystem::path diskCacheDirectory {std::filesystem::temp_directory_path() / ("lms-cover-" + std::to_string(::getpid()))};
+
+		auto createGrabber {[&](std::size_t maxDiskCacheSize)
+		{
+			return CoverArt::createGrabber(argv[0],
 				vm["default-cover"].as<std::string>(),
 				config->getULong("cover-max-cache-size", 30) * 1000 * 1000,
 				config->getULong("cover-max-file-size", 10) * 1000 * 1000,
-				config->getULong("cover-jpeg-quality", vm["quality"].as<unsigned>())
-				)};
+				jpegQuality,
+				webpQuality,
+				diskCacheDirectory, maxDiskCacheSize);
+		}};
+
+		Service<CoverArt::IGrabber> coverArtService {createGrabber(0 /* no disk cache */)};
 
-		Database::Db db {config->getPath("working-dir") / "lms.db"};
+		const std::size_t threadCount {std::max<std::size_t>(1, vm["threads"].as<std::size_t>())};
+		Database::Db db {config->getPath("working-dir") / "lms.db", std::max<std::size_t>(10, threadCount)};
 		Database::Session session {db};
 
 		if (vm.count("tracks"))
 			dumpTrackCovers(session, vm["size"].as<unsigned>());
+
+		if (vm.count("bench"))
+		{
+			std::vector<CoverArt::ImageSize> sizes;
+			for (const std::string& size : StringUtils::splitString(vm["sizes"].as<std::string>(), " ,"))
+			{
+				if (const auto value {StringUtils::readAs<CoverArt::ImageSize>(size)})
+					sizes.push_back(*value);
+			}
+
+			const CoverArt::ImageFormat format {vm["format"].as<std::string>() == "webp" ? CoverArt::ImageFormat::WebP : CoverArt::ImageFormat::JPEG};
+			if (!coverArtService->isFormatSupported(format))
+				throw std::runtime_error {"Requested format is not supported by this image library"};
+
+			std::cout << "Image library: " << LMS_IMAGE_LIBRARY << ", JPEG quality = " << jpegQuality << ", WebP quality = " << webpQuality << std::endl;
+
+			benchmark(db, [&] { return createGrabber(diskCacheSize); },
+					sizes,
+					vm.count("count") ? std::make_optional(vm["count"].as<std::size_t>()) : std::nullopt,
+					format,
+					threadCount,
+					diskCacheSize > 0);
+
+			std::error_code ec;
+			std::filesystem::remove_all(diskCacheDirectory, ec);
+		}
 	}
 	catch( std::exception& e)
 	{
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "database/Db.hpp"
+#include "database/Session.hpp"
+#include "utils/IConfig.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+
+namespace {
+
+	struct HotQuery
+	{
+		std::string name;
+		std::string query;
+	};
+
+	// Shapes of the queries run on each page or API call, none of them is expected to scan a whole table
+	const std::vector<HotQuery> hotQueries
+	{
+		{"tracks by clusters",			"SELECT t.id FROM track t WHERE t.id IN (SELECT DISTINCT t.id FROM track t INNER JOIN track_cluster t_c ON t_c.track_id = t.id INNER JOIN cluster c ON c.id = t_c.cluster_id WHERE c.id = ? OR c.id = ? GROUP BY t.id HAVING COUNT(*) = 2)"},
+		{"cluster track count",			"SELECT COUNT(*) FROM track_cluster t_c WHERE t_c.cluster_id = ?"},
+		{"clusters of tracks",			"SELECT DISTINCT c.id FROM cluster c INNER JOIN track_cluster t_c ON t_c.cluster_id = c.id WHERE t_c.track_id IN (?, ?)"},
+		{"tracklist tracks",			"SELECT t.id FROM track t INNER JOIN tracklist_entry p_e ON t.id = p_e.track_id WHERE p_e.tracklist_id = ? ORDER BY p_e.id"},
+		{"tracklist duration",			"SELECT COALESCE(SUM(duration), 0) FROM track t INNER JOIN tracklist_entry p_e ON t.id = p_e.track_id WHERE p_e.tracklist_id = ?"},
+		{"tracklist entries of track",	"SELECT p_e.id FROM tracklist_entry p_e WHERE p_e.track_id = ?"},
+		{"starred artists",				"SELECT a.id FROM artist a INNER JOIN user_artist_starred uas ON uas.artist_id = a.id WHERE uas.user_id = ?"},
+		{"starred releases",			"SELECT r.id FROM release r INNER JOIN user_release_starred urs ON urs.release_id = r.id WHERE urs.user_id = ?"},
+		{"starred tracks",				"SELECT t.id FROM track t WHERE t.id IN (SELECT DISTINCT t.id FROM track t INNER JOIN user_track_starred uts ON uts.track_id = t.id INNER JOIN user u ON u.id = uts.user_id WHERE u.id = ?)"},
+		{"starred artist ids",			"SELECT artist_id FROM user_artist_starred WHERE user_id = ?"},
+		{"starring users of track",		"SELECT user_id FROM user_track_starred WHERE track_id = ?"},
+		{"similar releases",			"SELECT similar_release_id FROM release_similarity WHERE release_id = ? ORDER BY position LIMIT ?"},
+		{"similar artists",				"SELECT similar_artist_id FROM artist_similarity WHERE artist_id = ? ORDER BY position LIMIT ?"},
+	};
+
+	// "SCAN t" (or "SCAN TABLE track AS t" using older SQLite versions) reads the whole table,
+	// whereas "SCAN t USING COVERING INDEX ..." only reads an index
+	bool
+	isFullScan(const std::string& step)
+	{
+		return step.rfind("SCAN ", 0) == 0 && step.find(" USING ") == std::string::npos;
+	}
+
+	// Returns true if no full scan is used
+	bool
+	explainQuery(Database::Db& db, const HotQuery& hotQuery)
+	{
+		bool res {true};
+
+		std::cout << "*** " << hotQuery.name << " ***" << std::endl;
+		std::cout << hotQuery.query << std::endl;
+		for (const std::string& step : db.getQueryPlan(hotQuery.query))
+		{
+			const bool fullScan {isFullScan(step)};
+			if (fullScan)
+				res = false;
+
+			std::cout << (fullScan ? " ! " : "   ") << step << std::endl;
+		}
+		std::cout << std::endl;
+
+		return res;
+	}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		// log to stdout
+		Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("conf,c", po::value<std::string>()->default_value("/etc/lms.conf"), "LMS config file")
+		("db,d", po::value<std::string>(), "Database file, defaults to the one in the LMS working directory")
+		("prepare,p", "Create or upgrade the tables and indexes first")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+
+		std::filesystem::path dbPath;
+		if (vm.count("db"))
+		{
+			dbPath = vm["db"].as<std::string>();
+		}
+		else
+		{
+			Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
+			dbPath = config->getPath("working-dir") / "lms.db";
+		}
+
+		Database::Db db {dbPath};
+		if (vm.count("prepare"))
+		{
+			Database::Session session {db};
+			session.prepareTables();
+		}
+
+		std::size_t fullScanQueryCount {};
+		for (const HotQuery& hotQuery : hotQueries)
+		{
+			if (!explainQuery(db, hotQuery))
+				fullScanQueryCount++;
+		}
+
+		if (fullScanQueryCount > 0)
+		{
+			std::cerr << fullScanQueryCount << " quer" << (fullScanQueryCount == 1 ? "y uses" : "ies use") << " full table scans (marked with '!')" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch( std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <taglib/id3v2tag.h>
+#include <taglib/mpegfile.h>
+#include <taglib/tpropertymap.h>
+
+#include "database/Artist.hpp"
+#include "database/Cluster.hpp"
+#include "database/Db.hpp"
+#include "database/Release.hpp"
+#include "database/ScanSettings.hpp"
+#include "database/Session.hpp"
+#include "database/Track.hpp"
+#include "database/TrackArtistLink.hpp"
+#include "database/TrackFeatures.hpp"
+#include "recommendation/IEngine.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Random.hpp"
+#include "utils/Service.hpp"
+#include "utils/StreamLogger.hpp"
+#include "utils/UUID.hpp"
+
+namespace {
+
+	// The library is only a function of the track count and of the seed, so that benchmarks can be compared across runs and machines
+
+	const std::vector<std::string> words
+	{
+		"Black", "Blue", "Broken", "City", "Cold", "Crystal", "Dance", "Dark", "Dawn", "Desert",
+		"Dream", "Echo", "Electric", "Empire", "Fire", "Ghost", "Glass", "Gold", "Heart", "Highway",
+		"Horizon", "Iron", "Island", "Light", "Lost", "Machine", "Midnight", "Mirror", "Moon", "Night",
+		"Ocean", "Paper", "Rain", "River", "Road", "Shadow", "Silver", "Sky", "Smoke", "Star",
+		"Stone", "Storm", "Summer", "Sun", "Thunder", "Velvet", "Wild", "Wind", "Winter", "Wolf",
+		// Non ASCII names, to exercise sorting and searching
+		"Été", "Mañana", "Ångström", "Noël", "Größe", "Café", "Déjà", "Søren", "Ça", "Niño",
+	};
+
+	const std::vector<std::string> genres
+	{
+		"Rock", "Pop", "Electronic", "Jazz", "Hip-Hop", "Classical", "Metal", "Folk", "Blues", "Soul",
+		"Reggae", "Punk", "Country", "Funk", "Ambient", "Techno", "House", "Indie", "Alternative", "R&B",
+		"Soundtrack", "World", "Latin", "Disco", "Gospel", "Trance", "Drum & Bass", "Dub", "Grunge", "Chanson",
+	};
+
+	// Dimension count of the features the classifier uses, as reported by the AcousticBrainz low level data
+	std::size_t
+	getFeatureDimCount(const std::string& featureName)
+	{
+		static const std::unordered_map<std::string, std::size_t> dimCounts
+		{
+			{"lowlevel.spectral_contrast_valleys.var",	6},
+			{"lowlevel.erbbands.mean",					40},
+			{"lowlevel.gfcc.mean",						13},
+		};
+
+		auto it {dimCounts.find(featureName)};
+		return it != std::cend(dimCounts) ? it->second : 1;
+	}
+
+	struct GenArtist
+	{
+		std::string		name;
+		UUID	mbid;
+		std::size_t		genre;
+	};
+
+	struct GenTrack
+	{
+		std::string					title;
+		std::vector<std::size_t>	artists;
+		std::size_t					discNumber;
+		std::size_t					trackNumber;
+		std::size_t					totalTrack;
+		std::chrono::seconds		duration;
+		UUID				recordingMBID;
+		UUID				releaseTrackMBID;
+		std::filesystem::path		relativePath;
+	};
+
+	struct GenRelease
+	{
+		std::string					name;
+		UUID				mbid;
+		std::optional<std::size_t>	artist;		// unset for compilations
+		std::size_t					genre;
+		int							year;
+		std::size_t					discCount;
+		std::vector<GenTrack>		tracks;
+	};
+
+	struct Library
+	{
+		std::vector<GenArtist>	artists;
+		std::vector<GenRelease>	releases;
+	};
+
+	class Generator
+	{
+		public:
+			Generator(std::uint_fast32_t seed) : _rng {Random::createSeededGenerator(seed)} {}
+
+			Library generate(std::size_t trackCount);
+
+		private:
+			std::size_t		pickZipf(std::discrete_distribution<std::size_t>& dist) { return dist(_rng); }
+			bool			pickChance(double probability) { return std::bernoulli_distribution {probability}(_rng); }
+			std::size_t		pickInRange(std::size_t min, std::size_t max) { return std::uniform_int_distribution<std::size_t> {min, max}(_rng); }
+			std::string		pickName(std::size_t minWordCount, std::size_t maxWordCount);
+			std::string		pickUniqueName(std::set<std::string>& usedNames, std::size_t minWordCount, std::size_t maxWordCount);
+			UUID	pickUUID();
+
+			Random::RandGenerator _rng;
+	};
+
+	// Popularity of ranked items follows a power law: a few artists and genres get most of the tracks
+	std::discrete_distribution<std::size_t>
+	createZipfDistribution(std::size_t count, double exponent)
+	{
+		std::vector<double> weights(count);
+		for (std::size_t i {}; i < count; ++i)
+			weights[i] = 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+
+		return std::discrete_distribution<std::size_t>(std::cbegin(weights), std::cend(weights));
+	}
+
+	std::string
+	Generator::pickName(std::size_t minWordCount, std::size_t maxWordCount)
+	{
+		std::string res;
+
+		const std::size_t wordCount {pickInRange(minWordCount, maxWordCount)};
+		for (std::size_t i {}; i < wordCount; ++i)
+		{
+			if (!res.empty())
+				res += ' ';
+			res += words[pickInRange(0, words.size() - 1)];
+		}
+
+		return res;
+	}
+
+	std::string
+	Generator::pickUniqueName(std::set<std::string>& usedNames, std::size_t minWordCount, std::size_t maxWordCount)
+	{
+		std::string name {pickName(minWordCount, maxWordCount)};
+		while (!usedNames.insert(name).second)
+			name += " " + words[pickInRange(0, words.size() - 1)];
+
+		return name;
+	}
+
+	UUID
+	Generator::pickUUID()
+	{
+		std::uniform_int_distribution<unsigned> dist {0, 255};
+
+		std::array<unsigned, UUID::byteCount> bytes;
+		for (unsigned& byte : bytes)
+			byte = dist(_rng);
+
+		// Version 4, variant 1
+		bytes[6] = (bytes[6] & 0x0F) | 0x40;
+		bytes[8] = (bytes[8] & 0x3F) | 0x80;
+
+		std::ostringstream oss;
+		oss << std::hex << std::setfill('0');
+		for (std::size_t i {}; i < bytes.size(); ++i)
+		{
+			if (i == 4 || i == 6 || i == 8 || i == 10)
+				oss << '-';
+			oss << std::setw(2) << bytes[i];
+		}
+
+		return *UUID::fromString(oss.str());
+	}
+
+	Library
+	Generator::generate(std::size_t trackCount)
+	{
+		Library library;
+
+		// Artists, each having a main genre
+		std::discrete_distribution<std::size_t> genreDist {createZipfDistribution(genres.size(), 1.0)};
+		const std::size_t artistCount {std::max<std::size_t>(1, trackCount / 40)};
+		std::set<std::string> usedArtistNames;
+		for (std::size_t i {}; i < artistCount; ++i)
+			library.artists.push_back(GenArtist {pickUniqueName(usedArtistNames, 1, 3), pickUUID(), pickZipf(genreDist)});
+
+		std::discrete_distribution<std::size_t> artistDist {createZipfDistribution(artistCount, 0.8)};
+		std::set<std::string> usedReleaseNames;
+		std::size_t remainingTrackCount {trackCount};
+		while (remainingTrackCount > 0)
+		{
+			const bool compilation {artistCount > 1 && pickChance(0.08)};
+			const std::optional<std::size_t> releaseArtist {compilation ? std::nullopt : std::make_optional(pickZipf(artistDist))};
+
+			GenRelease release
+			{
+				pickUniqueName(usedReleaseNames, 1, 4),
+				pickUUID(),
+				releaseArtist,
+				releaseArtist ? library.artists[*releaseArtist].genre : pickZipf(genreDist),
+				static_cast<int>(pickInRange(1960, 2025)),
+				pickChance(0.07) ? pickInRange(2, 3) : 1,
+				{},
+			};
+
+			const std::string& releaseArtistName {release.artist ? library.artists[*release.artist].name : "Various Artists"};
+			for (std::size_t disc {1}; disc <= release.discCount && remainingTrackCount > 0; ++disc)
+			{
+				// Singles and EPs, then albums
+				const std::size_t discTrackCount {std::min(remainingTrackCount, pickChance(0.10) ? pickInRange(1, 5) : pickInRange(8, 14))};
+				for (std::size_t trackNumber {1}; trackNumber <= discTrackCount; ++trackNumber)
+				{
+					const std::string title {pickName(1, 4)};
+
+					std::vector<std::size_t> trackArtists {release.artist ? *release.artist : pickZipf(artistDist)};
+					// Featured artists
+					if (artistCount > 1 && pickChance(0.10))
+					{
+						const std::size_t featuredArtist {pickZipf(artistDist)};
+						if (featuredArtist != trackArtists.front())
+							trackArtists.push_back(featuredArtist);
+					}
+
+					std::ostringstream fileName;
+					fileName << disc << "-" << std::setw(2) << std::setfill('0') << trackNumber << " - " << title << ".mp3";
+
+					const std::chrono::seconds duration {pickInRange(90, 420)};
+					const UUID recordingMBID {pickUUID()};
+					const UUID releaseTrackMBID {pickUUID()};
+					release.tracks.push_back(GenTrack
+					{
+						title,
+						std::move(trackArtists),
+						disc,
+						trackNumber,
+						discTrackCount,
+						duration,
+						recordingMBID,
+						releaseTrackMBID,
+						std::filesystem::path {releaseArtistName} / release.name / fileName.str(),
+					});
+				}
+				remainingTrackCount -= discTrackCount;
+			}
+
+			library.releases.push_back(std::move(release));
+		}
+
+		return library;
+	}
+
+	// Smallest valid MP3 file: a Xing frame declaring the duration, followed by one silent frame
+	// MPEG-1 layer III, 32 kbps, 44.1 kHz, mono: 104 bytes per frame, 1152 samples per frame
+	void
+	writeAudioFile(const std::filesystem::path& path, std::chrono::seconds duration)
+	{
+		constexpr std::size_t frameSize {104};
+		constexpr std::size_t sideInfoSize {17};
+		constexpr std::array<unsigned char, 4> frameHeader {0xFF, 0xFB, 0x10, 0xC4};
+
+		std::array<unsigned char, frameSize> xingFrame {};
+		std::copy(std::cbegin(frameHeader), std::cend(frameHeader), std::begin(xingFrame));
+
+		const std::uint32_t frameCount {static_cast<std::uint32_t>(duration.count() * 44100 / 1152)};
+		const std::array<unsigned char, 12> xingHeader
+		{
+			'X', 'i', 'n', 'g',
+			0, 0, 0, 1,		// frame count is set
+			static_cast<unsigned char>(frameCount >> 24), static_cast<unsigned char>(frameCount >> 16), static_cast<unsigned char>(frameCount >> 8), static_cast<unsigned char>(frameCount),
+		};
+		std::copy(std::cbegin(xingHeader), std::cend(xingHeader), std::begin(xingFrame) + frameHeader.size() + sideInfoSize);
+
+		std::array<unsigned char, frameSize> silentFrame {};
+		std::copy(std::cbegin(frameHeader), std::cend(frameHeader), std::begin(silentFrame));
+
+		std::ofstream file {path, std::ios::binary | std::ios::trunc};
+		if (!file)
+			throw std::runtime_error {"Cannot create file '" + path.string() + "'"};
+
+		file.write(reinterpret_cast<const char*>(xingFrame.data()), xingFrame.size());
+		file.write(reinterpret_cast<const char*>(silentFrame.data()), silentFrame.size());
+		if (!file)
+			throw std::runtime_error {"Cannot write file '" + path.string() + "'"};
+	}
+
+	TagLib::String
+	toTagLibString(const std::string& str)
+	{
+		return TagLib::String {str, TagLib::String::UTF8};
+	}
+
+	void
+	writeTags(const std::filesystem::path& path, const Library& library, const GenRelease& release, const GenTrack& track)
+	{
+		TagLib::PropertyMap properties;
+
+		properties["TITLE"] = toTagLibString(track.title);
+		properties["ALBUM"] = toTagLibString(release.name);
+		properties["TRACKNUMBER"] = toTagLibString(std::to_string(track.trackNumber) + "/" + std::to_string(track.totalTrack));
+		properties["DISCNUMBER"] = toTagLibString(std::to_string(track.discNumber) + "/" + std::to_string(release.discCount));
+		properties["DATE"] = toTagLibString(std::to_string(release.year));
+		properties["GENRE"] = toTagLibString(genres[release.genre]);
+		properties["MUSICBRAINZ_ALBUMID"] = toTagLibString(release.mbid.getAsString());
+		properties["MUSICBRAINZ_TRACKID"] = toTagLibString(track.recordingMBID.getAsString());
+		properties["MUSICBRAINZ_RELEASETRACKID"] = toTagLibString(track.releaseTrackMBID.getAsString());
+
+		TagLib::StringList artistNames;
+		TagLib::StringList artistMBIDs;
+		for (const std::size_t artist : track.artists)
+		{
+			artistNames.append(toTagLibString(library.artists[artist].name));
+			artistMBIDs.append(toTagLibString(library.artists[artist].mbid.getAsString()));
+		}
+		properties["ARTIST"] = artistNames;
+		properties["MUSICBRAINZ_ARTISTID"] = artistMBIDs;
+
+		if (release.artist)
+		{
+			properties["ALBUMARTIST"] = toTagLibString(library.artists[*release.artist].name);
+			properties["MUSICBRAINZ_ALBUMARTISTID"] = toTagLibString(library.artists[*release.artist].mbid.getAsString());
+		}
+		else
+		{
+			properties["ALBUMARTIST"] = toTagLibString("Various Artists");
+			properties["COMPILATION"] = toTagLibString("1");
+		}
+
+		TagLib::MPEG::File file {path.c_str()};
+		if (!file.isValid())
+			throw std::runtime_error {"Cannot open file '" + path.string() + "' for tagging"};
+
+		file.ID3v2Tag(true)->setProperties(properties);
+		if (!file.save())
+			throw std::runtime_error {"Cannot save tags of file '" + path.string() + "'"};
+	}
+
+	// Low level features, as found in AcousticBrainz data
+	// Values are centered on the genre of the release, then on the artist, so that similar tracks share genres and artists
+	class FeaturesGenerator
+	{
+		public:
+			FeaturesGenerator(std::uint_fast32_t seed, const Library& library);
+
+			std::string generateJson(const GenRelease& release, const GenTrack& track);
+
+		private:
+			using FeatureCenters = std::map<std::string, std::vector<double>>;
+
+			FeatureCenters	pickCenters(double stdDev);
+
+			Random::RandGenerator		_rng;
+			std::set<std::string>		_featureNames;	// ordered for reproducibility
+			std::vector<FeatureCenters>	_genreCenters;
+			std::vector<FeatureCenters>	_artistOffsets;
+	};
+
+	FeaturesGenerator::FeaturesGenerator(std::uint_fast32_t seed, const Library& library)
+	: _rng {Random::createSeededGenerator(seed)}
+	{
+		for (const std::string& featureName : Recommendation::getUsedTrackFeatureNames())
+			_featureNames.insert(featureName);
+
+		for (std::size_t i {}; i < genres.size(); ++i)
+			_genreCenters.push_back(pickCenters(1.0));
+
+		for (std::size_t i {}; i < library.artists.size(); ++i)
+			_artistOffsets.push_back(pickCenters(0.3));
+	}
+
+	FeaturesGenerator::FeatureCenters
+	FeaturesGenerator::pickCenters(double stdDev)
+	{
+		std::normal_distribution<double> dist {0, stdDev};
+
+		FeatureCenters res;
+		for (const std::string& featureName : _featureNames)
+		{
+			std::vector<double>& values {res[featureName]};
+			for (std::size_t i {}; i < getFeatureDimCount(featureName); ++i)
+				values.push_back(dist(_rng));
+		}
+
+		return res;
+	}
+
+	std::string
+	FeaturesGenerator::generateJson(const GenRelease& release, const GenTrack& track)
+	{
+		// Feature names are paths in the json tree
+		struct Node
+		{
+			std::map<std::string, Node>	children;
+			std::vector<double>			values;
+		};
+
+		std::normal_distribution<double> noiseDist {0, 0.1};
+
+		Node root;
+		for (const std::string& featureName : _featureNames)
+		{
+			Node* node {&root};
+			std::istringstream iss {featureName};
+			std::string key;
+			while (std::getline(iss, key, '.'))
+				node = &node->children[key];
+
+			const std::vector<double>& genreCenter {_genreCenters[release.genre].at(featureName)};
+			const std::vector<double>& artistOffset {_artistOffsets[track.artists.front()].at(featureName)};
+			for (std::size_t i {}; i < genreCenter.size(); ++i)
+				node->values.push_back(genreCenter[i] + artistOffset[i] + noiseDist(_rng));
+		}
+
+		std::ostringstream oss;
+		oss << std::setprecision(8);
+
+		auto writeNode {[&oss](const Node& node, const auto& writeNodeRef) -> void
+		{
+			if (node.children.empty())
+			{
+				if (node.values.size() == 1)
+				{
+					oss << node.values.front();
+					return;
+				}
+
+				oss << '[';
+				for (std::size_t i {}; i < node.values.size(); ++i)
+					oss << (i > 0 ? "," : "") << node.values[i];
+				oss << ']';
+				return;
+			}
+
+			oss << '{';
+			bool first {true};
+			for (const auto& [key, child] : node.children)
+			{
+				oss << (first ? "" : ",") << '"' << key << "\":";
+				writeNodeRef(child, writeNodeRef);
+				first = false;
+			}
+			oss << '}';
+		}};
+		writeNode(root, writeNode);
+
+		return oss.str();
+	}
+
+	void
+	createAudioFiles(const std::filesystem::path& outputDir, const Library& library)
+	{
+		std::size_t fileCount {};
+		for (const GenRelease& release : library.releases)
+		{
+			for (const GenTrack& track : release.tracks)
+			{
+				const std::filesystem::path path {outputDir / track.relativePath};
+				std::filesystem::create_directories(path.parent_path());
+
+				writeAudioFile(path, track.duration);
+				writeTags(path, library, release, track);
+
+				if (++fileCount % 1000 == 0)
+					std::cout << "Created " << fileCount << " files" << std::endl;
+			}
+		}
+		std::cout << "Created " << fileCount << " files in '" << outputDir.string() << "'" << std::endl;
+	}
+
+	// One json object per line: the recording MBID and the features, in the format stored by TrackFeatures
+	// Meant to be loaded by a FeaturesClassifier features fetch function, tracks being matched by MBID
+	void
+	writeFeaturesFile(const std::filesystem::path& featuresFile, const Library& library, FeaturesGenerator& featuresGenerator)
+	{
+		std::ofstream output {featuresFile, std::ios::trunc};
+		if (!output.is_open())
+			throw std::runtime_error {"Cannot create file '" + featuresFile.string() + "'"};
+
+		for (const GenRelease& release : library.releases)
+		{
+			for (const GenTrack& track : release.tracks)
+				output << "{\"mbid\":\"" << track.recordingMBID.getAsString() << "\",\"features\":" << featuresGenerator.generateJson(release, track) << "}\n";
+		}
+	}
+
+	// Same objects as the scanner would create for the generated files
+	// Tracks of files that do not exist are removed by the next scan
+	void
+	populateDatabase(const std::filesystem::path& dbPath, const std::filesystem::path& outputDir, const Library& library, FeaturesGenerator* featuresGenerator)
+	{
+		using namespace Database;
+
+		Db db {dbPath};
+		Session session {db};
+		session.prepareTables();
+
+		std::size_t scanVersion;
+		std::vector<Cluster::pointer> genreClusters;
+		std::vector<Artist::pointer> artists;
+		Artist::pointer variousArtists;
+		std::vector<Release::pointer> releases;
+		{
+			auto transaction {session.createUniqueTransaction()};
+
+			scanVersion = ScanSettings::get(session)->getScanVersion();
+
+			ClusterType::pointer genreClusterType {ClusterType::getByName(session, "GENRE")};
+			if (!genreClusterType)
+				genreClusterType = ClusterType::create(session, "GENRE");
+
+			for (const std::string& genre : genres)
+				genreClusters.push_back(Cluster::create(session, genreClusterType, genre));
+
+			for (const GenArtist& artist : library.artists)
+				artists.push_back(Artist::create(session, artist.name, artist.mbid));
+			variousArtists = Artist::create(session, "Various Artists");
+
+			for (const GenRelease& release : library.releases)
+				releases.push_back(Release::create(session, release.name, release.mbid));
+		}
+
+		const std::unordered_set<FeatureName> storedFeatureNames {Recommendation::getUsedTrackFeatureNames()};
+		const Wt::WDateTime now {Wt::WDateTime::currentDateTime()};
+
+		std::vector<std::pair<std::size_t /* release */, const GenTrack*>> tracks;
+		for (std::size_t releaseIndex {}; releaseIndex < library.releases.size(); ++releaseIndex)
+		{
+			for (const GenTrack& track : library.releases[releaseIndex].tracks)
+				tracks.emplace_back(releaseIndex, &track);
+		}
+
+		// Batched, so that the database is not locked during the whole generation
+		constexpr std::size_t batchSize {1000};
+		std::size_t trackCount {};
+		while (trackCount < tracks.size())
+		{
+			auto transaction {session.createUniqueTransaction()};
+
+			for (const std::size_t batchEnd {std::min(trackCount + batchSize, tracks.size())}; trackCount < batchEnd; ++trackCount)
+			{
+				const auto [releaseIndex, track] {tracks[trackCount]};
+				const GenRelease& release {library.releases[releaseIndex]};
+
+				Track::pointer dbTrack {Track::create(session, outputDir / track->relativePath)};
+				dbTrack.modify()->setScanVersion(scanVersion);
+				dbTrack.modify()->setName(track->title);
+				dbTrack.modify()->setDuration(track->duration);
+				dbTrack.modify()->setTrackNumber(static_cast<int>(track->trackNumber));
+				dbTrack.modify()->setTotalTrack(static_cast<int>(track->totalTrack));
+				dbTrack.modify()->setDiscNumber(static_cast<int>(track->discNumber));
+				dbTrack.modify()->setTotalDisc(static_cast<int>(release.discCount));
+				dbTrack.modify()->setYear(release.year);
+				dbTrack.modify()->setMBID(track->recordingMBID);
+				dbTrack.modify()->setRelease(releases[releaseIndex]);
+				dbTrack.modify()->setClusters({genreClusters[release.genre]});
+				dbTrack.modify()->setFileSize(208);	// audio frames, without the tags
+				dbTrack.modify()->setLastWriteTime(now);
+				dbTrack.modify()->setAddedTime(now);
+
+				for (const std::size_t artist : track->artists)
+					dbTrack.modify()->addArtistLink(TrackArtistLink::create(session, dbTrack, artists[artist], TrackArtistLinkType::Artist));
+				dbTrack.modify()->addArtistLink(TrackArtistLink::create(session, dbTrack, release.artist ? artists[*release.artist] : variousArtists, TrackArtistLinkType::ReleaseArtist));
+
+				if (featuresGenerator)
+					TrackFeatures::create(session, dbTrack, featuresGenerator->generateJson(release, *track), storedFeatureNames);
+			}
+
+			std::cout << "Added " << trackCount << " tracks" << std::endl;
+		}
+
+		std::cout << "Added " << trackCount << " tracks to '" << dbPath.string() << "'" << std::endl;
+	}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		// log to stderr
+		Service<Logger> logger {std::make_unique<StreamLogger>(std::cerr)};
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("output-dir,o", po::value<std::string>(), "Directory of the generated files (media directory of the library)")
+		("tracks,n", po::value<std::size_t>()->default_value(10000), "Number of tracks")
+		("seed,s", po::value<std::uint_fast32_t>()->default_value(0), "Seed, the same seed and track count always give the same library")
+		("no-files", "Do not create the audio files")
+		("db,d", po::value<std::string>(), "Also add the library to this database, as a scan would")
+		("features", "Add track features to the database (requires --db)")
+		("features-file", po::value<std::string>(), "Write the track features to this file, one json object per line")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help") || !vm.count("output-dir"))
+		{
+			std::cout << desc << std::endl;
+			return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		if (vm.count("features") && !vm.count("db"))
+			throw std::runtime_error {"--features requires --db"};
+
+		const std::filesystem::path outputDir {std::filesystem::absolute(vm["output-dir"].as<std::string>())};
+		const std::size_t trackCount {vm["tracks"].as<std::size_t>()};
+		const std::uint_fast32_t seed {vm["seed"].as<std::uint_fast32_t>()};
+
+		const Library library {Generator {seed}.generate(trackCount)};
+		std::cout << "Generated " << library.artists.size() << " artists, " << library.releases.size() << " releases" << std::endl;
+
+		if (!vm.count("no-files"))
+			createAudioFiles(outputDir, library);
+
+		if (vm.count("features-file"))
+		{
+			FeaturesGenerator featuresGenerator {seed, library};
+			writeFeaturesFile(vm["features-file"].as<std::string>(), library, featuresGenerator);
+		}
+
+		if (vm.count("db"))
+		{
+			// Same values as in the features file
+			std::optional<FeaturesGenerator> featuresGenerator;
+			if (vm.count("features"))
+				featuresGenerator.emplace(seed, library);
+
+			populateDatabase(vm["db"].as<std::string>(), outputDir, library, featuresGenerator ? &*featuresGenerator : nullptr);
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
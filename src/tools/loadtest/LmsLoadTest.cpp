@@ -0,0 +1,574 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <Wt/Http/Client.h>
+#include <Wt/Utils.h>
+
+#include "utils/Random.hpp"
+#include "utils/String.hpp"
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+
+	struct Settings
+	{
+		std::string					baseUrl;
+		std::string					user;
+		std::string					password;
+		std::string					clientName;
+		std::size_t					maxInFlightRequests;
+		std::chrono::seconds		timeout;
+		std::string					streamParameters;	// appended to the stream requests
+	};
+
+	// A request to be sent at a given time after the start
+	struct Request
+	{
+		Clock::duration	offset;
+		std::string		endpoint;
+		std::string		query;	// without the authentication parameters
+	};
+
+	// Binary responses are not checked for Subsonic errors
+	bool
+	isBinaryEndpoint(const std::string& endpoint)
+	{
+		return endpoint == "stream" || endpoint == "download" || endpoint == "getCoverArt";
+	}
+
+	std::string
+	createUrl(const Settings& settings, const std::string& endpoint, const std::string& query)
+	{
+		std::string url {settings.baseUrl + "/rest/" + endpoint + ".view"
+			+ "?u=" + Wt::Utils::urlEncode(settings.user)
+			+ "&p=" + Wt::Utils::urlEncode(settings.password)
+			+ "&c=" + Wt::Utils::urlEncode(settings.clientName)
+			+ "&v=1.16.1&f=json"};
+		if (!query.empty())
+			url += "&" + query;
+
+		return url;
+	}
+
+	// Synchronous GET, used to discover the library before the run
+	std::string
+	fetch(const Settings& settings, const std::string& endpoint, const std::string& query)
+	{
+		boost::asio::io_service ioService;
+		Wt::Http::Client client {ioService};
+		client.setTimeout(settings.timeout);
+		client.setMaximumResponseSize(256 * 1024 * 1024);
+
+		std::optional<std::string> body;
+		std::string error;
+		client.done().connect([&](Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
+		{
+			if (ec)
+				error = ec.message();
+			else if (msg.status() != 200)
+				error = "status = " + std::to_string(msg.status());
+			else if (msg.body().find("\"status\":\"failed\"") != std::string::npos)
+				error = "Subsonic error: " + msg.body();
+			else
+				body = msg.body();
+		});
+
+		if (!client.get(createUrl(settings, endpoint, query)))
+			throw std::runtime_error {"Cannot send request to '" + settings.baseUrl + "'"};
+
+		ioService.run();
+
+		if (!body)
+			throw std::runtime_error {"Request '" + endpoint + "' failed: " + error};
+
+		return *body;
+	}
+
+	template <typename Func>
+	void
+	forEachArrayElement(const boost::property_tree::ptree& root, const std::string& path, Func func)
+	{
+		if (const auto array {root.get_child_optional(path)})
+		{
+			for (const auto& [key, element] : *array)
+				func(element);
+		}
+	}
+
+	// Ids to pick from when generating requests
+	struct Library
+	{
+		std::vector<std::string>	artistIds;
+		std::vector<std::string>	albumIds;
+		std::vector<std::string>	coverArtIds;
+		std::vector<std::string>	songIds;
+		std::vector<std::string>	searchTerms;
+	};
+
+	Library
+	discoverLibrary(const Settings& settings)
+	{
+		Library library;
+
+		auto parse {[&](const std::string& endpoint, const std::string& query)
+		{
+			std::istringstream iss {fetch(settings, endpoint, query)};
+			boost::property_tree::ptree root;
+			boost::property_tree::read_json(iss, root);
+			return root;
+		}};
+
+		forEachArrayElement(parse("getArtists", ""), "subsonic-response.artists.index", [&](const boost::property_tree::ptree& index)
+		{
+			forEachArrayElement(index, "artist", [&](const boost::property_tree::ptree& artist)
+			{
+				library.artistIds.push_back(artist.get<std::string>("id"));
+			});
+		});
+
+		forEachArrayElement(parse("getAlbumList2", "type=random&size=500"), "subsonic-response.albumList2.album", [&](const boost::property_tree::ptree& album)
+		{
+			library.albumIds.push_back(album.get<std::string>("id"));
+			if (const auto coverArt {album.get_optional<std::string>("coverArt")})
+				library.coverArtIds.push_back(*coverArt);
+
+			for (const std::string& word : StringUtils::splitString(album.get<std::string>("name", ""), " "))
+			{
+				if (word.size() >= 3)
+					library.searchTerms.push_back(word);
+			}
+		});
+
+		forEachArrayElement(parse("getRandomSongs", "size=500"), "subsonic-response.randomSongs.song", [&](const boost::property_tree::ptree& song)
+		{
+			library.songIds.push_back(song.get<std::string>("id"));
+		});
+
+		std::cerr << "Library: " << library.artistIds.size() << " artist(s), " << library.albumIds.size() << " album(s), " << library.songIds.size() << " song(s)" << std::endl;
+
+		return library;
+	}
+
+	std::string
+	pickRandom(const std::vector<std::string>& values)
+	{
+		auto it {Random::pickRandom(values)};
+		return it != std::cend(values) ? *it : std::string {};
+	}
+
+	std::string
+	createQuery(const Settings& settings, const Library& library, const std::string& endpoint)
+	{
+		if (endpoint == "getArtist")
+			return "id=" + pickRandom(library.artistIds);
+		if (endpoint == "getAlbum")
+			return "id=" + pickRandom(library.albumIds);
+		if (endpoint == "getCoverArt")
+			return "id=" + pickRandom(library.coverArtIds) + "&size=" + std::to_string(Random::getRandom(1, 4) * 128);
+		if (endpoint == "stream" || endpoint == "download")
+			return "id=" + pickRandom(library.songIds) + (endpoint == "stream" ? settings.streamParameters : "");
+		if (endpoint == "search3")
+			return "query=" + Wt::Utils::urlEncode(pickRandom(library.searchTerms));
+		if (endpoint == "getAlbumList2" || endpoint == "getAlbumList")
+		{
+			static const std::vector<std::string> types {"random", "newest", "alphabeticalByName", "alphabeticalByArtist", "recent", "frequent"};
+			return "type=" + pickRandom(types) + "&size=50&offset=" + std::to_string(Random::getRandom(0, 4) * 50);
+		}
+		if (endpoint == "getRandomSongs")
+			return "size=50";
+
+		return "";
+	}
+
+	// Mix: comma separated endpoint=weight
+	std::vector<Request>
+	createMixRequests(const Settings& settings, const Library& library, const std::string& mix, double rps, std::chrono::seconds duration)
+	{
+		std::vector<std::string> endpoints;
+		std::vector<double> weights;
+		for (const std::string& entry : StringUtils::splitString(mix, ","))
+		{
+			const std::vector<std::string> values {StringUtils::splitString(entry, "=")};
+			const std::optional<double> weight {values.size() == 2 ? StringUtils::readAs<double>(values[1]) : std::nullopt};
+			if (!weight || *weight < 0)
+				throw std::runtime_error {"Bad mix entry '" + entry + "'"};
+
+			endpoints.push_back(values[0]);
+			weights.push_back(*weight);
+		}
+		if (endpoints.empty())
+			throw std::runtime_error {"Empty mix"};
+
+		std::discrete_distribution<std::size_t> endpointDistribution {std::cbegin(weights), std::cend(weights)};
+
+		// Evenly spaced: the load does not depend on the response times
+		std::vector<Request> requests;
+		const std::size_t requestCount {static_cast<std::size_t>(rps * duration.count())};
+		for (std::size_t i {}; i < requestCount; ++i)
+		{
+			const std::string& endpoint {endpoints[endpointDistribution(Random::getRandGenerator())]};
+			requests.push_back(Request {std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double> {i / rps}), endpoint, createQuery(settings, library, endpoint)});
+		}
+
+		return requests;
+	}
+
+	// Requests of an access log (common log format), sent at their original pace divided by speed
+	// Authentication parameters are replaced by the ones of the load test
+	std::vector<Request>
+	createReplayRequests(const std::string& accessLogPath, double speed)
+	{
+		std::ifstream file {accessLogPath};
+		if (!file)
+			throw std::runtime_error {"Cannot open '" + accessLogPath + "'"};
+
+		static const std::regex lineRegex {R"(\[([^\]]+)\] "GET [^ ]*/rest/([A-Za-z0-9]+)(?:\.view)?\??([^ ]*) HTTP)"};
+		static const std::vector<std::string> ignoredParameters {"u", "p", "t", "s", "c", "v", "f"};
+
+		std::vector<Request> requests;
+		std::optional<std::time_t> firstTime;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::smatch match;
+			if (!std::regex_search(line, match, lineRegex))
+				continue;
+
+			std::tm tm {};
+			std::istringstream timeStream {match[1].str()};
+			timeStream >> std::get_time(&tm, "%d/%b/%Y:%H:%M:%S");
+			if (timeStream.fail())
+				continue;
+
+			const std::time_t time {timegm(&tm)};
+			if (!firstTime)
+				firstTime = time;
+
+			std::vector<std::string> parameters;
+			for (const std::string& parameter : StringUtils::splitString(match[3].str(), "&"))
+			{
+				const std::string name {parameter.substr(0, parameter.find('='))};
+				if (std::find(std::cbegin(ignoredParameters), std::cend(ignoredParameters), name) == std::cend(ignoredParameters))
+					parameters.push_back(parameter);
+			}
+
+			const std::chrono::duration<double> offset {std::max<double>(0, std::difftime(time, *firstTime)) / speed};
+			requests.push_back(Request {std::chrono::duration_cast<Clock::duration>(offset), match[2].str(), StringUtils::joinStrings(parameters, "&")});
+		}
+
+		// Log lines are written when requests complete
+		std::stable_sort(std::begin(requests), std::end(requests), [](const Request& a, const Request& b) { return a.offset < b.offset; });
+
+		return requests;
+	}
+
+	struct EndpointStats
+	{
+		std::vector<std::chrono::microseconds>	latencies;	// successful requests
+		std::size_t								errorCount {};
+		std::size_t								skippedCount {};	// too many requests in flight
+		std::uint64_t							responseBytes {};
+	};
+
+	// Open loop: requests are sent on schedule, whether the previous ones are complete or not
+	class LoadGenerator
+	{
+		public:
+			LoadGenerator(const Settings& settings, std::vector<Request> requests)
+				: _settings {settings}
+				, _requests {std::move(requests)}
+			{}
+
+			void
+			run()
+			{
+				_start = Clock::now();
+				scheduleNextRequests();
+				_ioService.run();
+				_duration = Clock::now() - _start;
+			}
+
+			const std::map<std::string, EndpointStats>& getStats() const { return _stats; }
+			Clock::duration getDuration() const { return _duration; }
+
+		private:
+			void
+			scheduleNextRequests()
+			{
+				if (_nextRequest == _requests.size())
+					return;
+
+				_timer.expires_at(_start + _requests[_nextRequest].offset);
+				_timer.async_wait([this](const boost::system::error_code& ec)
+				{
+					if (ec)
+						return;
+
+					const Clock::time_point now {Clock::now()};
+					while (_nextRequest < _requests.size() && _start + _requests[_nextRequest].offset <= now)
+						sendRequest(_requests[_nextRequest++]);
+
+					scheduleNextRequests();
+				});
+			}
+
+			void
+			sendRequest(const Request& request)
+			{
+				EndpointStats& stats {_stats[request.endpoint]};
+				if (_clients.size() >= _settings.maxInFlightRequests)
+				{
+					stats.skippedCount++;
+					return;
+				}
+
+				const std::size_t clientId {_nextClientId++};
+				auto client {std::make_unique<Wt::Http::Client>(_ioService)};
+				client->setTimeout(_settings.timeout);
+				client->setMaximumResponseSize(256 * 1024 * 1024);
+
+				const Clock::time_point sendTime {Clock::now()};
+				client->done().connect([this, clientId, sendTime, &stats, endpoint = request.endpoint](Wt::AsioWrapper::error_code ec, const Wt::Http::Message& msg)
+				{
+					const bool error {ec
+						|| (msg.status() != 200 && msg.status() != 206)
+						|| (!isBinaryEndpoint(endpoint) && msg.body().find("\"status\":\"failed\"") != std::string::npos)};
+
+					if (error)
+						stats.errorCount++;
+					else
+					{
+						stats.latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sendTime));
+						stats.responseBytes += msg.body().size();
+					}
+
+					// Do not destroy the client from its own handler
+					_ioService.post([this, clientId] { _clients.erase(clientId); });
+				});
+
+				if (!client->get(createUrl(_settings, request.endpoint, request.query)))
+				{
+					stats.errorCount++;
+					return;
+				}
+
+				_clients.emplace(clientId, std::move(client));
+			}
+
+			const Settings&				_settings;
+			const std::vector<Request>	_requests;
+			std::size_t					_nextRequest {};
+
+			boost::asio::io_service		_ioService;
+			boost::asio::steady_timer	_timer {_ioService};
+			Clock::time_point			_start;
+			Clock::duration				_duration {};
+
+			std::size_t					_nextClientId {};
+			std::map<std::size_t, std::unique_ptr<Wt::Http::Client>>	_clients;	// in flight requests
+
+			std::map<std::string, EndpointStats>	_stats;	// by endpoint
+	};
+
+	double
+	getPercentileMs(const std::vector<std::chrono::microseconds>& sortedLatencies, double percentile)
+	{
+		if (sortedLatencies.empty())
+			return 0;
+
+		const std::size_t index {std::min(sortedLatencies.size() - 1, static_cast<std::size_t>(percentile * sortedLatencies.size()))};
+		return std::chrono::duration<double, std::milli> {sortedLatencies[index]}.count();
+	}
+
+	struct Thresholds
+	{
+		std::optional<double>	maxErrorRatio;
+		std::optional<double>	maxP99Ms;
+	};
+
+	// Returns false if a threshold is exceeded
+	bool
+	report(const LoadGenerator& generator, const Thresholds& thresholds)
+	{
+		const double durationSecs {std::chrono::duration<double> {generator.getDuration()}.count()};
+
+		bool success {true};
+		std::size_t totalRequestCount {};
+		std::size_t totalErrorCount {};
+
+		std::cout << std::left << std::setw(20) << "endpoint" << std::right
+			<< std::setw(9) << "requests" << std::setw(8) << "errors" << std::setw(8) << "skipped" << std::setw(8) << "rps"
+			<< std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::setw(12) << "KiB/s" << std::endl;
+
+		for (const auto& [endpoint, endpointStats] : generator.getStats())
+		{
+			std::vector<std::chrono::microseconds> latencies {endpointStats.latencies};
+			std::sort(std::begin(latencies), std::end(latencies));
+
+			const std::size_t requestCount {latencies.size() + endpointStats.errorCount + endpointStats.skippedCount};
+			const std::size_t errorCount {endpointStats.errorCount + endpointStats.skippedCount};
+			totalRequestCount += requestCount;
+			totalErrorCount += errorCount;
+
+			std::cout << std::fixed << std::setprecision(1)
+				<< std::left << std::setw(20) << endpoint << std::right
+				<< std::setw(9) << requestCount
+				<< std::setw(8) << endpointStats.errorCount
+				<< std::setw(8) << endpointStats.skippedCount
+				<< std::setw(8) << (requestCount / durationSecs)
+				<< std::setw(10) << getPercentileMs(latencies, 0.5)
+				<< std::setw(10) << getPercentileMs(latencies, 0.9)
+				<< std::setw(10) << getPercentileMs(latencies, 0.99)
+				<< std::setw(10) << getPercentileMs(latencies, 1)
+				<< std::setw(12) << (endpointStats.responseBytes / durationSecs / 1024)
+				<< std::endl;
+
+			if (thresholds.maxP99Ms && getPercentileMs(latencies, 0.99) > *thresholds.maxP99Ms)
+			{
+				std::cerr << "Endpoint '" << endpoint << "': p99 latency above " << *thresholds.maxP99Ms << " ms" << std::endl;
+				success = false;
+			}
+		}
+
+		const double errorRatio {totalRequestCount ? static_cast<double>(totalErrorCount) / totalRequestCount : 0};
+		std::cout << "Total: " << totalRequestCount << " request(s) in " << durationSecs << " s, error ratio = " << (errorRatio * 100) << "%" << std::endl;
+
+		if (thresholds.maxErrorRatio && errorRatio > *thresholds.maxErrorRatio)
+		{
+			std::cerr << "Error ratio above " << (*thresholds.maxErrorRatio * 100) << "%" << std::endl;
+			success = false;
+		}
+
+		return success;
+	}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("url", po::value<std::string>()->default_value("http://localhost:5082"), "Server URL, including the deploy path if any")
+		("user,u", po::value<std::string>()->required(), "User name")
+		("password,p", po::value<std::string>()->required(), "User password")
+		("client", po::value<std::string>()->default_value("lms-loadtest"), "Subsonic client name")
+		("rps", po::value<double>()->default_value(10), "Target number of requests per second")
+		("duration,d", po::value<unsigned>()->default_value(60), "Duration of the run, in seconds")
+		("mix", po::value<std::string>()->default_value("getAlbumList2=30,search3=20,getArtists=5,getArtist=10,getAlbum=15,getCoverArt=15,stream=5"), "Requests to send, as comma separated endpoint=weight")
+		("stream-parameters", po::value<std::string>()->default_value(""), "Parameters added to the stream requests, e.g. \"format=opus&maxBitRate=128\"")
+		("replay", po::value<std::string>(), "Access log file to be replayed instead of the mix")
+		("replay-speed", po::value<double>()->default_value(1), "Replay speed factor")
+		("max-in-flight", po::value<std::size_t>()->default_value(256), "Requests beyond this number of pending requests are skipped, and counted as errors")
+		("timeout", po::value<unsigned>()->default_value(30), "Request timeout, in seconds")
+		("max-error-ratio", po::value<double>(), "Fail if the ratio of failed and skipped requests is above this value (0 to 1)")
+		("max-p99", po::value<double>(), "Fail if the p99 latency of an endpoint is above this value, in milliseconds")
+		;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << desc << std::endl;
+			return EXIT_SUCCESS;
+		}
+		po::notify(vm);
+
+		Settings settings;
+		settings.baseUrl = StringUtils::stringTrimEnd(vm["url"].as<std::string>(), "/");
+		settings.user = vm["user"].as<std::string>();
+		settings.password = vm["password"].as<std::string>();
+		settings.clientName = vm["client"].as<std::string>();
+		settings.maxInFlightRequests = std::max<std::size_t>(1, vm["max-in-flight"].as<std::size_t>());
+		settings.timeout = std::chrono::seconds {vm["timeout"].as<unsigned>()};
+		if (const std::string streamParameters {vm["stream-parameters"].as<std::string>()}; !streamParameters.empty())
+			settings.streamParameters = "&" + streamParameters;
+
+		std::vector<Request> requests;
+		if (vm.count("replay"))
+		{
+			const double speed {vm["replay-speed"].as<double>()};
+			if (speed <= 0)
+				throw std::runtime_error {"Bad replay speed"};
+
+			requests = createReplayRequests(vm["replay"].as<std::string>(), speed);
+		}
+		else
+		{
+			const double rps {vm["rps"].as<double>()};
+			if (rps <= 0)
+				throw std::runtime_error {"Bad rps"};
+
+			const Library library {discoverLibrary(settings)};
+			requests = createMixRequests(settings, library, vm["mix"].as<std::string>(), rps, std::chrono::seconds {vm["duration"].as<unsigned>()});
+		}
+
+		std::cerr << "Sending " << requests.size() << " request(s)..." << std::endl;
+
+		LoadGenerator generator {settings, std::move(requests)};
+		generator.run();
+
+		Thresholds thresholds;
+		if (vm.count("max-error-ratio"))
+			thresholds.maxErrorRatio = vm["max-error-ratio"].as<double>();
+		if (vm.count("max-p99"))
+			thresholds.maxP99Ms = vm["max-p99"].as<double>();
+
+		if (!report(generator, thresholds))
+			return EXIT_FAILURE;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
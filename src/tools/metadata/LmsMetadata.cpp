@@ -17,17 +17,27 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
 #include <optional>
 #include <stdexcept>
 #include <stdlib.h>
 #include <iostream>
+#include <thread>
+#include <unordered_set>
 
+#include <boost/program_options.hpp>
 #include <Wt/WDate.h>
 
 #include "metadata/AvFormatParser.hpp"
 #include "metadata/TagLibParser.hpp"
+#include "utils/Path.hpp"
 #include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
 
 std::ostream& operator<<(std::ostream& os, const MetaData::Artist& artist)
 {
@@ -163,22 +173,200 @@ void parse(MetaData::IParser& parser, const std::filesystem::path& file)
 	std::cout << std::endl;
 }
 
-int main(int argc, char *argv[])
+std::unique_ptr<MetaData::IParser>
+createParser(const std::string& parserName)
+{
+	if (parserName == "taglib")
+		return std::make_unique<MetaData::TagLibParser>();
+	if (parserName == "av")
+		return std::make_unique<MetaData::AvFormatParser>();
+
+	throw std::runtime_error {"Unknown parser '" + parserName + "'"};
+}
+
+// Peak and current resident set sizes, in kB
+std::string
+getMemoryUsage()
 {
-	if (argc == 1)
+	std::string res;
+
+	std::ifstream ifs {"/proc/self/status"};
+	std::string line;
+	while (std::getline(ifs, line))
 	{
-		std::cerr << "Usage: <file> [<file> ...]" << std::endl;
-		return EXIT_FAILURE;
+		if (line.rfind("VmHWM:", 0) == 0 || line.rfind("VmRSS:", 0) == 0)
+			res += (res.empty() ? "" : ", ") + StringUtils::stringTrim(line.substr(0, 6)) + " " + StringUtils::stringTrim(line.substr(6));
+	}
+
+	return res;
+}
+
+struct ParseDurations
+{
+	std::vector<std::chrono::microseconds>	durations;
+	std::size_t								failures {};
+};
+
+void
+printDurations(const std::string& name, ParseDurations& parseDurations)
+{
+	std::vector<std::chrono::microseconds>& durations {parseDurations.durations};
+	if (durations.empty())
+		return;
+
+	std::sort(std::begin(durations), std::end(durations));
+
+	auto percentile {[&](std::size_t p) { return durations[(durations.size() - 1) * p / 100].count() / 1000.; }};
+
+	std::chrono::microseconds total {};
+	for (std::chrono::microseconds duration : durations)
+		total += duration;
+
+	std::cout << std::left << std::setw(8) << name << std::right
+		<< " files = " << std::setw(7) << durations.size()
+		<< ", failures = " << std::setw(5) << parseDurations.failures
+		<< ", mean = " << std::setw(8) << total.count() / 1000. / durations.size() << "ms"
+		<< ", p50 = " << std::setw(8) << percentile(50) << "ms"
+		<< ", p99 = " << std::setw(8) << percentile(99) << "ms"
+		<< ", max = " << std::setw(8) << durations.back().count() / 1000. << "ms" << std::endl;
+}
+
+// Parse all the files of a directory using several threads, and report the parsing throughput
+void
+benchmark(const std::filesystem::path& directory, const std::string& parserName, std::size_t threadCount, const std::unordered_set<std::filesystem::path>& extensions)
+{
+	std::cout << "Exploring '" << directory.string() << "'..." << std::endl;
+
+	std::vector<std::filesystem::path> files;
+	exploreFilesRecursive(directory, [&](std::error_code ec, const std::filesystem::path& path)
+	{
+		if (!ec && extensions.find(path.extension()) != std::cend(extensions))
+			files.push_back(path);
+
+		return true;
+	});
+
+	// Create the parser first to report errors early
+	createParser(parserName);
+
+	std::cout << "Parsing " << files.size() << " files using parser '" << parserName << "' and " << threadCount << " thread(s)..." << std::endl;
+
+	struct Result
+	{
+		std::chrono::microseconds	duration;
+		bool						success;
+	};
+	std::vector<Result> results(files.size());
+
+	std::atomic<std::size_t> nextFileIndex {};
+	auto worker {[&]
+	{
+		const std::unique_ptr<MetaData::IParser> parser {createParser(parserName)};
+		parser->setClusterTypeNames( {"ALBUMMOOD", "MOOD", "ALBUMGROUPING", "ALBUMGENRE", "GENRE"} );
+
+		for (std::size_t fileIndex {nextFileIndex++}; fileIndex < files.size(); fileIndex = nextFileIndex++)
+		{
+			const auto start {std::chrono::steady_clock::now()};
+			bool success {};
+			try
+			{
+				success = parser->parse(files[fileIndex]).has_value();
+			}
+			catch (std::exception& e)
+			{
+				std::cerr << "Caught exception while parsing '" << files[fileIndex].string() << "': " << e.what() << std::endl;
+			}
+			const auto end {std::chrono::steady_clock::now()};
+
+			results[fileIndex] = Result {std::chrono::duration_cast<std::chrono::microseconds>(end - start), success};
+		}
+	}};
+
+	const auto start {std::chrono::steady_clock::now()};
+	{
+		std::vector<std::thread> threads;
+		for (std::size_t i {}; i < threadCount; ++i)
+			threads.emplace_back(worker);
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+	const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+	ParseDurations allDurations;
+	std::map<std::string, ParseDurations> durationsByExtension;
+	for (std::size_t i {}; i < files.size(); ++i)
+	{
+		ParseDurations& extensionDurations {durationsByExtension[files[i].extension().string()]};
+
+		allDurations.durations.push_back(results[i].duration);
+		extensionDurations.durations.push_back(results[i].duration);
+		if (!results[i].success)
+		{
+			allDurations.failures++;
+			extensionDurations.failures++;
+		}
 	}
 
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Elapsed: " << elapsed.count() << "s, " << (elapsed.count() > 0 ? files.size() / elapsed.count() : 0) << " files/s" << std::endl;
+	std::cout << "Memory: " << getMemoryUsage() << std::endl;
+	printDurations("all", allDurations);
+	for (auto& [extension, durations] : durationsByExtension)
+		printDurations(extension, durations);
+}
+
+int main(int argc, char *argv[])
+{
 	try
 	{
+		namespace po = boost::program_options;
+
+		po::options_description desc{"Allowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("bench,b", po::value<std::string>(), "Benchmark the parsing of all the files in this directory")
+		("parsers,p", po::value<std::string>()->default_value("taglib"), "Comma separated parsers to benchmark (taglib, av)")
+		("threads,t", po::value<std::size_t>()->default_value(std::max<std::size_t>(1, std::thread::hardware_concurrency())), "Thread count used to benchmark")
+		("extensions,e", po::value<std::string>()->default_value(".alac .mp3 .ogg .oga .aac .m4a .m4b .flac .wav .wma .aif .aiff .ape .mpc .shn .opus"), "Extensions of the files to benchmark")
+		("file", po::value<std::vector<std::string>>(), "Files to parse and dump")
+		;
+
+		po::positional_options_description positional;
+		positional.add("file", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+		if (vm.count("help") || (!vm.count("file") && !vm.count("bench")))
+		{
+			std::cout << "Usage: " << argv[0] << " <file> [<file> ...]" << std::endl;
+			std::cout << "       " << argv[0] << " --bench <directory> [--parsers <parsers>] [--threads <count>]" << std::endl;
+			std::cout << desc << std::endl;
+			return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		if (vm.count("bench"))
+		{
+			const std::size_t threadCount {std::max<std::size_t>(1, vm["threads"].as<std::size_t>())};
+
+			std::unordered_set<std::filesystem::path> extensions;
+			for (const std::string& extension : StringUtils::splitString(vm["extensions"].as<std::string>(), " "))
+				extensions.emplace(extension);
+
+			// No logger: the parsers would flood the output
+			for (const std::string& parserName : StringUtils::splitString(vm["parsers"].as<std::string>(), ","))
+				benchmark(vm["bench"].as<std::string>(), parserName, threadCount, extensions);
+
+			return EXIT_SUCCESS;
+		}
+
 		// log to stdout
 		Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
 
-		for (std::size_t  i {}; i < static_cast<std::size_t>(argc - 1); ++i)
+		for (const std::string& fileName : vm["file"].as<std::vector<std::string>>())
 		{
-			std::filesystem::path file {argv[i + 1]};
+			std::filesystem::path file {fileName};
 
 			std::cout << "Parsing file '" << file << "'" << std::endl;
 
@@ -17,10 +17,19 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <random>
 #include <stdexcept>
 #include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -28,11 +37,15 @@
 #include "database/Cluster.hpp"
 #include "database/Db.hpp"
 #include "database/Release.hpp"
+#include "database/ScanSettings.hpp"
 #include "database/Session.hpp"
 #include "database/Track.hpp"
+#include "database/TrackList.hpp"
 #include "utils/IConfig.hpp"
+#include "utils/Scheduler.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
 #include "recommendation/IEngine.hpp"
 
 static
@@ -46,6 +59,7 @@ dumpTracksRecommendation(Database::Session session, Recommendation::IEngine& eng
 		}()};
 
 	std::cout << "*** Tracks (" << trackIds.size() << ") ***" << std::endl;
+	Recommendation::IEngine::RankedResults similarTracks;
 	for (Database::IdType trackId : trackIds)
 	{
 		auto trackToString = [&](Database::IdType trackId)
@@ -66,8 +80,9 @@ dumpTracksRecommendation(Database::Session session, Recommendation::IEngine& eng
 		};
 
 		std::cout << "Processing track '" << trackToString(trackId) << std::endl;
-		for (Database::IdType similarTrackId : engine.getSimilarTracks(session, {trackId}, maxSimilarityCount))
-			std::cout << "\t- Similar track '" << trackToString(similarTrackId) << std::endl;
+		engine.getRankedSimilarTracks(session, {trackId}, maxSimilarityCount, similarTracks);
+		for (const Recommendation::IEngine::ScoredId& similarTrack : similarTracks)
+			std::cout << "\t- Similar track '" << trackToString(similarTrack.id) << " (" << similarTrack.score << ")" << std::endl;
 	}
 }
 
@@ -82,6 +97,7 @@ dumpReleasesRecommendation(Database::Session session, Recommendation::IEngine& e
 			});
 
 	std::cout << "*** Releases ***" << std::endl;
+	Recommendation::IEngine::RankedResults similarReleases;
 	for (Database::IdType releaseId : releaseIds)
 	{
 		auto releaseToString = [&](Database::IdType releaseId)
@@ -93,8 +109,9 @@ dumpReleasesRecommendation(Database::Session session, Recommendation::IEngine& e
 		};
 
 		std::cout << "Processing release '" << releaseToString(releaseId) << "'" << std::endl;
-		for (Database::IdType similarReleaseId : engine.getSimilarReleases(session, releaseId, maxSimilarityCount))
-			std::cout << "\t- Similar release '" << releaseToString(similarReleaseId) << "'" << std::endl;
+		engine.getRankedSimilarReleases(session, releaseId, maxSimilarityCount, similarReleases);
+		for (const Recommendation::IEngine::ScoredId& similarRelease : similarReleases)
+			std::cout << "\t- Similar release '" << releaseToString(similarRelease.id) << "' (" << similarRelease.score << ")" << std::endl;
 	}
 }
 
@@ -109,6 +126,7 @@ dumpArtistsRecommendation(Database::Session session, Recommendation::IEngine& en
 			});
 
 	std::cout << "*** Artists ***" << std::endl;
+	Recommendation::IEngine::RankedResults similarArtists;
 	for (Database::IdType artistId : artistIds)
 	{
 		auto artistToString = [&](Database::IdType artistId)
@@ -120,13 +138,157 @@ dumpArtistsRecommendation(Database::Session session, Recommendation::IEngine& en
 		};
 
 		std::cout << "Processing artist '" << artistToString(artistId) << "'" << std::endl;
-		for (Database::IdType similarArtistId : engine.getSimilarArtists(session, artistId, {Database::TrackArtistLinkType::Artist, Database::TrackArtistLinkType::ReleaseArtist}, maxSimilarityCount))
+		engine.getRankedSimilarArtists(session, artistId, {Database::TrackArtistLinkType::Artist, Database::TrackArtistLinkType::ReleaseArtist}, maxSimilarityCount, similarArtists);
+		for (const Recommendation::IEngine::ScoredId& similarArtist : similarArtists)
 		{
-			std::cout << "\t- Similar artist '" << artistToString(similarArtistId) << "'" << std::endl;
+			std::cout << "\t- Similar artist '" << artistToString(similarArtist.id) << "' (" << similarArtist.score << ")" << std::endl;
 		}
 	}
 }
 
+// Peak and current resident set sizes, in kB
+static
+std::string
+getMemoryUsage()
+{
+	std::string res;
+
+	std::ifstream ifs {"/proc/self/status"};
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		if (line.rfind("VmHWM:", 0) == 0 || line.rfind("VmRSS:", 0) == 0)
+			res += (res.empty() ? "" : ", ") + StringUtils::stringTrim(line.substr(0, 6)) + " " + StringUtils::stringTrim(line.substr(6));
+	}
+
+	return res;
+}
+
+static
+void
+printDurations(const std::string& name, std::vector<std::chrono::microseconds>& durations, std::chrono::duration<double> elapsed)
+{
+	if (durations.empty())
+		return;
+
+	std::sort(std::begin(durations), std::end(durations));
+
+	auto percentile {[&](std::size_t p) { return durations[(durations.size() - 1) * p / 100].count() / 1000.; }};
+
+	std::chrono::microseconds total {};
+	for (std::chrono::microseconds duration : durations)
+		total += duration;
+
+	std::cout << std::left << std::setw(10) << name << std::right
+		<< " queries = " << std::setw(8) << durations.size()
+		<< ", " << std::setw(9) << durations.size() / elapsed.count() << " queries/s"
+		<< ", mean = " << std::setw(8) << total.count() / 1000. / durations.size() << "ms"
+		<< ", p50 = " << std::setw(8) << percentile(50) << "ms"
+		<< ", p99 = " << std::setw(8) << percentile(99) << "ms"
+		<< ", max = " << std::setw(8) << durations.back().count() / 1000. << "ms" << std::endl;
+}
+
+// Runs random similarity queries from several threads, and reports the latencies by query type
+// Queries go through the engine, so they are answered by the classifiers that have the priority and use the result cache, as in the server
+static
+void
+benchmark(Database::Db& db, Recommendation::IEngine& engine, unsigned maxSimilarityCount, std::chrono::seconds duration, std::size_t threadCount)
+{
+	enum QueryType : std::size_t
+	{
+		Tracks,
+		Releases,
+		Artists,
+		TrackLists,
+		QueryTypeCount,
+	};
+	const std::array<std::string, QueryTypeCount> queryTypeNames {"tracks", "releases", "artists", "tracklist"};
+
+	std::array<std::vector<Database::IdType>, QueryTypeCount> ids;
+	{
+		Database::Session& session {db.getTLSSession()};
+		auto transaction {session.createSharedTransaction()};
+
+		ids[Tracks] = Database::Track::getAllIds(session);
+		ids[Releases] = Database::Release::getAllIds(session);
+		ids[Artists] = Database::Artist::getAllIds(session);
+		for (const Database::TrackList::pointer& trackList : Database::TrackList::getAll(session))
+			ids[TrackLists].push_back(trackList.id());
+	}
+
+	std::cout << "Running queries for " << duration.count() << "s using " << threadCount << " thread(s), on "
+		<< ids[Tracks].size() << " tracks, " << ids[Releases].size() << " releases, " << ids[Artists].size() << " artists and " << ids[TrackLists].size() << " tracklists..." << std::endl;
+
+	// Durations by thread, then by query type
+	std::vector<std::array<std::vector<std::chrono::microseconds>, QueryTypeCount>> threadDurations(threadCount);
+
+	const auto start {std::chrono::steady_clock::now()};
+	const auto end {start + duration};
+	{
+		std::vector<std::thread> threads;
+		for (std::size_t threadIndex {}; threadIndex < threadCount; ++threadIndex)
+		{
+			threads.emplace_back([&, threadIndex]
+			{
+				Database::Session& session {db.getTLSSession()};
+				std::mt19937 generator {static_cast<std::mt19937::result_type>(threadIndex)};
+				Recommendation::IEngine::RankedResults results;
+
+				for (std::size_t queryIndex {threadIndex}; std::chrono::steady_clock::now() < end; ++queryIndex)
+				{
+					const QueryType queryType {static_cast<QueryType>(queryIndex % QueryTypeCount)};
+					const std::vector<Database::IdType>& queryTypeIds {ids[queryType]};
+					if (queryTypeIds.empty())
+						continue;
+
+					const Database::IdType id {queryTypeIds[std::uniform_int_distribution<std::size_t> {0, queryTypeIds.size() - 1}(generator)]};
+
+					const auto queryStart {std::chrono::steady_clock::now()};
+					switch (queryType)
+					{
+						case Tracks:
+							engine.getRankedSimilarTracks(session, {id}, maxSimilarityCount, results);
+							break;
+						case Releases:
+							engine.getRankedSimilarReleases(session, id, maxSimilarityCount, results);
+							break;
+						case Artists:
+							engine.getRankedSimilarArtists(session, id, {Database::TrackArtistLinkType::Artist, Database::TrackArtistLinkType::ReleaseArtist}, maxSimilarityCount, results);
+							break;
+						case TrackLists:
+							engine.getRankedSimilarTracksFromTrackList(session, id, maxSimilarityCount, results);
+							break;
+						case QueryTypeCount:
+							break;
+					}
+					threadDurations[threadIndex][queryType].push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - queryStart));
+				}
+			});
+		}
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+	const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+	std::vector<std::chrono::microseconds> allDurations;
+	std::array<std::vector<std::chrono::microseconds>, QueryTypeCount> durationsByQueryType;
+	for (const auto& durations : threadDurations)
+	{
+		for (std::size_t queryType {}; queryType < QueryTypeCount; ++queryType)
+		{
+			durationsByQueryType[queryType].insert(std::end(durationsByQueryType[queryType]), std::cbegin(durations[queryType]), std::cend(durations[queryType]));
+			allDurations.insert(std::end(allDurations), std::cbegin(durations[queryType]), std::cend(durations[queryType]));
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Elapsed: " << elapsed.count() << "s" << std::endl;
+	std::cout << "Memory: " << getMemoryUsage() << std::endl;
+	printDurations("all", allDurations, elapsed);
+	for (std::size_t queryType {}; queryType < QueryTypeCount; ++queryType)
+		printDurations(queryTypeNames[queryType], durationsByQueryType[queryType], elapsed);
+}
 
 int main(int argc, char *argv[])
 {
@@ -145,6 +307,8 @@ int main(int argc, char *argv[])
         ("releases,r", "Display recommendation for releases")
         ("tracks,t", "Display recommendation for tracks")
 		("max,m", po::value<unsigned>()->default_value(3), "Max similarity result count")
+		("bench,b", po::value<unsigned>(), "Benchmark: run random similarity queries for this duration, in seconds")
+		("threads", po::value<std::size_t>()->default_value(std::max<std::size_t>(1, std::thread::hardware_concurrency())), "Thread count used to benchmark")
         ;
 
         po::variables_map vm;
@@ -157,20 +321,38 @@ int main(int argc, char *argv[])
         }
 
 		Service<IConfig> config {createConfig(vm["conf"].as<std::string>())};
+		// Same threads and database settings as the server
+		Service<Scheduler> scheduler {std::make_unique<Scheduler>(config->getULong("background-cpu-thread-count", 0), config->getULong("background-io-thread-count", 0))};
 
-		Database::Db db {config->getPath("working-dir") / "lms.db"};
+		const std::size_t threadCount {std::max<std::size_t>(1, vm["threads"].as<std::size_t>())};
+		Database::Db db {config->getPath("working-dir") / "lms.db",
+			std::max<std::size_t>(10, threadCount),
+			config->getBool("db-concurrent-reads", true) ? Database::Db::ConcurrencyMode::ConcurrentReads : Database::Db::ConcurrencyMode::Exclusive};
 		Database::Session session {db};
 
+		{
+			auto transaction {session.createSharedTransaction()};
+			const bool featuresEngine {Database::ScanSettings::get(session)->getRecommendationEngineType() == Database::ScanSettings::RecommendationEngineType::Features};
+			std::cout << "Recommendation engine type: " << (featuresEngine ? "features (" + config->getString("recommendation-features-algorithm", "som") + "), clusters as fallback" : "clusters") << std::endl;
+		}
+
 		std::cout << "Creating recommendation engine..." << std::endl;
 		const auto engine {Recommendation::createEngine(db)};
 		std::cout << "Recommendation engine created!" << std::endl;
 
 		std::cout << "Loading recommendation engine..." << std::endl;
+		std::cout << "Memory: " << getMemoryUsage() << std::endl;
+		const auto loadStart {std::chrono::steady_clock::now()};
 		engine->load(false);
+		const std::chrono::duration<double> loadDuration {std::chrono::steady_clock::now() - loadStart};
 
 		unsigned maxSimilarityCount {vm["max"].as<unsigned>()};
 
-		std::cout << "Recommendation engine loaded!" << std::endl;
+		std::cout << "Recommendation engine loaded in " << loadDuration.count() << "s!" << std::endl;
+		std::cout << "Memory: " << getMemoryUsage() << std::endl;
+
+		if (vm.count("bench"))
+			benchmark(db, *engine, maxSimilarityCount, std::chrono::seconds {vm["bench"].as<unsigned>()}, threadCount);
 
 		if (vm.count("tracks"))
 			dumpTracksRecommendation(db, *engine, maxSimilarityCount);
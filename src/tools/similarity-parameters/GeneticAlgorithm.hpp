@@ -18,10 +18,11 @@
  */
 
 #include <numeric>
+#include <optional>
 
 #include "utils/Random.hpp"
 
-#include "ParallelFor.hpp"
+#include "ThreadPool.hpp"
 
 template<typename Individual>
 class GeneticAlgorithm
@@ -31,7 +32,8 @@ class GeneticAlgorithm
 
 		using BreedFunction = std::function<Individual(const Individual&, const Individual&)>;
 		using MutateFunction = std::function<void(Individual&)>;
-		using ScoreFunction = std::function<Score(const Individual&)>;
+		// If minScore is set, the evaluation may be stopped early and return an estimated score that is below minScore
+		using ScoreFunction = std::function<Score(const Individual&, std::optional<Score> minScore)>;
 
 		struct Params
 		{
@@ -42,6 +44,7 @@ class GeneticAlgorithm
 			BreedFunction	breedFunction;
 			MutateFunction		mutateFunction;
 			ScoreFunction		scoreFunction;
+			std::optional<float>	earlyStoppingRatio;	// children whose score is clearly below this ratio of the worst kept individual score are not fully evaluated
 		};
 
 		GeneticAlgorithm(const Params& params);
@@ -57,16 +60,18 @@ class GeneticAlgorithm
 			std::optional<Score> score {};
 		};
 
-		void scoreAndSortPopulation(std::vector<ScoredIndividual>& population);
+		void scoreAndSortPopulation(std::vector<ScoredIndividual>& population, std::optional<Score> minScore);
 		Score getTotalScore(const std::vector<ScoredIndividual>& population) const;
 		typename std::vector<ScoredIndividual>::const_iterator pickRandomRouletteWheel(const std::vector<ScoredIndividual>& population, Score totalScore);
 
-		Params _params;
+		Params		_params;
+		ThreadPool	_threadPool;
 };
 
 template<typename Individual>
 GeneticAlgorithm<Individual>::GeneticAlgorithm(const Params& params)
 : _params {params}
+, _threadPool {params.nbWorkers}
 {
 }
 
@@ -85,7 +90,7 @@ GeneticAlgorithm<Individual>::simulate(const std::vector<Individual>& initialPop
 	std::transform(std::cbegin(initialPopulation), std::cend(initialPopulation), std::back_inserter(scoredPopulation ),
 			[](const Individual& individual) { return ScoredIndividual {individual};});
 
-	scoreAndSortPopulation(scoredPopulation);
+	scoreAndSortPopulation(scoredPopulation, std::nullopt);
 
 	for (std::size_t currentGeneration {}; currentGeneration  < _params.nbGenerations; ++currentGeneration)
 	{
@@ -118,10 +123,14 @@ GeneticAlgorithm<Individual>::simulate(const std::vector<Individual>& initialPop
 		// Elitist selection
 		scoredPopulation.resize(initialPopulation.size() - childrenCountPerGeneration);
 
+		std::optional<Score> minScore;
+		if (_params.earlyStoppingRatio && !scoredPopulation.empty())
+			minScore = *scoredPopulation.back().score * *_params.earlyStoppingRatio;
+
 		scoredPopulation.insert(std::end(scoredPopulation), std::make_move_iterator(std::begin(children)), std::make_move_iterator(std::end(children)));
 		assert(scoredPopulation.size() == initialPopulation.size());
 
-		scoreAndSortPopulation(scoredPopulation);
+		scoreAndSortPopulation(scoredPopulation, minScore);
 
 		std::cout << "Mean score = " << getTotalScore(scoredPopulation) / scoredPopulation.size() << std::endl;
 		std::cout << "Current best score = " << *scoredPopulation.front().score << std::endl;
@@ -134,13 +143,13 @@ GeneticAlgorithm<Individual>::simulate(const std::vector<Individual>& initialPop
 
 template<typename Individual>
 void
-GeneticAlgorithm<Individual>::scoreAndSortPopulation(std::vector<ScoredIndividual>& scoredPopulation)
+GeneticAlgorithm<Individual>::scoreAndSortPopulation(std::vector<ScoredIndividual>& scoredPopulation, std::optional<Score> minScore)
 {
-	parallel_foreach(_params.nbWorkers, std::begin(scoredPopulation), std::end(scoredPopulation),
+	parallel_foreach(_threadPool, std::begin(scoredPopulation), std::end(scoredPopulation),
 			[&](ScoredIndividual& scoredIndividual)
 			{
 				if (!scoredIndividual.score)
-					scoredIndividual.score = _params.scoreFunction(scoredIndividual.individual);
+					scoredIndividual.score = _params.scoreFunction(scoredIndividual.individual, minScore);
 			});
 
 	std::sort(std::begin(scoredPopulation), std::end(scoredPopulation), [](const ScoredIndividual& a, const ScoredIndividual& b) { return a.score > b.score; });
@@ -17,8 +17,11 @@
  * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
 
 #include "database/Artist.hpp"
@@ -160,11 +163,13 @@ const FeatureSettingsMap featuresSettings
 	{ "lowlevel.zerocrossingrate.var",		{1}},
 };
 
+using FeaturesCache = std::unordered_map<Database::IdType, FeatureValuesMap>;
+
 static
-std::unordered_map<Database::IdType, FeatureValuesMap>
+FeaturesCache
 constructFeaturesCache(Database::Session& session, const FeatureSettingsMap& featureSettings)
 {
-	std::unordered_map<Database::IdType, FeatureValuesMap> cache;
+	FeaturesCache cache;
 
 	std::unordered_set<FeatureName> names;
 	std::transform(std::cbegin(featureSettings), std::cend(featureSettings), std::inserter(names, std::begin(names)),
@@ -185,7 +190,7 @@ constructFeaturesCache(Database::Session& session, const FeatureSettingsMap& fea
 
 static
 std::optional<FeatureValuesMap>
-getFeaturesFromCache(const std::unordered_map<Database::IdType, FeatureValuesMap>& cache, Database::IdType trackId, const FeatureNames& names)
+getFeaturesFromCache(const FeaturesCache& cache, Database::IdType trackId, const FeatureNames& names)
 {
 	std::optional<FeatureValuesMap> res;
 
@@ -284,7 +289,7 @@ computeTrackScore(Database::Session& session, Database::IdType track1Id, Databas
 
 static
 SimilarityScore
-computeSimilarityScore(Database::Session& session, FeaturesSearcher::TrainSettings trainSettings)
+computeSimilarityScore(Database::Session& session, FeaturesSearcher::TrainSettings trainSettings, std::optional<SimilarityScore> minScore)
 {
 	std::cout << "Compute score of: ";
 	printFeatureSettingsMap(trainSettings.featureSettingsMap);
@@ -298,9 +303,25 @@ computeSimilarityScore(Database::Session& session, FeaturesSearcher::TrainSettin
 				return Database::Track::getAllIdsWithFeatures(session);
 			});
 
+	// Once enough tracks have been processed, stop if the extrapolated score cannot reasonably reach minScore
+	constexpr std::size_t earlyStoppingCheckCount {10};
+	const std::size_t earlyStoppingCheckInterval {std::max<std::size_t>(trackIds.size() / earlyStoppingCheckCount, 1)};
+
 	SimilarityScore score {};
-	for (Database::IdType trackId : trackIds)
+	for (std::size_t trackIndex {}; trackIndex < trackIds.size(); ++trackIndex)
 	{
+		const Database::IdType trackId {trackIds[trackIndex]};
+
+		if (minScore && trackIndex >= trackIds.size() / 4 && trackIndex % earlyStoppingCheckInterval == 0)
+		{
+			const SimilarityScore extrapolatedScore {score * trackIds.size() / trackIndex};
+			if (extrapolatedScore < *minScore)
+			{
+				std::cout << "Early stop after " << trackIndex << "/" << trackIds.size() << " tracks, estimated score = " << extrapolatedScore << std::endl;
+				return extrapolatedScore;
+			}
+		}
+
 		constexpr std::size_t nbSimilarTracks {3};
 //		std::cout << "Processing track '" << trackToString(session, trackId) << "'" << std::endl;
 		SimilarityScore factor {1};		
@@ -404,13 +425,14 @@ int main(int argc, char *argv[])
 
 		std::cout << "Caching all features..." << std::endl;
 		// Cache all the features of all the music in order to speed up the multiple trainings
-		const auto cachedFeatures { constructFeaturesCache(Database::SessionPool::ScopedSession {sessionPool}.get(), featuresSettings) };
+		// The cache is immutable once built, so that all the concurrent trainings can read it without locking
+		std::shared_ptr<const FeaturesCache> cachedFeatures {std::make_shared<const FeaturesCache>(constructFeaturesCache(Database::SessionPool::ScopedSession {sessionPool}.get(), featuresSettings))};
 		std::cout << "Caching all features DONE" << std::endl;
 
 		FeaturesSearcher::setFeaturesFetchFunc(
-				[&](Database::IdType trackId, const FeatureNames& featureNames)
+				[cachedFeatures](Database::IdType trackId, const FeatureNames& featureNames)
 				{
-					return getFeaturesFromCache(cachedFeatures, trackId, featureNames);
+					return getFeaturesFromCache(*cachedFeatures, trackId, featureNames);
 				});
 
 		// Create some random settings (i.e random population)
@@ -443,14 +465,15 @@ int main(int argc, char *argv[])
 		params.mutationProbability = 0.2;
 		params.breedFunction = breedFeatureSettingsMap;
 		params.mutateFunction = mutateFeatureSettingsMap;
+		params.earlyStoppingRatio = 0.5;
 		params.scoreFunction =
-			[&](const FeatureSettingsMap& featureSettings)
+			[&](const FeatureSettingsMap& featureSettings, std::optional<SimilarityScore> minScore)
 			{
 				FeaturesSearcher::TrainSettings settings {trainSettings};
 				settings.featureSettingsMap = featureSettings;
 
 				Database::SessionPool::ScopedSession scopedSession {sessionPool};
-				return computeSimilarityScore(scopedSession.get(), settings);
+				return computeSimilarityScore(scopedSession.get(), settings, minScore);
 			};
 
 		GeneticAlgorithm<FeatureSettingsMap> geneticAlgorithm {params};
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2026 Emeric Poupon
+ *
+ * This file is part of LMS.
+ *
+ * LMS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LMS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LMS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed size pool of threads, each of them owning its own task queue
+// Idle workers steal tasks from the back of the other queues
+class ThreadPool
+{
+	public:
+		using Task = std::function<void()>;
+
+		ThreadPool(std::size_t workerCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		std::size_t getWorkerCount() const { return _workers.size(); }
+
+		void post(Task task);
+
+		// Waits for all the posted tasks to complete
+		// Rethrows the first exception thrown by a task, if any
+		void wait();
+
+	private:
+		struct Queue
+		{
+			std::mutex			mutex;
+			std::deque<Task>	tasks;
+		};
+
+		bool popTask(std::size_t workerIndex, Task& task);
+		void workerLoop(std::size_t workerIndex);
+
+		std::vector<std::unique_ptr<Queue>>	_queues;
+		std::vector<std::thread>			_workers;
+
+		std::mutex				_mutex;
+		std::condition_variable	_tasksCondition;	// signaled when a task is posted or on quit
+		std::condition_variable	_doneCondition;		// signaled when all the tasks are done
+		bool					_quit {};
+		std::size_t				_queuedTaskCount {};	// posted and not started yet
+		std::size_t				_pendingTaskCount {};	// posted and not completed yet
+		std::size_t				_nextQueueIndex {};
+		std::exception_ptr		_exception;
+};
+
+inline
+ThreadPool::ThreadPool(std::size_t workerCount)
+{
+	if (workerCount == 0)
+		throw std::runtime_error("Invalid worker count");
+
+	for (std::size_t i {}; i < workerCount; ++i)
+		_queues.emplace_back(std::make_unique<Queue>());
+
+	for (std::size_t i {}; i < workerCount; ++i)
+		_workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+inline
+ThreadPool::~ThreadPool()
+{
+	{
+		std::scoped_lock lock {_mutex};
+		_quit = true;
+	}
+	_tasksCondition.notify_all();
+
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+inline
+void
+ThreadPool::post(Task task)
+{
+	std::size_t queueIndex;
+	{
+		std::scoped_lock lock {_mutex};
+		queueIndex = _nextQueueIndex++ % _queues.size();
+		_queuedTaskCount++;
+		_pendingTaskCount++;
+	}
+
+	{
+		Queue& queue {*_queues[queueIndex]};
+		std::scoped_lock lock {queue.mutex};
+		queue.tasks.push_back(std::move(task));
+	}
+
+	_tasksCondition.notify_all();
+}
+
+inline
+void
+ThreadPool::wait()
+{
+	std::unique_lock lock {_mutex};
+	_doneCondition.wait(lock, [&] { return _pendingTaskCount == 0; });
+
+	if (_exception)
+		std::rethrow_exception(std::exchange(_exception, nullptr));
+}
+
+inline
+bool
+ThreadPool::popTask(std::size_t workerIndex, Task& task)
+{
+	// Own queue first, oldest tasks first
+	{
+		Queue& queue {*_queues[workerIndex]};
+		std::scoped_lock lock {queue.mutex};
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Then steal from the others, newest tasks first
+	for (std::size_t i {1}; i < _queues.size(); ++i)
+	{
+		Queue& queue {*_queues[(workerIndex + i) % _queues.size()]};
+		std::scoped_lock lock {queue.mutex};
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+inline
+void
+ThreadPool::workerLoop(std::size_t workerIndex)
+{
+	while (true)
+	{
+		Task task;
+		if (!popTask(workerIndex, task))
+		{
+			std::unique_lock lock {_mutex};
+
+			// The queued count is incremented before the task is actually pushed
+			_tasksCondition.wait(lock, [&] { return _quit || _queuedTaskCount > 0; });
+			if (_quit)
+				return;
+
+			lock.unlock();
+			if (!popTask(workerIndex, task))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+		}
+
+		{
+			std::scoped_lock lock {_mutex};
+			_queuedTaskCount--;
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		bool done {};
+		{
+			std::scoped_lock lock {_mutex};
+			if (exception && !_exception)
+				_exception = exception;
+
+			done = (--_pendingTaskCount == 0);
+		}
+
+		if (done)
+			_doneCondition.notify_all();
+	}
+}
+
+// Calls func on each element, using the pool workers, and waits for all the calls to complete
+template <typename It, typename Func>
+void parallel_foreach(ThreadPool& pool, It begin, It end, Func&& func)
+{
+	for (It it {begin}; it != end; ++it)
+	{
+		auto& value {*it};
+		pool.post([&value, &func] { func(value); });
+	}
+
+	pool.wait();
+}
+
@@ -19,71 +19,264 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <vector>
 
+#include <boost/program_options.hpp>
+
+#include "utils/Crc32Calculator.hpp"
 #include "utils/Service.hpp"
 #include "utils/StreamLogger.hpp"
+#include "utils/String.hpp"
 #include "utils/Zipper.hpp"
 
-int main(int argc, char* argv[])
+// Directories are explored recursively
+static
+std::map<std::string, Zip::FileEntry>
+getFileEntries(const std::vector<std::string>& paths)
 {
-	// log to stdout
-	Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
+	std::map<std::string, Zip::FileEntry> files;
 
-	if (argc < 2)
+	auto addFile {[&](const std::filesystem::path& path)
 	{
-		std::cerr << "Usage: <archive> <file> [...]" << std::endl;
-		return EXIT_FAILURE;
-	}
-
-	std::filesystem::path zipPath {argv[1]};
+		files.emplace(path.relative_path(), Zip::FileEntry {path});
+	}};
 
-	std::map<std::string, std::filesystem::path> files;
-	for (int i {2}; i < argc; ++i)
+	for (const std::string& pathStr : paths)
 	{
-		std::filesystem::path path {argv[i]};
-		files.emplace(path.relative_path(), path);
-	}
+		const std::filesystem::path path {pathStr};
+		if (!std::filesystem::is_directory(path))
+		{
+			addFile(path);
+			continue;
+		}
 
+		for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator {path})
+		{
+			if (entry.is_regular_file())
+				addFile(entry.path());
+		}
+	}
 
-	std::cout << "Compressing " << files.size() << " files..." << std::endl;
+	return files;
+}
 
+static
+void
+createArchive(const std::filesystem::path& zipPath, const std::map<std::string, Zip::FileEntry>& files)
+{
 	using namespace Zip;
 
+	std::cout << "Compressing " << files.size() << " files..." << std::endl;
+
 	std::ofstream ofs {zipPath.string().c_str(), std::ios_base::binary};
 	if (!ofs)
+		throw std::runtime_error {"Cannot open file '" + zipPath.string() + "' for writing"};
+
+	Zipper zipper {files};
+
+	Zip::SizeType nbTotalWrittenBytes {};
+	while (!zipper.isComplete())
 	{
-		std::cerr << "Cannot open file '" << zipPath.string() << "' for writing";
-		return EXIT_FAILURE;
+		//std::array<std::byte, Zipper::minOutputBufferSize> buffer;
+		std::array<std::byte, 65536> buffer;
+
+		const Zip::SizeType nbWrittenBytes {zipper.writeSome(buffer.data(), buffer.size())};
+		ofs.write(reinterpret_cast<const char*>(buffer.data()), nbWrittenBytes);
+		nbTotalWrittenBytes += nbWrittenBytes;
+	}
+
+	if (nbTotalWrittenBytes != zipper.getTotalZipFile())
+		std::cerr << "ERROR: actual size mismatch!" << std::endl;
+
+	std::cout << "Total zip size = " << zipper.getTotalZipFile() << std::endl;
+}
+
+static
+void
+printThroughput(const std::string& name, Zip::SizeType byteCount, std::chrono::duration<double> elapsed)
+{
+	std::cout << "  " << std::left << std::setw(16) << name << std::right
+		<< " size = " << std::setw(10) << byteCount / 1000. / 1000. << "MB"
+		<< ", elapsed = " << std::setw(9) << elapsed.count() * 1000 << "ms"
+		<< ", " << std::setw(9) << byteCount / 1000. / 1000. / elapsed.count() << " MB/s" << std::endl;
+}
+
+// Streams the archive the same way DownloadResource does, using one buffer of bufferSize bytes
+// Returns the CRC32s computed by the zipper
+static
+std::vector<Zip::Zipper::ComputedCrc32>
+streamArchive(const std::string& name, const std::map<std::string, Zip::FileEntry>& files, std::size_t bufferSize, std::ofstream& output)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::vector<std::byte> buffer(bufferSize);
+	Clock::duration zipperDuration {};
+	Clock::duration outputDuration {};
+
+	const Clock::time_point start {Clock::now()};
+
+	Zip::Zipper zipper {files};
+	while (!zipper.isComplete())
+	{
+		const Clock::time_point zipperStart {Clock::now()};
+		const Zip::SizeType nbWrittenBytes {zipper.writeSome(buffer.data(), buffer.size())};
+		const Clock::time_point outputStart {Clock::now()};
+		output.write(reinterpret_cast<const char*>(buffer.data()), nbWrittenBytes);
+		const Clock::time_point outputEnd {Clock::now()};
+
+		zipperDuration += outputStart - zipperStart;
+		outputDuration += outputEnd - outputStart;
+	}
+	output.flush();
+
+	const std::chrono::duration<double> elapsed {Clock::now() - start};
+
+	printThroughput(name, zipper.getTotalZipFile(), elapsed);
+	std::cout << "  " << std::setw(16) << "" << " zipper = " << std::chrono::duration<double, std::milli> {zipperDuration}.count() << "ms"
+		<< ", output = " << std::chrono::duration<double, std::milli> {outputDuration}.count() << "ms" << std::endl;
+
+	return zipper.getComputedCrc32s();
+}
+
+// CRC32 alone, on data already in memory
+static
+void
+benchmarkCrc32(std::size_t bufferSize)
+{
+	constexpr Zip::SizeType totalSize {1024 * 1024 * 1024};
+
+	std::vector<std::byte> buffer(bufferSize);
+	for (std::size_t i {}; i < buffer.size(); ++i)
+		buffer[i] = static_cast<std::byte>(i * 7 + 13);
+
+	Utils::Crc32Calculator crc32;
+	Zip::SizeType processedSize {};
+
+	const auto start {std::chrono::steady_clock::now()};
+	while (processedSize < totalSize)
+	{
+		crc32.processBytes(buffer.data(), buffer.size());
+		processedSize += buffer.size();
+	}
+	const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+
+	printThroughput("crc32 in memory", processedSize, elapsed);
+}
+
+// For each buffer size, streams the archive computing the CRC32s, and then again using the now known CRC32s
+// The difference between both is the CRC32 cost, the file data being read in both cases
+// The first pass may also be slowed down by reading the files from the storage rather than from the page cache
+static
+void
+benchmark(std::map<std::string, Zip::FileEntry> files, const std::vector<std::size_t>& bufferSizes, const std::filesystem::path& outputPath)
+{
+	std::ofstream output {outputPath.string().c_str(), std::ios_base::binary};
+	if (!output)
+		throw std::runtime_error {"Cannot open file '" + outputPath.string() + "' for writing"};
+
+	std::cout << "Streaming " << files.size() << " files to '" << outputPath.string() << "'..." << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+
+	std::cout << "Buffer size = " << bufferSizes.front() / 1024 << " KiB" << std::endl;
+	const std::vector<Zip::Zipper::ComputedCrc32> computedCrc32s {streamArchive("first pass", files, bufferSizes.front(), output)};
+
+	std::map<std::filesystem::path, Zip::FileEntry> filesWithCrc32;
+	for (auto& [name, fileEntry] : files)
+		filesWithCrc32.emplace(fileEntry.path, fileEntry);
+	for (const Zip::Zipper::ComputedCrc32& computedCrc32 : computedCrc32s)
+	{
+		Zip::FileEntry& fileEntry {filesWithCrc32.at(computedCrc32.path)};
+		fileEntry.crc32 = computedCrc32.crc32;
+		fileEntry.crc32FileLastWrite = computedCrc32.fileLastWrite;
+	}
+
+	std::map<std::string, Zip::FileEntry> knownCrc32Files;
+	for (const auto& [name, fileEntry] : files)
+		knownCrc32Files.emplace(name, filesWithCrc32.at(fileEntry.path));
+
+	for (std::size_t bufferSize : bufferSizes)
+	{
+		if (bufferSize != bufferSizes.front())
+			std::cout << "Buffer size = " << bufferSize / 1024 << " KiB" << std::endl;
+
+		streamArchive("compute crc32", files, bufferSize, output);
+		streamArchive("known crc32", knownCrc32Files, bufferSize, output);
+		benchmarkCrc32(bufferSize);
 	}
+}
+
+int main(int argc, char* argv[])
+{
+	// log to stdout
+	Service<Logger> logger {std::make_unique<StreamLogger>(std::cout)};
 
 	try
 	{
-		Zipper zipper {files};
+		namespace po = boost::program_options;
 
-		Zip::SizeType nbTotalWrittenBytes {};
-		while (!zipper.isComplete())
-		{
-			//std::array<std::byte, Zipper::minOutputBufferSize> buffer;
-			std::array<std::byte, 65536> buffer;
+		po::options_description desc {"Usage: <archive> <file> [...]\nAllowed options"};
+		desc.add_options()
+		("help,h", "print usage message")
+		("bench,b", "Benchmark: stream the archive of the files, no archive path to be provided")
+		("buffer-sizes", po::value<std::string>()->default_value("256"), "Benchmark: output buffer sizes, in KiB (see download-chunk-size)")
+		("output,o", po::value<std::string>()->default_value("/dev/null"), "Benchmark: output file")
+		("file", po::value<std::vector<std::string>>(), "Files or directories")
+		;
+
+		po::positional_options_description positional;
+		positional.add("file", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
 
-			const Zip::SizeType nbWrittenBytes {zipper.writeSome(buffer.data(), buffer.size())};
-			ofs.write(reinterpret_cast<const char*>(buffer.data()), nbWrittenBytes);
-			nbTotalWrittenBytes += nbWrittenBytes;
+		std::vector<std::string> paths;
+		if (vm.count("file"))
+			paths = vm["file"].as<std::vector<std::string>>();
+
+		if (vm.count("help") || paths.empty())
+		{
+			std::cout << desc << std::endl;
+			return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
 		}
 
-		if (nbTotalWrittenBytes != zipper.getTotalZipFile())
-			std::cerr << "ERROR: actual size mismatch!" << std::endl;
+		if (vm.count("bench"))
+		{
+			std::vector<std::size_t> bufferSizes;
+			for (const std::string& bufferSize : StringUtils::splitString(vm["buffer-sizes"].as<std::string>(), " ,"))
+			{
+				if (const auto value {StringUtils::readAs<std::size_t>(bufferSize)})
+					bufferSizes.push_back(std::max<std::size_t>(*value * 1024, Zip::Zipper::minOutputBufferSize));
+			}
+			if (bufferSizes.empty())
+				throw std::runtime_error {"No valid buffer size provided"};
+
+			benchmark(getFileEntries(paths), bufferSizes, vm["output"].as<std::string>());
+		}
+		else
+		{
+			const std::filesystem::path zipPath {paths.front()};
+			paths.erase(std::begin(paths));
 
-		std::cout << "Total zip size = " << zipper.getTotalZipFile() << std::endl;
+			createArchive(zipPath, getFileEntries(paths));
+		}
 	}
-	catch (const ZipperException& e)
+	catch (const Zip::ZipperException& e)
 	{
 		std::cerr << "Caught Zipper exception: " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Caught exception: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	return EXIT_SUCCESS;
 }